@@ -0,0 +1,122 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/*
+ * Socket filter dropping the packets of the flows bypassed by Suricata.
+ *
+ * Suricata adds both directions of a bypassed flow to the flow tables,
+ * the filter drops the packets matching an entry and updates its
+ * counters and timestamp so Suricata can expire idle entries.
+ *
+ * Use with the af-packet 'ebpf-filter-file' and 'bypass' options.
+ */
+
+#include <stddef.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+
+#include "flow_table.h"
+
+static __always_inline int ipv4_filter(struct __sk_buff *skb)
+{
+    struct iphdr iph;
+    struct flowv4_keys key;
+    struct pair *value;
+
+    __builtin_memset(&key, 0, sizeof(key));
+
+    if (bpf_skb_load_bytes(skb, ETH_HLEN, &iph, sizeof(iph)) < 0)
+        return -1;
+    if (iph.protocol != IPPROTO_TCP && iph.protocol != IPPROTO_UDP)
+        return -1;
+    /* no ports in fragments */
+    if (iph.frag_off & bpf_htons(0x3fff))
+        return -1;
+
+    if (bpf_skb_load_bytes(skb, ETH_HLEN + iph.ihl * 4, &key.ports,
+                sizeof(key.ports)) < 0)
+        return -1;
+    key.src = iph.saddr;
+    key.dst = iph.daddr;
+    key.ip_proto = iph.protocol;
+
+    value = bpf_map_lookup_elem(&flow_table_v4, &key);
+    if (value) {
+        value->packets++;
+        value->bytes += skb->len;
+        value->time = bpf_ktime_get_ns();
+        return 0;
+    }
+    return -1;
+}
+
+static __always_inline int ipv6_filter(struct __sk_buff *skb)
+{
+    struct ipv6hdr ip6h;
+    struct flowv6_keys key;
+    struct pair *value;
+
+    __builtin_memset(&key, 0, sizeof(key));
+
+    if (bpf_skb_load_bytes(skb, ETH_HLEN, &ip6h, sizeof(ip6h)) < 0)
+        return -1;
+    /* extension headers are not followed */
+    if (ip6h.nexthdr != IPPROTO_TCP && ip6h.nexthdr != IPPROTO_UDP)
+        return -1;
+
+    if (bpf_skb_load_bytes(skb, ETH_HLEN + sizeof(ip6h), &key.ports,
+                sizeof(key.ports)) < 0)
+        return -1;
+    __builtin_memcpy(key.src, ip6h.saddr.s6_addr32, sizeof(key.src));
+    __builtin_memcpy(key.dst, ip6h.daddr.s6_addr32, sizeof(key.dst));
+    key.ip_proto = ip6h.nexthdr;
+
+    value = bpf_map_lookup_elem(&flow_table_v6, &key);
+    if (value) {
+        value->packets++;
+        value->bytes += skb->len;
+        value->time = bpf_ktime_get_ns();
+        return 0;
+    }
+    return -1;
+}
+
+/* returns the number of bytes to pass to the socket: 0 drops the
+ * packet, -1 passes it whole */
+SEC("filter")
+int hashfilter(struct __sk_buff *skb)
+{
+    /* Suricata doesn't bypass vlan tagged flows */
+    if (skb->vlan_present)
+        return -1;
+
+    switch (skb->protocol) {
+        case bpf_htons(ETH_P_IP):
+            return ipv4_filter(skb);
+        case bpf_htons(ETH_P_IPV6):
+            return ipv6_filter(skb);
+        default:
+            return -1;
+    }
+}
+
+char __license[] SEC("license") = "GPL";
@@ -0,0 +1,70 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/*
+ * Bypass tables shared by the filter programs. The layout of the keys
+ * and values must match the one in src/util-ebpf.h.
+ */
+
+#ifndef __EBPF_FLOW_TABLE_H__
+#define __EBPF_FLOW_TABLE_H__
+
+#include <linux/types.h>
+
+#define FLOW_TABLE_SIZE 32768
+
+struct flowv4_keys {
+    __be32 src;
+    __be32 dst;
+    union {
+        __be32 ports;
+        __be16 port16[2];
+    };
+    __u32 ip_proto;
+} __attribute__((__aligned__(8)));
+
+struct flowv6_keys {
+    __be32 src[4];
+    __be32 dst[4];
+    union {
+        __be32 ports;
+        __be16 port16[2];
+    };
+    __u32 ip_proto;
+} __attribute__((__aligned__(8)));
+
+struct pair {
+    __u64 time;
+    __u64 packets;
+    __u64 bytes;
+} __attribute__((__aligned__(8)));
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __type(key, struct flowv4_keys);
+    __type(value, struct pair);
+    __uint(max_entries, FLOW_TABLE_SIZE);
+} flow_table_v4 SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __type(key, struct flowv6_keys);
+    __type(value, struct pair);
+    __uint(max_entries, FLOW_TABLE_SIZE);
+} flow_table_v6 SEC(".maps");
+
+#endif /* __EBPF_FLOW_TABLE_H__ */
@@ -0,0 +1,74 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/*
+ * Load balancing program for the eBPF fanout mode.
+ *
+ * The socket is selected on the IP addresses only, summed so both
+ * directions of a flow, and the fragments of a packet, land on the same
+ * capture thread. The kernel takes the returned value modulo the number
+ * of sockets in the fanout group.
+ *
+ * Use with the af-packet 'cluster_ebpf' cluster-type and 'ebpf-lb-file'.
+ */
+
+#include <stddef.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+
+static __always_inline __u32 ipv4_hash(struct __sk_buff *skb)
+{
+    __be32 addr[2];
+
+    if (bpf_skb_load_bytes(skb, ETH_HLEN + offsetof(struct iphdr, saddr),
+                addr, sizeof(addr)) < 0)
+        return 0;
+    return bpf_ntohl(addr[0]) + bpf_ntohl(addr[1]);
+}
+
+static __always_inline __u32 ipv6_hash(struct __sk_buff *skb)
+{
+    __be32 addr[8];
+    __u32 hash = 0;
+
+    if (bpf_skb_load_bytes(skb, ETH_HLEN + offsetof(struct ipv6hdr, saddr),
+                addr, sizeof(addr)) < 0)
+        return 0;
+#pragma unroll
+    for (int i = 0; i < 8; i++)
+        hash += bpf_ntohl(addr[i]);
+    return hash;
+}
+
+SEC("loadbalancer")
+int lb(struct __sk_buff *skb)
+{
+    switch (skb->protocol) {
+        case bpf_htons(ETH_P_IP):
+            return ipv4_hash(skb);
+        case bpf_htons(ETH_P_IPV6):
+            return ipv6_hash(skb);
+        default:
+            return 0;
+    }
+}
+
+char __license[] SEC("license") = "GPL";
@@ -0,0 +1,125 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/*
+ * XDP version of bypass_filter.c: the packets of bypassed flows are
+ * dropped in the driver, before an skb is allocated for them.
+ *
+ * Use with the af-packet 'xdp-filter-file' and 'bypass' options.
+ */
+
+#include <stddef.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+
+#include "flow_table.h"
+
+static __always_inline int ipv4_filter(void *data, void *data_end)
+{
+    struct iphdr *iph = data + sizeof(struct ethhdr);
+    struct flowv4_keys key;
+    struct pair *value;
+    __be16 *ports;
+
+    if ((void *)(iph + 1) > data_end)
+        return XDP_PASS;
+    if (iph->protocol != IPPROTO_TCP && iph->protocol != IPPROTO_UDP)
+        return XDP_PASS;
+    if (iph->frag_off & bpf_htons(0x3fff))
+        return XDP_PASS;
+
+    ports = (void *)iph + iph->ihl * 4;
+    if ((void *)(ports + 2) > data_end)
+        return XDP_PASS;
+
+    __builtin_memset(&key, 0, sizeof(key));
+    key.src = iph->saddr;
+    key.dst = iph->daddr;
+    key.port16[0] = ports[0];
+    key.port16[1] = ports[1];
+    key.ip_proto = iph->protocol;
+
+    value = bpf_map_lookup_elem(&flow_table_v4, &key);
+    if (value) {
+        value->packets++;
+        value->bytes += data_end - data;
+        value->time = bpf_ktime_get_ns();
+        return XDP_DROP;
+    }
+    return XDP_PASS;
+}
+
+static __always_inline int ipv6_filter(void *data, void *data_end)
+{
+    struct ipv6hdr *ip6h = data + sizeof(struct ethhdr);
+    struct flowv6_keys key;
+    struct pair *value;
+    __be16 *ports;
+
+    if ((void *)(ip6h + 1) > data_end)
+        return XDP_PASS;
+    if (ip6h->nexthdr != IPPROTO_TCP && ip6h->nexthdr != IPPROTO_UDP)
+        return XDP_PASS;
+
+    ports = (void *)(ip6h + 1);
+    if ((void *)(ports + 2) > data_end)
+        return XDP_PASS;
+
+    __builtin_memset(&key, 0, sizeof(key));
+    __builtin_memcpy(key.src, ip6h->saddr.s6_addr32, sizeof(key.src));
+    __builtin_memcpy(key.dst, ip6h->daddr.s6_addr32, sizeof(key.dst));
+    key.port16[0] = ports[0];
+    key.port16[1] = ports[1];
+    key.ip_proto = ip6h->nexthdr;
+
+    value = bpf_map_lookup_elem(&flow_table_v6, &key);
+    if (value) {
+        value->packets++;
+        value->bytes += data_end - data;
+        value->time = bpf_ktime_get_ns();
+        return XDP_DROP;
+    }
+    return XDP_PASS;
+}
+
+SEC("xdp")
+int xdp_hashfilter(struct xdp_md *ctx)
+{
+    void *data_end = (void *)(long)ctx->data_end;
+    void *data = (void *)(long)ctx->data;
+    struct ethhdr *eth = data;
+
+    if ((void *)(eth + 1) > data_end)
+        return XDP_PASS;
+
+    /* tagged frames are passed, Suricata doesn't bypass vlan flows */
+    switch (eth->h_proto) {
+        case bpf_htons(ETH_P_IP):
+            return ipv4_filter(data, data_end);
+        case bpf_htons(ETH_P_IPV6):
+            return ipv6_filter(data, data_end);
+        default:
+            return XDP_PASS;
+    }
+}
+
+char __license[] SEC("license") = "GPL";
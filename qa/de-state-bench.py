@@ -0,0 +1,105 @@
+#!/usr/bin/env python
+# Copyright(C) 2016 Open Information Security Foundation
+
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+# Replay pcaps through Suricata and report the memory used by the detect
+# state (the stored stateful rules of transactions and flows).
+#
+# Uses the detect.de_state.* counters from stats.log:
+#   memuse  bytes in use, the peak over the stats records is reported
+#   alloc   bytes allocated over the run, divided by the number of flows
+#           with an app-layer (app_layer.flow.*) for the per flow figure
+#   states  detect states in use
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+parser = argparse.ArgumentParser(prog='de-state-bench',
+        description='Report detect state memory use per flow for pcaps')
+parser.add_argument('-s', '--suricata', default='src/suricata',
+        help='Suricata binary')
+parser.add_argument('-c', '--config', default='suricata.yaml',
+        help='Suricata configuration file')
+parser.add_argument('-S', '--rules', required=True, help='rule file')
+parser.add_argument('-k', '--keep', action='store_true', default=False,
+        help='keep the log directories')
+parser.add_argument('pcaps', metavar='pcap', nargs='+', help='pcap files to replay')
+args = parser.parse_args()
+
+
+def parse_stats(path):
+    """ return a list of {counter: value} dicts, one per stats record """
+    records = []
+    cur = None
+    with open(path) as f:
+        for line in f:
+            if line.startswith('Date:'):
+                cur = {}
+                records.append(cur)
+                continue
+            parts = [p.strip() for p in line.split('|')]
+            if cur is None or len(parts) != 3 or parts[1] != 'Total':
+                continue
+            try:
+                cur[parts[0]] = int(parts[2])
+            except ValueError:
+                pass
+    return records
+
+
+def run(pcap, logdir):
+    cmd = [args.suricata, '-c', args.config, '-S', args.rules, '-r', pcap,
+           '-l', logdir, '-k', 'none',
+           '--set', 'stats.enabled=yes',
+           '--set', 'stats.interval=1']
+    with open(os.path.join(logdir, 'bench.log'), 'w') as log:
+        if subprocess.call(cmd, stdout=log, stderr=subprocess.STDOUT) != 0:
+            sys.stderr.write('suricata failed, see %s\n' % log.name)
+            sys.exit(1)
+
+    records = parse_stats(os.path.join(logdir, 'stats.log'))
+    if not records:
+        sys.stderr.write('%s: no stats records, is the stats output enabled?\n' % pcap)
+        sys.exit(1)
+    last = records[-1]
+    if 'detect.de_state.alloc' not in last:
+        sys.stderr.write('%s: no detect.de_state counters\n' % pcap)
+        sys.exit(1)
+
+    peak = max(r.get('detect.de_state.memuse', 0) for r in records)
+    states = max(r.get('detect.de_state.states', 0) for r in records)
+    alloc = last['detect.de_state.alloc']
+    flows = sum(v for k, v in last.items() if k.startswith('app_layer.flow.'))
+    return peak, states, alloc, flows
+
+
+print('%-32s %10s %12s %12s %12s %12s' % ('pcap', 'flows', 'peak memuse',
+        'peak states', 'alloc', 'bytes/flow'))
+for pcap in args.pcaps:
+    logdir = tempfile.mkdtemp(prefix='de-state-')
+
+    peak, states, alloc, flows = run(pcap, logdir)
+    per_flow = float(alloc) / flows if flows else 0.0
+    print('%-32s %10d %12d %12d %12d %12.1f' % (os.path.basename(pcap),
+            flows, peak, states, alloc, per_flow))
+
+    if args.keep:
+        print('  logs: %s' % logdir)
+    else:
+        shutil.rmtree(logdir)
@@ -0,0 +1,90 @@
+#!/usr/bin/env python
+# Copyright(C) 2016 Open Information Security Foundation
+
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+# Replay pcaps through a profiling build of Suricata with and without
+# detect.sig-order.cost and report the rule inspection ticks of both runs.
+#
+# The json rule profile of the first run can be fed to the second one
+# with --use-profile, to order by measured instead of estimated cost.
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+parser = argparse.ArgumentParser(prog='sig-order-bench',
+        description='Compare rule inspection ticks with and without cost based signature ordering')
+parser.add_argument('-s', '--suricata', default='src/suricata',
+        help='Suricata binary, built with --enable-profiling')
+parser.add_argument('-c', '--config', default='suricata.yaml',
+        help='Suricata configuration file')
+parser.add_argument('-S', '--rules', required=True, help='rule file')
+parser.add_argument('-p', '--use-profile', action='store_true', default=False,
+        help='order by the measured cost of the first run')
+parser.add_argument('-k', '--keep', action='store_true', default=False,
+        help='keep the log directories')
+parser.add_argument('pcaps', metavar='pcap', nargs='+', help='pcap files to replay')
+args = parser.parse_args()
+
+
+def run(pcap, logdir, cost, profile=None):
+    cmd = [args.suricata, '-c', args.config, '-S', args.rules, '-r', pcap,
+           '-l', logdir, '-k', 'none',
+           '--set', 'detect.sig-order.cost=%s' % ('yes' if cost else 'no'),
+           '--set', 'profiling.rules.enabled=yes',
+           '--set', 'profiling.rules.json=yes',
+           '--set', 'profiling.rules.append=no',
+           '--set', 'profiling.rules.filename=rule_perf.json']
+    if profile:
+        cmd += ['--set', 'detect.sig-order.cost-profile=%s' % profile]
+    with open(os.path.join(logdir, 'bench.log'), 'w') as log:
+        if subprocess.call(cmd, stdout=log, stderr=subprocess.STDOUT) != 0:
+            sys.stderr.write('suricata failed, see %s\n' % log.name)
+            sys.exit(1)
+
+    path = os.path.join(logdir, 'rule_perf.json')
+    with open(path) as f:
+        profile = json.load(f)
+    # the buffer totals cover all rules, the rules list is limited
+    ticks = sum(b['ticks_total'] for b in profile.get('buffers', []))
+    checks = sum(b['checks'] for b in profile.get('buffers', []))
+    return path, ticks, checks
+
+
+print('%-40s %16s %16s %8s' % ('pcap', 'ticks before', 'ticks after', 'change'))
+for pcap in args.pcaps:
+    before_dir = tempfile.mkdtemp(prefix='sig-order-before-')
+    after_dir = tempfile.mkdtemp(prefix='sig-order-after-')
+
+    profile, before, before_checks = run(pcap, before_dir, False)
+    _, after, after_checks = run(pcap, after_dir, True,
+            profile if args.use_profile else None)
+
+    if before_checks != after_checks:
+        sys.stderr.write('%s: rule checks differ, %d vs %d\n' %
+                (pcap, before_checks, after_checks))
+
+    change = (float(after) - before) / before * 100 if before else 0.0
+    print('%-40s %16d %16d %7.2f%%' % (os.path.basename(pcap), before, after, change))
+
+    if args.keep:
+        print('  logs: %s %s' % (before_dir, after_dir))
+    else:
+        shutil.rmtree(before_dir)
+        shutil.rmtree(after_dir)
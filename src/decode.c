@@ -382,6 +382,17 @@ void PacketDefragPktSetupParent(Packet *parent)
     DecodeSetNoPayloadInspectionFlag(parent);
 }
 
+/**
+ *  \brief bypass the flow of a packet
+ *
+ *  The capture method is asked to bypass the flow through the packet's
+ *  BypassPacketsFlow callback. If it can, the flow gets a bypass info,
+ *  which the callback may already have set up to add its own update and
+ *  free callbacks. If it can't, the flow is bypassed locally: its packets
+ *  are still decoded and looked up, but not inspected.
+ *
+ *  \param p packet with a locked flow
+ */
 void PacketBypassCallback(Packet *p)
 {
     /* Don't try to bypass if flow is already out or
@@ -393,6 +404,7 @@ void PacketBypassCallback(Packet *p)
     }
 
     if (p->BypassPacketsFlow && p->BypassPacketsFlow(p)) {
+        (void)FlowSetupBypassInfo(p->flow);
         FlowUpdateState(p->flow, FLOW_STATE_CAPTURE_BYPASSED);
     } else {
         FlowUpdateState(p->flow, FLOW_STATE_LOCAL_BYPASSED);
@@ -429,6 +441,7 @@ void DecodeRegisterPerfCounters(DecodeThreadVars *dtv, ThreadVars *tv)
     dtv->counter_max_pkt_size = StatsRegisterMaxCounter("decoder.max_pkt_size", tv);
     dtv->counter_erspan = StatsRegisterMaxCounter("decoder.erspan", tv);
     dtv->counter_flow_memcap = StatsRegisterCounter("flow.memcap", tv);
+    dtv->counter_flow_wrong_thread = StatsRegisterCounter("flow.wrong_thread", tv);
 
     dtv->counter_defrag_ipv4_fragments =
         StatsRegisterCounter("defrag.ipv4.fragments", tv);
@@ -648,12 +648,17 @@ typedef struct DecodeThreadVars_
     uint16_t counter_defrag_max_hit;
 
     uint16_t counter_flow_memcap;
+    uint16_t counter_flow_wrong_thread;
 
      uint16_t counter_invalid_events[DECODE_EVENT_PACKET_MAX];
     /* thread data for flow logging api: only used at forced
      * flow recycle during lookups */
     void *output_flow_thread_data;
 
+    /** lockless flow lookup reader state, only set for threads that
+     *  look up flows in the global hash (the flow workers) */
+    struct FlowEpochReader_ *flow_reader;
+
 #ifdef __SC_CUDA_SUPPORT__
     CudaThreadVars cuda_vars;
 #endif
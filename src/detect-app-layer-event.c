@@ -33,6 +33,7 @@
 #include "detect-parse.h"
 #include "detect-engine.h"
 #include "detect-engine-state.h"
+#include "detect-engine-prefilter-common.h"
 #include "detect-app-layer-event.h"
 
 #include "flow.h"
@@ -54,6 +55,9 @@ static int DetectAppLayerEventSetupP1(DetectEngineCtx *, Signature *, char *);
 static void DetectAppLayerEventRegisterTests(void);
 static void DetectAppLayerEventFree(void *);
 
+static int PrefilterSetupAppLayerEvent(SigGroupHead *sgh);
+static _Bool PrefilterAppLayerEventIsPrefilterable(const Signature *s);
+
 /**
  * \brief Registers the keyword handlers for the "app-layer-event" keyword.
  */
@@ -69,6 +73,11 @@ void DetectAppLayerEventRegister(void)
     sigmatch_table[DETECT_AL_APP_LAYER_EVENT].RegisterTests =
         DetectAppLayerEventRegisterTests;
 
+    sigmatch_table[DETECT_AL_APP_LAYER_EVENT].SupportsPrefilter =
+        PrefilterAppLayerEventIsPrefilterable;
+    sigmatch_table[DETECT_AL_APP_LAYER_EVENT].SetupPrefilter =
+        PrefilterSetupAppLayerEvent;
+
     return;
 }
 
@@ -102,6 +111,48 @@ static int DetectAppLayerEventAppMatch(ThreadVars *t, DetectEngineThreadCtx *det
     SCReturnInt(r);
 }
 
+/* prefilter code */
+
+static void
+PrefilterPacketAppLayerEventMatch(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx)
+{
+    const AppLayerDecoderEvents *events = p->app_layer_events;
+    if (events == NULL)
+        return;
+
+    /* add the rules for each of the events set on the packet */
+    uint8_t i;
+    for (i = 0; i < events->cnt; i++) {
+        PrefilterPacketU8HashAddSids(det_ctx, pectx, events->events[i]);
+    }
+}
+
+static _Bool PrefilterPacketAppLayerEventValueMatch(const SigMatchCtx *smctx,
+        const uint8_t value)
+{
+    const DetectAppLayerEventData *aled = (const DetectAppLayerEventData *)smctx;
+    return (aled->event_id == (int)value) ? TRUE : FALSE;
+}
+
+static int PrefilterSetupAppLayerEvent(SigGroupHead *sgh)
+{
+    return PrefilterSetupPacketHeaderU8Hash(sgh, DETECT_AL_APP_LAYER_EVENT,
+            PrefilterPacketAppLayerEventValueMatch,
+            PrefilterPacketAppLayerEventMatch, "app-layer-events");
+}
+
+/** \brief only the packet events in the match list are prefilterable,
+ *         the app-layer events are inspected per tx. */
+static _Bool PrefilterAppLayerEventIsPrefilterable(const Signature *s)
+{
+    const SigMatch *sm = s->sm_lists[DETECT_SM_LIST_MATCH];
+    for ( ; sm != NULL; sm = sm->next) {
+        if (sm->type == DETECT_AL_APP_LAYER_EVENT)
+            return TRUE;
+    }
+    return FALSE;
+}
+
 static DetectAppLayerEventData *DetectAppLayerEventParsePkt(const char *arg,
                                                             AppLayerEventType *event_type)
 {
@@ -28,6 +28,8 @@
 
 #include "detect.h"
 #include "detect-engine.h"
+#include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -105,6 +107,7 @@ int DetectEngineInspectDnsQueryName(ThreadVars *tv,
  *  \retval ret Number of matches.
  */
 static inline uint32_t DnsQueryPatternSearch(DetectEngineThreadCtx *det_ctx,
+                                      const MpmCtx *mpm_ctx,
                                       const uint8_t *buffer, const uint32_t buffer_len,
                                       const uint8_t flags)
 {
@@ -113,11 +116,11 @@ static inline uint32_t DnsQueryPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOCLIENT);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_dnsquery_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (buffer_len >= det_ctx->sgh->mpm_dnsquery_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_dnsquery_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_dnsquery_ctx_ts, &det_ctx->mtcu,
+    if (buffer_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, buffer, buffer_len);
     }
 
@@ -127,36 +130,43 @@ static inline uint32_t DnsQueryPatternSearch(DetectEngineThreadCtx *det_ctx,
 /**
  *  \brief Run the pattern matcher against the queries
  *
+ *  \param det_ctx detection engine thread ctx
+ *  \param pectx inspection context (the mpm ctx)
  *  \param f locked flow
- *  \param dns_state initialized dns state
+ *  \param txv tx to inspect
  *
  *  \warning Make sure the flow/state is locked
- *  \todo what should we return? Just the fact that we matched?
  */
-uint32_t DetectDnsQueryInspectMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                  DNSState *dns_state, uint8_t flags, void *txv,
-                                  uint64_t tx_id)
+static void PrefilterTxDnsQuery(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
     SCEnter();
 
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
     DNSTransaction *tx = (DNSTransaction *)txv;
     DNSQueryEntry *query = NULL;
-    uint8_t *buffer;
-    uint16_t buffer_len;
-    uint32_t cnt = 0;
 
     TAILQ_FOREACH(query, &tx->query_list, next) {
         SCLogDebug("tx %p query %p", tx, query);
 
-        buffer = (uint8_t *)((uint8_t *)query + sizeof(DNSQueryEntry));
-        buffer_len = query->len;
+        const uint8_t *buffer =
+            (const uint8_t *)((uint8_t *)query + sizeof(DNSQueryEntry));
+        const uint32_t buffer_len = query->len;
 
-        cnt += DnsQueryPatternSearch(det_ctx,
+        DnsQueryPatternSearch(det_ctx, mpm_ctx,
                 buffer, buffer_len,
                 flags);
     }
+}
+
+int PrefilterTxDnsQueryRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
 
-    SCReturnUInt(cnt);
+    return PrefilterAppendTxEngine(sgh, PrefilterTxDnsQuery,
+        ALPROTO_DNS, STREAM_TOSERVER, 0,
+        mpm_ctx, NULL, "dns_query");
 }
 
 int DetectEngineInspectDnsRequest(ThreadVars *tv,
@@ -37,4 +37,6 @@ int DetectEngineInspectDnsResponse(ThreadVars *tv,
                                    Signature *s, Flow *f, uint8_t flags,
                                    void *alstate, void *txv, uint64_t tx_id);
 
+int PrefilterTxDnsQueryRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx);
+
 #endif /* __DETECT_ENGINE_DNS_H__ */
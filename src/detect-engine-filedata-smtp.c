@@ -29,6 +29,7 @@
 #include "detect.h"
 #include "detect-engine.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -244,6 +245,7 @@ void DetectEngineCleanSMTPBuffers(DetectEngineThreadCtx *det_ctx)
  *  \retval ret Number of matches.
  */
 static inline uint32_t SMTPFiledataPatternSearch(DetectEngineThreadCtx *det_ctx,
+                              const MpmCtx *mpm_ctx,
                               const uint8_t *buffer, const uint32_t buffer_len,
                               const uint8_t flags)
 {
@@ -252,45 +254,61 @@ static inline uint32_t SMTPFiledataPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOCLIENT);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_smtp_filedata_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (buffer_len >= det_ctx->sgh->mpm_smtp_filedata_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_smtp_filedata_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_smtp_filedata_ctx_ts, &det_ctx->mtcu,
+    if (buffer_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, buffer, buffer_len);
     }
 
     SCReturnUInt(ret);
 }
 
-int DetectEngineRunSMTPMpm(DetectEngineCtx *de_ctx,
-                           DetectEngineThreadCtx *det_ctx, Flow *f,
-                           SMTPState *smtp_state, uint8_t flags,
-                           void *tx, uint64_t idx)
+/** \brief SMTP Filedata Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxSmtpFiledata(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
-    FileContainer *ffc = smtp_state->files_ts;
-    uint32_t cnt = 0;
-    uint32_t buffer_len = 0;
-    uint32_t stream_start_offset = 0;
-    const uint8_t *buffer = NULL;
+    SCEnter();
 
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
+    SMTPState *smtp_state = f->alstate;
+    FileContainer *ffc = smtp_state->files_ts;
     if (ffc != NULL) {
         File *file = ffc->head;
         for (; file != NULL; file = file->next) {
-            buffer = DetectEngineSMTPGetBufferForTX(idx,
-                                                    de_ctx, det_ctx,
+            uint32_t buffer_len = 0;
+            uint32_t stream_start_offset = 0;
+
+            const uint8_t *buffer = DetectEngineSMTPGetBufferForTX(idx,
+                                                    det_ctx->de_ctx, det_ctx,
                                                     f, file,
                                                     flags,
                                                     &buffer_len,
                                                     &stream_start_offset);
             if (buffer_len == 0)
-                goto end;
+                return;
 
-            cnt += SMTPFiledataPatternSearch(det_ctx, (uint8_t *)buffer, buffer_len, flags);
+            SMTPFiledataPatternSearch(det_ctx, mpm_ctx, buffer, buffer_len, flags);
         }
     }
-end:
-    return cnt;
+}
+
+int PrefilterTxSmtpFiledataRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxSmtpFiledata,
+        ALPROTO_SMTP, STREAM_TOSERVER, 0,
+        mpm_ctx, NULL, "file_data");
 }
 
 #ifdef UNITTESTS
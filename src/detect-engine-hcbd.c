@@ -38,6 +38,8 @@
 #include "detect.h"
 #include "detect-engine.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
+#include "detect-engine-mpm-stream.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -60,6 +62,9 @@
 #include "conf.h"
 #include "conf-yaml-loader.h"
 
+#include "flow-bit.h"
+#include "util-var-name.h"
+
 #include "util-validate.h"
 
 #define BUFFER_STEP 50
@@ -222,6 +227,7 @@ static const uint8_t *DetectEngineHCBDGetBufferForTX(htp_tx_t *tx, uint64_t tx_i
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpClientBodyPatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *body, const uint32_t body_len,
         const uint8_t flags)
 {
@@ -230,38 +236,58 @@ static inline uint32_t HttpClientBodyPatternSearch(DetectEngineThreadCtx *det_ct
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOCLIENT);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hcbd_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (body_len >= det_ctx->sgh->mpm_hcbd_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_hcbd_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_hcbd_ctx_ts, &det_ctx->mtcu,
+    if (body_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, body, body_len);
     }
 
     SCReturnUInt(ret);
 }
 
-int DetectEngineRunHttpClientBodyMpm(DetectEngineCtx *de_ctx,
-                                     DetectEngineThreadCtx *det_ctx, Flow *f,
-                                     HtpState *htp_state, uint8_t flags,
-                                     void *tx, uint64_t idx)
+/** \brief HTTP Request Body Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxHttpRequestBody(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
-    uint32_t cnt = 0;
+    SCEnter();
+
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
+    HtpState *htp_state = f->alstate;
     uint32_t buffer_len = 0;
     uint32_t stream_start_offset = 0;
-    const uint8_t *buffer = DetectEngineHCBDGetBufferForTX(tx, idx,
-                                                     de_ctx, det_ctx,
+    const uint8_t *buffer = DetectEngineHCBDGetBufferForTX(txv, idx,
+                                                     det_ctx->de_ctx, det_ctx,
                                                      f, htp_state,
                                                      flags,
                                                      &buffer_len,
                                                      &stream_start_offset);
     if (buffer_len == 0)
-        goto end;
+        return;
 
-    cnt = HttpClientBodyPatternSearch(det_ctx, (uint8_t *)buffer, buffer_len, flags);
+    if (DetectMpmStreamSearchBody(det_ctx, f, mpm_ctx, idx, buffer,
+                buffer_len, stream_start_offset, flags))
+        return;
 
- end:
-    return cnt;
+    HttpClientBodyPatternSearch(det_ctx, mpm_ctx, buffer, buffer_len, flags);
+}
+
+int PrefilterTxHttpRequestBodyRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxHttpRequestBody,
+        ALPROTO_HTTP, STREAM_TOSERVER, HTP_REQUEST_BODY,
+        mpm_ctx, NULL, "http_client_body");
 }
 
 int DetectEngineInspectHttpClientBody(ThreadVars *tv,
@@ -1060,6 +1086,120 @@ libhtp:\n\
     return RunTest(steps, sig, yaml);
 }
 
+/** \internal
+ *  \brief the body pattern is in the first chunk, but the flowbit the
+ *         rule needs is only set before the second chunk.
+ */
+static int DetectEngineHttpClientBodyFlowbitTest(int mpm_streaming)
+{
+    const char yaml[] = "\
+%YAML 1.1\n\
+---\n\
+libhtp:\n\
+\n\
+  default-config:\n\
+    personality: IDS\n\
+    request-body-limit: 0\n\
+    response-body-limit: 0\n\
+\n\
+    request-body-inspect-window: 4096\n\
+    response-body-inspect-window: 4096\n\
+    request-body-minimal-inspect-size: 0\n\
+    response-body-minimal-inspect-size: 0\n\
+";
+    const char *chunks[] = {
+        "POST /index.html HTTP/1.1\r\n"
+        "Host: www.openinfosecfoundation.org\r\n"
+        "Content-Length: 46\r\n"
+        "\r\n"
+        "This is dummy body1",
+        "This is dummy message body2",
+    };
+    TcpSession ssn;
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    AppLayerParserThreadCtx *alp_tctx = AppLayerParserThreadCtxAlloc();
+    FAIL_IF_NULL(alp_tctx);
+    memset(&th_v, 0, sizeof(th_v));
+    memset(&ssn, 0, sizeof(ssn));
+
+    ConfCreateContextBackup();
+    ConfInit();
+    HtpConfigCreateBackup();
+    ConfYamlLoadString(yaml, strlen(yaml));
+    HTPConfigure();
+
+    FlowInitConfig(FLOW_QUIET);
+    StreamTcpInitConfig(TRUE);
+
+    /* the mpm stream state lives in the flow storage */
+    Flow *f = FlowAlloc();
+    FAIL_IF_NULL(f);
+    f->protoctx = (void *)&ssn;
+    f->proto = IPPROTO_TCP;
+    f->flags |= FLOW_IPV4;
+    f->alproto = ALPROTO_HTTP;
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->mpm_streaming = mpm_streaming;
+
+    Signature *s = DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(flowbits:isset,fb; content:\"body1\"; http_client_body; sid:1;)");
+    FAIL_IF_NULL(s);
+    uint16_t fb = VariableNameGetIdx(de_ctx, "fb", VAR_TYPE_FLOW_BIT);
+
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    int i;
+    for (i = 0; i < 2; i++) {
+        Packet *p = UTHBuildPacket(NULL, 0, IPPROTO_TCP);
+        FAIL_IF_NULL(p);
+        p->flow = f;
+        p->flowflags = FLOW_PKT_TOSERVER|FLOW_PKT_ESTABLISHED;
+        p->flags |= PKT_HAS_FLOW|PKT_STREAM_EST;
+
+        FLOWLOCK_WRLOCK(f);
+        int r = AppLayerParserParse(NULL, alp_tctx, f, ALPROTO_HTTP,
+                STREAM_TOSERVER, (uint8_t *)chunks[i], strlen(chunks[i]));
+        FAIL_IF(r != 0);
+        /* the flowbit is set after the first chunk was inspected */
+        if (i == 1)
+            FlowBitSet(f, fb);
+        FLOWLOCK_UNLOCK(f);
+
+        SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+        FAIL_IF(PacketAlertCheck(p, 1) != i);
+        UTHFreePackets(&p, 1);
+    }
+
+    AppLayerParserThreadCtxFree(alp_tctx);
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+
+    f->protoctx = NULL;
+    FlowClearMemory(f, FlowGetProtoMapping(f->proto));
+    FlowFree(f);
+    StreamTcpFreeConfig(TRUE);
+    FlowShutdown();
+
+    HtpConfigRestoreBackup();
+    ConfRestoreContextBackup();
+    PASS;
+}
+
+/** \test rule found in the first body chunk while its flowbit is unset
+ *        matches on the second chunk, with and without the streaming
+ *        mpm searching only the new data */
+static int DetectEngineHttpClientBodyTest32(void)
+{
+    FAIL_IF_NOT(DetectEngineHttpClientBodyFlowbitTest(0));
+    FAIL_IF_NOT(DetectEngineHttpClientBodyFlowbitTest(1));
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void DetectEngineHttpClientBodyRegisterTests(void)
@@ -1129,6 +1269,8 @@ void DetectEngineHttpClientBodyRegisterTests(void)
                    DetectEngineHttpClientBodyTest30);
     UtRegisterTest("DetectEngineHttpClientBodyTest31",
                    DetectEngineHttpClientBodyTest31);
+    UtRegisterTest("DetectEngineHttpClientBodyTest32",
+                   DetectEngineHttpClientBodyTest32);
 #endif /* UNITTESTS */
 
     return;
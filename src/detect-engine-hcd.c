@@ -38,6 +38,7 @@
 #include "detect-engine.h"
 #include "detect-engine-hcd.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -68,6 +69,7 @@
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpCookiePatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *cookie, const uint32_t cookie_len,
         const uint8_t flags)
 {
@@ -75,58 +77,97 @@ static inline uint32_t HttpCookiePatternSearch(DetectEngineThreadCtx *det_ctx,
 
     uint32_t ret = 0;
 
-    if (flags & STREAM_TOSERVER) {
-        DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hcd_ctx_ts == NULL);
-
-        if (cookie_len >= det_ctx->sgh->mpm_hcd_ctx_ts->minlen) {
-            ret = mpm_table[det_ctx->sgh->mpm_hcd_ctx_ts->mpm_type].
-                Search(det_ctx->sgh->mpm_hcd_ctx_ts, &det_ctx->mtcu,
-                        &det_ctx->pmq, cookie, cookie_len);
-        }
-    } else {
-        DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hcd_ctx_tc == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-        if (cookie_len >= det_ctx->sgh->mpm_hcd_ctx_tc->minlen) {
-            ret = mpm_table[det_ctx->sgh->mpm_hcd_ctx_tc->mpm_type].
-                Search(det_ctx->sgh->mpm_hcd_ctx_tc, &det_ctx->mtcu,
-                        &det_ctx->pmq, cookie, cookie_len);
-        }
+    if (cookie_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
+                    &det_ctx->pmq, cookie, cookie_len);
     }
 
     SCReturnUInt(ret);
 }
 
-int DetectEngineRunHttpCookieMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                 HtpState *htp_state, uint8_t flags,
-                                 void *txv, uint64_t idx)
+/** \brief HTTP Cookie Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxRequestCookie(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
-    uint32_t cnt = 0;
+    SCEnter();
+
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
     htp_tx_t *tx = (htp_tx_t *)txv;
+
     if (tx->request_headers == NULL)
-        goto end;
+        return;
 
-    htp_header_t *h = NULL;
-    if (flags & STREAM_TOSERVER) {
-        h = (htp_header_t *)htp_table_get_c(tx->request_headers,
-                                            "Cookie");
-        if (h == NULL) {
-            SCLogDebug("HTTP cookie header not present in this request");
-            goto end;
-        }
-    } else {
-        h = (htp_header_t *)htp_table_get_c(tx->response_headers,
-                                            "Set-Cookie");
-        if (h == NULL) {
-            SCLogDebug("HTTP Set-Cookie header not present in this request");
-            goto end;
-        }
+    htp_header_t *h = (htp_header_t *)htp_table_get_c(tx->request_headers,
+                                                      "Cookie");
+    if (h == NULL) {
+        SCLogDebug("HTTP cookie header not present in this request");
+        return;
     }
 
-    cnt = HttpCookiePatternSearch(det_ctx,
-                                  (uint8_t *)bstr_ptr(h->value),
-                                  bstr_len(h->value), flags);
- end:
-    return cnt;
+    HttpCookiePatternSearch(det_ctx, mpm_ctx,
+                            (uint8_t *)bstr_ptr(h->value),
+                            bstr_len(h->value), flags);
+}
+
+int PrefilterTxRequestCookieRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxRequestCookie,
+        ALPROTO_HTTP, STREAM_TOSERVER, HTP_REQUEST_HEADERS,
+        mpm_ctx, NULL, "http_cookie");
+}
+
+/** \brief HTTP Set-Cookie Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxResponseCookie(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
+{
+    SCEnter();
+
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
+    htp_tx_t *tx = (htp_tx_t *)txv;
+
+    if (tx->response_headers == NULL)
+        return;
+
+    htp_header_t *h = (htp_header_t *)htp_table_get_c(tx->response_headers,
+                                                      "Set-Cookie");
+    if (h == NULL) {
+        SCLogDebug("HTTP Set-Cookie header not present in this request");
+        return;
+    }
+
+    HttpCookiePatternSearch(det_ctx, mpm_ctx,
+                            (uint8_t *)bstr_ptr(h->value),
+                            bstr_len(h->value), flags);
+}
+
+int PrefilterTxResponseCookieRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxResponseCookie,
+        ALPROTO_HTTP, STREAM_TOCLIENT, HTP_RESPONSE_HEADERS,
+        mpm_ctx, NULL, "http_cookie");
 }
 
 /**
@@ -38,6 +38,7 @@
 #include "detect-engine.h"
 #include "detect-engine-hhd.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -224,6 +225,7 @@ static uint8_t *DetectEngineHHDGetBufferForTX(htp_tx_t *tx, uint64_t tx_id,
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpHeaderPatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *headers, const uint32_t headers_len,
         const uint8_t flags)
 {
@@ -231,45 +233,61 @@ static inline uint32_t HttpHeaderPatternSearch(DetectEngineThreadCtx *det_ctx,
 
     uint32_t ret = 0;
 
-    if (flags & STREAM_TOSERVER) {
-        DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hhd_ctx_ts == NULL);
-
-        if (headers_len >= det_ctx->sgh->mpm_hhd_ctx_ts->minlen) {
-            ret = mpm_table[det_ctx->sgh->mpm_hhd_ctx_ts->mpm_type].
-                Search(det_ctx->sgh->mpm_hhd_ctx_ts, &det_ctx->mtcu,
-                        &det_ctx->pmq, headers, headers_len);
-        }
-    } else {
-        DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hhd_ctx_tc == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-        if (headers_len >= det_ctx->sgh->mpm_hhd_ctx_tc->minlen) {
-            ret = mpm_table[det_ctx->sgh->mpm_hhd_ctx_tc->mpm_type].
-                Search(det_ctx->sgh->mpm_hhd_ctx_tc, &det_ctx->mtcu,
-                        &det_ctx->pmq, headers, headers_len);
-        }
+    if (headers_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
+                    &det_ctx->pmq, headers, headers_len);
     }
 
     SCReturnUInt(ret);
 }
 
-int DetectEngineRunHttpHeaderMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                 HtpState *htp_state, uint8_t flags,
-                                 void *tx, uint64_t idx)
+/** \brief HTTP Header Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxHttpHeaders(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
-    uint32_t cnt = 0;
+    SCEnter();
+
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
+    HtpState *htp_state = f->alstate;
     uint32_t buffer_len = 0;
-    uint8_t *buffer = DetectEngineHHDGetBufferForTX(tx, idx,
+    const uint8_t *buffer = DetectEngineHHDGetBufferForTX(txv, idx,
                                                     NULL, det_ctx,
                                                     f, htp_state,
                                                     flags,
                                                     &buffer_len);
     if (buffer_len == 0)
-        goto end;
+        return;
 
-    cnt = HttpHeaderPatternSearch(det_ctx, buffer, buffer_len, flags);
+    HttpHeaderPatternSearch(det_ctx, mpm_ctx, buffer, buffer_len, flags);
+}
 
- end:
-    return cnt;
+int PrefilterTxHttpRequestHeadersRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxHttpHeaders,
+        ALPROTO_HTTP, STREAM_TOSERVER, HTP_REQUEST_HEADERS,
+        mpm_ctx, NULL, "http_header");
+}
+
+int PrefilterTxHttpResponseHeadersRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxHttpHeaders,
+        ALPROTO_HTTP, STREAM_TOCLIENT, HTP_RESPONSE_HEADERS,
+        mpm_ctx, NULL, "http_header");
 }
 
 int DetectEngineInspectHttpHeader(ThreadVars *tv,
@@ -2032,7 +2050,12 @@ static int DetectEngineHttpHeaderTest18(void)
 
     /* start the search phase */
     det_ctx->sgh = SigMatchSignaturesGetSgh(de_ctx, det_ctx, p);
-    uint32_t r = HttpHeaderPatternSearch(det_ctx, http_buf, http_len, STREAM_TOSERVER);
+    const PrefilterEngine *engine = PrefilterFindEngine(det_ctx->sgh->tx_engines, "http_header");
+    if (engine == NULL) {
+        printf("no http_header prefilter engine: ");
+        goto end;
+    }
+    uint32_t r = HttpHeaderPatternSearch(det_ctx, engine->pectx, http_buf, http_len, STREAM_TOSERVER);
     if (r < 1) {
         printf("expected result >= 1, got %"PRIu32": ", r);
         goto end;
@@ -2107,7 +2130,12 @@ static int DetectEngineHttpHeaderTest19(void)
 
     /* start the search phase */
     det_ctx->sgh = SigMatchSignaturesGetSgh(de_ctx, det_ctx, p);
-    uint32_t r = HttpHeaderPatternSearch(det_ctx, http_buf, http_len, STREAM_TOSERVER);
+    const PrefilterEngine *engine = PrefilterFindEngine(det_ctx->sgh->tx_engines, "http_header");
+    if (engine == NULL) {
+        printf("no http_header prefilter engine: ");
+        goto end;
+    }
+    uint32_t r = HttpHeaderPatternSearch(det_ctx, engine->pectx, http_buf, http_len, STREAM_TOSERVER);
     if (r != 1) {
         printf("expected result 1, got %"PRIu32": ", r);
         goto end;
@@ -38,6 +38,7 @@
 #include "detect.h"
 #include "detect-engine.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -71,6 +72,7 @@
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpHHPatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *hh, const uint32_t hh_len,
         const uint8_t flags)
 {
@@ -79,34 +81,52 @@ static inline uint32_t HttpHHPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOCLIENT);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hhhd_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (hh_len >= det_ctx->sgh->mpm_hhhd_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_hhhd_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_hhhd_ctx_ts, &det_ctx->mtcu,
+    if (hh_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, hh, hh_len);
     }
 
     SCReturnUInt(ret);
 }
 
-int DetectEngineRunHttpHHMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                             HtpState *htp_state, uint8_t flags,
-                             void *txv, uint64_t idx)
+/** \brief HTTP Hostname Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxHostname(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
-    uint32_t cnt = 0;
+    SCEnter();
+
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
     htp_tx_t *tx = (htp_tx_t *)txv;
+
     if (tx->request_hostname == NULL)
-        goto end;
+        return;
+
     const uint8_t *hname = (const uint8_t *)bstr_ptr(tx->request_hostname);
     if (hname == NULL)
-        goto end;
+        return;
     const uint32_t hname_len = bstr_len(tx->request_hostname);
 
-    cnt = HttpHHPatternSearch(det_ctx, hname, hname_len, flags);
+    HttpHHPatternSearch(det_ctx, mpm_ctx, hname, hname_len, flags);
+}
 
- end:
-    return cnt;
+int PrefilterTxHostnameRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxHostname,
+        ALPROTO_HTTP, STREAM_TOSERVER, HTP_REQUEST_HEADERS,
+        mpm_ctx, NULL, "http_host");
 }
 
 /**
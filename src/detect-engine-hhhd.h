@@ -31,9 +31,7 @@ int DetectEngineInspectHttpHH(ThreadVars *tv,
                               Signature *s, Flow *f, uint8_t flags,
                               void *alstate,
                               void *tx, uint64_t tx_id);
-int DetectEngineRunHttpHHMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                             HtpState *htp_state, uint8_t flags,
-                             void *tx, uint64_t idx);
+int PrefilterTxHostnameRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx);
 void DetectEngineHttpHHRegisterTests(void);
 
 #endif /* __DETECT_ENGINE_HHHD_H__ */
@@ -38,6 +38,7 @@
 #include "detect-engine.h"
 #include "detect-engine-hmd.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -68,6 +69,7 @@
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpMethodPatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *raw_method, const uint32_t raw_method_len,
         const uint8_t flags)
 {
@@ -76,32 +78,50 @@ static inline uint32_t HttpMethodPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOCLIENT);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hmd_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (raw_method_len >= det_ctx->sgh->mpm_hmd_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_hmd_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_hmd_ctx_ts, &det_ctx->mtcu,
+    if (raw_method_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, raw_method, raw_method_len);
     }
 
     SCReturnUInt(ret);
 }
 
-int DetectEngineRunHttpMethodMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                 HtpState *htp_state, uint8_t flags,
-                                 void *txv, uint64_t idx)
+/** \brief HTTP Method Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxMethod(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
-    uint32_t cnt = 0;
+    SCEnter();
+
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
     htp_tx_t *tx = (htp_tx_t *)txv;
+
     if (tx->request_method == NULL)
-        goto end;
+        return;
+
+    HttpMethodPatternSearch(det_ctx, mpm_ctx,
+            (const uint8_t *)bstr_ptr(tx->request_method),
+            bstr_len(tx->request_method),
+            flags);
+}
+
+int PrefilterTxMethodRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
 
-    cnt = HttpMethodPatternSearch(det_ctx,
-                                  (const uint8_t *)bstr_ptr(tx->request_method),
-                                  bstr_len(tx->request_method),
-                                  flags);
- end:
-    return cnt;
+    return PrefilterAppendTxEngine(sgh, PrefilterTxMethod,
+        ALPROTO_HTTP, STREAM_TOSERVER, HTP_REQUEST_LINE+1,
+        mpm_ctx, NULL, "http_method");
 }
 
 /**
@@ -38,6 +38,7 @@
 #include "detect-engine.h"
 #include "detect-engine-hrhd.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -69,6 +70,7 @@
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpRawHeaderPatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *raw_headers, const uint32_t raw_headers_len,
         const uint8_t flags)
 {
@@ -76,58 +78,87 @@ static inline uint32_t HttpRawHeaderPatternSearch(DetectEngineThreadCtx *det_ctx
 
     uint32_t ret = 0;
 
-    if (flags & STREAM_TOSERVER) {
-        DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hrhd_ctx_ts == NULL);
-
-        if (raw_headers_len >= det_ctx->sgh->mpm_hrhd_ctx_ts->minlen) {
-            ret = mpm_table[det_ctx->sgh->mpm_hrhd_ctx_ts->mpm_type].
-                Search(det_ctx->sgh->mpm_hrhd_ctx_ts, &det_ctx->mtcu,
-                        &det_ctx->pmq, raw_headers, raw_headers_len);
-        }
-    } else {
-        DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hrhd_ctx_tc == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-        if (raw_headers_len >= det_ctx->sgh->mpm_hrhd_ctx_tc->minlen) {
-            ret = mpm_table[det_ctx->sgh->mpm_hrhd_ctx_tc->mpm_type].
-                Search(det_ctx->sgh->mpm_hrhd_ctx_tc, &det_ctx->mtcu,
-                        &det_ctx->pmq, raw_headers, raw_headers_len);
-        }
+    if (raw_headers_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
+                    &det_ctx->pmq, raw_headers, raw_headers_len);
     }
 
     SCReturnUInt(ret);
 }
 
-int DetectEngineRunHttpRawHeaderMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                    HtpState *htp_state, uint8_t flags,
-                                    void *txv, uint64_t idx)
+/** \brief HTTP Raw Header Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxRequestHeadersRaw(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
     SCEnter();
 
-    uint32_t cnt = 0;
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
+    htp_tx_t *tx = (htp_tx_t *)txv;
+    HtpTxUserData *tx_ud = htp_tx_get_user_data(tx);
 
+    if (tx_ud == NULL || tx_ud->request_headers_raw == NULL)
+        return;
+
+    HttpRawHeaderPatternSearch(det_ctx, mpm_ctx,
+                               tx_ud->request_headers_raw,
+                               tx_ud->request_headers_raw_len,
+                               flags);
+}
+
+int PrefilterTxRequestHeadersRawRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxRequestHeadersRaw,
+        ALPROTO_HTTP, STREAM_TOSERVER, HTP_REQUEST_HEADERS+1,
+        mpm_ctx, NULL, "http_raw_header");
+}
+
+/** \brief HTTP Raw Header Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxResponseHeadersRaw(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
+{
+    SCEnter();
+
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
     htp_tx_t *tx = (htp_tx_t *)txv;
     HtpTxUserData *tx_ud = htp_tx_get_user_data(tx);
-    if (tx_ud == NULL) {
-        SCReturnInt(0);
-    }
 
-    if (flags & STREAM_TOSERVER) {
-        if (tx_ud->request_headers_raw != NULL) {
-            cnt = HttpRawHeaderPatternSearch(det_ctx,
-                                             tx_ud->request_headers_raw,
-                                             tx_ud->request_headers_raw_len,
-                                             flags);
-        }
-    } else {
-        if (tx_ud->response_headers_raw != NULL) {
-            cnt = HttpRawHeaderPatternSearch(det_ctx,
-                                              tx_ud->response_headers_raw,
-                                              tx_ud->response_headers_raw_len,
-                                              flags);
-        }
-    }
+    if (tx_ud == NULL || tx_ud->response_headers_raw == NULL)
+        return;
+
+    HttpRawHeaderPatternSearch(det_ctx, mpm_ctx,
+                               tx_ud->response_headers_raw,
+                               tx_ud->response_headers_raw_len,
+                               flags);
+}
+
+int PrefilterTxResponseHeadersRawRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
 
-    SCReturnInt(cnt);
+    return PrefilterAppendTxEngine(sgh, PrefilterTxResponseHeadersRaw,
+        ALPROTO_HTTP, STREAM_TOCLIENT, HTP_RESPONSE_HEADERS+1,
+        mpm_ctx, NULL, "http_raw_header");
 }
 
 /**
@@ -1904,7 +1935,12 @@ static int DetectEngineHttpRawHeaderTest18(void)
 
     /* start the search phase */
     det_ctx->sgh = SigMatchSignaturesGetSgh(de_ctx, det_ctx, p);
-    uint32_t r = HttpRawHeaderPatternSearch(det_ctx, http_buf, http_len, STREAM_TOSERVER);
+    const PrefilterEngine *engine = PrefilterFindEngine(det_ctx->sgh->tx_engines, "http_raw_header");
+    if (engine == NULL) {
+        printf("no http_raw_header prefilter engine: ");
+        goto end;
+    }
+    uint32_t r = HttpRawHeaderPatternSearch(det_ctx, engine->pectx, http_buf, http_len, STREAM_TOSERVER);
     if (r < 1) {
         printf("expected result >= 1, got %"PRIu32": ", r);
         goto end;
@@ -1979,7 +2015,12 @@ static int DetectEngineHttpRawHeaderTest19(void)
 
     /* start the search phase */
     det_ctx->sgh = SigMatchSignaturesGetSgh(de_ctx, det_ctx, p);
-    uint32_t r = HttpRawHeaderPatternSearch(det_ctx, http_buf, http_len, STREAM_TOSERVER);
+    const PrefilterEngine *engine = PrefilterFindEngine(det_ctx->sgh->tx_engines, "http_raw_header");
+    if (engine == NULL) {
+        printf("no http_raw_header prefilter engine: ");
+        goto end;
+    }
+    uint32_t r = HttpRawHeaderPatternSearch(det_ctx, engine->pectx, http_buf, http_len, STREAM_TOSERVER);
     if (r != 1) {
         printf("expected result 1, got %"PRIu32": ", r);
         goto end;
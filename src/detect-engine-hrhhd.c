@@ -38,6 +38,7 @@
 #include "detect.h"
 #include "detect-engine.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -71,6 +72,7 @@
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpHRHPatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *hrh, const uint32_t hrh_len,
         const uint8_t flags)
 {
@@ -79,39 +81,49 @@ static inline uint32_t HttpHRHPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOCLIENT);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hrhhd_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (hrh_len >= det_ctx->sgh->mpm_hrhhd_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_hrhhd_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_hrhhd_ctx_ts, &det_ctx->mtcu,
+    if (hrh_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, hrh, hrh_len);
     }
 
     SCReturnUInt(ret);
 }
 
-int DetectEngineRunHttpHRHMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                              HtpState *htp_state, uint8_t flags,
-                              void *txv, uint64_t idx)
+/** \brief HTTP Raw Hostname Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxHostnameRaw(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
-    uint32_t cnt = 0;
+    SCEnter();
+
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
     htp_tx_t *tx = (htp_tx_t *)txv;
+
     const uint8_t *hname = NULL;
     uint32_t hname_len = 0;
 
     if (tx->parsed_uri == NULL || tx->parsed_uri->hostname == NULL) {
         if (tx->request_headers == NULL)
-            goto end;
-        htp_header_t *h = NULL;
-        h = (htp_header_t *)htp_table_get_c(tx->request_headers, "Host");
-        if (h != NULL) {
-            hname = (const uint8_t *)bstr_ptr(h->value);
-            if (hname != NULL)
-                hname_len = bstr_len(h->value);
-        } else {
+            return;
+
+        htp_header_t *h = (htp_header_t *)htp_table_get_c(tx->request_headers, "Host");
+        if (h == NULL) {
             SCLogDebug("HTTP host header not present in this request");
-            goto end;
+            return;
         }
+        hname = (const uint8_t *)bstr_ptr(h->value);
+        if (hname != NULL)
+            hname_len = bstr_len(h->value);
     } else {
         hname = (uint8_t *)bstr_ptr(tx->parsed_uri->hostname);
         if (hname != NULL)
@@ -119,11 +131,17 @@ int DetectEngineRunHttpHRHMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
     }
 
     if (hname != NULL) {
-        cnt = HttpHRHPatternSearch(det_ctx, hname, hname_len, flags);
+        HttpHRHPatternSearch(det_ctx, mpm_ctx, hname, hname_len, flags);
     }
+}
 
- end:
-    return cnt;
+int PrefilterTxHostnameRawRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxHostnameRaw,
+        ALPROTO_HTTP, STREAM_TOSERVER, HTP_REQUEST_HEADERS,
+        mpm_ctx, NULL, "http_raw_host");
 }
 
 /**
@@ -37,6 +37,7 @@
 #include "detect-engine.h"
 #include "detect-engine-hrud.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -68,6 +69,7 @@
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpRawUriPatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *uri, const uint32_t uri_len,
         const uint8_t flags)
 {
@@ -76,11 +78,11 @@ static inline uint32_t HttpRawUriPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOCLIENT);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hrud_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (uri_len >= det_ctx->sgh->mpm_hrud_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_hrud_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_hrud_ctx_ts, &det_ctx->mtcu,
+    if (uri_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, uri, uri_len);
     }
 
@@ -92,22 +94,38 @@ static inline uint32_t HttpRawUriPatternSearch(DetectEngineThreadCtx *det_ctx,
  *
  * \retval cnt Number of matches reported by the mpm algo.
  */
-int DetectEngineRunHttpRawUriMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                 HtpState *htp_state, uint8_t flags,
-                                 void *txv, uint64_t idx)
+/** \brief HTTP Raw Uri Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxRawUri(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
     SCEnter();
 
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
     htp_tx_t *tx = (htp_tx_t *)txv;
-    uint32_t cnt = 0;
+
     if (tx->request_uri == NULL)
-        goto end;
+        return;
 
-    cnt = HttpRawUriPatternSearch(det_ctx,
-                                  (const uint8_t *)bstr_ptr(tx->request_uri),
-                                  bstr_len(tx->request_uri), flags);
-end:
-    SCReturnInt(cnt);
+    HttpRawUriPatternSearch(det_ctx, mpm_ctx,
+                            (const uint8_t *)bstr_ptr(tx->request_uri),
+                            bstr_len(tx->request_uri), flags);
+}
+
+int PrefilterTxRawUriRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxRawUri,
+        ALPROTO_HTTP, STREAM_TOSERVER, HTP_REQUEST_LINE+1,
+        mpm_ctx, NULL, "http_raw_uri");
 }
 
 /**
@@ -2262,7 +2280,12 @@ static int DetectEngineHttpRawUriTest17(void)
 
     /* start the search phase */
     det_ctx->sgh = SigMatchSignaturesGetSgh(de_ctx, det_ctx, p1);
-    uint32_t r = HttpRawUriPatternSearch(det_ctx, http1_buf, http1_len, STREAM_TOSERVER);
+    const PrefilterEngine *engine = PrefilterFindEngine(det_ctx->sgh->tx_engines, "http_raw_uri");
+    if (engine == NULL) {
+        printf("no http_raw_uri prefilter engine: ");
+        goto end;
+    }
+    uint32_t r = HttpRawUriPatternSearch(det_ctx, engine->pectx, http1_buf, http1_len, STREAM_TOSERVER);
     if (r != 1) {
         printf("expected 1 result, got %"PRIu32": ", r);
         goto end;
@@ -2334,7 +2357,12 @@ static int DetectEngineHttpRawUriTest18(void)
 
     /* start the search phase */
     det_ctx->sgh = SigMatchSignaturesGetSgh(de_ctx, det_ctx, p1);
-    uint32_t r = HttpRawUriPatternSearch(det_ctx, http1_buf, http1_len, STREAM_TOSERVER);
+    const PrefilterEngine *engine = PrefilterFindEngine(det_ctx->sgh->tx_engines, "http_raw_uri");
+    if (engine == NULL) {
+        printf("no http_raw_uri prefilter engine: ");
+        goto end;
+    }
+    uint32_t r = HttpRawUriPatternSearch(det_ctx, engine->pectx, http1_buf, http1_len, STREAM_TOSERVER);
     if (r != 0) {
         printf("expected 0 result, got %"PRIu32": ", r);
         goto end;
@@ -2406,7 +2434,12 @@ static int DetectEngineHttpRawUriTest19(void)
 
     /* start the search phase */
     det_ctx->sgh = SigMatchSignaturesGetSgh(de_ctx, det_ctx, p1);
-    uint32_t r = HttpRawUriPatternSearch(det_ctx, http1_buf, http1_len, STREAM_TOSERVER);
+    const PrefilterEngine *engine = PrefilterFindEngine(det_ctx->sgh->tx_engines, "http_raw_uri");
+    if (engine == NULL) {
+        printf("no http_raw_uri prefilter engine: ");
+        goto end;
+    }
+    uint32_t r = HttpRawUriPatternSearch(det_ctx, engine->pectx, http1_buf, http1_len, STREAM_TOSERVER);
     if (r != 0) {
         printf("expected 0 result, got %"PRIu32": ", r);
         goto end;
@@ -2478,7 +2511,12 @@ static int DetectEngineHttpRawUriTest20(void)
 
     /* start the search phase */
     det_ctx->sgh = SigMatchSignaturesGetSgh(de_ctx, det_ctx, p1);
-    uint32_t r = HttpRawUriPatternSearch(det_ctx, http1_buf, http1_len, STREAM_TOSERVER);
+    const PrefilterEngine *engine = PrefilterFindEngine(det_ctx->sgh->tx_engines, "http_raw_uri");
+    if (engine == NULL) {
+        printf("no http_raw_uri prefilter engine: ");
+        goto end;
+    }
+    uint32_t r = HttpRawUriPatternSearch(det_ctx, engine->pectx, http1_buf, http1_len, STREAM_TOSERVER);
     if (r < 1) {
         printf("expected result >= 1, got %"PRIu32": ", r);
         goto end;
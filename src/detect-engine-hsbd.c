@@ -39,6 +39,8 @@
 #include "detect.h"
 #include "detect-engine.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
+#include "detect-engine-mpm-stream.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -227,6 +229,7 @@ static const uint8_t *DetectEngineHSBDGetBufferForTX(htp_tx_t *tx, uint64_t tx_i
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpServerBodyPatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *body, const uint32_t body_len,
         const uint8_t flags)
 {
@@ -235,38 +238,58 @@ static inline uint32_t HttpServerBodyPatternSearch(DetectEngineThreadCtx *det_ct
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(!(flags & STREAM_TOCLIENT));
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hsbd_ctx_tc == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (body_len >= det_ctx->sgh->mpm_hsbd_ctx_tc->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_hsbd_ctx_tc->mpm_type].
-            Search(det_ctx->sgh->mpm_hsbd_ctx_tc, &det_ctx->mtcu,
+    if (body_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, body, body_len);
     }
 
     SCReturnUInt(ret);
 }
 
-int DetectEngineRunHttpServerBodyMpm(DetectEngineCtx *de_ctx,
-                                     DetectEngineThreadCtx *det_ctx, Flow *f,
-                                     HtpState *htp_state, uint8_t flags,
-                                     void *tx, uint64_t idx)
+/** \brief HTTP Response Body Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxHttpResponseBody(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
-    uint32_t cnt = 0;
+    SCEnter();
+
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
+    HtpState *htp_state = f->alstate;
     uint32_t buffer_len = 0;
     uint32_t stream_start_offset = 0;
-    const uint8_t *buffer = DetectEngineHSBDGetBufferForTX(tx, idx,
-                                                     de_ctx, det_ctx,
+    const uint8_t *buffer = DetectEngineHSBDGetBufferForTX(txv, idx,
+                                                     det_ctx->de_ctx, det_ctx,
                                                      f, htp_state,
                                                      flags,
                                                      &buffer_len,
                                                      &stream_start_offset);
     if (buffer_len == 0)
-        goto end;
+        return;
 
-    cnt = HttpServerBodyPatternSearch(det_ctx, (uint8_t *)buffer, buffer_len, flags);
+    if (DetectMpmStreamSearchBody(det_ctx, f, mpm_ctx, idx, buffer,
+                buffer_len, stream_start_offset, flags))
+        return;
 
- end:
-    return cnt;
+    HttpServerBodyPatternSearch(det_ctx, mpm_ctx, buffer, buffer_len, flags);
+}
+
+int PrefilterTxHttpResponseBodyRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxHttpResponseBody,
+        ALPROTO_HTTP, STREAM_TOCLIENT, HTP_RESPONSE_BODY,
+        mpm_ctx, NULL, "file_data");
 }
 
 int DetectEngineInspectHttpServerBody(ThreadVars *tv,
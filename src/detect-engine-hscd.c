@@ -34,6 +34,7 @@
 #include "detect.h"
 #include "detect-engine.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-engine-hscd.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
@@ -65,6 +66,7 @@
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpStatCodePatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *stat_code, const uint32_t stat_code_len,
         const uint8_t flags)
 {
@@ -73,11 +75,11 @@ static inline uint32_t HttpStatCodePatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(!(flags & STREAM_TOCLIENT));
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_hscd_ctx_tc == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (stat_code_len >= det_ctx->sgh->mpm_hscd_ctx_tc->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_hscd_ctx_tc->mpm_type].
-            Search(det_ctx->sgh->mpm_hscd_ctx_tc, &det_ctx->mtcu,
+    if (stat_code_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, stat_code, stat_code_len);
     }
 
@@ -89,22 +91,38 @@ static inline uint32_t HttpStatCodePatternSearch(DetectEngineThreadCtx *det_ctx,
  *
  * \retval cnt Number of matches reported by the mpm algo.
  */
-int DetectEngineRunHttpStatCodeMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                   HtpState *htp_state, uint8_t flags,
-                                   void *txv, uint64_t idx)
+/** \brief HTTP Status Code Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxHttpStatCode(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
     SCEnter();
 
-    uint32_t cnt = 0;
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
     htp_tx_t *tx = (htp_tx_t *)txv;
+
     if (tx->response_status == NULL)
-        goto end;
+        return;
 
-    cnt = HttpStatCodePatternSearch(det_ctx,
-                                    (const uint8_t *)bstr_ptr(tx->response_status),
-                                    bstr_len(tx->response_status), flags);
-end:
-    SCReturnInt(cnt);
+    HttpStatCodePatternSearch(det_ctx, mpm_ctx,
+                              (const uint8_t *)bstr_ptr(tx->response_status),
+                              bstr_len(tx->response_status), flags);
+}
+
+int PrefilterTxHttpStatCodeRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxHttpStatCode,
+        ALPROTO_HTTP, STREAM_TOCLIENT, HTP_RESPONSE_LINE+1,
+        mpm_ctx, NULL, "http_stat_code");
 }
 
 /**
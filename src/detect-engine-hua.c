@@ -37,6 +37,7 @@
 #include "detect.h"
 #include "detect-engine.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -69,6 +70,7 @@
  *  \retval ret Number of matches.
  */
 static inline uint32_t HttpUAPatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *ua, const uint32_t ua_len,
         const uint8_t flags)
 {
@@ -77,37 +79,56 @@ static inline uint32_t HttpUAPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOCLIENT);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_huad_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (ua_len >= det_ctx->sgh->mpm_huad_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_huad_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_huad_ctx_ts, &det_ctx->mtcu,
+    if (ua_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, ua, ua_len);
     }
 
     SCReturnUInt(ret);
 }
 
-int DetectEngineRunHttpUAMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                             HtpState *htp_state, uint8_t flags,
-                             void *txv, uint64_t idx)
+/** \brief HTTP User-Agent Mpm prefilter callback
+ *
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect
+ *  \param pectx inspection context
+ */
+static void PrefilterTxUA(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
-    uint32_t cnt = 0;
+    SCEnter();
+
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
     htp_tx_t *tx = (htp_tx_t *)txv;
+
     if (tx->request_headers == NULL)
-        goto end;
+        return;
 
     htp_header_t *h = (htp_header_t *)htp_table_get_c(tx->request_headers,
                                                       "User-Agent");
     if (h == NULL) {
         SCLogDebug("HTTP user agent header not present in this request");
-        goto end;
+        return;
     }
-    cnt = HttpUAPatternSearch(det_ctx,
-                              (const uint8_t *)bstr_ptr(h->value),
-                              bstr_len(h->value), flags);
- end:
-    return cnt;
+
+    HttpUAPatternSearch(det_ctx, mpm_ctx,
+                        (const uint8_t *)bstr_ptr(h->value),
+                        bstr_len(h->value), flags);
+}
+
+int PrefilterTxUARegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxUA,
+        ALPROTO_HTTP, STREAM_TOSERVER, HTP_REQUEST_HEADERS,
+        mpm_ctx, NULL, "http_user_agent");
 }
 
 /**
@@ -31,9 +31,7 @@ int DetectEngineInspectHttpUA(ThreadVars *tv,
                               Signature *s, Flow *f, uint8_t flags,
                               void *alstate,
                               void *tx, uint64_t tx_id);
-int DetectEngineRunHttpUAMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                             HtpState *htp_state, uint8_t flags,
-                             void *tx, uint64_t idx);
+int PrefilterTxUARegister(SigGroupHead *sgh, MpmCtx *mpm_ctx);
 void DetectEngineHttpUARegisterTests(void);
 
 #endif /* __DETECT_ENGINE_HUA_H__ */
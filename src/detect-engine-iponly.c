@@ -567,6 +567,8 @@ static void SigNumArrayFree(void *tmp)
 
     if (sna->array != NULL)
         SCFree(sna->array);
+    if (sna->sigs != NULL)
+        SCFree(sna->sigs);
 
     SCFree(sna);
 }
@@ -861,25 +863,6 @@ void IPOnlyInit(DetectEngineCtx *de_ctx, DetectEngineIPOnlyCtx *io_ctx)
                                                   SigNumArrayPrint);
 }
 
-/**
- * \brief Setup the IP Only thread detection engine context
- *
- * \param de_ctx Pointer to the current detection engine
- * \param io_ctx Pointer to the current ip only thread detection engine
- */
-void DetectEngineIPOnlyThreadInit(DetectEngineCtx *de_ctx,
-                                  DetectEngineIPOnlyThreadCtx *io_tctx)
-{
-    /* initialize the signature bitarray */
-    io_tctx->sig_match_size = de_ctx->io_ctx.max_idx / 8 + 1;
-    io_tctx->sig_match_array = SCMalloc(io_tctx->sig_match_size);
-    if (io_tctx->sig_match_array == NULL) {
-        exit(EXIT_FAILURE);
-    }
-
-    memset(io_tctx->sig_match_array, 0, io_tctx->sig_match_size);
-}
-
 /**
  * \brief Print stats of the IP Only engine
  *
@@ -924,17 +907,6 @@ void IPOnlyDeinit(DetectEngineCtx *de_ctx, DetectEngineIPOnlyCtx *io_ctx)
     io_ctx->sig_init_array = NULL;
 }
 
-/**
- * \brief Deinitialize the IP Only thread detection engine context
- *
- * \param de_ctx Pointer to the current detection engine
- * \param io_ctx Pointer to the current ip only detection engine
- */
-void DetectEngineIPOnlyThreadDeinit(DetectEngineIPOnlyThreadCtx *io_tctx)
-{
-    SCFree(io_tctx->sig_match_array);
-}
-
 static inline
 int IPOnlyMatchCompatSMs(ThreadVars *tv,
                          DetectEngineThreadCtx *det_ctx,
@@ -961,16 +933,21 @@ int IPOnlyMatchCompatSMs(ThreadVars *tv,
 /**
  * \brief Match a packet against the IP Only detection engine contexts
  *
+ * The signatures of the src and dst address are intersected by walking
+ * the sorted list of the address with the least signatures and checking
+ * them against the bit array of the other address. So the cost depends
+ * on the number of signatures that apply to the addresses of the packet,
+ * not on the total number of ip-only signatures.
+ *
  * \param de_ctx Pointer to the current detection engine
  * \param io_ctx Pointer to the current ip only detection engine
- * \param io_ctx Pointer to the current ip only thread detection engine
  * \param p Pointer to the Packet to match against
  */
 void IPOnlyMatchPacket(ThreadVars *tv,
-                       DetectEngineCtx *de_ctx,
+                       const DetectEngineCtx *de_ctx,
                        DetectEngineThreadCtx *det_ctx,
-                       DetectEngineIPOnlyCtx *io_ctx,
-                       DetectEngineIPOnlyThreadCtx *io_tctx, Packet *p)
+                       const DetectEngineIPOnlyCtx *io_ctx,
+                       Packet *p)
 {
     SigNumArray *src = NULL;
     SigNumArray *dst = NULL;
@@ -998,105 +975,164 @@ void IPOnlyMatchPacket(ThreadVars *tv,
     if (src == NULL || dst == NULL)
         return;
 
-    uint32_t u;
-    for (u = 0; u < src->size; u++) {
-        SCLogDebug("And %"PRIu8" & %"PRIu8, src->array[u], dst->array[u]);
+    /* walk the shortest list, check against the other's bit array */
+    const SigNumArray *list = src;
+    const SigNumArray *bits = dst;
+    if (dst->sigs_cnt < src->sigs_cnt) {
+        list = dst;
+        bits = src;
+    }
 
-        /* The final results will be at io_tctx */
-        io_tctx->sig_match_array[u] = dst->array[u] & src->array[u];
+    uint32_t u;
+    for (u = 0; u < list->sigs_cnt; u++) {
+        SigIntId num = list->sigs[u];
+        if (!(bits->array[num / 8] & (1 << (num % 8))))
+            continue;
 
         /* We have to move the logic of the signature checking
          * to the main detect loop, in order to apply the
          * priority of actions (pass, drop, reject, alert) */
-        if (io_tctx->sig_match_array[u] != 0) {
-            /* We have a match :) Let's see from which signum's */
-            uint8_t bitarray = io_tctx->sig_match_array[u];
-            uint8_t i = 0;
-
-            for (; i < 8; i++, bitarray = bitarray >> 1) {
-                if (bitarray & 0x01) {
-                    Signature *s = de_ctx->sig_array[u * 8 + i];
-
-                    if ((s->proto.flags & DETECT_PROTO_IPV4) && !PKT_IS_IPV4(p)) {
-                        SCLogDebug("ip version didn't match");
-                        continue;
-                    }
-                    if ((s->proto.flags & DETECT_PROTO_IPV6) && !PKT_IS_IPV6(p)) {
-                        SCLogDebug("ip version didn't match");
-                        continue;
-                    }
+        Signature *s = de_ctx->sig_array[num];
 
-                    if (DetectProtoContainsProto(&s->proto, IP_GET_IPPROTO(p)) == 0) {
-                        SCLogDebug("proto didn't match");
-                        continue;
-                    }
+        if ((s->proto.flags & DETECT_PROTO_IPV4) && !PKT_IS_IPV4(p)) {
+            SCLogDebug("ip version didn't match");
+            continue;
+        }
+        if ((s->proto.flags & DETECT_PROTO_IPV6) && !PKT_IS_IPV6(p)) {
+            SCLogDebug("ip version didn't match");
+            continue;
+        }
 
-                    /* check the source & dst port in the sig */
-                    if (p->proto == IPPROTO_TCP || p->proto == IPPROTO_UDP || p->proto == IPPROTO_SCTP) {
-                        if (!(s->flags & SIG_FLAG_DP_ANY)) {
-                            if (p->flags & PKT_IS_FRAGMENT)
-                                continue;
-
-                            DetectPort *dport = DetectPortLookupGroup(s->dp,p->dp);
-                            if (dport == NULL) {
-                                SCLogDebug("dport didn't match.");
-                                continue;
-                            }
-                        }
-                        if (!(s->flags & SIG_FLAG_SP_ANY)) {
-                            if (p->flags & PKT_IS_FRAGMENT)
-                                continue;
-
-                            DetectPort *sport = DetectPortLookupGroup(s->sp,p->sp);
-                            if (sport == NULL) {
-                                SCLogDebug("sport didn't match.");
-                                continue;
-                            }
-                        }
-                    } else if ((s->flags & (SIG_FLAG_DP_ANY|SIG_FLAG_SP_ANY)) != (SIG_FLAG_DP_ANY|SIG_FLAG_SP_ANY)) {
-                        SCLogDebug("port-less protocol and sig needs ports");
-                        continue;
-                    }
+        if (DetectProtoContainsProto(&s->proto, IP_GET_IPPROTO(p)) == 0) {
+            SCLogDebug("proto didn't match");
+            continue;
+        }
 
-                    if (!IPOnlyMatchCompatSMs(tv, det_ctx, s, p)) {
-                        continue;
-                    }
+        /* check the source & dst port in the sig */
+        if (p->proto == IPPROTO_TCP || p->proto == IPPROTO_UDP || p->proto == IPPROTO_SCTP) {
+            if (!(s->flags & SIG_FLAG_DP_ANY)) {
+                if (p->flags & PKT_IS_FRAGMENT)
+                    continue;
 
-                    SCLogDebug("Signum %"PRIu16" match (sid: %"PRIu16", msg: %s)",
-                               u * 8 + i, s->id, s->msg);
-
-                    if (s->sm_arrays[DETECT_SM_LIST_POSTMATCH] != NULL) {
-                        KEYWORD_PROFILING_SET_LIST(det_ctx, DETECT_SM_LIST_POSTMATCH);
-                        SigMatchData *smd = s->sm_arrays[DETECT_SM_LIST_POSTMATCH];
-
-                        SCLogDebug("running match functions, sm %p", smd);
-
-                        if (smd != NULL) {
-                            while (1) {
-                                KEYWORD_PROFILING_START;
-                                (void)sigmatch_table[smd->type].Match(tv, det_ctx, p, s, smd->ctx);
-                                KEYWORD_PROFILING_END(det_ctx, smd->type, 1);
-                                if (smd->is_last)
-                                    break;
-                                smd++;
-                            }
-                        }
-                    }
-                    if (!(s->flags & SIG_FLAG_NOALERT)) {
-                        if (s->action & ACTION_DROP)
-                            PacketAlertAppend(det_ctx, s, p, 0, PACKET_ALERT_FLAG_DROP_FLOW);
-                        else
-                            PacketAlertAppend(det_ctx, s, p, 0, 0);
-                    } else {
-                        /* apply actions for noalert/rule suppressed as well */
-                        DetectSignatureApplyActions(p, s);
-                    }
+                DetectPort *dport = DetectPortLookupGroup(s->dp,p->dp);
+                if (dport == NULL) {
+                    SCLogDebug("dport didn't match.");
+                    continue;
+                }
+            }
+            if (!(s->flags & SIG_FLAG_SP_ANY)) {
+                if (p->flags & PKT_IS_FRAGMENT)
+                    continue;
+
+                DetectPort *sport = DetectPortLookupGroup(s->sp,p->sp);
+                if (sport == NULL) {
+                    SCLogDebug("sport didn't match.");
+                    continue;
+                }
+            }
+        } else if ((s->flags & (SIG_FLAG_DP_ANY|SIG_FLAG_SP_ANY)) != (SIG_FLAG_DP_ANY|SIG_FLAG_SP_ANY)) {
+            SCLogDebug("port-less protocol and sig needs ports");
+            continue;
+        }
+
+        if (!IPOnlyMatchCompatSMs(tv, det_ctx, s, p)) {
+            continue;
+        }
+
+        SCLogDebug("Signum %"PRIu32" match (sid: %"PRIu32", msg: %s)",
+                   num, s->id, s->msg);
+
+        if (s->sm_arrays[DETECT_SM_LIST_POSTMATCH] != NULL) {
+            KEYWORD_PROFILING_SET_LIST(det_ctx, DETECT_SM_LIST_POSTMATCH);
+            SigMatchData *smd = s->sm_arrays[DETECT_SM_LIST_POSTMATCH];
+
+            SCLogDebug("running match functions, sm %p", smd);
+
+            if (smd != NULL) {
+                while (1) {
+                    KEYWORD_PROFILING_START;
+                    (void)sigmatch_table[smd->type].Match(tv, det_ctx, p, s, smd->ctx);
+                    KEYWORD_PROFILING_END(det_ctx, smd->type, 1);
+                    if (smd->is_last)
+                        break;
+                    smd++;
                 }
             }
         }
+        if (!(s->flags & SIG_FLAG_NOALERT)) {
+            if (s->action & ACTION_DROP)
+                PacketAlertAppend(det_ctx, s, p, 0, PACKET_ALERT_FLAG_DROP_FLOW);
+            else
+                PacketAlertAppend(det_ctx, s, p, 0, 0);
+        } else {
+            /* apply actions for noalert/rule suppressed as well */
+            DetectSignatureApplyActions(p, s);
+        }
     }
 }
 
+/**
+ * \internal
+ * \brief Build the sorted sig num list of a SigNumArray from its bit array
+ */
+static void SigNumArrayBuildList(SigNumArray *sna)
+{
+    uint32_t cnt = 0;
+    uint32_t u;
+
+    if (sna->sigs != NULL) {
+        SCFree(sna->sigs);
+        sna->sigs = NULL;
+    }
+    sna->sigs_cnt = 0;
+
+    for (u = 0; u < sna->size; u++) {
+        cnt += __builtin_popcount(sna->array[u]);
+    }
+    if (cnt == 0)
+        return;
+
+    sna->sigs = SCMalloc(cnt * sizeof(SigIntId));
+    if (sna->sigs == NULL) {
+        SCLogError(SC_ERR_FATAL, "Fatal error encountered in SigNumArrayBuildList. Exiting...");
+        exit(EXIT_FAILURE);
+    }
+
+    for (u = 0; u < sna->size; u++) {
+        uint8_t bitarray = sna->array[u];
+        while (bitarray != 0) {
+            uint8_t i = __builtin_ctz(bitarray);
+            sna->sigs[sna->sigs_cnt++] = u * 8 + i;
+            bitarray &= bitarray - 1;
+        }
+    }
+}
+
+/**
+ * \internal
+ * \brief Build the sig num lists of all SigNumArrays in a radix (sub)tree
+ */
+static void IPOnlyBuildListsRadixNode(SCRadixNode *node)
+{
+    while (node != NULL) {
+        if (node->prefix != NULL) {
+            SCRadixUserData *ud = node->prefix->user_data;
+            for ( ; ud != NULL; ud = ud->next) {
+                if (ud->user != NULL)
+                    SigNumArrayBuildList((SigNumArray *)ud->user);
+            }
+        }
+        IPOnlyBuildListsRadixNode(node->left);
+        node = node->right;
+    }
+}
+
+static void IPOnlyBuildLists(SCRadixTree *tree)
+{
+    if (tree != NULL)
+        IPOnlyBuildListsRadixNode(tree->head);
+}
+
 /**
  * \brief Build the radix trees from the lists of parsed adresses in CIDR format
  *        the result should be 4 radix trees: src/dst ipv4 and src/dst ipv6
@@ -1501,6 +1537,11 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx)
         SCFree(tmpaux);
     }
 
+    IPOnlyBuildLists((de_ctx->io_ctx).tree_ipv4src);
+    IPOnlyBuildLists((de_ctx->io_ctx).tree_ipv4dst);
+    IPOnlyBuildLists((de_ctx->io_ctx).tree_ipv6src);
+    IPOnlyBuildLists((de_ctx->io_ctx).tree_ipv6dst);
+
     /* print all the trees: for debuggin it might print too much info
     SCLogDebug("Radix tree src ipv4:");
     SCRadixPrintTree((de_ctx->io_ctx).tree_ipv4src);
@@ -2245,6 +2286,71 @@ int IPOnlyTestSig17(void)
     return result;
 }
 
+/**
+ * \test "blacklist" style rules: the sig num lists of the tree entries only
+ *       hold the rules for the address, and matching uses the shortest one
+ */
+static int IPOnlyTestSig18(void)
+{
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    char sig[128];
+    void *user_data = NULL;
+    struct in_addr a;
+    int i;
+
+    memset(&th_v, 0, sizeof(th_v));
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    for (i = 0; i < 64; i++) {
+        snprintf(sig, sizeof(sig),
+                "alert ip 10.0.0.%d any -> any any (sid:%d;)", i + 1, i + 1);
+        FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, sig));
+    }
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx,
+                "alert ip any any -> 192.168.0.0/16 any (sid:100;)"));
+    SigGroupBuild(de_ctx);
+
+    FAIL_IF(inet_pton(AF_INET, "10.0.0.5", &a) != 1);
+    (void)SCRadixFindKeyIPV4BestMatch((uint8_t *)&a.s_addr,
+            de_ctx->io_ctx.tree_ipv4src, &user_data);
+    FAIL_IF_NULL(user_data);
+    /* sid 5 and sid 100 */
+    FAIL_IF(((SigNumArray *)user_data)->sigs_cnt != 2);
+
+    user_data = NULL;
+    FAIL_IF(inet_pton(AF_INET, "192.168.1.1", &a) != 1);
+    (void)SCRadixFindKeyIPV4BestMatch((uint8_t *)&a.s_addr,
+            de_ctx->io_ctx.tree_ipv4dst, &user_data);
+    FAIL_IF_NULL(user_data);
+    FAIL_IF(((SigNumArray *)user_data)->sigs_cnt != 65);
+
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    Packet *p = UTHBuildPacketSrcDst((uint8_t *)"Hi all!", 7, IPPROTO_TCP,
+            "10.0.0.5", "192.168.1.1");
+    FAIL_IF_NULL(p);
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+    FAIL_IF_NOT(PacketAlertCheck(p, 5));
+    FAIL_IF_NOT(PacketAlertCheck(p, 100));
+    FAIL_IF(PacketAlertCheck(p, 6));
+    UTHFreePackets(&p, 1);
+
+    p = UTHBuildPacketSrcDst((uint8_t *)"Hi all!", 7, IPPROTO_TCP,
+            "10.0.1.5", "192.169.1.1");
+    FAIL_IF_NULL(p);
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+    FAIL_IF(p->alerts.cnt != 0);
+    UTHFreePackets(&p, 1);
+
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void IPOnlyRegisterTests(void)
@@ -2280,6 +2386,7 @@ void IPOnlyRegisterTests(void)
     UtRegisterTest("IPOnlyTestSig16", IPOnlyTestSig16);
 
     UtRegisterTest("IPOnlyTestSig17", IPOnlyTestSig17);
+    UtRegisterTest("IPOnlyTestSig18", IPOnlyTestSig18);
 #endif
 
     return;
@@ -0,0 +1,659 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Streaming mpm for the reassembled stream and the http bodies.
+ *
+ * The stream chunks and http body buffers given to the mpm overlap: each
+ * time data is added the inspection window is searched again, including
+ * the data already searched for the previous packets. With
+ * detect.mpm-streaming enabled the mpm state is kept in the flow storage
+ * per direction, and only the data not searched before is searched,
+ * continuing from the state left by the previous search. See
+ * MpmStreamSearch() for how the backends carry the state over.
+ *
+ * A state belongs to the mpm ctx and detect engine it was used with, so
+ * another rule group or a rule reload starts over. Body states also
+ * belong to a tx, stream states to the tcp stream by its isn. Data that
+ * doesn't follow the data searched before starts over as well.
+ *
+ * A rule found in data searched before can't be found again in a later
+ * search, but it can still match on the data in the inspection window,
+ * e.g. when a flowbit it needs is set later. So the rules found stay
+ * candidates for as long as the data they were found in is part of the
+ * inspection window: the stream chunk or the body buffer.
+ *
+ * The memory of the states is limited by detect.mpm-streaming-memcap. A
+ * flow that can't get its state within the memcap has its buffers
+ * searched in full, the same as with streaming disabled.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+
+#include "detect.h"
+#include "detect-engine.h"
+#include "detect-engine-mpm-stream.h"
+
+#include "flow.h"
+#include "flow-storage.h"
+#include "flow-util.h"
+#include "stream-tcp-private.h"
+
+#include "conf.h"
+#include "util-debug.h"
+#include "util-misc.h"
+#include "util-mpm.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+enum {
+    DETECT_MPM_STREAM_RAW = 0,
+    DETECT_MPM_STREAM_BODY,
+    DETECT_MPM_STREAM_MAX,
+};
+
+typedef struct DetectMpmStream_ {
+    MpmStreamState state;
+
+    /** mpm ctx and detect engine id the state was used with */
+    const MpmCtx *mpm_ctx;
+    uint32_t de_ctx_id;
+    int active;
+
+    /** body: tx id and body offset of the next byte to search.
+     *  stream: isn and sequence number of the next byte to search. */
+    uint64_t id;
+    uint64_t offset;
+
+    /** rules found in the inspection window and the end of the data
+     *  they were found in: the sequence number of the end of the chunk
+     *  for the stream, the body offset of the end of the buffer for
+     *  the bodies. */
+    SigIntId *sids;
+    uint64_t *sids_end;
+    uint32_t sids_cnt;
+    uint32_t sids_size;
+} DetectMpmStream;
+
+typedef struct DetectMpmStreamFlow_ {
+    /** toserver and toclient states */
+    DetectMpmStream s[2][DETECT_MPM_STREAM_MAX];
+} DetectMpmStreamFlow;
+
+/** flow storage id of the streaming mpm states */
+static int detect_mpm_stream_id = -1;
+
+#define DETECT_MPM_STREAM_DEFAULT_MEMCAP    (32 * 1024 * 1024)
+
+/** memory used by the states of all flows and its limit */
+static SC_ATOMIC_DECLARE(uint64_t, detect_mpm_stream_memuse);
+static uint64_t detect_mpm_stream_memcap = DETECT_MPM_STREAM_DEFAULT_MEMCAP;
+
+/** size of a sid and its end in the sid arrays */
+#define DETECT_MPM_STREAM_SID_SIZE  (sizeof(SigIntId) + sizeof(uint64_t))
+
+static inline int DetectMpmStreamCheckMemcap(const uint64_t size)
+{
+    return (SC_ATOMIC_GET(detect_mpm_stream_memuse) + size <=
+            detect_mpm_stream_memcap);
+}
+
+static inline void DetectMpmStreamIncrMemuse(const uint64_t size)
+{
+    (void)SC_ATOMIC_ADD(detect_mpm_stream_memuse, size);
+}
+
+static inline void DetectMpmStreamDecrMemuse(const uint64_t size)
+{
+    (void)SC_ATOMIC_SUB(detect_mpm_stream_memuse, size);
+}
+
+static void DetectMpmStreamFlowFree(void *x)
+{
+    DetectMpmStreamFlow *sf = (DetectMpmStreamFlow *)x;
+    if (sf == NULL)
+        return;
+
+    int d, t;
+    for (d = 0; d < 2; d++) {
+        for (t = 0; t < DETECT_MPM_STREAM_MAX; t++) {
+            DetectMpmStream *ds = &sf->s[d][t];
+            DetectMpmStreamDecrMemuse(ds->state.tail_size +
+                    (uint64_t)ds->sids_size * DETECT_MPM_STREAM_SID_SIZE);
+            MpmStreamStateFree(&ds->state);
+            if (ds->sids != NULL)
+                SCFree(ds->sids);
+            if (ds->sids_end != NULL)
+                SCFree(ds->sids_end);
+        }
+    }
+    SCFree(sf);
+    DetectMpmStreamDecrMemuse(sizeof(*sf));
+}
+
+/** \brief register the flow storage of the streaming mpm states. Must be
+ *         called before the storage is finalized. */
+void DetectMpmStreamRegister(void)
+{
+    detect_mpm_stream_id = FlowStorageRegister("mpm_stream", sizeof(void *),
+            NULL, DetectMpmStreamFlowFree);
+    if (detect_mpm_stream_id == -1) {
+        SCLogError(SC_ERR_FLOW_INIT, "Can't initiate flow storage for "
+                "the streaming mpm");
+        exit(EXIT_FAILURE);
+    }
+
+    SC_ATOMIC_INIT(detect_mpm_stream_memuse);
+
+    char *conf_val;
+    if (ConfGet("detect.mpm-streaming-memcap", &conf_val) == 1) {
+        if (ParseSizeStringU64(conf_val, &detect_mpm_stream_memcap) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
+                    "detect.mpm-streaming-memcap from conf file - %s. "
+                    "Killing engine", conf_val);
+            exit(EXIT_FAILURE);
+        }
+    }
+    SCLogDebug("streaming mpm memcap %"PRIu64, detect_mpm_stream_memcap);
+}
+
+static void DetectMpmStreamRestart(DetectMpmStream *ds, uint64_t id,
+                                   uint64_t offset)
+{
+    MpmStreamStateReset(&ds->state);
+    ds->id = id;
+    ds->offset = offset;
+    ds->active = 1;
+}
+
+/**
+ * \internal
+ * \brief get the state of a direction and buffer of the flow
+ *
+ * A state used with another mpm ctx or detect engine is reset.
+ *
+ * \retval ds state or NULL if streaming is disabled, the ctx can't be
+ *         searched as a stream, or on memcap or alloc failure
+ */
+static DetectMpmStream *DetectMpmStreamGet(DetectEngineThreadCtx *det_ctx,
+        Flow *f, const MpmCtx *mpm_ctx, const uint8_t flags, const int type)
+{
+    if (!det_ctx->de_ctx->mpm_streaming || detect_mpm_stream_id == -1 ||
+            f == NULL)
+        return NULL;
+
+    DetectMpmStreamFlow *sf = FlowGetStorageById(f, detect_mpm_stream_id);
+    if (sf == NULL) {
+        if (!DetectMpmStreamCheckMemcap(sizeof(*sf)))
+            return NULL;
+        sf = SCCalloc(1, sizeof(*sf));
+        if (unlikely(sf == NULL))
+            return NULL;
+        DetectMpmStreamIncrMemuse(sizeof(*sf));
+        FlowSetStorageById(f, detect_mpm_stream_id, sf);
+    }
+
+    DetectMpmStream *ds = &sf->s[(flags & STREAM_TOSERVER) ? 0 : 1][type];
+    if (ds->mpm_ctx != mpm_ctx || ds->de_ctx_id != det_ctx->de_ctx->id) {
+        MpmStreamStateReset(&ds->state);
+        ds->mpm_ctx = mpm_ctx;
+        ds->de_ctx_id = det_ctx->de_ctx->id;
+        ds->active = 0;
+        ds->sids_cnt = 0;
+    }
+
+    /* the caller searches in full, so start over next time */
+    const uint32_t old_size = ds->state.tail_size;
+    const uint32_t size = MpmStreamStateSize(mpm_ctx);
+    if (size > old_size && !DetectMpmStreamCheckMemcap(size - old_size)) {
+        ds->active = 0;
+        return NULL;
+    }
+    if (MpmStreamStateSetup(&ds->state, mpm_ctx) != 0) {
+        ds->active = 0;
+        return NULL;
+    }
+    DetectMpmStreamIncrMemuse(ds->state.tail_size - old_size);
+    return ds;
+}
+
+/** \internal
+ *  \brief remember a rule found in the data ending at 'end'
+ *
+ *  \retval 0 ok, -1 memcap or alloc failure
+ */
+static int DetectMpmStreamSidAdd(DetectMpmStream *ds, SigIntId sid,
+                                 uint64_t end)
+{
+    uint32_t i;
+    for (i = 0; i < ds->sids_cnt; i++) {
+        if (ds->sids[i] == sid) {
+            ds->sids_end[i] = end;
+            return 0;
+        }
+    }
+
+    if (ds->sids_cnt == ds->sids_size) {
+        uint32_t size = ds->sids_size ? ds->sids_size * 2 : 16;
+        const uint64_t grow = (uint64_t)(size - ds->sids_size) *
+            DETECT_MPM_STREAM_SID_SIZE;
+        if (!DetectMpmStreamCheckMemcap(grow))
+            return -1;
+        SigIntId *sids = SCRealloc(ds->sids, size * sizeof(SigIntId));
+        if (unlikely(sids == NULL))
+            return -1;
+        ds->sids = sids;
+        uint64_t *sids_end = SCRealloc(ds->sids_end, size * sizeof(uint64_t));
+        if (unlikely(sids_end == NULL))
+            return -1;
+        ds->sids_end = sids_end;
+        ds->sids_size = size;
+        DetectMpmStreamIncrMemuse(grow);
+    }
+    ds->sids[ds->sids_cnt] = sid;
+    ds->sids_end[ds->sids_cnt] = end;
+    ds->sids_cnt++;
+    return 0;
+}
+
+/** \internal
+ *  \brief forget the rules found in data ending before 'start', the
+ *         start of the inspection window
+ *
+ *  \param type stream ends are sequence numbers, body ends offsets
+ */
+static void DetectMpmStreamSidExpire(DetectMpmStream *ds, const int type,
+                                     uint64_t start)
+{
+    uint32_t i, cnt = 0;
+    for (i = 0; i < ds->sids_cnt; i++) {
+        int keep;
+        if (type == DETECT_MPM_STREAM_RAW)
+            keep = SEQ_GT((uint32_t)ds->sids_end[i], (uint32_t)start);
+        else
+            keep = (ds->sids_end[i] > start);
+        if (keep) {
+            ds->sids[cnt] = ds->sids[i];
+            ds->sids_end[cnt] = ds->sids_end[i];
+            cnt++;
+        }
+    }
+    ds->sids_cnt = cnt;
+}
+
+/** \internal
+ *  \brief search the new data and remember the rules found
+ *
+ *  \retval 0 ok, -1 a rule couldn't be remembered. It would be lost for
+ *          the next searches, so the caller has to deactivate the state to
+ *          have the next search start over from the start of its window.
+ */
+static int DetectMpmStreamSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+        DetectMpmStream *ds, const uint8_t *data, const uint32_t data_len,
+        const uint64_t end)
+{
+    const uint32_t cnt = det_ctx->pmq.rule_id_array_cnt;
+    (void)MpmStreamSearch(mpm_ctx, mpm_thread_ctx, &det_ctx->pmq,
+            &ds->state, data, data_len);
+
+    uint32_t i;
+    for (i = cnt; i < det_ctx->pmq.rule_id_array_cnt; i++) {
+        if (DetectMpmStreamSidAdd(ds, det_ctx->pmq.rule_id_array[i], end) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * \brief search the stream msgs of a packet with the stream state of the
+ *        flow, only the data not searched for the previous packets
+ *
+ * \param mpm_ctx stream mpm ctx
+ * \param smsg list of consecutive stream msgs, the inspection window
+ * \param flags STREAM_TOSERVER or STREAM_TOCLIENT
+ *
+ * \retval 1 searched
+ * \retval 0 not searched as streaming is disabled or there is no state,
+ *         the caller has to search the msgs
+ */
+int DetectMpmStreamSearchRaw(DetectEngineThreadCtx *det_ctx, Flow *f,
+        const MpmCtx *mpm_ctx, const StreamMsg *smsg, const uint8_t flags)
+{
+    if (smsg == NULL || f == NULL || f->protoctx == NULL)
+        return 0;
+
+    DetectMpmStream *ds = DetectMpmStreamGet(det_ctx, f, mpm_ctx, flags,
+            DETECT_MPM_STREAM_RAW);
+    if (ds == NULL)
+        return 0;
+
+    const TcpSession *ssn = (const TcpSession *)f->protoctx;
+    const uint32_t isn = (flags & STREAM_TOSERVER) ?
+        ssn->client.isn : ssn->server.isn;
+
+    /* a new session on the flow */
+    if (ds->active && ds->id != isn) {
+        ds->active = 0;
+        ds->sids_cnt = 0;
+    }
+
+    /* rules found before in chunks that are still in the window */
+    DetectMpmStreamSidExpire(ds, DETECT_MPM_STREAM_RAW, smsg->seq);
+    if (ds->sids_cnt > 0)
+        MpmAddSids(&det_ctx->pmq, ds->sids, ds->sids_cnt);
+
+    int failed = 0;
+    for ( ; smsg != NULL; smsg = smsg->next) {
+        const uint32_t end = smsg->seq + smsg->data_len;
+
+        if (!ds->active || SEQ_GT(smsg->seq, (uint32_t)ds->offset)) {
+            DetectMpmStreamRestart(ds, isn, smsg->seq);
+        }
+        if (SEQ_LEQ(end, (uint32_t)ds->offset))
+            continue;
+
+        const uint32_t skip = (uint32_t)ds->offset - smsg->seq;
+        if (DetectMpmStreamSearch(det_ctx, mpm_ctx, &det_ctx->mtcs, ds,
+                    smsg->data + skip, smsg->data_len - skip, end) != 0)
+            failed = 1;
+        ds->offset = end;
+    }
+    if (failed)
+        ds->active = 0;
+
+    return 1;
+}
+
+/**
+ * \brief search a http body buffer with the body state of the flow, only
+ *        the data not searched for the previous packets
+ *
+ * \param mpm_ctx body mpm ctx
+ * \param tx_id id of the tx the body belongs to
+ * \param buffer body buffer
+ * \param buffer_len length of the buffer
+ * \param offset offset of the buffer in the body
+ * \param flags STREAM_TOSERVER or STREAM_TOCLIENT
+ *
+ * \retval 1 searched
+ * \retval 0 not searched as streaming is disabled or there is no state,
+ *         the caller has to search the buffer
+ */
+int DetectMpmStreamSearchBody(DetectEngineThreadCtx *det_ctx, Flow *f,
+        const MpmCtx *mpm_ctx, const uint64_t tx_id,
+        const uint8_t *buffer, const uint32_t buffer_len,
+        const uint64_t offset, const uint8_t flags)
+{
+    DetectMpmStream *ds = DetectMpmStreamGet(det_ctx, f, mpm_ctx, flags,
+            DETECT_MPM_STREAM_BODY);
+    if (ds == NULL)
+        return 0;
+
+    /* body of another tx */
+    if (ds->active && ds->id != tx_id) {
+        ds->active = 0;
+        ds->sids_cnt = 0;
+    }
+    if (!ds->active || offset > ds->offset) {
+        DetectMpmStreamRestart(ds, tx_id, offset);
+    }
+
+    /* rules found before in data that is still in the buffer */
+    DetectMpmStreamSidExpire(ds, DETECT_MPM_STREAM_BODY, offset);
+    if (ds->sids_cnt > 0)
+        MpmAddSids(&det_ctx->pmq, ds->sids, ds->sids_cnt);
+
+    const uint64_t end = offset + buffer_len;
+    if (end <= ds->offset)
+        return 1;
+
+    const uint32_t skip = (uint32_t)(ds->offset - offset);
+    if (DetectMpmStreamSearch(det_ctx, mpm_ctx, &det_ctx->mtcu, ds,
+                buffer + skip, buffer_len - skip, end) != 0)
+        ds->active = 0;
+    ds->offset = end;
+    return 1;
+}
+
+/*************************************Unittests********************************/
+
+#ifdef UNITTESTS
+
+static int DetectMpmStreamTestHasSid(const PatternMatcherQueue *pmq,
+                                     SigIntId sid)
+{
+    uint32_t i;
+    for (i = 0; i < pmq->rule_id_array_cnt; i++) {
+        if (pmq->rule_id_array[i] == sid)
+            return 1;
+    }
+    return 0;
+}
+
+static void DetectMpmStreamTestSetup(DetectEngineCtx *de_ctx,
+        DetectEngineThreadCtx *det_ctx, MpmCtx *mpm_ctx)
+{
+    memset(de_ctx, 0, sizeof(*de_ctx));
+    memset(det_ctx, 0, sizeof(*det_ctx));
+    memset(mpm_ctx, 0, sizeof(*mpm_ctx));
+
+    de_ctx->mpm_streaming = 1;
+    de_ctx->id = 1;
+    det_ctx->de_ctx = de_ctx;
+    PmqSetup(&det_ctx->pmq);
+
+    MpmInitCtx(mpm_ctx, MPM_AC);
+    MpmInitThreadCtx(&det_ctx->mtcu, MPM_AC);
+    MpmInitThreadCtx(&det_ctx->mtcs, MPM_AC);
+    MpmAddPatternCS(mpm_ctx, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    MpmAddPatternCI(mpm_ctx, (uint8_t *)"efgh", 4, 0, 0, 1, 1, 0);
+    mpm_table[MPM_AC].Prepare(mpm_ctx);
+}
+
+static void DetectMpmStreamTestCleanup(DetectEngineThreadCtx *det_ctx,
+        MpmCtx *mpm_ctx)
+{
+    mpm_table[MPM_AC].DestroyCtx(mpm_ctx);
+    mpm_table[MPM_AC].DestroyThreadCtx(mpm_ctx, &det_ctx->mtcu);
+    mpm_table[MPM_AC].DestroyThreadCtx(mpm_ctx, &det_ctx->mtcs);
+    PmqFree(&det_ctx->pmq);
+}
+
+/** \test body buffers that overlap only have their new data searched,
+ *        including the patterns spanning the old and new data. The rules
+ *        found stay candidates while their data is in the buffer. */
+static int DetectMpmStreamTest01(void)
+{
+    DetectEngineCtx de_ctx;
+    DetectEngineThreadCtx det_ctx;
+    MpmCtx mpm_ctx;
+    const uint8_t *body = (const uint8_t *)"..abcd..EFGH..abcd";
+
+    FlowInitConfig(FLOW_QUIET);
+    DetectMpmStreamTestSetup(&de_ctx, &det_ctx, &mpm_ctx);
+    Flow *f = FlowAlloc();
+    FAIL_IF_NULL(f);
+
+    /* "..abcd..EF" */
+    FAIL_IF_NOT(DetectMpmStreamSearchBody(&det_ctx, f, &mpm_ctx, 0,
+                body, 10, 0, STREAM_TOSERVER));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 0));
+    FAIL_IF(DetectMpmStreamTestHasSid(&det_ctx.pmq, 1));
+    PmqReset(&det_ctx.pmq);
+
+    /* "..abcd..EFGH.." with "..abcd..EF" searched before: "EFGH" is
+     * found, "abcd" is still in the buffer */
+    FAIL_IF_NOT(DetectMpmStreamSearchBody(&det_ctx, f, &mpm_ctx, 0,
+                body, 14, 0, STREAM_TOSERVER));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 0));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 1));
+    PmqReset(&det_ctx.pmq);
+
+    /* nothing new, but both are in the buffer */
+    FAIL_IF_NOT(DetectMpmStreamSearchBody(&det_ctx, f, &mpm_ctx, 0,
+                body + 4, 10, 4, STREAM_TOSERVER));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 0));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 1));
+    PmqReset(&det_ctx.pmq);
+
+    /* window moved on: "abcd", the data "EFGH" was found in is gone */
+    FAIL_IF_NOT(DetectMpmStreamSearchBody(&det_ctx, f, &mpm_ctx, 0,
+                body + 14, 4, 14, STREAM_TOSERVER));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 0));
+    FAIL_IF(DetectMpmStreamTestHasSid(&det_ctx.pmq, 1));
+    PmqReset(&det_ctx.pmq);
+
+    /* the body of the next tx is searched from the start */
+    FAIL_IF_NOT(DetectMpmStreamSearchBody(&det_ctx, f, &mpm_ctx, 1,
+                body + 6, 8, 0, STREAM_TOSERVER));
+    FAIL_IF(DetectMpmStreamTestHasSid(&det_ctx.pmq, 0));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 1));
+    PmqReset(&det_ctx.pmq);
+
+    /* disabled: the caller searches */
+    de_ctx.mpm_streaming = 0;
+    FAIL_IF(DetectMpmStreamSearchBody(&det_ctx, f, &mpm_ctx, 1,
+                body, 18, 0, STREAM_TOSERVER));
+
+    FlowFreeStorage(f);
+    FlowFree(f);
+    DetectMpmStreamTestCleanup(&det_ctx, &mpm_ctx);
+    FlowShutdown();
+    PASS;
+}
+
+/** \test stream msgs are only searched once, and the rules found stay
+ *        candidates while their msg is in the window */
+static int DetectMpmStreamTest02(void)
+{
+    DetectEngineCtx de_ctx;
+    DetectEngineThreadCtx det_ctx;
+    MpmCtx mpm_ctx;
+    TcpSession ssn;
+    uint8_t d1[] = "..abcd..";
+    uint8_t d2[] = "..ef";
+    uint8_t d3[] = "gh....";
+    StreamMsg m1, m2, m3;
+
+    FlowInitConfig(FLOW_QUIET);
+    DetectMpmStreamTestSetup(&de_ctx, &det_ctx, &mpm_ctx);
+    Flow *f = FlowAlloc();
+    FAIL_IF_NULL(f);
+    memset(&ssn, 0, sizeof(ssn));
+    ssn.client.isn = 999;
+    f->protoctx = &ssn;
+
+    memset(&m1, 0, sizeof(m1));
+    memset(&m2, 0, sizeof(m2));
+    memset(&m3, 0, sizeof(m3));
+    m1.seq = 1000;
+    m1.data = d1;
+    m1.data_len = sizeof(d1) - 1;
+    m2.seq = 1008;
+    m2.data = d2;
+    m2.data_len = sizeof(d2) - 1;
+    m3.seq = 1012;
+    m3.data = d3;
+    m3.data_len = sizeof(d3) - 1;
+
+    FAIL_IF_NOT(DetectMpmStreamSearchRaw(&det_ctx, f, &mpm_ctx, &m1,
+                STREAM_TOSERVER));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 0));
+    PmqReset(&det_ctx.pmq);
+
+    /* m1 searched before, its rule is still a candidate */
+    m1.next = &m2;
+    FAIL_IF_NOT(DetectMpmStreamSearchRaw(&det_ctx, f, &mpm_ctx, &m1,
+                STREAM_TOSERVER));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 0));
+    FAIL_IF(DetectMpmStreamTestHasSid(&det_ctx.pmq, 1));
+    PmqReset(&det_ctx.pmq);
+
+    /* m1 left the window, "efgh" spans m2 and m3 */
+    m1.next = NULL;
+    m2.next = &m3;
+    FAIL_IF_NOT(DetectMpmStreamSearchRaw(&det_ctx, f, &mpm_ctx, &m2,
+                STREAM_TOSERVER));
+    FAIL_IF(DetectMpmStreamTestHasSid(&det_ctx.pmq, 0));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 1));
+    PmqReset(&det_ctx.pmq);
+
+    /* a new session on the flow is searched from the start */
+    ssn.client.isn = 12345;
+    m2.next = NULL;
+    FAIL_IF_NOT(DetectMpmStreamSearchRaw(&det_ctx, f, &mpm_ctx, &m1,
+                STREAM_TOSERVER));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 0));
+    PmqReset(&det_ctx.pmq);
+
+    f->protoctx = NULL;
+    FlowFreeStorage(f);
+    FlowFree(f);
+    DetectMpmStreamTestCleanup(&det_ctx, &mpm_ctx);
+    FlowShutdown();
+    PASS;
+}
+
+/** \test a flow that can't get its state within the memcap is searched
+ *        in full by the caller, and the memory is given back on free */
+static int DetectMpmStreamTest03(void)
+{
+    DetectEngineCtx de_ctx;
+    DetectEngineThreadCtx det_ctx;
+    MpmCtx mpm_ctx;
+    const uint8_t *body = (const uint8_t *)"..abcd..EFGH..abcd";
+    const uint64_t memcap = detect_mpm_stream_memcap;
+    const uint64_t memuse = SC_ATOMIC_GET(detect_mpm_stream_memuse);
+
+    FlowInitConfig(FLOW_QUIET);
+    DetectMpmStreamTestSetup(&de_ctx, &det_ctx, &mpm_ctx);
+    Flow *f = FlowAlloc();
+    FAIL_IF_NULL(f);
+
+    detect_mpm_stream_memcap = memuse + 1;
+    FAIL_IF(DetectMpmStreamSearchBody(&det_ctx, f, &mpm_ctx, 0,
+                body, 10, 0, STREAM_TOSERVER));
+    FAIL_IF(SC_ATOMIC_GET(detect_mpm_stream_memuse) != memuse);
+
+    detect_mpm_stream_memcap = memcap;
+    FAIL_IF_NOT(DetectMpmStreamSearchBody(&det_ctx, f, &mpm_ctx, 0,
+                body, 10, 0, STREAM_TOSERVER));
+    FAIL_IF_NOT(DetectMpmStreamTestHasSid(&det_ctx.pmq, 0));
+    FAIL_IF(SC_ATOMIC_GET(detect_mpm_stream_memuse) <= memuse);
+    PmqReset(&det_ctx.pmq);
+
+    FlowFreeStorage(f);
+    FlowFree(f);
+    FAIL_IF(SC_ATOMIC_GET(detect_mpm_stream_memuse) != memuse);
+    DetectMpmStreamTestCleanup(&det_ctx, &mpm_ctx);
+    FlowShutdown();
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void DetectMpmStreamRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("DetectMpmStreamTest01", DetectMpmStreamTest01);
+    UtRegisterTest("DetectMpmStreamTest02", DetectMpmStreamTest02);
+    UtRegisterTest("DetectMpmStreamTest03", DetectMpmStreamTest03);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,40 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Streaming mpm for the reassembled stream and the http bodies.
+ */
+
+#ifndef __DETECT_ENGINE_MPM_STREAM_H__
+#define __DETECT_ENGINE_MPM_STREAM_H__
+
+#include "stream.h"
+
+void DetectMpmStreamRegister(void);
+
+int DetectMpmStreamSearchRaw(DetectEngineThreadCtx *det_ctx, Flow *f,
+        const MpmCtx *mpm_ctx, const StreamMsg *smsg, const uint8_t flags);
+int DetectMpmStreamSearchBody(DetectEngineThreadCtx *det_ctx, Flow *f,
+        const MpmCtx *mpm_ctx, const uint64_t tx_id,
+        const uint8_t *buffer, const uint32_t buffer_len,
+        const uint64_t offset, const uint8_t flags);
+
+void DetectMpmStreamRegisterTests(void);
+
+#endif /* __DETECT_ENGINE_MPM_STREAM_H__ */
@@ -36,6 +36,24 @@
 #include "detect-engine-mpm.h"
 #include "detect-engine-iponly.h"
 #include "detect-parse.h"
+#include "detect-engine-prefilter.h"
+#include "detect-engine-payload.h"
+#include "detect-engine-uri.h"
+#include "detect-engine-hrud.h"
+#include "detect-engine-hmd.h"
+#include "detect-engine-hhd.h"
+#include "detect-engine-hrhd.h"
+#include "detect-engine-hcd.h"
+#include "detect-engine-hua.h"
+#include "detect-engine-hhhd.h"
+#include "detect-engine-hrhhd.h"
+#include "detect-engine-hcbd.h"
+#include "detect-engine-hsbd.h"
+#include "detect-engine-hsmd.h"
+#include "detect-engine-hscd.h"
+#include "detect-engine-filedata-smtp.h"
+#include "detect-engine-dns.h"
+#include "detect-engine-tls.h"
 #include "util-mpm.h"
 #include "util-memcmp.h"
 #include "util-memcpy.h"
@@ -72,45 +90,46 @@ typedef struct AppLayerMpms_ {
     int32_t sgh_mpm_context;    /**< mpm factory id */
     int direction;              /**< SIG_FLAG_TOSERVER or SIG_FLAG_TOCLIENT */
     int sm_list;
-    uint32_t flags;             /**< flags set to SGH when this mpm is present */
+    /** register the prefilter engine for this buffer in a rule group */
+    int (*PrefilterRegister)(SigGroupHead *sgh, MpmCtx *mpm_ctx);
     int id;                     /**< index into this array and result arrays */
 } AppLayerMpms;
 
 AppLayerMpms app_mpms[] = {
-    { "http_uri", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_UMATCH, SIG_GROUP_HEAD_MPM_URI, 0 },
-    { "http_raw_uri", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HRUDMATCH, SIG_GROUP_HEAD_MPM_HRUD, 1 },
+    { "http_uri", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_UMATCH, PrefilterTxUriRegister, 0 },
+    { "http_raw_uri", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HRUDMATCH, PrefilterTxRawUriRegister, 1 },
 
-    { "http_header", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HHDMATCH, SIG_GROUP_HEAD_MPM_HHD, 2},
-    { "http_header", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_HHDMATCH, SIG_GROUP_HEAD_MPM_HHD, 3},
+    { "http_header", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HHDMATCH, PrefilterTxHttpRequestHeadersRegister, 2},
+    { "http_header", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_HHDMATCH, PrefilterTxHttpResponseHeadersRegister, 3},
 
-    { "http_user_agent", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HUADMATCH, SIG_GROUP_HEAD_MPM_HUAD, 4},
+    { "http_user_agent", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HUADMATCH, PrefilterTxUARegister, 4},
 
-    { "http_raw_header", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HRHDMATCH, SIG_GROUP_HEAD_MPM_HRHD, 5},
-    { "http_raw_header", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_HRHDMATCH, SIG_GROUP_HEAD_MPM_HRHD, 6},
+    { "http_raw_header", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HRHDMATCH, PrefilterTxRequestHeadersRawRegister, 5},
+    { "http_raw_header", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_HRHDMATCH, PrefilterTxResponseHeadersRawRegister, 6},
 
-    { "http_method", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HMDMATCH, SIG_GROUP_HEAD_MPM_HMD, 7},
+    { "http_method", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HMDMATCH, PrefilterTxMethodRegister, 7},
 
-    { "file_data", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_FILEDATA, SIG_GROUP_HEAD_MPM_FD_SMTP, 8}, /* smtp */
-    { "file_data", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_FILEDATA, SIG_GROUP_HEAD_MPM_HSBD, 9}, /* http server body */
+    { "file_data", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_FILEDATA, PrefilterTxSmtpFiledataRegister, 8}, /* smtp */
+    { "file_data", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_FILEDATA, PrefilterTxHttpResponseBodyRegister, 9}, /* http server body */
 
-    { "http_stat_msg", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_HSMDMATCH, SIG_GROUP_HEAD_MPM_HSMD, 10},
-    { "http_stat_code", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_HSCDMATCH, SIG_GROUP_HEAD_MPM_HSCD, 11},
+    { "http_stat_msg", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_HSMDMATCH, PrefilterTxHttpStatMsgRegister, 10},
+    { "http_stat_code", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_HSCDMATCH, PrefilterTxHttpStatCodeRegister, 11},
 
-    { "http_client_body", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HCBDMATCH, SIG_GROUP_HEAD_MPM_HCBD, 12},
+    { "http_client_body", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HCBDMATCH, PrefilterTxHttpRequestBodyRegister, 12},
 
-    { "http_host", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HHHDMATCH, SIG_GROUP_HEAD_MPM_HHHD, 13},
-    { "http_raw_host", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HRHHDMATCH, SIG_GROUP_HEAD_MPM_HRHHD, 14},
+    { "http_host", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HHHDMATCH, PrefilterTxHostnameRegister, 13},
+    { "http_raw_host", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HRHHDMATCH, PrefilterTxHostnameRawRegister, 14},
 
-    { "http_cookie", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HCDMATCH, SIG_GROUP_HEAD_MPM_HCD, 15},
-    { "http_cookie", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_HCDMATCH, SIG_GROUP_HEAD_MPM_HCD, 16},
+    { "http_cookie", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_HCDMATCH, PrefilterTxRequestCookieRegister, 15},
+    { "http_cookie", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_HCDMATCH, PrefilterTxResponseCookieRegister, 16},
 
-    { "dns_query", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_DNSQUERYNAME_MATCH, SIG_GROUP_HEAD_MPM_DNSQUERY, 17},
+    { "dns_query", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_DNSQUERYNAME_MATCH, PrefilterTxDnsQueryRegister, 17},
 
-    { "tls_sni", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_TLSSNI_MATCH, SIG_GROUP_HEAD_MPM_TLSSNI, 18},
-    { "tls_cert_issuer", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_TLSISSUER_MATCH, SIG_GROUP_HEAD_MPM_TLSISSUER, 19},
-    { "tls_cert_subject", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_TLSSUBJECT_MATCH, SIG_GROUP_HEAD_MPM_TLSSUBJECT, 20},
+    { "tls_sni", 0, SIG_FLAG_TOSERVER, DETECT_SM_LIST_TLSSNI_MATCH, PrefilterTxTlsSniRegister, 18},
+    { "tls_cert_issuer", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_TLSISSUER_MATCH, PrefilterTxTlsIssuerRegister, 19},
+    { "tls_cert_subject", 0, SIG_FLAG_TOCLIENT, DETECT_SM_LIST_TLSSUBJECT_MATCH, PrefilterTxTlsSubjectRegister, 20},
 
-    { NULL, 0, 0, 0, 0, 0, }
+    { NULL, 0, 0, 0, NULL, 0, }
 };
 
 void DetectMpmInitializeAppMpms(DetectEngineCtx *de_ctx)
@@ -146,11 +165,47 @@ void DetectMpmInitializeAppMpms(DetectEngineCtx *de_ctx)
     }
 }
 
+/** \brief list of mpm contexts to prepare at the end of the build */
+typedef struct MpmPrepareList_ {
+    MpmCtx **ctxs;
+    uint32_t cnt;
+    uint32_t size;
+} MpmPrepareList;
+
+static int MpmPrepareListAdd(MpmPrepareList *list, MpmCtx *mpm_ctx)
+{
+    if (mpm_ctx == NULL)
+        return 0;
+
+    if (list->cnt == list->size) {
+        uint32_t size = list->size ? list->size * 2 : 64;
+        MpmCtx **ctxs = SCRealloc(list->ctxs, size * sizeof(MpmCtx *));
+        if (ctxs == NULL)
+            return -1;
+        list->ctxs = ctxs;
+        list->size = size;
+    }
+    list->ctxs[list->cnt++] = mpm_ctx;
+    return 0;
+}
+
+/** \brief add a shared context, skipping it if it's on the list already
+ *         as it mustn't be prepared twice in parallel */
+static int MpmPrepareListAddShared(MpmPrepareList *list, MpmCtx *mpm_ctx)
+{
+    uint32_t i;
+    for (i = 0; i < list->cnt; i++) {
+        if (list->ctxs[i] == mpm_ctx)
+            return 0;
+    }
+    return MpmPrepareListAdd(list, mpm_ctx);
+}
+
 /**
- *  \brief initialize mpm contexts for applayer buffers that are in
- *         "single or "shared" mode.
+ *  \brief add the mpm contexts for applayer buffers that are in
+ *         "single or "shared" mode to the prepare list.
  */
-void DetectMpmPrepareAppMpms(DetectEngineCtx *de_ctx)
+static int DetectMpmPrepareAppMpms(DetectEngineCtx *de_ctx, MpmPrepareList *list)
 {
     int i;
     for (i = 0; i < APP_MPMS_MAX; i++) {
@@ -161,13 +216,11 @@ void DetectMpmPrepareAppMpms(DetectEngineCtx *de_ctx)
         if (am->sgh_mpm_context != MPM_CTX_FACTORY_UNIQUE_CONTEXT)
         {
             MpmCtx *mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, am->sgh_mpm_context, dir);
-            if (mpm_ctx != NULL) {
-                if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-                    mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-                }
-            }
+            if (MpmPrepareListAddShared(list, mpm_ctx) != 0)
+                return -1;
         }
     }
+    return 0;
 }
 
 static int32_t SetupBuiltinMpm(DetectEngineCtx *de_ctx, const char *name)
@@ -204,52 +257,177 @@ void DetectMpmInitializeBuiltinMpms(DetectEngineCtx *de_ctx)
 }
 
 /**
- *  \brief initialize mpm contexts for builtin buffers that are in
- *         "single or "shared" mode.
+ *  \brief add the mpm contexts for builtin buffers that are in
+ *         "single or "shared" mode to the prepare list.
  */
-void DetectMpmPrepareBuiltinMpms(DetectEngineCtx *de_ctx)
+static int DetectMpmPrepareBuiltinMpms(DetectEngineCtx *de_ctx, MpmPrepareList *list)
 {
-    MpmCtx *mpm_ctx = NULL;
+    int r = 0;
 
     if (de_ctx->sgh_mpm_context_proto_tcp_packet != MPM_CTX_FACTORY_UNIQUE_CONTEXT) {
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_tcp_packet, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_tcp_packet, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
+        r |= MpmPrepareListAddShared(list, MpmFactoryGetMpmCtxForProfile(de_ctx,
+                    de_ctx->sgh_mpm_context_proto_tcp_packet, 0));
+        r |= MpmPrepareListAddShared(list, MpmFactoryGetMpmCtxForProfile(de_ctx,
+                    de_ctx->sgh_mpm_context_proto_tcp_packet, 1));
     }
 
     if (de_ctx->sgh_mpm_context_proto_udp_packet != MPM_CTX_FACTORY_UNIQUE_CONTEXT) {
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_udp_packet, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_udp_packet, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
+        r |= MpmPrepareListAddShared(list, MpmFactoryGetMpmCtxForProfile(de_ctx,
+                    de_ctx->sgh_mpm_context_proto_udp_packet, 0));
+        r |= MpmPrepareListAddShared(list, MpmFactoryGetMpmCtxForProfile(de_ctx,
+                    de_ctx->sgh_mpm_context_proto_udp_packet, 1));
     }
 
     if (de_ctx->sgh_mpm_context_proto_other_packet != MPM_CTX_FACTORY_UNIQUE_CONTEXT) {
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_proto_other_packet, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
+        r |= MpmPrepareListAddShared(list, MpmFactoryGetMpmCtxForProfile(de_ctx,
+                    de_ctx->sgh_mpm_context_proto_other_packet, 0));
     }
 
     if (de_ctx->sgh_mpm_context_stream != MPM_CTX_FACTORY_UNIQUE_CONTEXT) {
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_stream, 0);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
-        }
-        mpm_ctx = MpmFactoryGetMpmCtxForProfile(de_ctx, de_ctx->sgh_mpm_context_stream, 1);
-        if (mpm_table[de_ctx->mpm_matcher].Prepare != NULL) {
-            mpm_table[de_ctx->mpm_matcher].Prepare(mpm_ctx);
+        r |= MpmPrepareListAddShared(list, MpmFactoryGetMpmCtxForProfile(de_ctx,
+                    de_ctx->sgh_mpm_context_stream, 0));
+        r |= MpmPrepareListAddShared(list, MpmFactoryGetMpmCtxForProfile(de_ctx,
+                    de_ctx->sgh_mpm_context_stream, 1));
+    }
+    return r ? -1 : 0;
+}
+
+/**
+ *  \brief add the unique mpm contexts of the rule groups to the prepare
+ *         list.
+ */
+static int MpmStorePrepareList(DetectEngineCtx *de_ctx, MpmPrepareList *list)
+{
+    HashListTableBucket *htb = NULL;
+
+    for (htb = HashListTableGetListHead(de_ctx->mpm_hash_table);
+            htb != NULL;
+            htb = HashListTableGetListNext(htb))
+    {
+        const MpmStore *ms = (MpmStore *)HashListTableGetListData(htb);
+        if (ms == NULL || ms->mpm_ctx == NULL)
+            continue;
+        if (ms->sgh_mpm_context != MPM_CTX_FACTORY_UNIQUE_CONTEXT)
+            continue;
+        if (MpmPrepareListAdd(list, ms->mpm_ctx) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+typedef struct MpmPrepareWork_ {
+    MpmPrepareList *list;
+    uint16_t mpm_matcher;
+    uint32_t next;          /**< next context to prepare, under m */
+    SCMutex m;
+} MpmPrepareWork;
+
+static void *MpmPrepareThread(void *data)
+{
+    MpmPrepareWork *w = (MpmPrepareWork *)data;
+
+    while (1) {
+        SCMutexLock(&w->m);
+        uint32_t idx = w->next++;
+        SCMutexUnlock(&w->m);
+
+        if (idx >= w->list->cnt)
+            break;
+
+        mpm_table[w->mpm_matcher].Prepare(w->list->ctxs[idx]);
+    }
+    return NULL;
+}
+
+/* largest first, so the big contexts don't end up last on a single
+ * thread */
+static int MpmPrepareCompare(const void *a, const void *b)
+{
+    const MpmCtx *ma = *(const MpmCtx **)a;
+    const MpmCtx *mb = *(const MpmCtx **)b;
+
+    if (ma->pattern_cnt > mb->pattern_cnt)
+        return -1;
+    else if (ma->pattern_cnt < mb->pattern_cnt)
+        return 1;
+    return 0;
+}
+
+/**
+ *  \brief prepare (compile) the mpm contexts of the detection engine
+ *
+ *  The contexts don't depend on each other, so with
+ *  detect.mpm-build-threads > 1 they are prepared by a set of threads
+ *  that are started here and joined before returning.
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int DetectMpmPrepareContexts(DetectEngineCtx *de_ctx)
+{
+    MpmPrepareList list = { NULL, 0, 0 };
+    int ret = 0;
+
+    if (mpm_table[de_ctx->mpm_matcher].Prepare == NULL)
+        return 0;
+
+    if (MpmStorePrepareList(de_ctx, &list) != 0 ||
+        DetectMpmPrepareBuiltinMpms(de_ctx, &list) != 0 ||
+        DetectMpmPrepareAppMpms(de_ctx, &list) != 0)
+    {
+        ret = -1;
+        goto end;
+    }
+    if (list.cnt == 0)
+        goto end;
+
+    qsort(list.ctxs, list.cnt, sizeof(MpmCtx *), MpmPrepareCompare);
+
+    MpmPrepareWork w;
+    memset(&w, 0, sizeof(w));
+    w.list = &list;
+    w.mpm_matcher = de_ctx->mpm_matcher;
+    SCMutexInit(&w.m, NULL);
+
+    uint32_t nthreads = (uint32_t)de_ctx->mpm_build_threads;
+#ifdef __SC_CUDA_SUPPORT__
+    if (de_ctx->mpm_matcher == MPM_AC_CUDA)
+        nthreads = 1;
+#endif
+    if (nthreads > list.cnt)
+        nthreads = list.cnt;
+
+    /* the calling thread is one of the workers */
+    pthread_t *threads = NULL;
+    if (nthreads > 1) {
+        threads = SCCalloc(nthreads - 1, sizeof(pthread_t));
+        if (threads == NULL)
+            nthreads = 1;
+    }
+    uint32_t started = 0;
+    for ( ; started + 1 < nthreads; started++) {
+        if (pthread_create(&threads[started], NULL, MpmPrepareThread, &w) != 0) {
+            SCLogWarning(SC_ERR_THREAD_CREATE, "failed to start mpm build "
+                    "thread, continuing with %u threads", started + 1);
+            break;
         }
     }
+    MpmPrepareThread(&w);
+
+    uint32_t t;
+    for (t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    if (threads != NULL)
+        SCFree(threads);
+    SCMutexDestroy(&w.m);
+
+    SCLogPerf("prepared %u mpm contexts using %u threads",
+            list.cnt, started + 1);
+end:
+    if (list.ctxs != NULL)
+        SCFree(list.ctxs);
+    return ret;
 }
 
 /**
@@ -386,9 +564,10 @@ void PacketPatternCleanup(ThreadVars *t, DetectEngineThreadCtx *det_ctx)
         mpm_table[det_ctx->sgh->mpm_packet_ctx->mpm_type].Cleanup(&det_ctx->mtc);
     }
 
-    /* uricontent */
-    if (det_ctx->sgh->mpm_uri_ctx_ts != NULL && mpm_table[det_ctx->sgh->mpm_uri_ctx_ts->mpm_type].Cleanup != NULL) {
-        mpm_table[det_ctx->sgh->mpm_uri_ctx_ts->mpm_type].Cleanup(&det_ctx->mtcu);
+    /* app layer buffers */
+    if (det_ctx->sgh->tx_engines != NULL &&
+            mpm_table[det_ctx->de_ctx->mpm_matcher].Cleanup != NULL) {
+        mpm_table[det_ctx->de_ctx->mpm_matcher].Cleanup(&det_ctx->mtcu);
     }
 
     /* stream content */
@@ -953,15 +1132,11 @@ void MpmStoreSetup(const DetectEngineCtx *de_ctx, MpmStore *ms)
         }
     }
 
+    /* unique contexts are prepared by DetectMpmPrepareContexts once all
+     * rule groups are set up */
     if (ms->mpm_ctx->pattern_cnt == 0) {
         MpmFactoryReClaimMpmCtx(de_ctx, ms->mpm_ctx);
         ms->mpm_ctx = NULL;
-    } else {
-        if (ms->sgh_mpm_context == MPM_CTX_FACTORY_UNIQUE_CONTEXT) {
-            if (mpm_table[ms->mpm_ctx->mpm_type].Prepare != NULL) {
-                mpm_table[ms->mpm_ctx->mpm_type].Prepare(ms->mpm_ctx);
-            }
-        }
     }
 }
 
@@ -1171,68 +1346,10 @@ MpmStore *MpmStorePrepareBuffer2(DetectEngineCtx *de_ctx, SigGroupHead *sgh, App
     return NULL;
 }
 
-/** \todo fixup old mpm ptrs. We could use the array directly later */
-void MpmStoreFixup(SigGroupHead *sgh)
-{
-    if (!(SGH_PROTO(sgh, IPPROTO_TCP) || SGH_PROTO(sgh, IPPROTO_UDP)))
-        return;
-
-#define SET_TS(sgh, ptr) do {                   \
-        if (SGH_DIRECTION_TS((sgh)))            \
-            (ptr) = (sgh)->init->app_mpms[i++]; \
-        else                                    \
-            i++;                                \
-    } while(0)
-
-#define SET_TC(sgh, ptr) do {                   \
-        if (SGH_DIRECTION_TC((sgh)))            \
-            (ptr) = (sgh)->init->app_mpms[i++]; \
-        else                                    \
-            i++;                                \
-    } while(0)
-
-    int i = 0;
-    SET_TS(sgh, sgh->mpm_uri_ctx_ts);
-    SET_TS(sgh, sgh->mpm_hrud_ctx_ts);
-
-    SET_TS(sgh, sgh->mpm_hhd_ctx_ts);
-    SET_TC(sgh, sgh->mpm_hhd_ctx_tc);
-
-    SET_TS(sgh, sgh->mpm_huad_ctx_ts);
-
-    SET_TS(sgh, sgh->mpm_hrhd_ctx_ts);
-    SET_TC(sgh, sgh->mpm_hrhd_ctx_tc);
-
-    SET_TS(sgh, sgh->mpm_hmd_ctx_ts);
-
-    SET_TS(sgh, sgh->mpm_smtp_filedata_ctx_ts);
-    SET_TC(sgh, sgh->mpm_hsbd_ctx_tc);
-
-    SET_TC(sgh, sgh->mpm_hsmd_ctx_tc);
-    SET_TC(sgh, sgh->mpm_hscd_ctx_tc);
-
-    SET_TS(sgh, sgh->mpm_hcbd_ctx_ts);
-
-    SET_TS(sgh, sgh->mpm_hhhd_ctx_ts);
-    SET_TS(sgh, sgh->mpm_hrhhd_ctx_ts);
-
-    SET_TS(sgh, sgh->mpm_hcd_ctx_ts);
-    SET_TC(sgh, sgh->mpm_hcd_ctx_tc);
-
-    SET_TS(sgh, sgh->mpm_dnsquery_ctx_ts);
-
-    SET_TS(sgh, sgh->mpm_tlssni_ctx_ts);
-    SET_TC(sgh, sgh->mpm_tlsissuer_ctx_ts);
-    SET_TC(sgh, sgh->mpm_tlssubject_ctx_ts);
-
-    BUG_ON(APP_MPMS_MAX != 21 || i != 21);
-
-#undef SET_TS
-#undef SET_TC
-}
-
 /** \brief Prepare the pattern matcher ctx in a sig group head.
  *
+ *  Sets up the mpm ctx' for the packet, stream and app layer buffers
+ *  and registers a prefilter engine for each of them.
  */
 int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
 {
@@ -1243,8 +1360,10 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
             if (mpm_store != NULL) {
                 BUG_ON(sh->mpm_packet_ctx);
                 sh->mpm_packet_ctx = mpm_store->mpm_ctx;
-                if (sh->mpm_packet_ctx)
+                if (sh->mpm_packet_ctx) {
                     sh->flags |= SIG_GROUP_HEAD_MPM_PACKET;
+                    PrefilterPktPayloadRegister(sh, mpm_store->mpm_ctx);
+                }
             }
 
             mpm_store = MpmStorePrepareBuffer(de_ctx, sh, MPMB_TCP_STREAM_TS);
@@ -1252,8 +1371,10 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                 BUG_ON(mpm_store == NULL);
                 BUG_ON(sh->mpm_stream_ctx);
                 sh->mpm_stream_ctx = mpm_store->mpm_ctx;
-                if (sh->mpm_stream_ctx)
+                if (sh->mpm_stream_ctx) {
                     sh->flags |= SIG_GROUP_HEAD_MPM_STREAM;
+                    PrefilterPktStreamRegister(sh, mpm_store->mpm_ctx);
+                }
             }
         }
         if (SGH_DIRECTION_TC(sh)) {
@@ -1261,16 +1382,20 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
             if (mpm_store != NULL) {
                 BUG_ON(sh->mpm_packet_ctx);
                 sh->mpm_packet_ctx = mpm_store->mpm_ctx;
-                if (sh->mpm_packet_ctx)
+                if (sh->mpm_packet_ctx) {
                     sh->flags |= SIG_GROUP_HEAD_MPM_PACKET;
+                    PrefilterPktPayloadRegister(sh, mpm_store->mpm_ctx);
+                }
             }
 
             mpm_store = MpmStorePrepareBuffer(de_ctx, sh, MPMB_TCP_STREAM_TC);
             if (mpm_store != NULL) {
                 BUG_ON(sh->mpm_stream_ctx);
                 sh->mpm_stream_ctx = mpm_store->mpm_ctx;
-                if (sh->mpm_stream_ctx)
+                if (sh->mpm_stream_ctx) {
                     sh->flags |= SIG_GROUP_HEAD_MPM_STREAM;
+                    PrefilterPktStreamRegister(sh, mpm_store->mpm_ctx);
+                }
             }
        }
     } else if (SGH_PROTO(sh, IPPROTO_UDP)) {
@@ -1281,8 +1406,10 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                 BUG_ON(sh->mpm_packet_ctx);
                 sh->mpm_packet_ctx = mpm_store->mpm_ctx;
 
-                if (sh->mpm_packet_ctx != NULL)
+                if (sh->mpm_packet_ctx != NULL) {
                     sh->flags |= SIG_GROUP_HEAD_MPM_PACKET;
+                    PrefilterPktPayloadRegister(sh, mpm_store->mpm_ctx);
+                }
             }
         }
         if (SGH_DIRECTION_TC(sh)) {
@@ -1291,8 +1418,10 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
                 BUG_ON(sh->mpm_packet_ctx);
                 sh->mpm_packet_ctx = mpm_store->mpm_ctx;
 
-                if (sh->mpm_packet_ctx != NULL)
+                if (sh->mpm_packet_ctx != NULL) {
                     sh->flags |= SIG_GROUP_HEAD_MPM_PACKET;
+                    PrefilterPktPayloadRegister(sh, mpm_store->mpm_ctx);
+                }
             }
         }
     } else {
@@ -1301,23 +1430,31 @@ int PatternMatchPrepareGroup(DetectEngineCtx *de_ctx, SigGroupHead *sh)
             BUG_ON(sh->mpm_packet_ctx);
             sh->mpm_packet_ctx = mpm_store->mpm_ctx;
 
-            if (sh->mpm_packet_ctx != NULL)
+            if (sh->mpm_packet_ctx != NULL) {
                 sh->flags |= SIG_GROUP_HEAD_MPM_PACKET;
+                PrefilterPktPayloadRegister(sh, mpm_store->mpm_ctx);
+            }
         }
     }
 
+    /* app layer buffers are only inspected for tcp and udp */
+    if (!(SGH_PROTO(sh, IPPROTO_TCP) || SGH_PROTO(sh, IPPROTO_UDP)))
+        return 0;
+
     AppLayerMpms *a = app_mpms;
     while (a->name != NULL) {
-        mpm_store = MpmStorePrepareBuffer2(de_ctx, sh, a);
-        if (mpm_store != NULL) {
-            sh->init->app_mpms[a->id] = mpm_store->mpm_ctx;
-            if (sh->init->app_mpms[a->id] != NULL)
-                sh->flags |= a->flags;
+        if ((a->direction == SIG_FLAG_TOSERVER && SGH_DIRECTION_TS(sh)) ||
+            (a->direction == SIG_FLAG_TOCLIENT && SGH_DIRECTION_TC(sh)))
+        {
+            mpm_store = MpmStorePrepareBuffer2(de_ctx, sh, a);
+            if (mpm_store != NULL && mpm_store->mpm_ctx != NULL) {
+                if (a->PrefilterRegister(sh, mpm_store->mpm_ctx) != 0)
+                    return -1;
+            }
         }
         a++;
     }
 
-    MpmStoreFixup(sh);
     return 0;
 }
 
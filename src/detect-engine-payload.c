@@ -30,6 +30,8 @@
 
 #include "detect.h"
 #include "detect-engine.h"
+#include "detect-engine-prefilter.h"
+#include "detect-engine-mpm-stream.h"
 #include "detect-parse.h"
 #include "detect-engine-content-inspection.h"
 
@@ -82,6 +84,10 @@ uint32_t StreamPatternSearch(DetectEngineThreadCtx *det_ctx, const Packet *p,
 
     //PrintRawDataFp(stdout, smsg->data.data, smsg->data.data_len);
 
+    if (p->flow != NULL && DetectMpmStreamSearchRaw(det_ctx, p->flow,
+                det_ctx->sgh->mpm_stream_ctx, smsg, flags))
+        SCReturnInt(0);
+
     uint32_t r;
     for ( ; smsg != NULL; smsg = smsg->next) {
         if (smsg->data_len >= det_ctx->sgh->mpm_stream_ctx->minlen) {
@@ -138,6 +144,59 @@ uint32_t PacketPatternSearch(DetectEngineThreadCtx *det_ctx, Packet *p)
     SCReturnInt(ret);
 }
 
+/** \brief Prefilter callback for the packet mpm
+ *
+ *  Runs the packet mpm against the packet payload. Only called for
+ *  packets that have a payload to inspect.
+ */
+static void PrefilterPktPayload(DetectEngineThreadCtx *det_ctx,
+        Packet *p, const void *pectx)
+{
+    (void)PacketPatternSearch(det_ctx, p);
+}
+
+int PrefilterPktPayloadRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    return PrefilterAppendPayloadEngine(sgh, PrefilterPktPayload,
+            mpm_ctx, NULL, "payload");
+}
+
+/** \brief Prefilter callback for the stream mpm
+ *
+ *  Runs the stream mpm against the reassembled stream chunks if we
+ *  have them, and against the packet payload if it isn't part of the
+ *  reassembled data.
+ *
+ *  Registered as a packet engine as it has to run for packets without
+ *  payload as well, as those can trigger the stream reassembly.
+ */
+static void PrefilterPktStream(DetectEngineThreadCtx *det_ctx,
+        Packet *p, const void *pectx)
+{
+    SCEnter();
+
+    /* if we have stream msgs, inspect against those first */
+    if ((p->flowflags & FLOW_PKT_ESTABLISHED) && det_ctx->smsg != NULL) {
+        const uint8_t flags = (p->flowflags & FLOW_PKT_TOSERVER) ?
+            STREAM_TOSERVER : STREAM_TOCLIENT;
+        (void)StreamPatternSearch(det_ctx, p, det_ctx->smsg, flags);
+    }
+
+    /* packets that have not been added to the stream will be inspected
+     * as if they are stream chunks */
+    if (p->payload_len > 0 && !(p->flags & PKT_NOPAYLOAD_INSPECTION) &&
+        !(p->flags & PKT_STREAM_ADD))
+    {
+        (void)PacketPatternSearchWithStreamCtx(det_ctx, p);
+    }
+}
+
+int PrefilterPktStreamRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    return PrefilterAppendEngine(sgh, PrefilterPktStream,
+            mpm_ctx, NULL, "stream");
+}
+
 /**
  *  \brief Do the content inspection & validation for a signature
  *
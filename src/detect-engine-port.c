@@ -818,6 +818,119 @@ DetectPortLookupGroup(DetectPort *dp, uint16_t port)
     return NULL;
 }
 
+static int DetectPortLookupArrayCompare(const void *a, const void *b)
+{
+    const DetectPort *pa = *(const DetectPort **)a;
+    const DetectPort *pb = *(const DetectPort **)b;
+
+    if (pa->port < pb->port)
+        return -1;
+    else if (pa->port > pb->port)
+        return 1;
+    return 0;
+}
+
+/**
+ * \brief Build a sorted array for a list of port groups, to be searched
+ *        with DetectPortLookupArrayGroup instead of walking the list
+ *
+ * The grouping appends a 0:65535 group for the rules of the groups that
+ * didn't make the cut. It overlaps with all other groups and is only hit
+ * if they don't match, so it's kept out of the array as the catch all.
+ * If other groups overlap the list is walked as before.
+ *
+ * The array references the groups, so it has to be freed before the
+ * list is.
+ *
+ * \param pla array to set up
+ * \param list list of port groups
+ *
+ * \retval 0 on success
+ * \retval -1 on memory allocation error
+ */
+int DetectPortLookupArraySetup(DetectPortLookupArray *pla, DetectPort *list)
+{
+    DetectPort *p;
+    uint32_t cnt = 0;
+    uint32_t u;
+
+    memset(pla, 0, sizeof(*pla));
+    pla->list = list;
+
+    for (p = list; p != NULL; p = p->next) {
+        if (p->next == NULL && p->port == 0 && p->port2 == 65535)
+            pla->catchall = p;
+        else
+            cnt++;
+    }
+    if (cnt == 0)
+        return 0;
+
+    pla->groups = SCMalloc(cnt * sizeof(DetectPort *));
+    pla->port2 = SCMalloc(cnt * sizeof(uint16_t));
+    if (pla->groups == NULL || pla->port2 == NULL) {
+        DetectPortLookupArrayFree(pla);
+        return -1;
+    }
+
+    for (p = list, u = 0; p != NULL && p != pla->catchall; p = p->next, u++)
+        pla->groups[u] = p;
+    qsort(pla->groups, cnt, sizeof(DetectPort *), DetectPortLookupArrayCompare);
+
+    for (u = 0; u < cnt; u++) {
+        if (u > 0 && pla->groups[u]->port <= pla->groups[u - 1]->port2) {
+            SCLogDebug("port groups %u-%u and %u-%u overlap, using list",
+                    pla->groups[u - 1]->port, pla->groups[u - 1]->port2,
+                    pla->groups[u]->port, pla->groups[u]->port2);
+            DetectPortLookupArrayFree(pla);
+            pla->list = list;
+            return 0;
+        }
+        pla->port2[u] = pla->groups[u]->port2;
+    }
+    pla->cnt = cnt;
+    return 0;
+}
+
+void DetectPortLookupArrayFree(DetectPortLookupArray *pla)
+{
+    if (pla->groups != NULL)
+        SCFree(pla->groups);
+    if (pla->port2 != NULL)
+        SCFree(pla->port2);
+    memset(pla, 0, sizeof(*pla));
+}
+
+/**
+ * \brief Find the group containing a port in a lookup array
+ *
+ * Branch free binary search for the first group whose range ends at or
+ * after the port, then check that the range starts at or before it.
+ *
+ * \param pla lookup array set up by DetectPortLookupArraySetup
+ * \param port port to look up
+ *
+ * \retval Pointer to the DetectPort group of our port if it matched
+ * \retval NULL if port is not in any group
+ */
+DetectPort *DetectPortLookupArrayGroup(const DetectPortLookupArray *pla, uint16_t port)
+{
+    if (pla->cnt == 0)
+        return DetectPortLookupGroup(pla->list, port);
+
+    const uint16_t *base = pla->port2;
+    uint32_t n = pla->cnt;
+    while (n > 1) {
+        uint32_t half = n / 2;
+        base = (base[half - 1] < port) ? base + half : base;
+        n -= half;
+    }
+    uint32_t idx = (uint32_t)(base - pla->port2) + (*base < port);
+    if (idx < pla->cnt && pla->groups[idx]->port <= port)
+        return pla->groups[idx];
+    return pla->catchall;
+}
+
 /**
  * \brief Function to join the source group to the target and its members
  *
@@ -2686,6 +2799,65 @@ static int PortTestMatchDoubleNegation(void)
     return result;
 }
 
+static DetectPort *PortTestLookupArrayAdd(DetectPort **tail, uint16_t port,
+        uint16_t port2)
+{
+    DetectPort *p = DetectPortInit();
+    if (p == NULL)
+        return NULL;
+    p->port = port;
+    p->port2 = port2;
+    if (*tail != NULL)
+        (*tail)->next = p;
+    *tail = p;
+    return p;
+}
+
+/**
+ * \test check that the lookup array returns the same groups as walking
+ *       the list, for a list with a catch all group and for an
+ *       overlapping list
+ */
+static int PortTestLookupArray01(void)
+{
+    DetectPortLookupArray pla;
+    DetectPort *tail = NULL;
+    uint32_t port;
+
+    DetectPort *head = PortTestLookupArrayAdd(&tail, 1000, 2000);
+    FAIL_IF_NULL(head);
+    FAIL_IF_NULL(PortTestLookupArrayAdd(&tail, 80, 80));
+    FAIL_IF_NULL(PortTestLookupArrayAdd(&tail, 22, 25));
+    FAIL_IF_NULL(PortTestLookupArrayAdd(&tail, 65535, 65535));
+    DetectPort *all = PortTestLookupArrayAdd(&tail, 0, 65535);
+    FAIL_IF_NULL(all);
+
+    FAIL_IF(DetectPortLookupArraySetup(&pla, head) != 0);
+    FAIL_IF(pla.cnt != 4);
+    FAIL_IF(pla.catchall != all);
+    for (port = 0; port <= 65535; port++) {
+        FAIL_IF(DetectPortLookupArrayGroup(&pla, (uint16_t)port) !=
+                DetectPortLookupGroup(head, (uint16_t)port));
+    }
+    DetectPortLookupArrayFree(&pla);
+    DetectPortCleanupList(head);
+
+    tail = NULL;
+    head = PortTestLookupArrayAdd(&tail, 80, 90);
+    FAIL_IF_NULL(head);
+    FAIL_IF_NULL(PortTestLookupArrayAdd(&tail, 85, 100));
+
+    FAIL_IF(DetectPortLookupArraySetup(&pla, head) != 0);
+    FAIL_IF(pla.cnt != 0);
+    FAIL_IF(DetectPortLookupArrayGroup(&pla, 79) != NULL);
+    FAIL_IF(DetectPortLookupArrayGroup(&pla, 85) != head);
+    FAIL_IF(DetectPortLookupArrayGroup(&pla, 95) != head->next);
+    DetectPortLookupArrayFree(&pla);
+    DetectPortCleanupList(head);
+
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void DetectPortTests(void)
@@ -2733,6 +2905,7 @@ void DetectPortTests(void)
     UtRegisterTest("PortTestMatchReal18", PortTestMatchReal18);
     UtRegisterTest("PortTestMatchReal19", PortTestMatchReal19);
     UtRegisterTest("PortTestMatchDoubleNegation", PortTestMatchDoubleNegation);
+    UtRegisterTest("PortTestLookupArray01", PortTestLookupArray01);
 
 
 #endif /* UNITTESTS */
@@ -35,6 +35,10 @@ void DetectPortCleanupList (DetectPort *head);
 
 DetectPort *DetectPortLookupGroup(DetectPort *dp, uint16_t port);
 
+int DetectPortLookupArraySetup(DetectPortLookupArray *, DetectPort *);
+void DetectPortLookupArrayFree(DetectPortLookupArray *);
+DetectPort *DetectPortLookupArrayGroup(const DetectPortLookupArray *, uint16_t port);
+
 int DetectPortJoin(DetectEngineCtx *,DetectPort *target, DetectPort *source);
 
 void DetectPortPrint(DetectPort *);
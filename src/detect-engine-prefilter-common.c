@@ -0,0 +1,212 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+
+/**
+ * \file
+ *
+ * Prefilter engines for keywords inspecting a packet header value.
+ *
+ * Two setups are available:
+ *  - PrefilterSetupPacketHeader groups the rules by identical keyword
+ *    ctx and adds an engine per group. The engine checks the condition
+ *    once for the whole group.
+ *  - PrefilterSetupPacketHeaderU8Hash builds a single engine with a
+ *    lookup table of rules for each of the 256 possible values of a u8
+ *    header field. At runtime the field value selects the rules, so the
+ *    cost doesn't depend on the number of rules.
+ */
+
+#include "suricata-common.h"
+
+#include "detect.h"
+#include "detect-engine-prefilter.h"
+#include "detect-engine-prefilter-common.h"
+
+#include "util-mpm.h"
+
+/** \internal
+ *  \brief append a sig id to an array, growing it as needed */
+static int SigsArrayAdd(SigIntId **sigs, uint32_t *cnt, const SigIntId id)
+{
+    SigIntId *ptr = SCRealloc(*sigs, (*cnt + 1) * sizeof(SigIntId));
+    if (ptr == NULL)
+        return -1;
+
+    ptr[*cnt] = id;
+    *sigs = ptr;
+    (*cnt)++;
+    return 0;
+}
+
+/** \internal
+ *  \brief get the prefilter sigmatch of type sm_type for sig s
+ *  \retval sm or NULL if s doesn't use sm_type as prefilter */
+static const SigMatch *GetPrefilterSm(const Signature *s, const int sm_type)
+{
+    if (s == NULL || !(s->flags & SIG_FLAG_PREFILTER))
+        return NULL;
+    if (s->prefilter_sm == NULL || s->prefilter_sm->type != sm_type)
+        return NULL;
+    return s->prefilter_sm;
+}
+
+static void PrefilterPacketHeaderFree(void *pectx)
+{
+    PrefilterPacketHeaderCtx *ctx = pectx;
+    SCFree(ctx->sigs_array);
+    SCFree(ctx);
+}
+
+/** \brief set up prefilter engines per group of rules with the same
+ *         keyword condition
+ *
+ *  \param sm_type keyword to set up the engines for
+ *  \param Compare compare callback, returns TRUE if the ctx' are equal
+ *  \param Match prefilter callback, called with a PrefilterPacketHeaderCtx
+ *  \param name engine name
+ */
+int PrefilterSetupPacketHeader(SigGroupHead *sgh, int sm_type,
+        _Bool (*Compare)(const SigMatchCtx *a, const SigMatchCtx *b),
+        void (*Match)(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx),
+        const char *name)
+{
+    /* tracks which rules of the group have been added to an engine */
+    uint8_t *done = SCCalloc(1, sgh->sig_cnt);
+    if (done == NULL && sgh->sig_cnt > 0)
+        return -1;
+
+    uint32_t sig;
+    for (sig = 0; sig < sgh->sig_cnt; sig++) {
+        if (done[sig])
+            continue;
+        const Signature *s = sgh->match_array[sig];
+        const SigMatch *sm = GetPrefilterSm(s, sm_type);
+        if (sm == NULL)
+            continue;
+
+        PrefilterPacketHeaderCtx *ctx = SCCalloc(1, sizeof(*ctx));
+        if (ctx == NULL)
+            goto error;
+        ctx->smctx = sm->ctx;
+
+        /* add this rule and all others with the same condition */
+        uint32_t i;
+        for (i = sig; i < sgh->sig_cnt; i++) {
+            if (done[i])
+                continue;
+            const SigMatch *osm = GetPrefilterSm(sgh->match_array[i], sm_type);
+            if (osm == NULL || !Compare(ctx->smctx, osm->ctx))
+                continue;
+
+            if (SigsArrayAdd(&ctx->sigs_array, &ctx->sigs_cnt,
+                        sgh->match_array[i]->num) != 0) {
+                PrefilterPacketHeaderFree(ctx);
+                goto error;
+            }
+            done[i] = 1;
+        }
+
+        SCLogDebug("%s: %u rules share condition of sid %u",
+                name, ctx->sigs_cnt, s->id);
+
+        if (PrefilterAppendEngine(sgh, Match, ctx,
+                    PrefilterPacketHeaderFree, name) != 0) {
+            PrefilterPacketHeaderFree(ctx);
+            goto error;
+        }
+    }
+
+    SCFree(done);
+    return 0;
+error:
+    SCFree(done);
+    return -1;
+}
+
+static void PrefilterPacketU8HashFree(void *pectx)
+{
+    PrefilterPacketU8HashCtx *ctx = pectx;
+    int i;
+    for (i = 0; i < 256; i++) {
+        SigsArray *sa = ctx->array[i];
+        if (sa == NULL)
+            continue;
+        SCFree(sa->sigs);
+        SCFree(sa);
+    }
+    SCFree(ctx);
+}
+
+/** \brief set up a prefilter engine using a lookup table on a u8 value
+ *
+ *  For each rule using sm_type as prefilter, the rule is added to the
+ *  table entry of each value for which ValueMatch returns TRUE.
+ *
+ *  \param sm_type keyword to set up the engine for
+ *  \param ValueMatch check if the keyword ctx matches a value
+ *  \param Match prefilter callback, called with a PrefilterPacketU8HashCtx
+ *  \param name engine name
+ */
+int PrefilterSetupPacketHeaderU8Hash(SigGroupHead *sgh, int sm_type,
+        _Bool (*ValueMatch)(const SigMatchCtx *smctx, const uint8_t value),
+        void (*Match)(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx),
+        const char *name)
+{
+    PrefilterPacketU8HashCtx *ctx = NULL;
+    uint32_t sig;
+
+    for (sig = 0; sig < sgh->sig_cnt; sig++) {
+        const Signature *s = sgh->match_array[sig];
+        const SigMatch *sm = GetPrefilterSm(s, sm_type);
+        if (sm == NULL)
+            continue;
+
+        if (ctx == NULL) {
+            ctx = SCCalloc(1, sizeof(*ctx));
+            if (ctx == NULL)
+                return -1;
+        }
+
+        int v;
+        for (v = 0; v < 256; v++) {
+            if (!ValueMatch(sm->ctx, (uint8_t)v))
+                continue;
+
+            if (ctx->array[v] == NULL) {
+                ctx->array[v] = SCCalloc(1, sizeof(SigsArray));
+                if (ctx->array[v] == NULL)
+                    goto error;
+            }
+            if (SigsArrayAdd(&ctx->array[v]->sigs, &ctx->array[v]->cnt,
+                        s->num) != 0)
+                goto error;
+        }
+    }
+
+    /* no rules in this group use the keyword */
+    if (ctx == NULL)
+        return 0;
+
+    if (PrefilterAppendEngine(sgh, Match, ctx,
+                PrefilterPacketU8HashFree, name) != 0)
+        goto error;
+    return 0;
+error:
+    PrefilterPacketU8HashFree(ctx);
+    return -1;
+}
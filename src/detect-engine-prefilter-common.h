@@ -0,0 +1,77 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+
+/**
+ * \file
+ *
+ * Helpers for keywords that use a packet header value as prefilter.
+ */
+
+#ifndef __DETECT_ENGINE_PREFILTER_COMMON_H__
+#define __DETECT_ENGINE_PREFILTER_COMMON_H__
+
+/** rules sharing the same prefilter condition */
+typedef struct PrefilterPacketHeaderCtx_ {
+    /** sigmatch ctx of the first rule, describes the condition
+     *  for all rules in the array */
+    const SigMatchCtx *smctx;
+
+    uint32_t sigs_cnt;
+    SigIntId *sigs_array;
+} PrefilterPacketHeaderCtx;
+
+typedef struct SigsArray_ {
+    uint32_t cnt;
+    SigIntId *sigs;
+} SigsArray;
+
+/** rules per u8 value of a packet header field */
+typedef struct PrefilterPacketU8HashCtx_ {
+    SigsArray *array[256];
+} PrefilterPacketU8HashCtx;
+
+int PrefilterSetupPacketHeader(SigGroupHead *sgh, int sm_type,
+        _Bool (*Compare)(const SigMatchCtx *a, const SigMatchCtx *b),
+        void (*Match)(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx),
+        const char *name);
+
+int PrefilterSetupPacketHeaderU8Hash(SigGroupHead *sgh, int sm_type,
+        _Bool (*ValueMatch)(const SigMatchCtx *smctx, const uint8_t value),
+        void (*Match)(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx),
+        const char *name);
+
+/** \brief add the rules of a packet header ctx to the candidates */
+static inline void
+PrefilterPacketHeaderAddSids(DetectEngineThreadCtx *det_ctx,
+        const PrefilterPacketHeaderCtx *ctx)
+{
+    MpmAddSids(&det_ctx->pmq, ctx->sigs_array, ctx->sigs_cnt);
+}
+
+/** \brief add the rules for u8 value 'value' to the candidates */
+static inline void
+PrefilterPacketU8HashAddSids(DetectEngineThreadCtx *det_ctx,
+        const PrefilterPacketU8HashCtx *ctx, const uint8_t value)
+{
+    const SigsArray *sa = ctx->array[value];
+    if (sa != NULL) {
+        MpmAddSids(&det_ctx->pmq, sa->sigs, sa->cnt);
+    }
+}
+
+#endif /* __DETECT_ENGINE_PREFILTER_COMMON_H__ */
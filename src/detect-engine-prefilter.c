@@ -0,0 +1,468 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Prefilter engines per rule group.
+ *
+ * Each rule group (SigGroupHead) gets a list of prefilter engines for
+ * the buffers and keywords its signatures use. At runtime only the
+ * engines that are present are run, each through its own callback.
+ * Engines add the internal ids of the candidate signatures to the
+ * pmq, which is then merged with the non-prefilter (non-mpm) list.
+ *
+ * There are 3 types of engines:
+ *  - packet engines: run on every packet (e.g. ttl, flags, stream mpm)
+ *  - payload engines: run on packets with payload (packet mpm)
+ *  - tx engines: run per transaction of the flow's app layer state
+ *    once the tx reached the engine's minimal progress (e.g. http_uri)
+ *
+ * Engines are registered during rule group setup through the
+ * PrefilterAppend*Engine functions and converted into arrays for cache
+ * friendly access at runtime.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+
+#include "detect.h"
+#include "detect-engine.h"
+#include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
+
+#include "app-layer-parser.h"
+
+#include "util-profiling.h"
+
+static int PrefilterEngineListAppend(PrefilterEngineList **list,
+        PrefilterEngineList *e)
+{
+    if (*list == NULL) {
+        e->id = 0;
+        *list = e;
+    } else {
+        PrefilterEngineList *t = *list;
+        while (t->next != NULL) {
+            t = t->next;
+        }
+        e->id = t->id + 1;
+        t->next = e;
+    }
+    return 0;
+}
+
+int PrefilterAppendEngine(SigGroupHead *sgh,
+        void (*PrefilterFunc)(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx),
+        void *pectx, void (*FreeFunc)(void *pectx),
+        const char *name)
+{
+    if (sgh == NULL || PrefilterFunc == NULL || pectx == NULL)
+        return -1;
+
+    PrefilterEngineList *e = SCCalloc(1, sizeof(*e));
+    if (e == NULL)
+        return -1;
+
+    e->Prefilter = PrefilterFunc;
+    e->pectx = pectx;
+    e->Free = FreeFunc;
+    e->name = name;
+
+    return PrefilterEngineListAppend(&sgh->init->pkt_engines, e);
+}
+
+int PrefilterAppendPayloadEngine(SigGroupHead *sgh,
+        void (*PrefilterFunc)(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx),
+        void *pectx, void (*FreeFunc)(void *pectx),
+        const char *name)
+{
+    if (sgh == NULL || PrefilterFunc == NULL || pectx == NULL)
+        return -1;
+
+    PrefilterEngineList *e = SCCalloc(1, sizeof(*e));
+    if (e == NULL)
+        return -1;
+
+    e->Prefilter = PrefilterFunc;
+    e->pectx = pectx;
+    e->Free = FreeFunc;
+    e->name = name;
+
+    return PrefilterEngineListAppend(&sgh->init->payload_engines, e);
+}
+
+int PrefilterAppendTxEngine(SigGroupHead *sgh,
+        void (*PrefilterTxFunc)(DetectEngineThreadCtx *det_ctx, const void *pectx,
+            Packet *p, Flow *f, void *tx,
+            const uint64_t idx, const uint8_t flags),
+        AppProto alproto, uint8_t direction, int tx_min_progress,
+        void *pectx, void (*FreeFunc)(void *pectx),
+        const char *name)
+{
+    if (sgh == NULL || PrefilterTxFunc == NULL || pectx == NULL)
+        return -1;
+
+    PrefilterEngineList *e = SCCalloc(1, sizeof(*e));
+    if (e == NULL)
+        return -1;
+
+    e->PrefilterTx = PrefilterTxFunc;
+    e->pectx = pectx;
+    e->alproto = alproto;
+    e->direction = direction;
+    e->tx_min_progress = tx_min_progress;
+    e->Free = FreeFunc;
+    e->name = name;
+
+    return PrefilterEngineListAppend(&sgh->init->tx_engines, e);
+}
+
+static void PrefilterFreeEngineList(PrefilterEngineList *e)
+{
+    if (e->Free && e->pectx) {
+        e->Free(e->pectx);
+    }
+    SCFree(e);
+}
+
+/** \brief free a list of engines and their ctx' */
+void PrefilterFreeEnginesList(PrefilterEngineList *list)
+{
+    PrefilterEngineList *t = list;
+
+    while (t != NULL) {
+        PrefilterEngineList *next = t->next;
+        PrefilterFreeEngineList(t);
+        t = next;
+    }
+}
+
+static void PrefilterFreeEngines(PrefilterEngine *list)
+{
+    PrefilterEngine *t = list;
+
+    while (1) {
+        if (t->Free && t->pectx) {
+            t->Free(t->pectx);
+        }
+        if (t->is_last)
+            break;
+        t++;
+    }
+    SCFree(list);
+}
+
+void PrefilterCleanupRuleGroup(SigGroupHead *sgh)
+{
+    if (sgh->pkt_engines) {
+        PrefilterFreeEngines(sgh->pkt_engines);
+        sgh->pkt_engines = NULL;
+    }
+    if (sgh->payload_engines) {
+        PrefilterFreeEngines(sgh->payload_engines);
+        sgh->payload_engines = NULL;
+    }
+    if (sgh->tx_engines) {
+        PrefilterFreeEngines(sgh->tx_engines);
+        sgh->tx_engines = NULL;
+    }
+}
+
+/** \internal
+ *  \brief convert a list of engines into an array
+ *
+ *  The ctx' are handed over to the array and the list is freed.
+ *
+ *  \retval array or NULL if the list is empty or on alloc failure
+ */
+static PrefilterEngine *PrefilterEngineListToArray(PrefilterEngineList **list)
+{
+    PrefilterEngineList *el;
+    uint32_t cnt = 0;
+
+    for (el = *list; el != NULL; el = el->next) {
+        cnt++;
+    }
+    if (cnt == 0)
+        return NULL;
+
+    PrefilterEngine *engines = SCCalloc(cnt, sizeof(PrefilterEngine));
+    if (engines == NULL)
+        return NULL;
+
+    PrefilterEngine *e = engines;
+    el = *list;
+    while (el != NULL) {
+        PrefilterEngineList *next = el->next;
+
+        e->id = el->id;
+        e->alproto = el->alproto;
+        e->direction = el->direction;
+        e->tx_min_progress = el->tx_min_progress;
+        e->pectx = el->pectx;
+        if (el->Prefilter != NULL)
+            e->cb.Prefilter = el->Prefilter;
+        else
+            e->cb.PrefilterTx = el->PrefilterTx;
+        e->Free = el->Free;
+        e->name = el->name;
+        e->is_last = (next == NULL);
+
+        SCFree(el);
+        el = next;
+        e++;
+    }
+    *list = NULL;
+    return engines;
+}
+
+/** \brief set up the prefilter engines for a rule group
+ *
+ *  Registers the mpm engines and, if enabled, the keyword based engines
+ *  and then converts the engine lists into the runtime arrays.
+ */
+int PrefilterSetupRuleGroup(DetectEngineCtx *de_ctx, SigGroupHead *sgh)
+{
+    if (PatternMatchPrepareGroup(de_ctx, sgh) != 0)
+        return -1;
+
+    if (de_ctx->prefilter_setting == DETECT_PREFILTER_AUTO) {
+        int i;
+        for (i = 0; i < DETECT_TBLSIZE; i++) {
+            if (sigmatch_table[i].SetupPrefilter != NULL) {
+                if (sigmatch_table[i].SetupPrefilter(sgh) != 0)
+                    return -1;
+            }
+        }
+    }
+
+    /* large groups merge their candidates through a bitmap: the cost of
+     * that doesn't depend on the number of candidates, while sorting them
+     * gets expensive for groups that have many rules with common
+     * patterns. */
+    if (de_ctx->prefilter_bitmap_threshold > 0 &&
+        sgh->sig_cnt >= de_ctx->prefilter_bitmap_threshold)
+    {
+        SCLogDebug("sgh %p: %u rules, using candidate bitmap",
+                sgh, sgh->sig_cnt);
+        sgh->flags |= SIG_GROUP_HEAD_PREFILTER_BITMAP;
+    }
+
+    /* convert lists to prefilter engine arrays */
+    if (sgh->init->pkt_engines != NULL) {
+        sgh->pkt_engines = PrefilterEngineListToArray(&sgh->init->pkt_engines);
+        if (sgh->pkt_engines == NULL)
+            return -1;
+    }
+    if (sgh->init->payload_engines != NULL) {
+        sgh->payload_engines = PrefilterEngineListToArray(&sgh->init->payload_engines);
+        if (sgh->payload_engines == NULL)
+            return -1;
+    }
+    if (sgh->init->tx_engines != NULL) {
+        sgh->tx_engines = PrefilterEngineListToArray(&sgh->init->tx_engines);
+        if (sgh->tx_engines == NULL)
+            return -1;
+    }
+    return 0;
+}
+
+/** \brief pick the prefilter keyword for a signature
+ *
+ *  Only signatures without a fast_pattern are considered: sigs with
+ *  a fast_pattern get their prefiltering from the mpm. The first keyword
+ *  in the packet match list that supports prefiltering is used.
+ */
+void PrefilterSetupSignature(const DetectEngineCtx *de_ctx, Signature *s)
+{
+    if (de_ctx->prefilter_setting != DETECT_PREFILTER_AUTO)
+        return;
+    if (s->mpm_sm != NULL || (s->flags & SIG_FLAG_IPONLY))
+        return;
+
+    SigMatch *sm = s->sm_lists[DETECT_SM_LIST_MATCH];
+    for ( ; sm != NULL; sm = sm->next) {
+        if (sigmatch_table[sm->type].SupportsPrefilter == NULL)
+            continue;
+        if (sigmatch_table[sm->type].SupportsPrefilter(s) == TRUE) {
+            SCLogDebug("sid %u: using keyword %s as prefilter",
+                    s->id, sigmatch_table[sm->type].name);
+            s->prefilter_sm = sm;
+            s->flags |= SIG_FLAG_PREFILTER;
+            break;
+        }
+    }
+}
+
+/** \brief find an engine by name
+ *  \retval engine or NULL if not found */
+const PrefilterEngine *PrefilterFindEngine(const PrefilterEngine *engines,
+        const char *name)
+{
+    const PrefilterEngine *e = engines;
+    if (e == NULL)
+        return NULL;
+
+    while (1) {
+        if (e->name != NULL && strcmp(e->name, name) == 0)
+            return e;
+        if (e->is_last)
+            break;
+        e++;
+    }
+    return NULL;
+}
+
+/** \internal
+ *  \brief run the tx engines for each of the inspectable txs of a flow
+ */
+static void PrefilterTxEngines(DetectEngineThreadCtx *det_ctx,
+        const SigGroupHead *sgh, Packet *p, const uint8_t flags,
+        const AppProto alproto)
+{
+    Flow *f = p->flow;
+    void *alstate = FlowGetAppState(f);
+    if (alstate == NULL)
+        return;
+
+    /* quickly check if we have any engine for this alproto and
+     * direction, if not we can bail early */
+    const PrefilterEngine *first = sgh->tx_engines;
+    while (first->alproto != alproto || !(first->direction & flags)) {
+        if (first->is_last)
+            return;
+        first++;
+    }
+
+    const uint8_t ipproto = f->proto;
+    uint64_t idx = AppLayerParserGetTransactionInspectId(f->alparser, flags);
+    const uint64_t total_txs = AppLayerParserGetTxCnt(ipproto, alproto, alstate);
+
+    for ( ; idx < total_txs; idx++) {
+        void *tx = AppLayerParserGetTx(ipproto, alproto, alstate, idx);
+        if (tx == NULL)
+            continue;
+
+        const int tx_progress = AppLayerParserGetStateProgress(ipproto, alproto, tx, flags);
+
+        const PrefilterEngine *engine = first;
+        while (1) {
+            if (engine->alproto == alproto &&
+                (engine->direction & flags) &&
+                tx_progress >= engine->tx_min_progress)
+            {
+                engine->cb.PrefilterTx(det_ctx, engine->pectx,
+                        p, f, tx, idx, flags);
+            }
+            if (engine->is_last)
+                break;
+            engine++;
+        }
+    }
+}
+
+/** \internal
+ *  \brief sort the sids smallest to largest */
+static void QuickSortSigIntId(SigIntId *sids, uint32_t n)
+{
+    if (n < 2)
+        return;
+    SigIntId p = sids[n / 2];
+    SigIntId *l = sids;
+    SigIntId *r = sids + n - 1;
+    while (l <= r) {
+        if (*l < p)
+            l++;
+        else if (*r > p)
+            r--;
+        else {
+            SigIntId t = *l;
+            *l = *r;
+            *r = t;
+            l++;
+            r--;
+        }
+    }
+    QuickSortSigIntId(sids, r - sids + 1);
+    QuickSortSigIntId(l, sids + n - l);
+}
+
+/**
+ *  \brief run the prefilter engines of a rule group
+ *
+ *  \param det_ctx   detection engine thread ctx
+ *  \param sgh       rule group to run the engines of
+ *  \param p         packet
+ *  \param flags     STREAM_* flags
+ *  \param alproto   flow's alproto
+ *  \param has_state bool indicating we have (al)state
+ */
+void Prefilter(DetectEngineThreadCtx *det_ctx, const SigGroupHead *sgh,
+        Packet *p, const uint8_t flags, const AppProto alproto,
+        const int has_state)
+{
+    SCEnter();
+
+    /* run packet engines */
+    const PrefilterEngine *engine = sgh->pkt_engines;
+    if (engine != NULL) {
+        PACKET_PROFILING_DETECT_START(p, PROF_DETECT_PF_PKT);
+        while (1) {
+            engine->cb.Prefilter(det_ctx, p, engine->pectx);
+            if (engine->is_last)
+                break;
+            engine++;
+        }
+        PACKET_PROFILING_DETECT_END(p, PROF_DETECT_PF_PKT);
+    }
+
+    /* run payload inspecting engines */
+    engine = sgh->payload_engines;
+    if (engine != NULL && p->payload_len > 0 &&
+        !(p->flags & PKT_NOPAYLOAD_INSPECTION))
+    {
+        PACKET_PROFILING_DETECT_START(p, PROF_DETECT_PF_PAYLOAD);
+        while (1) {
+            engine->cb.Prefilter(det_ctx, p, engine->pectx);
+            if (engine->is_last)
+                break;
+            engine++;
+        }
+        PACKET_PROFILING_DETECT_END(p, PROF_DETECT_PF_PAYLOAD);
+    }
+
+    /* run tx engines */
+    if (sgh->tx_engines != NULL && has_state && p->flow != NULL) {
+        PACKET_PROFILING_DETECT_START(p, PROF_DETECT_PF_TX);
+        PrefilterTxEngines(det_ctx, sgh, p, flags, alproto);
+        PACKET_PROFILING_DETECT_END(p, PROF_DETECT_PF_TX);
+    }
+
+    /* Sort the rule list to lets look at pmq.
+     * NOTE due to merging of 'stream' pmqs we *MAY* have duplicate entries
+     * Groups using the candidate bitmap don't need a sorted list. */
+    if (likely(det_ctx->pmq.rule_id_array_cnt > 1) &&
+        !(sgh->flags & SIG_GROUP_HEAD_PREFILTER_BITMAP))
+    {
+        PACKET_PROFILING_DETECT_START(p, PROF_DETECT_PF_SORT);
+        QuickSortSigIntId(det_ctx->pmq.rule_id_array, det_ctx->pmq.rule_id_array_cnt);
+        PACKET_PROFILING_DETECT_END(p, PROF_DETECT_PF_SORT);
+    }
+
+    SCReturn;
+}
@@ -36,6 +36,7 @@
 #include "detect-engine-address.h"
 #include "detect-engine-mpm.h"
 #include "detect-engine-siggroup.h"
+#include "detect-engine-prefilter.h"
 
 #include "detect-content.h"
 #include "detect-uricontent.h"
@@ -60,6 +61,10 @@ void SigGroupHeadInitDataFree(SigGroupHeadInitData *sghid)
         SCFree(sghid->sig_array);
         sghid->sig_array = NULL;
     }
+    PrefilterFreeEnginesList(sghid->tx_engines);
+    PrefilterFreeEnginesList(sghid->pkt_engines);
+    PrefilterFreeEnginesList(sghid->payload_engines);
+
     SCFree(sghid);
 }
 
@@ -163,8 +168,15 @@ void SigGroupHeadFree(SigGroupHead *sgh)
         sgh->non_mpm_syn_store_cnt = 0;
     }
 
+    if (sgh->pcre_hs_groups != NULL) {
+        SCFree(sgh->pcre_hs_groups);
+        sgh->pcre_hs_groups = NULL;
+    }
+
     sgh->sig_cnt = 0;
 
+    PrefilterCleanupRuleGroup(sgh);
+
     if (sgh->init != NULL) {
         SigGroupHeadInitDataFree(sgh->init);
         sgh->init = NULL;
@@ -694,6 +706,9 @@ int SigGroupHeadBuildNonMpmArray(DetectEngineCtx *de_ctx, SigGroupHead *sgh)
         s = sgh->match_array[sig];
         if (s == NULL)
             continue;
+        /* sigs with a keyword prefilter get added by their engine */
+        if (s->flags & SIG_FLAG_PREFILTER)
+            continue;
 
         if (s->mpm_sm == NULL || (s->flags & SIG_FLAG_MPM_NEG)) {
             if (!(DetectFlagsSignatureNeedsSynPackets(s))) {
@@ -725,6 +740,9 @@ int SigGroupHeadBuildNonMpmArray(DetectEngineCtx *de_ctx, SigGroupHead *sgh)
         s = sgh->match_array[sig];
         if (s == NULL)
             continue;
+        /* sigs with a keyword prefilter get added by their engine */
+        if (s->flags & SIG_FLAG_PREFILTER)
+            continue;
 
         if (s->mpm_sm == NULL || (s->flags & SIG_FLAG_MPM_NEG)) {
             if (!(DetectFlagsSignatureNeedsSynPackets(s))) {
@@ -1270,9 +1288,9 @@ static int SigGroupHeadTest11(void)
         goto end;
     }
 
-    /* check if hcbd flag is set in sgh */
-    if (!(sgh->flags & SIG_GROUP_HEAD_MPM_HCBD)) {
-        printf("sgh has not SIG_GROUP_HEAD_MPM_HCBD flag set: ");
+    /* check if the hcbd prefilter engine is set up in sgh */
+    if (PrefilterFindEngine(sgh->tx_engines, "http_client_body") == NULL) {
+        printf("sgh has no http_client_body prefilter engine: ");
         goto end;
     }
 
@@ -31,6 +31,7 @@
 #include "detect-parse.h"
 #include "detect-engine-sigorder.h"
 #include "detect-pcre.h"
+#include "conf.h"
 
 #include "util-unittest.h"
 #include "util-unittest-helper.h"
@@ -485,6 +486,211 @@ static inline void SCSigProcessUserDataForIPPairbits(SCSigSignatureWrapper *sw)
     sw->user[SC_RADIX_USER_DATA_IPPAIRBITS] = SCSigGetXbitsType(sw->sig, VAR_TYPE_IPPAIR_BIT);
 }
 
+/**
+ * \brief Static estimate of the cost of inspecting a keyword, in the
+ *        order of magnitude of cpu ticks, so that it can be mixed with
+ *        the averages from a rule profile.
+ */
+static inline int SCSigGetKeywordCost(const SigMatch *sm)
+{
+    switch (sm->type) {
+        case DETECT_LUA:
+            return 5000;
+        case DETECT_FILEMAGIC:
+            return 2000;
+        case DETECT_PCRE:
+        case DETECT_BASE64_DECODE:
+        case DETECT_ASN1:
+            return 1000;
+        case DETECT_FILEMD5:
+        case DETECT_FILESHA1:
+        case DETECT_FILESHA256:
+            return 200;
+        case DETECT_CONTENT:
+        case DETECT_IPREP:
+        case DETECT_GEOIP:
+            return 100;
+        case DETECT_BYTETEST:
+        case DETECT_BYTEJUMP:
+        case DETECT_BYTE_EXTRACT:
+            return 50;
+        default:
+            return 10;
+    }
+}
+
+/**
+ * \brief Returns the estimated inspection cost of the signature: the sum
+ *        of the cost of its keywords, plus a setup cost for every buffer
+ *        other than the packet and the payload.
+ *
+ * \param sig Pointer to the Signature
+ *
+ * \retval cost estimated cost
+ */
+static inline int SCSigGetCost(const Signature *sig)
+{
+    int cost = 0;
+    int list;
+
+    for (list = 0; list < DETECT_SM_LIST_DETECT_MAX; list++) {
+        const SigMatch *sm = sig->sm_lists[list];
+        if (sm == NULL)
+            continue;
+
+        if (list != DETECT_SM_LIST_MATCH && list != DETECT_SM_LIST_PMATCH)
+            cost += 50;
+
+        for ( ; sm != NULL; sm = sm->next)
+            cost += SCSigGetKeywordCost(sm);
+    }
+    return cost;
+}
+
+/**
+ * \brief Measured cost of a rule, as read from a rule profiling dump.
+ */
+typedef struct SCSigOrderCost_ {
+    uint32_t gid;
+    uint32_t sid;
+    int cost;
+} SCSigOrderCost;
+
+static int SCSigOrderCostCompare(const void *a, const void *b)
+{
+    const SCSigOrderCost *c0 = a;
+    const SCSigOrderCost *c1 = b;
+    if (c0->gid != c1->gid)
+        return c0->gid < c1->gid ? -1 : 1;
+    if (c0->sid != c1->sid)
+        return c0->sid < c1->sid ? -1 : 1;
+    return 0;
+}
+
+#ifdef HAVE_LIBJANSSON
+/**
+ * \brief Load the average ticks per rule from the json rule profiling
+ *        output of a previous run. The file may contain several dumps
+ *        when it was appended to, the last one is used.
+ *
+ * \param filename rule profiling json file
+ * \param cnt      set to the number of entries returned
+ *
+ * \retval costs array sorted by gid and sid, NULL on error
+ */
+static SCSigOrderCost *SCSigOrderLoadCostProfile(const char *filename, uint32_t *cnt)
+{
+    SCSigOrderCost *costs = NULL;
+    json_t *profile = NULL;
+    char *buf = NULL;
+    long len;
+
+    *cnt = 0;
+
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        SCLogWarning(SC_ERR_FOPEN, "failed to open rule cost profile %s: %s",
+                filename, strerror(errno));
+        return NULL;
+    }
+    if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) <= 0 ||
+            fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    buf = SCMalloc(len);
+    if (unlikely(buf == NULL)) {
+        fclose(fp);
+        return NULL;
+    }
+    if (fread(buf, 1, len, fp) != (size_t)len) {
+        SCFree(buf);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+
+    size_t offset = 0;
+    while (offset < (size_t)len) {
+        json_error_t error;
+        json_t *js = json_loadb(buf + offset, len - offset,
+                JSON_DISABLE_EOF_CHECK, &error);
+        if (js == NULL)
+            break;
+        offset += error.position;
+
+        if (json_is_array(json_object_get(js, "rules"))) {
+            if (profile != NULL)
+                json_decref(profile);
+            profile = js;
+        } else {
+            json_decref(js);
+        }
+        if (error.position == 0)
+            break;
+    }
+    SCFree(buf);
+
+    if (profile == NULL) {
+        SCLogWarning(SC_ERR_INVALID_ARGUMENT, "no rule profiling data "
+                "found in %s", filename);
+        return NULL;
+    }
+
+    json_t *rules = json_object_get(profile, "rules");
+    size_t size = json_array_size(rules);
+    if (size > 0)
+        costs = SCMalloc(size * sizeof(SCSigOrderCost));
+    if (costs != NULL) {
+        size_t i;
+        uint32_t n = 0;
+        for (i = 0; i < size; i++) {
+            json_t *rule = json_array_get(rules, i);
+            json_t *sid = json_object_get(rule, "signature_id");
+            json_t *gid = json_object_get(rule, "gid");
+            json_t *ticks = json_object_get(rule, "ticks_avg");
+            if (!json_is_integer(sid) || !json_is_integer(ticks))
+                continue;
+
+            costs[n].sid = (uint32_t)json_integer_value(sid);
+            costs[n].gid = json_is_integer(gid) ? (uint32_t)json_integer_value(gid) : 1;
+            costs[n].cost = (int)MIN(json_integer_value(ticks), INT_MAX);
+            n++;
+        }
+        qsort(costs, n, sizeof(SCSigOrderCost), SCSigOrderCostCompare);
+        *cnt = n;
+        SCLogConfig("loaded the measured cost of %u rules from %s", n, filename);
+    }
+    json_decref(profile);
+    return costs;
+}
+#endif /* HAVE_LIBJANSSON */
+
+/**
+ * \brief Processes the cost for this signature and caches it for future
+ *        use. The measured cost from the profile is used if the rule is in
+ *        it, the static estimate otherwise.
+ *
+ * \param sw        The sigwrapper/signature for which the cost has to be
+ *                  cached
+ * \param costs     sorted measured costs, can be NULL
+ * \param costs_cnt number of measured costs
+ */
+static inline void SCSigProcessUserDataForCost(SCSigSignatureWrapper *sw,
+        const SCSigOrderCost *costs, uint32_t costs_cnt)
+{
+    if (costs != NULL) {
+        SCSigOrderCost key = { .gid = sw->sig->gid, .sid = sw->sig->id, .cost = 0 };
+        const SCSigOrderCost *c = bsearch(&key, costs, costs_cnt,
+                sizeof(SCSigOrderCost), SCSigOrderCostCompare);
+        if (c != NULL) {
+            sw->user[SC_RADIX_USER_DATA_COST] = c->cost;
+            return;
+        }
+    }
+    sw->user[SC_RADIX_USER_DATA_COST] = SCSigGetCost(sw->sig);
+}
+
 /* Return 1 if sw1 comes before sw2 in the final list. */
 static int SCSigLessThan(SCSigSignatureWrapper *sw1,
                          SCSigSignatureWrapper *sw2,
@@ -673,6 +879,21 @@ static int SCSigOrderByPriorityCompare(SCSigSignatureWrapper *sw1,
     return sw2->sig->prio - sw1->sig->prio;
 }
 
+/**
+ * \brief Orders an incoming Signature based on its inspection cost, cheap
+ *        signatures first
+ *
+ * \param de_ctx Pointer to the detection engine context from which the
+ *               signatures have to be ordered.
+ * \param sw     The new signature that has to be ordered based on its cost
+ */
+static int SCSigOrderByCostCompare(SCSigSignatureWrapper *sw1,
+                                   SCSigSignatureWrapper *sw2)
+{
+    return sw2->user[SC_RADIX_USER_DATA_COST] -
+        sw1->user[SC_RADIX_USER_DATA_COST];
+}
+
 /**
  * \brief Creates a Wrapper around the Signature
  *
@@ -714,12 +935,26 @@ void SCSigOrderSignatures(DetectEngineCtx *de_ctx)
     SCSigSignatureWrapper *sigw = NULL;
     SCSigSignatureWrapper *sigw_list = NULL;
 
+    SCSigOrderCost *costs = NULL;
+    uint32_t costs_cnt = 0;
+
     int i = 0;
     SCLogDebug("ordering signatures in memory");
 
+#ifdef HAVE_LIBJANSSON
+    char *cost_profile = NULL;
+    if (de_ctx->sig_order_cost &&
+            ConfGet("detect.sig-order.cost-profile", &cost_profile) == 1 &&
+            cost_profile != NULL) {
+        costs = SCSigOrderLoadCostProfile(cost_profile, &costs_cnt);
+    }
+#endif
+
     sig = de_ctx->sig_list;
     while (sig != NULL) {
         sigw = SCSigAllocSignatureWrapper(sig);
+        if (de_ctx->sig_order_cost)
+            SCSigProcessUserDataForCost(sigw, costs, costs_cnt);
         /* Push signature wrapper onto a list, order doesn't matter here. */
         sigw->next = sigw_list;
         sigw_list = sigw;
@@ -728,6 +963,9 @@ void SCSigOrderSignatures(DetectEngineCtx *de_ctx)
         i++;
     }
 
+    if (costs != NULL)
+        SCFree(costs);
+
     /* Sort the list */
     sigw_list = SCSigOrder(sigw_list, de_ctx->sc_sig_order_funcs);
 
@@ -780,6 +1018,9 @@ void SCSigRegisterSignatureOrderingFuncs(DetectEngineCtx *de_ctx)
     SCSigRegisterSignatureOrderingFunc(de_ctx, SCSigOrderByHostbitsCompare);
     SCSigRegisterSignatureOrderingFunc(de_ctx, SCSigOrderByIPPairbitsCompare);
     SCSigRegisterSignatureOrderingFunc(de_ctx, SCSigOrderByPriorityCompare);
+    /* only reorders signatures that are equal for all of the above */
+    if (de_ctx->sig_order_cost)
+        SCSigRegisterSignatureOrderingFunc(de_ctx, SCSigOrderByCostCompare);
 }
 
 /**
@@ -2179,6 +2420,39 @@ end:
     return result;
 }
 
+static int SCSigOrderingTest14(void)
+{
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->sig_order_cost = 1;
+
+    Signature *sig = DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any (content:\"abc\"; pcre:\"/abc/R\"; sid:1;)");
+    FAIL_IF_NULL(sig);
+    sig = DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any (content:\"abc\"; sid:2;)");
+    FAIL_IF_NULL(sig);
+    sig = DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any (content:\"abc\"; byte_test:1,=,1,0,relative; sid:3;)");
+    FAIL_IF_NULL(sig);
+    /* pcre, but dropping comes first */
+    sig = DetectEngineAppendSig(de_ctx, "drop tcp any any -> any any (content:\"abc\"; pcre:\"/abc/R\"; sid:4;)");
+    FAIL_IF_NULL(sig);
+
+    SCSigRegisterSignatureOrderingFuncs(de_ctx);
+    SCSigOrderSignatures(de_ctx);
+    SCSigSignatureOrderingModuleCleanup(de_ctx);
+
+    sig = de_ctx->sig_list;
+    FAIL_IF_NOT(sig->id == 4);
+    sig = sig->next;
+    FAIL_IF_NOT(sig->id == 2);
+    sig = sig->next;
+    FAIL_IF_NOT(sig->id == 3);
+    sig = sig->next;
+    FAIL_IF_NOT(sig->id == 1);
+
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
 #endif
 
 void SCSigRegisterSignatureOrderingTests(void)
@@ -2198,5 +2472,6 @@ void SCSigRegisterSignatureOrderingTests(void)
     UtRegisterTest("SCSigOrderingTest11", SCSigOrderingTest11);
     UtRegisterTest("SCSigOrderingTest12", SCSigOrderingTest12);
     UtRegisterTest("SCSigOrderingTest13", SCSigOrderingTest13);
+    UtRegisterTest("SCSigOrderingTest14", SCSigOrderingTest14);
 #endif
 }
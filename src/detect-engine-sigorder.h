@@ -35,6 +35,7 @@ typedef enum{
     SC_RADIX_USER_DATA_FLOWINT,
     SC_RADIX_USER_DATA_HOSTBITS,
     SC_RADIX_USER_DATA_IPPAIRBITS,
+    SC_RADIX_USER_DATA_COST,
     SC_RADIX_USER_DATA_MAX
 } SCRadixUserDataType;
 
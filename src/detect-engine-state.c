@@ -22,11 +22,13 @@
  * This is done by this code. It uses the ::Flow structure to store
  * the list of signatures to match on the reconstructed stream.
  *
- * The Flow::de_state is a ::DetectEngineState structure. This is
- * basically a containter for storage item of type ::DeStateStore.
- * They contains an array of ::DeStateStoreItem which store the
- * state of match for an individual signature identified by
- * DeStateStoreItem::sid.
+ * Per transaction a ::DetectEngineState structure is kept. For each
+ * direction it has a bitset of the signatures in the state, indexed by
+ * their position in the rule group (::SigGroupHead) of the flow, and an
+ * array with the state of match for each of those signatures.
+ *
+ * Flow based (AMATCH) state is kept in Flow::de_state, a
+ * ::DetectEngineStateFlow structure.
  *
  * The state is constructed by DeStateDetectStartDetection() which
  * also starts the matching. Work is continued by
@@ -75,8 +77,10 @@
 #include "util-unittest.h"
 #include "util-unittest-helper.h"
 #include "util-profiling.h"
+#include "util-atomic.h"
 
 #include "flow-util.h"
+#include "counters.h"
 
 /** convert enum to string */
 #define CASE_CODE(E)  case E: return #E
@@ -117,87 +121,203 @@ static inline int TxIsLast(uint64_t tx_id, uint64_t total_txs)
     return 0;
 }
 
-static DeStateStore *DeStateStoreAlloc(void)
+/** memory in use by detect states, current and allocated over time, and
+ *  the number of detect states in use */
+SC_ATOMIC_DECLARE(uint64_t, de_state_memuse);
+SC_ATOMIC_DECLARE(uint64_t, de_state_alloc);
+SC_ATOMIC_DECLARE(uint64_t, de_state_cnt);
+
+static inline void DeStateMemuseIncr(const uint64_t size)
 {
-    DeStateStore *d = SCMalloc(sizeof(DeStateStore));
-    if (unlikely(d == NULL))
-        return NULL;
-    memset(d, 0, sizeof(DeStateStore));
+    (void) SC_ATOMIC_ADD(de_state_memuse, size);
+    (void) SC_ATOMIC_ADD(de_state_alloc, size);
+}
 
-    return d;
+static inline void DeStateMemuseDecr(const uint64_t size)
+{
+    (void) SC_ATOMIC_SUB(de_state_memuse, size);
 }
+
 static DeStateStoreFlowRules *DeStateStoreFlowRulesAlloc(void)
 {
     DeStateStoreFlowRules *d = SCMalloc(sizeof(DeStateStoreFlowRules));
     if (unlikely(d == NULL))
         return NULL;
     memset(d, 0, sizeof(DeStateStoreFlowRules));
+    DeStateMemuseIncr(sizeof(DeStateStoreFlowRules));
 
     return d;
 }
 
-static int DeStateSearchState(DetectEngineState *state, uint8_t direction, SigIntId num)
+/** \internal
+ *  \brief Get the position of a rule in the match_array of a sgh
+ *
+ *  The match_array is ordered by Signature::num, so we can bsearch it.
+ *
+ *  \retval pos position of the rule
+ *  \retval -1 rule is not part of the sgh
+ */
+static int DeStateSghRulePosition(const SigGroupHead *sgh, const Signature *s)
+{
+    uint32_t lo = 0;
+    uint32_t hi = sgh->sig_cnt;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        SigIntId num = sgh->match_array[mid]->num;
+        if (num == s->num)
+            return (int)mid;
+        else if (num < s->num)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+/** \internal
+ *  \brief Get the index into the inspect_flags array for bit 'pos', which
+ *         is the number of bits set below it. */
+static SigIntId DeStateBitRank(const DetectEngineStateDirection *dir_state,
+                               const uint32_t pos)
+{
+    const uint32_t word = pos / 64;
+    SigIntId rank = 0;
+    uint32_t i;
+
+    for (i = 0; i < word && i < dir_state->bits_size; i++) {
+        rank += __builtin_popcountll(dir_state->bits[i]);
+    }
+    if (word < dir_state->bits_size) {
+        uint64_t below = dir_state->bits[word] & ((1ULL << (pos % 64)) - 1);
+        rank += __builtin_popcountll(below);
+    }
+    return rank;
+}
+
+static inline int DeStateBitIsSet(const DetectEngineStateDirection *dir_state,
+                                  const uint32_t pos)
+{
+    const uint32_t word = pos / 64;
+    if (word >= dir_state->bits_size)
+        return 0;
+    return (dir_state->bits[word] & (1ULL << (pos % 64))) != 0;
+}
+
+/** \internal
+ *  \brief grow the bits and inspect_flags arrays so that bit 'pos' and
+ *         one more inspect_flags entry fit.
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+static int DeStateDirectionGrow(DetectEngineStateDirection *dir_state,
+                                const uint32_t pos)
+{
+    const uint32_t words = pos / 64 + 1;
+    if (words > dir_state->bits_size) {
+        uint64_t *ptmp = SCRealloc(dir_state->bits, words * sizeof(uint64_t));
+        if (ptmp == NULL)
+            return -1;
+        memset(ptmp + dir_state->bits_size, 0,
+                (words - dir_state->bits_size) * sizeof(uint64_t));
+        DeStateMemuseIncr((words - dir_state->bits_size) * sizeof(uint64_t));
+        dir_state->bits = ptmp;
+        dir_state->bits_size = words;
+    }
+
+    if (dir_state->cnt == dir_state->inspect_flags_size) {
+        /* the size is computed wide so that doubling can't wrap, and
+         * capped to what cnt and inspect_flags_size can count */
+        const uint64_t max_size = MIN((uint64_t)(SigIntId)~(SigIntId)0,
+                (uint64_t)(SIZE_MAX / sizeof(uint32_t)));
+        if ((uint64_t)dir_state->inspect_flags_size >= max_size)
+            return -1;
+
+        /* start small, most tx' only have a handful of rules stored */
+        uint64_t size = dir_state->inspect_flags_size ?
+            (uint64_t)dir_state->inspect_flags_size * 2 : 4;
+        if (size > max_size)
+            size = max_size;
+        uint32_t *ptmp = SCRealloc(dir_state->inspect_flags,
+                (size_t)size * sizeof(uint32_t));
+        if (ptmp == NULL)
+            return -1;
+        DeStateMemuseIncr((size - dir_state->inspect_flags_size) * sizeof(uint32_t));
+        dir_state->inspect_flags = ptmp;
+        dir_state->inspect_flags_size = (SigIntId)size;
+    }
+    return 0;
+}
+
+/** \internal
+ *  \brief clear the stored rules, but keep the memory around for reuse */
+static void DeStateDirectionReset(DetectEngineStateDirection *dir_state)
+{
+    if (dir_state->bits != NULL) {
+        memset(dir_state->bits, 0, dir_state->bits_size * sizeof(uint64_t));
+    }
+    dir_state->sgh_id = DE_STATE_SGH_ID_NONE;
+    dir_state->cnt = 0;
+    dir_state->filestore_cnt = 0;
+    dir_state->flags = 0;
+}
+
+static int DeStateSearchState(DetectEngineState *state, const SigGroupHead *sgh,
+                              uint8_t direction, const Signature *s)
 {
     DetectEngineStateDirection *dir_state = &state->dir_state[direction & STREAM_TOSERVER ? 0 : 1];
-    DeStateStore *tx_store = dir_state->head;
-    SigIntId store_cnt;
-    SigIntId state_cnt = 0;
 
-    for (; tx_store != NULL; tx_store = tx_store->next) {
-        SCLogDebug("tx_store %p", tx_store);
-        for (store_cnt = 0;
-             store_cnt < DE_STATE_CHUNK_SIZE && state_cnt < dir_state->cnt;
-             store_cnt++, state_cnt++)
-        {
-            DeStateStoreItem *item = &tx_store->store[store_cnt];
-            if (item->sid == num) {
-                SCLogDebug("sid %u already in state: %p %p %p %u %u, direction %s",
-                            num, state, dir_state, tx_store, state_cnt,
-                            store_cnt, direction & STREAM_TOSERVER ? "toserver" : "toclient");
-                return 1;
-            }
-        }
+    if (dir_state->cnt == 0 || dir_state->sgh_id != sgh->id)
+        return 0;
+
+    int pos = DeStateSghRulePosition(sgh, s);
+    if (pos < 0)
+        return 0;
+
+    if (DeStateBitIsSet(dir_state, (uint32_t)pos)) {
+        SCLogDebug("sid %u already in state: %p %p pos %d, direction %s",
+                s->num, state, dir_state, pos,
+                direction & STREAM_TOSERVER ? "toserver" : "toclient");
+        return 1;
     }
     return 0;
 }
 
-static void DeStateSignatureAppend(DetectEngineState *state, Signature *s, uint32_t inspect_flags, uint8_t direction)
+static void DeStateSignatureAppend(DetectEngineState *state, const SigGroupHead *sgh,
+                                   Signature *s, uint32_t inspect_flags, uint8_t direction)
 {
-    int jump = 0;
-    int i = 0;
     DetectEngineStateDirection *dir_state = &state->dir_state[direction & STREAM_TOSERVER ? 0 : 1];
 
 #ifdef DEBUG_VALIDATION
-    BUG_ON(DeStateSearchState(state, direction, s->num));
+    BUG_ON(DeStateSearchState(state, sgh, direction, s));
 #endif
-    DeStateStore *store = dir_state->head;
-
-    if (store == NULL) {
-        store = DeStateStoreAlloc();
-        if (store != NULL) {
-            dir_state->head = store;
-            dir_state->tail = store;
-        }
-    } else {
-        jump = dir_state->cnt / DE_STATE_CHUNK_SIZE;
-        for (i = 0; i < jump; i++) {
-            store = store->next;
-        }
-        if (store == NULL) {
-            store = DeStateStoreAlloc();
-            if (store != NULL) {
-                dir_state->tail->next = store;
-                dir_state->tail = store;
-            }
-        }
+    if (dir_state->cnt == 0) {
+        dir_state->sgh_id = sgh->id;
+    } else if (dir_state->sgh_id != sgh->id) {
+        /* the positions in the bitset refer to another rule group, for
+         * example because this is an ICMP error packet for the flow. */
+        SCLogDebug("state is for sgh %u, not %u: not storing sid %u",
+                dir_state->sgh_id, sgh->id, s->id);
+        return;
     }
 
-    if (store == NULL)
+    int pos = DeStateSghRulePosition(sgh, s);
+    if (pos < 0)
         return;
 
-    SigIntId idx = dir_state->cnt++ % DE_STATE_CHUNK_SIZE;
-    store->store[idx].sid = s->num;
-    store->store[idx].flags = inspect_flags;
+    if (DeStateDirectionGrow(dir_state, (uint32_t)pos) < 0)
+        return;
+
+    /* rules are mostly added in match_array order, so this is usually
+     * an append to the end of the inspect_flags array */
+    SigIntId idx = DeStateBitRank(dir_state, (uint32_t)pos);
+    if (idx < dir_state->cnt) {
+        memmove(&dir_state->inspect_flags[idx + 1], &dir_state->inspect_flags[idx],
+                (dir_state->cnt - idx) * sizeof(uint32_t));
+    }
+    dir_state->inspect_flags[idx] = inspect_flags;
+    dir_state->bits[pos / 64] |= (1ULL << (pos % 64));
+    dir_state->cnt++;
 
     return;
 }
@@ -269,7 +389,11 @@ DetectEngineState *DetectEngineStateAlloc(void)
     if (unlikely(d == NULL))
         return NULL;
     memset(d, 0, sizeof(DetectEngineState));
+    d->dir_state[0].sgh_id = DE_STATE_SGH_ID_NONE;
+    d->dir_state[1].sgh_id = DE_STATE_SGH_ID_NONE;
 
+    DeStateMemuseIncr(sizeof(DetectEngineState));
+    (void) SC_ATOMIC_ADD(de_state_cnt, 1);
     return d;
 }
 
@@ -280,25 +404,31 @@ DetectEngineStateFlow *DetectEngineStateFlowAlloc(void)
         return NULL;
     memset(d, 0, sizeof(DetectEngineStateFlow));
 
+    DeStateMemuseIncr(sizeof(DetectEngineStateFlow));
+    (void) SC_ATOMIC_ADD(de_state_cnt, 1);
     return d;
 }
 
 void DetectEngineStateFree(DetectEngineState *state)
 {
-    DeStateStore *store;
-    DeStateStore *store_next;
+    uint64_t size = sizeof(DetectEngineState);
     int i = 0;
 
     for (i = 0; i < 2; i++) {
-        store = state->dir_state[i].head;
-        while (store != NULL) {
-            store_next = store->next;
-            SCFree(store);
-            store = store_next;
+        DetectEngineStateDirection *dir_state = &state->dir_state[i];
+        if (dir_state->bits != NULL) {
+            size += dir_state->bits_size * sizeof(uint64_t);
+            SCFree(dir_state->bits);
+        }
+        if (dir_state->inspect_flags != NULL) {
+            size += dir_state->inspect_flags_size * sizeof(uint32_t);
+            SCFree(dir_state->inspect_flags);
         }
     }
     SCFree(state);
 
+    DeStateMemuseDecr(size);
+    (void) SC_ATOMIC_SUB(de_state_cnt, 1);
     return;
 }
 
@@ -313,11 +443,14 @@ void DetectEngineStateFlowFree(DetectEngineStateFlow *state)
         while (store != NULL) {
             store_next = store->next;
             SCFree(store);
+            DeStateMemuseDecr(sizeof(DeStateStoreFlowRules));
             store = store_next;
         }
     }
     SCFree(state);
 
+    DeStateMemuseDecr(sizeof(DetectEngineStateFlow));
+    (void) SC_ATOMIC_SUB(de_state_cnt, 1);
     return;
 }
 
@@ -463,8 +596,8 @@ static void StoreStateTx(DetectEngineThreadCtx *det_ctx,
 
         SCLogDebug("file_no_match %u", file_no_match);
 
-        if (check_before_add == 0 || DeStateSearchState(destate, flags, s->num) == 0)
-            DeStateSignatureAppend(destate, s, inspect_flags, flags);
+        if (check_before_add == 0 || DeStateSearchState(destate, det_ctx->sgh, flags, s) == 0)
+            DeStateSignatureAppend(destate, det_ctx->sgh, s, inspect_flags, flags);
         DeStateStoreStateVersion(f, alversion, flags);
 
         StoreStateTxHandleFiles(det_ctx, f, destate, flags, tx_id, file_no_match);
@@ -726,43 +859,41 @@ int DeStateDetectStartDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
 
 static int DoInspectItem(ThreadVars *tv,
     DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx,
-    DeStateStoreItem *item, const uint8_t dir_state_flags,
+    Signature *s, uint32_t *stored_flags, const uint8_t dir_state_flags,
     Packet *p, Flow *f, AppProto alproto, uint8_t flags,
     const uint64_t inspect_tx_id, const uint64_t total_txs,
 
     uint16_t *file_no_match, int inprogress, // is current tx in progress?
     const int next_tx_no_progress)                // tx after current is still dormant
 {
-    Signature *s = de_ctx->sig_array[item->sid];
-
     SCLogDebug("file_no_match %u, sid %u", *file_no_match, s->id);
 
     /* check if a sig in state 'full inspect' needs to be reconsidered
      * as the result of a new file in the existing tx */
-    if (item->flags & DE_STATE_FLAG_FULL_INSPECT) {
-        if (item->flags & (DE_STATE_FLAG_FILE_TC_INSPECT|DE_STATE_FLAG_FILE_TS_INSPECT)) {
+    if (*stored_flags & DE_STATE_FLAG_FULL_INSPECT) {
+        if (*stored_flags & (DE_STATE_FLAG_FILE_TC_INSPECT|DE_STATE_FLAG_FILE_TS_INSPECT)) {
             if ((flags & STREAM_TOCLIENT) &&
                     (dir_state_flags & DETECT_ENGINE_STATE_FLAG_FILE_TC_NEW))
             {
                 SCLogDebug("~DE_STATE_FLAG_FILE_TC_INSPECT");
-                item->flags &= ~DE_STATE_FLAG_FILE_TC_INSPECT;
-                item->flags &= ~DE_STATE_FLAG_FULL_INSPECT;
-                item->flags &= ~DE_STATE_FLAG_SIG_CANT_MATCH;
+                *stored_flags &= ~DE_STATE_FLAG_FILE_TC_INSPECT;
+                *stored_flags &= ~DE_STATE_FLAG_FULL_INSPECT;
+                *stored_flags &= ~DE_STATE_FLAG_SIG_CANT_MATCH;
             }
 
             if ((flags & STREAM_TOSERVER) &&
                     (dir_state_flags & DETECT_ENGINE_STATE_FLAG_FILE_TS_NEW))
             {
                 SCLogDebug("~DE_STATE_FLAG_FILE_TS_INSPECT");
-                item->flags &= ~DE_STATE_FLAG_FILE_TS_INSPECT;
-                item->flags &= ~DE_STATE_FLAG_FULL_INSPECT;
-                item->flags &= ~DE_STATE_FLAG_SIG_CANT_MATCH;
+                *stored_flags &= ~DE_STATE_FLAG_FILE_TS_INSPECT;
+                *stored_flags &= ~DE_STATE_FLAG_FULL_INSPECT;
+                *stored_flags &= ~DE_STATE_FLAG_SIG_CANT_MATCH;
             }
         }
 
-        if (item->flags & DE_STATE_FLAG_FULL_INSPECT) {
+        if (*stored_flags & DE_STATE_FLAG_FULL_INSPECT) {
             if (TxIsLast(inspect_tx_id, total_txs) || inprogress || next_tx_no_progress) {
-                det_ctx->de_state_sig_array[item->sid] = DE_STATE_MATCH_NO_NEW_STATE;
+                det_ctx->de_state_sig_array[s->num] = DE_STATE_MATCH_NO_NEW_STATE;
                 SCLogDebug("skip and bypass %u: tx %u packet %u", s->id, (uint)inspect_tx_id, (uint)p->pcap_cnt);
             } else {
                 SCLogDebug("just skip: tx %u packet %u", (uint)inspect_tx_id, (uint)p->pcap_cnt);
@@ -773,9 +904,9 @@ static int DoInspectItem(ThreadVars *tv,
                 uint64_t offset = (inspect_tx_id + 1) - base_tx_id;
                 if (offset > MAX_STORED_TXID_OFFSET)
                     offset = MAX_STORED_TXID_OFFSET;
-                det_ctx->de_state_sig_array[item->sid] = (uint8_t)offset;
+                det_ctx->de_state_sig_array[s->num] = (uint8_t)offset;
 #ifdef DEBUG_VALIDATION
-                BUG_ON(det_ctx->de_state_sig_array[item->sid] & DE_STATE_MATCH_NO_NEW_STATE); // check that we don't set the bit
+                BUG_ON(det_ctx->de_state_sig_array[s->num] & DE_STATE_MATCH_NO_NEW_STATE); // check that we don't set the bit
 #endif
                 SCLogDebug("storing tx_id %u for this sid", (uint)inspect_tx_id + 1);
             }
@@ -785,28 +916,28 @@ static int DoInspectItem(ThreadVars *tv,
 
     /* check if a sig in state 'cant match' needs to be reconsidered
      * as the result of a new file in the existing tx */
-    SCLogDebug("item->flags %x", item->flags);
-    if (item->flags & DE_STATE_FLAG_SIG_CANT_MATCH) {
+    SCLogDebug("stored flags %x", *stored_flags);
+    if (*stored_flags & DE_STATE_FLAG_SIG_CANT_MATCH) {
         SCLogDebug("DE_STATE_FLAG_SIG_CANT_MATCH");
 
         if ((flags & STREAM_TOSERVER) &&
-                (item->flags & DE_STATE_FLAG_FILE_TS_INSPECT) &&
+                (*stored_flags & DE_STATE_FLAG_FILE_TS_INSPECT) &&
                 (dir_state_flags & DETECT_ENGINE_STATE_FLAG_FILE_TS_NEW))
         {
             SCLogDebug("unset ~DE_STATE_FLAG_FILE_TS_INSPECT ~DE_STATE_FLAG_SIG_CANT_MATCH");
-            item->flags &= ~DE_STATE_FLAG_FILE_TS_INSPECT;
-            item->flags &= ~DE_STATE_FLAG_SIG_CANT_MATCH;
+            *stored_flags &= ~DE_STATE_FLAG_FILE_TS_INSPECT;
+            *stored_flags &= ~DE_STATE_FLAG_SIG_CANT_MATCH;
 
         } else if ((flags & STREAM_TOCLIENT) &&
-                (item->flags & DE_STATE_FLAG_FILE_TC_INSPECT) &&
+                (*stored_flags & DE_STATE_FLAG_FILE_TC_INSPECT) &&
                 (dir_state_flags & DETECT_ENGINE_STATE_FLAG_FILE_TC_NEW))
         {
             SCLogDebug("unset ~DE_STATE_FLAG_FILE_TC_INSPECT ~DE_STATE_FLAG_SIG_CANT_MATCH");
-            item->flags &= ~DE_STATE_FLAG_FILE_TC_INSPECT;
-            item->flags &= ~DE_STATE_FLAG_SIG_CANT_MATCH;
+            *stored_flags &= ~DE_STATE_FLAG_FILE_TC_INSPECT;
+            *stored_flags &= ~DE_STATE_FLAG_SIG_CANT_MATCH;
         } else {
             if (TxIsLast(inspect_tx_id, total_txs) || inprogress || next_tx_no_progress) {
-                det_ctx->de_state_sig_array[item->sid] = DE_STATE_MATCH_NO_NEW_STATE;
+                det_ctx->de_state_sig_array[s->num] = DE_STATE_MATCH_NO_NEW_STATE;
                 SCLogDebug("skip and bypass: tx %u packet %u", (uint)inspect_tx_id, (uint)p->pcap_cnt);
             } else {
                 SCLogDebug("just skip: tx %u packet %u", (uint)inspect_tx_id, (uint)p->pcap_cnt);
@@ -817,9 +948,9 @@ static int DoInspectItem(ThreadVars *tv,
                 uint64_t offset = (inspect_tx_id + 1) - base_tx_id;
                 if (offset > MAX_STORED_TXID_OFFSET)
                     offset = MAX_STORED_TXID_OFFSET;
-                det_ctx->de_state_sig_array[item->sid] = (uint8_t)offset;
+                det_ctx->de_state_sig_array[s->num] = (uint8_t)offset;
 #ifdef DEBUG_VALIDATION
-                BUG_ON(det_ctx->de_state_sig_array[item->sid] & DE_STATE_MATCH_NO_NEW_STATE); // check that we don't set the bit
+                BUG_ON(det_ctx->de_state_sig_array[s->num] & DE_STATE_MATCH_NO_NEW_STATE); // check that we don't set the bit
 #endif
                 SCLogDebug("storing tx_id %u for this sid", (uint)inspect_tx_id + 1);
             }
@@ -851,7 +982,7 @@ static int DoInspectItem(ThreadVars *tv,
     }
 
     while (engine != NULL) {
-        if (!(item->flags & engine->inspect_flags) &&
+        if (!(*stored_flags & engine->inspect_flags) &&
                 s->sm_lists[engine->sm_list] != NULL)
         {
             SCLogDebug("inspect_flags %x", inspect_flags);
@@ -889,11 +1020,11 @@ static int DoInspectItem(ThreadVars *tv,
         inspect_flags |= DE_STATE_FLAG_FULL_INSPECT;
     }
 
-    item->flags |= inspect_flags;
+    *stored_flags |= inspect_flags;
     /* flag this sig to don't inspect again from the detection loop it if
      * there is no need for it */
     if (TxIsLast(inspect_tx_id, total_txs) || inprogress || next_tx_no_progress) {
-        det_ctx->de_state_sig_array[item->sid] = DE_STATE_MATCH_NO_NEW_STATE;
+        det_ctx->de_state_sig_array[s->num] = DE_STATE_MATCH_NO_NEW_STATE;
         SCLogDebug("inspected, now bypass: tx %u packet %u", (uint)inspect_tx_id, (uint)p->pcap_cnt);
     } else {
         /* make sure that if we reinspect this right now from
@@ -902,9 +1033,9 @@ static int DoInspectItem(ThreadVars *tv,
         uint64_t offset = (inspect_tx_id + 1) - base_tx_id;
         if (offset > MAX_STORED_TXID_OFFSET)
             offset = MAX_STORED_TXID_OFFSET;
-        det_ctx->de_state_sig_array[item->sid] = (uint8_t)offset;
+        det_ctx->de_state_sig_array[s->num] = (uint8_t)offset;
 #ifdef DEBUG_VALIDATION
-        BUG_ON(det_ctx->de_state_sig_array[item->sid] & DE_STATE_MATCH_NO_NEW_STATE); // check that we don't set the bit
+        BUG_ON(det_ctx->de_state_sig_array[s->num] & DE_STATE_MATCH_NO_NEW_STATE); // check that we don't set the bit
 #endif
         SCLogDebug("storing tx_id %u for this sid", (uint)inspect_tx_id + 1);
     }
@@ -1060,9 +1191,11 @@ void DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
     uint16_t file_no_match = 0;
     SigIntId store_cnt = 0;
     SigIntId state_cnt = 0;
+    uint32_t word = 0;
     uint64_t inspect_tx_id = 0;
     uint64_t total_txs = 0;
     uint8_t direction = (flags & STREAM_TOSERVER) ? 0 : 1;
+    const SigGroupHead *sgh = det_ctx->sgh;
 
     SCLogDebug("starting continue detection for packet %"PRIu64, p->pcap_cnt);
 
@@ -1094,7 +1227,6 @@ void DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
                     continue;
                 }
                 DetectEngineStateDirection *tx_dir_state = &tx_de_state->dir_state[direction];
-                DeStateStore *tx_store = tx_dir_state->head;
 
                 SCLogDebug("tx_dir_state->filestore_cnt %u", tx_dir_state->filestore_cnt);
 
@@ -1110,17 +1242,29 @@ void DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
                     }
                 }
 
+                /* the stored rules are positions in the match_array of the
+                 * sgh they were inspected in. If this packet uses another
+                 * sgh, e.g. because it's an ICMP error, leave them for now */
+                if (tx_dir_state->cnt != 0 && tx_dir_state->sgh_id != sgh->id) {
+                    SCLogDebug("tx state is for sgh %u, packet uses sgh %u",
+                            tx_dir_state->sgh_id, sgh->id);
+                    goto next_tx;
+                }
+
                 /* Loop through stored 'items' (stateful rules) and inspect them */
                 state_cnt = 0;
-                for (; tx_store != NULL; tx_store = tx_store->next) {
-                    SCLogDebug("tx_store %p", tx_store);
-                    for (store_cnt = 0;
-                            store_cnt < DE_STATE_CHUNK_SIZE && state_cnt < tx_dir_state->cnt;
-                            store_cnt++, state_cnt++)
-                    {
-                        DeStateStoreItem *item = &tx_store->store[store_cnt];
+                for (word = 0; word < tx_dir_state->bits_size &&
+                        state_cnt < tx_dir_state->cnt; word++)
+                {
+                    uint64_t bits = tx_dir_state->bits[word];
+                    while (bits != 0) {
+                        uint32_t pos = word * 64 + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+
+                        Signature *s = sgh->match_array[pos];
                         int r = DoInspectItem(tv, de_ctx, det_ctx,
-                                item, tx_dir_state->flags,
+                                s, &tx_dir_state->inspect_flags[state_cnt++],
+                                tx_dir_state->flags,
                                 p, f, alproto, flags,
                                 inspect_tx_id, total_txs,
                                 &file_no_match, inspect_tx_inprogress, next_tx_no_progress);
@@ -1134,6 +1278,7 @@ void DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx,
                 tx_dir_state->flags &=
                     ~(DETECT_ENGINE_STATE_FLAG_FILE_TS_NEW|DETECT_ENGINE_STATE_FLAG_FILE_TC_NEW);
             }
+        next_tx:
             /* if the current tx is in progress, we won't advance to any newer
              * tx' just yet. */
             if (inspect_tx_inprogress) {
@@ -1171,6 +1316,28 @@ end:
     det_ctx->tx_id_set = 0;
     return;
 }
+static uint64_t DeStateMemuseGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(de_state_memuse);
+}
+
+static uint64_t DeStateAllocGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(de_state_alloc);
+}
+
+static uint64_t DeStateCntGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(de_state_cnt);
+}
+
+void DetectEngineStateRegisterGlobalCounters(void)
+{
+    StatsRegisterGlobalCounter("detect.de_state.memuse", DeStateMemuseGlobalCounter);
+    StatsRegisterGlobalCounter("detect.de_state.alloc", DeStateAllocGlobalCounter);
+    StatsRegisterGlobalCounter("detect.de_state.states", DeStateCntGlobalCounter);
+}
+
 /** \brief update flow's inspection id's
  *
  *  \param f unlocked flow
@@ -1229,13 +1396,8 @@ void DetectEngineStateResetTxs(Flow *f)
                     continue;
                 }
 
-                tx_de_state->dir_state[0].cnt = 0;
-                tx_de_state->dir_state[0].filestore_cnt = 0;
-                tx_de_state->dir_state[0].flags = 0;
-
-                tx_de_state->dir_state[1].cnt = 0;
-                tx_de_state->dir_state[1].filestore_cnt = 0;
-                tx_de_state->dir_state[1].flags = 0;
+                DeStateDirectionReset(&tx_de_state->dir_state[0]);
+                DeStateDirectionReset(&tx_de_state->dir_state[1]);
             }
         }
     }
@@ -1249,142 +1411,152 @@ static int DeStateTest01(void)
 {
     SCLogDebug("sizeof(DetectEngineState)\t\t%"PRIuMAX,
             (uintmax_t)sizeof(DetectEngineState));
-    SCLogDebug("sizeof(DeStateStore)\t\t\t%"PRIuMAX,
-            (uintmax_t)sizeof(DeStateStore));
-    SCLogDebug("sizeof(DeStateStoreItem)\t\t%"PRIuMAX"",
-            (uintmax_t)sizeof(DeStateStoreItem));
+    SCLogDebug("sizeof(DetectEngineStateDirection)\t%"PRIuMAX,
+            (uintmax_t)sizeof(DetectEngineStateDirection));
+    SCLogDebug("sizeof(DeStateStoreFlowRules)\t\t%"PRIuMAX"",
+            (uintmax_t)sizeof(DeStateStoreFlowRules));
 
     return 1;
 }
 
-static int DeStateTest02(void)
+#define DE_STATE_TEST_SIGS 170
+
+/** \internal
+ *  \brief setup a sgh with rules num 0 to DE_STATE_TEST_SIGS-1
+ *  \retval sigs array of DE_STATE_TEST_SIGS rules or NULL on error */
+static Signature *DeStateTestSetupSgh(SigGroupHead *sgh)
 {
-    int result = 0;
+    int i;
 
-    DetectEngineState *state = DetectEngineStateAlloc();
-    if (state == NULL) {
-        printf("d == NULL: ");
-        goto end;
+    memset(sgh, 0x00, sizeof(*sgh));
+    Signature *sigs = SCCalloc(DE_STATE_TEST_SIGS, sizeof(Signature));
+    if (sigs == NULL)
+        return NULL;
+    sgh->match_array = SCCalloc(DE_STATE_TEST_SIGS, sizeof(Signature *));
+    if (sgh->match_array == NULL) {
+        SCFree(sigs);
+        return NULL;
     }
+    for (i = 0; i < DE_STATE_TEST_SIGS; i++) {
+        sigs[i].num = i;
+        sgh->match_array[i] = &sigs[i];
+    }
+    sgh->sig_cnt = DE_STATE_TEST_SIGS;
+    sgh->id = 1;
+    return sigs;
+}
 
-    Signature s;
-    memset(&s, 0x00, sizeof(s));
-
+static int DeStateTest02(void)
+{
+    SigGroupHead sgh;
+    SigIntId nums[] = { 0, 11, 22, 33, 44, 55, 66, 77, 88, 99, 100,
+                        111, 122, 133, 144, 155, 166 };
     uint8_t direction = STREAM_TOSERVER;
+    uint32_t i;
 
-    s.num = 0;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 11;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 22;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 33;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 44;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 55;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 66;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 77;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 88;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 99;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 100;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 111;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 122;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 133;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 144;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 155;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 166;
-    DeStateSignatureAppend(state, &s, 0, direction);
+    Signature *sigs = DeStateTestSetupSgh(&sgh);
+    FAIL_IF_NULL(sigs);
 
-    if (state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head == NULL) {
-        goto end;
-    }
+    DetectEngineState *state = DetectEngineStateAlloc();
+    FAIL_IF_NULL(state);
 
-    if (state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[1].sid != 11) {
-        goto end;
+    for (i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+        DeStateSignatureAppend(state, &sgh, &sigs[nums[i]], nums[i], direction);
     }
 
-    if (state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next == NULL) {
-        goto end;
-    }
+    DetectEngineStateDirection *dir_state = &state->dir_state[0];
+    FAIL_IF_NOT(dir_state->cnt == 17);
+    FAIL_IF_NOT(dir_state->sgh_id == 1);
+    FAIL_IF_NOT(dir_state->bits_size == 3);
+    FAIL_IF(state->dir_state[1].cnt != 0);
 
-    if (state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[14].sid != 144) {
-        goto end;
-    }
-
-    if (state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next->store[0].sid != 155) {
-        goto end;
+    for (i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+        FAIL_IF_NOT(DeStateSearchState(state, &sgh, direction, &sigs[nums[i]]));
+        FAIL_IF_NOT(DeStateBitRank(dir_state, nums[i]) == i);
+        FAIL_IF_NOT(dir_state->inspect_flags[i] == nums[i]);
     }
+    FAIL_IF(DeStateSearchState(state, &sgh, direction, &sigs[12]));
+    FAIL_IF(DeStateSearchState(state, &sgh, direction, &sigs[167]));
+    FAIL_IF(DeStateSearchState(state, &sgh, STREAM_TOCLIENT, &sigs[11]));
 
-    if (state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->next->store[1].sid != 166) {
-        goto end;
-    }
+    DeStateDirectionReset(dir_state);
+    FAIL_IF_NOT(dir_state->cnt == 0);
+    FAIL_IF(DeStateSearchState(state, &sgh, direction, &sigs[11]));
+    FAIL_IF(DeStateBitIsSet(dir_state, 11));
 
-    result = 1;
-end:
-    if (state != NULL) {
-        DetectEngineStateFree(state);
-    }
-    return result;
+    DetectEngineStateFree(state);
+    SCFree(sgh.match_array);
+    SCFree(sigs);
+    PASS;
 }
 
 static int DeStateTest03(void)
 {
-    int result = 0;
-
-    DetectEngineState *state = DetectEngineStateAlloc();
-    if (state == NULL) {
-        printf("d == NULL: ");
-        goto end;
-    }
-
-    Signature s;
-    memset(&s, 0x00, sizeof(s));
-
+    SigGroupHead sgh;
     uint8_t direction = STREAM_TOSERVER;
 
-    s.num = 11;
-    DeStateSignatureAppend(state, &s, 0, direction);
-    s.num = 22;
-    DeStateSignatureAppend(state, &s, DE_STATE_FLAG_URI_INSPECT, direction);
-
-    if (state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head == NULL) {
-        goto end;
-    }
+    Signature *sigs = DeStateTestSetupSgh(&sgh);
+    FAIL_IF_NULL(sigs);
 
-    if (state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[0].sid != 11) {
-        goto end;
-    }
-
-    if (state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[0].flags & DE_STATE_FLAG_URI_INSPECT) {
-        goto end;
-    }
-
-    if (state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[1].sid != 22) {
-        goto end;
-    }
-
-    if (!(state->dir_state[direction & STREAM_TOSERVER ? 0 : 1].head->store[1].flags & DE_STATE_FLAG_URI_INSPECT)) {
-        goto end;
-    }
+    DetectEngineState *state = DetectEngineStateAlloc();
+    FAIL_IF_NULL(state);
+
+    /* add out of order: flags have to stay in bit order */
+    DeStateSignatureAppend(state, &sgh, &sigs[22], DE_STATE_FLAG_URI_INSPECT, direction);
+    DeStateSignatureAppend(state, &sgh, &sigs[11], 0, direction);
+    DeStateSignatureAppend(state, &sgh, &sigs[130], DE_STATE_FLAG_HHD_INSPECT, direction);
+
+    DetectEngineStateDirection *dir_state = &state->dir_state[0];
+    FAIL_IF_NOT(dir_state->cnt == 3);
+    FAIL_IF(dir_state->inspect_flags[0] & DE_STATE_FLAG_URI_INSPECT);
+    FAIL_IF_NOT(dir_state->inspect_flags[1] & DE_STATE_FLAG_URI_INSPECT);
+    FAIL_IF_NOT(dir_state->inspect_flags[2] & DE_STATE_FLAG_HHD_INSPECT);
+
+    /* rules from another sgh are not stored */
+    SigGroupHead other = sgh;
+    other.id = 2;
+    DeStateSignatureAppend(state, &other, &sigs[33], 0, direction);
+    FAIL_IF_NOT(dir_state->cnt == 3);
+    FAIL_IF(DeStateSearchState(state, &other, direction, &sigs[22]));
+
+    /* rules not part of the sgh are not stored */
+    Signature extra;
+    memset(&extra, 0x00, sizeof(extra));
+    extra.num = DE_STATE_TEST_SIGS + 1;
+    DeStateSignatureAppend(state, &sgh, &extra, 0, direction);
+    FAIL_IF_NOT(dir_state->cnt == 3);
+
+    DetectEngineStateFree(state);
+    SCFree(sgh.match_array);
+    SCFree(sigs);
+    PASS;
+}
 
-    result = 1;
-end:
-    if (state != NULL) {
-        DetectEngineStateFree(state);
-    }
-    return result;
+/** \test a full inspect_flags array at the maximum size isn't grown
+ *        past what inspect_flags_size can hold */
+static int DeStateTest04(void)
+{
+    DetectEngineState *state = DetectEngineStateAlloc();
+    FAIL_IF_NULL(state);
+    DetectEngineStateDirection *dir_state = &state->dir_state[0];
+
+    FAIL_IF(DeStateDirectionGrow(dir_state, 0) != 0);
+    FAIL_IF_NULL(dir_state->inspect_flags);
+    FAIL_IF_NOT(dir_state->inspect_flags_size == 4);
+    uint32_t *inspect_flags = dir_state->inspect_flags;
+
+    /* pretend the array is full at the largest size */
+    SigIntId max = (SigIntId)~(SigIntId)0;
+    dir_state->cnt = max;
+    dir_state->inspect_flags_size = max;
+    FAIL_IF(DeStateDirectionGrow(dir_state, 0) != -1);
+    FAIL_IF_NOT(dir_state->inspect_flags == inspect_flags);
+    FAIL_IF_NOT(dir_state->inspect_flags_size == max);
+
+    dir_state->cnt = 0;
+    dir_state->inspect_flags_size = 4;
+    DetectEngineStateFree(state);
+    PASS;
 }
 
 static int DeStateSigTest01(void)
@@ -1656,7 +1828,7 @@ static int DeStateSigTest02(void)
     }
     DetectEngineState *tx_de_state = AppLayerParserGetTxDetectState(IPPROTO_TCP, ALPROTO_HTTP, tx);
     if (tx_de_state == NULL || tx_de_state->dir_state[0].cnt != 1 ||
-        tx_de_state->dir_state[0].head->store[0].flags != 0x00000001) {
+        tx_de_state->dir_state[0].inspect_flags[0] != 0x00000001) {
         printf("de_state not present or has unexpected content: ");
         goto end;
     }
@@ -2428,6 +2600,7 @@ void DeStateRegisterTests(void)
     UtRegisterTest("DeStateTest01", DeStateTest01);
     UtRegisterTest("DeStateTest02", DeStateTest02);
     UtRegisterTest("DeStateTest03", DeStateTest03);
+    UtRegisterTest("DeStateTest04", DeStateTest04);
     UtRegisterTest("DeStateSigTest01", DeStateSigTest01);
     UtRegisterTest("DeStateSigTest02", DeStateSigTest02);
     UtRegisterTest("DeStateSigTest03", DeStateSigTest03);
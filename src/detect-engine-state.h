@@ -59,7 +59,7 @@
  *  more files that have ongoing inspection. */
 #define DETECT_ENGINE_INSPECT_SIG_MATCH_MORE_FILES 4
 
-/** number of DeStateStoreItem's in one DeStateStore object */
+/** number of DeStateStoreFlowRule's in one DeStateStoreFlowRules object */
 #define DE_STATE_CHUNK_SIZE             15
 
 /* per sig flags */
@@ -119,20 +119,21 @@
 
 /* TX BASED (inspect engines) */
 
-typedef struct DeStateStoreItem_ {
-    uint32_t flags;
-    SigIntId sid;
-} DeStateStoreItem;
-
-typedef struct DeStateStore_ {
-    DeStateStoreItem store[DE_STATE_CHUNK_SIZE];
-    struct DeStateStore_ *next;
-} DeStateStore;
+/** sgh_id value of a direction that has no rules stored */
+#define DE_STATE_SGH_ID_NONE            UINT32_MAX
 
+/** The rules stored for a tx are kept as a bitset indexed by the position
+ *  of the rule in the match_array of the rule group (SigGroupHead) they
+ *  were inspected in. The inspect flags of the stored rules are kept in a
+ *  compact side array, ordered by bit position: the flags of the rule at
+ *  bit 'b' are at the index of the number of bits set below 'b'. */
 typedef struct DetectEngineStateDirection_ {
-    DeStateStore *head;
-    DeStateStore *tail;
-    SigIntId cnt;
+    uint64_t *bits;             /**< rules, by sgh match_array position */
+    uint32_t *inspect_flags;    /**< per rule flags, in bit order */
+    uint32_t sgh_id;            /**< id of the sgh the bits refer to */
+    SigIntId cnt;               /**< number of rules stored */
+    SigIntId bits_size;         /**< number of words in bits */
+    SigIntId inspect_flags_size;/**< number of entries in inspect_flags */
     uint16_t filestore_cnt;
     uint8_t flags;
 } DetectEngineStateDirection;
@@ -246,6 +247,11 @@ void DetectEngineStateReset(DetectEngineStateFlow *state, uint8_t direction);
 
 void DetectEngineStateResetTxs(Flow *f);
 
+/**
+ * \brief Register the detect state memory use counters.
+ */
+void DetectEngineStateRegisterGlobalCounters(void);
+
 void DeStateRegisterTests(void);
 
 #endif /* __DETECT_ENGINE_STATE_H__ */
@@ -27,6 +27,8 @@
 
 #include "detect.h"
 #include "detect-engine.h"
+#include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -56,6 +58,7 @@
  * \retval ret      Number of matches
  */
 static inline uint32_t TlsSniPatternSearch(DetectEngineThreadCtx *det_ctx,
+                                           const MpmCtx *mpm_ctx,
                                            const uint8_t *buffer,
                                            const uint32_t buffer_len,
                                            const uint8_t flags)
@@ -65,45 +68,50 @@ static inline uint32_t TlsSniPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOCLIENT);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_tlssni_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (buffer_len >= det_ctx->sgh->mpm_tlssni_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_tlssni_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_tlssni_ctx_ts, &det_ctx->mtcu,
+    if (buffer_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                     &det_ctx->pmq, buffer, buffer_len);
     }
 
     SCReturnUInt(ret);
 }
 
-/**
- *  \brief Run the pattern matcher against the SNI buffer
- *
- *  \param det_ctx    Detection engine thread ctx
- *  \param f          Locked flow
- *  \param dns_state  Initialized dns state
- *  \param flags      Flags
+/** \brief TLS SNI Mpm prefilter callback
  *
- *  \retval cnt       Number of matches
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect (the SSLState)
+ *  \param pectx inspection context
  */
-uint32_t DetectTlsSniInspectMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                SSLState *ssl_state, uint8_t flags)
+static void PrefilterTxTlsSni(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
     SCEnter();
 
-    uint8_t *buffer;
-    uint32_t buffer_len;
-    uint32_t cnt = 0;
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
+    SSLState *ssl_state = f->alstate;
 
     if (ssl_state->client_connp.sni == NULL)
-        return 0;
+        return;
 
-    buffer = (uint8_t *)ssl_state->client_connp.sni;
-    buffer_len = strlen(ssl_state->client_connp.sni);
+    const uint8_t *buffer = (const uint8_t *)ssl_state->client_connp.sni;
+    const uint32_t buffer_len = strlen(ssl_state->client_connp.sni);
 
-    cnt = TlsSniPatternSearch(det_ctx, buffer, buffer_len, flags);
+    TlsSniPatternSearch(det_ctx, mpm_ctx, buffer, buffer_len, flags);
+}
 
-    SCReturnUInt(cnt);
+int PrefilterTxTlsSniRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxTlsSni,
+        ALPROTO_TLS, STREAM_TOSERVER, 0,
+        mpm_ctx, NULL, "tls_sni");
 }
 
 /** \brief Do the content inspection and validation for a signature
@@ -155,6 +163,7 @@ int DetectEngineInspectTlsSni(ThreadVars *tv, DetectEngineCtx *de_ctx,
  * \retval ret      Number of matches
  */
 static inline uint32_t TlsIssuerPatternSearch(DetectEngineThreadCtx *det_ctx,
+                                              const MpmCtx *mpm_ctx,
                                               const uint8_t *buffer,
                                               const uint32_t buffer_len,
                                               const uint8_t flags)
@@ -164,45 +173,50 @@ static inline uint32_t TlsIssuerPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOSERVER);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_tlsissuer_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (buffer_len >= det_ctx->sgh->mpm_tlsissuer_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_tlsissuer_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_tlsissuer_ctx_ts, &det_ctx->mtcu,
+    if (buffer_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                    &det_ctx->pmq, buffer, buffer_len);
     }
 
     SCReturnUInt(ret);
 }
 
-/**
- *  \brief Run the pattern matcher against the TLS issuer buffer
- *
- *  \param det_ctx    Detection engine thread ctx
- *  \param f          Locked flow
- *  \param dns_state  Initialized dns state
- *  \param flags      Flags
+/** \brief TLS Issuer Mpm prefilter callback
  *
- *  \retval cnt       Number of matches
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect (the SSLState)
+ *  \param pectx inspection context
  */
-uint32_t DetectTlsIssuerInspectMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                   SSLState *ssl_state, uint8_t flags)
+static void PrefilterTxTlsIssuer(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
     SCEnter();
 
-    uint8_t *buffer;
-    uint32_t buffer_len;
-    uint32_t cnt = 0;
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
+    SSLState *ssl_state = f->alstate;
 
     if (ssl_state->server_connp.cert0_issuerdn == NULL)
-        return 0;
+        return;
 
-    buffer = (uint8_t *)ssl_state->server_connp.cert0_issuerdn;
-    buffer_len = strlen(ssl_state->server_connp.cert0_issuerdn);
+    const uint8_t *buffer = (const uint8_t *)ssl_state->server_connp.cert0_issuerdn;
+    const uint32_t buffer_len = strlen(ssl_state->server_connp.cert0_issuerdn);
+
+    TlsIssuerPatternSearch(det_ctx, mpm_ctx, buffer, buffer_len, flags);
+}
 
-    cnt = TlsIssuerPatternSearch(det_ctx, buffer, buffer_len, flags);
+int PrefilterTxTlsIssuerRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
 
-    SCReturnUInt(cnt);
+    return PrefilterAppendTxEngine(sgh, PrefilterTxTlsIssuer,
+        ALPROTO_TLS, STREAM_TOCLIENT, 0,
+        mpm_ctx, NULL, "tls_cert_issuer");
 }
 
 /** \brief Do the content inspection and validation for a signature
@@ -254,6 +268,7 @@ int DetectEngineInspectTlsIssuer(ThreadVars *tv, DetectEngineCtx *de_ctx,
  * \retval ret      Number of matches
  */
 static inline uint32_t TlsSubjectPatternSearch(DetectEngineThreadCtx *det_ctx,
+                                               const MpmCtx *mpm_ctx,
                                                const uint8_t *buffer,
                                                const uint32_t buffer_len,
                                                const uint8_t flags)
@@ -263,45 +278,50 @@ static inline uint32_t TlsSubjectPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOSERVER);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_tlssubject_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (buffer_len >= det_ctx->sgh->mpm_tlssubject_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_tlssubject_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_tlssubject_ctx_ts, &det_ctx->mtcu,
+    if (buffer_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx, &det_ctx->mtcu,
                    &det_ctx->pmq, buffer, buffer_len);
     }
 
     SCReturnUInt(ret);
 }
 
-/**
- *  \brief Run the pattern matcher against the TLS subject buffer
+/** \brief TLS Subject Mpm prefilter callback
  *
- *  \param det_ctx    Detection engine thread ctx
- *  \param f          Locked flow
- *  \param dns_state  Initialized dns state
- *  \param flags      Flags
- *
- *  \retval cnt       Number of matches
+ *  \param det_ctx detection engine thread ctx
+ *  \param p packet to inspect
+ *  \param f flow to inspect
+ *  \param txv tx to inspect (the SSLState)
+ *  \param pectx inspection context
  */
-uint32_t DetectTlsSubjectInspectMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                    SSLState *ssl_state, uint8_t flags)
+static void PrefilterTxTlsSubject(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
     SCEnter();
 
-    uint8_t *buffer;
-    uint32_t buffer_len;
-    uint32_t cnt = 0;
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
+    SSLState *ssl_state = f->alstate;
 
     if (ssl_state->server_connp.cert0_subject == NULL)
-        return 0;
+        return;
 
-    buffer = (uint8_t *)ssl_state->server_connp.cert0_subject;
-    buffer_len = strlen(ssl_state->server_connp.cert0_subject);
+    const uint8_t *buffer = (const uint8_t *)ssl_state->server_connp.cert0_subject;
+    const uint32_t buffer_len = strlen(ssl_state->server_connp.cert0_subject);
 
-    cnt = TlsSubjectPatternSearch(det_ctx, buffer, buffer_len, flags);
+    TlsSubjectPatternSearch(det_ctx, mpm_ctx, buffer, buffer_len, flags);
+}
+
+int PrefilterTxTlsSubjectRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
 
-    SCReturnUInt(cnt);
+    return PrefilterAppendTxEngine(sgh, PrefilterTxTlsSubject,
+        ALPROTO_TLS, STREAM_TOCLIENT, 0,
+        mpm_ctx, NULL, "tls_cert_subject");
 }
 
 /** \brief Do the content inspection and validation for a signature
@@ -29,6 +29,8 @@
 
 #include "detect.h"
 #include "detect-engine.h"
+#include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-parse.h"
 #include "detect-engine-state.h"
 #include "detect-engine-content-inspection.h"
@@ -57,6 +59,7 @@
  *  \retval ret number of matches
  */
 static inline uint32_t UriPatternSearch(DetectEngineThreadCtx *det_ctx,
+        const MpmCtx *mpm_ctx,
         const uint8_t *uri, const uint16_t uri_len,
         const uint8_t flags)
 {
@@ -65,11 +68,11 @@ static inline uint32_t UriPatternSearch(DetectEngineThreadCtx *det_ctx,
     uint32_t ret = 0;
 
     DEBUG_VALIDATE_BUG_ON(flags & STREAM_TOCLIENT);
-    DEBUG_VALIDATE_BUG_ON(det_ctx->sgh->mpm_uri_ctx_ts == NULL);
+    DEBUG_VALIDATE_BUG_ON(mpm_ctx == NULL);
 
-    if (uri_len >= det_ctx->sgh->mpm_uri_ctx_ts->minlen) {
-        ret = mpm_table[det_ctx->sgh->mpm_uri_ctx_ts->mpm_type].
-            Search(det_ctx->sgh->mpm_uri_ctx_ts,
+    if (uri_len >= mpm_ctx->minlen) {
+        ret = mpm_table[mpm_ctx->mpm_type].
+            Search(mpm_ctx,
                     &det_ctx->mtcu, &det_ctx->pmq, uri, uri_len);
     }
 
@@ -85,31 +88,39 @@ static inline uint32_t UriPatternSearch(DetectEngineThreadCtx *det_ctx,
  *  flag each sig that has a match. We need to do this for all uri(s)
  *  to not miss possible events.
  *
+ *  \param det_ctx detection engine thread ctx
+ *  \param pectx inspection context (the mpm ctx)
  *  \param f locked flow
- *  \param htp_state initialized htp state
+ *  \param txv tx to inspect
  *
  *  \warning Make sure the flow/state is locked
- *  \todo what should we return? Just the fact that we matched?
  */
-uint32_t DetectUricontentInspectMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                    HtpState *htp_state, uint8_t flags,
-                                    void *txv, uint64_t idx)
+static void PrefilterTxUri(DetectEngineThreadCtx *det_ctx, const void *pectx,
+        Packet *p, Flow *f, void *txv,
+        const uint64_t idx, const uint8_t flags)
 {
     SCEnter();
 
+    const MpmCtx *mpm_ctx = (MpmCtx *)pectx;
     htp_tx_t *tx = (htp_tx_t *)txv;
     HtpTxUserData *tx_ud = htp_tx_get_user_data(tx);
-    uint32_t cnt = 0;
 
     if (tx_ud == NULL || tx_ud->request_uri_normalized == NULL)
-        goto end;
-    cnt = UriPatternSearch(det_ctx, (const uint8_t *)
-                           bstr_ptr(tx_ud->request_uri_normalized),
-                           bstr_len(tx_ud->request_uri_normalized),
-                           flags);
+        SCReturn;
 
-end:
-    SCReturnUInt(cnt);
+    UriPatternSearch(det_ctx, mpm_ctx, (const uint8_t *)
+                     bstr_ptr(tx_ud->request_uri_normalized),
+                     bstr_len(tx_ud->request_uri_normalized),
+                     flags);
+}
+
+int PrefilterTxUriRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx)
+{
+    SCEnter();
+
+    return PrefilterAppendTxEngine(sgh, PrefilterTxUri,
+        ALPROTO_HTTP, STREAM_TOSERVER, HTP_REQUEST_LINE+1,
+        mpm_ctx, NULL, "http_uri");
 }
 
 /**
@@ -30,6 +30,8 @@ int DetectEngineInspectPacketUris(ThreadVars *tv,
                                   Signature *s, Flow *f, uint8_t flags,
                                   void *alstate,
                                   void *tx, uint64_t tx_id);
+int PrefilterTxUriRegister(SigGroupHead *sgh, MpmCtx *mpm_ctx);
+
 void UriRegisterTests(void);
 
 #endif /* __DETECT_ENGINE_URICONTENT_H__ */
@@ -74,6 +74,7 @@
 #include "detect-engine-threshold.h"
 
 #include "detect-engine-loader.h"
+#include "detect-pcre-hs.h"
 
 #include "util-classification-config.h"
 #include "util-reference-config.h"
@@ -89,13 +90,12 @@
 #include "util-spm.h"
 
 #include "util-var-name.h"
+#include "util-cpu.h"
 
 #include "tm-threads.h"
 #include "runmodes.h"
 
-#ifdef PROFILING
 #include "util-profiling.h"
-#endif
 
 #include "reputation.h"
 
@@ -994,11 +994,11 @@ void DetectEngineCtxFree(DetectEngineCtx *de_ctx)
     if (de_ctx == NULL)
         return;
 
-#ifdef PROFILING
     if (de_ctx->profile_ctx != NULL) {
         SCProfilingRuleDestroyCtx(de_ctx->profile_ctx);
         de_ctx->profile_ctx = NULL;
     }
+#ifdef PROFILING
     if (de_ctx->profile_keyword_ctx != NULL) {
         SCProfilingKeywordDestroyCtx(de_ctx);//->profile_keyword_ctx);
 //        de_ctx->profile_keyword_ctx = NULL;
@@ -1026,6 +1026,9 @@ void DetectEngineCtxFree(DetectEngineCtx *de_ctx)
     SCRConfDeInitContext(de_ctx);
 
     SigGroupCleanup(de_ctx);
+#ifdef BUILD_HYPERSCAN
+    DetectPcreHSFree(de_ctx);
+#endif
 
     SpmDestroyGlobalThreadCtx(de_ctx->spm_global_thread_ctx);
 
@@ -1286,6 +1289,79 @@ static int DetectEngineCtxLoadConf(DetectEngineCtx *de_ctx)
     SCLogDebug("de_ctx->inspection_recursion_limit: %d",
                de_ctx->inspection_recursion_limit);
 
+    /* parse prefilter setting */
+
+    de_ctx->prefilter_setting = DETECT_PREFILTER_MPM;
+    char *pf_setting = NULL;
+    if (ConfGet("detect.prefilter.default", &pf_setting) == 1 && pf_setting) {
+        if (strcasecmp(pf_setting, "mpm") == 0) {
+            de_ctx->prefilter_setting = DETECT_PREFILTER_MPM;
+        } else if (strcasecmp(pf_setting, "auto") == 0) {
+            de_ctx->prefilter_setting = DETECT_PREFILTER_AUTO;
+        } else {
+            SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "'%s' is not a valid "
+                    "value for detect.prefilter.default, using 'mpm'",
+                    pf_setting);
+        }
+    }
+    SCLogConfig("prefilter engines: %s",
+            de_ctx->prefilter_setting == DETECT_PREFILTER_AUTO ? "auto" : "mpm");
+
+    de_ctx->prefilter_bitmap_threshold = DETECT_PREFILTER_BITMAP_THRESHOLD_DEFAULT;
+    intmax_t bitmap_threshold = 0;
+    if (ConfGetInt("detect.prefilter.bitmap-threshold", &bitmap_threshold) == 1) {
+        if (bitmap_threshold >= 0 && bitmap_threshold <= UINT32_MAX) {
+            de_ctx->prefilter_bitmap_threshold = (uint32_t)bitmap_threshold;
+        } else {
+            SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "'%"PRIdMAX"' is not "
+                    "a valid value for detect.prefilter.bitmap-threshold, "
+                    "using %u", bitmap_threshold,
+                    DETECT_PREFILTER_BITMAP_THRESHOLD_DEFAULT);
+        }
+    }
+    SCLogConfig("prefilter bitmap threshold: %u",
+            de_ctx->prefilter_bitmap_threshold);
+
+    de_ctx->mpm_build_threads = 1;
+    char *build_threads = NULL;
+    if (ConfGet("detect.mpm-build-threads", &build_threads) == 1 && build_threads) {
+        if (strcasecmp(build_threads, "auto") == 0) {
+            de_ctx->mpm_build_threads = UtilCpuGetNumProcessorsOnline();
+        } else {
+            int cnt = atoi(build_threads);
+            if (cnt >= 1 && cnt <= 1024) {
+                de_ctx->mpm_build_threads = cnt;
+            } else {
+                SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "'%s' is not a "
+                        "valid value for detect.mpm-build-threads, using 1",
+                        build_threads);
+            }
+        }
+    }
+    if (de_ctx->mpm_build_threads < 1)
+        de_ctx->mpm_build_threads = 1;
+    SCLogConfig("mpm build threads: %d", de_ctx->mpm_build_threads);
+
+    int mpm_streaming = 0;
+    (void)ConfGetBool("detect.mpm-streaming", &mpm_streaming);
+    de_ctx->mpm_streaming = mpm_streaming;
+    if (de_ctx->mpm_streaming)
+        SCLogConfig("streaming mpm enabled for the stream and http bodies");
+
+#ifdef BUILD_HYPERSCAN
+    int pcre_hs_prefilter = 0;
+    (void)ConfGetBool("hyperscan.pcre-prefilter", &pcre_hs_prefilter);
+    de_ctx->pcre_hs_prefilter = pcre_hs_prefilter;
+#endif
+
+    /* parse signature ordering settings */
+
+    int sig_order_cost = 0;
+    (void)ConfGetBool("detect.sig-order.cost", &sig_order_cost);
+    de_ctx->sig_order_cost = sig_order_cost;
+    if (de_ctx->sig_order_cost)
+        SCLogConfig("ordering rules by inspection cost");
+
     /* parse port grouping whitelisting settings */
 
     char *ports = NULL;
@@ -1532,9 +1608,6 @@ static TmEcode ThreadCtxDoInit (DetectEngineCtx *de_ctx, DetectEngineThreadCtx *
         BUG_ON(det_ctx->non_mpm_id_array == NULL);
     }
 
-    /* IP-ONLY */
-    DetectEngineIPOnlyThreadInit(de_ctx,&det_ctx->io_ctx);
-
     /* DeState */
     if (de_ctx->sig_array_len > 0) {
         det_ctx->de_state_sig_array_len = de_ctx->sig_array_len;
@@ -1552,6 +1625,14 @@ static TmEcode ThreadCtxDoInit (DetectEngineCtx *de_ctx, DetectEngineThreadCtx *
         }
         memset(det_ctx->match_array, 0,
                det_ctx->match_array_len * sizeof(Signature *));
+
+        /* candidate bitmap, one bit per sig */
+        det_ctx->prefilter_bitmap_words = (de_ctx->sig_array_len + 63) / 64;
+        det_ctx->prefilter_bitmap = SCCalloc(det_ctx->prefilter_bitmap_words,
+                sizeof(uint64_t));
+        if (det_ctx->prefilter_bitmap == NULL) {
+            return TM_ECODE_FAILED;
+        }
     }
 
     /* byte_extract storage */
@@ -1572,8 +1653,8 @@ static TmEcode ThreadCtxDoInit (DetectEngineCtx *de_ctx, DetectEngineThreadCtx *
     }
 
     DetectEngineThreadCtxInitKeywords(de_ctx, det_ctx);
-#ifdef PROFILING
     SCProfilingRuleThreadSetup(de_ctx->profile_ctx, det_ctx);
+#ifdef PROFILING
     SCProfilingKeywordThreadSetup(de_ctx->profile_keyword_ctx, det_ctx);
     SCProfilingSghThreadSetup(de_ctx->profile_sgh_ctx, det_ctx);
 #endif
@@ -1640,6 +1721,10 @@ TmEcode DetectEngineThreadCtxInit(ThreadVars *tv, void *initdata, void **data)
 
     /** alert counter setup */
     det_ctx->counter_alerts = counter_alerts;
+#ifdef BUILD_HYPERSCAN
+    if (det_ctx->de_ctx->pcre_hs != NULL)
+        DetectPcreHSRegisterCounters(tv, det_ctx);
+#endif
 #ifdef PROFILING
     det_ctx->counter_mpm_list = counter_mpm_list;
     det_ctx->counter_nonmpm_list = counter_nonmpm_list;
@@ -1692,6 +1777,10 @@ static DetectEngineThreadCtx *DetectEngineThreadCtxInitForReload(
 
     /** alert counter setup */
     det_ctx->counter_alerts = StatsRegisterCounter("detect.alert", tv);
+#ifdef BUILD_HYPERSCAN
+    if (det_ctx->de_ctx->pcre_hs != NULL)
+        DetectPcreHSRegisterCounters(tv, det_ctx);
+#endif
 #ifdef PROFILING
     uint16_t counter_mpm_list = StatsRegisterAvgCounter("detect.mpm_list", tv);
     uint16_t counter_nonmpm_list = StatsRegisterAvgCounter("detect.nonmpm_list", tv);
@@ -1723,14 +1812,12 @@ void DetectEngineThreadCtxFree(DetectEngineThreadCtx *det_ctx)
         det_ctx->tenant_array = NULL;
     }
 
-#ifdef PROFILING
     SCProfilingRuleThreadCleanup(det_ctx);
+#ifdef PROFILING
     SCProfilingKeywordThreadCleanup(det_ctx);
     SCProfilingSghThreadCleanup(det_ctx);
 #endif
 
-    DetectEngineIPOnlyThreadDeinit(&det_ctx->io_ctx);
-
     /** \todo get rid of this static */
     if (det_ctx->de_ctx != NULL) {
         PatternMatchThreadDestroy(&det_ctx->mtc, det_ctx->de_ctx->mpm_matcher);
@@ -1751,6 +1838,8 @@ void DetectEngineThreadCtxFree(DetectEngineThreadCtx *det_ctx)
         SCFree(det_ctx->de_state_sig_array);
     if (det_ctx->match_array != NULL)
         SCFree(det_ctx->match_array);
+    if (det_ctx->prefilter_bitmap != NULL)
+        SCFree(det_ctx->prefilter_bitmap);
 
     if (det_ctx->bj_values != NULL)
         SCFree(det_ctx->bj_values);
@@ -2608,6 +2697,12 @@ void DetectEnginePruneFreeList(void)
 static int reloads = 0;
 
 /** \brief Reload the detection engine
+ *
+ *  A complete new engine is built. The rule groups of the running engine
+ *  can't be moved over, as they and their mpm contexts use the internal
+ *  signature numbers of that engine. The compiled pattern matchers of the
+ *  groups whose fast patterns didn't change (Hyperscan databases, AC state
+ *  tables) are shared with the running engine instead of built again.
  *
  *  \param filename YAML file to load for the detect config
  *
@@ -29,6 +29,7 @@
 
 #include "detect.h"
 #include "detect-parse.h"
+#include "detect-engine-prefilter-common.h"
 
 #include "flow-var.h"
 #include "decode-events.h"
@@ -60,6 +61,9 @@ static int DetectFlagsMatch (ThreadVars *, DetectEngineThreadCtx *, Packet *, Si
 static int DetectFlagsSetup (DetectEngineCtx *, Signature *, char *);
 static void DetectFlagsFree(void *);
 
+static _Bool PrefilterTcpFlagsIsPrefilterable(const Signature *s);
+static int PrefilterSetupTcpFlags(SigGroupHead *sgh);
+
 /**
  * \brief Registration function for flags: keyword
  */
@@ -72,9 +76,54 @@ void DetectFlagsRegister (void)
     sigmatch_table[DETECT_FLAGS].Free  = DetectFlagsFree;
     sigmatch_table[DETECT_FLAGS].RegisterTests = FlagsRegisterTests;
 
+    sigmatch_table[DETECT_FLAGS].SupportsPrefilter = PrefilterTcpFlagsIsPrefilterable;
+    sigmatch_table[DETECT_FLAGS].SetupPrefilter = PrefilterSetupTcpFlags;
+
     DetectSetupParseRegexes(PARSE_REGEX, &parse_regex, &parse_regex_study);
 }
 
+static inline int FlagsMatch(const uint8_t pflags, const uint8_t modifier,
+                             const uint8_t dflags, const uint8_t iflags)
+{
+    if (!dflags && pflags) {
+        if (modifier == MODIFIER_NOT) {
+            return 1;
+        }
+
+        return 0;
+    }
+
+    const uint8_t flags = pflags & iflags;
+
+    switch (modifier) {
+        case MODIFIER_ANY:
+            if ((flags & dflags) > 0) {
+                return 1;
+            }
+            return 0;
+
+        case MODIFIER_PLUS:
+            if (((flags & dflags) == dflags)) {
+                return 1;
+            }
+            return 0;
+
+        case MODIFIER_NOT:
+            if ((flags & dflags) != dflags) {
+                return 1;
+            }
+            return 0;
+
+        default:
+            SCLogDebug("flags %"PRIu8" and de->flags %"PRIu8"", flags, dflags);
+            if (flags == dflags) {
+                return 1;
+            }
+    }
+
+    return 0;
+}
+
 /**
  * \internal
  * \brief This function is used to match flags on a packet with those passed via flags:
@@ -92,52 +141,15 @@ static int DetectFlagsMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Pack
 {
     SCEnter();
 
-    uint8_t flags = 0;
     const DetectFlagsData *de = (const DetectFlagsData *)ctx;
 
     if (!(PKT_IS_TCP(p)) || PKT_IS_PSEUDOPKT(p)) {
         SCReturnInt(0);
     }
 
-    flags = p->tcph->th_flags;
-
-    if (!de->flags && flags) {
-        if(de->modifier == MODIFIER_NOT) {
-            SCReturnInt(1);
-        }
-
-        SCReturnInt(0);
-    }
-
-    flags &= de->ignored_flags;
-
-    switch (de->modifier) {
-        case MODIFIER_ANY:
-            if ((flags & de->flags) > 0) {
-                SCReturnInt(1);
-            }
-            SCReturnInt(0);
-
-        case MODIFIER_PLUS:
-            if (((flags & de->flags) == de->flags)) {
-                SCReturnInt(1);
-            }
-            SCReturnInt(0);
+    const uint8_t flags = p->tcph->th_flags;
 
-        case MODIFIER_NOT:
-            if ((flags & de->flags) != de->flags) {
-                SCReturnInt(1);
-            }
-            SCReturnInt(0);
-
-        default:
-            SCLogDebug("flags %"PRIu8" and de->flags %"PRIu8"",flags,de->flags);
-            if (flags == de->flags) {
-                SCReturnInt(1);
-            }
-    }
-
-    SCReturnInt(0);
+    SCReturnInt(FlagsMatch(flags, de->modifier, de->flags, de->ignored_flags));
 }
 
 /**
@@ -502,6 +514,36 @@ static void DetectFlagsFree(void *de_ptr)
     if(de) SCFree(de);
 }
 
+/* prefilter code */
+
+static void
+PrefilterPacketFlagsMatch(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx)
+{
+    if (!(PKT_IS_TCP(p)) || PKT_IS_PSEUDOPKT(p)) {
+        return;
+    }
+
+    PrefilterPacketU8HashAddSids(det_ctx, pectx, p->tcph->th_flags);
+}
+
+static _Bool PrefilterPacketFlagsValueMatch(const SigMatchCtx *smctx, const uint8_t value)
+{
+    const DetectFlagsData *de = (const DetectFlagsData *)smctx;
+    return FlagsMatch(value, de->modifier, de->flags, de->ignored_flags) ?
+        TRUE : FALSE;
+}
+
+static int PrefilterSetupTcpFlags(SigGroupHead *sgh)
+{
+    return PrefilterSetupPacketHeaderU8Hash(sgh, DETECT_FLAGS,
+            PrefilterPacketFlagsValueMatch, PrefilterPacketFlagsMatch, "tcp-flags");
+}
+
+static _Bool PrefilterTcpFlagsIsPrefilterable(const Signature *s)
+{
+    return TRUE;
+}
+
 int DetectFlagsSignatureNeedsSynPackets(const Signature *s)
 {
     const SigMatch *sm;
@@ -29,6 +29,7 @@
 
 #include "detect.h"
 #include "detect-parse.h"
+#include "detect-engine-prefilter-common.h"
 
 #include "detect-icode.h"
 
@@ -50,6 +51,9 @@ static int DetectICodeSetup(DetectEngineCtx *, Signature *, char *);
 void DetectICodeRegisterTests(void);
 void DetectICodeFree(void *);
 
+static int PrefilterSetupICode(SigGroupHead *sgh);
+static _Bool PrefilterICodeIsPrefilterable(const Signature *s);
+
 
 /**
  * \brief Registration function for icode: keyword
@@ -64,9 +68,28 @@ void DetectICodeRegister (void)
     sigmatch_table[DETECT_ICODE].Free = DetectICodeFree;
     sigmatch_table[DETECT_ICODE].RegisterTests = DetectICodeRegisterTests;
 
+    sigmatch_table[DETECT_ICODE].SupportsPrefilter = PrefilterICodeIsPrefilterable;
+    sigmatch_table[DETECT_ICODE].SetupPrefilter = PrefilterSetupICode;
+
     DetectSetupParseRegexes(PARSE_REGEX, &parse_regex, &parse_regex_study);
 }
 
+static inline int ICodeMatch(const uint8_t pcode, const uint8_t mode,
+                             const uint8_t dcode1, const uint8_t dcode2)
+{
+    switch (mode) {
+        case DETECT_ICODE_EQ:
+            return pcode == dcode1;
+        case DETECT_ICODE_LT:
+            return pcode < dcode1;
+        case DETECT_ICODE_GT:
+            return pcode > dcode1;
+        case DETECT_ICODE_RN:
+            return (pcode >= dcode1 && pcode <= dcode2);
+    }
+    return 0;
+}
+
 /**
  * \brief This function is used to match icode rule option set on a packet with those passed via icode:
  *
@@ -80,7 +103,6 @@ void DetectICodeRegister (void)
  */
 int DetectICodeMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p, Signature *s, const SigMatchCtx *ctx)
 {
-    int ret = 0;
     uint8_t picode;
     const DetectICodeData *icd = (const DetectICodeData *)ctx;
 
@@ -93,25 +115,10 @@ int DetectICodeMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p,
         picode = ICMPV6_GET_CODE(p);
     } else {
         /* Packet not ICMPv4 nor ICMPv6 */
-        return ret;
-    }
-
-    switch(icd->mode) {
-        case DETECT_ICODE_EQ:
-            ret = (picode == icd->code1) ? 1 : 0;
-            break;
-        case DETECT_ICODE_LT:
-            ret = (picode < icd->code1) ? 1 : 0;
-            break;
-        case DETECT_ICODE_GT:
-            ret = (picode > icd->code1) ? 1 : 0;
-            break;
-        case DETECT_ICODE_RN:
-            ret = (picode >= icd->code1 && picode <= icd->code2) ? 1 : 0;
-            break;
+        return 0;
     }
 
-    return ret;
+    return ICodeMatch(picode, icd->mode, icd->code1, icd->code2);
 }
 
 /**
@@ -263,6 +270,44 @@ void DetectICodeFree(void *ptr)
     SCFree(icd);
 }
 
+/* prefilter code */
+
+static void PrefilterPacketICodeMatch(DetectEngineThreadCtx *det_ctx,
+        Packet *p, const void *pectx)
+{
+    if (PKT_IS_PSEUDOPKT(p))
+        return;
+
+    uint8_t picode;
+    if (PKT_IS_ICMPV4(p)) {
+        picode = ICMPV4_GET_CODE(p);
+    } else if (PKT_IS_ICMPV6(p)) {
+        picode = ICMPV6_GET_CODE(p);
+    } else {
+        /* Packet not ICMPv4 nor ICMPv6 */
+        return;
+    }
+
+    PrefilterPacketU8HashAddSids(det_ctx, pectx, picode);
+}
+
+static _Bool PrefilterICodeValueMatch(const SigMatchCtx *smctx, const uint8_t value)
+{
+    const DetectICodeData *a = (const DetectICodeData *)smctx;
+    return ICodeMatch(value, a->mode, a->code1, a->code2) ? TRUE : FALSE;
+}
+
+static int PrefilterSetupICode(SigGroupHead *sgh)
+{
+    return PrefilterSetupPacketHeaderU8Hash(sgh, DETECT_ICODE,
+            PrefilterICodeValueMatch, PrefilterPacketICodeMatch, "icode");
+}
+
+static _Bool PrefilterICodeIsPrefilterable(const Signature *s)
+{
+    return TRUE;
+}
+
 #ifdef UNITTESTS
 #include "detect-engine.h"
 #include "detect-engine-mpm.h"
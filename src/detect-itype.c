@@ -29,6 +29,7 @@
 
 #include "detect.h"
 #include "detect-parse.h"
+#include "detect-engine-prefilter-common.h"
 
 #include "detect-itype.h"
 
@@ -50,6 +51,9 @@ static int DetectITypeSetup(DetectEngineCtx *, Signature *, char *);
 void DetectITypeRegisterTests(void);
 void DetectITypeFree(void *);
 
+static int PrefilterSetupIType(SigGroupHead *sgh);
+static _Bool PrefilterITypeIsPrefilterable(const Signature *s);
+
 
 /**
  * \brief Registration function for itype: keyword
@@ -64,9 +68,28 @@ void DetectITypeRegister (void)
     sigmatch_table[DETECT_ITYPE].Free = DetectITypeFree;
     sigmatch_table[DETECT_ITYPE].RegisterTests = DetectITypeRegisterTests;
 
+    sigmatch_table[DETECT_ITYPE].SupportsPrefilter = PrefilterITypeIsPrefilterable;
+    sigmatch_table[DETECT_ITYPE].SetupPrefilter = PrefilterSetupIType;
+
     DetectSetupParseRegexes(PARSE_REGEX, &parse_regex, &parse_regex_study);
 }
 
+static inline int ITypeMatch(const uint8_t ptype, const uint8_t mode,
+                             const uint8_t dtype1, const uint8_t dtype2)
+{
+    switch (mode) {
+        case DETECT_ITYPE_EQ:
+            return ptype == dtype1;
+        case DETECT_ITYPE_LT:
+            return ptype < dtype1;
+        case DETECT_ITYPE_GT:
+            return ptype > dtype1;
+        case DETECT_ITYPE_RN:
+            return (ptype > dtype1 && ptype < dtype2);
+    }
+    return 0;
+}
+
 /**
  * \brief This function is used to match itype rule option set on a packet with those passed via itype:
  *
@@ -80,7 +103,6 @@ void DetectITypeRegister (void)
  */
 int DetectITypeMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p, Signature *s, const SigMatchCtx *ctx)
 {
-    int ret = 0;
     uint8_t pitype;
     const DetectITypeData *itd = (const DetectITypeData *)ctx;
 
@@ -93,25 +115,10 @@ int DetectITypeMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p,
         pitype = ICMPV6_GET_TYPE(p);
     } else {
         /* Packet not ICMPv4 nor ICMPv6 */
-        return ret;
-    }
-
-    switch(itd->mode) {
-        case DETECT_ITYPE_EQ:
-            ret = (pitype == itd->type1) ? 1 : 0;
-            break;
-        case DETECT_ITYPE_LT:
-            ret = (pitype < itd->type1) ? 1 : 0;
-            break;
-        case DETECT_ITYPE_GT:
-            ret = (pitype > itd->type1) ? 1 : 0;
-            break;
-        case DETECT_ITYPE_RN:
-            ret = (pitype > itd->type1 && pitype < itd->type2) ? 1 : 0;
-            break;
+        return 0;
     }
 
-    return ret;
+    return ITypeMatch(pitype, itd->mode, itd->type1, itd->type2);
 }
 
 /**
@@ -263,6 +270,44 @@ void DetectITypeFree(void *ptr)
     SCFree(itd);
 }
 
+/* prefilter code */
+
+static void PrefilterPacketITypeMatch(DetectEngineThreadCtx *det_ctx,
+        Packet *p, const void *pectx)
+{
+    if (PKT_IS_PSEUDOPKT(p))
+        return;
+
+    uint8_t pitype;
+    if (PKT_IS_ICMPV4(p)) {
+        pitype = ICMPV4_GET_TYPE(p);
+    } else if (PKT_IS_ICMPV6(p)) {
+        pitype = ICMPV6_GET_TYPE(p);
+    } else {
+        /* Packet not ICMPv4 nor ICMPv6 */
+        return;
+    }
+
+    PrefilterPacketU8HashAddSids(det_ctx, pectx, pitype);
+}
+
+static _Bool PrefilterITypeValueMatch(const SigMatchCtx *smctx, const uint8_t value)
+{
+    const DetectITypeData *a = (const DetectITypeData *)smctx;
+    return ITypeMatch(value, a->mode, a->type1, a->type2) ? TRUE : FALSE;
+}
+
+static int PrefilterSetupIType(SigGroupHead *sgh)
+{
+    return PrefilterSetupPacketHeaderU8Hash(sgh, DETECT_ITYPE,
+            PrefilterITypeValueMatch, PrefilterPacketITypeMatch, "itype");
+}
+
+static _Bool PrefilterITypeIsPrefilterable(const Signature *s)
+{
+    return TRUE;
+}
+
 #ifdef UNITTESTS
 
 #include "detect-engine.h"
@@ -0,0 +1,1140 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Hyperscan prefilter for the pcre keyword (hyperscan.pcre-prefilter).
+ *
+ * The pcres of a rule group that are inspected in the same buffer type
+ * (sm list) are compiled into a single Hyperscan block mode database, in
+ * Hyperscan's prefilter mode. A prefilter mode database reports a
+ * superset of the matches of the pcres, so a pcre that isn't reported
+ * for a buffer can't match anywhere in it.
+ *
+ * Scanning a buffer only pays off if more than one pcre of the group is
+ * inspected in it. The first prefiltered pcre inspected in a buffer is run
+ * by pcre_exec() as usual. The second one scans the buffer with the
+ * database of its group and list, and the result is kept for the other
+ * pcres of that group inspected in the same buffer while detecting the
+ * packet. From then on only the pcres Hyperscan reported are run by
+ * pcre_exec() to confirm the match. For the same reason groups of a single
+ * pcre get no database.
+ *
+ * The detect.pcre_hs.* counters show the number of scans and of pcre_exec()
+ * calls that were skipped or passed on by the prefilter.
+ *
+ * Only pcres that are matched from the start of the buffer are prefiltered:
+ * relative pcres depend on the previous matches. Pcres that Hyperscan
+ * doesn't support or that can match an empty string are left alone.
+ *
+ * Pcres with the same expression and flags share an id. The databases are
+ * shared through util-hyperscan.c, like the mpm ones: rule groups with the
+ * same pcres share a database, also with the detection engine of a rule
+ * reload, and the databases are stored in the on disk cache if
+ * mpm-cache.dir is set.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+
+#include "detect.h"
+#include "detect-parse.h"
+#include "detect-engine.h"
+#include "detect-pcre.h"
+#include "detect-pcre-hs.h"
+
+#include "counters.h"
+
+#include "util-debug.h"
+#include "util-hashlist.h"
+#include "util-hyperscan.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+#ifdef BUILD_HYPERSCAN
+
+#include <hs.h>
+
+/* pcres of a group inspected in a buffer before the buffer is scanned */
+#define DETECT_PCRE_HS_SCAN_MIN     2
+
+#define DETECT_PCRE_HS_HASH_SIZE    4096
+
+typedef struct DetectPcreHSGroup_ {
+    /** sm list the pcres are inspected in */
+    int list;
+    /** number of pcres, the Hyperscan id of a pcre is its index */
+    uint32_t cnt;
+    /** sorted pcre ids */
+    uint32_t *ids;
+    /** NULL if the group has no database */
+    HSDatabase *db;
+} DetectPcreHSGroup;
+
+typedef struct DetectPcreHSCtx_ {
+    /** number of prefiltered pcres, their ids are 1..cnt */
+    uint32_t cnt;
+    /** number of pcres of the largest group with a database */
+    uint32_t max_group_cnt;
+    uint32_t groups_cnt;
+
+    /** id of the thread ctx, see DetectRegisterThreadCtxFuncs() */
+    int thread_ctx_id;
+    /** scratch that fits all databases, cloned for each thread */
+    hs_scratch_t *scratch_proto;
+    /** the groups, owned by this hash */
+    HashListTable *groups;
+
+    /* build time only, freed by DetectPcreHSFinalize() */
+
+    /** pcre by id, one of the pcres with that expression and flags */
+    DetectPcreData **pds;
+    /** expressions by expression and flags, for assigning the ids */
+    HashListTable *exprs;
+    /** (list << 32 | id) of the prefiltered pcres of all sigs. The keys
+     *  of sig num n are sig_keys[sig_start[n]] to sig_keys[sig_start[n + 1]] */
+    uint64_t *sig_keys;
+    uint32_t sig_keys_cnt;
+    uint32_t *sig_start;
+    /** work arrays for DetectPcreHSSetupRuleGroup() */
+    uint64_t *keys;
+    uint32_t *ids;
+} DetectPcreHSCtx;
+
+/** state of the last buffer of a list */
+typedef struct DetectPcreHSResult_ {
+    /** valid if equal to the packet counter of the thread */
+    uint64_t packet;
+    const DetectPcreHSGroup *group;
+    const uint8_t *buffer;
+    uint32_t buffer_len;
+    /** pcres inspected in the buffer before it was scanned */
+    uint32_t inspected;
+    /** 1 if scanned, -1 if the scan failed */
+    int scanned;
+    /** bit per group pcre, set if Hyperscan reported it */
+    uint8_t *matches;
+} DetectPcreHSResult;
+
+typedef struct DetectPcreHSThreadCtx_ {
+    hs_scratch_t *scratch;
+    /** incremented for each packet, see DetectPcreHSThreadReset() */
+    uint64_t packet;
+    /** by sm list, a rule group has one database per list */
+    DetectPcreHSResult results[DETECT_SM_LIST_DETECT_MAX];
+    uint8_t *matches;
+} DetectPcreHSThreadCtx;
+
+static unsigned int DetectPcreHSFlags(const DetectPcreData *pd)
+{
+    unsigned int flags = HS_FLAG_SINGLEMATCH | HS_FLAG_PREFILTER;
+
+    if (pd->opts & PCRE_CASELESS)
+        flags |= HS_FLAG_CASELESS;
+    if (pd->opts & PCRE_MULTILINE)
+        flags |= HS_FLAG_MULTILINE;
+    if (pd->opts & PCRE_DOTALL)
+        flags |= HS_FLAG_DOTALL;
+    return flags;
+}
+
+/**
+ * \internal
+ * \brief Check if the pcre is inspected in a way the prefilter can handle.
+ *
+ * Options without a Hyperscan flag are fine if they only restrict where
+ * the pcre matches, as the prefilter may report too much: e.g. 'A', 'E'
+ * and 'G'. 'x' changes the meaning of the expression, so it isn't.
+ */
+static int DetectPcreHSSupported(const DetectPcreData *pd, int list)
+{
+    if (pd->hs_expr == NULL)
+        return 0;
+    if (pd->flags & DETECT_PCRE_RELATIVE)
+        return 0;
+    /* the decoded buffer is reused for each rule */
+    if (list == DETECT_SM_LIST_BASE64_DATA)
+        return 0;
+    if (pd->opts & PCRE_EXTENDED)
+        return 0;
+    return 1;
+}
+
+/**
+ * \internal
+ * \brief Check if Hyperscan can prefilter the expression of the pcre.
+ */
+static int DetectPcreHSExpressionSupported(const DetectPcreData *pd)
+{
+    hs_expr_info_t *info = NULL;
+    hs_compile_error_t *compile_err = NULL;
+
+    hs_error_t err = hs_expression_info(pd->hs_expr, DetectPcreHSFlags(pd),
+                                        &info, &compile_err);
+    if (err != HS_SUCCESS) {
+        SCLogDebug("pcre \"%s\" not supported by hyperscan: %s", pd->hs_expr,
+                   compile_err != NULL ? compile_err->message : "unknown error");
+        hs_free_compile_error(compile_err);
+        return 0;
+    }
+
+    /* a pcre that can match an empty string matches any buffer */
+    int r = (info->min_width > 0);
+    SCFree(info);
+    return r;
+}
+
+static uint32_t DetectPcreHSExprHash(HashListTable *ht, void *data, uint16_t datalen)
+{
+    const DetectPcreData *pd = (DetectPcreData *)data;
+    uint32_t hash = DetectPcreHSFlags(pd);
+    const char *c;
+
+    for (c = pd->hs_expr; *c != '\0'; c++) {
+        hash = hash * 31 + (uint8_t)*c;
+    }
+    return hash % ht->array_size;
+}
+
+static char DetectPcreHSExprCompare(void *data1, uint16_t len1, void *data2,
+                                    uint16_t len2)
+{
+    const DetectPcreData *pd1 = (DetectPcreData *)data1;
+    const DetectPcreData *pd2 = (DetectPcreData *)data2;
+
+    return DetectPcreHSFlags(pd1) == DetectPcreHSFlags(pd2) &&
+           strcmp(pd1->hs_expr, pd2->hs_expr) == 0;
+}
+
+static uint32_t DetectPcreHSGroupHash(HashListTable *ht, void *data, uint16_t datalen)
+{
+    const DetectPcreHSGroup *g = (DetectPcreHSGroup *)data;
+    uint32_t hash = (uint32_t)g->list * 31 + g->cnt;
+    uint32_t i;
+
+    for (i = 0; i < g->cnt; i++) {
+        hash = hash * 31 + g->ids[i];
+    }
+    return hash % ht->array_size;
+}
+
+static char DetectPcreHSGroupCompare(void *data1, uint16_t len1, void *data2,
+                                     uint16_t len2)
+{
+    const DetectPcreHSGroup *g1 = (DetectPcreHSGroup *)data1;
+    const DetectPcreHSGroup *g2 = (DetectPcreHSGroup *)data2;
+
+    return g1->list == g2->list && g1->cnt == g2->cnt &&
+           memcmp(g1->ids, g2->ids, g1->cnt * sizeof(uint32_t)) == 0;
+}
+
+static void DetectPcreHSGroupFree(void *data)
+{
+    DetectPcreHSGroup *g = (DetectPcreHSGroup *)data;
+    if (g == NULL)
+        return;
+
+    if (g->db != NULL)
+        HSDatabaseRelease(g->db);
+    if (g->ids != NULL)
+        SCFree(g->ids);
+    SCFree(g);
+}
+
+static void DetectPcreHSCtxFreeBuildData(DetectPcreHSCtx *ctx)
+{
+    if (ctx->exprs != NULL) {
+        HashListTableFree(ctx->exprs);
+        ctx->exprs = NULL;
+    }
+    if (ctx->pds != NULL) {
+        SCFree(ctx->pds);
+        ctx->pds = NULL;
+    }
+    if (ctx->sig_keys != NULL) {
+        SCFree(ctx->sig_keys);
+        ctx->sig_keys = NULL;
+    }
+    if (ctx->sig_start != NULL) {
+        SCFree(ctx->sig_start);
+        ctx->sig_start = NULL;
+    }
+    if (ctx->keys != NULL) {
+        SCFree(ctx->keys);
+        ctx->keys = NULL;
+    }
+    if (ctx->ids != NULL) {
+        SCFree(ctx->ids);
+        ctx->ids = NULL;
+    }
+}
+
+static void DetectPcreHSCtxFree(DetectPcreHSCtx *ctx)
+{
+    if (ctx == NULL)
+        return;
+
+    DetectPcreHSCtxFreeBuildData(ctx);
+    if (ctx->groups != NULL)
+        HashListTableFree(ctx->groups);
+    if (ctx->scratch_proto != NULL)
+        hs_free_scratch(ctx->scratch_proto);
+    SCFree(ctx);
+}
+
+static void *DetectPcreHSThreadInit(void *data)
+{
+    const DetectPcreHSCtx *ctx = (DetectPcreHSCtx *)data;
+
+    DetectPcreHSThreadCtx *t = SCCalloc(1, sizeof(DetectPcreHSThreadCtx));
+    if (unlikely(t == NULL))
+        return NULL;
+
+    /* no scratch if none of the databases compiled */
+    if (ctx->scratch_proto != NULL &&
+        hs_clone_scratch(ctx->scratch_proto, &t->scratch) != HS_SUCCESS)
+    {
+        SCLogError(SC_ERR_MEM_ALLOC, "unable to clone the pcre prefilter "
+                   "hyperscan scratch");
+        SCFree(t);
+        return NULL;
+    }
+
+    /* no result is valid for packet 0 */
+    t->packet = 1;
+
+    const uint32_t matches_size = ctx->max_group_cnt / 8 + 1;
+    t->matches = SCCalloc(DETECT_SM_LIST_DETECT_MAX, matches_size);
+    if (unlikely(t->matches == NULL)) {
+        if (t->scratch != NULL)
+            hs_free_scratch(t->scratch);
+        SCFree(t);
+        return NULL;
+    }
+    int i;
+    for (i = 0; i < DETECT_SM_LIST_DETECT_MAX; i++) {
+        t->results[i].matches = t->matches + i * matches_size;
+    }
+    return t;
+}
+
+static void DetectPcreHSThreadFree(void *data)
+{
+    DetectPcreHSThreadCtx *t = (DetectPcreHSThreadCtx *)data;
+    if (t == NULL)
+        return;
+
+    if (t->matches != NULL)
+        SCFree(t->matches);
+    if (t->scratch != NULL)
+        hs_free_scratch(t->scratch);
+    SCFree(t);
+}
+
+static uint32_t DetectPcreHSSigCount(const Signature *s)
+{
+    uint32_t cnt = 0;
+    int list;
+
+    if (s == NULL)
+        return 0;
+
+    for (list = 0; list < DETECT_SM_LIST_DETECT_MAX; list++) {
+        const SigMatch *sm;
+        for (sm = s->sm_lists[list]; sm != NULL; sm = sm->next) {
+            if (sm->type == DETECT_PCRE)
+                cnt++;
+        }
+    }
+    return cnt;
+}
+
+/**
+ * \brief Assign the prefilter ids to the pcres of the detection engine.
+ *
+ * Sets up de_ctx->pcre_hs if hyperscan.pcre-prefilter is enabled and
+ * any pcre can be prefiltered. Called before the rule groups are set up.
+ */
+void DetectPcreHSPrepare(DetectEngineCtx *de_ctx)
+{
+    if (!de_ctx->pcre_hs_prefilter)
+        return;
+    BUG_ON(de_ctx->pcre_hs != NULL);
+
+    const uint32_t max_num = DetectEngineGetMaxSigId(de_ctx);
+    uint32_t total = 0;
+    uint32_t num;
+
+    for (num = 0; num < max_num; num++) {
+        total += DetectPcreHSSigCount(de_ctx->sig_array[num]);
+    }
+    if (total == 0)
+        return;
+
+    DetectPcreHSCtx *ctx = SCCalloc(1, sizeof(DetectPcreHSCtx));
+    if (unlikely(ctx == NULL))
+        goto error;
+
+    ctx->pds = SCCalloc(total + 1, sizeof(DetectPcreData *));
+    ctx->sig_keys = SCCalloc(total, sizeof(uint64_t));
+    ctx->sig_start = SCCalloc(max_num + 1, sizeof(uint32_t));
+    ctx->keys = SCCalloc(total, sizeof(uint64_t));
+    ctx->ids = SCCalloc(total, sizeof(uint32_t));
+    ctx->exprs = HashListTableInit(DETECT_PCRE_HS_HASH_SIZE,
+            DetectPcreHSExprHash, DetectPcreHSExprCompare, NULL);
+    ctx->groups = HashListTableInit(DETECT_PCRE_HS_HASH_SIZE,
+            DetectPcreHSGroupHash, DetectPcreHSGroupCompare,
+            DetectPcreHSGroupFree);
+    if (ctx->pds == NULL || ctx->sig_keys == NULL || ctx->sig_start == NULL ||
+        ctx->keys == NULL || ctx->ids == NULL || ctx->exprs == NULL ||
+        ctx->groups == NULL)
+    {
+        goto error;
+    }
+
+    for (num = 0; num < max_num; num++) {
+        ctx->sig_start[num] = ctx->sig_keys_cnt;
+
+        const Signature *s = de_ctx->sig_array[num];
+        if (s == NULL)
+            continue;
+
+        int list;
+        for (list = 0; list < DETECT_SM_LIST_DETECT_MAX; list++) {
+            const SigMatch *sm;
+            for (sm = s->sm_lists[list]; sm != NULL; sm = sm->next) {
+                if (sm->type != DETECT_PCRE)
+                    continue;
+
+                DetectPcreData *pd = (DetectPcreData *)sm->ctx;
+                pd->hs_id = 0;
+                if (!DetectPcreHSSupported(pd, list))
+                    continue;
+
+                const DetectPcreData *dup = HashListTableLookup(ctx->exprs, pd, 0);
+                if (dup != NULL) {
+                    pd->hs_id = dup->hs_id;
+                } else {
+                    if (!DetectPcreHSExpressionSupported(pd))
+                        continue;
+                    if (HashListTableAdd(ctx->exprs, pd, 0) != 0)
+                        goto error;
+                    pd->hs_id = ++ctx->cnt;
+                    ctx->pds[pd->hs_id] = pd;
+                }
+                pd->hs_list = list;
+                ctx->sig_keys[ctx->sig_keys_cnt++] =
+                    ((uint64_t)list << 32) | pd->hs_id;
+            }
+        }
+    }
+    ctx->sig_start[max_num] = ctx->sig_keys_cnt;
+
+    if (ctx->cnt == 0) {
+        SCLogConfig("pcre prefilter: none of the %u pcres are supported by "
+                    "hyperscan", total);
+        DetectPcreHSCtxFree(ctx);
+        return;
+    }
+
+    ctx->thread_ctx_id = DetectRegisterThreadCtxFuncs(de_ctx, "pcre-hs",
+            DetectPcreHSThreadInit, ctx, DetectPcreHSThreadFree, 1);
+    if (ctx->thread_ctx_id == -1)
+        goto error;
+
+    de_ctx->pcre_hs = ctx;
+    return;
+
+error:
+    SCLogError(SC_ERR_MEM_ALLOC, "failed to set up the pcre prefilter, "
+               "pcres won't be prefiltered");
+    DetectPcreHSCtxFree(ctx);
+}
+
+typedef struct DetectPcreHSCompileArgs_ {
+    const DetectPcreHSCtx *ctx;
+    const DetectPcreHSGroup *g;
+} DetectPcreHSCompileArgs;
+
+/**
+ * \internal
+ * \brief Compile the database of a group, called by HSDatabaseGet() if
+ *        the database isn't in use or cached yet.
+ */
+static int DetectPcreHSGroupCompileDatabase(void *data, hs_database_t **hs_db)
+{
+    const DetectPcreHSCompileArgs *args = data;
+    const DetectPcreHSGroup *g = args->g;
+    int ret = -1;
+
+    const char **expressions = SCCalloc(g->cnt, sizeof(char *));
+    unsigned int *flags = SCCalloc(g->cnt, sizeof(unsigned int));
+    unsigned int *ids = SCCalloc(g->cnt, sizeof(unsigned int));
+    if (expressions == NULL || flags == NULL || ids == NULL)
+        goto end;
+
+    uint32_t i;
+    for (i = 0; i < g->cnt; i++) {
+        const DetectPcreData *pd = args->ctx->pds[g->ids[i]];
+        expressions[i] = pd->hs_expr;
+        flags[i] = DetectPcreHSFlags(pd);
+        ids[i] = i;
+    }
+
+    hs_compile_error_t *compile_err = NULL;
+    hs_error_t err = hs_compile_multi(expressions, flags, ids, g->cnt,
+                                      HS_MODE_BLOCK, NULL, hs_db,
+                                      &compile_err);
+    if (err != HS_SUCCESS) {
+        SCLogWarning(SC_ERR_PCRE_COMPILE, "failed to compile the hyperscan "
+                     "database of %u pcres, they won't be prefiltered: %s",
+                     g->cnt, compile_err != NULL ? compile_err->message :
+                     "unknown error");
+        hs_free_compile_error(compile_err);
+        goto end;
+    }
+    ret = 0;
+
+end:
+    if (expressions != NULL)
+        SCFree(expressions);
+    if (flags != NULL)
+        SCFree(flags);
+    if (ids != NULL)
+        SCFree(ids);
+    return ret;
+}
+
+/* key of the shared databases, see HSDatabaseGet() */
+#define DETECT_PCRE_HS_KEY "pcre-prefilter\n"
+
+/**
+ * \internal
+ * \brief Build the database key of a group: the expressions and flags of
+ *        its pcres, in database order.
+ *
+ * \retval key buffer, to be freed by the caller, NULL on error
+ */
+static uint8_t *DetectPcreHSGroupKey(const DetectPcreHSCtx *ctx,
+        const DetectPcreHSGroup *g, uint32_t *key_len)
+{
+    const size_t tag_len = strlen(DETECT_PCRE_HS_KEY);
+    size_t len = tag_len + sizeof(uint32_t);
+    uint32_t i;
+
+    for (i = 0; i < g->cnt; i++) {
+        len += 2 * sizeof(uint32_t) + strlen(ctx->pds[g->ids[i]]->hs_expr);
+    }
+    if (len > UINT32_MAX)
+        return NULL;
+
+    uint8_t *key = SCMalloc(len);
+    if (unlikely(key == NULL))
+        return NULL;
+
+    uint8_t *ptr = key;
+    memcpy(ptr, DETECT_PCRE_HS_KEY, tag_len);
+    ptr += tag_len;
+    memcpy(ptr, &g->cnt, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    for (i = 0; i < g->cnt; i++) {
+        const DetectPcreData *pd = ctx->pds[g->ids[i]];
+        const uint32_t flags = DetectPcreHSFlags(pd);
+        const uint32_t expr_len = (uint32_t)strlen(pd->hs_expr);
+
+        memcpy(ptr, &flags, sizeof(uint32_t));
+        ptr += sizeof(uint32_t);
+        memcpy(ptr, &expr_len, sizeof(uint32_t));
+        ptr += sizeof(uint32_t);
+        memcpy(ptr, pd->hs_expr, expr_len);
+        ptr += expr_len;
+    }
+
+    *key_len = (uint32_t)len;
+    return key;
+}
+
+/**
+ * \internal
+ * \brief Get the database of a group.
+ *
+ * Failing to compile isn't fatal: the group is left without a database
+ * and its pcres are inspected as if the prefilter was disabled.
+ */
+static void DetectPcreHSGroupCompile(DetectPcreHSCtx *ctx, DetectPcreHSGroup *g)
+{
+    uint32_t key_len = 0;
+    uint8_t *key = DetectPcreHSGroupKey(ctx, g, &key_len);
+    if (key == NULL)
+        return;
+
+    DetectPcreHSCompileArgs args = { .ctx = ctx, .g = g };
+    g->db = HSDatabaseGet(key, key_len, DetectPcreHSGroupCompileDatabase,
+                          &args, NULL);
+    SCFree(key);
+    if (g->db == NULL)
+        return;
+
+    hs_error_t err = hs_alloc_scratch(g->db->hs_db, &ctx->scratch_proto);
+    if (err != HS_SUCCESS) {
+        SCLogWarning(SC_ERR_MEM_ALLOC, "failed to allocate hyperscan scratch "
+                     "for %u pcres, they won't be prefiltered", g->cnt);
+        HSDatabaseRelease(g->db);
+        g->db = NULL;
+    }
+}
+
+/**
+ * \internal
+ * \brief Get the group of the pcres, compiling it if it is new.
+ *
+ * \retval g group, possibly without a database
+ * \retval NULL on alloc failure
+ */
+static DetectPcreHSGroup *DetectPcreHSGroupGet(DetectPcreHSCtx *ctx,
+        int list, uint32_t *ids, uint32_t cnt)
+{
+    DetectPcreHSGroup lookup = { .list = list, .cnt = cnt, .ids = ids, .db = NULL };
+    DetectPcreHSGroup *g = HashListTableLookup(ctx->groups, &lookup, 0);
+    if (g != NULL)
+        return g;
+
+    g = SCCalloc(1, sizeof(DetectPcreHSGroup));
+    if (unlikely(g == NULL))
+        return NULL;
+    g->ids = SCMalloc(cnt * sizeof(uint32_t));
+    if (unlikely(g->ids == NULL)) {
+        SCFree(g);
+        return NULL;
+    }
+    memcpy(g->ids, ids, cnt * sizeof(uint32_t));
+    g->list = list;
+    g->cnt = cnt;
+
+    /* a single pcre is never scanned, see DetectPcreHSMayMatch() */
+    if (cnt >= DETECT_PCRE_HS_SCAN_MIN)
+        DetectPcreHSGroupCompile(ctx, g);
+
+    if (HashListTableAdd(ctx->groups, g, 0) != 0) {
+        DetectPcreHSGroupFree(g);
+        return NULL;
+    }
+    if (g->db != NULL) {
+        ctx->groups_cnt++;
+        if (cnt > ctx->max_group_cnt)
+            ctx->max_group_cnt = cnt;
+    }
+    return g;
+}
+
+static int DetectPcreHSKeyCompare(const void *a, const void *b)
+{
+    const uint64_t ka = *(const uint64_t *)a;
+    const uint64_t kb = *(const uint64_t *)b;
+
+    return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
+
+/**
+ * \brief Set up the per list pcre groups of a rule group.
+ *
+ * \retval 0 ok, also if the rule group has nothing to prefilter
+ * \retval -1 alloc failure
+ */
+int DetectPcreHSSetupRuleGroup(DetectEngineCtx *de_ctx, SigGroupHead *sgh)
+{
+    DetectPcreHSCtx *ctx = de_ctx->pcre_hs;
+    if (ctx == NULL || sgh->init == NULL)
+        return 0;
+
+    const uint32_t max_num = DetectEngineGetMaxSigId(de_ctx);
+    uint32_t cnt = 0;
+    uint32_t num;
+
+    for (num = 0; num < max_num; num++) {
+        if (!(sgh->init->sig_array[num / 8] & (1 << (num % 8))))
+            continue;
+
+        uint32_t k;
+        for (k = ctx->sig_start[num]; k < ctx->sig_start[num + 1]; k++) {
+            ctx->keys[cnt++] = ctx->sig_keys[k];
+        }
+    }
+    if (cnt == 0)
+        return 0;
+
+    /* sorts by list, then by id */
+    qsort(ctx->keys, cnt, sizeof(uint64_t), DetectPcreHSKeyCompare);
+
+    uint32_t i = 0;
+    while (i < cnt) {
+        const int list = (int)(ctx->keys[i] >> 32);
+        uint32_t ids_cnt = 0;
+
+        for ( ; i < cnt && (int)(ctx->keys[i] >> 32) == list; i++) {
+            const uint32_t id = (uint32_t)ctx->keys[i];
+            if (ids_cnt == 0 || ctx->ids[ids_cnt - 1] != id)
+                ctx->ids[ids_cnt++] = id;
+        }
+
+        DetectPcreHSGroup *g = DetectPcreHSGroupGet(ctx, list, ctx->ids, ids_cnt);
+        if (g == NULL)
+            return -1;
+        if (g->db == NULL)
+            continue;
+
+        if (sgh->pcre_hs_groups == NULL) {
+            sgh->pcre_hs_groups = SCCalloc(DETECT_SM_LIST_DETECT_MAX,
+                                           sizeof(DetectPcreHSGroup *));
+            if (sgh->pcre_hs_groups == NULL)
+                return -1;
+        }
+        sgh->pcre_hs_groups[list] = g;
+    }
+    return 0;
+}
+
+/**
+ * \brief Free the build time data once all rule groups are set up.
+ */
+void DetectPcreHSFinalize(DetectEngineCtx *de_ctx)
+{
+    DetectPcreHSCtx *ctx = de_ctx->pcre_hs;
+    if (ctx == NULL)
+        return;
+
+    DetectPcreHSCtxFreeBuildData(ctx);
+    SCLogConfig("pcre prefilter: %u unique pcres in %u hyperscan databases",
+                ctx->cnt, ctx->groups_cnt);
+}
+
+void DetectPcreHSFree(DetectEngineCtx *de_ctx)
+{
+    if (de_ctx->pcre_hs == NULL)
+        return;
+
+    DetectPcreHSCtxFree(de_ctx->pcre_hs);
+    de_ctx->pcre_hs = NULL;
+}
+
+/**
+ * \brief Forget the scanned buffers, called for each packet as the
+ *        buffers of the previous packet may be reused.
+ */
+void DetectPcreHSThreadReset(DetectEngineThreadCtx *det_ctx)
+{
+    const DetectPcreHSCtx *ctx = det_ctx->de_ctx->pcre_hs;
+    if (ctx == NULL)
+        return;
+
+    DetectPcreHSThreadCtx *t =
+        DetectThreadCtxGetKeywordThreadCtx(det_ctx, ctx->thread_ctx_id);
+    if (t == NULL)
+        return;
+
+    t->packet++;
+}
+
+/**
+ * \internal
+ * \brief Hyperscan match callback, called by hs_scan.
+ */
+static int DetectPcreHSMatchEvent(unsigned int id, unsigned long long from,
+                                  unsigned long long to, unsigned int flags,
+                                  void *context)
+{
+    uint8_t *matches = (uint8_t *)context;
+    matches[id / 8] |= (uint8_t)(1 << (id % 8));
+    return 0;
+}
+
+/**
+ * \internal
+ * \brief Scan the buffer of a result with the database of its group.
+ *
+ * \retval 0 scanned
+ * \retval -1 the scan failed
+ */
+static int DetectPcreHSScan(DetectEngineThreadCtx *det_ctx,
+        DetectPcreHSThreadCtx *t, DetectPcreHSResult *r)
+{
+    const DetectPcreHSGroup *g = r->group;
+
+    memset(r->matches, 0, g->cnt / 8 + 1);
+
+    hs_error_t err = hs_scan(g->db->hs_db, (const char *)r->buffer,
+                             r->buffer_len, 0, t->scratch,
+                             DetectPcreHSMatchEvent, r->matches);
+    if (err != HS_SUCCESS) {
+        SCLogDebug("hs_scan returned error %d", err);
+        r->scanned = -1;
+        return -1;
+    }
+    r->scanned = 1;
+    StatsIncr(det_ctx->tv, det_ctx->counter_pcre_hs_scans);
+    return 0;
+}
+
+static int DetectPcreHSIdCompare(const void *a, const void *b)
+{
+    const uint32_t ia = *(const uint32_t *)a;
+    const uint32_t ib = *(const uint32_t *)b;
+
+    return ia < ib ? -1 : (ia > ib ? 1 : 0);
+}
+
+/**
+ * \brief Check if a prefiltered pcre can match in a buffer.
+ *
+ * The buffer is scanned once DETECT_PCRE_HS_SCAN_MIN pcres of the group
+ * were inspected in it, before that the pcres are left to pcre_exec().
+ *
+ * \param pd pcre with a prefilter id (pd->hs_id != 0)
+ * \param buffer the whole buffer the pcre is inspected in
+ *
+ * \retval 0 the pcre can't match anywhere in the buffer
+ * \retval 1 the pcre may match, or the buffer wasn't prefiltered
+ */
+int DetectPcreHSMayMatch(DetectEngineThreadCtx *det_ctx,
+        const DetectPcreData *pd, const uint8_t *buffer, uint32_t buffer_len)
+{
+    const DetectPcreHSCtx *ctx = det_ctx->de_ctx->pcre_hs;
+    const SigGroupHead *sgh = det_ctx->sgh;
+    if (ctx == NULL || sgh == NULL || sgh->pcre_hs_groups == NULL)
+        return 1;
+
+    const DetectPcreHSGroup *g = sgh->pcre_hs_groups[pd->hs_list];
+    if (g == NULL)
+        return 1;
+
+    /* the rule may be inspected outside of the rule group it was set up
+     * for, e.g. when continuing a stateful inspection */
+    const uint32_t *id = bsearch(&pd->hs_id, g->ids, g->cnt, sizeof(uint32_t),
+                                 DetectPcreHSIdCompare);
+    if (id == NULL)
+        return 1;
+
+    DetectPcreHSThreadCtx *t =
+        DetectThreadCtxGetKeywordThreadCtx(det_ctx, ctx->thread_ctx_id);
+    if (t == NULL || t->scratch == NULL)
+        return 1;
+
+    DetectPcreHSResult *r = &t->results[pd->hs_list];
+    if (r->packet != t->packet || r->group != g || r->buffer != buffer ||
+        r->buffer_len != buffer_len)
+    {
+        r->packet = t->packet;
+        r->group = g;
+        r->buffer = buffer;
+        r->buffer_len = buffer_len;
+        r->inspected = 0;
+        r->scanned = 0;
+    }
+
+    if (r->scanned == 0) {
+        if (++r->inspected < DETECT_PCRE_HS_SCAN_MIN)
+            return 1;
+        if (DetectPcreHSScan(det_ctx, t, r) != 0)
+            return 1;
+    } else if (r->scanned < 0) {
+        return 1;
+    }
+
+    const uint32_t idx = (uint32_t)(id - g->ids);
+    if (r->matches[idx / 8] & (1 << (idx % 8))) {
+        StatsIncr(det_ctx->tv, det_ctx->counter_pcre_hs_passed);
+        return 1;
+    }
+    StatsIncr(det_ctx->tv, det_ctx->counter_pcre_hs_skipped);
+    return 0;
+}
+
+/**
+ * \brief Register the prefilter counters of a detection thread.
+ */
+void DetectPcreHSRegisterCounters(ThreadVars *tv, DetectEngineThreadCtx *det_ctx)
+{
+    det_ctx->counter_pcre_hs_scans =
+        StatsRegisterCounter("detect.pcre_hs.scans", tv);
+    det_ctx->counter_pcre_hs_skipped =
+        StatsRegisterCounter("detect.pcre_hs.skipped", tv);
+    det_ctx->counter_pcre_hs_passed =
+        StatsRegisterCounter("detect.pcre_hs.passed", tv);
+}
+
+/*************************************Unittests********************************/
+
+#ifdef UNITTESTS
+
+static const DetectPcreData *DetectPcreHSTestGetPcre(const Signature *s, int n)
+{
+    const SigMatch *sm = s->sm_lists[DETECT_SM_LIST_PMATCH];
+    for ( ; sm != NULL; sm = sm->next) {
+        if (sm->type == DETECT_PCRE && n-- == 0)
+            return (DetectPcreData *)sm->ctx;
+    }
+    return NULL;
+}
+
+/**
+ * \test prefiltered, negated and relative pcres still give the regular
+ *       pcre results
+ */
+static int DetectPcreHSTest01(void)
+{
+    uint8_t *buf = (uint8_t *)"GET /index.php?id=12345 HTTP/1.0\r\n\r\n";
+    uint16_t buflen = strlen((char *)buf);
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+
+    memset(&th_v, 0, sizeof(th_v));
+
+    Packet *p = UTHBuildPacket(buf, buflen, IPPROTO_TCP);
+    FAIL_IF_NULL(p);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->pcre_hs_prefilter = 1;
+
+    Signature *s1 = DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(pcre:\"/id=[0-9]+/\"; sid:1;)");
+    FAIL_IF_NULL(s1);
+    Signature *s2 = DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(pcre:\"/id=[a-z]+/\"; sid:2;)");
+    FAIL_IF_NULL(s2);
+    Signature *s3 = DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(pcre:!\"/passwd[0-9]/i\"; sid:3;)");
+    FAIL_IF_NULL(s3);
+    Signature *s4 = DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(content:\"GET\"; pcre:\"/id=[0-9]+/\"; pcre:\"/ HTTP/R\"; sid:4;)");
+    FAIL_IF_NULL(s4);
+
+    SigGroupBuild(de_ctx);
+    FAIL_IF_NULL(de_ctx->pcre_hs);
+
+    const DetectPcreData *pd1 = DetectPcreHSTestGetPcre(s1, 0);
+    const DetectPcreData *pd4a = DetectPcreHSTestGetPcre(s4, 0);
+    const DetectPcreData *pd4b = DetectPcreHSTestGetPcre(s4, 1);
+    FAIL_IF_NULL(pd1);
+    FAIL_IF_NULL(pd4a);
+    FAIL_IF_NULL(pd4b);
+    FAIL_IF(pd1->hs_id == 0);
+    /* same expression, same id */
+    FAIL_IF(pd4a->hs_id != pd1->hs_id);
+    /* relative pcres are not prefiltered */
+    FAIL_IF(pd4b->hs_id != 0);
+
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+    FAIL_IF_NULL(det_ctx);
+
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+    FAIL_IF_NOT(PacketAlertCheck(p, 1));
+    FAIL_IF(PacketAlertCheck(p, 2));
+    FAIL_IF_NOT(PacketAlertCheck(p, 3));
+    FAIL_IF_NOT(PacketAlertCheck(p, 4));
+
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    UTHFreePackets(&p, 1);
+    PASS;
+}
+
+/**
+ * \test the scan result of a packet isn't used for the next one
+ */
+static int DetectPcreHSTest02(void)
+{
+    uint8_t *buf1 = (uint8_t *)"user=admin&pass=secret";
+    uint8_t *buf2 = (uint8_t *)"user=guest&pass=secret";
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+
+    memset(&th_v, 0, sizeof(th_v));
+
+    Packet *p1 = UTHBuildPacket(buf1, strlen((char *)buf1), IPPROTO_TCP);
+    FAIL_IF_NULL(p1);
+    Packet *p2 = UTHBuildPacket(buf2, strlen((char *)buf2), IPPROTO_TCP);
+    FAIL_IF_NULL(p2);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->pcre_hs_prefilter = 1;
+
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(pcre:\"/user=ad[a-z]+/\"; sid:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(pcre:\"/pass=s[a-z]+t/\"; sid:2;)"));
+
+    SigGroupBuild(de_ctx);
+    FAIL_IF_NULL(de_ctx->pcre_hs);
+
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+    FAIL_IF_NULL(det_ctx);
+
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p1);
+    FAIL_IF_NOT(PacketAlertCheck(p1, 1));
+    FAIL_IF_NOT(PacketAlertCheck(p1, 2));
+
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p2);
+    FAIL_IF(PacketAlertCheck(p2, 1));
+    FAIL_IF_NOT(PacketAlertCheck(p2, 2));
+
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    UTHFreePackets(&p1, 1);
+    UTHFreePackets(&p2, 1);
+    PASS;
+}
+
+/**
+ * \test pcre_exec() is skipped for the pcres the scan didn't report, and
+ *       the buffer is only scanned from the second pcre on
+ */
+static int DetectPcreHSTest03(void)
+{
+    uint8_t *buf1 = (uint8_t *)"GET /index.html HTTP/1.0";
+    uint8_t *buf2 = (uint8_t *)"id=1&pass=abx&user=zzy";
+    ThreadVars tv;
+    DetectEngineThreadCtx *det_ctx = NULL;
+
+    memset(&tv, 0, sizeof(tv));
+    strlcpy(tv.name, "detect_test", sizeof(tv.name));
+
+    Packet *p1 = UTHBuildPacket(buf1, strlen((char *)buf1), IPPROTO_TCP);
+    FAIL_IF_NULL(p1);
+    Packet *p2 = UTHBuildPacket(buf2, strlen((char *)buf2), IPPROTO_TCP);
+    FAIL_IF_NULL(p2);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->pcre_hs_prefilter = 1;
+
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(pcre:\"/id=[0-9]+/\"; sid:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(pcre:\"/pass=[a-z]+x/\"; sid:2;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+            "(pcre:\"/user=[a-z]+y/\"; sid:3;)"));
+
+    SigGroupBuild(de_ctx);
+    FAIL_IF_NULL(de_ctx->pcre_hs);
+
+    DetectEngineThreadCtxInit(&tv, (void *)de_ctx, (void *)&det_ctx);
+    FAIL_IF_NULL(det_ctx);
+    StatsSetupPrivate(&tv);
+
+    /* the first pcre runs pcre_exec() as usual, the second scans the
+     * buffer and pcre_exec() is skipped for the other two */
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p1);
+    FAIL_IF(PacketAlertCheck(p1, 1));
+    FAIL_IF(PacketAlertCheck(p1, 2));
+    FAIL_IF(PacketAlertCheck(p1, 3));
+    FAIL_IF(StatsGetLocalCounterValue(&tv, det_ctx->counter_pcre_hs_scans) != 1);
+    FAIL_IF(StatsGetLocalCounterValue(&tv, det_ctx->counter_pcre_hs_skipped) != 2);
+    FAIL_IF(StatsGetLocalCounterValue(&tv, det_ctx->counter_pcre_hs_passed) != 0);
+
+    /* all are reported and confirmed by pcre_exec() */
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p2);
+    FAIL_IF_NOT(PacketAlertCheck(p2, 1));
+    FAIL_IF_NOT(PacketAlertCheck(p2, 2));
+    FAIL_IF_NOT(PacketAlertCheck(p2, 3));
+    FAIL_IF(StatsGetLocalCounterValue(&tv, det_ctx->counter_pcre_hs_scans) != 2);
+    FAIL_IF(StatsGetLocalCounterValue(&tv, det_ctx->counter_pcre_hs_skipped) != 2);
+    FAIL_IF(StatsGetLocalCounterValue(&tv, det_ctx->counter_pcre_hs_passed) != 2);
+
+    DetectEngineThreadCtxDeinit(&tv, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    StatsThreadCleanup(&tv);
+    UTHFreePackets(&p1, 1);
+    UTHFreePackets(&p2, 1);
+    PASS;
+}
+
+/**
+ * \test a rule group with a single pcre gets no database, and the
+ *       databases are shared with the detection engine of a reload
+ */
+static int DetectPcreHSTest04(void)
+{
+    DetectEngineCtx *de_ctx1 = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx1);
+    de_ctx1->flags |= DE_QUIET;
+    de_ctx1->pcre_hs_prefilter = 1;
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx1, "alert tcp any any -> any any "
+            "(pcre:\"/id=[0-9]+/\"; sid:1;)"));
+    SigGroupBuild(de_ctx1);
+    FAIL_IF_NULL(de_ctx1->pcre_hs);
+    FAIL_IF(de_ctx1->pcre_hs->groups_cnt != 0);
+    DetectEngineCtxFree(de_ctx1);
+
+    char *sigs[] = {
+        "alert tcp any any -> any any (pcre:\"/id=[0-9]+/\"; sid:1;)",
+        "alert tcp any any -> any any (pcre:\"/pass=[a-z]+x/\"; sid:2;)",
+        NULL };
+    DetectEngineCtx *de_ctx[2];
+    int i;
+    for (i = 0; i < 2; i++) {
+        de_ctx[i] = DetectEngineCtxInit();
+        FAIL_IF_NULL(de_ctx[i]);
+        de_ctx[i]->flags |= DE_QUIET;
+        de_ctx[i]->pcre_hs_prefilter = 1;
+        int n;
+        for (n = 0; sigs[n] != NULL; n++) {
+            FAIL_IF_NULL(DetectEngineAppendSig(de_ctx[i], sigs[n]));
+        }
+        SigGroupBuild(de_ctx[i]);
+        FAIL_IF_NULL(de_ctx[i]->pcre_hs);
+        FAIL_IF(de_ctx[i]->pcre_hs->groups_cnt != 1);
+    }
+
+    const DetectPcreHSGroup *g[2] = { NULL, NULL };
+    for (i = 0; i < 2; i++) {
+        uint32_t n;
+        for (n = 0; n < de_ctx[i]->sgh_array_cnt && g[i] == NULL; n++) {
+            const SigGroupHead *sgh = de_ctx[i]->sgh_array[n];
+            if (sgh != NULL && sgh->pcre_hs_groups != NULL)
+                g[i] = sgh->pcre_hs_groups[DETECT_SM_LIST_PMATCH];
+        }
+        FAIL_IF_NULL(g[i]);
+        FAIL_IF_NULL(g[i]->db);
+    }
+    FAIL_IF(g[0]->db != g[1]->db);
+    FAIL_IF(g[0]->db->ref_cnt != 2);
+
+    DetectEngineCtxFree(de_ctx[0]);
+    FAIL_IF(g[1]->db->ref_cnt != 1);
+    DetectEngineCtxFree(de_ctx[1]);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void DetectPcreHSRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("DetectPcreHSTest01", DetectPcreHSTest01);
+    UtRegisterTest("DetectPcreHSTest02", DetectPcreHSTest02);
+    UtRegisterTest("DetectPcreHSTest03", DetectPcreHSTest03);
+    UtRegisterTest("DetectPcreHSTest04", DetectPcreHSTest04);
+#endif /* UNITTESTS */
+}
+
+#endif /* BUILD_HYPERSCAN */
@@ -0,0 +1,41 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Hyperscan prefilter for the pcre keyword.
+ */
+
+#ifndef __DETECT_PCRE_HS_H__
+#define __DETECT_PCRE_HS_H__
+
+#include "detect-pcre.h"
+
+void DetectPcreHSPrepare(DetectEngineCtx *de_ctx);
+int DetectPcreHSSetupRuleGroup(DetectEngineCtx *de_ctx, SigGroupHead *sgh);
+void DetectPcreHSFinalize(DetectEngineCtx *de_ctx);
+void DetectPcreHSFree(DetectEngineCtx *de_ctx);
+
+void DetectPcreHSRegisterCounters(ThreadVars *tv, DetectEngineThreadCtx *det_ctx);
+void DetectPcreHSThreadReset(DetectEngineThreadCtx *det_ctx);
+int DetectPcreHSMayMatch(DetectEngineThreadCtx *det_ctx,
+        const DetectPcreData *pd, const uint8_t *buffer, uint32_t buffer_len);
+
+void DetectPcreHSRegisterTests(void);
+
+#endif /* __DETECT_PCRE_HS_H__ */
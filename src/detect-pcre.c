@@ -33,6 +33,7 @@
 #include "flow-util.h"
 
 #include "detect-pcre.h"
+#include "detect-pcre-hs.h"
 #include "detect-flowvar.h"
 
 #include "detect-parse.h"
@@ -186,7 +187,14 @@ int DetectPcrePayloadMatch(DetectEngineThreadCtx *det_ctx, Signature *s,
         start_offset = (payload + det_ctx->pcre_match_start_offset - ptr);
     }
 
-    /* run the actual pcre detection */
+    /* run the actual pcre detection, unless the hyperscan prefilter
+     * found that it can't match in this buffer */
+#ifdef BUILD_HYPERSCAN
+    if (pe->hs_id != 0 &&
+        !DetectPcreHSMayMatch(det_ctx, pe, payload, payload_len))
+        ret = PCRE_ERROR_NOMATCH;
+    else
+#endif
     ret = pcre_exec(pe->re, pe->sd, (char *)ptr, len, start_offset, 0, ov, MAX_SUBSTRINGS);
     SCLogDebug("ret %d (negating %s)", ret, (pe->flags & DETECT_PCRE_NEGATE) ? "set" : "not set");
 
@@ -531,6 +539,12 @@ static DetectPcreData *DetectPcreParse (DetectEngineCtx *de_ctx, char *regexstr,
     if (pd->sd == NULL)
         pd->sd = (pcre_extra *) SCCalloc(1,sizeof(pcre_extra));
 
+    pd->opts = opts;
+#ifdef BUILD_HYPERSCAN
+    /* only used by the prefilter, which leaves the pcre alone if NULL */
+    pd->hs_expr = SCStrdup(re);
+#endif
+
     if (pd->sd) {
         if(pd->flags & DETECT_PCRE_MATCH_LIMIT) {
             if(pcre_match_limit >= -1)    {
@@ -562,6 +576,8 @@ error:
         pcre_free(pd->re);
     if (pd != NULL && pd->sd != NULL)
         pcre_free_study(pd->sd);
+    if (pd != NULL && pd->hs_expr != NULL)
+        SCFree(pd->hs_expr);
     if (pd)
         SCFree(pd);
     return NULL;
@@ -784,6 +800,8 @@ void DetectPcreFree(void *ptr)
 
     if (pd->capname != NULL)
         SCFree(pd->capname);
+    if (pd->hs_expr != NULL)
+        SCFree(pd->hs_expr);
     if (pd->re != NULL)
         pcre_free(pd->re);
     if (pd->sd != NULL)
@@ -3410,5 +3428,8 @@ void DetectPcreRegisterTests(void)
     UtRegisterTest("DetectPcreParseHttpHost", DetectPcreParseHttpHost);
 
 #endif /* UNITTESTS */
+#ifdef BUILD_HYPERSCAN
+    DetectPcreHSRegisterTests();
+#endif
 }
 
@@ -41,6 +41,13 @@ typedef struct DetectPcreData_ {
     uint16_t flags;
     uint16_t capidx;
     char *capname;
+
+    /** Hyperscan prefilter id, 0 if not prefiltered, and the list the
+     *  pcre is inspected in. See detect-pcre-hs.c */
+    uint32_t hs_id;
+    int hs_list;
+    /** the regex, for the Hyperscan prefilter */
+    char *hs_expr;
 } DetectPcreData;
 
 /* prototypes */
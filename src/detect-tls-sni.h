@@ -27,7 +27,5 @@
 #include "app-layer-ssl.h"
 
 void DetectTlsSniRegister(void);
-uint32_t DetectTlsSniInspectMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
-                                SSLState *ssl_state, uint8_t flags);
 
 #endif /* __DETECT_TLS_SNI_H__ */
@@ -29,6 +29,7 @@
 
 #include "detect.h"
 #include "detect-parse.h"
+#include "detect-engine-prefilter-common.h"
 
 #include "detect-ttl.h"
 #include "util-debug.h"
@@ -46,6 +47,8 @@ int DetectTtlMatch (ThreadVars *, DetectEngineThreadCtx *, Packet *, Signature *
 static int DetectTtlSetup (DetectEngineCtx *, Signature *, char *);
 void DetectTtlFree (void *);
 void DetectTtlRegisterTests (void);
+static int PrefilterSetupTtl(SigGroupHead *sgh);
+static _Bool PrefilterTtlIsPrefilterable(const Signature *s);
 
 /**
  * \brief Registration function for ttl: keyword
@@ -61,10 +64,28 @@ void DetectTtlRegister(void)
     sigmatch_table[DETECT_TTL].Free = DetectTtlFree;
     sigmatch_table[DETECT_TTL].RegisterTests = DetectTtlRegisterTests;
 
+    sigmatch_table[DETECT_TTL].SupportsPrefilter = PrefilterTtlIsPrefilterable;
+    sigmatch_table[DETECT_TTL].SetupPrefilter = PrefilterSetupTtl;
+
     DetectSetupParseRegexes(PARSE_REGEX, &parse_regex, &parse_regex_study);
     return;
 }
 
+static inline int TtlMatch(const uint8_t pttl, const uint8_t mode,
+                           const uint8_t dttl1, const uint8_t dttl2)
+{
+    if (mode == DETECT_TTL_EQ && pttl == dttl1)
+        return 1;
+    else if (mode == DETECT_TTL_LT && pttl < dttl1)
+        return 1;
+    else if (mode == DETECT_TTL_GT && pttl > dttl1)
+        return 1;
+    else if (mode == DETECT_TTL_RA && (pttl > dttl1 && pttl < dttl2))
+        return 1;
+
+    return 0;
+}
+
 /**
  * \brief This function is used to match TTL rule option on a packet with those passed via ttl:
  *
@@ -79,7 +100,6 @@ void DetectTtlRegister(void)
 int DetectTtlMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p, Signature *s, const SigMatchCtx *ctx)
 {
 
-    int ret = 0;
     uint8_t pttl;
     const DetectTtlData *ttld = (const DetectTtlData *)ctx;
 
@@ -92,19 +112,10 @@ int DetectTtlMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p, Si
         pttl = IPV6_GET_HLIM(p);
     } else {
         SCLogDebug("Packet is of not IPv4 or IPv6");
-        return ret;
+        return 0;
     }
 
-    if (ttld->mode == DETECT_TTL_EQ && pttl == ttld->ttl1)
-        ret = 1;
-    else if (ttld->mode == DETECT_TTL_LT && pttl < ttld->ttl1)
-        ret = 1;
-    else if (ttld->mode == DETECT_TTL_GT && pttl > ttld->ttl1)
-        ret = 1;
-    else if (ttld->mode == DETECT_TTL_RA && (pttl > ttld->ttl1 && pttl < ttld->ttl2))
-        ret = 1;
-
-    return ret;
+    return TtlMatch(pttl, ttld->mode, ttld->ttl1, ttld->ttl2);
 }
 
 /**
@@ -293,6 +304,44 @@ void DetectTtlFree(void *ptr)
     SCFree(ttld);
 }
 
+/* prefilter code */
+
+static void
+PrefilterPacketTtlMatch(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx)
+{
+    if (PKT_IS_PSEUDOPKT(p))
+        return;
+
+    uint8_t pttl;
+    if (PKT_IS_IPV4(p)) {
+        pttl = IPV4_GET_IPTTL(p);
+    } else if (PKT_IS_IPV6(p)) {
+        pttl = IPV6_GET_HLIM(p);
+    } else {
+        SCLogDebug("Packet is of not IPv4 or IPv6");
+        return;
+    }
+
+    PrefilterPacketU8HashAddSids(det_ctx, pectx, pttl);
+}
+
+static _Bool PrefilterTtlValueMatch(const SigMatchCtx *smctx, const uint8_t value)
+{
+    const DetectTtlData *a = (const DetectTtlData *)smctx;
+    return TtlMatch(value, a->mode, a->ttl1, a->ttl2) ? TRUE : FALSE;
+}
+
+static int PrefilterSetupTtl(SigGroupHead *sgh)
+{
+    return PrefilterSetupPacketHeaderU8Hash(sgh, DETECT_TTL,
+            PrefilterTtlValueMatch, PrefilterPacketTtlMatch, "ttl");
+}
+
+static _Bool PrefilterTtlIsPrefilterable(const Signature *s)
+{
+    return TRUE;
+}
+
 #ifdef UNITTESTS
 #include "detect-engine.h"
 #include "detect-engine-mpm.h"
@@ -596,6 +645,56 @@ end:
     return result;
 }
 
+/**
+ * \test DetectTtlTestSig2 tests the ttl keyword as prefilter engine
+ */
+static int DetectTtlTestSig2(void)
+{
+    Packet *p = PacketGetFromAlloc();
+    FAIL_IF_NULL(p);
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    IPV4Hdr ip4h;
+
+    memset(&th_v, 0, sizeof(th_v));
+    memset(&ip4h, 0, sizeof(ip4h));
+
+    p->src.family = AF_INET;
+    p->dst.family = AF_INET;
+    p->proto = IPPROTO_TCP;
+    ip4h.ip_ttl = 15;
+    p->ip4h = &ip4h;
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->prefilter_setting = DETECT_PREFILTER_AUTO;
+
+    Signature *s = DetectEngineAppendSig(de_ctx, "alert ip any any -> any any (ttl: >16; sid:1;)");
+    FAIL_IF_NULL(s);
+    s = DetectEngineAppendSig(de_ctx, "alert ip any any -> any any (ttl: <17; sid:2;)");
+    FAIL_IF_NULL(s);
+    s = DetectEngineAppendSig(de_ctx, "alert ip any any -> any any (ttl:15; sid:3;)");
+    FAIL_IF_NULL(s);
+    s = DetectEngineAppendSig(de_ctx, "alert ip any any -> any any (ttl: 1-14; sid:4;)");
+    FAIL_IF_NULL(s);
+
+    SigGroupBuild(de_ctx);
+    FAIL_IF_NOT(s->flags & SIG_FLAG_PREFILTER);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+    FAIL_IF(PacketAlertCheck(p, 1));
+    FAIL_IF_NOT(PacketAlertCheck(p, 2));
+    FAIL_IF_NOT(PacketAlertCheck(p, 3));
+    FAIL_IF(PacketAlertCheck(p, 4));
+
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    SCFree(p);
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 /**
@@ -613,5 +712,6 @@ void DetectTtlRegisterTests(void)
     UtRegisterTest("DetectTtlParseTest07", DetectTtlParseTest07);
     UtRegisterTest("DetectTtlSetpTest01", DetectTtlSetpTest01);
     UtRegisterTest("DetectTtlTestSig1", DetectTtlTestSig1);
+    UtRegisterTest("DetectTtlTestSig2", DetectTtlTestSig2);
 #endif /* UNITTESTS */
 }
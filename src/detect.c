@@ -41,6 +41,7 @@
 #include "detect-engine-proto.h"
 #include "detect-engine-port.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-prefilter.h"
 #include "detect-engine-iponly.h"
 #include "detect-engine-threshold.h"
 
@@ -76,6 +77,7 @@
 #include "detect-content.h"
 #include "detect-uricontent.h"
 #include "detect-pcre.h"
+#include "detect-pcre-hs.h"
 #include "detect-depth.h"
 #include "detect-nocase.h"
 #include "detect-rawbytes.h"
@@ -209,6 +211,8 @@
 #include "util-path.h"
 #include "util-mpm-ac.h"
 #include "runmodes.h"
+#include "counters.h"
+#include "util-atomic.h"
 
 #include <glob.h>
 
@@ -414,6 +418,51 @@ static int ProcessSigFiles(DetectEngineCtx *de_ctx, char *pattern,
     return r;
 }
 
+/* time the detection engine builds took, for the stats. The first build
+ * is the one at startup, later ones are reloads (or tenants). */
+SC_ATOMIC_DECLARE(uint64_t, detect_build_cnt);
+SC_ATOMIC_DECLARE(uint64_t, detect_build_startup_ms);
+SC_ATOMIC_DECLARE(uint64_t, detect_build_reload_ms);
+
+static void SigLoadSignaturesUpdateBuildTime(const struct timeval *tv_start)
+{
+    struct timeval tv_end;
+    gettimeofday(&tv_end, NULL);
+
+    uint64_t ms = ((uint64_t)(tv_end.tv_sec - tv_start->tv_sec) * 1000) +
+        ((int64_t)tv_end.tv_usec - (int64_t)tv_start->tv_usec) / 1000;
+
+    if (SC_ATOMIC_ADD(detect_build_cnt, 1) == 1) {
+        SC_ATOMIC_SET(detect_build_startup_ms, ms);
+    } else {
+        SC_ATOMIC_SET(detect_build_reload_ms, ms);
+    }
+    SCLogPerf("detection engine built in %"PRIu64" ms", ms);
+}
+
+static uint64_t DetectBuildStartupMsGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(detect_build_startup_ms);
+}
+
+static uint64_t DetectBuildReloadMsGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(detect_build_reload_ms);
+}
+
+static uint64_t DetectBuildReloadsGlobalCounter(void)
+{
+    uint64_t cnt = SC_ATOMIC_GET(detect_build_cnt);
+    return cnt ? cnt - 1 : 0;
+}
+
+void DetectEngineBuildRegisterGlobalCounters(void)
+{
+    StatsRegisterGlobalCounter("detect.build.startup_ms", DetectBuildStartupMsGlobalCounter);
+    StatsRegisterGlobalCounter("detect.build.reload_ms", DetectBuildReloadMsGlobalCounter);
+    StatsRegisterGlobalCounter("detect.build.reloads", DetectBuildReloadsGlobalCounter);
+}
+
 /**
  *  \brief Load signatures
  *  \param de_ctx Pointer to the detection engine context
@@ -425,6 +474,9 @@ int SigLoadSignatures(DetectEngineCtx *de_ctx, char *sig_file, int sig_file_excl
 {
     SCEnter();
 
+    struct timeval tv_start;
+    gettimeofday(&tv_start, NULL);
+
     ConfNode *rule_files;
     ConfNode *file = NULL;
     SigFileLoaderStat sig_stat;
@@ -527,6 +579,9 @@ int SigLoadSignatures(DetectEngineCtx *de_ctx, char *sig_file, int sig_file_excl
     }
 
     DetectParseDupSigHashFree(de_ctx);
+
+    if (ret == 0)
+        SigLoadSignaturesUpdateBuildTime(&tv_start);
     SCReturnInt(ret);
 }
 
@@ -591,24 +646,24 @@ SigGroupHead *SigMatchSignaturesGetSgh(DetectEngineCtx *de_ctx, DetectEngineThre
 
     int proto = IP_GET_IPPROTO(p);
     if (proto == IPPROTO_TCP) {
-        DetectPort *list = de_ctx->flow_gh[f].tcp;
         SCLogDebug("tcp toserver %p, tcp toclient %p: going to use %p",
                 de_ctx->flow_gh[1].tcp, de_ctx->flow_gh[0].tcp, de_ctx->flow_gh[f].tcp);
         uint16_t port = f ? p->dp : p->sp;
         SCLogDebug("tcp port %u -> %u:%u", port, p->sp, p->dp);
-        DetectPort *sghport = DetectPortLookupGroup(list, port);
+        DetectPort *sghport = DetectPortLookupArrayGroup(&de_ctx->flow_gh[f].tcp_lookup, port);
         if (sghport != NULL)
             sgh = sghport->sh;
         SCLogDebug("TCP list %p, port %u, direction %s, sghport %p, sgh %p",
-                list, port, f ? "toserver" : "toclient", sghport, sgh);
+                de_ctx->flow_gh[f].tcp, port, f ? "toserver" : "toclient",
+                sghport, sgh);
     } else if (proto == IPPROTO_UDP) {
-        DetectPort *list = de_ctx->flow_gh[f].udp;
         uint16_t port = f ? p->dp : p->sp;
-        DetectPort *sghport = DetectPortLookupGroup(list, port);
+        DetectPort *sghport = DetectPortLookupArrayGroup(&de_ctx->flow_gh[f].udp_lookup, port);
         if (sghport != NULL)
             sgh = sghport->sh;
         SCLogDebug("UDP list %p, port %u, direction %s, sghport %p, sgh %p",
-                list, port, f ? "toserver" : "toclient", sghport, sgh);
+                de_ctx->flow_gh[f].udp, port, f ? "toserver" : "toclient",
+                sghport, sgh);
     } else {
         sgh = de_ctx->flow_gh[f].sgh[proto];
     }
@@ -823,333 +878,86 @@ static inline void DetectPrefilterMergeSort(DetectEngineCtx *de_ctx,
     BUG_ON((det_ctx->pmq.rule_id_array_cnt + det_ctx->non_mpm_id_cnt) < det_ctx->match_array_cnt);
 }
 
-/* Return true is the list is sorted smallest to largest */
-static void QuickSortSigIntId(SigIntId *sids, uint32_t n)
-{
-    if (n < 2)
-        return;
-    SigIntId p = sids[n / 2];
-    SigIntId *l = sids;
-    SigIntId *r = sids + n - 1;
-    while (l <= r) {
-        if (*l < p)
-            l++;
-        else if (*r > p)
-            r--;
-        else {
-            SigIntId t = *l;
-            *l = *r;
-            *r = t;
-            l++;
-            r--;
-        }
+/** \internal
+ *  \brief set the bits for a list of sig ids in the candidate bitmap
+ *
+ *  Tracks the lowest and highest word that was touched, so that only
+ *  that part of the bitmap has to be scanned and cleared.
+ *
+ *  \param flip toggle the bits instead of setting them
+ */
+static inline void DetectPrefilterBitmapSet(uint64_t *bitmap,
+        const SigIntId *ids, uint32_t cnt, uint32_t *lo, uint32_t *hi,
+        const int flip)
+{
+    uint32_t l = *lo, h = *hi;
+    while (cnt--) {
+        const SigIntId id = *ids++;
+        const uint32_t w = id / 64;
+        if (flip)
+            bitmap[w] ^= (1ULL << (id % 64));
+        else
+            bitmap[w] |= (1ULL << (id % 64));
+        if (w < l)
+            l = w;
+        if (w > h)
+            h = w;
     }
-    QuickSortSigIntId(sids, r - sids + 1);
-    QuickSortSigIntId(l, sids + n - l);
+    *lo = l;
+    *hi = h;
 }
 
-#define SMS_USE_FLOW_SGH        0x01
-#define SMS_USED_PM             0x02
-
-/**
- * \internal
- * \brief Run mpm on packet, stream and other buffers based on
- *        alproto, sgh state.
+/** \brief merge the prefilter candidates using the candidate bitmap
  *
- * \param de_ctx       Pointer to the detection engine context.
- * \param det_ctx      Pointer to the detection engine thread context.
- * \param smsg         The stream segment to inspect for stream mpm.
- * \param p            Packet.
- * \param flags        Flags.
- * \param alproto      Flow alproto.
- * \param has_state    Bool indicating we have (al)state
- * \param sms_runflags Used to store state by detection engine.
+ *  Alternative to DetectPrefilterMergeSort for large groups: the
+ *  unsorted mpm list and the non-mpm list are set in the thread's bitmap,
+ *  which is then scanned a word at a time. The result is the same sorted,
+ *  deduplicated match_array, without sorting the mpm list first.
+ *
+ *  A sig on both lists has a negated mpm pattern that matched, so like
+ *  in DetectPrefilterMergeSort it is dropped: the non-mpm list has no
+ *  duplicates, so its bits are toggled, clearing those set by the mpm.
+ *
+ *  The bitmap words are cleared while scanning, so the bitmap is all
+ *  zero again afterwards.
  */
-static inline void DetectMpmPrefilter(DetectEngineCtx *de_ctx,
-        DetectEngineThreadCtx *det_ctx, StreamMsg *smsg, Packet *p,
-        const uint8_t flags, const AppProto alproto,
-        const int has_state, uint8_t *sms_runflags)
+static inline void DetectPrefilterMergeBitmap(DetectEngineCtx *de_ctx,
+                                              DetectEngineThreadCtx *det_ctx)
 {
-    SCEnter();
-
-    /* have a look at the reassembled stream (if any) */
-    if (p->flowflags & FLOW_PKT_ESTABLISHED) {
-        SCLogDebug("p->flowflags & FLOW_PKT_ESTABLISHED");
-
-        /* all http based mpms */
-        if (has_state && alproto == ALPROTO_HTTP) {
-            void *alstate = FlowGetAppState(p->flow);
-            if (alstate == NULL) {
-                SCLogDebug("no alstate");
-                return;
-            }
-
-            HtpState *htp_state = (HtpState *)alstate;
-            if (htp_state->connp == NULL) {
-                SCLogDebug("no HTTP connp");
-                return;
-            }
-
-            int tx_progress = 0;
-            uint64_t idx = AppLayerParserGetTransactionInspectId(p->flow->alparser, flags);
-            uint64_t total_txs = AppLayerParserGetTxCnt(IPPROTO_TCP, ALPROTO_HTTP, alstate);
-            for (; idx < total_txs; idx++) {
-                htp_tx_t *tx = AppLayerParserGetTx(IPPROTO_TCP, ALPROTO_HTTP, htp_state, idx);
-                if (tx == NULL)
-                    continue;
-
-                if (p->flowflags & FLOW_PKT_TOSERVER) {
-                    tx_progress = AppLayerParserGetStateProgress(IPPROTO_TCP, ALPROTO_HTTP, tx, flags);
-
-                    if (tx_progress > HTP_REQUEST_LINE) {
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_URI) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_URI);
-                            DetectUricontentInspectMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_URI);
-                        }
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HRUD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HRUD);
-                            DetectEngineRunHttpRawUriMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HRUD);
-                        }
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HMD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HMD);
-                            DetectEngineRunHttpMethodMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HMD);
-                        }
-                    }
-
-                    if (tx_progress >= HTP_REQUEST_HEADERS) {
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HHHD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HHHD);
-                            DetectEngineRunHttpHHMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HHHD);
-                        }
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HRHHD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HRHHD);
-                            DetectEngineRunHttpHRHMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HRHHD);
-                        }
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HCD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HCD);
-                            DetectEngineRunHttpCookieMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HCD);
-                        }
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HUAD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HUAD);
-                            DetectEngineRunHttpUAMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HUAD);
-                        }
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HHD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HHD);
-                            DetectEngineRunHttpHeaderMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HHD);
-                        }
-                    }
-
-                    if (tx_progress > HTP_REQUEST_HEADERS) {
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HRHD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HRHD);
-                            DetectEngineRunHttpRawHeaderMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HRHD);
-                        }
-                    }
-
-                    if (tx_progress >= HTP_REQUEST_BODY) {
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HCBD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HCBD);
-                            DetectEngineRunHttpClientBodyMpm(de_ctx, det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HCBD);
-                        }
-                    }
-                } else { /* implied FLOW_PKT_TOCLIENT */
-                    tx_progress = AppLayerParserGetStateProgress(IPPROTO_TCP, ALPROTO_HTTP, tx, flags);
-
-                    if (tx_progress > HTP_RESPONSE_LINE) {
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HSMD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HSMD);
-                            DetectEngineRunHttpStatMsgMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HSMD);
-                        }
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HSCD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HSCD);
-                            DetectEngineRunHttpStatCodeMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HSCD);
-                        }
-                    }
-
-                    if (tx_progress >= HTP_RESPONSE_HEADERS) {
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HHD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HHD);
-                            DetectEngineRunHttpHeaderMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HHD);
-                        }
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HCD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HCD);
-                            DetectEngineRunHttpCookieMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HCD);
-                        }
-                    }
-
-                    if (tx_progress > HTP_RESPONSE_HEADERS) {
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HRHD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HRHD);
-                            DetectEngineRunHttpRawHeaderMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HRHD);
-                        }
-                    }
-
-                    if (tx_progress >= HTP_RESPONSE_BODY) {
-                        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_HSBD) {
-                            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_HSBD);
-                            DetectEngineRunHttpServerBodyMpm(de_ctx, det_ctx, p->flow, alstate, flags, tx, idx);
-                            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_HSBD);
-                        }
-                    }
-                }
-            } /* for */
-        }
-        /* all dns based mpms */
-        else if (alproto == ALPROTO_DNS && has_state) {
-            if (p->flowflags & FLOW_PKT_TOSERVER) {
-                if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_DNSQUERY) {
-                    void *alstate = FlowGetAppState(p->flow);
-                    if (alstate == NULL) {
-                        SCLogDebug("no alstate");
-                        return;
-                    }
-
-                    uint64_t idx = AppLayerParserGetTransactionInspectId(p->flow->alparser, flags);
-                    uint64_t total_txs = AppLayerParserGetTxCnt(p->flow->proto, alproto, alstate);
-                    for (; idx < total_txs; idx++) {
-                        void *tx = AppLayerParserGetTx(p->flow->proto, alproto, alstate, idx);
-                        if (tx == NULL)
-                            continue;
-
-                        PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_DNSQUERY);
-                        DetectDnsQueryInspectMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                        PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_DNSQUERY);
-                    }
-                }
-            }
-        } else if (alproto == ALPROTO_TLS && has_state) {
-            void *alstate = FlowGetAppState(p->flow);
-            if (alstate == NULL) {
-                SCLogDebug("no alstate");
-                return;
-            }
-
-            if (p->flowflags & FLOW_PKT_TOSERVER) {
-                if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_TLSSNI) {
-                    PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_TLSSNI);
-                    DetectTlsSniInspectMpm(det_ctx, p->flow, alstate, flags);
-                    PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_TLSSNI);
-                }
-            } else if (p->flowflags & FLOW_PKT_TOCLIENT) {
-                if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_TLSISSUER) {
-                    PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_TLSISSUER);
-                    DetectTlsIssuerInspectMpm(det_ctx, p->flow, alstate, flags);
-                    PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_TLSISSUER);
-                }
-                if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_TLSSUBJECT) {
-                    PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_TLSSUBJECT);
-                    DetectTlsSubjectInspectMpm(det_ctx, p->flow, alstate, flags);
-                    PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_TLSSUBJECT);
-                }
-            }
-        } else if (alproto == ALPROTO_SMTP && has_state) {
-            if (p->flowflags & FLOW_PKT_TOSERVER) {
-                if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_FD_SMTP) {
-                    void *alstate = FlowGetAppState(p->flow);
-                    if (alstate == NULL) {
-                        SCLogDebug("no alstate");
-                        return;
-                    }
-
-                    SMTPState *smtp_state = (SMTPState *)alstate;
-                    uint64_t idx = AppLayerParserGetTransactionInspectId(p->flow->alparser, flags);
-                    uint64_t total_txs = AppLayerParserGetTxCnt(p->flow->proto, alproto, alstate);
-                    for (; idx < total_txs; idx++) {
-                        void *tx = AppLayerParserGetTx(p->flow->proto, alproto, alstate, idx);
-                        if (tx == NULL)
-                            continue;
-
-                        PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_FD_SMTP);
-                        DetectEngineRunSMTPMpm(de_ctx, det_ctx, p->flow, smtp_state, flags, tx, idx);
-                        PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_FD_SMTP);
-                    }
-                }
-            }
-        }
+    uint64_t *bitmap = det_ctx->prefilter_bitmap;
+    Signature **sig_array = de_ctx->sig_array;
+    Signature **match_array = det_ctx->match_array;
+    uint32_t lo = UINT32_MAX, hi = 0;
 
-        if (smsg != NULL && (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_STREAM)) {
-            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_STREAM);
-            StreamPatternSearch(det_ctx, p, smsg, flags);
-            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_STREAM);
-        } else {
-            SCLogDebug("smsg NULL or no stream mpm for this sgh");
-        }
-    } else {
-        SCLogDebug("NOT p->flowflags & FLOW_PKT_ESTABLISHED");
-    }
+    SCLogDebug("PMQ rule id array count %d", det_ctx->pmq.rule_id_array_cnt);
 
-    if (p->payload_len > 0 && (!(p->flags & PKT_NOPAYLOAD_INSPECTION))) {
-        if (!(p->flags & PKT_STREAM_ADD) && (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_STREAM)) {
-            *sms_runflags |= SMS_USED_PM;
-            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_PKT_STREAM);
-            PacketPatternSearchWithStreamCtx(det_ctx, p);
-            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_PKT_STREAM);
-        }
-        if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_PACKET) {
-            /* run the multi packet matcher against the payload of the packet */
-            SCLogDebug("search: (%p, sgh->sig_cnt %" PRIu32 ")",
-                    det_ctx->sgh, det_ctx->sgh->sig_cnt);
+    DetectPrefilterBitmapSet(bitmap, det_ctx->pmq.rule_id_array,
+            det_ctx->pmq.rule_id_array_cnt, &lo, &hi, 0);
+    DetectPrefilterBitmapSet(bitmap, det_ctx->non_mpm_id_array,
+            det_ctx->non_mpm_id_cnt, &lo, &hi, 1);
 
-            PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_PACKET);
-            PacketPatternSearch(det_ctx, p);
-            PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_PACKET);
+    uint32_t w;
+    for (w = lo; w <= hi && lo != UINT32_MAX; w++) {
+        uint64_t word = bitmap[w];
+        if (word == 0)
+            continue;
+        bitmap[w] = 0;
 
-            *sms_runflags |= SMS_USED_PM;
-        } else {
-            SCLogDebug("not packet");
-        }
-    } else {
-        SCLogDebug("how did we get here?");
+        Signature **base = sig_array + (w * 64);
+        do {
+            *match_array++ = base[__builtin_ctzll(word)];
+            /* clear lowest set bit */
+            word &= word - 1;
+        } while (word != 0);
     }
 
-    /* UDP DNS inspection is independent of est or not */
-    if (alproto == ALPROTO_DNS && has_state) {
-        if (p->flowflags & FLOW_PKT_TOSERVER) {
-            SCLogDebug("mpm inspection");
-            if (det_ctx->sgh->flags & SIG_GROUP_HEAD_MPM_DNSQUERY) {
-                void *alstate = FlowGetAppState(p->flow);
-                if (alstate == NULL) {
-                    SCLogDebug("no alstate");
-                    return;
-                }
-
-                uint64_t idx = AppLayerParserGetTransactionInspectId(p->flow->alparser, flags);
-                uint64_t total_txs = AppLayerParserGetTxCnt(p->flow->proto, alproto, alstate);
-                for (; idx < total_txs; idx++) {
-                    void *tx = AppLayerParserGetTx(p->flow->proto, alproto, alstate, idx);
-                    if (tx == NULL)
-                        continue;
-                    SCLogDebug("tx %p",tx);
-                    PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM_DNSQUERY);
-                    DetectDnsQueryInspectMpm(det_ctx, p->flow, alstate, flags, tx, idx);
-                    PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM_DNSQUERY);
-                }
-            }
-        }
-    }
+    det_ctx->match_array_cnt = match_array - det_ctx->match_array;
 
-    /* Sort the rule list to lets look at pmq.
-     * NOTE due to merging of 'stream' pmqs we *MAY* have duplicate entries */
-    if (det_ctx->pmq.rule_id_array_cnt > 1) {
-        QuickSortSigIntId(det_ctx->pmq.rule_id_array, det_ctx->pmq.rule_id_array_cnt);
-    }
+    BUG_ON((det_ctx->pmq.rule_id_array_cnt + det_ctx->non_mpm_id_cnt) < det_ctx->match_array_cnt);
 }
 
+#define SMS_USE_FLOW_SGH        0x01
+
 #ifdef DEBUG
 static void DebugInspectIds(Packet *p, Flow *f, StreamMsg *smsg)
 {
@@ -1269,9 +1077,7 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
     uint8_t sms_runflags = 0;   /* function flags */
     uint8_t alert_flags = 0;
     AppProto alproto = ALPROTO_UNKNOWN;
-#ifdef PROFILING
     int smatch = 0; /* signature match: 1, no match: 0 */
-#endif
     uint8_t flow_flags = 0; /* flow/state flags */
     StreamMsg *smsg = NULL;
     Signature *s = NULL;
@@ -1290,12 +1096,17 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
     det_ctx->filestore_cnt = 0;
 
     det_ctx->base64_decoded_len = 0;
+#ifdef BUILD_HYPERSCAN
+    DetectPcreHSThreadReset(det_ctx);
+#endif
 
     /* No need to perform any detection on this packet, if the the given flag is set.*/
     if (p->flags & PKT_NOPACKET_INSPECTION) {
         SCReturnInt(0);
     }
 
+    RULE_PROFILING_SAMPLE(p);
+
     /* Load the Packet's flow early, even though it might not be needed.
      * Mark as a constant pointer, although the flow can change.
      */
@@ -1406,7 +1217,7 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
             SCLogDebug("testing against \"ip-only\" signatures");
 
             PACKET_PROFILING_DETECT_START(p, PROF_DETECT_IPONLY);
-            IPOnlyMatchPacket(th_v, de_ctx, det_ctx, &de_ctx->io_ctx, &det_ctx->io_ctx, p);
+            IPOnlyMatchPacket(th_v, de_ctx, det_ctx, &de_ctx->io_ctx, p);
             PACKET_PROFILING_DETECT_END(p, PROF_DETECT_IPONLY);
 
             /* save in the flow that we scanned this direction... */
@@ -1443,8 +1254,7 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
 
         /* Even without flow we should match the packet src/dst */
         PACKET_PROFILING_DETECT_START(p, PROF_DETECT_IPONLY);
-        IPOnlyMatchPacket(th_v, de_ctx, det_ctx, &de_ctx->io_ctx,
-                          &det_ctx->io_ctx, p);
+        IPOnlyMatchPacket(th_v, de_ctx, det_ctx, &de_ctx->io_ctx, p);
         PACKET_PROFILING_DETECT_END(p, PROF_DETECT_IPONLY);
 
         PACKET_PROFILING_DETECT_START(p, PROF_DETECT_GETSGH);
@@ -1489,9 +1299,11 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
     }
     PACKET_PROFILING_DETECT_END(p, PROF_DETECT_NONMPMLIST);
 
-    /* run the mpm for each type */
+    /* run the prefilter engines */
     PACKET_PROFILING_DETECT_START(p, PROF_DETECT_MPM);
-    DetectMpmPrefilter(de_ctx, det_ctx, smsg, p, flow_flags, alproto, has_state, &sms_runflags);
+    det_ctx->smsg = smsg;
+    Prefilter(det_ctx, det_ctx->sgh, p, flow_flags, alproto, has_state);
+    det_ctx->smsg = NULL;
     PACKET_PROFILING_DETECT_END(p, PROF_DETECT_MPM);
 #ifdef PROFILING
     if (th_v) {
@@ -1506,7 +1318,11 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
 #endif
 
     PACKET_PROFILING_DETECT_START(p, PROF_DETECT_PREFILTER);
-    DetectPrefilterMergeSort(de_ctx, det_ctx);
+    if (det_ctx->sgh->flags & SIG_GROUP_HEAD_PREFILTER_BITMAP) {
+        DetectPrefilterMergeBitmap(de_ctx, det_ctx);
+    } else {
+        DetectPrefilterMergeSort(de_ctx, det_ctx);
+    }
     PACKET_PROFILING_DETECT_END(p, PROF_DETECT_PREFILTER);
 
     PACKET_PROFILING_DETECT_START(p, PROF_DETECT_RULES);
@@ -1539,9 +1355,7 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
     while (match_cnt--) {
         RULE_PROFILING_START(p);
         state_alert = 0;
-#ifdef PROFILING
         smatch = 0;
-#endif
 
         s = next_s;
         sflags = next_sflags;
@@ -1766,9 +1580,7 @@ int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx, DetectEngineTh
             alert_flags |= PACKET_ALERT_FLAG_STATE_MATCH;
         }
 
-#ifdef PROFILING
         smatch = 1;
-#endif
 
         SigMatchSignaturesRunPostMatch(th_v, de_ctx, det_ctx, p, s);
 
@@ -3669,6 +3481,8 @@ int SigAddressPrepareStage1(DetectEngineCtx *de_ctx)
             tmp_s->flags |= SIG_FLAG_MPM_NEG;
         }
 
+        PrefilterSetupSignature(de_ctx, tmp_s);
+
         SignatureCreateMask(tmp_s);
         SigParseApplyDsizeToContent(tmp_s);
 
@@ -3904,6 +3718,20 @@ int SigAddressPrepareStage2(DetectEngineCtx *de_ctx)
     de_ctx->flow_gh[1].udp = RulesGroupByPorts(de_ctx, IPPROTO_UDP, SIG_FLAG_TOSERVER);
     de_ctx->flow_gh[0].udp = RulesGroupByPorts(de_ctx, IPPROTO_UDP, SIG_FLAG_TOCLIENT);
 
+    /* flat sorted versions of the port group lists for the per packet
+     * sgh lookup */
+    int f;
+    for (f = 0; f < FLOW_STATES; f++) {
+        if (DetectPortLookupArraySetup(&de_ctx->flow_gh[f].tcp_lookup,
+                    de_ctx->flow_gh[f].tcp) < 0 ||
+            DetectPortLookupArraySetup(&de_ctx->flow_gh[f].udp_lookup,
+                    de_ctx->flow_gh[f].udp) < 0)
+        {
+            SCLogError(SC_ERR_MEM_ALLOC, "failed to set up port group lookup");
+            return -1;
+        }
+    }
+
     /* Setup the other IP Protocols (so not TCP/UDP) */
     RulesGroupByProto(de_ctx);
 
@@ -3963,6 +3791,8 @@ int SigAddressCleanupStage1(DetectEngineCtx *de_ctx)
         }
 
         /* free lookup lists */
+        DetectPortLookupArrayFree(&de_ctx->flow_gh[f].tcp_lookup);
+        DetectPortLookupArrayFree(&de_ctx->flow_gh[f].udp_lookup);
         DetectPortCleanupList(de_ctx->flow_gh[f].tcp);
         de_ctx->flow_gh[f].tcp = NULL;
         DetectPortCleanupList(de_ctx->flow_gh[f].udp);
@@ -4053,6 +3883,9 @@ int SigAddressPrepareStage4(DetectEngineCtx *de_ctx)
 
     uint32_t cnt = 0;
     uint32_t idx = 0;
+#ifdef BUILD_HYPERSCAN
+    DetectPcreHSPrepare(de_ctx);
+#endif
     for (idx = 0; idx < de_ctx->sgh_array_cnt; idx++) {
         SigGroupHead *sgh = de_ctx->sgh_array[idx];
         if (sgh == NULL)
@@ -4066,12 +3899,18 @@ int SigAddressPrepareStage4(DetectEngineCtx *de_ctx)
         SigGroupHeadSetFilestoreCount(de_ctx, sgh);
         SCLogDebug("filestore count %u", sgh->filestore_cnt);
 
-        BUG_ON(PatternMatchPrepareGroup(de_ctx, sgh) != 0);
+        BUG_ON(PrefilterSetupRuleGroup(de_ctx, sgh) != 0);
+#ifdef BUILD_HYPERSCAN
+        BUG_ON(DetectPcreHSSetupRuleGroup(de_ctx, sgh) != 0);
+#endif
         SigGroupHeadBuildNonMpmArray(de_ctx, sgh);
 
         sgh->id = idx;
         cnt++;
     }
+#ifdef BUILD_HYPERSCAN
+    DetectPcreHSFinalize(de_ctx);
+#endif
     SCLogPerf("Unique rule groups: %u", cnt);
 
     MpmStoreReportStats(de_ctx);
@@ -4226,17 +4065,17 @@ int SigGroupBuild(DetectEngineCtx *de_ctx)
     }
 #endif
 
-    DetectMpmPrepareBuiltinMpms(de_ctx);
-    DetectMpmPrepareAppMpms(de_ctx);
+    if (DetectMpmPrepareContexts(de_ctx) != 0) {
+        SCLogError(SC_ERR_DETECT_PREPARE, "initializing the detection engine failed");
+        exit(EXIT_FAILURE);
+    }
 
     if (SigMatchPrepare(de_ctx) != 0) {
         SCLogError(SC_ERR_DETECT_PREPARE, "initializing the detection engine failed");
         exit(EXIT_FAILURE);
     }
 
-#ifdef PROFILING
     SCProfilingRuleInitCounters(de_ctx);
-#endif
     return 0;
 }
 
@@ -9974,6 +9813,130 @@ end:
     return result;
 }
 
+/** \test merge the prefilter candidates through the bitmap */
+static int SigTestPrefilterBitmap01(void)
+{
+    ThreadVars tv;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    uint8_t payload[] = "xx abc7 abc70 yy";
+    char sig[128];
+    int i;
+
+    memset(&tv, 0, sizeof(ThreadVars));
+
+    Packet *p = UTHBuildPacket(payload, sizeof(payload) - 1, IPPROTO_TCP);
+    FAIL_IF_NULL(p);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->prefilter_bitmap_threshold = 1;
+
+    for (i = 1; i <= 130; i++) {
+        snprintf(sig, sizeof(sig), "alert tcp any any -> any any "
+                "(content:\"abc%d\"; sid:%d;)", i, i);
+        FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, sig));
+    }
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+                "(dsize:>0; sid:1001;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+                "(dsize:0; sid:1002;)"));
+
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&tv, (void *)de_ctx, (void *)&det_ctx);
+
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+
+    FAIL_IF_NULL(det_ctx->sgh);
+    FAIL_IF_NOT(det_ctx->sgh->flags & SIG_GROUP_HEAD_PREFILTER_BITMAP);
+
+    FAIL_IF_NOT(PacketAlertCheck(p, 7));
+    FAIL_IF_NOT(PacketAlertCheck(p, 70));
+    FAIL_IF_NOT(PacketAlertCheck(p, 1001));
+    FAIL_IF(PacketAlertCheck(p, 1));
+    FAIL_IF(PacketAlertCheck(p, 71));
+    FAIL_IF(PacketAlertCheck(p, 1002));
+    FAIL_IF_NOT(p->alerts.cnt == 3);
+
+    /* bitmap is cleared by the merge */
+    uint32_t w;
+    for (w = 0; w < det_ctx->prefilter_bitmap_words; w++) {
+        FAIL_IF(det_ctx->prefilter_bitmap[w] != 0);
+    }
+
+    DetectEngineThreadCtxDeinit(&tv, det_ctx);
+    SigGroupCleanup(de_ctx);
+    DetectEngineCtxFree(de_ctx);
+    UTHFreePackets(&p, 1);
+    PASS;
+}
+
+/** \internal
+ *  \brief negated mpm patterns with the candidates merged through the
+ *         bitmap or the sort, depending on the bitmap threshold */
+static int SigTestPrefilterNegated(const uint32_t bitmap_threshold)
+{
+    ThreadVars tv;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    uint8_t payload[] = "xx abc7 yy";
+
+    memset(&tv, 0, sizeof(ThreadVars));
+
+    Packet *p = UTHBuildPacket(payload, sizeof(payload) - 1, IPPROTO_TCP);
+    FAIL_IF_NULL(p);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->prefilter_bitmap_threshold = bitmap_threshold;
+
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+                "(content:\"abc7\"; sid:1;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+                "(content:!\"abc7\"; fast_pattern; sid:2;)"));
+    FAIL_IF_NULL(DetectEngineAppendSig(de_ctx, "alert tcp any any -> any any "
+                "(content:!\"zzz9\"; fast_pattern; sid:3;)"));
+
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&tv, (void *)de_ctx, (void *)&det_ctx);
+
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+
+    FAIL_IF_NULL(det_ctx->sgh);
+    if (bitmap_threshold > 0) {
+        FAIL_IF_NOT(det_ctx->sgh->flags & SIG_GROUP_HEAD_PREFILTER_BITMAP);
+    } else {
+        FAIL_IF(det_ctx->sgh->flags & SIG_GROUP_HEAD_PREFILTER_BITMAP);
+    }
+
+    FAIL_IF_NOT(PacketAlertCheck(p, 1));
+    FAIL_IF(PacketAlertCheck(p, 2));
+    FAIL_IF_NOT(PacketAlertCheck(p, 3));
+    /* sig 2 was dropped before inspection */
+    FAIL_IF(det_ctx->match_array_cnt != 2);
+
+    if (det_ctx->prefilter_bitmap != NULL) {
+        uint32_t w;
+        for (w = 0; w < det_ctx->prefilter_bitmap_words; w++) {
+            FAIL_IF(det_ctx->prefilter_bitmap[w] != 0);
+        }
+    }
+
+    DetectEngineThreadCtxDeinit(&tv, det_ctx);
+    SigGroupCleanup(de_ctx);
+    DetectEngineCtxFree(de_ctx);
+    UTHFreePackets(&p, 1);
+    PASS;
+}
+
+/** \test a matching negated fast_pattern drops the sig on both merges */
+static int SigTestPrefilterBitmap02(void)
+{
+    FAIL_IF_NOT(SigTestPrefilterNegated(1));
+    FAIL_IF_NOT(SigTestPrefilterNegated(0));
+    PASS;
+}
+
 static const char *dummy_conf_string2 =
     "%YAML 1.1\n"
     "---\n"
@@ -10278,6 +10241,8 @@ void SigRegisterTests(void)
 
     UtRegisterTest("SigTestPorts01", SigTestPorts01);
     UtRegisterTest("SigTestBug01", SigTestBug01);
+    UtRegisterTest("SigTestPrefilterBitmap01", SigTestPrefilterBitmap01);
+    UtRegisterTest("SigTestPrefilterBitmap02", SigTestPrefilterBitmap02);
 
 #if 0
     DetectSimdRegisterTests();
@@ -274,6 +274,9 @@ typedef struct DetectPort_ {
 #define SIG_FLAG_TLSSTORE               (1<<21)
 
 #define SIG_FLAG_BYPASS                (1<<22)
+
+#define SIG_FLAG_PREFILTER              (1<<23) /**< sig is part of a prefilter engine */
+
 /* signature init flags */
 #define SIG_FLAG_INIT_DEONLY         1  /**< decode event only signature */
 #define SIG_FLAG_INIT_PACKET         (1<<1)  /**< signature has matches against a packet (as opposed to app layer) */
@@ -399,9 +402,7 @@ typedef struct Signature_ {
     /** port settings for this signature */
     DetectPort *sp, *dp;
 
-#ifdef PROFILING
     uint16_t profiling_id;
-#endif
     /** number of sigmatches in the match and pmatch list */
     uint16_t sm_cnt;
 
@@ -436,6 +437,8 @@ typedef struct Signature_ {
     SigMatch *dsize_sm;
     /* the fast pattern added from this signature */
     SigMatch *mpm_sm;
+    /* used to speed up init of prefilter */
+    SigMatch *prefilter_sm;
 
     /* SigMatch list used for adding content and friends. E.g. file_data; */
     int list;
@@ -475,11 +478,6 @@ typedef struct DetectFlowvarList_ {
     struct DetectFlowvarList_ *next;
 } DetectFlowvarList;
 
-typedef struct DetectEngineIPOnlyThreadCtx_ {
-    uint8_t *sig_match_array; /* bit array of sig nums */
-    uint32_t sig_match_size;  /* size in bytes of the array */
-} DetectEngineIPOnlyThreadCtx;
-
 /** \brief IP only rules matching ctx. */
 typedef struct DetectEngineIPOnlyCtx_ {
     /* lookup hashes */
@@ -509,9 +507,21 @@ typedef struct DetectEngineIPOnlyCtx_ {
     uint32_t *match_array;
 } DetectEngineIPOnlyCtx;
 
+/** \brief flat version of a list of port groups, sorted by port, for
+ *         lookups using a binary search. */
+typedef struct DetectPortLookupArray_ {
+    uint16_t *port2;        /**< end of the range of each group, sorted */
+    DetectPort **groups;    /**< the port groups */
+    uint32_t cnt;           /**< groups in the array, 0 to walk the list */
+    DetectPort *catchall;   /**< 0:65535 group used if none matched */
+    DetectPort *list;       /**< the port group list */
+} DetectPortLookupArray;
+
 typedef struct DetectEngineLookupFlow_ {
     DetectPort *tcp;
     DetectPort *udp;
+    DetectPortLookupArray tcp_lookup;
+    DetectPortLookupArray udp_lookup;
     struct SigGroupHead_ *sgh[256];
 } DetectEngineLookupFlow;
 
@@ -568,6 +578,8 @@ typedef struct DetectEngineCtx_ {
 
     /* used by the signature ordering module */
     struct SCSigOrderFunc_ *sc_sig_order_funcs;
+    /** order rules that are equal otherwise by their inspection cost */
+    int sig_order_cost;
 
     /* hash table used for holding the classification config info */
     HashTable *class_conf_ht;
@@ -616,6 +628,26 @@ typedef struct DetectEngineCtx_ {
     /* maximum recursion depth for content inspection */
     int inspection_recursion_limit;
 
+    /** which prefilter engines to use: DETECT_PREFILTER_MPM or
+     *  DETECT_PREFILTER_AUTO */
+    int prefilter_setting;
+    /** min number of rules in a group to use the candidate bitmap,
+     *  0 to disable */
+    uint32_t prefilter_bitmap_threshold;
+
+    /** number of threads preparing the mpm contexts at the end of the
+     *  build, see detect.mpm-build-threads */
+    int mpm_build_threads;
+
+    /** carry the mpm state over the stream chunks and body fragments
+     *  of a flow, see detect.mpm-streaming */
+    int mpm_streaming;
+
+    /** prefilter the pcres with Hyperscan, see hyperscan.pcre-prefilter */
+    int pcre_hs_prefilter;
+    /** pcre prefilter state, NULL if disabled or nothing to prefilter */
+    struct DetectPcreHSCtx_ *pcre_hs;
+
     /* conf parameter that limits the length of the http request body inspected */
     int hcbd_buffer_limit;
     /* conf parameter that limits the length of the http response body inspected */
@@ -655,8 +687,8 @@ typedef struct DetectEngineCtx_ {
 
     int detect_luajit_instances;
 
-#ifdef PROFILING
     struct SCProfileDetectCtx_ *profile_ctx;
+#ifdef PROFILING
     struct SCProfileKeywordDetectCtx_ *profile_keyword_ctx;
     struct SCProfileKeywordDetectCtx_ *profile_keyword_ctx_per_list[DETECT_SM_LIST_MAX];
     struct SCProfileSghDetectCtx_ *profile_sgh_ctx;
@@ -697,6 +729,17 @@ enum {
     ENGINE_PROFILE_MAX
 };
 
+/* prefilter setting, see detect.prefilter.default */
+enum DetectEnginePrefilterSetting
+{
+    DETECT_PREFILTER_MPM = 0,   /**< use only mpm / fast_pattern */
+    DETECT_PREFILTER_AUTO = 1,  /**< use mpm + keyword prefilters */
+};
+
+/** default min number of rules in a group to merge the prefilter
+ *  candidates through a bitmap */
+#define DETECT_PREFILTER_BITMAP_THRESHOLD_DEFAULT   1024
+
 /* Siggroup mpm context profile */
 enum {
     ENGINE_SGH_MPM_FACTORY_CONTEXT_FULL,
@@ -786,6 +829,12 @@ typedef struct DetectEngineThreadCtx_ {
 
     /** id for alert counter */
     uint16_t counter_alerts;
+#ifdef BUILD_HYPERSCAN
+    /** ids of the pcre prefilter counters, see detect-pcre-hs.c */
+    uint16_t counter_pcre_hs_scans;
+    uint16_t counter_pcre_hs_skipped;
+    uint16_t counter_pcre_hs_passed;
+#endif
 #ifdef PROFILING
     uint16_t counter_mpm_list;
     uint16_t counter_nonmpm_list;
@@ -816,6 +865,11 @@ typedef struct DetectEngineThreadCtx_ {
     /** size in use */
     SigIntId match_array_cnt;
 
+    /** candidate bitmap indexed by internal sig id, used to merge the
+     *  prefilter results of large groups. All zero between packets. */
+    uint64_t *prefilter_bitmap;
+    uint32_t prefilter_bitmap_words;
+
     /** Array of sigs that had a state change */
     SigIntId de_state_sig_array_len;
     uint8_t *de_state_sig_array;
@@ -833,13 +887,13 @@ typedef struct DetectEngineThreadCtx_ {
     MpmThreadCtx mtcs;  /**< thread ctx for stream mpm */
     PatternMatcherQueue pmq;
 
+    /** reassembled stream chunks for the stream prefilter engine */
+    struct StreamMsg_ *smsg;
+
     /** SPM thread context used for scanning. This has been cloned from the
      * prototype held by DetectEngineCtx. */
     SpmThreadCtx *spm_thread_ctx;
 
-    /** ip only rules ctx */
-    DetectEngineIPOnlyThreadCtx io_ctx;
-
     /* byte jump values */
     uint64_t *bj_values;
 
@@ -866,9 +920,10 @@ typedef struct DetectEngineThreadCtx_ {
     int base64_decoded_len;
     int base64_decoded_len_max;
 
-#ifdef PROFILING
     struct SCProfileData_ *rule_perf_data;
     int rule_perf_data_size;
+    struct SCProfileRuleThreadData_ *rule_perf_thread_data;
+#ifdef PROFILING
     struct SCProfileKeywordData_ *keyword_perf_data;
     struct SCProfileKeywordData_ *keyword_perf_data_per_list[DETECT_SM_LIST_MAX];
     int keyword_perf_list; /**< list we're currently inspecting, DETECT_SM_LIST_* */
@@ -900,6 +955,12 @@ typedef struct SigTableElmt_ {
     /** keyword setup function pointer */
     int (*Setup)(DetectEngineCtx *, Signature *, char *);
 
+    /** keyword specific prefilter support: returns true if the keyword
+     *  in this sig can be used as the sig's prefilter */
+    _Bool (*SupportsPrefilter)(const Signature *s);
+    /** set up the prefilter engine(s) for this keyword in a rule group */
+    int (*SetupPrefilter)(struct SigGroupHead_ *sgh);
+
     void (*Free)(void *);
     void (*RegisterTests)(void);
 
@@ -915,20 +976,6 @@ typedef struct SigTableElmt_ {
 
 } SigTableElmt;
 
-#define SIG_GROUP_HEAD_MPM_URI          (1)
-#define SIG_GROUP_HEAD_MPM_HCBD         (1 << 1)
-#define SIG_GROUP_HEAD_MPM_HHD          (1 << 2)
-#define SIG_GROUP_HEAD_MPM_HRHD         (1 << 3)
-#define SIG_GROUP_HEAD_MPM_HMD          (1 << 4)
-#define SIG_GROUP_HEAD_MPM_HCD          (1 << 5)
-#define SIG_GROUP_HEAD_MPM_HRUD         (1 << 6)
-#define SIG_GROUP_HEAD_MPM_HSBD         (1 << 7)
-#define SIG_GROUP_HEAD_MPM_HSMD         (1 << 8)
-#define SIG_GROUP_HEAD_MPM_HSCD         (1 << 9)
-#define SIG_GROUP_HEAD_MPM_HUAD         (1 << 10)
-#define SIG_GROUP_HEAD_MPM_HHHD         (1 << 11)
-#define SIG_GROUP_HEAD_MPM_HRHHD        (1 << 12)
-
 #define SIG_GROUP_HEAD_MPM_COPY         (1 << 13)
 #define SIG_GROUP_HEAD_MPM_URI_COPY     (1 << 14)
 #define SIG_GROUP_HEAD_MPM_STREAM_COPY  (1 << 15)
@@ -941,12 +988,9 @@ typedef struct SigTableElmt_ {
 #define SIG_GROUP_HEAD_HAVEFILESIZE     (1 << 22)
 #define SIG_GROUP_HEAD_HAVEFILESHA1     (1 << 23)
 #define SIG_GROUP_HEAD_HAVEFILESHA256   (1 << 24)
-
-#define SIG_GROUP_HEAD_MPM_DNSQUERY     (1 << 25)
-#define SIG_GROUP_HEAD_MPM_TLSSNI       (1 << 26)
-#define SIG_GROUP_HEAD_MPM_TLSISSUER    (1 << 27)
-#define SIG_GROUP_HEAD_MPM_TLSSUBJECT   (1 << 28)
-#define SIG_GROUP_HEAD_MPM_FD_SMTP      (1 << 29)
+/** merge the prefilter candidates through the thread's bitmap instead
+ *  of sorting them. Set for large groups, see PrefilterSetupRuleGroup() */
+#define SIG_GROUP_HEAD_PREFILTER_BITMAP (1 << 25)
 
 #define APP_MPMS_MAX 21
 
@@ -974,6 +1018,69 @@ typedef struct MpmStore_ {
 
 } MpmStore;
 
+/** \brief prefilter engine as used during rule group setup */
+typedef struct PrefilterEngineList_ {
+    uint16_t id;
+
+    /** App Proto this engine applies to: only used with Tx Engines */
+    AppProto alproto;
+    /** Direction (STREAM_TOSERVER or STREAM_TOCLIENT) this engine
+     *  applies to: only used with Tx Engines */
+    uint8_t direction;
+    /** Minimal Tx progress we need before running the engine. Only used
+     *  with Tx Engines */
+    int tx_min_progress;
+
+    /** Context for matching. Might be MpmCtx for MPM engines, other ctx'
+     *  for other engines. */
+    void *pectx;
+
+    void (*Prefilter)(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx);
+    void (*PrefilterTx)(DetectEngineThreadCtx *det_ctx, const void *pectx,
+            Packet *p, Flow *f, void *tx,
+            const uint64_t idx, const uint8_t flags);
+
+    struct PrefilterEngineList_ *next;
+
+    /** Free function for pectx data. If NULL the memory is not freed. */
+    void (*Free)(void *pectx);
+
+    const char *name;
+} PrefilterEngineList;
+
+/** \brief prefilter engine as used at runtime, stored in an array per
+ *         rule group. The last engine in the array has is_last set. */
+typedef struct PrefilterEngine_ {
+    uint16_t id;
+
+    /** App Proto this engine applies to: only used with Tx Engines */
+    AppProto alproto;
+    /** Direction (STREAM_TOSERVER or STREAM_TOCLIENT): only used with
+     *  Tx Engines */
+    uint8_t direction;
+    /** Minimal Tx progress we need before running the engine. Only used
+     *  with Tx Engines */
+    int tx_min_progress;
+
+    /** Context for matching. Might be MpmCtx for MPM engines, other ctx'
+     *  for other engines. */
+    void *pectx;
+
+    union {
+        void (*Prefilter)(DetectEngineThreadCtx *det_ctx, Packet *p, const void *pectx);
+        void (*PrefilterTx)(DetectEngineThreadCtx *det_ctx, const void *pectx,
+                Packet *p, Flow *f, void *tx,
+                const uint64_t idx, const uint8_t flags);
+    } cb;
+
+    /** Free function for pectx data. If NULL the memory is not freed. */
+    void (*Free)(void *pectx);
+
+    const char *name;
+
+    _Bool is_last;
+} PrefilterEngine;
+
 typedef struct SigGroupHeadInitData_ {
     MpmStore mpm_store[MPMB_MAX];
 
@@ -984,7 +1091,11 @@ typedef struct SigGroupHeadInitData_ {
     uint32_t direction;     /**< set to SIG_FLAG_TOSERVER, SIG_FLAG_TOCLIENT or both */
     int whitelist;          /**< try to make this group a unique one */
 
-    MpmCtx *app_mpms[APP_MPMS_MAX];
+    /** prefilter engines, converted to arrays in the SigGroupHead by
+     *  PrefilterSetupRuleGroup() */
+    PrefilterEngineList *pkt_engines;
+    PrefilterEngineList *payload_engines;
+    PrefilterEngineList *tx_engines;
 
     /* port ptr */
     struct DetectPort_ *port;
@@ -1013,33 +1124,13 @@ typedef struct SigGroupHead_ {
     const MpmCtx *mpm_packet_ctx;
     const MpmCtx *mpm_stream_ctx;
 
-    union {
-        struct {
-            const MpmCtx *mpm_uri_ctx_ts;
-            const MpmCtx *mpm_hcbd_ctx_ts;
-            const MpmCtx *mpm_hhd_ctx_ts;
-            const MpmCtx *mpm_hrhd_ctx_ts;
-            const MpmCtx *mpm_hmd_ctx_ts;
-            const MpmCtx *mpm_hcd_ctx_ts;
-            const MpmCtx *mpm_hrud_ctx_ts;
-            const MpmCtx *mpm_huad_ctx_ts;
-            const MpmCtx *mpm_hhhd_ctx_ts;
-            const MpmCtx *mpm_hrhhd_ctx_ts;
-            const MpmCtx *mpm_dnsquery_ctx_ts;
-            const MpmCtx *mpm_tlssni_ctx_ts;
-            const MpmCtx *mpm_tlsissuer_ctx_ts;
-            const MpmCtx *mpm_tlssubject_ctx_ts;
-            const MpmCtx *mpm_smtp_filedata_ctx_ts;
-        };
-        struct {
-            const MpmCtx *mpm_hsbd_ctx_tc;
-            const MpmCtx *mpm_hhd_ctx_tc;
-            const MpmCtx *mpm_hrhd_ctx_tc;
-            const MpmCtx *mpm_hcd_ctx_tc;
-            const MpmCtx *mpm_hsmd_ctx_tc;
-            const MpmCtx *mpm_hscd_ctx_tc;
-        };
-    };
+    /* prefilter engines, NULL if the group has none of a type */
+    PrefilterEngine *pkt_engines;
+    PrefilterEngine *payload_engines;
+    PrefilterEngine *tx_engines;
+
+    /** pcre prefilter groups by sm list, NULL if the group has none */
+    struct DetectPcreHSGroup_ **pcre_hs_groups;
 
     /** Array with sig ptrs... size is sig_cnt * sizeof(Signature *) */
     Signature **match_array;
@@ -1274,6 +1365,7 @@ void SigAddressPrepareBidirectionals (DetectEngineCtx *);
 
 char *DetectLoadCompleteSigPath(const DetectEngineCtx *, char *sig_file);
 int SigLoadSignatures (DetectEngineCtx *, char *, int);
+void DetectEngineBuildRegisterGlobalCounters(void);
 void SigTableList(const char *keyword);
 void SigTableSetup(void);
 int SigMatchSignatures(ThreadVars *th_v, DetectEngineCtx *de_ctx,
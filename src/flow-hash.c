@@ -36,6 +36,7 @@
 #include "flow-private.h"
 #include "flow-manager.h"
 #include "flow-storage.h"
+#include "flow-slab.h"
 #include "app-layer-parser.h"
 
 #include "util-time.h"
@@ -51,6 +52,7 @@
 
 SC_ATOMIC_EXTERN(unsigned int, flow_prune_idx);
 SC_ATOMIC_EXTERN(unsigned int, flow_flags);
+SC_ATOMIC_EXTERN(uint64_t, flow_epoch);
 
 static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv);
 
@@ -297,6 +299,48 @@ void FlowSetupPacket(Packet *p)
     p->flow_hash = FlowGetHash(p);
 }
 
+/**
+ *  \brief prefetch flow hash buckets and flows for a batch of packets
+ *
+ *  Meant to be called after the packets are decoded (so their flow hash
+ *  is known) but before they reach the flow worker. First the buckets of
+ *  all packets are prefetched, then the flows found in the bucket lookup
+ *  slots. Lookups in FlowGetFlowFromHash() then mostly hit the cache.
+ *
+ *  Nothing is done if the workers use private flow tables.
+ */
+void FlowHashPrefetchBatch(Packet **pkts, const uint32_t cnt)
+{
+    uint32_t i;
+
+    if (flow_hash == NULL || FlowPrivateTablesEnabled())
+        return;
+
+    for (i = 0; i < cnt; i++) {
+        const Packet *p = pkts[i];
+        if (p == NULL || !(p->flags & PKT_WANTS_FLOW))
+            continue;
+        prefetch(&flow_hash[p->flow_hash % flow_config.hash_size]);
+    }
+
+    for (i = 0; i < cnt; i++) {
+        const Packet *p = pkts[i];
+        if (p == NULL || !(p->flags & PKT_WANTS_FLOW))
+            continue;
+
+        const FlowBucket *fb = &flow_hash[p->flow_hash % flow_config.hash_size];
+        int s;
+        for (s = 0; s < FLOW_BUCKET_SLOTS; s++) {
+            if (fb->tag[s] == p->flow_hash) {
+                const Flow *f = fb->slot[s];
+                if (f != NULL)
+                    prefetch(f);
+                break;
+            }
+        }
+    }
+}
+
 int TcpSessionPacketSsnReuse(const Packet *p, const Flow *f, void *tcp_ssn);
 
 static inline int FlowCompare(Flow *f, const Packet *p)
@@ -342,8 +386,9 @@ static inline int FlowCreateCheck(const Packet *p)
 /**
  *  \brief Get a new flow
  *
- *  Get a new flow. We're checking memcap first and will try to make room
- *  if the memcap is reached.
+ *  Get a new flow from the slab of our NUMA node. Only if the slab can't
+ *  grow because of the memcap, we use a recycled flow from the global
+ *  spare queue. If that is empty too we will try to make room.
  *
  *  \param tv thread vars
  *  \param dtv decode thread vars (for flow log api thread data)
@@ -358,53 +403,42 @@ static Flow *FlowGetNew(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p)
         return NULL;
     }
 
-    /* get a flow from the spare queue */
-    f = FlowDequeue(&flow_spare_q);
+    /* get a flow from the local slab */
+    f = FlowAlloc();
     if (f == NULL) {
-        /* If we reached the max memcap, we get a used flow */
-        if (!(FLOW_CHECK_MEMCAP(sizeof(Flow) + FlowStorageSize()))) {
-            /* declare state of emergency */
-            if (!(SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY)) {
-                SC_ATOMIC_OR(flow_flags, FLOW_EMERGENCY);
-
-                FlowTimeoutsEmergency();
-
-                /* under high load, waking up the flow mgr each time leads
-                 * to high cpu usage. Flows are not timed out much faster if
-                 * we check a 1000 times a second. */
-                FlowWakeupFlowManagerThread();
-            }
+        /* slab is at the memcap, use a recycled flow */
+        f = FlowDequeue(&flow_spare_q);
+    }
+    if (f == NULL) {
+        /* declare state of emergency */
+        if (!(SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY)) {
+            SC_ATOMIC_OR(flow_flags, FLOW_EMERGENCY);
 
-            f = FlowGetUsedFlow(tv, dtv);
-            if (f == NULL) {
-                /* max memcap reached, so increments the counter */
-                if (tv != NULL && dtv != NULL) {
-                    StatsIncr(tv, dtv->counter_flow_memcap);
-                }
+            FlowTimeoutsEmergency();
 
-                /* very rare, but we can fail. Just giving up */
-                return NULL;
-            }
+            /* under high load, waking up the flow mgr each time leads
+             * to high cpu usage. Flows are not timed out much faster if
+             * we check a 1000 times a second. */
+            FlowWakeupFlowManagerThread();
+        }
 
-            /* freed a flow, but it's unlocked */
-        } else {
-            /* now see if we can alloc a new flow */
-            f = FlowAlloc();
-            if (f == NULL) {
-                if (tv != NULL && dtv != NULL) {
-                    StatsIncr(tv, dtv->counter_flow_memcap);
-                }
-                return NULL;
+        /* If we reached the max memcap, we get a used flow */
+        f = FlowGetUsedFlow(tv, dtv);
+        if (f == NULL) {
+            /* max memcap reached, so increments the counter */
+            if (tv != NULL && dtv != NULL) {
+                StatsIncr(tv, dtv->counter_flow_memcap);
             }
 
-            /* flow is initialized but *unlocked* */
+            /* very rare, but we can fail. Just giving up */
+            return NULL;
         }
-    } else {
-        /* flow has been recycled before it went into the spare queue */
 
-        /* flow is initialized (recylced) but *unlocked* */
+        /* freed a flow, but it's unlocked */
     }
 
+    /* flow is initialized (new or recycled) but *unlocked* */
+
     FLOWLOCK_WRLOCK(f);
     return f;
 }
@@ -415,6 +449,8 @@ static Flow *TcpReuseReplace(ThreadVars *tv, DecodeThreadVars *dtv,
 {
     /* tag flow as reused so future lookups won't find it */
     old_f->flags |= FLOW_TCP_REUSED;
+    /* free up its lookup slot for the new flow */
+    FlowBucketSlotDel(fb, old_f);
     /* get some settings that we move over to the new flow */
     FlowThreadId thread_id = old_f->thread_id;
 
@@ -438,16 +474,156 @@ static Flow *TcpReuseReplace(ThreadVars *tv, DecodeThreadVars *dtv,
     FlowInit(f, p);
     f->flow_hash = hash;
     f->fb = fb;
+    FlowBucketSlotAdd(fb, f);
+    FlowTimerArm(f);
 
     f->thread_id = thread_id;
     return f;
 }
 
+static FlowEpochReader *flow_epoch_readers = NULL;
+static SCMutex flow_epoch_readers_lock = SCMUTEX_INITIALIZER;
+
+/** \brief register the calling thread as a lockless flow hash reader
+ *
+ *  \retval r reader or NULL on alloc failure. Without a reader the
+ *             thread only uses the locked lookup.
+ */
+FlowEpochReader *FlowEpochReaderRegister(void)
+{
+    FlowEpochReader *r = SCCalloc(1, sizeof(*r));
+    if (unlikely(r == NULL))
+        return NULL;
+    SC_ATOMIC_INIT(r->epoch);
+
+    SCMutexLock(&flow_epoch_readers_lock);
+    r->next = flow_epoch_readers;
+    flow_epoch_readers = r;
+    SCMutexUnlock(&flow_epoch_readers_lock);
+    return r;
+}
+
+void FlowEpochReaderDeregister(FlowEpochReader *r)
+{
+    if (r == NULL)
+        return;
+
+    SCMutexLock(&flow_epoch_readers_lock);
+    FlowEpochReader **pr = &flow_epoch_readers;
+    while (*pr != NULL) {
+        if (*pr == r) {
+            *pr = r->next;
+            break;
+        }
+        pr = &(*pr)->next;
+    }
+    SCMutexUnlock(&flow_epoch_readers_lock);
+
+    SC_ATOMIC_DESTROY(r->epoch);
+    SCFree(r);
+}
+
+/** \brief start a new epoch for memory that just left the hash
+ *
+ *  Flows (or slabs) must be unreachable through the hash before this
+ *  is called. Readers that start a lookup after this see the new epoch
+ *  and can't find them anymore.
+ *
+ *  \retval epoch to pass to FlowEpochPassed() before freeing
+ */
+uint64_t FlowEpochRetire(void)
+{
+    return SC_ATOMIC_ADD(flow_epoch, 1);
+}
+
+/** \brief check if all readers are done with memory retired in 'epoch'
+ *
+ *  A reader is done if it is idle or if it started its current lookup
+ *  in 'epoch' or later.
+ *
+ *  \retval 1 memory retired in 'epoch' can be freed
+ *  \retval 0 a reader may still hold a pointer to it
+ */
+int FlowEpochPassed(const uint64_t epoch)
+{
+    int passed = 1;
+
+    SCMutexLock(&flow_epoch_readers_lock);
+    FlowEpochReader *r = flow_epoch_readers;
+    for ( ; r != NULL; r = r->next) {
+        const uint64_t re = SC_ATOMIC_GET(r->epoch);
+        if (re != 0 && re < epoch) {
+            passed = 0;
+            break;
+        }
+    }
+    SCMutexUnlock(&flow_epoch_readers_lock);
+    return passed;
+}
+
+/** \internal
+ *  \brief mark the reader as inside a lockless lookup
+ *
+ *  SC_ATOMIC_SET is a full barrier, so the epoch is visible before
+ *  any of the bucket slots are read. */
+static inline void FlowEpochEnter(FlowEpochReader *r)
+{
+    (void)SC_ATOMIC_SET(r->epoch, SC_ATOMIC_GET(flow_epoch));
+}
+
+static inline void FlowEpochExit(FlowEpochReader *r)
+{
+    (void)SC_ATOMIC_SET(r->epoch, 0);
+}
+
+/** \internal
+ *  \brief Lockless lookup of a flow in the bucket's lookup slots
+ *
+ *  Scans the tag/flow slots without taking the bucket lock. The seq
+ *  counter tells us if a writer touched the slots while we read them.
+ *  A candidate is then locked and validated: flows are only removed
+ *  from the hash (clearing Flow::fb) or marked as reused while the flow
+ *  lock is held, so once we hold it the check below is stable.
+ *
+ *  Must be called between FlowEpochEnter() and FlowEpochExit(). Flow
+ *  memory stays valid for the reader until it exits the epoch: flows
+ *  that left the hash are only freed after FlowEpochPassed() says all
+ *  readers are done with them, see FlowUpdateSpareFlows(). Once the
+ *  flow is returned locked and validated it is in the hash, so it can't
+ *  be freed until it's removed again under its lock.
+ *
+ *  \retval f *LOCKED* flow or NULL if the locked lookup is needed
+ */
+static inline Flow *FlowBucketLookupLockless(FlowBucket *fb,
+        const uint32_t hash, const Packet *p)
+{
+    int i;
+    for (i = 0; i < FLOW_BUCKET_SLOTS; i++) {
+        const uint32_t seq = SC_ATOMIC_GET(fb->seq);
+        cc_barrier();
+        const uint32_t tag = fb->tag[i];
+        Flow *f = fb->slot[i];
+        cc_barrier();
+        /* writer active or done in the mean time: take the slow path */
+        if ((seq & 1) || seq != SC_ATOMIC_GET(fb->seq))
+            return NULL;
+        if (f == NULL || tag != hash)
+            continue;
+
+        FLOWLOCK_WRLOCK(f);
+        if (f->fb == fb && FlowCompare(f, p) != 0)
+            return f;
+        FLOWLOCK_UNLOCK(f);
+    }
+    return NULL;
+}
+
 /** \brief Get Flow for packet
  *
- * Hash retrieval function for flows. Looks up the hash bucket containing the
- * flow pointer. Then compares the packet with the found flow to see if it is
- * the flow we need. If it isn't, walk the list until the right flow is found.
+ * Hash retrieval function for flows. First the bucket's lookup slots are
+ * checked without locking the bucket. If that doesn't produce the flow,
+ * the bucket is locked and the packet is compared with the flows in the
+ * list. If it isn't the first, walk the list until the right flow is found.
  *
  * If the flow is not found or the bucket was emtpy, a new flow is taken from
  * the queue. FlowDequeue() will alloc new flows as long as we stay within our
@@ -464,9 +640,25 @@ Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p
 {
     Flow *f = NULL;
 
-    /* get our hash bucket and lock it */
+    /* get our hash bucket */
     const uint32_t hash = p->flow_hash;
     FlowBucket *fb = &flow_hash[hash % flow_config.hash_size];
+
+    /* fast path: active flows are usually in a lookup slot */
+    if (dtv != NULL && dtv->flow_reader != NULL) {
+        FlowEpochEnter(dtv->flow_reader);
+        f = FlowBucketLookupLockless(fb, hash, p);
+        FlowEpochExit(dtv->flow_reader);
+    }
+    if (f != NULL) {
+        if (likely(TcpSessionPacketSsnReuse(p, f, f->protoctx) == 0)) {
+            FlowReference(dest, f);
+            return f;
+        }
+        /* session reuse needs the bucket lock, handled below */
+        FLOWLOCK_UNLOCK(f);
+    }
+
     FBLOCK_LOCK(fb);
 
     SCLogDebug("fb %p fb->head %p", fb, fb->head);
@@ -487,7 +679,9 @@ Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p
         FlowInit(f, p);
         f->flow_hash = hash;
         f->fb = fb;
+        FlowBucketSlotAdd(fb, f);
         FlowUpdateState(f, FLOW_STATE_NEW);
+        FlowTimerArm(f);
 
         FlowReference(dest, f);
 
@@ -522,7 +716,9 @@ Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p
                 FlowInit(f, p);
                 f->flow_hash = hash;
                 f->fb = fb;
+                FlowBucketSlotAdd(fb, f);
                 FlowUpdateState(f, FLOW_STATE_NEW);
+                FlowTimerArm(f);
 
                 FlowReference(dest, f);
 
@@ -631,18 +827,8 @@ static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv)
         }
 
         /* remove from the hash */
-        if (f->hprev != NULL)
-            f->hprev->hnext = f->hnext;
-        if (f->hnext != NULL)
-            f->hnext->hprev = f->hprev;
-        if (fb->head == f)
-            fb->head = f->hnext;
-        if (fb->tail == f)
-            fb->tail = f->hprev;
-
-        f->hnext = NULL;
-        f->hprev = NULL;
-        f->fb = NULL;
+        FlowTimerDisarm(f);
+        FlowBucketRemove(fb, f);
         SC_ATOMIC_SET(fb->next_ts, 0);
         FBLOCK_UNLOCK(fb);
 
@@ -679,3 +865,244 @@ static Flow *FlowGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv)
 
     return NULL;
 }
+
+/** map of flow hash to the worker thread that created the flow. Only
+ *  used with private flow tables to detect flows whose packets are
+ *  spread over several workers (asymmetric hashing). Each entry holds
+ *  the full 32 bit flow hash in the upper half and the thread id in the
+ *  lower half. Read and written without locking as it only drives a
+ *  counter. */
+static uint64_t *flow_owner_map = NULL;
+static uint32_t flow_owner_map_size = 0;
+
+int FlowOwnerMapInit(uint32_t size)
+{
+    flow_owner_map = SCCalloc(size, sizeof(uint64_t));
+    if (unlikely(flow_owner_map == NULL))
+        return -1;
+    flow_owner_map_size = size;
+    return 0;
+}
+
+void FlowOwnerMapFree(void)
+{
+    if (flow_owner_map != NULL) {
+        SCFree(flow_owner_map);
+        flow_owner_map = NULL;
+    }
+    flow_owner_map_size = 0;
+}
+
+/** \internal
+ *  \brief register a new flow's owner, count it if another worker
+ *         already created a flow with this hash */
+static inline void FlowOwnerMapUpdate(ThreadVars *tv, DecodeThreadVars *dtv,
+        const uint32_t hash, const FlowThreadId thread_id)
+{
+    if (flow_owner_map == NULL)
+        return;
+
+    uint64_t *e = &flow_owner_map[hash % flow_owner_map_size];
+    const uint64_t v = *e;
+    if (v != 0 && (uint32_t)(v >> 32) == hash &&
+            (FlowThreadId)(v & 0xffff) != thread_id)
+    {
+        SCLogDebug("flow hash %08x already owned by thread %u", hash,
+                (uint32_t)(v & 0xffff));
+        if (tv != NULL && dtv != NULL)
+            StatsIncr(tv, dtv->counter_flow_wrong_thread);
+        return;
+    }
+    *e = ((uint64_t)hash << 32) | thread_id;
+}
+
+/** \internal
+ *  \brief Get a flow from the private table directly.
+ *
+ *  Private table version of FlowGetUsedFlow(). As only the owner
+ *  thread accesses the table, no bucket locks are needed.
+ *
+ *  \retval f *LOCKED* flow or NULL
+ */
+static Flow *FlowPrivateGetUsedFlow(ThreadVars *tv, DecodeThreadVars *dtv,
+        FlowPrivateTable *ft)
+{
+    uint32_t idx = ft->prune_row;
+    uint32_t cnt = ft->hash_size;
+
+    while (cnt--) {
+        if (++idx >= ft->hash_size)
+            idx = 0;
+
+        FlowBucket *fb = &ft->hash[idx];
+        Flow *f = fb->tail;
+        if (f == NULL)
+            continue;
+
+        /** never prune a flow that is still used by a packet */
+        if (SC_ATOMIC_GET(f->use_cnt) > 0)
+            continue;
+
+        FLOWLOCK_WRLOCK(f);
+
+        FlowBucketRemove(fb, f);
+        SC_ATOMIC_SET(fb->next_ts, 0);
+
+        int state = SC_ATOMIC_GET(f->flow_state);
+        if (state == FLOW_STATE_NEW)
+            f->flow_end_flags |= FLOW_END_FLAG_STATE_NEW;
+        else if (state == FLOW_STATE_ESTABLISHED)
+            f->flow_end_flags |= FLOW_END_FLAG_STATE_ESTABLISHED;
+        else if (state == FLOW_STATE_CLOSED)
+            f->flow_end_flags |= FLOW_END_FLAG_STATE_CLOSED;
+        else if (state == FLOW_STATE_CAPTURE_BYPASSED)
+            f->flow_end_flags |= FLOW_END_FLAG_STATE_BYPASSED;
+        else if (state == FLOW_STATE_LOCAL_BYPASSED)
+            f->flow_end_flags |= FLOW_END_FLAG_STATE_BYPASSED;
+
+        f->flow_end_flags |= FLOW_END_FLAG_FORCED;
+
+        if (SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY)
+            f->flow_end_flags |= FLOW_END_FLAG_EMERGENCY;
+
+        /* invoke flow log api */
+        if (dtv && dtv->output_flow_thread_data)
+            (void)OutputFlowLog(tv, dtv->output_flow_thread_data, f);
+
+        FlowClearMemory(f, f->protomap);
+
+        FlowUpdateState(f, FLOW_STATE_NEW);
+
+        ft->prune_row = idx;
+        return f;
+    }
+
+    return NULL;
+}
+
+/** \internal
+ *  \brief Get a new flow for the private table
+ *
+ *  Flows are taken from the table's private spare list. If that is
+ *  empty it's refilled from the local slab, or from the global spare
+ *  queue when the slab is at the memcap. After that we take a flow
+ *  from our own table.
+ *
+ *  \retval f *LOCKED* flow on succes, NULL on error.
+ */
+static Flow *FlowPrivateGetNew(ThreadVars *tv, DecodeThreadVars *dtv,
+        FlowPrivateTable *ft, const Packet *p)
+{
+    Flow *f = NULL;
+
+    if (FlowCreateCheck(p) == 0) {
+        return NULL;
+    }
+
+    if (ft->spare == NULL) {
+        /* refill from the local slab. The global spare queue is only
+         * used if the slab is at the memcap. */
+        uint32_t i;
+        for (i = 0; i < FLOW_PRIVATE_SPARE_BATCH; i++) {
+            Flow *n = FlowAlloc();
+            if (n == NULL)
+                n = FlowDequeue(&flow_spare_q);
+            if (n == NULL)
+                break;
+            n->lnext = ft->spare;
+            ft->spare = n;
+            ft->spare_len++;
+        }
+    }
+
+    if (ft->spare != NULL) {
+        f = ft->spare;
+        ft->spare = f->lnext;
+        f->lnext = NULL;
+        ft->spare_len--;
+
+    } else {
+        /* declare state of emergency */
+        if (!(SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY)) {
+            SC_ATOMIC_OR(flow_flags, FLOW_EMERGENCY);
+            FlowTimeoutsEmergency();
+            FlowWakeupFlowManagerThread();
+        }
+
+        /* flow is returned locked */
+        f = FlowPrivateGetUsedFlow(tv, dtv, ft);
+        if (f == NULL) {
+            if (tv != NULL && dtv != NULL) {
+                StatsIncr(tv, dtv->counter_flow_memcap);
+            }
+            return NULL;
+        }
+        return f;
+    }
+
+    FLOWLOCK_WRLOCK(f);
+    return f;
+}
+
+/** \brief Get Flow for packet from a worker's private flow table
+ *
+ *  Private table version of FlowGetFlowFromHash(). The table is only
+ *  used by the calling thread, so the bucket is walked without locking.
+ *  The flow itself is still locked, as the rest of the engine expects.
+ *
+ *  \param tv thread vars
+ *  \param dtv decode thread vars (for flow log api thread data)
+ *  \param ft private flow table of this thread
+ *
+ *  \retval f *LOCKED* flow or NULL
+ */
+Flow *FlowGetFlowFromPrivateTable(ThreadVars *tv, DecodeThreadVars *dtv,
+        FlowPrivateTable *ft, const Packet *p, Flow **dest)
+{
+    const uint32_t hash = p->flow_hash;
+    FlowBucket *fb = &ft->hash[hash % ft->hash_size];
+    Flow *f;
+
+    for (f = fb->head; f != NULL; f = f->hnext) {
+        if (f->flow_hash == hash && FlowCompare(f, p) != 0)
+            break;
+    }
+
+    if (f != NULL) {
+        FLOWLOCK_WRLOCK(f);
+        if (likely(TcpSessionPacketSsnReuse(p, f, f->protoctx) == 0)) {
+            FlowReference(dest, f);
+            return f;
+        }
+        /* tag flow as reused so future lookups won't find it */
+        f->flags |= FLOW_TCP_REUSED;
+        FLOWLOCK_UNLOCK(f);
+    }
+
+    f = FlowPrivateGetNew(tv, dtv, ft, p);
+    if (f == NULL)
+        return NULL;
+
+    /* flow is locked */
+
+    FlowOwnerMapUpdate(tv, dtv, hash, ft->thread_id);
+
+    /* put at the start of the list */
+    f->hnext = fb->head;
+    f->hprev = NULL;
+    if (fb->head != NULL)
+        fb->head->hprev = f;
+    else
+        fb->tail = f;
+    fb->head = f;
+
+    /* initialize and return */
+    FlowInit(f, p);
+    f->flow_hash = hash;
+    f->fb = fb;
+    f->thread_id = ft->thread_id;
+    FlowUpdateState(f, FLOW_STATE_NEW);
+
+    FlowReference(dest, f);
+    return f;
+}
@@ -34,11 +34,29 @@
     #endif
 #endif
 
+/** number of flows per bucket that are stored in the lockless lookup
+ *  slots. Together with the tags and the sequence counter they fill
+ *  the first cache line of the bucket. */
+#define FLOW_BUCKET_SLOTS   4
+
 /* flow hash bucket -- the hash is basically an array of these buckets.
  * Each bucket contains a flow or list of flows. All these flows have
  * the same hashkey (the hash is a chained hash). When doing modifications
- * to the list, the entire bucket is locked. */
+ * to the list, the entire bucket is locked.
+ *
+ * The first FLOW_BUCKET_SLOTS flows added to a bucket are also stored in
+ * the slot array together with their full 32 bit hash as a tag. Lookups
+ * scan these slots without taking the bucket lock, using 'seq' as a
+ * seqlock: writers (holding the bucket lock) make it odd while updating
+ * the slots and even again when done. Flows not in a slot are only
+ * found by walking the list under the bucket lock. */
 typedef struct FlowBucket_ {
+    /* lockless lookup part: first cache line */
+    SC_ATOMIC_DECLARE(uint32_t, seq);
+    uint32_t tag[FLOW_BUCKET_SLOTS];
+    Flow *slot[FLOW_BUCKET_SLOTS];
+
+    /* locked part */
     Flow *head;
     Flow *tail;
 #ifdef FBLOCK_MUTEX
@@ -72,9 +90,140 @@ typedef struct FlowBucket_ {
     #error Enable FBLOCK_SPIN or FBLOCK_MUTEX
 #endif
 
+/** \brief start a slot update. Bucket lock must be held. */
+static inline void FlowBucketSeqBegin(FlowBucket *fb)
+{
+    (void)SC_ATOMIC_ADD(fb->seq, 1);
+    hw_barrier();
+}
+
+/** \brief finish a slot update. Bucket lock must be held. */
+static inline void FlowBucketSeqEnd(FlowBucket *fb)
+{
+    hw_barrier();
+    (void)SC_ATOMIC_ADD(fb->seq, 1);
+}
+
+/**
+ *  \brief add a flow to a free lookup slot of the bucket, if any.
+ *
+ *  Bucket lock must be held. If all slots are in use the flow is only
+ *  reachable through the list.
+ */
+static inline void FlowBucketSlotAdd(FlowBucket *fb, Flow *f)
+{
+    int i;
+    for (i = 0; i < FLOW_BUCKET_SLOTS; i++) {
+        if (fb->slot[i] == NULL) {
+            FlowBucketSeqBegin(fb);
+            fb->tag[i] = f->flow_hash;
+            fb->slot[i] = f;
+            FlowBucketSeqEnd(fb);
+            return;
+        }
+    }
+}
+
+/**
+ *  \brief remove a flow from its lookup slot, if it has one. The flow
+ *         stays on the list. Bucket lock must be held.
+ */
+static inline void FlowBucketSlotDel(FlowBucket *fb, const Flow *f)
+{
+    int i;
+    for (i = 0; i < FLOW_BUCKET_SLOTS; i++) {
+        if (fb->slot[i] == f) {
+            FlowBucketSeqBegin(fb);
+            fb->slot[i] = NULL;
+            fb->tag[i] = 0;
+            FlowBucketSeqEnd(fb);
+            return;
+        }
+    }
+}
+
+/**
+ *  \brief remove a flow from the bucket: both the list and its lookup
+ *         slot, if it has one.
+ *
+ *  Bucket lock and flow lock must be held.
+ */
+static inline void FlowBucketRemove(FlowBucket *fb, Flow *f)
+{
+    FlowBucketSlotDel(fb, f);
+
+    if (f->hprev != NULL)
+        f->hprev->hnext = f->hnext;
+    if (f->hnext != NULL)
+        f->hnext->hprev = f->hprev;
+    if (fb->head == f)
+        fb->head = f->hnext;
+    if (fb->tail == f)
+        fb->tail = f->hprev;
+
+    f->hnext = NULL;
+    f->hprev = NULL;
+    /* lockless lookups validate a slot hit against this */
+    f->fb = NULL;
+}
+
+/** number of flows a private table takes from the global spare queue
+ *  at once */
+#define FLOW_PRIVATE_SPARE_BATCH    32
+/** lower limit for the private table hash size */
+#define FLOW_PRIVATE_MIN_HASH_SIZE  1024
+
+/** per worker private flow table. Used when the capture method already
+ *  makes sure all packets of a flow end up in the same worker thread
+ *  (AF_PACKET cluster_flow, NIC RSS). The table and its spare flows are
+ *  only ever accessed by the owning thread, so no bucket locks are
+ *  taken. Timed out flows are handed to the flow recycler as usual. */
+typedef struct FlowPrivateTable_ {
+    FlowBucket *hash;
+    uint32_t hash_size;
+
+    /** thread id of the owner, used to detect flows that show up
+     *  in more than one worker */
+    uint16_t thread_id;
+
+    /** private spare flows, linked through Flow::lnext */
+    Flow *spare;
+    uint32_t spare_len;
+
+    /** next row to check in the timeout walk */
+    uint32_t timeout_row;
+    /** packet time (sec) of the last timeout walk */
+    uint32_t timeout_ts;
+    /** next row to check when evicting a flow under memcap pressure */
+    uint32_t prune_row;
+    /** next row to force reassembly for at shutdown */
+    uint32_t shutdown_row;
+} FlowPrivateTable;
+
+/** lockless lookup reader. Every thread doing lockless bucket lookups
+ *  registers one of these. 'epoch' holds the global flow epoch the
+ *  reader saw when it started a lookup, or 0 while it is outside of
+ *  a lookup. Flow memory that left the hash is only freed once all
+ *  readers moved past the epoch it was retired in, see FlowEpochRetire()
+ *  and FlowEpochPassed(). */
+typedef struct FlowEpochReader_ {
+    SC_ATOMIC_DECLARE(uint64_t, epoch);
+    struct FlowEpochReader_ *next;
+} FlowEpochReader;
+
 /* prototypes */
 
+FlowEpochReader *FlowEpochReaderRegister(void);
+void FlowEpochReaderDeregister(FlowEpochReader *r);
+uint64_t FlowEpochRetire(void);
+int FlowEpochPassed(const uint64_t epoch);
+
 Flow *FlowGetFlowFromHash(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *, Flow **);
+Flow *FlowGetFlowFromPrivateTable(ThreadVars *tv, DecodeThreadVars *dtv,
+        FlowPrivateTable *ft, const Packet *, Flow **);
+void FlowHashPrefetchBatch(Packet **pkts, const uint32_t cnt);
+int FlowOwnerMapInit(uint32_t size);
+void FlowOwnerMapFree(void);
 
 void FlowDisableTcpReuseHandling(void);
 
@@ -66,6 +66,7 @@
 #include "ippair-timeout.h"
 
 #include "output-flow.h"
+#include "util-ebpf.h"
 
 /* Run mode selected at suricata.c */
 extern int run_mode;
@@ -103,6 +104,9 @@ void FlowTimeoutsEmergency(void)
 #define FLOW_EMERG_MODE_UPDATE_DELAY_SEC 0
 #define FLOW_EMERG_MODE_UPDATE_DELAY_NSEC 100000
 #define NEW_FLOW_COUNT_COND 10
+/** number of packet time seconds a full timeout walk of a private
+ *  flow table is spread over */
+#define FLOW_PRIVATE_TIMEOUT_SLICES 8
 
 typedef struct FlowTimeoutCounters_ {
     uint32_t new;
@@ -122,6 +126,9 @@ typedef struct FlowTimeoutCounters_ {
     uint32_t rows_empty;
     uint32_t rows_busy;
     uint32_t rows_maxlen;
+
+    uint32_t wheel_rearmed;
+    uint32_t wheel_busy;
 } FlowTimeoutCounters;
 
 /**
@@ -246,17 +253,32 @@ static int FlowManagerFlowTimeout(const Flow *f, enum FlowState state, struct ti
     return 1;
 }
 
+/** \internal
+ *  \brief force reassembly from the flow manager, or from the worker
+ *         owning the flow if worker_tv is set */
+static inline void FlowManagerForceReassembly(ThreadVars *worker_tv, Flow *f,
+                                              int server, int client)
+{
+    if (worker_tv != NULL)
+        (void)FlowForceReassemblyForFlowLocal(worker_tv, f, server, client);
+    else
+        (void)FlowForceReassemblyForFlow(f, server, client);
+}
+
 /** \internal
  *  \brief See if we can really discard this flow. Check use_cnt reference
  *         counter and force reassembly if necessary.
  *
  *  \param f flow
  *  \param ts timestamp
+ *  \param worker_tv worker thread doing the check for its private flow
+ *         table, NULL for the flow manager
  *
  *  \retval 0 not timed out just yet
  *  \retval 1 fully timed out, lets kill it
  */
-static int FlowManagerFlowTimedOut(Flow *f, struct timeval *ts)
+static int FlowManagerFlowTimedOut(Flow *f, struct timeval *ts,
+                                   ThreadVars *worker_tv)
 {
     /** never prune a flow that is used by a packet or stream msg
      *  we are currently processing in one of the threads */
@@ -269,15 +291,20 @@ static int FlowManagerFlowTimedOut(Flow *f, struct timeval *ts)
     int state = SC_ATOMIC_GET(f->flow_state);
     if ((state == FLOW_STATE_LOCAL_BYPASSED) ||
             (state == FLOW_STATE_CAPTURE_BYPASSED)) {
+        /* the capture method may still be handling the flow's packets */
+        if (state == FLOW_STATE_CAPTURE_BYPASSED &&
+                FlowBypassUpdate(f, ts) == 1) {
+            return 0;
+        }
         if (FlowForceReassemblyNeedReassembly(f, &server, &client) == 1) {
-            FlowForceReassemblyForFlow(f, server, client);
+            FlowManagerForceReassembly(worker_tv, f, server, client);
         }
         return 1;
     }
 
     if (!(f->flags & FLOW_TIMEOUT_REASSEMBLY_DONE) &&
             FlowForceReassemblyNeedReassembly(f, &server, &client) == 1) {
-        FlowForceReassemblyForFlow(f, server, client);
+        FlowManagerForceReassembly(worker_tv, f, server, client);
         return 0;
     }
 #ifdef DEBUG
@@ -297,11 +324,14 @@ static int FlowManagerFlowTimedOut(Flow *f, struct timeval *ts)
  *  \param ts timestamp
  *  \param emergency bool indicating emergency mode
  *  \param counters ptr to FlowTimeoutCounters structure
+ *  \param worker_tv worker thread checking its private flow table, NULL
+ *         for the flow manager
  *
  *  \retval cnt timed out flows
  */
 static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
-        int emergency, FlowTimeoutCounters *counters, int32_t *next_ts)
+        int emergency, FlowTimeoutCounters *counters, int32_t *next_ts,
+        ThreadVars *worker_tv)
 {
     uint32_t cnt = 0;
     uint32_t checked = 0;
@@ -311,8 +341,10 @@ static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
 
         /* check flow timeout based on lastts and state. Both can be
          * accessed w/o Flow lock as we do have the hash row lock (so flow
-         * can't disappear) and flow_state is atomic. lastts can only
-         * be modified when we have both the flow and hash row lock */
+         * can't disappear) and flow_state is atomic. This is only a hint
+         * though: workers that find the flow through a lockless lookup
+         * slot don't take the row lock, so lastts and use_cnt can change
+         * until we hold the flow lock. Both are checked again below. */
 
         enum FlowState state = SC_ATOMIC_GET(f->flow_state);
 
@@ -326,30 +358,32 @@ static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
         }
 
         /* before grabbing the flow lock, make sure we have at least
-         * 3 packets in the pool */
-        PacketPoolWaitForN(3);
+         * 3 packets in the pool. Not for a worker: the pool is its own
+         * and it's only refilled by the worker itself. */
+        if (worker_tv == NULL)
+            PacketPoolWaitForN(3);
 
         FLOWLOCK_WRLOCK(f);
 
         Flow *next_flow = f->hprev;
 
+        /* a worker may have updated the flow after the unlocked check */
+        state = SC_ATOMIC_GET(f->flow_state);
+        if (FlowManagerFlowTimeout(f, state, ts, next_ts) == 0) {
+            counters->flows_notimeout++;
+            FLOWLOCK_UNLOCK(f);
+            f = next_flow;
+            continue;
+        }
+
         counters->flows_timeout++;
 
         /* check if the flow is fully timed out and
          * ready to be discarded. */
-        if (FlowManagerFlowTimedOut(f, ts) == 1) {
+        if (FlowManagerFlowTimedOut(f, ts, worker_tv) == 1) {
             /* remove from the hash */
-            if (f->hprev != NULL)
-                f->hprev->hnext = f->hnext;
-            if (f->hnext != NULL)
-                f->hnext->hprev = f->hprev;
-            if (f->fb->head == f)
-                f->fb->head = f->hnext;
-            if (f->fb->tail == f)
-                f->fb->tail = f->hprev;
-
-            f->hnext = NULL;
-            f->hprev = NULL;
+            FlowTimerDisarm(f);
+            FlowBucketRemove(f->fb, f);
 
             if (f->flags & FLOW_TCP_REUSED)
                 counters->tcp_reuse++;
@@ -371,8 +405,11 @@ static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
 
 //            FlowClearMemory (f, f->protomap);
 
-            /* no one is referring to this flow, use_cnt 0, removed from hash
-             * so we can unlock it and move it back to the spare queue. */
+            /* no one is referring to this flow: use_cnt was 0 while we
+             * held the flow lock and lockless lookups validate Flow::fb
+             * under that same lock, so it can't be picked up anymore.
+             * Removed from hash so we can unlock it and move it back to
+             * the spare queue. */
             FLOWLOCK_UNLOCK(f);
             FlowEnqueue(&flow_recycle_q, f);
             /* move to spare list */
@@ -465,7 +502,8 @@ static uint32_t FlowTimeoutHash(struct timeval *ts, uint32_t try_cnt,
         int32_t next_ts = 0;
 
         /* we have a flow, or more than one */
-        cnt += FlowManagerHashRowTimeout(fb->tail, ts, emergency, counters, &next_ts);
+        cnt += FlowManagerHashRowTimeout(fb->tail, ts, emergency, counters,
+                &next_ts, NULL);
 
         SC_ATOMIC_SET(fb->next_ts, next_ts);
 
@@ -479,6 +517,488 @@ next:
     return cnt;
 }
 
+/** \defgroup flowtimer Flow timer wheel
+ *
+ *  Flows in the global hash are armed in a two level timer wheel at the
+ *  moment they are expected to time out, so the flow manager only has
+ *  to look at the flows that are about to expire. Level 0 has a slot
+ *  per second, level 1 a slot per FLOW_TIMER_L0_SLOTS seconds.
+ *
+ *  Flows are armed on creation and re-armed on state changes. Packets
+ *  don't re-arm the timer: when a slot fires, flows that have seen
+ *  packets in the mean time are simply armed again at their new expiry
+ *  time.
+ *
+ *  Slot lists are protected by a spinlock per slot. Arming and disarming
+ *  is done with the flow lock held and takes one slot lock at a time.
+ *  Only the (first) flow manager holds two slot locks at once, when it
+ *  moves a fired slot to the pending slot.
+ *
+ *  @{
+ */
+
+#define FLOW_TIMER_L0_SLOTS     256
+#define FLOW_TIMER_L1_SLOTS     64
+#define FLOW_TIMER_L1_SHIFT     8   /**< log2(FLOW_TIMER_L0_SLOTS) */
+/** slot flows are moved to when their slot fires, or when they are armed
+ *  before the wheel runs */
+#define FLOW_TIMER_PENDING      (FLOW_TIMER_L0_SLOTS + FLOW_TIMER_L1_SLOTS)
+#define FLOW_TIMER_SLOTS        (FLOW_TIMER_PENDING + 1)
+
+typedef struct FlowTimerSlot_ {
+    SCSpinlock lock;
+    Flow *head;
+    uint32_t len;
+} __attribute__((aligned(CLS))) FlowTimerSlot;
+
+static FlowTimerSlot flow_timer_slots[FLOW_TIMER_SLOTS];
+/** last second the wheel has fired, 0 if it didn't run yet */
+SC_ATOMIC_DECLARE(uint32_t, flow_timer_cur);
+
+void FlowTimerInit(void)
+{
+    uint32_t u;
+
+    memset(flow_timer_slots, 0, sizeof(flow_timer_slots));
+    for (u = 0; u < FLOW_TIMER_SLOTS; u++) {
+        SCSpinInit(&flow_timer_slots[u].lock, 0);
+    }
+    SC_ATOMIC_INIT(flow_timer_cur);
+}
+
+void FlowTimerDestroy(void)
+{
+    uint32_t u;
+
+    for (u = 0; u < FLOW_TIMER_SLOTS; u++) {
+        SCSpinDestroy(&flow_timer_slots[u].lock);
+        flow_timer_slots[u].head = NULL;
+        flow_timer_slots[u].len = 0;
+    }
+    SC_ATOMIC_DESTROY(flow_timer_cur);
+}
+
+/** \internal
+ *  \brief get the slot index for expiry time 'e'
+ *
+ *  \param cur last second the wheel fired
+ */
+static inline uint32_t FlowTimerSlotIdx(uint32_t e, const uint32_t cur)
+{
+    if (cur == 0)
+        return FLOW_TIMER_PENDING;
+
+    if (e <= cur)
+        e = cur + 1;
+
+    if (e - cur < FLOW_TIMER_L0_SLOTS)
+        return e % FLOW_TIMER_L0_SLOTS;
+
+    uint32_t period = e >> FLOW_TIMER_L1_SHIFT;
+    const uint32_t cur_period = cur >> FLOW_TIMER_L1_SHIFT;
+    if (period - cur_period >= FLOW_TIMER_L1_SLOTS)
+        period = cur_period + FLOW_TIMER_L1_SLOTS - 1;
+    return FLOW_TIMER_L0_SLOTS + (period % FLOW_TIMER_L1_SLOTS);
+}
+
+/** \internal
+ *  \brief add flow to slot. Slot lock must be held. */
+static inline void FlowTimerSlotAdd(FlowTimerSlot *ts, const uint32_t idx, Flow *f)
+{
+    f->tprev = NULL;
+    f->tnext = ts->head;
+    if (ts->head != NULL)
+        ts->head->tprev = f;
+    ts->head = f;
+    ts->len++;
+    f->timer_slot = (uint16_t)(idx + 1);
+}
+
+/** \internal
+ *  \brief remove flow from slot. Slot lock must be held. */
+static inline void FlowTimerSlotDel(FlowTimerSlot *ts, Flow *f)
+{
+    if (f->tprev != NULL)
+        f->tprev->tnext = f->tnext;
+    else
+        ts->head = f->tnext;
+    if (f->tnext != NULL)
+        f->tnext->tprev = f->tprev;
+    f->tnext = NULL;
+    f->tprev = NULL;
+    ts->len--;
+    f->timer_slot = 0;
+}
+
+/** \internal
+ *  \brief arm timer at absolute time 'e' (sec) */
+static void FlowTimerArmAt(Flow *f, const uint32_t e)
+{
+    while (1) {
+        const uint32_t cur = SC_ATOMIC_GET(flow_timer_cur);
+        const uint32_t idx = FlowTimerSlotIdx(e, cur);
+        FlowTimerSlot *ts = &flow_timer_slots[idx];
+
+        SCSpinLock(&ts->lock);
+        /* if the wheel moved on while we were getting the lock, our slot
+         * may have fired already */
+        if (likely(SC_ATOMIC_GET(flow_timer_cur) == cur)) {
+            FlowTimerSlotAdd(ts, idx, f);
+            SCSpinUnlock(&ts->lock);
+            return;
+        }
+        SCSpinUnlock(&ts->lock);
+    }
+}
+
+/**
+ *  \brief arm the flow's timer based on its last activity and state
+ *
+ *  Flow lock must be held and the timer must not be armed.
+ */
+void FlowTimerArm(Flow *f)
+{
+    const enum FlowState state = SC_ATOMIC_GET(f->flow_state);
+    const uint32_t e = (uint32_t)f->lastts.tv_sec + FlowGetFlowTimeout(f, state);
+    FlowTimerArmAt(f, e);
+}
+
+/**
+ *  \brief disarm the flow's timer, if it is armed
+ *
+ *  Flow lock must be held.
+ */
+void FlowTimerDisarm(Flow *f)
+{
+    while (1) {
+        const uint16_t slot = f->timer_slot;
+        if (slot == 0)
+            return;
+
+        FlowTimerSlot *ts = &flow_timer_slots[slot - 1];
+        SCSpinLock(&ts->lock);
+        /* the flow manager may have moved it to the pending slot */
+        if (likely(f->timer_slot == slot)) {
+            FlowTimerSlotDel(ts, f);
+            SCSpinUnlock(&ts->lock);
+            return;
+        }
+        SCSpinUnlock(&ts->lock);
+    }
+}
+
+/**
+ *  \brief re-arm an armed timer, e.g. after a state change
+ *
+ *  Flow lock must be held.
+ */
+void FlowTimerRearm(Flow *f)
+{
+    if (f->timer_slot == 0)
+        return;
+
+    FlowTimerDisarm(f);
+    FlowTimerArm(f);
+}
+
+/** \internal
+ *  \brief move all flows of a slot to the pending slot */
+static void FlowTimerSlotFire(const uint32_t idx)
+{
+    FlowTimerSlot *ts = &flow_timer_slots[idx];
+    FlowTimerSlot *pending = &flow_timer_slots[FLOW_TIMER_PENDING];
+
+    SCSpinLock(&ts->lock);
+    if (ts->head == NULL) {
+        SCSpinUnlock(&ts->lock);
+        return;
+    }
+
+    SCSpinLock(&pending->lock);
+    Flow *f = ts->head;
+    while (f != NULL) {
+        Flow *next = f->tnext;
+        FlowTimerSlotAdd(pending, FLOW_TIMER_PENDING, f);
+        f = next;
+    }
+    ts->head = NULL;
+    ts->len = 0;
+    SCSpinUnlock(&pending->lock);
+    SCSpinUnlock(&ts->lock);
+}
+
+/** \internal
+ *  \brief handle a flow from the pending slot
+ *
+ *  Flow is locked and no longer armed. Either it's timed out and removed
+ *  from the hash, or it's armed again.
+ *
+ *  \retval 1 flow was removed from the hash
+ *  \retval 0 flow was armed again
+ */
+static int FlowTimerHandleFlow(Flow *f, struct timeval *ts,
+        const uint32_t now, int emergency, FlowTimeoutCounters *counters)
+{
+    int32_t next_ts = 0;
+    enum FlowState state = SC_ATOMIC_GET(f->flow_state);
+
+    counters->flows_checked++;
+
+    int timedout = FlowManagerFlowTimeout(f, state, ts, &next_ts);
+    if (timedout && state == FLOW_STATE_CAPTURE_BYPASSED &&
+            FlowBypassUpdate(f, ts) == 1) {
+        /* still active in the capture method, lastts was updated */
+        next_ts = 0;
+        timedout = FlowManagerFlowTimeout(f, state, ts, &next_ts);
+    }
+    if (timedout == 0) {
+        counters->flows_notimeout++;
+        counters->wheel_rearmed++;
+        FlowTimerArmAt(f, (uint32_t)next_ts);
+        return 0;
+    }
+
+    FlowBucket *fb = f->fb;
+    if (fb == NULL || FBLOCK_TRYLOCK(fb) != 0) {
+        counters->rows_busy++;
+        FlowTimerArmAt(f, now + 1);
+        return 0;
+    }
+
+    counters->flows_timeout++;
+
+    /* check if the flow is fully timed out and ready to be discarded */
+    if (FlowManagerFlowTimedOut(f, ts, NULL) == 0) {
+        counters->flows_timeout_inuse++;
+        FBLOCK_UNLOCK(fb);
+        FlowTimerArmAt(f, now + 1);
+        return 0;
+    }
+
+    FlowBucketRemove(fb, f);
+    FBLOCK_UNLOCK(fb);
+
+    if (f->flags & FLOW_TCP_REUSED)
+        counters->tcp_reuse++;
+
+    if (state == FLOW_STATE_NEW)
+        f->flow_end_flags |= FLOW_END_FLAG_STATE_NEW;
+    else if (state == FLOW_STATE_ESTABLISHED)
+        f->flow_end_flags |= FLOW_END_FLAG_STATE_ESTABLISHED;
+    else if (state == FLOW_STATE_CLOSED)
+        f->flow_end_flags |= FLOW_END_FLAG_STATE_CLOSED;
+    else if (state == FLOW_STATE_LOCAL_BYPASSED)
+        f->flow_end_flags |= FLOW_END_FLAG_STATE_BYPASSED;
+    else if (state == FLOW_STATE_CAPTURE_BYPASSED)
+        f->flow_end_flags |= FLOW_END_FLAG_STATE_BYPASSED;
+
+    if (emergency)
+        f->flow_end_flags |= FLOW_END_FLAG_EMERGENCY;
+    f->flow_end_flags |= FLOW_END_FLAG_TIMEOUT;
+
+    switch (state) {
+        case FLOW_STATE_NEW:
+        default:
+            counters->new++;
+            break;
+        case FLOW_STATE_ESTABLISHED:
+            counters->est++;
+            break;
+        case FLOW_STATE_CLOSED:
+            counters->clo++;
+            break;
+        case FLOW_STATE_LOCAL_BYPASSED:
+        case FLOW_STATE_CAPTURE_BYPASSED:
+            counters->byp++;
+            break;
+    }
+    counters->flows_removed++;
+    return 1;
+}
+
+/**
+ *  \brief time out flows using the timer wheel
+ *
+ *  Fires all slots between the last run and 'ts', then checks each of
+ *  the fired flows. The work done is proportional to the number of
+ *  flows in the fired slots, not to the size of the hash.
+ *
+ *  \param ts timestamp
+ *  \param counters ptr to FlowTimeoutCounters structure
+ *
+ *  \retval cnt number of timed out flows
+ */
+static uint32_t FlowTimeoutWheel(struct timeval *ts, FlowTimeoutCounters *counters)
+{
+    const uint32_t now = (uint32_t)ts->tv_sec;
+    uint32_t cur = SC_ATOMIC_GET(flow_timer_cur);
+    uint32_t cnt = 0;
+    int emergency = 0;
+
+    if (SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY)
+        emergency = 1;
+
+    if (cur == 0) {
+        /* first run: flows armed so far are in the pending slot */
+        SC_ATOMIC_SET(flow_timer_cur, now);
+
+    } else if (now > cur) {
+        /* set the new time first, so that flows armed from here on
+         * won't go into a slot we're about to fire */
+        SC_ATOMIC_SET(flow_timer_cur, now);
+
+        const uint32_t cur_period = cur >> FLOW_TIMER_L1_SHIFT;
+        const uint32_t now_period = now >> FLOW_TIMER_L1_SHIFT;
+        uint32_t n = now_period - cur_period;
+        if (n > FLOW_TIMER_L1_SLOTS)
+            n = FLOW_TIMER_L1_SLOTS;
+        uint32_t u;
+        for (u = 0; u < n; u++) {
+            FlowTimerSlotFire(FLOW_TIMER_L0_SLOTS +
+                    ((now_period - u) % FLOW_TIMER_L1_SLOTS));
+        }
+
+        n = now - cur;
+        if (n > FLOW_TIMER_L0_SLOTS)
+            n = FLOW_TIMER_L0_SLOTS;
+        for (u = 0; u < n; u++) {
+            FlowTimerSlotFire((now - u) % FLOW_TIMER_L0_SLOTS);
+        }
+    }
+
+    FlowTimerSlot *pending = &flow_timer_slots[FLOW_TIMER_PENDING];
+    while (1) {
+        /* before grabbing the flow lock, make sure we have at least
+         * 3 packets in the pool */
+        PacketPoolWaitForN(3);
+
+        SCSpinLock(&pending->lock);
+        Flow *f = pending->head;
+        /* skip flows that are locked by a worker: they are moved to the
+         * next second's slot */
+        while (f != NULL && FLOWLOCK_TRYWRLOCK(f) != 0) {
+            Flow *next = f->tnext;
+            counters->wheel_busy++;
+            FlowTimerSlotDel(pending, f);
+            const uint32_t idx = (now + 1) % FLOW_TIMER_L0_SLOTS;
+            SCSpinLock(&flow_timer_slots[idx].lock);
+            FlowTimerSlotAdd(&flow_timer_slots[idx], idx, f);
+            SCSpinUnlock(&flow_timer_slots[idx].lock);
+            f = next;
+        }
+        if (f == NULL) {
+            SCSpinUnlock(&pending->lock);
+            break;
+        }
+        FlowTimerSlotDel(pending, f);
+        SCSpinUnlock(&pending->lock);
+
+        /* flow is locked and no longer armed */
+        if (FlowTimerHandleFlow(f, ts, now, emergency, counters) == 1) {
+            /* no one is referring to this flow, use_cnt 0, removed from hash
+             * so we can unlock it and move it to the recycle queue. */
+            FLOWLOCK_UNLOCK(f);
+            FlowEnqueue(&flow_recycle_q, f);
+            cnt++;
+        } else {
+            FLOWLOCK_UNLOCK(f);
+        }
+    }
+
+    return cnt;
+}
+
+static uint64_t FlowTimerArmedL0(void)
+{
+    uint64_t cnt = 0;
+    uint32_t u;
+    for (u = 0; u < FLOW_TIMER_L0_SLOTS; u++)
+        cnt += flow_timer_slots[u].len;
+    return cnt;
+}
+
+static uint64_t FlowTimerArmedL1(void)
+{
+    uint64_t cnt = 0;
+    uint32_t u;
+    for (u = FLOW_TIMER_L0_SLOTS; u < FLOW_TIMER_PENDING; u++)
+        cnt += flow_timer_slots[u].len;
+    return cnt;
+}
+
+static uint64_t FlowTimerSlotMax(void)
+{
+    uint32_t max = 0;
+    uint32_t u;
+    for (u = 0; u < FLOW_TIMER_L0_SLOTS; u++) {
+        if (flow_timer_slots[u].len > max)
+            max = flow_timer_slots[u].len;
+    }
+    return max;
+}
+
+/** @} */
+
+/**
+ *  \brief time out flows in a worker's private flow table
+ *
+ *  Called by the owning worker thread when packet time moved to the next
+ *  second. Each call checks the next 1/FLOW_PRIVATE_TIMEOUT_SLICES part of
+ *  the table, so the per packet cost stays low. No bucket locks are
+ *  needed as no other thread accesses the table.
+ *
+ *  The worker doesn't wait for its packet pool, and forced reassembly
+ *  pseudo packets are queued to its own stream queue, see
+ *  FlowForceReassemblyForFlowLocal().
+ *
+ *  \param tv the worker thread
+ *  \param ft private flow table
+ *  \param ts packet timestamp
+ *
+ *  \retval cnt number of timed out flows
+ */
+uint32_t FlowPrivateTableTimeout(ThreadVars *tv, FlowPrivateTable *ft,
+                                 struct timeval *ts)
+{
+    FlowTimeoutCounters counters;
+    uint32_t cnt = 0;
+    int emergency = 0;
+
+    memset(&counters, 0, sizeof(counters));
+
+    if (SC_ATOMIC_GET(flow_flags) & FLOW_EMERGENCY)
+        emergency = 1;
+
+    uint32_t rows = ft->hash_size / FLOW_PRIVATE_TIMEOUT_SLICES;
+    if (rows == 0)
+        rows = ft->hash_size;
+
+    uint32_t idx = ft->timeout_row;
+    while (rows--) {
+        FlowBucket *fb = &ft->hash[idx];
+        if (++idx >= ft->hash_size)
+            idx = 0;
+
+        int32_t check_ts = SC_ATOMIC_GET(fb->next_ts);
+        if (check_ts > (int32_t)ts->tv_sec)
+            continue;
+
+        if (fb->tail == NULL) {
+            SC_ATOMIC_SET(fb->next_ts, INT_MAX);
+            continue;
+        }
+
+        int32_t next_ts = 0;
+        cnt += FlowManagerHashRowTimeout(fb->tail, ts, emergency, &counters,
+                &next_ts, tv);
+        SC_ATOMIC_SET(fb->next_ts, next_ts);
+    }
+    ft->timeout_row = idx;
+    ft->timeout_ts = (uint32_t)ts->tv_sec;
+
+    return cnt;
+}
+
 /**
  *  \internal
  *
@@ -500,17 +1020,8 @@ static uint32_t FlowManagerHashRowCleanup(Flow *f)
         int state = SC_ATOMIC_GET(f->flow_state);
 
         /* remove from the hash */
-        if (f->hprev != NULL)
-            f->hprev->hnext = f->hnext;
-        if (f->hnext != NULL)
-            f->hnext->hprev = f->hprev;
-        if (f->fb->head == f)
-            f->fb->head = f->hnext;
-        if (f->fb->tail == f)
-            f->fb->tail = f->hprev;
-
-        f->hnext = NULL;
-        f->hprev = NULL;
+        FlowTimerDisarm(f);
+        FlowBucketRemove(f->fb, f);
 
         if (state == FLOW_STATE_NEW)
             f->flow_end_flags |= FLOW_END_FLAG_STATE_NEW;
@@ -588,6 +1099,12 @@ typedef struct FlowManagerThreadData_ {
     uint16_t flow_mgr_rows_busy;
     uint16_t flow_mgr_rows_maxlen;
 
+    uint16_t flow_mgr_wheel_rearmed;
+    uint16_t flow_mgr_wheel_busy;
+
+#ifdef HAVE_PACKET_EBPF
+    uint16_t flow_mgr_ebpf_pruned;
+#endif
 } FlowManagerThreadData;
 
 static TmEcode FlowManagerThreadInit(ThreadVars *t, void *initdata, void **data)
@@ -621,7 +1138,7 @@ static TmEcode FlowManagerThreadInit(ThreadVars *t, void *initdata, void **data)
     ftd->flow_mgr_cnt_clo = StatsRegisterCounter("flow_mgr.closed_pruned", t);
     ftd->flow_mgr_cnt_new = StatsRegisterCounter("flow_mgr.new_pruned", t);
     ftd->flow_mgr_cnt_est = StatsRegisterCounter("flow_mgr.est_pruned", t);
-    ftd->flow_mgr_cnt_est = StatsRegisterCounter("flow_mgr.bypassed_pruned", t);
+    ftd->flow_mgr_cnt_byp = StatsRegisterCounter("flow_mgr.bypassed_pruned", t);
     ftd->flow_mgr_spare = StatsRegisterCounter("flow.spare", t);
     ftd->flow_emerg_mode_enter = StatsRegisterCounter("flow.emerg_mode_entered", t);
     ftd->flow_emerg_mode_over = StatsRegisterCounter("flow.emerg_mode_over", t);
@@ -639,6 +1156,12 @@ static TmEcode FlowManagerThreadInit(ThreadVars *t, void *initdata, void **data)
     ftd->flow_mgr_rows_busy = StatsRegisterCounter("flow_mgr.rows_busy", t);
     ftd->flow_mgr_rows_maxlen = StatsRegisterCounter("flow_mgr.rows_maxlen", t);
 
+    ftd->flow_mgr_wheel_rearmed = StatsRegisterCounter("flow_mgr.wheel_rearmed", t);
+    ftd->flow_mgr_wheel_busy = StatsRegisterCounter("flow_mgr.wheel_busy", t);
+#ifdef HAVE_PACKET_EBPF
+    ftd->flow_mgr_ebpf_pruned = StatsRegisterCounter("flow_mgr.ebpf_pruned", t);
+#endif
+
     PacketPoolInit();
     return TM_ECODE_OK;
 }
@@ -707,9 +1230,14 @@ static TmEcode FlowManager(ThreadVars *th_v, void *thread_data)
         if (ftd->instance == 1)
             FlowUpdateSpareFlows();
 
-        /* try to time out flows */
-        FlowTimeoutCounters counters = { 0, 0, 0, 0, 0,0,0,0,0,0,0,0,0,0,0};
-        FlowTimeoutHash(&ts, 0 /* check all */, ftd->min, ftd->max, &counters);
+        /* try to time out flows. The wheel is only run by the first
+         * manager. In emergency mode the shorter timeouts don't match
+         * the armed timers, so then walk our part of the hash as well. */
+        FlowTimeoutCounters counters = { 0, 0, 0, 0, 0,0,0,0,0,0,0,0,0,0,0,0,0};
+        if (ftd->instance == 1)
+            FlowTimeoutWheel(&ts, &counters);
+        if (emerg == TRUE)
+            FlowTimeoutHash(&ts, 0 /* check all */, ftd->min, ftd->max, &counters);
 
 
         if (ftd->instance == 1) {
@@ -717,6 +1245,15 @@ static TmEcode FlowManager(ThreadVars *th_v, void *thread_data)
             //uint32_t hosts_pruned =
             HostTimeoutHash(&ts);
             IPPairTimeoutHash(&ts);
+#ifdef HAVE_PACKET_EBPF
+            /* flows bypassed in the kernel are not seen by us anymore,
+             * expire their entries using the kernel's timestamps */
+            struct timespec curtime;
+            clock_gettime(CLOCK_MONOTONIC, &curtime);
+            uint32_t ebpf_pruned = EBPFTimeoutFlowTables(&curtime,
+                    FLOW_BYPASSED_TIMEOUT);
+            StatsAddUI64(th_v, ftd->flow_mgr_ebpf_pruned, (uint64_t)ebpf_pruned);
+#endif
         }
 /*
         StatsAddUI64(th_v, flow_mgr_host_prune, (uint64_t)hosts_pruned);
@@ -742,6 +1279,8 @@ static TmEcode FlowManager(ThreadVars *th_v, void *thread_data)
         StatsSetUI64(th_v, ftd->flow_mgr_rows_maxlen, (uint64_t)counters.rows_maxlen);
         StatsSetUI64(th_v, ftd->flow_mgr_rows_busy, (uint64_t)counters.rows_busy);
         StatsSetUI64(th_v, ftd->flow_mgr_rows_empty, (uint64_t)counters.rows_empty);
+        StatsAddUI64(th_v, ftd->flow_mgr_wheel_rearmed, (uint64_t)counters.wheel_rearmed);
+        StatsAddUI64(th_v, ftd->flow_mgr_wheel_busy, (uint64_t)counters.wheel_busy);
 
         uint32_t len = 0;
         FQLOCK_LOCK(&flow_spare_q);
@@ -831,6 +1370,9 @@ void FlowManagerThreadSpawn()
     SCCtrlMutexInit(&flow_manager_ctrl_mutex, NULL);
 
     StatsRegisterGlobalCounter("flow.memuse", FlowGetMemuse);
+    StatsRegisterGlobalCounter("flow.wheel_armed_l0", FlowTimerArmedL0);
+    StatsRegisterGlobalCounter("flow.wheel_armed_l1", FlowTimerArmedL1);
+    StatsRegisterGlobalCounter("flow.wheel_slot_max", FlowTimerSlotMax);
 
     uint32_t u;
     for (u = 0; u < flowmgr_number; u++)
@@ -935,7 +1477,12 @@ static TmEcode FlowRecycler(ThreadVars *th_v, void *thread_data)
 
                 FlowClearMemory (f, f->protomap);
                 FLOWLOCK_UNLOCK(f);
-                FlowMoveToSpare(f);
+                /* slab flows go back to the pool of their node, the
+                 * spare queue only holds the preallocated reserve */
+                if (f->slab)
+                    FlowFree(f);
+                else
+                    FlowMoveToSpare(f);
                 recycled_cnt++;
             }
         }
@@ -1160,7 +1707,7 @@ static int FlowMgrTest01 (void)
 
     int32_t next_ts = 0;
     int state = SC_ATOMIC_GET(f.flow_state);
-    if (FlowManagerFlowTimeout(&f, state, &ts, &next_ts) != 1 && FlowManagerFlowTimedOut(&f, &ts) != 1) {
+    if (FlowManagerFlowTimeout(&f, state, &ts, &next_ts) != 1 && FlowManagerFlowTimedOut(&f, &ts, NULL) != 1) {
         FBLOCK_DESTROY(&fb);
         FLOW_DESTROY(&f);
         FlowQueueDestroy(&flow_spare_q);
@@ -1190,6 +1737,7 @@ static int FlowMgrTest02 (void)
     TcpSegment seg;
     TcpStream client;
     uint8_t payload[3] = {0x41, 0x41, 0x41};
+    StreamingBufferConfig sbcnf = { 0, 0, 16, NULL, NULL, NULL, NULL };
 
     FlowQueueInit(&flow_spare_q);
 
@@ -1205,7 +1753,9 @@ static int FlowMgrTest02 (void)
     f.flags |= FLOW_TIMEOUT_REASSEMBLY_DONE;
 
     TimeGet(&ts);
-    seg.payload = payload;
+    memset(&client.sb, 0, sizeof(StreamingBuffer));
+    client.sb.cfg = &sbcnf;
+    StreamingBufferInsertAt(&client.sb, &seg.sbseg, payload, 3, 0);
     seg.payload_len = 3;
     seg.next = NULL;
     seg.prev = NULL;
@@ -1220,12 +1770,14 @@ static int FlowMgrTest02 (void)
 
     int32_t next_ts = 0;
     int state = SC_ATOMIC_GET(f.flow_state);
-    if (FlowManagerFlowTimeout(&f, state, &ts, &next_ts) != 1 && FlowManagerFlowTimedOut(&f, &ts) != 1) {
+    if (FlowManagerFlowTimeout(&f, state, &ts, &next_ts) != 1 && FlowManagerFlowTimedOut(&f, &ts, NULL) != 1) {
+        StreamingBufferClear(&client.sb);
         FBLOCK_DESTROY(&fb);
         FLOW_DESTROY(&f);
         FlowQueueDestroy(&flow_spare_q);
         return 0;
     }
+    StreamingBufferClear(&client.sb);
     FBLOCK_DESTROY(&fb);
     FLOW_DESTROY(&f);
     FlowQueueDestroy(&flow_spare_q);
@@ -1268,7 +1820,7 @@ static int FlowMgrTest03 (void)
 
     int next_ts = 0;
     int state = SC_ATOMIC_GET(f.flow_state);
-    if (FlowManagerFlowTimeout(&f, state, &ts, &next_ts) != 1 && FlowManagerFlowTimedOut(&f, &ts) != 1) {
+    if (FlowManagerFlowTimeout(&f, state, &ts, &next_ts) != 1 && FlowManagerFlowTimedOut(&f, &ts, NULL) != 1) {
         FBLOCK_DESTROY(&fb);
         FLOW_DESTROY(&f);
         FlowQueueDestroy(&flow_spare_q);
@@ -1298,6 +1850,7 @@ static int FlowMgrTest04 (void)
     TcpSegment seg;
     TcpStream client;
     uint8_t payload[3] = {0x41, 0x41, 0x41};
+    StreamingBufferConfig sbcnf = { 0, 0, 16, NULL, NULL, NULL, NULL };
 
     FlowQueueInit(&flow_spare_q);
 
@@ -1313,7 +1866,9 @@ static int FlowMgrTest04 (void)
     f.flags |= FLOW_TIMEOUT_REASSEMBLY_DONE;
 
     TimeGet(&ts);
-    seg.payload = payload;
+    memset(&client.sb, 0, sizeof(StreamingBuffer));
+    client.sb.cfg = &sbcnf;
+    StreamingBufferInsertAt(&client.sb, &seg.sbseg, payload, 3, 0);
     seg.payload_len = 3;
     seg.next = NULL;
     seg.prev = NULL;
@@ -1329,13 +1884,15 @@ static int FlowMgrTest04 (void)
 
     int next_ts = 0;
     int state = SC_ATOMIC_GET(f.flow_state);
-    if (FlowManagerFlowTimeout(&f, state, &ts, &next_ts) != 1 && FlowManagerFlowTimedOut(&f, &ts) != 1) {
+    if (FlowManagerFlowTimeout(&f, state, &ts, &next_ts) != 1 && FlowManagerFlowTimedOut(&f, &ts, NULL) != 1) {
+        StreamingBufferClear(&client.sb);
         FBLOCK_DESTROY(&fb);
         FLOW_DESTROY(&f);
         FlowQueueDestroy(&flow_spare_q);
         return 0;
     }
 
+    StreamingBufferClear(&client.sb);
     FBLOCK_DESTROY(&fb);
     FLOW_DESTROY(&f);
     FlowQueueDestroy(&flow_spare_q);
@@ -1392,6 +1949,89 @@ static int FlowMgrTest05 (void)
     FlowShutdown();
     return result;
 }
+
+/**
+ *  \test  Test timing out flows through the timer wheel.
+ */
+static int FlowMgrTest06 (void)
+{
+    struct timeval ts;
+    FlowTimeoutCounters counters;
+
+    FlowInitConfig(FLOW_QUIET);
+    memset(&counters, 0, sizeof(counters));
+
+    /* start the wheel */
+    TimeGet(&ts);
+    FlowTimeoutWheel(&ts, &counters);
+
+    UTHBuildPacketOfFlows(0, 10, 0);
+    FAIL_IF(FlowTimerArmedL0() != 10);
+
+    /* nothing times out yet */
+    FlowTimeoutWheel(&ts, &counters);
+    FAIL_IF(flow_recycle_q.len != 0);
+
+    TimeSetIncrementTime(2000);
+    TimeGet(&ts);
+    FAIL_IF(FlowTimeoutWheel(&ts, &counters) != 10);
+    FAIL_IF(flow_recycle_q.len != 10);
+    FAIL_IF(FlowTimerArmedL0() != 0);
+    FAIL_IF(FlowTimerArmedL1() != 0);
+
+    FlowShutdown();
+    PASS;
+}
+
+/**
+ *  \test  A worker timing out a flow of its private table queues the
+ *         forced reassembly packets to its own stream queue.
+ */
+static int FlowMgrTest07 (void)
+{
+    ThreadVars tv;
+    PacketQueue pq;
+    TcpSession ssn;
+    Flow f;
+    struct timeval ts;
+    Packet *p;
+
+    memset(&tv, 0, sizeof(tv));
+    memset(&pq, 0, sizeof(pq));
+    SCMutexInit(&pq.mutex_q, NULL);
+    tv.stream_pq = &pq;
+
+    memset(&ssn, 0, sizeof(ssn));
+    memset(&f, 0, sizeof(f));
+    FLOW_INITIALIZE(&f);
+    ssn.state = TCP_ESTABLISHED;
+    f.protoctx = &ssn;
+    f.proto = IPPROTO_TCP;
+    f.flags |= FLOW_IPV4;
+    TimeGet(&ts);
+    f.lastts.tv_sec = ts.tv_sec - 5000;
+
+    /* reassembly is forced first */
+    FAIL_IF(FlowManagerFlowTimedOut(&f, &ts, &tv) != 0);
+    FAIL_IF_NOT(f.flags & FLOW_TIMEOUT_REASSEMBLY_DONE);
+    FAIL_IF(pq.len != 2);
+    FAIL_IF(SC_ATOMIC_GET(f.use_cnt) != 2);
+
+    /* in use until the worker handled its packets */
+    FAIL_IF(FlowManagerFlowTimedOut(&f, &ts, &tv) != 0);
+    FAIL_IF(pq.len != 2);
+
+    while ((p = PacketDequeue(&pq)) != NULL) {
+        FAIL_IF(p->flow != &f);
+        FlowDeReference(&p->flow);
+        TmqhOutputPacketpool(NULL, p);
+    }
+    FAIL_IF(FlowManagerFlowTimedOut(&f, &ts, &tv) != 1);
+
+    SCMutexDestroy(&pq.mutex_q);
+    FLOW_DESTROY(&f);
+    PASS;
+}
 #endif /* UNITTESTS */
 
 /**
@@ -1410,5 +2050,9 @@ void FlowMgrRegisterTests (void)
                    FlowMgrTest04);
     UtRegisterTest("FlowMgrTest05 -- Test flow Allocations when it reach memcap",
                    FlowMgrTest05);
+    UtRegisterTest("FlowMgrTest06 -- Timeout flows using the timer wheel",
+                   FlowMgrTest06);
+    UtRegisterTest("FlowMgrTest07 -- Timeout a flow from its worker with "
+                   "forced reassembly", FlowMgrTest07);
 #endif /* UNITTESTS */
 }
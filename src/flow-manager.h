@@ -37,6 +37,16 @@ void FlowManagerThreadSpawn(void);
 void FlowDisableFlowManagerThread(void);
 void FlowMgrRegisterTests (void);
 
+void FlowTimerInit(void);
+void FlowTimerDestroy(void);
+void FlowTimerArm(Flow *f);
+void FlowTimerDisarm(Flow *f);
+void FlowTimerRearm(Flow *f);
+
+struct FlowPrivateTable_;
+uint32_t FlowPrivateTableTimeout(ThreadVars *tv, struct FlowPrivateTable_ *ft,
+                                 struct timeval *ts);
+
 /** flow recycler scheduling condition */
 SCCtrlCondT flow_recycler_ctrl_cond;
 SCCtrlMutex flow_recycler_ctrl_mutex;
@@ -0,0 +1,583 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Slab allocator for Flow objects.
+ *
+ * Flows are carved out of large, size aligned slabs of contiguous cache
+ * line aligned objects. Each NUMA node has its own pool of slabs with its
+ * own lock, so threads on different nodes never contend and the flows a
+ * thread gets are on its local node. Slabs are allocated and touched by
+ * the thread that needs them, so with the default first touch policy of
+ * the kernel their memory is placed on that thread's node.
+ *
+ * The memcap is accounted per slab: flow_memuse grows by a slab at a
+ * time. Slabs that become empty are released, except for one per node
+ * that is kept to avoid thrashing.
+ *
+ * Flows that are put back are not reused or released right away, as a
+ * lockless lookup in the flow hash may still be waiting for their lock.
+ * The flow manager retires them in a flow epoch and gives them back to
+ * their slabs once all readers have passed it, see FlowSlabReclaim().
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+
+#include "flow.h"
+#include "flow-private.h"
+#include "flow-util.h"
+#include "flow-hash.h"
+#include "flow-slab.h"
+#include "flow-storage.h"
+
+#include "util-cpu.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+
+static FlowSlabPool flow_slab_pools[FLOW_SLAB_MAX_NODES];
+/** number of nodes, 0 if the slab allocator is not initialized */
+static uint16_t flow_slab_nodes = 0;
+
+/** cpu to node map */
+static uint16_t *flow_slab_cpu_node = NULL;
+static uint32_t flow_slab_cpu_cnt = 0;
+
+static uint32_t flow_slab_size = 0;
+static uint32_t flow_slab_obj_size = 0;
+static uint32_t flow_slab_obj_offset = 0;
+
+#define FLOW_SLAB_OF(f) \
+    ((FlowSlab *)((uintptr_t)(f) & ~((uintptr_t)flow_slab_size - 1)))
+
+/** \internal
+ *  \brief build the cpu to node map from sysfs
+ *
+ *  If the map can't be built all cpus are considered to be on node 0.
+ */
+static void FlowSlabNodeMapInit(void)
+{
+    char path[128];
+    uint32_t cpu;
+    uint16_t node;
+
+    flow_slab_nodes = 1;
+
+    uint16_t ncpus = UtilCpuGetNumProcessorsConfigured();
+    if (ncpus == 0)
+        return;
+
+    flow_slab_cpu_node = SCCalloc(ncpus, sizeof(uint16_t));
+    if (flow_slab_cpu_node == NULL)
+        return;
+    flow_slab_cpu_cnt = ncpus;
+
+    for (cpu = 0; cpu < flow_slab_cpu_cnt; cpu++) {
+        for (node = 0; node < FLOW_SLAB_MAX_NODES; node++) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/node%u",
+                    cpu, (uint32_t)node);
+            if (access(path, F_OK) == 0) {
+                flow_slab_cpu_node[cpu] = node;
+                if (node >= flow_slab_nodes)
+                    flow_slab_nodes = node + 1;
+                break;
+            }
+        }
+    }
+}
+
+/** \brief get the NUMA node of the cpu the calling thread runs on */
+uint16_t FlowSlabCurrentNode(void)
+{
+#ifdef HAVE_SCHED_GETCPU
+    if (flow_slab_cpu_node != NULL) {
+        int cpu = sched_getcpu();
+        if (cpu >= 0 && (uint32_t)cpu < flow_slab_cpu_cnt)
+            return flow_slab_cpu_node[cpu];
+    }
+#endif
+    return 0;
+}
+
+uint16_t FlowSlabNodes(void)
+{
+    return flow_slab_nodes;
+}
+
+int FlowSlabEnabled(void)
+{
+    return (flow_slab_nodes != 0);
+}
+
+/** \brief setup the slab pools
+ *
+ *  Needs to be called after the flow storage has been finalized, as the
+ *  object size includes it.
+ */
+void FlowSlabInit(void)
+{
+    uint16_t n;
+
+    flow_slab_obj_offset = (sizeof(FlowSlab) + CLS - 1) & ~(CLS - 1);
+    flow_slab_obj_size = (sizeof(Flow) + FlowStorageSize() + CLS - 1) & ~(CLS - 1);
+    flow_slab_size = FLOW_SLAB_MIN_SIZE;
+    while (flow_slab_size < flow_slab_obj_offset +
+            (FLOW_SLAB_MIN_OBJS * flow_slab_obj_size))
+        flow_slab_size <<= 1;
+
+    FlowSlabNodeMapInit();
+
+    for (n = 0; n < FLOW_SLAB_MAX_NODES; n++) {
+        memset(&flow_slab_pools[n], 0, sizeof(FlowSlabPool));
+        SCSpinInit(&flow_slab_pools[n].lock, 0);
+    }
+
+    SCLogDebug("flow slabs of %u bytes, %u flows of %u bytes, %u node(s)",
+            flow_slab_size, (flow_slab_size - flow_slab_obj_offset) / flow_slab_obj_size,
+            flow_slab_obj_size, flow_slab_nodes);
+}
+
+/** \internal
+ *  \brief destroy the locks of a list of put flows */
+static void FlowSlabDestroyList(Flow *f)
+{
+    while (f != NULL) {
+        Flow *next = f->lnext;
+        FLOW_DESTROY_LOCKS(f);
+        f = next;
+    }
+}
+
+/** \brief free the slab pools
+ *
+ *  All slabs are freed, including the ones with flows in use. The flow
+ *  engine is shut down, so nothing can reference those anymore.
+ */
+void FlowSlabShutdown(void)
+{
+    uint16_t n;
+
+    if (flow_slab_nodes == 0)
+        return;
+
+    for (n = 0; n < FLOW_SLAB_MAX_NODES; n++) {
+        FlowSlabPool *pool = &flow_slab_pools[n];
+
+        FlowSlabDestroyList(pool->pending);
+        FlowSlabDestroyList(pool->retired);
+
+        FlowSlab *s = pool->slabs;
+        while (s != NULL) {
+            FlowSlab *next = s->list_next;
+            if (s->free_cnt != s->obj_cnt) {
+                SCLogDebug("node %u: slab %p has %u flows in use", n, s,
+                        s->obj_cnt - s->free_cnt);
+            }
+            SCFreeAligned(s);
+            (void) SC_ATOMIC_SUB(flow_memuse, flow_slab_size);
+            s = next;
+        }
+        SCSpinDestroy(&pool->lock);
+        memset(pool, 0, sizeof(FlowSlabPool));
+    }
+
+    if (flow_slab_cpu_node != NULL) {
+        SCFree(flow_slab_cpu_node);
+        flow_slab_cpu_node = NULL;
+    }
+    flow_slab_cpu_cnt = 0;
+    flow_slab_nodes = 0;
+}
+
+/** \brief get the number of free and used flow objects in all slabs */
+void FlowSlabGetObjects(uint32_t *free_objs, uint32_t *used_objs)
+{
+    uint32_t free_cnt = 0, total = 0;
+    uint16_t n;
+
+    for (n = 0; n < flow_slab_nodes; n++) {
+        FlowSlabPool *pool = &flow_slab_pools[n];
+
+        SCSpinLock(&pool->lock);
+        FlowSlab *s;
+        for (s = pool->partial; s != NULL; s = s->next) {
+            free_cnt += s->free_cnt;
+        }
+        total += pool->slab_cnt *
+            ((flow_slab_size - flow_slab_obj_offset) / flow_slab_obj_size);
+        SCSpinUnlock(&pool->lock);
+    }
+
+    if (free_objs != NULL)
+        *free_objs = free_cnt;
+    if (used_objs != NULL)
+        *used_objs = total - free_cnt;
+}
+
+/** \internal
+ *  \brief alloc a new slab within the memcap
+ *
+ *  The memory is touched here, so it's placed on the node of the
+ *  calling thread.
+ */
+static FlowSlab *FlowSlabNew(uint16_t node)
+{
+    uint32_t i;
+
+    if (!(FLOW_CHECK_MEMCAP(flow_slab_size))) {
+        return NULL;
+    }
+    (void) SC_ATOMIC_ADD(flow_memuse, flow_slab_size);
+
+    FlowSlab *s = SCMallocAligned(flow_slab_size, flow_slab_size);
+    if (unlikely(s == NULL)) {
+        (void) SC_ATOMIC_SUB(flow_memuse, flow_slab_size);
+        return NULL;
+    }
+    memset(s, 0, flow_slab_size);
+
+    s->node = node;
+    s->obj_cnt = (flow_slab_size - flow_slab_obj_offset) / flow_slab_obj_size;
+    /* build the free list so that objects are handed out in order */
+    for (i = s->obj_cnt; i > 0; i--) {
+        Flow *f = (Flow *)((uint8_t *)s + flow_slab_obj_offset +
+                (i - 1) * flow_slab_obj_size);
+        f->lnext = s->free;
+        s->free = f;
+    }
+    s->free_cnt = s->obj_cnt;
+    return s;
+}
+
+static inline void FlowSlabPartialAdd(FlowSlabPool *pool, FlowSlab *s)
+{
+    s->prev = NULL;
+    s->next = pool->partial;
+    if (s->next != NULL)
+        s->next->prev = s;
+    pool->partial = s;
+}
+
+static inline void FlowSlabPartialDel(FlowSlabPool *pool, FlowSlab *s)
+{
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else
+        pool->partial = s->next;
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+    s->next = s->prev = NULL;
+}
+
+static inline void FlowSlabListAdd(FlowSlabPool *pool, FlowSlab *s)
+{
+    s->list_prev = NULL;
+    s->list_next = pool->slabs;
+    if (s->list_next != NULL)
+        s->list_next->list_prev = s;
+    pool->slabs = s;
+}
+
+static inline void FlowSlabListDel(FlowSlabPool *pool, FlowSlab *s)
+{
+    if (s->list_prev != NULL)
+        s->list_prev->list_next = s->list_next;
+    else
+        pool->slabs = s->list_next;
+    if (s->list_next != NULL)
+        s->list_next->list_prev = s->list_prev;
+    s->list_next = s->list_prev = NULL;
+}
+
+/** \brief get a zeroed flow object from the pool of 'node'
+ *
+ *  A new slab is allocated if the pool has no free objects and the
+ *  memcap allows it.
+ *
+ *  \retval f the flow object or NULL if the memcap is reached
+ */
+Flow *FlowSlabGet(uint16_t node)
+{
+    if (node >= flow_slab_nodes)
+        node = 0;
+
+    /* objects of existing slabs are already accounted for, but if the
+     * memcap was lowered below our use we stop handing them out so the
+     * engine falls back to its spare and recycled flows */
+    if (!(FLOW_CHECK_MEMCAP(0))) {
+        return NULL;
+    }
+
+    FlowSlabPool *pool = &flow_slab_pools[node];
+    FlowSlab *s;
+
+    SCSpinLock(&pool->lock);
+    s = pool->partial;
+    if (s == NULL) {
+        SCSpinUnlock(&pool->lock);
+
+        s = FlowSlabNew(node);
+        if (s == NULL)
+            return NULL;
+
+        SCSpinLock(&pool->lock);
+        pool->slab_cnt++;
+        pool->empty_cnt++;
+        FlowSlabListAdd(pool, s);
+        FlowSlabPartialAdd(pool, s);
+    }
+
+    Flow *f = s->free;
+    s->free = f->lnext;
+    if (s->free_cnt-- == s->obj_cnt)
+        pool->empty_cnt--;
+    if (s->free_cnt == 0)
+        FlowSlabPartialDel(pool, s);
+    SCSpinUnlock(&pool->lock);
+
+    memset(f, 0, sizeof(Flow) + FlowStorageSize());
+    f->slab = 1;
+    return f;
+}
+
+/** \brief return a flow object to the pool of its slab's node
+ *
+ *  The flow's data must have been freed already. It's only given back
+ *  to its slab by FlowSlabReclaim() after a grace period, until then
+ *  its lock and hash fields stay intact.
+ */
+void FlowSlabPut(Flow *f)
+{
+    /* pools are gone, leave the slab alone */
+    if (flow_slab_nodes == 0)
+        return;
+
+    FlowSlab *s = FLOW_SLAB_OF(f);
+    FlowSlabPool *pool = &flow_slab_pools[s->node];
+
+    SCSpinLock(&pool->lock);
+    f->lnext = pool->pending;
+    pool->pending = f;
+    SCSpinUnlock(&pool->lock);
+}
+
+/** \internal
+ *  \brief give a list of retired flows back to their slabs
+ *
+ *  Slabs that became empty are released, except for one per node.
+ */
+static void FlowSlabRelease(FlowSlabPool *pool, Flow *f)
+{
+    FlowSlab *release = NULL;
+
+    SCSpinLock(&pool->lock);
+    while (f != NULL) {
+        Flow *next = f->lnext;
+        FlowSlab *s = FLOW_SLAB_OF(f);
+
+        FLOW_DESTROY_LOCKS(f);
+
+        f->lnext = s->free;
+        s->free = f;
+        if (s->free_cnt++ == 0)
+            FlowSlabPartialAdd(pool, s);
+        if (s->free_cnt == s->obj_cnt) {
+            /* keep a single empty slab per node around */
+            if (pool->empty_cnt > 0) {
+                FlowSlabPartialDel(pool, s);
+                FlowSlabListDel(pool, s);
+                pool->slab_cnt--;
+                s->next = release;
+                release = s;
+            } else {
+                pool->empty_cnt++;
+            }
+        }
+        f = next;
+    }
+    SCSpinUnlock(&pool->lock);
+
+    while (release != NULL) {
+        FlowSlab *next = release->next;
+        SCFreeAligned(release);
+        (void) SC_ATOMIC_SUB(flow_memuse, flow_slab_size);
+        release = next;
+    }
+}
+
+/** \brief give put flows back to their slabs after a grace period
+ *
+ *  Flows put since the last call are retired in a new flow epoch. The
+ *  ones retired earlier are given back to their slabs once no lockless
+ *  flow hash lookup can reference them anymore, see FlowEpochPassed().
+ *  Slabs that became empty are released at that point as well.
+ *
+ *  Only called by the flow manager, which is the only one changing
+ *  the retired lists.
+ */
+void FlowSlabReclaim(void)
+{
+    uint16_t n;
+
+    for (n = 0; n < flow_slab_nodes; n++) {
+        FlowSlabPool *pool = &flow_slab_pools[n];
+        Flow *done = NULL;
+
+        SCSpinLock(&pool->lock);
+        Flow *retired = pool->retired;
+        uint64_t epoch = pool->retired_epoch;
+        SCSpinUnlock(&pool->lock);
+
+        if (retired != NULL && FlowEpochPassed(epoch) == 1) {
+            done = retired;
+        }
+
+        /* retire the pending flows. They already left the hash, so
+         * taking the epoch after moving them is safe. */
+        SCSpinLock(&pool->lock);
+        if (done != NULL)
+            pool->retired = NULL;
+        if (pool->retired == NULL && pool->pending != NULL) {
+            pool->retired = pool->pending;
+            pool->pending = NULL;
+            pool->retired_epoch = FlowEpochRetire();
+        }
+        SCSpinUnlock(&pool->lock);
+
+        if (done != NULL)
+            FlowSlabRelease(pool, done);
+    }
+}
+
+#ifdef UNITTESTS
+
+SC_ATOMIC_EXTERN(uint64_t, flow_epoch);
+
+/**
+ *  \test flows from a slab are contiguous and aligned, memuse is
+ *        accounted per slab and empty slabs are released.
+ */
+static int FlowSlabTest01(void)
+{
+    Flow *flows[FLOW_SLAB_MIN_OBJS * 3];
+    uint32_t i;
+
+    FlowInitConfig(FLOW_QUIET);
+    uint64_t memuse = SC_ATOMIC_GET(flow_memuse);
+
+    /* use the last node. On single node machines that is the node of the
+     * preallocated flows, so only the slabs we add are checked below. */
+    uint16_t node = FlowSlabNodes() - 1;
+    FlowSlabPool *pool = &flow_slab_pools[node];
+    uint32_t slabs = pool->slab_cnt;
+
+    for (i = 0; i < FLOW_SLAB_MIN_OBJS * 3; i++) {
+        flows[i] = FlowSlabGet(node);
+        FAIL_IF_NULL(flows[i]);
+        FAIL_IF(((uintptr_t)flows[i] & (CLS - 1)) != 0);
+        FAIL_IF(flows[i]->slab != 1);
+        FAIL_IF(FLOW_SLAB_OF(flows[i])->node != node);
+    }
+    /* a new slab hands out its objects in order */
+    uint32_t contiguous = 0;
+    for (i = 1; i < FLOW_SLAB_MIN_OBJS * 3; i++) {
+        if (FLOW_SLAB_OF(flows[i]) == FLOW_SLAB_OF(flows[i - 1]) &&
+            (uint8_t *)flows[i] - (uint8_t *)flows[i - 1] == (ptrdiff_t)flow_slab_obj_size)
+            contiguous++;
+    }
+    FAIL_IF(contiguous < FLOW_SLAB_MIN_OBJS);
+    FAIL_IF(pool->slab_cnt <= slabs);
+    FAIL_IF(SC_ATOMIC_GET(flow_memuse) <
+            memuse + (uint64_t)(pool->slab_cnt - slabs) * flow_slab_size);
+
+    for (i = 0; i < FLOW_SLAB_MIN_OBJS * 3; i++) {
+        FlowSlabPut(flows[i]);
+    }
+    /* put flows are retired first and given back on the next pass */
+    FlowSlabReclaim();
+    FlowSlabReclaim();
+    /* all but one empty slab released */
+    FAIL_IF(pool->empty_cnt != 1);
+    FAIL_IF(SC_ATOMIC_GET(flow_memuse) > memuse + flow_slab_size);
+
+    FlowShutdown();
+    PASS;
+}
+
+/**
+ *  \test put flows are only reused after the lockless readers passed
+ *        their retire epoch, and all slabs are freed at shutdown.
+ */
+static int FlowSlabTest02(void)
+{
+    FlowInitConfig(FLOW_QUIET);
+    uint16_t node = FlowSlabNodes() - 1;
+    FlowSlabPool *pool = &flow_slab_pools[node];
+    FlowEpochReader *r = FlowEpochReaderRegister();
+    FAIL_IF_NULL(r);
+
+    Flow *f = FlowSlabGet(node);
+    FAIL_IF_NULL(f);
+    FLOW_INITIALIZE(f);
+    FlowFree(f);
+    FAIL_IF(pool->pending != f);
+
+    /* reader in a lookup that started before the flow was retired */
+    (void) SC_ATOMIC_SET(r->epoch, SC_ATOMIC_GET(flow_epoch));
+    FlowSlabReclaim();
+    FAIL_IF(pool->retired != f);
+    FAIL_IF(pool->pending != NULL);
+    FlowSlabReclaim();
+    FAIL_IF(pool->retired != f);
+
+    Flow *g = FlowSlabGet(node);
+    FAIL_IF_NULL(g);
+    FAIL_IF(g == f);
+    FLOW_INITIALIZE(g);
+    FlowFree(g);
+
+    /* reader is done: f goes back to its slab, g is retired now */
+    (void) SC_ATOMIC_SET(r->epoch, 0);
+    FlowSlabReclaim();
+    FAIL_IF(pool->retired != g);
+    FAIL_IF(pool->pending != NULL);
+
+    /* fill more than a slab and keep the flows in use */
+    uint32_t obj_cnt = (flow_slab_size - flow_slab_obj_offset) / flow_slab_obj_size;
+    uint32_t i;
+    for (i = 0; i < obj_cnt + 1; i++) {
+        FAIL_IF_NULL(FlowSlabGet(node));
+    }
+
+    FlowEpochReaderDeregister(r);
+    FlowShutdown();
+    /* the hash and all slabs, full ones too, are freed */
+    FAIL_IF(SC_ATOMIC_GET(flow_memuse) != 0);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void FlowSlabRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("FlowSlabTest01", FlowSlabTest01);
+    UtRegisterTest("FlowSlabTest02", FlowSlabTest02);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,86 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Slab allocator for Flow objects with a pool per NUMA node.
+ */
+
+#ifndef __FLOW_SLAB_H__
+#define __FLOW_SLAB_H__
+
+#include "flow.h"
+
+/** minimal size of a slab. Slabs are aligned to their size, so the slab
+ *  of a flow can be found from the flow's address. */
+#define FLOW_SLAB_MIN_SIZE      (64 * 1024)
+/** minimal number of flows in a slab */
+#define FLOW_SLAB_MIN_OBJS      32
+
+#define FLOW_SLAB_MAX_NODES     8
+
+/** slab header, at the start of the slab memory. Protected by the
+ *  lock of the pool of its node. */
+typedef struct FlowSlab_ {
+    /** list of slabs with free objects in the pool */
+    struct FlowSlab_ *next;
+    struct FlowSlab_ *prev;
+
+    /** list of all slabs in the pool */
+    struct FlowSlab_ *list_next;
+    struct FlowSlab_ *list_prev;
+
+    /** free objects in this slab, linked through lnext */
+    Flow *free;
+    uint32_t free_cnt;
+    uint32_t obj_cnt;
+
+    uint16_t node;
+} FlowSlab;
+
+typedef struct FlowSlabPool_ {
+    SCSpinlock lock;
+    /** slabs that have free objects */
+    FlowSlab *partial;
+    uint32_t slab_cnt;
+    /** slabs with no objects in use */
+    uint32_t empty_cnt;
+    /** all slabs of the pool, including full ones */
+    FlowSlab *slabs;
+
+    /** flows put since the last FlowSlabReclaim(), linked through lnext */
+    Flow *pending;
+    /** flows waiting for the lockless readers to pass retired_epoch */
+    Flow *retired;
+    uint64_t retired_epoch;
+} __attribute__((aligned(CLS))) FlowSlabPool;
+
+void FlowSlabInit(void);
+void FlowSlabShutdown(void);
+int FlowSlabEnabled(void);
+uint16_t FlowSlabCurrentNode(void);
+uint16_t FlowSlabNodes(void);
+
+Flow *FlowSlabGet(uint16_t node);
+void FlowSlabPut(Flow *f);
+void FlowSlabReclaim(void);
+void FlowSlabGetObjects(uint32_t *free_objs, uint32_t *used_objs);
+
+void FlowSlabRegisterTests(void);
+
+#endif /* __FLOW_SLAB_H__ */
@@ -261,9 +261,11 @@ static inline Packet *FlowForceReassemblyPseudoPacketSetup(Packet *p,
 static inline Packet *FlowForceReassemblyPseudoPacketGet(int direction,
                                                          Flow *f,
                                                          TcpSession *ssn,
-                                                         int dummy)
+                                                         int dummy,
+                                                         const int wait)
 {
-    PacketPoolWait();
+    if (wait)
+        PacketPoolWait();
     Packet *p = PacketPoolGetPacket();
     if (p == NULL) {
         return NULL;
@@ -345,30 +347,35 @@ int FlowForceReassemblyNeedReassembly(Flow *f, int *server, int *client)
 
 /**
  * \internal
- * \brief Forces reassembly for flow if it needs it.
+ * \brief Get the pseudo packets to force reassembly for a flow.
  *
  *        The function requires flow to be locked beforehand.
  *
  * \param f Pointer to the flow.
  * \param server action required for server: 1 or 2
  * \param client action required for client: 1 or 2
+ * \param wait wait for the packet pool if it's empty
+ * \param packets null terminated array of the packets to handle
  *
- * \retval 0 This flow doesn't need any reassembly processing; 1 otherwise.
+ * \retval -1 This flow doesn't need any reassembly processing
+ * \retval 0 no packets available
+ * \retval 1 packets ready
  */
-int FlowForceReassemblyForFlow(Flow *f, int server, int client)
+static int FlowForceReassemblyPseudoPackets(Flow *f, int server, int client,
+                                            const int wait, Packet **packets)
 {
     Packet *p1 = NULL, *p2 = NULL, *p3 = NULL;
     TcpSession *ssn;
 
     /* looks like we have no flows in this queue */
     if (f == NULL) {
-        return 0;
+        return -1;
     }
 
     /* Get the tcp session for the flow */
     ssn = (TcpSession *)f->protoctx;
     if (ssn == NULL) {
-        return 0;
+        return -1;
     }
 
     /* The packets we use are based on what segments in what direction are
@@ -381,68 +388,68 @@ int FlowForceReassemblyForFlow(Flow *f, int server, int client)
 
     /* insert a pseudo packet in the toserver direction */
     if (client == STREAM_HAS_UNPROCESSED_SEGMENTS_NEED_REASSEMBLY) {
-        p1 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 0);
+        p1 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 0, wait);
         if (p1 == NULL) {
-            goto done;
+            return 0;
         }
         PKT_SET_SRC(p1, PKT_SRC_FFR);
 
         if (server == STREAM_HAS_UNPROCESSED_SEGMENTS_NEED_REASSEMBLY) {
-            p2 = FlowForceReassemblyPseudoPacketGet(0, f, ssn, 0);
+            p2 = FlowForceReassemblyPseudoPacketGet(0, f, ssn, 0, wait);
             if (p2 == NULL) {
                 FlowDeReference(&p1->flow);
                 TmqhOutputPacketpool(NULL, p1);
-                goto done;
+                return 0;
             }
             PKT_SET_SRC(p2, PKT_SRC_FFR);
 
-            p3 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 1);
+            p3 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 1, wait);
             if (p3 == NULL) {
                 FlowDeReference(&p1->flow);
                 TmqhOutputPacketpool(NULL, p1);
                 FlowDeReference(&p2->flow);
                 TmqhOutputPacketpool(NULL, p2);
-                goto done;
+                return 0;
             }
             PKT_SET_SRC(p3, PKT_SRC_FFR);
         } else {
-            p2 = FlowForceReassemblyPseudoPacketGet(0, f, ssn, 1);
+            p2 = FlowForceReassemblyPseudoPacketGet(0, f, ssn, 1, wait);
             if (p2 == NULL) {
                 FlowDeReference(&p1->flow);
                 TmqhOutputPacketpool(NULL, p1);
-                goto done;
+                return 0;
             }
             PKT_SET_SRC(p2, PKT_SRC_FFR);
         }
 
     } else if (client == STREAM_HAS_UNPROCESSED_SEGMENTS_NEED_ONLY_DETECTION) {
         if (server == STREAM_HAS_UNPROCESSED_SEGMENTS_NEED_REASSEMBLY) {
-            p1 = FlowForceReassemblyPseudoPacketGet(0, f, ssn, 0);
+            p1 = FlowForceReassemblyPseudoPacketGet(0, f, ssn, 0, wait);
             if (p1 == NULL) {
-                goto done;
+                return 0;
             }
             PKT_SET_SRC(p1, PKT_SRC_FFR);
 
-            p2 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 1);
+            p2 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 1, wait);
             if (p2 == NULL) {
                 FlowDeReference(&p1->flow);
                 TmqhOutputPacketpool(NULL, p1);
-                goto done;
+                return 0;
             }
             PKT_SET_SRC(p2, PKT_SRC_FFR);
         } else {
-            p1 = FlowForceReassemblyPseudoPacketGet(0, f, ssn, 1);
+            p1 = FlowForceReassemblyPseudoPacketGet(0, f, ssn, 1, wait);
             if (p1 == NULL) {
-                goto done;
+                return 0;
             }
             PKT_SET_SRC(p1, PKT_SRC_FFR);
 
             if (server == STREAM_HAS_UNPROCESSED_SEGMENTS_NEED_ONLY_DETECTION) {
-                p2 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 1);
+                p2 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 1, wait);
                 if (p2 == NULL) {
                     FlowDeReference(&p1->flow);
                     TmqhOutputPacketpool(NULL, p1);
-                    goto done;
+                    return 0;
                 }
                 PKT_SET_SRC(p2, PKT_SRC_FFR);
             }
@@ -450,23 +457,23 @@ int FlowForceReassemblyForFlow(Flow *f, int server, int client)
 
     } else {
         if (server == STREAM_HAS_UNPROCESSED_SEGMENTS_NEED_REASSEMBLY) {
-            p1 = FlowForceReassemblyPseudoPacketGet(0, f, ssn, 0);
+            p1 = FlowForceReassemblyPseudoPacketGet(0, f, ssn, 0, wait);
             if (p1 == NULL) {
-                goto done;
+                return 0;
             }
             PKT_SET_SRC(p1, PKT_SRC_FFR);
 
-            p2 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 1);
+            p2 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 1, wait);
             if (p2 == NULL) {
                 FlowDeReference(&p1->flow);
                 TmqhOutputPacketpool(NULL, p1);
-                goto done;
+                return 0;
             }
             PKT_SET_SRC(p2, PKT_SRC_FFR);
         } else if (server == STREAM_HAS_UNPROCESSED_SEGMENTS_NEED_ONLY_DETECTION) {
-            p1 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 1);
+            p1 = FlowForceReassemblyPseudoPacketGet(1, f, ssn, 1, wait);
             if (p1 == NULL) {
-                goto done;
+                return 0;
             }
             PKT_SET_SRC(p1, PKT_SRC_FFR);
         } else {
@@ -475,29 +482,143 @@ int FlowForceReassemblyForFlow(Flow *f, int server, int client)
         }
     }
 
+    packets[0] = p1;
+    packets[1] = p2 ? p2 : p3;
+    packets[2] = p2 ? p3 : NULL;
+    packets[3] = NULL;
+    return 1;
+}
+
+/** \internal
+ *  \brief return a null terminated array of pseudo packets to the pool */
+static void FlowForceReassemblyPseudoPacketsRelease(Packet **packets)
+{
+    for ( ; *packets != NULL; packets++) {
+        FlowDeReference(&(*packets)->flow);
+        TmqhOutputPacketpool(NULL, *packets);
+    }
+}
+
+/**
+ * \internal
+ * \brief Forces reassembly for flow if it needs it.
+ *
+ *        The function requires flow to be locked beforehand.
+ *
+ * \param f Pointer to the flow.
+ * \param server action required for server: 1 or 2
+ * \param client action required for client: 1 or 2
+ *
+ * \retval 0 This flow doesn't need any reassembly processing; 1 otherwise.
+ */
+int FlowForceReassemblyForFlow(Flow *f, int server, int client)
+{
+    Packet *packets[4];
+
+    int r = FlowForceReassemblyPseudoPackets(f, server, client, 1, packets);
+    if (r == -1)
+        return 0;
+
     /* inject the packet(s) into the appropriate thread */
-    int thread_id = (int)f->thread_id;
-    Packet *packets[4] = { p1, p2 ? p2 : p3, p2 ? p3 : NULL, NULL }; /**< null terminated array of packets */
-    if (unlikely(!(TmThreadsInjectPacketsById(packets, thread_id)))) {
-        FlowDeReference(&p1->flow);
-        TmqhOutputPacketpool(NULL, p1);
-        if (p2) {
-            FlowDeReference(&p2->flow);
-            TmqhOutputPacketpool(NULL, p2);
-        }
-        if (p3) {
-            FlowDeReference(&p3->flow);
-            TmqhOutputPacketpool(NULL, p3);
-        }
+    if (r == 1 &&
+        unlikely(!(TmThreadsInjectPacketsById(packets, (int)f->thread_id)))) {
+        FlowForceReassemblyPseudoPacketsRelease(packets);
     }
 
     /* done, in case of error (no packet) we still tag flow as complete
      * as we're probably resource stress if we couldn't get packets */
-done:
     f->flags |= FLOW_TIMEOUT_REASSEMBLY_DONE;
     return 1;
 }
 
+/**
+ * \brief Forces reassembly for a flow of the calling worker's private
+ *        flow table.
+ *
+ * Unlike FlowForceReassemblyForFlow() this doesn't wait for the packet
+ * pool: it's the worker's own pool, which only gets refilled once the
+ * worker is done with its packets. The pseudo packets are queued to the
+ * worker's own stream queue and handled with its next packet.
+ *
+ *        The function requires flow to be locked beforehand.
+ *
+ * \param tv the worker thread owning the flow
+ *
+ * \retval 1 packets queued or no reassembly needed
+ * \retval 0 no packets available, try again later
+ */
+int FlowForceReassemblyForFlowLocal(ThreadVars *tv, Flow *f,
+                                    int server, int client)
+{
+    Packet *packets[4];
+
+    int r = FlowForceReassemblyPseudoPackets(f, server, client, 0, packets);
+    if (r == -1)
+        return 1;
+    if (r == 0 || tv->stream_pq == NULL) {
+        if (r == 1)
+            FlowForceReassemblyPseudoPacketsRelease(packets);
+        return 0;
+    }
+
+    SCMutexLock(&tv->stream_pq->mutex_q);
+    Packet **pp;
+    for (pp = packets; *pp != NULL; pp++) {
+        PacketEnqueue(tv->stream_pq, *pp);
+    }
+    SCMutexUnlock(&tv->stream_pq->mutex_q);
+
+    f->flags |= FLOW_TIMEOUT_REASSEMBLY_DONE;
+    return 1;
+}
+
+/**
+ * \brief Forces reassembly for the flows of a worker's private flow table
+ *        at shutdown.
+ *
+ * The flows of private tables aren't in the flow hash, so the shutdown
+ * reassembly in FlowForceReassembly() doesn't see them. The owning worker
+ * runs this from its flow timeout loop instead. The pseudo packets are
+ * queued to its stream queue, see FlowForceReassemblyForFlowLocal(). If
+ * the worker's packet pool runs dry the walk stops, and it's continued
+ * by the next call once the queued packets are handled.
+ *
+ * \param tv the worker thread owning the table
+ * \param ft private flow table
+ *
+ * \retval 1 all flows handled
+ * \retval 0 call again after the stream queue has been processed
+ */
+int FlowForceReassemblyForPrivateTable(ThreadVars *tv, FlowPrivateTable *ft)
+{
+    for ( ; ft->shutdown_row < ft->hash_size; ft->shutdown_row++) {
+        Flow *f = ft->hash[ft->shutdown_row].head;
+        for ( ; f != NULL; f = f->hnext) {
+            int server = 0, client = 0;
+
+            FLOWLOCK_WRLOCK(f);
+            if (f->protoctx == NULL || (f->flags & FLOW_TIMEOUT_REASSEMBLY_DONE) ||
+                    FlowForceReassemblyNeedReassembly(f, &server, &client) == 0) {
+                FLOWLOCK_UNLOCK(f);
+                continue;
+            }
+
+            if (FlowForceReassemblyForFlowLocal(tv, f, server, client) == 0) {
+                /* out of packets, retry after the queued ones are back */
+                if (tv->stream_pq != NULL && tv->stream_pq->len > 0) {
+                    FLOWLOCK_UNLOCK(f);
+                    return 0;
+                }
+                /* nothing to wait for, give up on this flow like
+                 * FlowForceReassemblyForFlow() does */
+                f->flags |= FLOW_TIMEOUT_REASSEMBLY_DONE;
+            }
+            FLOWLOCK_UNLOCK(f);
+        }
+    }
+    return 1;
+}
+
 /**
  * \internal
  * \brief Forces reassembly for flows that need it.
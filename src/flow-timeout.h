@@ -25,7 +25,12 @@
 #define __FLOW_TIMEOUT_H__
 
 int FlowForceReassemblyForFlow(Flow *f, int server, int client);
+int FlowForceReassemblyForFlowLocal(ThreadVars *tv, Flow *f,
+                                    int server, int client);
 int FlowForceReassemblyNeedReassembly(Flow *f, int *server, int *client);
+struct FlowPrivateTable_;
+int FlowForceReassemblyForPrivateTable(ThreadVars *tv,
+                                       struct FlowPrivateTable_ *ft);
 void FlowForceReassembly(void);
 void FlowForceReassemblySetup(int detect_disabled);
 
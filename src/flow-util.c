@@ -35,14 +35,18 @@
 #include "util-var.h"
 #include "util-debug.h"
 #include "flow-storage.h"
+#include "flow-slab.h"
 
 #include "detect.h"
 #include "detect-engine-state.h"
 
 /** \brief allocate a flow
  *
- *  We check against the memuse counter. If it passes that check we increment
- *  the counter first, then we try to alloc.
+ *  When the flow engine is initialized the flow comes from the slab pool
+ *  of the NUMA node we run on, which does the memcap accounting per slab.
+ *
+ *  Otherwise we check against the memuse counter. If it passes that check
+ *  we increment the counter first, then we try to alloc.
  *
  *  \retval f the flow or NULL on out of memory
  */
@@ -51,6 +55,15 @@ Flow *FlowAlloc(void)
     Flow *f;
     size_t size = sizeof(Flow) + FlowStorageSize();
 
+    if (FlowSlabEnabled()) {
+        f = FlowSlabGet(FlowSlabCurrentNode());
+        if (f == NULL)
+            return NULL;
+
+        FLOW_INITIALIZE(f);
+        return f;
+    }
+
     if (!(FLOW_CHECK_MEMCAP(size))) {
         return NULL;
     }
@@ -76,6 +89,14 @@ Flow *FlowAlloc(void)
  */
 void FlowFree(Flow *f)
 {
+    if (f->slab) {
+        /* a lockless hash lookup may still be waiting for the lock, so
+         * it's only destroyed when the slab takes the flow back */
+        FLOW_DESTROY_DATA(f);
+        FlowSlabPut(f);
+        return;
+    }
+
     FLOW_DESTROY(f);
     SCFree(f);
 
@@ -114,16 +114,28 @@
         RESET_COUNTERS((f)); \
     } while(0)
 
-#define FLOW_DESTROY(f) do { \
+/** \brief free the flow's data, but leave the lock and atomics alone */
+#define FLOW_DESTROY_DATA(f) do { \
         FlowCleanupAppLayer((f)); \
-        SC_ATOMIC_DESTROY((f)->flow_state); \
-        SC_ATOMIC_DESTROY((f)->use_cnt); \
-        \
-        FLOWLOCK_DESTROY((f)); \
         if ((f)->de_state != NULL) { \
             DetectEngineStateFlowFree((f)->de_state); \
+            (f)->de_state = NULL; \
         } \
         GenericVarFree((f)->flowvar); \
+        (f)->flowvar = NULL; \
+    } while(0)
+
+/** \brief destroy the flow's lock and atomics */
+#define FLOW_DESTROY_LOCKS(f) do { \
+        SC_ATOMIC_DESTROY((f)->flow_state); \
+        SC_ATOMIC_DESTROY((f)->use_cnt); \
+        \
+        FLOWLOCK_DESTROY((f)); \
+    } while(0)
+
+#define FLOW_DESTROY(f) do { \
+        FLOW_DESTROY_DATA((f)); \
+        FLOW_DESTROY_LOCKS((f)); \
     } while(0)
 
 /** \brief check if a memory alloc would fit in the memcap
@@ -43,6 +43,9 @@
 #include "util-validate.h"
 
 #include "flow-util.h"
+#include "flow-hash.h"
+#include "flow-manager.h"
+#include "flow-timeout.h"
 
 typedef DetectEngineThreadCtx *DetectEngineThreadCtxPtr;
 
@@ -60,6 +63,9 @@ typedef struct FlowWorkerThreadData_ {
 
     PacketQueue pq;
 
+    /** private flow table, NULL if the global flow hash is used */
+    FlowPrivateTable *ft;
+
 } FlowWorkerThreadData;
 
 /** \brief handle flow for packet
@@ -94,6 +100,19 @@ static TmEcode FlowWorkerThreadInit(ThreadVars *tv, void *initdata, void **data)
         return TM_ECODE_FAILED;
     }
 
+    if (FlowPrivateTablesEnabled()) {
+        fw->ft = FlowPrivateTableAlloc(tv);
+        if (fw->ft == NULL) {
+            DecodeThreadVarsFree(tv, fw->dtv);
+            SC_ATOMIC_DESTROY(fw->detect_thread);
+            SCFree(fw);
+            return TM_ECODE_FAILED;
+        }
+    } else {
+        /* lockless lookups in the global flow hash */
+        fw->dtv->flow_reader = FlowEpochReaderRegister();
+    }
+
     /* setup TCP */
     BUG_ON(StreamTcpThreadInit(tv, NULL, &fw->stream_thread_ptr) != TM_ECODE_OK);
 
@@ -123,8 +142,14 @@ static TmEcode FlowWorkerThreadDeinit(ThreadVars *tv, void *data)
 {
     FlowWorkerThreadData *fw = data;
 
+    FlowEpochReaderDeregister(fw->dtv->flow_reader);
+    fw->dtv->flow_reader = NULL;
     DecodeThreadVarsFree(tv, fw->dtv);
 
+    /* the flows were handed to the recycler at shutdown, see
+     * FlowWorkerPrivateTableShutdown() */
+    FlowPrivateTableFree(fw->ft);
+
     /* free TCP */
     StreamTcpThreadDeinit(tv, (void *)fw->stream_thread);
 
@@ -165,7 +190,17 @@ TmEcode FlowWorker(ThreadVars *tv, Packet *p, void *data, PacketQueue *preq, Pac
     if (p->flags & PKT_WANTS_FLOW) {
         FLOWWORKER_PROFILING_START(p, PROFILE_FLOWWORKER_FLOW);
 
-        FlowHandlePacket(tv, fw->dtv, p);
+        if (fw->ft != NULL) {
+            /* time out our own flows once per packet time second */
+            if ((uint32_t)p->ts.tv_sec != fw->ft->timeout_ts &&
+                    !(PKT_IS_PSEUDOPKT(p)))
+            {
+                FlowPrivateTableTimeout(tv, fw->ft, &p->ts);
+            }
+            FlowHandlePacketPrivate(tv, fw->dtv, fw->ft, p);
+        } else {
+            FlowHandlePacket(tv, fw->dtv, p);
+        }
         if (likely(p->flow != NULL)) {
             DEBUG_ASSERT_FLOW_LOCKED(p->flow);
             if (FlowUpdate(p) == TM_ECODE_DONE) {
@@ -250,6 +285,32 @@ TmEcode FlowWorker(ThreadVars *tv, Packet *p, void *data, PacketQueue *preq, Pac
     return TM_ECODE_OK;
 }
 
+/** \brief handle the flows of the worker's private flow table at shutdown
+ *
+ *  Forces reassembly for the flows, and once the resulting pseudo packets
+ *  are processed, hands them to the flow recycler. Called by the worker
+ *  thread from its flow timeout loop, while the flow recycler still runs.
+ *
+ *  \retval 1 done, or no private flow table
+ *  \retval 0 call again after the stream queue has been processed
+ */
+int FlowWorkerPrivateTableShutdown(ThreadVars *tv, void *flow_worker)
+{
+    FlowWorkerThreadData *fw = flow_worker;
+
+    if (fw == NULL || fw->ft == NULL)
+        return 1;
+
+    if (FlowForceReassemblyForPrivateTable(tv, fw->ft) == 0)
+        return 0;
+    /* the pseudo packets still hold references to the flows */
+    if (tv->stream_pq != NULL && tv->stream_pq->len > 0)
+        return 0;
+
+    FlowPrivateTableRecycle(fw->ft);
+    return 1;
+}
+
 void FlowWorkerReplaceDetectCtx(void *flow_worker, void *detect_ctx)
 {
     FlowWorkerThreadData *fw = flow_worker;
@@ -43,6 +43,7 @@
 #include "flow-timeout.h"
 #include "flow-manager.h"
 #include "flow-storage.h"
+#include "flow-slab.h"
 
 #include "stream-tcp-private.h"
 #include "stream-tcp-reassemble.h"
@@ -55,6 +56,7 @@
 
 #include "util-debug.h"
 #include "util-privs.h"
+#include "util-cpu.h"
 
 #include "detect.h"
 #include "detect-engine-state.h"
@@ -71,6 +73,39 @@
 
 #define FLOW_DEFAULT_PREALLOC    10000
 
+/* Compile time checks of the Flow layout, see the Flow struct docs. The
+ * lockless lookup in flow-hash.c compares the members of the first cache
+ * line and then takes the flow lock. The build fails if a member moves
+ * out of its group. */
+#define FLOW_LAYOUT_CAT_(a, b) a##b
+#define FLOW_LAYOUT_CAT(a, b) FLOW_LAYOUT_CAT_(a, b)
+#define FLOW_LAYOUT_ASSERT(expr) \
+    typedef char FLOW_LAYOUT_CAT(flow_layout_assert_, __LINE__)[(expr) ? 1 : -1]
+#define FLOW_MEMBER_END(member) \
+    (offsetof(Flow, member) + sizeof(((Flow *)0)->member))
+
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(src) <= CLS);
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(dst) <= CLS);
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(sp) <= CLS);
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(dp) <= CLS);
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(proto) <= CLS);
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(recursion_level) <= CLS);
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(vlan_id) <= CLS);
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(flags) <= CLS);
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(fb) <= CLS);
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(hnext) <= CLS);
+#ifdef FLOWLOCK_RWLOCK
+/* the rwlock is larger than the mutex, with it the per packet members
+ * run into the fourth line */
+FLOW_LAYOUT_ASSERT(offsetof(Flow, r) == CLS);
+#else
+/* the lock starts the second line, the per packet members end within the
+ * third one and the cold part starts at the fourth */
+FLOW_LAYOUT_ASSERT(offsetof(Flow, m) == CLS);
+FLOW_LAYOUT_ASSERT(FLOW_MEMBER_END(sgh_toserver) <= 3 * CLS);
+FLOW_LAYOUT_ASSERT(offsetof(Flow, tenant_id) >= 3 * CLS);
+#endif
+
 /** atomic int that is used when freeing a flow from the hash. In this
  *  case we walk the hash to find a flow to free. This var records where
  *  we left off in the hash. Without this only the top rows of the hash
@@ -82,6 +117,10 @@ SC_ATOMIC_DECLARE(unsigned int, flow_prune_idx);
 /** atomic flags */
 SC_ATOMIC_DECLARE(unsigned int, flow_flags);
 
+/** epoch for lockless flow hash readers, see FlowEpochRetire(). Starts
+ *  at 1 as a reader epoch of 0 means the reader is idle. */
+SC_ATOMIC_DECLARE(uint64_t, flow_epoch);
+
 void FlowRegisterTests(void);
 void FlowInitFlowProto();
 int FlowSetProtoFreeFunc(uint8_t, void (*Free)(void *));
@@ -100,10 +139,20 @@ void FlowCleanupAppLayer(Flow *f)
     return;
 }
 
+/** queue of flows taken from the spare queue to be freed once all
+ *  lockless hash readers are done with them. Such a reader may still
+ *  hold a pointer to a flow that just left the hash. All flows in the
+ *  queue were retired in flow_retired_epoch. Only used by the flow
+ *  manager. */
+static FlowQueue flow_retired_q;
+static uint64_t flow_retired_epoch = 0;
+
 /** \brief Make sure we have enough spare flows. 
  *
  *  Enforce the prealloc parameter, so keep at least prealloc flows in the
- *  spare queue and free flows going over the limit.
+ *  spare queue and free flows going over the limit. Flows over the limit
+ *  are retired first and only freed when FlowEpochPassed() says no
+ *  lockless reader can reference them anymore, see flow_retired_q.
  *
  *  \retval 1 if the queue was properly updated (or if it already was in good shape)
  *  \retval 0 otherwise.
@@ -112,6 +161,19 @@ int FlowUpdateSpareFlows(void)
 {
     SCEnter();
     uint32_t toalloc = 0, tofree = 0, len;
+    Flow *rf;
+
+    /* flows put back in the slabs are handed out again once the
+     * lockless readers are done with them */
+    FlowSlabReclaim();
+
+    /* free the retired batch if the readers moved on, otherwise
+     * retry on the next call */
+    if (flow_retired_q.len > 0 && FlowEpochPassed(flow_retired_epoch) == 1) {
+        while ((rf = FlowDequeue(&flow_retired_q))) {
+            FlowFree(rf);
+        }
+    }
 
     FQLOCK_LOCK(&flow_spare_q);
     len = flow_spare_q.len;
@@ -128,7 +190,8 @@ int FlowUpdateSpareFlows(void)
 
             FlowEnqueue(&flow_spare_q,f);
         }
-    } else if (len > flow_config.prealloc) {
+    } else if (len > flow_config.prealloc && flow_retired_q.len == 0) {
+        /* only one retired batch at a time */
         tofree = len - flow_config.prealloc;
 
         uint32_t i;
@@ -136,10 +199,12 @@ int FlowUpdateSpareFlows(void)
             /* FlowDequeue locks the queue */
             Flow *f = FlowDequeue(&flow_spare_q);
             if (f == NULL)
-                return 1;
+                break;
 
-            FlowFree(f);
+            FlowEnqueue(&flow_retired_q, f);
         }
+        if (flow_retired_q.len > 0)
+            flow_retired_epoch = FlowEpochRetire();
     }
 
     return 1;
@@ -302,6 +367,177 @@ void FlowHandlePacket(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p)
     return;
 }
 
+/** \brief Entry point for packet flow handling with private flow tables
+ *
+ *  Like FlowHandlePacket(), but the flow is looked up in (and added to)
+ *  the worker's private table.
+ */
+void FlowHandlePacketPrivate(ThreadVars *tv, DecodeThreadVars *dtv,
+        FlowPrivateTable *ft, Packet *p)
+{
+    Flow *f = FlowGetFlowFromPrivateTable(tv, dtv, ft, p, &p->flow);
+    if (f == NULL)
+        return;
+
+    /* set the flow in the packet */
+    p->flags |= PKT_HAS_FLOW;
+    return;
+}
+
+/** set by the runmode if the workers use private flow tables */
+static int flow_private_tables = 0;
+/** hash size of each of the private tables */
+static uint32_t flow_private_hash_size = 0;
+
+/**
+ *  \brief Make the flow workers use private flow tables
+ *
+ *  Only to be used by runmodes that guarantee that all packets of a flow
+ *  are handled by the same worker thread. Must be called after
+ *  FlowInitConfig() and before the worker threads are created.
+ *
+ *  The size of the tables is set by "flow.private-hash-size", defaulting
+ *  to the global hash size spread over the online cpus.
+ */
+void FlowPrivateTablesEnable(void)
+{
+    char *conf_val;
+    uint32_t configval = 0;
+
+    flow_private_hash_size = flow_config.hash_size / UtilCpuGetNumProcessorsOnline();
+    if ((ConfGet("flow.private-hash-size", &conf_val)) == 1)
+    {
+        if (ByteExtractStringUint32(&configval, 10, strlen(conf_val),
+                                    conf_val) > 0) {
+            flow_private_hash_size = configval;
+        }
+    }
+    if (flow_private_hash_size < FLOW_PRIVATE_MIN_HASH_SIZE)
+        flow_private_hash_size = FLOW_PRIVATE_MIN_HASH_SIZE;
+
+    if (FlowOwnerMapInit(flow_config.hash_size) < 0) {
+        SCLogError(SC_ERR_FATAL, "Fatal error encountered in "
+                "FlowPrivateTablesEnable. Exiting...");
+        exit(EXIT_FAILURE);
+    }
+
+    flow_private_tables = 1;
+    SCLogConfig("flow workers use private flow tables of %"PRIu32" buckets",
+            flow_private_hash_size);
+}
+
+int FlowPrivateTablesEnabled(void)
+{
+    return flow_private_tables;
+}
+
+/**
+ *  \brief Alloc a private flow table for a worker thread
+ *
+ *  \retval ft table or NULL on error (memcap reached or alloc failure)
+ */
+FlowPrivateTable *FlowPrivateTableAlloc(ThreadVars *tv)
+{
+    const uint64_t hash_size = (uint64_t)flow_private_hash_size * sizeof(FlowBucket);
+    if (!(FLOW_CHECK_MEMCAP(hash_size))) {
+        SCLogError(SC_ERR_FLOW_INIT, "allocating private flow table failed: "
+                "max flow memcap reached. Memcap %"PRIu64", Memuse %"PRIu64".",
+                flow_config.memcap, (uint64_t)SC_ATOMIC_GET(flow_memuse));
+        return NULL;
+    }
+
+    FlowPrivateTable *ft = SCCalloc(1, sizeof(*ft));
+    if (unlikely(ft == NULL))
+        return NULL;
+
+    ft->hash = SCMallocAligned(hash_size, CLS);
+    if (unlikely(ft->hash == NULL)) {
+        SCFree(ft);
+        return NULL;
+    }
+    memset(ft->hash, 0, hash_size);
+
+    uint32_t i;
+    for (i = 0; i < flow_private_hash_size; i++) {
+        FBLOCK_INIT(&ft->hash[i]);
+        SC_ATOMIC_INIT(ft->hash[i].seq);
+        SC_ATOMIC_INIT(ft->hash[i].next_ts);
+    }
+    ft->hash_size = flow_private_hash_size;
+    ft->thread_id = (FlowThreadId)tv->id;
+
+    (void) SC_ATOMIC_ADD(flow_memuse, hash_size);
+    return ft;
+}
+
+/**
+ *  \brief Hand all flows of a private flow table to the flow recycler
+ *
+ *  Used at shutdown by the owning worker, after the flows got their
+ *  forced reassembly, see FlowForceReassemblyForPrivateTable(). The
+ *  recycler logs and cleans them up.
+ */
+void FlowPrivateTableRecycle(FlowPrivateTable *ft)
+{
+    uint32_t u;
+    for (u = 0; u < ft->hash_size; u++) {
+        FlowBucket *fb = &ft->hash[u];
+        Flow *f;
+        while ((f = fb->tail) != NULL) {
+            FLOWLOCK_WRLOCK(f);
+            FlowBucketRemove(fb, f);
+
+            int state = SC_ATOMIC_GET(f->flow_state);
+            if (state == FLOW_STATE_NEW)
+                f->flow_end_flags |= FLOW_END_FLAG_STATE_NEW;
+            else if (state == FLOW_STATE_ESTABLISHED)
+                f->flow_end_flags |= FLOW_END_FLAG_STATE_ESTABLISHED;
+            else if (state == FLOW_STATE_CLOSED)
+                f->flow_end_flags |= FLOW_END_FLAG_STATE_CLOSED;
+            else if (state == FLOW_STATE_LOCAL_BYPASSED ||
+                     state == FLOW_STATE_CAPTURE_BYPASSED)
+                f->flow_end_flags |= FLOW_END_FLAG_STATE_BYPASSED;
+            f->flow_end_flags |= FLOW_END_FLAG_SHUTDOWN;
+            FLOWLOCK_UNLOCK(f);
+
+            FlowEnqueue(&flow_recycle_q, f);
+        }
+    }
+}
+
+/**
+ *  \brief Free a private flow table
+ *
+ *  Flows still in the table are handed to the flow recycler for logging
+ *  and cleanup. Private spare flows go back to the global spare queue.
+ */
+void FlowPrivateTableFree(FlowPrivateTable *ft)
+{
+    if (ft == NULL)
+        return;
+
+    FlowPrivateTableRecycle(ft);
+
+    uint32_t u;
+    for (u = 0; u < ft->hash_size; u++) {
+        FlowBucket *fb = &ft->hash[u];
+        FBLOCK_DESTROY(fb);
+        SC_ATOMIC_DESTROY(fb->seq);
+        SC_ATOMIC_DESTROY(fb->next_ts);
+    }
+
+    while (ft->spare != NULL) {
+        Flow *f = ft->spare;
+        ft->spare = f->lnext;
+        f->lnext = NULL;
+        FlowEnqueue(&flow_spare_q, f);
+    }
+
+    SCFreeAligned(ft->hash);
+    (void) SC_ATOMIC_SUB(flow_memuse, (uint64_t)ft->hash_size * sizeof(FlowBucket));
+    SCFree(ft);
+}
+
 /** \brief initialize the configuration
  *  \warning Not thread safe */
 void FlowInitConfig(char quiet)
@@ -312,8 +548,12 @@ void FlowInitConfig(char quiet)
     SC_ATOMIC_INIT(flow_flags);
     SC_ATOMIC_INIT(flow_memuse);
     SC_ATOMIC_INIT(flow_prune_idx);
+    SC_ATOMIC_INIT(flow_epoch);
+    (void) SC_ATOMIC_SET(flow_epoch, 1);
     FlowQueueInit(&flow_spare_q);
     FlowQueueInit(&flow_recycle_q);
+    FlowQueueInit(&flow_retired_q);
+    FlowTimerInit();
 
 #ifndef AFLFUZZ_NO_RANDOM
     unsigned int seed = RandomTimePreseed();
@@ -392,6 +632,7 @@ void FlowInitConfig(char quiet)
     uint32_t i = 0;
     for (i = 0; i < flow_config.hash_size; i++) {
         FBLOCK_INIT(&flow_hash[i]);
+        SC_ATOMIC_INIT(flow_hash[i].seq);
         SC_ATOMIC_INIT(flow_hash[i].next_ts);
     }
     (void) SC_ATOMIC_ADD(flow_memuse, (flow_config.hash_size * sizeof(FlowBucket)));
@@ -403,6 +644,8 @@ void FlowInitConfig(char quiet)
                   (uintmax_t)sizeof(FlowBucket));
     }
 
+    FlowSlabInit();
+
     /* pre allocate flows */
     for (i = 0; i < flow_config.prealloc; i++) {
         if (!(FLOW_CHECK_MEMCAP(sizeof(Flow) + FlowStorageSize()))) {
@@ -431,9 +674,103 @@ void FlowInitConfig(char quiet)
 
     FlowInitFlowProto();
 
+#ifdef DEBUG
+    FlowLayoutReport();
+#endif
     return;
 }
 
+/** where a Flow member is expected to be, see the Flow struct docs */
+enum FlowLayoutClass {
+    FLOW_LAYOUT_LOOKUP,     /**< first cache line */
+    FLOW_LAYOUT_PACKET,     /**< after lookup, before the cold members */
+    FLOW_LAYOUT_COLD,
+};
+
+typedef struct FlowLayoutField_ {
+    const char *name;
+    size_t offset;
+    size_t size;
+    enum FlowLayoutClass class;
+} FlowLayoutField;
+
+#define FLOW_LAYOUT_FIELD(field, class) \
+    { #field, offsetof(Flow, field), sizeof(((Flow *)0)->field), (class) }
+
+static const FlowLayoutField flow_layout[] = {
+    FLOW_LAYOUT_FIELD(src, FLOW_LAYOUT_LOOKUP),
+    FLOW_LAYOUT_FIELD(dst, FLOW_LAYOUT_LOOKUP),
+    FLOW_LAYOUT_FIELD(sp, FLOW_LAYOUT_LOOKUP),
+    FLOW_LAYOUT_FIELD(dp, FLOW_LAYOUT_LOOKUP),
+    FLOW_LAYOUT_FIELD(proto, FLOW_LAYOUT_LOOKUP),
+    FLOW_LAYOUT_FIELD(recursion_level, FLOW_LAYOUT_LOOKUP),
+    FLOW_LAYOUT_FIELD(vlan_id, FLOW_LAYOUT_LOOKUP),
+    FLOW_LAYOUT_FIELD(flags, FLOW_LAYOUT_LOOKUP),
+    FLOW_LAYOUT_FIELD(fb, FLOW_LAYOUT_LOOKUP),
+    FLOW_LAYOUT_FIELD(hnext, FLOW_LAYOUT_LOOKUP),
+
+#ifdef FLOWLOCK_RWLOCK
+    FLOW_LAYOUT_FIELD(r, FLOW_LAYOUT_PACKET),
+#else
+    FLOW_LAYOUT_FIELD(m, FLOW_LAYOUT_PACKET),
+#endif
+    FLOW_LAYOUT_FIELD(lastts, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(flow_hash, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(thread_id, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(protomap, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(flow_end_flags, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(protoctx, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(todstpktcnt, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(tosrcpktcnt, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(todstbytecnt, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(tosrcbytecnt, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(alproto, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(alproto_ts, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(alproto_tc, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(sgh_toclient, FLOW_LAYOUT_PACKET),
+    FLOW_LAYOUT_FIELD(sgh_toserver, FLOW_LAYOUT_PACKET),
+
+    FLOW_LAYOUT_FIELD(tenant_id, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(probing_parser_toserver_alproto_masks, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(probing_parser_toclient_alproto_masks, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(data_al_so_far, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(de_ctx_id, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(detect_alversion, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(slab, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(timer_slot, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(alparser, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(alstate, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(de_state, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(flowvar, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(hprev, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(tnext, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(tprev, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(lnext, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(lprev, FLOW_LAYOUT_COLD),
+    FLOW_LAYOUT_FIELD(startts, FLOW_LAYOUT_COLD),
+};
+
+/** \brief log the layout of the Flow struct, pahole style
+ *
+ *  Lists the members with their offset, size and cache line.
+ */
+void FlowLayoutReport(void)
+{
+    static const char *class_names[] = { "lookup", "packet", "cold" };
+    size_t i;
+
+    SCLogDebug("struct Flow_: size %"PRIuMAX", %"PRIuMAX" cache lines, "
+            "%u bytes flow storage", (uintmax_t)sizeof(Flow),
+            (uintmax_t)((sizeof(Flow) + CLS - 1) / CLS), FlowStorageSize());
+
+    for (i = 0; i < sizeof(flow_layout) / sizeof(flow_layout[0]); i++) {
+        const FlowLayoutField *fl = &flow_layout[i];
+        SCLogDebug("    %-40s offset %4"PRIuMAX" size %3"PRIuMAX" line %2"PRIuMAX" %s",
+                fl->name, (uintmax_t)fl->offset, (uintmax_t)fl->size,
+                (uintmax_t)(fl->offset / CLS), class_names[fl->class]);
+    }
+}
+
 /** \brief print some flow stats
  *  \warning Not thread safe */
 static void FlowPrintStats (void)
@@ -457,6 +794,9 @@ void FlowShutdown(void)
     while((f = FlowDequeue(&flow_recycle_q))) {
         FlowFree(f);
     }
+    while((f = FlowDequeue(&flow_retired_q))) {
+        FlowFree(f);
+    }
 
     /* clear and free the hash */
     if (flow_hash != NULL) {
@@ -475,6 +815,7 @@ void FlowShutdown(void)
             }
 
             FBLOCK_DESTROY(&flow_hash[u]);
+            SC_ATOMIC_DESTROY(flow_hash[u].seq);
             SC_ATOMIC_DESTROY(flow_hash[u].next_ts);
         }
         SCFreeAligned(flow_hash);
@@ -483,8 +824,14 @@ void FlowShutdown(void)
     (void) SC_ATOMIC_SUB(flow_memuse, flow_config.hash_size * sizeof(FlowBucket));
     FlowQueueDestroy(&flow_spare_q);
     FlowQueueDestroy(&flow_recycle_q);
+    FlowQueueDestroy(&flow_retired_q);
+    FlowTimerDestroy();
+    FlowOwnerMapFree();
+    FlowSlabShutdown();
+    flow_private_tables = 0;
 
     SC_ATOMIC_DESTROY(flow_prune_idx);
+    SC_ATOMIC_DESTROY(flow_epoch);
     SC_ATOMIC_DESTROY(flow_memuse);
     SC_ATOMIC_DESTROY(flow_flags);
     return;
@@ -881,6 +1228,9 @@ void FlowUpdateState(Flow *f, enum FlowState s)
     /* set the state */
     SC_ATOMIC_SET(f->flow_state, s);
 
+    /* state determines the timeout, so update the timer */
+    FlowTimerRearm(f);
+
     if (f->fb) {
         /* and reset the flow buckup next_ts value so that the flow manager
          * has to revisit this row */
@@ -888,6 +1238,106 @@ void FlowUpdateState(Flow *f, enum FlowState s)
     }
 }
 
+/** flow storage id of the bypass info */
+static int flow_bypass_info_id = -1;
+
+static void FlowBypassInfoFree(void *x)
+{
+    FlowBypassInfo *fc = (FlowBypassInfo *)x;
+    if (fc == NULL)
+        return;
+
+    if (fc->BypassFree && fc->bypass_data) {
+        fc->BypassFree(fc->bypass_data);
+    }
+    SCFree(fc);
+    (void) SC_ATOMIC_SUB(flow_memuse, sizeof(FlowBypassInfo));
+}
+
+/** \brief register the flow storage of the bypass info. Must be called
+ *         before the storage is finalized. */
+void FlowBypassInfoRegister(void)
+{
+    flow_bypass_info_id = FlowStorageRegister("bypass_counters", sizeof(void *),
+            NULL, FlowBypassInfoFree);
+    if (flow_bypass_info_id == -1) {
+        SCLogError(SC_ERR_FLOW_INIT, "Can't initiate flow storage for bypass");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/** \brief get the bypass info of a flow, NULL if it wasn't bypassed */
+FlowBypassInfo *FlowGetBypassInfo(Flow *f)
+{
+    if (flow_bypass_info_id == -1)
+        return NULL;
+    return (FlowBypassInfo *)FlowGetStorageById(f, flow_bypass_info_id);
+}
+
+/**
+ *  \brief set up the bypass info of a flow bypassed by the capture method
+ *
+ *  The flow counters are recorded so the packets seen after the bypass
+ *  can be told apart in the flow records. Locally bypassed flows don't
+ *  get one, we still see and count all their packets. The info counts
+ *  against the flow memcap.
+ *
+ *  \param f locked flow
+ *
+ *  \retval fc bypass info or NULL if it couldn't be allocated or the
+ *          memcap was reached
+ */
+FlowBypassInfo *FlowSetupBypassInfo(Flow *f)
+{
+    if (flow_bypass_info_id == -1)
+        return NULL;
+
+    FlowBypassInfo *fc = FlowGetStorageById(f, flow_bypass_info_id);
+    if (fc != NULL)
+        return fc;
+
+    if (!(FLOW_CHECK_MEMCAP(sizeof(FlowBypassInfo))))
+        return NULL;
+
+    fc = SCCalloc(1, sizeof(*fc));
+    if (unlikely(fc == NULL))
+        return NULL;
+    (void) SC_ATOMIC_ADD(flow_memuse, sizeof(FlowBypassInfo));
+
+    fc->todstpktcnt_start = f->todstpktcnt;
+    fc->tosrcpktcnt_start = f->tosrcpktcnt;
+    fc->todstbytecnt_start = f->todstbytecnt;
+    fc->tosrcbytecnt_start = f->tosrcbytecnt;
+
+    FlowSetStorageById(f, flow_bypass_info_id, fc);
+    return fc;
+}
+
+/**
+ *  \brief check with the capture method if a bypassed flow is active
+ *
+ *  Called by the flow manager for flows bypassed in the capture method,
+ *  as those don't update the flow's lastts.
+ *
+ *  \param f locked flow
+ *  \param ts current time
+ *
+ *  \retval 1 flow is still active, lastts was updated
+ *  \retval 0 flow is not active or can't be checked
+ */
+int FlowBypassUpdate(Flow *f, struct timeval *ts)
+{
+    FlowBypassInfo *fc = FlowGetBypassInfo(f);
+    if (fc == NULL || fc->BypassUpdate == NULL)
+        return 0;
+
+    if (fc->BypassUpdate(f, fc->bypass_data, ts->tv_sec) == 1) {
+        COPY_TIMESTAMP(ts, &f->lastts);
+        return 1;
+    }
+    return 0;
+}
+
 /************************************Unittests*******************************/
 
 #ifdef UNITTESTS
@@ -1097,6 +1547,268 @@ static int FlowTest09 (void)
     return result;
 }
 
+/**
+ *  \test  Test the bucket lookup slots: flows fill the slots, overflow
+ *         to the list only and removal clears both.
+ */
+static int FlowTest10 (void)
+{
+    FlowBucket fb;
+    Flow f[FLOW_BUCKET_SLOTS + 1];
+    int i;
+
+    memset(&fb, 0, sizeof(fb));
+    memset(&f, 0, sizeof(f));
+    FBLOCK_INIT(&fb);
+    SC_ATOMIC_INIT(fb.seq);
+
+    FBLOCK_LOCK(&fb);
+    for (i = 0; i < FLOW_BUCKET_SLOTS + 1; i++) {
+        f[i].flow_hash = 100 + i;
+        f[i].fb = &fb;
+        if (fb.tail != NULL) {
+            fb.tail->hnext = &f[i];
+            f[i].hprev = fb.tail;
+        } else {
+            fb.head = &f[i];
+        }
+        fb.tail = &f[i];
+        FlowBucketSlotAdd(&fb, &f[i]);
+    }
+
+    /* all slots taken by the first flows, the last is list only */
+    for (i = 0; i < FLOW_BUCKET_SLOTS; i++) {
+        FAIL_IF(fb.slot[i] != &f[i]);
+        FAIL_IF(fb.tag[i] != (uint32_t)(100 + i));
+    }
+    FAIL_IF(SC_ATOMIC_GET(fb.seq) & 1);
+
+    FlowBucketRemove(&fb, &f[1]);
+    FAIL_IF(fb.slot[1] != NULL);
+    FAIL_IF(f[1].fb != NULL);
+    FAIL_IF(f[0].hnext != &f[2]);
+    FAIL_IF(SC_ATOMIC_GET(fb.seq) & 1);
+
+    /* freed slot is reused */
+    FlowBucketSlotDel(&fb, &f[FLOW_BUCKET_SLOTS]);
+    FlowBucketSlotAdd(&fb, &f[FLOW_BUCKET_SLOTS]);
+    FAIL_IF(fb.slot[1] != &f[FLOW_BUCKET_SLOTS]);
+
+    FlowBucketRemove(&fb, &f[0]);
+    FAIL_IF(fb.head != &f[2]);
+    FBLOCK_UNLOCK(&fb);
+
+    FBLOCK_DESTROY(&fb);
+    PASS;
+}
+
+/**
+ *  \test  Test flow lookups in a private flow table.
+ */
+static int FlowTest11 (void)
+{
+    ThreadVars tv;
+    uint8_t payload[] = "Payload";
+
+    memset(&tv, 0, sizeof(tv));
+    tv.id = 1;
+
+    FlowInitConfig(FLOW_QUIET);
+    FlowPrivateTablesEnable();
+    FAIL_IF_NOT(FlowPrivateTablesEnabled());
+    FlowPrivateTable *ft = FlowPrivateTableAlloc(&tv);
+    FAIL_IF_NULL(ft);
+
+    Packet *p = UTHBuildPacket(payload, sizeof(payload), IPPROTO_TCP);
+    FAIL_IF_NULL(p);
+    FlowSetupPacket(p);
+
+    FlowHandlePacketPrivate(NULL, NULL, ft, p);
+    FAIL_IF_NULL(p->flow);
+    Flow *f = p->flow;
+    FAIL_IF(f->fb != &ft->hash[p->flow_hash % ft->hash_size]);
+    FAIL_IF(f->thread_id != 1);
+    FLOWLOCK_UNLOCK(f);
+    FlowDeReference(&p->flow);
+
+    /* second lookup finds the same flow */
+    FlowHandlePacketPrivate(NULL, NULL, ft, p);
+    FAIL_IF(p->flow != f);
+    FLOWLOCK_UNLOCK(f);
+    FlowDeReference(&p->flow);
+
+    /* the global hash doesn't know about it */
+    FAIL_IF(flow_hash[p->flow_hash % flow_config.hash_size].head != NULL);
+
+    /* at shutdown the flow, which has no session to reassemble, goes
+     * to the recycler */
+    FAIL_IF(FlowForceReassemblyForPrivateTable(&tv, ft) != 1);
+    FAIL_IF(ft->shutdown_row != ft->hash_size);
+    uint32_t recycle_len = flow_recycle_q.len;
+    FlowPrivateTableRecycle(ft);
+    FAIL_IF(flow_recycle_q.len != recycle_len + 1);
+    FAIL_IF(ft->hash[p->flow_hash % ft->hash_size].head != NULL);
+    FAIL_IF_NOT(f->flow_end_flags & FLOW_END_FLAG_SHUTDOWN);
+
+    UTHFreePacket(p);
+    FlowPrivateTableFree(ft);
+    FlowShutdown();
+    PASS;
+}
+
+/**
+ *  \test  Test the layout of the Flow struct against the report: the
+ *         members used by the hash lookup share the first cache line, the
+ *         lock starts the second one and the per packet members come
+ *         before the cold part, which starts at the fourth line.
+ */
+static int FlowTest12 (void)
+{
+    size_t i, packet_end = 0, cold_start = sizeof(Flow);
+
+    FlowLayoutReport();
+
+    for (i = 0; i < sizeof(flow_layout) / sizeof(flow_layout[0]); i++) {
+        const FlowLayoutField *fl = &flow_layout[i];
+        size_t end = fl->offset + fl->size;
+
+        switch (fl->class) {
+            case FLOW_LAYOUT_LOOKUP:
+                FAIL_IF(end > CLS);
+                break;
+            case FLOW_LAYOUT_PACKET:
+                FAIL_IF(fl->offset < CLS);
+                if (end > packet_end)
+                    packet_end = end;
+                break;
+            case FLOW_LAYOUT_COLD:
+                if (fl->offset < cold_start)
+                    cold_start = fl->offset;
+                break;
+        }
+    }
+    FAIL_IF(packet_end > cold_start);
+#ifdef FLOWLOCK_RWLOCK
+    FAIL_IF(offsetof(Flow, r) != CLS);
+#else
+    FAIL_IF(offsetof(Flow, m) != CLS);
+    FAIL_IF(packet_end > 3 * CLS);
+    FAIL_IF(cold_start < 3 * CLS);
+#endif
+
+    PASS;
+}
+
+static int flow_test13_freed = 0;
+
+static int FlowTest13BypassUpdate(Flow *f, void *data, time_t tsec)
+{
+    FlowBypassInfo *fc = FlowGetBypassInfo(f);
+    fc->todstpktcnt += 2;
+    fc->todstbytecnt += 200;
+    return 1;
+}
+
+static void FlowTest13BypassFree(void *data)
+{
+    flow_test13_freed = 1;
+    SCFree(data);
+}
+
+/**
+ *  \test  Test the bypass info of a flow: the counters at the time of
+ *         the bypass are recorded, the capture update keeps the flow
+ *         alive and the capture data is freed with the flow.
+ */
+static int FlowTest13 (void)
+{
+    struct timeval ts = { 1000, 0 };
+
+    FlowInitConfig(FLOW_QUIET);
+    Flow *f = FlowAlloc();
+    FAIL_IF_NULL(f);
+    FAIL_IF_NOT_NULL(FlowGetBypassInfo(f));
+
+    f->todstpktcnt = 3;
+    f->todstbytecnt = 300;
+    f->tosrcpktcnt = 1;
+    f->tosrcbytecnt = 100;
+
+    /* no capture callback: nothing to update */
+    uint64_t memuse = SC_ATOMIC_GET(flow_memuse);
+    FlowBypassInfo *fc = FlowSetupBypassInfo(f);
+    FAIL_IF_NULL(fc);
+    FAIL_IF(FlowGetBypassInfo(f) != fc);
+    FAIL_IF(FlowSetupBypassInfo(f) != fc);
+    FAIL_IF(SC_ATOMIC_GET(flow_memuse) != memuse + sizeof(FlowBypassInfo));
+    FAIL_IF(fc->todstpktcnt_start != 3);
+    FAIL_IF(fc->tosrcbytecnt_start != 100);
+    FAIL_IF(FlowBypassUpdate(f, &ts) != 0);
+
+    fc->BypassUpdate = FlowTest13BypassUpdate;
+    fc->BypassFree = FlowTest13BypassFree;
+    fc->bypass_data = SCMalloc(1);
+    FAIL_IF_NULL(fc->bypass_data);
+
+    FAIL_IF(FlowBypassUpdate(f, &ts) != 1);
+    FAIL_IF(f->lastts.tv_sec != 1000);
+    FAIL_IF(fc->todstpktcnt != 2);
+    FAIL_IF(fc->todstbytecnt != 200);
+
+    flow_test13_freed = 0;
+    FlowClearMemory(f, FlowGetProtoMapping(IPPROTO_TCP));
+    FAIL_IF(flow_test13_freed != 1);
+    FAIL_IF_NOT_NULL(FlowGetBypassInfo(f));
+    FAIL_IF(SC_ATOMIC_GET(flow_memuse) != memuse);
+
+    FlowFree(f);
+    FlowShutdown();
+    PASS;
+}
+
+/**
+ *  \test  Test that retired flows are only freed once the lockless
+ *          readers are done with them.
+ */
+static int FlowTest14 (void)
+{
+    FlowInitConfig(FLOW_QUIET);
+    FlowEpochReader *r = FlowEpochReaderRegister();
+    FAIL_IF_NULL(r);
+
+    /* idle reader doesn't hold anything */
+    uint64_t epoch = FlowEpochRetire();
+    FAIL_IF_NOT(FlowEpochPassed(epoch) == 1);
+
+    /* reader in a lookup that started before the retire */
+    (void) SC_ATOMIC_SET(r->epoch, SC_ATOMIC_GET(flow_epoch));
+    epoch = FlowEpochRetire();
+    FAIL_IF_NOT(FlowEpochPassed(epoch) == 0);
+
+    /* surplus spare flows are retired but not freed */
+    uint32_t spare = flow_spare_q.len;
+    FAIL_IF(spare < 10);
+    flow_config.prealloc = spare - 10;
+    FAIL_IF_NOT(FlowUpdateSpareFlows() == 1);
+    FAIL_IF(flow_retired_q.len != 10);
+    FAIL_IF(flow_spare_q.len != spare - 10);
+
+    (void) SC_ATOMIC_SET(r->epoch, SC_ATOMIC_GET(flow_epoch) - 1);
+    FAIL_IF_NOT(FlowUpdateSpareFlows() == 1);
+    FAIL_IF(flow_retired_q.len != 10);
+
+    /* a lookup started after the retire doesn't block it */
+    (void) SC_ATOMIC_SET(r->epoch, SC_ATOMIC_GET(flow_epoch));
+    FAIL_IF_NOT(FlowEpochPassed(flow_retired_epoch) == 1);
+    FAIL_IF_NOT(FlowUpdateSpareFlows() == 1);
+    FAIL_IF(flow_retired_q.len != 0);
+
+    (void) SC_ATOMIC_SET(r->epoch, 0);
+    FlowEpochReaderDeregister(r);
+    FlowShutdown();
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 /**
@@ -1114,6 +1826,14 @@ void FlowRegisterTests (void)
                    FlowTest08);
     UtRegisterTest("FlowTest09 -- Test flow Allocations when it reach memcap",
                    FlowTest09);
+    UtRegisterTest("FlowTest10 -- Test flow bucket lookup slots",
+                   FlowTest10);
+    UtRegisterTest("FlowTest11 -- Test private flow table lookups and shutdown",
+                   FlowTest11);
+    UtRegisterTest("FlowTest12 -- Test Flow struct layout", FlowTest12);
+    UtRegisterTest("FlowTest13 -- Test flow bypass info", FlowTest13);
+    UtRegisterTest("FlowTest14 -- Test retired flow grace period",
+                   FlowTest14);
 
     FlowMgrRegisterTests();
     RegisterFlowStorageTests();
@@ -304,6 +304,17 @@ typedef uint16_t FlowThreadId;
  *  The flow "header" (addresses, ports, proto, recursion level) are static
  *  after the initialization and remain read-only throughout the entire live
  *  of a flow. This is why we can access those without protection of the lock.
+ *
+ *  Layout
+ *
+ *  The members are grouped by how often they are used. The first cache line
+ *  holds what the hash lookup compares: the header, the flags, the bucket
+ *  and the hash list next pointer. The flow lock, which the lookup takes
+ *  next, starts the second line. It doesn't fit the first one with the
+ *  header. It's followed by the members updated for every packet of the
+ *  flow. The rest is only used at flow setup, by the app layer and
+ *  detection, or on timeout. The layout is checked at compile time in
+ *  flow.c and by FlowTest12, see FlowLayoutReport().
  */
 
 typedef struct Flow_
@@ -323,34 +334,19 @@ typedef struct Flow_
     uint8_t recursion_level;
     uint16_t vlan_id[2];
 
-    /** flow hash - the flow hash before hash table size mod. */
-    uint32_t flow_hash;
-
-    /* time stamp of last update (last packet). Set/updated under the
-     * flow and flow hash row locks, safe to read under either the
-     * flow lock or flow hash row lock. */
-    struct timeval lastts;
-
     /* end of flow "header" */
 
-    SC_ATOMIC_DECLARE(FlowStateType, flow_state);
-
-    /** how many pkts and stream msgs are using the flow *right now*. This
-     *  variable is atomic so not protected by the Flow mutex "m".
-     *
-     *  On receiving a packet the counter is incremented while the flow
-     *  bucked is locked, which is also the case on timeout pruning.
-     */
-    SC_ATOMIC_DECLARE(FlowRefCount, use_cnt);
+    uint32_t flags;
 
-    /** flow tenant id, used to setup flow timeout and stream pseudo
-     *  packets with the correct tenant id set */
-    uint32_t tenant_id;
+    /** hash bucket the flow is in, NULL if it's not in the hash. Set and
+     *  cleared under the flow lock and fb->s */
+    struct FlowBucket_ *fb;
 
-    uint32_t probing_parser_toserver_alproto_masks;
-    uint32_t probing_parser_toclient_alproto_masks;
+    /** hash list next pointer, protected by fb->s */
+    struct Flow_ *hnext;
 
-    uint32_t flags;
+    /* end of the lookup cache line. The flow lock starts the second line,
+     * followed by the members updated per packet */
 
 #ifdef FLOWLOCK_RWLOCK
     SCRWLock r;
@@ -360,8 +356,16 @@ typedef struct Flow_
     #error Enable FLOWLOCK_RWLOCK or FLOWLOCK_MUTEX
 #endif
 
-    /** protocol specific data pointer, e.g. for TcpSession */
-    void *protoctx;
+    /* time stamp of last update (last packet). Set/updated under the
+     * flow and flow hash row locks, safe to read under either the
+     * flow lock or flow hash row lock. */
+    struct timeval lastts;
+
+    /** flow hash - the flow hash before hash table size mod. */
+    uint32_t flow_hash;
+
+    /** Thread ID for the stream/detect portion of this flow */
+    FlowThreadId thread_id;
 
     /** mapping to Flow's protocol specific protocols for timeouts
         and state and free functions. */
@@ -370,10 +374,44 @@ typedef struct Flow_
     uint8_t flow_end_flags;
     /* coccinelle: Flow:flow_end_flags:FLOW_END_FLAG_ */
 
+    SC_ATOMIC_DECLARE(FlowStateType, flow_state);
+
+    /** how many pkts and stream msgs are using the flow *right now*. This
+     *  variable is atomic so not protected by the Flow mutex "m".
+     *
+     *  On receiving a packet the counter is incremented while the flow
+     *  bucked is locked, which is also the case on timeout pruning.
+     */
+    SC_ATOMIC_DECLARE(FlowRefCount, use_cnt);
+
+    /** protocol specific data pointer, e.g. for TcpSession */
+    void *protoctx;
+
+    uint32_t todstpktcnt;
+    uint32_t tosrcpktcnt;
+    uint64_t todstbytecnt;
+    uint64_t tosrcbytecnt;
+
     AppProto alproto; /**< \brief application level protocol */
     AppProto alproto_ts;
     AppProto alproto_tc;
 
+    /** toclient sgh for this flow. Only use when FLOW_SGH_TOCLIENT flow flag
+     *  has been set. */
+    struct SigGroupHead_ *sgh_toclient;
+    /** toserver sgh for this flow. Only use when FLOW_SGH_TOSERVER flow flag
+     *  has been set. */
+    struct SigGroupHead_ *sgh_toserver;
+
+    /* end of the per packet members, the cold part follows */
+
+    /** flow tenant id, used to setup flow timeout and stream pseudo
+     *  packets with the correct tenant id set */
+    uint32_t tenant_id;
+
+    uint32_t probing_parser_toserver_alproto_masks;
+    uint32_t probing_parser_toclient_alproto_masks;
+
     uint32_t data_al_so_far[2];
 
     /** detection engine ctx id used to inspect this flow. Set at initial
@@ -381,12 +419,17 @@ typedef struct Flow_
      *  de_state and stored sgh ptrs are reset. */
     uint32_t de_ctx_id;
 
-    /** Thread ID for the stream/detect portion of this flow */
-    FlowThreadId thread_id;
-
     /** detect state 'alversion' inspected for both directions */
     uint8_t detect_alversion[2];
 
+    /** set if the flow was allocated from a slab. Flows allocated (or
+     *  zeroed) otherwise have this unset. Set at alloc. */
+    uint8_t slab;
+
+    /** timer wheel slot the flow is armed in, 0 if not armed. Protected
+     *  by the slot lock. Arming and disarming also need the flow lock. */
+    uint16_t timer_slot;
+
     /** application level storage ptrs.
      *
      */
@@ -396,30 +439,20 @@ typedef struct Flow_
     /** detection engine state */
     struct DetectEngineStateFlow_ *de_state;
 
-    /** toclient sgh for this flow. Only use when FLOW_SGH_TOCLIENT flow flag
-     *  has been set. */
-    struct SigGroupHead_ *sgh_toclient;
-    /** toserver sgh for this flow. Only use when FLOW_SGH_TOSERVER flow flag
-     *  has been set. */
-    struct SigGroupHead_ *sgh_toserver;
-
     /* pointer to the var list */
     GenericVar *flowvar;
 
-    /** hash list pointers, protected by fb->s */
-    struct Flow_ *hnext; /* hash list */
+    /** hash list prev pointer, protected by fb->s */
     struct Flow_ *hprev;
-    struct FlowBucket_ *fb;
+
+    /** timer wheel list pointers, protected by the wheel slot lock */
+    struct Flow_ *tnext;
+    struct Flow_ *tprev;
 
     /** queue list pointers, protected by queue mutex */
     struct Flow_ *lnext; /* list */
     struct Flow_ *lprev;
     struct timeval startts;
-
-    uint32_t todstpktcnt;
-    uint32_t tosrcpktcnt;
-    uint64_t todstbytecnt;
-    uint64_t tosrcbytecnt;
 } Flow;
 
 enum FlowState {
@@ -441,15 +474,49 @@ typedef struct FlowProtoFreeFunc_ {
     void (*Freefunc)(void *);
 } FlowProtoFreeFunc;
 
+/** \brief bypass state of a flow, kept in flow storage
+ *
+ *  Set up when the flow is bypassed. A capture method that bypasses the
+ *  flow itself can set the callbacks: BypassUpdate is called by the flow
+ *  manager when the flow times out, to pull the counters of the packets
+ *  the capture method handled. It returns 1 if the flow is still active
+ *  in the capture method. BypassFree is called when the flow ends. */
+typedef struct FlowBypassInfo_ {
+    int (*BypassUpdate)(Flow *f, void *data, time_t tsec);
+    void (*BypassFree)(void *data);
+    void *bypass_data;
+
+    /** flow counters at the time the flow was bypassed */
+    uint32_t todstpktcnt_start;
+    uint32_t tosrcpktcnt_start;
+    uint64_t todstbytecnt_start;
+    uint64_t tosrcbytecnt_start;
+
+    /** packets dropped by the capture method, not seen by us */
+    uint64_t todstpktcnt;
+    uint64_t tosrcpktcnt;
+    uint64_t todstbytecnt;
+    uint64_t tosrcbytecnt;
+} FlowBypassInfo;
+
 /** \brief prepare packet for a life with flow
  *  Set PKT_WANTS_FLOW flag to incidate workers should do a flow lookup
  *  and calc the hash value to be used in the lookup and autofp flow
  *  balancing. */
 void FlowSetupPacket(Packet *p);
 void FlowHandlePacket (ThreadVars *, DecodeThreadVars *, Packet *);
+struct FlowPrivateTable_;
+void FlowHandlePacketPrivate(ThreadVars *, DecodeThreadVars *,
+        struct FlowPrivateTable_ *, Packet *);
+void FlowPrivateTablesEnable(void);
+int FlowPrivateTablesEnabled(void);
+struct FlowPrivateTable_ *FlowPrivateTableAlloc(ThreadVars *);
+void FlowPrivateTableRecycle(struct FlowPrivateTable_ *);
+void FlowPrivateTableFree(struct FlowPrivateTable_ *);
 void FlowInitConfig (char);
 void FlowPrintQueueInfo (void);
 void FlowShutdown(void);
+void FlowLayoutReport(void);
 void FlowSetIPOnlyFlag(Flow *, int);
 
 void FlowRegisterTests (void);
@@ -471,6 +538,11 @@ void FlowCleanupAppLayer(Flow *);
 
 void FlowUpdateState(Flow *f, enum FlowState s);
 
+void FlowBypassInfoRegister(void);
+FlowBypassInfo *FlowGetBypassInfo(Flow *f);
+FlowBypassInfo *FlowSetupBypassInfo(Flow *f);
+int FlowBypassUpdate(Flow *f, struct timeval *ts);
+
 /** ----- Inline functions ----- */
 
 /** \brief Set the No Packet Inspection Flag without locking the flow.
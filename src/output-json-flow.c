@@ -189,14 +189,45 @@ static void JsonFlowLogJSON(JsonFlowLogThread *aft, json_t *js, Flow *f)
 
     json_object_set_new(js, "app_proto", json_string(AppProtoToString(f->alproto)));
 
-    json_object_set_new(hjs, "pkts_toserver",
-            json_integer(f->todstpktcnt));
-    json_object_set_new(hjs, "pkts_toclient",
-            json_integer(f->tosrcpktcnt));
-    json_object_set_new(hjs, "bytes_toserver",
-            json_integer(f->todstbytecnt));
-    json_object_set_new(hjs, "bytes_toclient",
-            json_integer(f->tosrcbytecnt));
+    /* the totals include the packets the capture method handled for
+     * us after the flow was bypassed */
+    FlowBypassInfo *fc = FlowGetBypassInfo(f);
+    if (fc != NULL) {
+        json_object_set_new(hjs, "pkts_toserver",
+                json_integer(f->todstpktcnt + fc->todstpktcnt));
+        json_object_set_new(hjs, "pkts_toclient",
+                json_integer(f->tosrcpktcnt + fc->tosrcpktcnt));
+        json_object_set_new(hjs, "bytes_toserver",
+                json_integer(f->todstbytecnt + fc->todstbytecnt));
+        json_object_set_new(hjs, "bytes_toclient",
+                json_integer(f->tosrcbytecnt + fc->tosrcbytecnt));
+
+        json_t *bjs = json_object();
+        if (bjs != NULL) {
+            json_object_set_new(bjs, "pkts_toserver",
+                    json_integer(f->todstpktcnt - fc->todstpktcnt_start +
+                        fc->todstpktcnt));
+            json_object_set_new(bjs, "pkts_toclient",
+                    json_integer(f->tosrcpktcnt - fc->tosrcpktcnt_start +
+                        fc->tosrcpktcnt));
+            json_object_set_new(bjs, "bytes_toserver",
+                    json_integer(f->todstbytecnt - fc->todstbytecnt_start +
+                        fc->todstbytecnt));
+            json_object_set_new(bjs, "bytes_toclient",
+                    json_integer(f->tosrcbytecnt - fc->tosrcbytecnt_start +
+                        fc->tosrcbytecnt));
+            json_object_set_new(js, "bypassed", bjs);
+        }
+    } else {
+        json_object_set_new(hjs, "pkts_toserver",
+                json_integer(f->todstpktcnt));
+        json_object_set_new(hjs, "pkts_toclient",
+                json_integer(f->tosrcpktcnt));
+        json_object_set_new(hjs, "bytes_toserver",
+                json_integer(f->todstbytecnt));
+        json_object_set_new(hjs, "bytes_toclient",
+                json_integer(f->tosrcbytecnt));
+    }
 
     char timebuf1[64], timebuf2[64];
 
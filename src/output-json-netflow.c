@@ -196,10 +196,15 @@ static void JsonNetFlowLogJSONToServer(JsonNetFlowLogThread *aft, json_t *js, Fl
     json_object_set_new(js, "app_proto",
             json_string(AppProtoToString(f->alproto_ts ? f->alproto_ts : f->alproto)));
 
-    json_object_set_new(hjs, "pkts",
-            json_integer(f->todstpktcnt));
-    json_object_set_new(hjs, "bytes",
-            json_integer(f->todstbytecnt));
+    uint64_t pkts = f->todstpktcnt;
+    uint64_t bytes = f->todstbytecnt;
+    FlowBypassInfo *fc = FlowGetBypassInfo(f);
+    if (fc != NULL) {
+        pkts += fc->todstpktcnt;
+        bytes += fc->todstbytecnt;
+    }
+    json_object_set_new(hjs, "pkts", json_integer(pkts));
+    json_object_set_new(hjs, "bytes", json_integer(bytes));
 
     char timebuf1[64], timebuf2[64];
 
@@ -245,10 +250,15 @@ static void JsonNetFlowLogJSONToClient(JsonNetFlowLogThread *aft, json_t *js, Fl
     json_object_set_new(js, "app_proto",
             json_string(AppProtoToString(f->alproto_tc ? f->alproto_tc : f->alproto)));
 
-    json_object_set_new(hjs, "pkts",
-            json_integer(f->tosrcpktcnt));
-    json_object_set_new(hjs, "bytes",
-            json_integer(f->tosrcbytecnt));
+    uint64_t pkts = f->tosrcpktcnt;
+    uint64_t bytes = f->tosrcbytecnt;
+    FlowBypassInfo *fc = FlowGetBypassInfo(f);
+    if (fc != NULL) {
+        pkts += fc->tosrcpktcnt;
+        bytes += fc->tosrcbytecnt;
+    }
+    json_object_set_new(hjs, "pkts", json_integer(pkts));
+    json_object_set_new(hjs, "bytes", json_integer(bytes));
 
     char timebuf1[64], timebuf2[64];
 
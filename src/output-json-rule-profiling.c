@@ -0,0 +1,213 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Periodic eve records of the live rule profiling data.
+ *
+ * Runs as a stats logger so it is driven by the stats thread. Every
+ * 'interval' seconds a snapshot of the per rule, per rule group and per
+ * buffer counters of the current detection engine is logged.
+ */
+
+#include "suricata-common.h"
+#include "debug.h"
+#include "detect.h"
+#include "detect-engine.h"
+#include "conf.h"
+
+#include "threads.h"
+#include "threadvars.h"
+#include "tm-threads.h"
+
+#include "util-debug.h"
+#include "util-buffer.h"
+#include "util-byte.h"
+#include "util-profiling.h"
+#include "util-logopenfile.h"
+
+#include "output.h"
+#include "output-json.h"
+#include "output-json-rule-profiling.h"
+
+#define MODULE_NAME "JsonRuleProfilingLog"
+
+#ifdef HAVE_LIBJANSSON
+
+#define DEFAULT_INTERVAL 60
+
+typedef struct OutputRuleProfilingCtx_ {
+    LogFileCtx *file_ctx;
+    uint32_t interval;  /**< seconds between two records */
+} OutputRuleProfilingCtx;
+
+typedef struct JsonRuleProfilingLogThread_ {
+    OutputRuleProfilingCtx *ctx;
+    MemBuffer *buffer;
+    time_t last;
+} JsonRuleProfilingLogThread;
+
+static int JsonRuleProfilingLogger(ThreadVars *tv, void *thread_data, const StatsTable *st)
+{
+    SCEnter();
+    JsonRuleProfilingLogThread *aft = (JsonRuleProfilingLogThread *)thread_data;
+
+    struct timeval tval;
+    gettimeofday(&tval, NULL);
+
+    if (tval.tv_sec - aft->last < (time_t)aft->ctx->interval)
+        SCReturnInt(0);
+    aft->last = tval.tv_sec;
+
+    DetectEngineCtx *de_ctx = DetectEngineGetCurrent();
+    json_t *js_prof = SCProfilingRuleGetJson(de_ctx);
+    if (de_ctx != NULL)
+        DetectEngineDeReference(&de_ctx);
+    if (js_prof == NULL)
+        SCReturnInt(0);
+
+    json_t *js = json_object();
+    if (unlikely(js == NULL)) {
+        json_decref(js_prof);
+        SCReturnInt(0);
+    }
+    char timebuf[64];
+    CreateIsoTimeString(&tval, timebuf, sizeof(timebuf));
+    json_object_set_new(js, "timestamp", json_string(timebuf));
+    json_object_set_new(js, "event_type", json_string("rule_profiling"));
+    json_object_set_new(js, "rule_profiling", js_prof);
+
+    OutputJSONBuffer(js, aft->ctx->file_ctx, &aft->buffer);
+    MemBufferReset(aft->buffer);
+
+    json_decref(js);
+    SCReturnInt(0);
+}
+
+#define OUTPUT_BUFFER_SIZE 65535
+static TmEcode JsonRuleProfilingLogThreadInit(ThreadVars *t, void *initdata, void **data)
+{
+    if (initdata == NULL) {
+        SCLogDebug("Error getting context for EveLogRuleProfiling. \"initdata\" argument NULL");
+        return TM_ECODE_FAILED;
+    }
+
+    JsonRuleProfilingLogThread *aft = SCMalloc(sizeof(JsonRuleProfilingLogThread));
+    if (unlikely(aft == NULL))
+        return TM_ECODE_FAILED;
+    memset(aft, 0, sizeof(JsonRuleProfilingLogThread));
+
+    aft->ctx = ((OutputCtx *)initdata)->data;
+
+    aft->buffer = MemBufferCreateNew(OUTPUT_BUFFER_SIZE);
+    if (aft->buffer == NULL) {
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
+
+    /* first record after one interval */
+    struct timeval tval;
+    gettimeofday(&tval, NULL);
+    aft->last = tval.tv_sec;
+
+    *data = (void *)aft;
+    return TM_ECODE_OK;
+}
+
+static TmEcode JsonRuleProfilingLogThreadDeinit(ThreadVars *t, void *data)
+{
+    JsonRuleProfilingLogThread *aft = (JsonRuleProfilingLogThread *)data;
+    if (aft == NULL) {
+        return TM_ECODE_OK;
+    }
+
+    MemBufferFree(aft->buffer);
+
+    /* clear memory */
+    memset(aft, 0, sizeof(JsonRuleProfilingLogThread));
+
+    SCFree(aft);
+    return TM_ECODE_OK;
+}
+
+static void OutputRuleProfilingLogDeinitSub(OutputCtx *output_ctx)
+{
+    OutputRuleProfilingCtx *ctx = output_ctx->data;
+    SCFree(ctx);
+    SCFree(output_ctx);
+}
+
+static OutputCtx *OutputRuleProfilingLogInitSub(ConfNode *conf, OutputCtx *parent_ctx)
+{
+    AlertJsonThread *ajt = parent_ctx->data;
+
+    if (!profiling_rules_enabled) {
+        SCLogWarning(SC_ERR_INVALID_ARGUMENT, "eve-log rule-profiling needs "
+                "profiling.rules.enabled, not logging rule profiling");
+        return NULL;
+    }
+
+    OutputRuleProfilingCtx *ctx = SCMalloc(sizeof(OutputRuleProfilingCtx));
+    if (unlikely(ctx == NULL))
+        return NULL;
+    ctx->interval = DEFAULT_INTERVAL;
+
+    if (conf != NULL) {
+        const char *interval = ConfNodeLookupChildValue(conf, "interval");
+        if (interval != NULL) {
+            if (ByteExtractStringUint32(&ctx->interval, 10,
+                        (uint16_t)strlen(interval), interval) <= 0 ||
+                    ctx->interval == 0) {
+                SCLogError(SC_ERR_INVALID_ARGUMENT,
+                        "invalid rule-profiling interval: %s", interval);
+                SCFree(ctx);
+                return NULL;
+            }
+        }
+    }
+
+    OutputCtx *output_ctx = SCCalloc(1, sizeof(OutputCtx));
+    if (unlikely(output_ctx == NULL)) {
+        SCFree(ctx);
+        return NULL;
+    }
+
+    ctx->file_ctx = ajt->file_ctx;
+
+    output_ctx->data = ctx;
+    output_ctx->DeInit = OutputRuleProfilingLogDeinitSub;
+
+    SCLogInfo("logging rule profiling every %u seconds", ctx->interval);
+    return output_ctx;
+}
+
+void JsonRuleProfilingLogRegister(void)
+{
+    OutputRegisterStatsSubModule(LOGGER_JSON_RULE_PROFILING, "eve-log",
+        MODULE_NAME, "eve-log.rule-profiling", OutputRuleProfilingLogInitSub,
+        JsonRuleProfilingLogger, JsonRuleProfilingLogThreadInit,
+        JsonRuleProfilingLogThreadDeinit, NULL);
+}
+
+#else
+
+void JsonRuleProfilingLogRegister(void)
+{
+}
+
+#endif
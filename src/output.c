@@ -63,6 +63,7 @@
 #include "output-json-file.h"
 #include "output-json-smtp.h"
 #include "output-json-stats.h"
+#include "output-json-rule-profiling.h"
 #include "log-filestore.h"
 #include "log-tcp-data.h"
 #include "log-stats.h"
@@ -1086,6 +1087,8 @@ void OutputRegisterLoggers(void)
     JsonNetFlowLogRegister();
     /* json stats */
     JsonStatsLogRegister();
+    /* live rule profiling */
+    JsonRuleProfilingLogRegister();
 
     /* Template JSON logger. */
     JsonTemplateLogRegister();
@@ -39,6 +39,7 @@
 #include "runmode-af-packet.h"
 #include "log-httplog.h"
 #include "output.h"
+#include "flow.h"
 #include "detect-engine-mpm.h"
 
 #include "alert-fastlog.h"
@@ -53,6 +54,7 @@
 #include "util-device.h"
 #include "util-runmodes.h"
 #include "util-ioctl.h"
+#include "util-ebpf.h"
 
 #include "source-af-packet.h"
 
@@ -121,6 +123,7 @@ void *ParseAFPConfig(const char *iface)
     intmax_t value;
     int boolval;
     char *bpf_filter = NULL;
+    char *ebpf_file = NULL;
     char *out_iface = NULL;
     int cluster_type = PACKET_FANOUT_HASH;
 
@@ -145,6 +148,12 @@ void *ParseAFPConfig(const char *iface)
     aconf->DerefFunc = AFPDerefConfig;
     aconf->flags = AFP_RING_MODE;
     aconf->bpf_filter = NULL;
+    aconf->ebpf_lb_file = NULL;
+    aconf->ebpf_lb_fd = -1;
+    aconf->ebpf_filter_file = NULL;
+    aconf->ebpf_filter_fd = -1;
+    aconf->xdp_filter_file = NULL;
+    aconf->xdp_filter_fd = -1;
     aconf->out_iface = NULL;
     aconf->copy_mode = AFP_COPY_MODE_NONE;
     aconf->block_timeout = 10;
@@ -325,11 +334,48 @@ void *ParseAFPConfig(const char *iface)
                 aconf->iface);
         aconf->cluster_type = PACKET_FANOUT_ROLLOVER;
         cluster_type = PACKET_FANOUT_ROLLOVER;
-
+    } else if (strcmp(tmpctype, "cluster_ebpf") == 0) {
+#ifdef HAVE_PACKET_EBPF
+        SCLogConfig("Using ebpf based cluster mode for AF_PACKET (iface %s)",
+                aconf->iface);
+        aconf->cluster_type = PACKET_FANOUT_EBPF;
+        cluster_type = PACKET_FANOUT_EBPF;
+#else
+        SCLogError(SC_ERR_INVALID_CLUSTER_TYPE, "Cluster type ebpf is not "
+                "supported, Suricata was built without eBPF support");
+#endif
     } else {
         SCLogWarning(SC_ERR_INVALID_CLUSTER_TYPE,"invalid cluster-type %s",tmpctype);
     }
 
+    if (ConfGetChildValueWithDefault(if_root, if_default, "ebpf-lb-file", &ebpf_file) != 1) {
+        if (cluster_type == PACKET_FANOUT_EBPF) {
+            SCLogError(SC_ERR_INVALID_VALUE, "Cluster type ebpf needs an "
+                    "ebpf-lb-file on iface %s, falling back to cluster_flow",
+                    aconf->iface);
+            aconf->cluster_type = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+            cluster_type = PACKET_FANOUT_HASH;
+        }
+    } else {
+#ifdef HAVE_PACKET_EBPF
+        if (cluster_type != PACKET_FANOUT_EBPF) {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "ebpf-lb-file set but cluster-type "
+                    "is not cluster_ebpf on iface %s, ignoring it", aconf->iface);
+        } else {
+            aconf->ebpf_lb_file = ebpf_file;
+            if (EBPFLoadFile(aconf->iface, aconf->ebpf_lb_file, "loadbalancer",
+                        &aconf->ebpf_lb_fd, EBPF_SOCKET_FILTER) != 0) {
+                SCLogError(SC_ERR_INVALID_VALUE, "Unable to load eBPF load "
+                        "balancing program, falling back to cluster_flow");
+                aconf->cluster_type = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+                cluster_type = PACKET_FANOUT_HASH;
+            }
+        }
+#else
+        SCLogError(SC_ERR_UNIMPLEMENTED, "eBPF support is not built-in");
+#endif
+    }
+
     int conf_val = 0;
     ConfGetChildValueBoolWithDefault(if_root, if_default, "rollover", &conf_val);
     if (conf_val) {
@@ -349,6 +395,74 @@ void *ParseAFPConfig(const char *iface)
         }
     }
 
+    if (ConfGetChildValueWithDefault(if_root, if_default, "ebpf-filter-file", &ebpf_file) == 1) {
+#ifdef HAVE_PACKET_EBPF
+        aconf->ebpf_filter_file = ebpf_file;
+        if (aconf->bpf_filter) {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "eBPF filter takes precedence "
+                    "over bpf filter '%s' on iface %s", aconf->bpf_filter,
+                    aconf->iface);
+        }
+        if (EBPFLoadFile(aconf->iface, aconf->ebpf_filter_file, "filter",
+                    &aconf->ebpf_filter_fd, EBPF_SOCKET_FILTER) != 0) {
+            SCLogError(SC_ERR_INVALID_VALUE, "Unable to load eBPF filter "
+                    "'%s'", aconf->ebpf_filter_file);
+        }
+#else
+        SCLogError(SC_ERR_UNIMPLEMENTED, "eBPF support is not built-in");
+#endif
+    }
+
+    if (ConfGetChildValueWithDefault(if_root, if_default, "xdp-filter-file", &ebpf_file) == 1) {
+#ifdef HAVE_PACKET_EBPF
+        aconf->xdp_filter_file = ebpf_file;
+        aconf->xdp_mode = EBPF_XDP_MODE_DRIVER;
+        if (ConfGetChildValueWithDefault(if_root, if_default, "xdp-mode", &tmpctype) == 1) {
+            if (strcmp(tmpctype, "soft") == 0) {
+                aconf->xdp_mode = EBPF_XDP_MODE_SOFT;
+            } else if (strcmp(tmpctype, "hw") == 0) {
+                aconf->xdp_mode = EBPF_XDP_MODE_HW;
+            } else if (strcmp(tmpctype, "driver") != 0) {
+                SCLogWarning(SC_ERR_INVALID_VALUE, "Invalid xdp-mode '%s' on "
+                        "iface %s, using driver mode", tmpctype, aconf->iface);
+            }
+        }
+        if (EBPFLoadFile(aconf->iface, aconf->xdp_filter_file, "xdp",
+                    &aconf->xdp_filter_fd, EBPF_XDP_CODE) != 0 ||
+                EBPFSetupXDP(aconf->iface, aconf->xdp_filter_fd,
+                    aconf->xdp_mode) != 0) {
+            SCLogError(SC_ERR_INVALID_VALUE, "Unable to set up XDP filter "
+                    "'%s'", aconf->xdp_filter_file);
+            aconf->xdp_filter_fd = -1;
+        }
+#else
+        SCLogError(SC_ERR_UNIMPLEMENTED, "XDP support is not built-in");
+#endif
+    }
+
+    conf_val = 0;
+    (void)ConfGetChildValueBoolWithDefault(if_root, if_default, "bypass", &conf_val);
+    if (conf_val) {
+#ifdef HAVE_PACKET_EBPF
+        if (aconf->copy_mode != AFP_COPY_MODE_NONE) {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "Bypass would drop the packets "
+                    "of bypassed flows in IPS/TAP mode, disabling it on "
+                    "iface %s", aconf->iface);
+        } else if (EBPFGetMapFDByName(aconf->iface, EBPF_FLOW_TABLE_V4) == -1 &&
+                EBPFGetMapFDByName(aconf->iface, EBPF_FLOW_TABLE_V6) == -1) {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "Bypass needs an eBPF or XDP "
+                    "filter with flow tables on iface %s", aconf->iface);
+        } else {
+            SCLogConfig("Using bypass kernel functionality for AF_PACKET (iface %s)",
+                    aconf->iface);
+            aconf->flags |= AFP_BYPASS;
+        }
+#else
+        SCLogError(SC_ERR_UNIMPLEMENTED, "Bypass is not supported, Suricata "
+                "was built without eBPF support");
+#endif
+    }
+
     if ((ConfGetChildValueIntWithDefault(if_root, if_default, "buffer-size", &value)) == 1) {
         aconf->buffer_size = value;
     } else {
@@ -409,8 +523,9 @@ finalize:
 
     /* try to automagically set the proper number of threads */
     if (aconf->threads == 0) {
-        /* for cluster_flow use core count */
-        if (cluster_type == PACKET_FANOUT_HASH) {
+        /* for cluster_flow and cluster_ebpf use core count */
+        if (cluster_type == PACKET_FANOUT_HASH ||
+                cluster_type == PACKET_FANOUT_EBPF) {
             aconf->threads = (int)UtilCpuGetNumProcessorsOnline();
             SCLogPerf("%u cores, so using %u threads", aconf->threads, aconf->threads);
 
@@ -684,6 +799,14 @@ int RunModeIdsAFPWorkers(void)
         exit(EXIT_FAILURE);
     }
 
+    /* with flow or cpu load balancing each flow sticks to one worker,
+     * so the workers can keep their own flow tables */
+    int private_tables = 0;
+    if (ConfGetBool("flow.private-tables", &private_tables) == 1 &&
+            private_tables == 1) {
+        FlowPrivateTablesEnable();
+    }
+
     ret = RunModeSetLiveCaptureWorkers(ParseAFPConfig,
                                     AFPConfigGeThreadsCount,
                                     "ReceiveAFP",
@@ -36,6 +36,7 @@
 #include "detect-engine-payload.h"
 #include "detect-engine-dcepayload.h"
 #include "detect-engine-uri.h"
+#include "detect-engine-mpm-stream.h"
 #include "detect-engine-hcbd.h"
 #include "detect-engine-hsbd.h"
 #include "detect-engine-hhd.h"
@@ -58,6 +59,7 @@
 #include "flow-manager.h"
 #include "flow-var.h"
 #include "flow-bit.h"
+#include "flow-slab.h"
 #include "pkt-var.h"
 
 #include "host.h"
@@ -111,6 +113,7 @@
 
 #include "util-mpm-ac.h"
 #include "util-mpm-hs.h"
+#include "util-mpm-cache.h"
 
 #include "util-decode-asn1.h"
 
@@ -174,6 +177,8 @@ void RunUnittests(int list_unittests, char *regex_arg)
     SCProtoNameInit();
 
     TagInitCtx();
+    FlowBypassInfoRegister();
+    DetectMpmStreamRegister();
     SCReferenceConfInit();
     SCClassConfInit();
 
@@ -208,6 +213,8 @@ void RunUnittests(int list_unittests, char *regex_arg)
     PoolRegisterTests();
     ByteRegisterTests();
     MpmRegisterTests();
+    MpmCacheRegisterTests();
+    DetectMpmStreamRegisterTests();
     FlowBitRegisterTests();
     HostBitRegisterTests();
     IPPairBitRegisterTests();
@@ -230,6 +237,7 @@ void RunUnittests(int list_unittests, char *regex_arg)
     ConfYamlRegisterTests();
     TmqhFlowRegisterTests();
     FlowRegisterTests();
+    FlowSlabRegisterTests();
     HostRegisterUnittests();
     IPPairRegisterUnittests();
     SCSigRegisterSignatureOrderingTests();
@@ -298,9 +306,11 @@ void RunUnittests(int list_unittests, char *regex_arg)
         uint32_t failed = UtRunTests(regex_arg);
         PacketPoolDestroy();
         UtCleanup();
+        MpmACGlobalCleanup();
 #ifdef BUILD_HYPERSCAN
         MpmHSGlobalCleanup();
 #endif
+        MpmCacheGlobalCleanup();
 #ifdef __SC_CUDA_SUPPORT__
         if (PatternMatchDefaultMatcher() == MPM_AC_CUDA)
             MpmCudaBufferDeSetup();
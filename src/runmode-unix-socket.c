@@ -29,6 +29,7 @@
 #include "unix-manager.h"
 
 #include "detect-engine.h"
+#include "detect-engine-state.h"
 
 #include "flow-manager.h"
 #include "flow-timeout.h"
@@ -375,8 +376,8 @@ TmEcode UnixSocketPcapFilesCheck(void *data)
         }
         PcapFilesFree(cfile);
         StatsInit();
-#ifdef PROFILING
         SCProfilingRulesGlobalInit();
+#ifdef PROFILING
         SCProfilingKeywordsGlobalInit();
         SCProfilingSghsGlobalInit();
         SCProfilingInit();
@@ -386,6 +387,8 @@ TmEcode UnixSocketPcapFilesCheck(void *data)
         IPPairInitConfig(FLOW_QUIET);
         StreamTcpInitConfig(STREAM_VERBOSE);
         AppLayerRegisterGlobalCounters();
+        DetectEngineStateRegisterGlobalCounters();
+        DetectEngineBuildRegisterGlobalCounters();
         RunModeInitializeOutputs();
         StatsSetupPostConfig();
         RunModeDispatch(RUNMODE_PCAP_FILE, NULL);
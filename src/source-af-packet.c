@@ -52,6 +52,9 @@
 #include "util-checksum.h"
 #include "util-ioctl.h"
 #include "util-host-info.h"
+#include "util-ebpf.h"
+#include "flow.h"
+#include "flow-private.h"
 #include "tmqh-packetpool.h"
 #include "source-af-packet.h"
 #include "runmodes.h"
@@ -155,6 +158,10 @@ TmEcode NoAFPSupportExit(ThreadVars *tv, void *initdata, void **data)
 #define AFP_RECONNECT_TIMEOUT 500000
 #define AFP_DOWN_COUNTER_INTERVAL 40
 
+/** max number of packets of a TPACKET_V3 block passed to the pipeline
+ *  at once, see TmThreadsSlotProcessPktBatch() */
+#define AFP_BATCH_SIZE 16
+
 #define POLL_TIMEOUT 100
 
 #ifndef TP_STATUS_USER_BUSY
@@ -166,6 +173,10 @@ TmEcode NoAFPSupportExit(ThreadVars *tv, void *initdata, void **data)
 #define TP_STATUS_VLAN_VALID (1 << 4)
 #endif
 
+#ifndef SO_ATTACH_BPF
+#define SO_ATTACH_BPF 50
+#endif
+
 /** protect pfring_set_bpf_filter, as it is not thread safe */
 static SCMutex afpacket_bpf_set_filter_lock = SCMUTEX_INITIALIZER;
 
@@ -189,6 +200,23 @@ union thdr {
     void *raw;
 };
 
+#ifdef HAVE_TPACKET_V3
+/**
+ * \brief TPACKET_V3 block state for zero copy mode
+ *
+ * Every packet referencing the block holds a reference, as does the
+ * capture thread while it walks the block. The block is handed back to
+ * the kernel when the last reference is dropped, so the whole block is
+ * released at once instead of tracking its packets.
+ */
+typedef struct AFPV3Block_ {
+    SC_ATOMIC_DECLARE(uint32_t, refs);
+    struct tpacket_block_desc *pbd;
+    /** socket reference held for the block */
+    AFPPeer *mpeer;
+} AFPV3Block;
+#endif
+
 /**
  * \brief Structure to hold thread specific variables.
  */
@@ -198,6 +226,10 @@ typedef struct AFPThreadVars_
         char *ring_v2;
         struct iovec *ring_v3;
     };
+#ifdef HAVE_TPACKET_V3
+    /** per block state for zero copy, indexed like ring_v3 */
+    AFPV3Block *v3_blocks;
+#endif
 
     /* counters */
     uint64_t pkts;
@@ -243,6 +275,13 @@ typedef struct AFPThreadVars_
     int buffer_size;
     /* Filter */
     char *bpf_filter;
+    int ebpf_lb_fd;
+    int ebpf_filter_fd;
+#ifdef HAVE_PACKET_EBPF
+    /* bypass tables */
+    int v4_map_fd;
+    int v6_map_fd;
+#endif
 
     int promisc;
 
@@ -277,10 +316,12 @@ TmEcode DecodeAFPThreadDeinit(ThreadVars *tv, void *data);
 TmEcode DecodeAFP(ThreadVars *, Packet *, void *, PacketQueue *, PacketQueue *);
 
 TmEcode AFPSetBPFFilter(AFPThreadVars *ptv);
+static TmEcode AFPSetEBPFFilter(AFPThreadVars *ptv);
 static int AFPGetIfnumByDev(int fd, const char *ifname, int verbose);
 static int AFPGetDevFlags(int fd, const char *ifname);
 static int AFPDerefSocket(AFPPeer* peer);
 static int AFPRefSocket(AFPPeer* peer);
+static inline void AFPSetBypass(AFPThreadVars *ptv, Packet *p);
 
 /**
  * \brief Registration Function for RecieveAFP.
@@ -550,6 +591,179 @@ static inline void AFPDumpCounters(AFPThreadVars *ptv)
  * \param user pointer to AFPThreadVars
  * \retval TM_ECODE_FAILED on failure and TM_ECODE_OK on success
  */
+#ifdef HAVE_PACKET_EBPF
+/** kernel bypass state of a flow, key 0 is the to server direction */
+typedef struct AFPBypassData_ {
+    int fd;
+    int ipv6;
+    union {
+        struct flowv4_keys v4[2];
+        struct flowv6_keys v6[2];
+    } keys;
+    /** kernel counters at the last update */
+    uint64_t pkts[2];
+    uint64_t bytes[2];
+} AFPBypassData;
+
+/**
+ * \brief update the flow with the counters of the bypass table
+ *
+ * Called by the flow manager, the flow is locked.
+ *
+ * \retval 1 if the kernel still sees packets for the flow, 0 otherwise
+ */
+static int AFPBypassUpdate(Flow *f, void *data, time_t tsec)
+{
+    AFPBypassData *d = (AFPBypassData *)data;
+    FlowBypassInfo *fc = FlowGetBypassInfo(f);
+    int active = 0;
+
+    for (int i = 0; i < 2; i++) {
+        void *key = d->ipv6 ? (void *)&d->keys.v6[i] : (void *)&d->keys.v4[i];
+        uint64_t pkts, bytes;
+        uint32_t idle;
+
+        if (EBPFGetFlowStats(d->fd, key, &pkts, &bytes, &idle) != 0)
+            continue;
+
+        if (fc != NULL && pkts >= d->pkts[i] && bytes >= d->bytes[i]) {
+            if (i == 0) {
+                fc->todstpktcnt += pkts - d->pkts[i];
+                fc->todstbytecnt += bytes - d->bytes[i];
+            } else {
+                fc->tosrcpktcnt += pkts - d->pkts[i];
+                fc->tosrcbytecnt += bytes - d->bytes[i];
+            }
+        }
+        d->pkts[i] = pkts;
+        d->bytes[i] = bytes;
+
+        if (idle < FLOW_BYPASSED_TIMEOUT)
+            active = 1;
+    }
+    return active;
+}
+
+/** \brief remove the flow from the bypass table when it is freed */
+static void AFPBypassFree(void *data)
+{
+    AFPBypassData *d = (AFPBypassData *)data;
+    if (d == NULL)
+        return;
+
+    for (int i = 0; i < 2; i++) {
+        if (d->ipv6)
+            EBPFDeleteKey(d->fd, &d->keys.v6[i]);
+        else
+            EBPFDeleteKey(d->fd, &d->keys.v4[i]);
+    }
+    SCFree(d);
+}
+
+/**
+ * \brief bypass a flow in the kernel
+ *
+ * Both directions of the flow are added to the bypass table of the
+ * interface, the eBPF filter then drops the packets of the flow. The
+ * flow manager polls the table through the bypass info of the flow to
+ * keep the flow alive and account for the dropped packets.
+ *
+ * \retval 1 if the flow is bypassed in the kernel, 0 otherwise
+ */
+static int AFPBypassCallback(Packet *p)
+{
+    if (!(PKT_IS_TCP(p) || PKT_IS_UDP(p)))
+        return 0;
+
+    /* the eBPF programs don't decode tunnels or vlan headers */
+    if (IS_TUNNEL_PKT(p) || p->vlan_idx != 0)
+        return 0;
+
+    int fd;
+    if (PKT_IS_IPV4(p))
+        fd = p->afp_v.v4_map_fd;
+    else if (PKT_IS_IPV6(p))
+        fd = p->afp_v.v6_map_fd;
+    else
+        return 0;
+    if (fd == -1)
+        return 0;
+
+    AFPBypassData *d = SCCalloc(1, sizeof(*d));
+    if (unlikely(d == NULL))
+        return 0;
+    d->fd = fd;
+
+    /* key 0 is the to server direction */
+    int s = PKT_IS_TOCLIENT(p) ? 1 : 0;
+    int r;
+    if (PKT_IS_IPV4(p)) {
+        struct flowv4_keys *keys = d->keys.v4;
+        keys[s].src = GET_IPV4_SRC_ADDR_U32(p);
+        keys[s].dst = GET_IPV4_DST_ADDR_U32(p);
+        keys[s].port16[0] = htons(p->sp);
+        keys[s].port16[1] = htons(p->dp);
+        keys[s].ip_proto = p->proto;
+
+        keys[!s].src = keys[s].dst;
+        keys[!s].dst = keys[s].src;
+        keys[!s].port16[0] = keys[s].port16[1];
+        keys[!s].port16[1] = keys[s].port16[0];
+        keys[!s].ip_proto = p->proto;
+
+        r = EBPFBypassFlowV4(fd, keys, 2);
+    } else {
+        struct flowv6_keys *keys = d->keys.v6;
+        d->ipv6 = 1;
+        memcpy(keys[s].src, GET_IPV6_SRC_ADDR(p), sizeof(keys[s].src));
+        memcpy(keys[s].dst, GET_IPV6_DST_ADDR(p), sizeof(keys[s].dst));
+        keys[s].port16[0] = htons(p->sp);
+        keys[s].port16[1] = htons(p->dp);
+        keys[s].ip_proto = p->proto;
+
+        memcpy(keys[!s].src, keys[s].dst, sizeof(keys[!s].src));
+        memcpy(keys[!s].dst, keys[s].src, sizeof(keys[!s].dst));
+        keys[!s].port16[0] = keys[s].port16[1];
+        keys[!s].port16[1] = keys[s].port16[0];
+        keys[!s].ip_proto = p->proto;
+
+        r = EBPFBypassFlowV6(fd, keys, 2);
+    }
+
+    if (r != 1) {
+        SCFree(d);
+        return 0;
+    }
+
+    /* the table entries are polled and removed through the bypass info,
+     * without it (flow memcap) the flow is bypassed locally instead */
+    FlowBypassInfo *fc = p->flow ? FlowSetupBypassInfo(p->flow) : NULL;
+    if (fc == NULL) {
+        AFPBypassFree(d);
+        return 0;
+    }
+    if (fc->bypass_data == NULL) {
+        fc->BypassUpdate = AFPBypassUpdate;
+        fc->BypassFree = AFPBypassFree;
+        fc->bypass_data = d;
+    } else {
+        SCFree(d);
+    }
+    return 1;
+}
+#endif
+
+static inline void AFPSetBypass(AFPThreadVars *ptv, Packet *p)
+{
+#ifdef HAVE_PACKET_EBPF
+    if (ptv->flags & AFP_BYPASS) {
+        p->BypassPacketsFlow = AFPBypassCallback;
+        p->afp_v.v4_map_fd = ptv->v4_map_fd;
+        p->afp_v.v6_map_fd = ptv->v6_map_fd;
+    }
+#endif
+}
+
 int AFPRead(AFPThreadVars *ptv)
 {
     Packet *p = NULL;
@@ -605,6 +819,7 @@ int AFPRead(AFPThreadVars *ptv)
 
     ptv->pkts++;
     p->livedev = ptv->livedev;
+    AFPSetBypass(ptv, p);
 
     /* add forged header */
     if (ptv->cooked) {
@@ -728,6 +943,25 @@ cleanup:
     AFPV_CLEANUP(&p->afp_v);
 }
 
+#ifdef HAVE_TPACKET_V3
+static inline void AFPFlushBlock(struct tpacket_block_desc *pbd)
+{
+    pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+}
+
+/**
+ * \brief drop a reference to a block, handing it back to the kernel
+ *        if it was the last one
+ */
+static inline void AFPV3BlockDeref(AFPV3Block *blk)
+{
+    if (SC_ATOMIC_SUB(blk->refs, 1) == 0) {
+        AFPFlushBlock(blk->pbd);
+        AFPDerefSocket(blk->mpeer);
+    }
+}
+#endif
+
 void AFPReleasePacketV3(Packet *p)
 {
     /* Need to be in copy mode and need to detect early release
@@ -735,6 +969,13 @@ void AFPReleasePacketV3(Packet *p)
     if ((p->afp_v.copy_mode != AFP_COPY_MODE_NONE) && !PKT_IS_PSEUDOPKT(p)) {
         AFPWritePacket(p);
     }
+#ifdef HAVE_TPACKET_V3
+    /* data is no longer used, the block may go back to the kernel */
+    if (p->afp_v.relptr != NULL) {
+        AFPV3BlockDeref((AFPV3Block *)p->afp_v.relptr);
+    }
+#endif
+    AFPV_CLEANUP(&p->afp_v);
     PacketFreeOrRelease(p);
 }
 
@@ -820,6 +1061,7 @@ int AFPReadFromRing(AFPThreadVars *ptv)
 
         ptv->pkts++;
         p->livedev = ptv->livedev;
+        AFPSetBypass(ptv, p);
         p->datalink = ptv->datalink;
 
         if (h.h2->tp_len > h.h2->tp_snaplen) {
@@ -912,12 +1154,14 @@ next_frame:
 }
 
 #ifdef HAVE_TPACKET_V3
-static inline void AFPFlushBlock(struct tpacket_block_desc *pbd)
-{
-    pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
-}
-
-static inline int AFPParsePacketV3(AFPThreadVars *ptv, struct tpacket_block_desc *pbd, struct tpacket3_hdr *ppd)
+/**
+ * \brief Set up a packet for a TPACKET_V3 frame
+ *
+ * The packet is not processed here but returned in 'rp', so that
+ * AFPWalkBlock() can pass a batch of them to the pipeline at once.
+ */
+static inline int AFPParsePacketV3(AFPThreadVars *ptv, AFPV3Block *blk,
+        struct tpacket3_hdr *ppd, Packet **rp)
 {
     Packet *p = PacketGetFromQueueOrAlloc();
     if (p == NULL) {
@@ -927,6 +1171,7 @@ static inline int AFPParsePacketV3(AFPThreadVars *ptv, struct tpacket_block_desc
 
     ptv->pkts++;
     p->livedev = ptv->livedev;
+    AFPSetBypass(ptv, p);
     p->datalink = ptv->datalink;
 
     if (ptv->flags & AFP_ZERO_COPY) {
@@ -934,10 +1179,11 @@ static inline int AFPParsePacketV3(AFPThreadVars *ptv, struct tpacket_block_desc
             TmqhOutputPacketpool(ptv->tv, p);
             SCReturnInt(AFP_FAILURE);
         }
-        p->afp_v.relptr = pbd;
+        /* the packet holds a block reference, not a socket one */
+        (void) SC_ATOMIC_ADD(blk->refs, 1);
+        p->afp_v.relptr = blk;
         p->ReleasePacket = AFPReleasePacketV3;
         p->afp_v.mpeer = ptv->mpeer;
-        AFPRefSocket(ptv->mpeer);
 
         p->afp_v.copy_mode = ptv->copy_mode;
         if (p->afp_v.copy_mode != AFP_COPY_MODE_NONE) {
@@ -975,26 +1221,50 @@ static inline int AFPParsePacketV3(AFPThreadVars *ptv, struct tpacket_block_desc
         }
     }
 
-    if (TmThreadsSlotProcessPkt(ptv->tv, ptv->slot, p) != TM_ECODE_OK) {
-        TmqhOutputPacketpool(ptv->tv, p);
-        SCReturnInt(AFP_FAILURE);
-    }
-
+    *rp = p;
     SCReturnInt(AFP_READ_OK);
 }
 
-static inline int AFPWalkBlock(AFPThreadVars *ptv, struct tpacket_block_desc *pbd)
+/**
+ * \brief Process all packets of a block, in batches of AFP_BATCH_SIZE
+ *
+ * In zero copy mode the packets reference the block through 'blk'.
+ */
+static inline int AFPWalkBlock(AFPThreadVars *ptv, struct tpacket_block_desc *pbd,
+        AFPV3Block *blk)
 {
     int num_pkts = pbd->hdr.bh1.num_pkts, i;
     uint8_t *ppd;
+    Packet *batch[AFP_BATCH_SIZE];
+    uint32_t batch_cnt = 0;
 
     ppd = (uint8_t *)pbd + pbd->hdr.bh1.offset_to_first_pkt;
     for (i = 0; i < num_pkts; ++i) {
-        if (unlikely(AFPParsePacketV3(ptv, pbd,
-                             (struct tpacket3_hdr *)ppd) == AFP_FAILURE)) {
+        if (unlikely(AFPParsePacketV3(ptv, blk,
+                             (struct tpacket3_hdr *)ppd, &batch[batch_cnt]) == AFP_FAILURE)) {
+            /* packets already set up are still processed */
+            if (batch_cnt > 0) {
+                TmThreadsSlotProcessPktBatch(ptv->tv, ptv->slot, batch, batch_cnt);
+            }
             SCReturnInt(AFP_READ_FAILURE);
         }
         ppd = ppd + ((struct tpacket3_hdr *)ppd)->tp_next_offset;
+
+        if (++batch_cnt == AFP_BATCH_SIZE) {
+            /* on failure the batch packets are released by the callee */
+            if (TmThreadsSlotProcessPktBatch(ptv->tv, ptv->slot,
+                        batch, batch_cnt) != TM_ECODE_OK) {
+                SCReturnInt(AFP_READ_FAILURE);
+            }
+            batch_cnt = 0;
+        }
+    }
+
+    if (batch_cnt > 0) {
+        if (TmThreadsSlotProcessPktBatch(ptv->tv, ptv->slot,
+                    batch, batch_cnt) != TM_ECODE_OK) {
+            SCReturnInt(AFP_READ_FAILURE);
+        }
     }
 
     SCReturnInt(AFP_READ_OK);
@@ -1029,12 +1299,35 @@ int AFPReadFromRingV3(AFPThreadVars *ptv)
             SCReturnInt(AFP_READ_OK);
         }
 
-        if (unlikely(AFPWalkBlock(ptv, pbd) != AFP_READ_OK)) {
+        AFPV3Block *blk = NULL;
+        if (ptv->flags & AFP_ZERO_COPY) {
+            blk = &ptv->v3_blocks[ptv->frame_offset];
+            /* we walked this block before, but some of its packets are
+             * still in use. Wait for them. */
+            if (SC_ATOMIC_GET(blk->refs) != 0) {
+                SCReturnInt(AFP_READ_OK);
+            }
+            /* reference held by us while walking the block */
+            (void) SC_ATOMIC_SET(blk->refs, 1);
+            blk->pbd = pbd;
+            blk->mpeer = ptv->mpeer;
+            AFPRefSocket(ptv->mpeer);
+        }
+
+        int r = AFPWalkBlock(ptv, pbd, blk);
+
+        /* release the whole block. In zero copy mode this happens when
+         * the last packet using it is released, normally right here as
+         * the batches have gone through the whole pipeline. */
+        if (blk != NULL) {
+            AFPV3BlockDeref(blk);
+        } else {
             AFPFlushBlock(pbd);
+        }
+        if (unlikely(r != AFP_READ_OK)) {
             SCReturnInt(AFP_READ_FAILURE);
         }
 
-        AFPFlushBlock(pbd);
         ptv->frame_offset = (ptv->frame_offset + 1) % ptv->req3.tp_block_nr;
         /* return to maintenance task after one loop on the ring */
         if (ptv->frame_offset == 0) {
@@ -1091,10 +1384,14 @@ void AFPSwitchState(AFPThreadVars *ptv, int state)
     if (state == AFP_STATE_DOWN) {
 #ifdef HAVE_TPACKET_V3
         if (ptv->flags & AFP_TPACKET_V3) {
-            if (!ptv->ring_v3) {
+            if (ptv->ring_v3) {
                 SCFree(ptv->ring_v3);
                 ptv->ring_v3 = NULL;
             }
+            if (ptv->v3_blocks) {
+                SCFree(ptv->v3_blocks);
+                ptv->v3_blocks = NULL;
+            }
         } else {
 #endif
             if (ptv->ring_v2) {
@@ -1769,6 +2066,16 @@ static int AFPSetupRing(AFPThreadVars *ptv, char *devname)
             ptv->ring_v3[i].iov_base = ring_buf + (i * ptv->req3.tp_block_size);
             ptv->ring_v3[i].iov_len = ptv->req3.tp_block_size;
         }
+        if (ptv->flags & AFP_ZERO_COPY) {
+            ptv->v3_blocks = SCCalloc(ptv->req3.tp_block_nr, sizeof(AFPV3Block));
+            if (ptv->v3_blocks == NULL) {
+                SCLogError(SC_ERR_MEM_ALLOC, "Unable to malloc ptv v3_blocks");
+                goto postmmap_err;
+            }
+            for (i = 0; i < ptv->req3.tp_block_nr; ++i) {
+                SC_ATOMIC_INIT(ptv->v3_blocks[i].refs);
+            }
+        }
     } else {
 #endif
         /* allocate a ring for each frame header pointer*/
@@ -1801,6 +2108,12 @@ postmmap_err:
         SCFree(ptv->ring_v2);
     if (ptv->ring_v3)
         SCFree(ptv->ring_v3);
+#ifdef HAVE_TPACKET_V3
+    if (ptv->v3_blocks) {
+        SCFree(ptv->v3_blocks);
+        ptv->v3_blocks = NULL;
+    }
+#endif
 mmap_err:
     /* Packet mmap does the cleaning when socket is closed */
     return AFP_FATAL_ERROR;
@@ -1927,6 +2240,19 @@ static int AFPCreateSocket(AFPThreadVars *ptv, char *devname, int verbose)
                        strerror(errno));
             goto socket_err;
         }
+#ifdef HAVE_PACKET_EBPF
+        /* the eBPF program returns the index of the socket in the group */
+        if (ptv->ebpf_lb_fd != -1) {
+            r = setsockopt(ptv->socket, SOL_PACKET, PACKET_FANOUT_DATA,
+                    &ptv->ebpf_lb_fd, sizeof(ptv->ebpf_lb_fd));
+            if (r < 0) {
+                SCLogError(SC_ERR_AFP_CREATE,
+                        "Couldn't set eBPF load balancing, error %s",
+                        strerror(errno));
+                goto socket_err;
+            }
+        }
+#endif
     }
 #endif
 
@@ -1967,10 +2293,18 @@ static int AFPCreateSocket(AFPThreadVars *ptv, char *devname, int verbose)
     }
 
     TmEcode rc;
-    rc = AFPSetBPFFilter(ptv);
-    if (rc == TM_ECODE_FAILED) {
-        SCLogError(SC_ERR_AFP_CREATE, "Set AF_PACKET bpf filter \"%s\" failed.", ptv->bpf_filter);
-        goto frame_err;
+    if (ptv->ebpf_filter_fd != -1) {
+        rc = AFPSetEBPFFilter(ptv);
+        if (rc == TM_ECODE_FAILED) {
+            SCLogError(SC_ERR_AFP_CREATE, "Set AF_PACKET eBPF filter failed.");
+            goto frame_err;
+        }
+    } else {
+        rc = AFPSetBPFFilter(ptv);
+        if (rc == TM_ECODE_FAILED) {
+            SCLogError(SC_ERR_AFP_CREATE, "Set AF_PACKET bpf filter \"%s\" failed.", ptv->bpf_filter);
+            goto frame_err;
+        }
     }
 
     /* Init is ok */
@@ -1992,6 +2326,19 @@ error:
     return -ret;
 }
 
+/** \brief attach the eBPF filter loaded for the interface */
+static TmEcode AFPSetEBPFFilter(AFPThreadVars *ptv)
+{
+    SCLogInfo("Using eBPF filter on iface '%s'", ptv->iface);
+    if (setsockopt(ptv->socket, SOL_SOCKET, SO_ATTACH_BPF,
+                &ptv->ebpf_filter_fd, sizeof(ptv->ebpf_filter_fd)) != 0) {
+        SCLogError(SC_ERR_AFP_CREATE, "Failed to attach eBPF filter: %s",
+                strerror(errno));
+        return TM_ECODE_FAILED;
+    }
+    return TM_ECODE_OK;
+}
+
 TmEcode AFPSetBPFFilter(AFPThreadVars *ptv)
 {
     struct bpf_program filter;
@@ -2098,9 +2445,30 @@ TmEcode ReceiveAFPThreadInit(ThreadVars *tv, void *initdata, void **data)
 #endif
     ptv->flags = afpconfig->flags;
 
+#ifdef HAVE_TPACKET_V3
+    /* a TPACKET_V3 block goes back to the kernel when all its packets are
+     * released. If packets are passed on to other threads they would hold
+     * on to the blocks, so copy them instead. */
+    if ((ptv->flags & AFP_TPACKET_V3) && (ptv->flags & AFP_ZERO_COPY) &&
+            tv->tmqh_out != TmqhOutputPacketpool) {
+        SCLogConfig("%s: packets outlive the capture thread, "
+                "disabling zero copy for tpacket v3", ptv->iface);
+        ptv->flags &= ~AFP_ZERO_COPY;
+    }
+#endif
+
     if (afpconfig->bpf_filter) {
         ptv->bpf_filter = afpconfig->bpf_filter;
     }
+    ptv->ebpf_lb_fd = afpconfig->ebpf_lb_fd;
+    ptv->ebpf_filter_fd = afpconfig->ebpf_filter_fd;
+
+#ifdef HAVE_PACKET_EBPF
+    if (ptv->flags & AFP_BYPASS) {
+        ptv->v4_map_fd = EBPFGetMapFDByName(ptv->iface, EBPF_FLOW_TABLE_V4);
+        ptv->v6_map_fd = EBPFGetMapFDByName(ptv->iface, EBPF_FLOW_TABLE_V6);
+    }
+#endif
 
 #ifdef PACKET_STATISTICS
     ptv->capture_kernel_packets = StatsRegisterCounter("capture.kernel_packets",
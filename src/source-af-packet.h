@@ -41,6 +41,15 @@
 #else /* HAVE_PACKET_FANOUT */
 #include <linux/if_packet.h>
 #endif /* HAVE_PACKET_FANOUT */
+
+/* eBPF fanout, may be missing in older headers */
+#ifndef PACKET_FANOUT_EBPF
+#define PACKET_FANOUT_EBPF             7
+#endif
+#ifndef PACKET_FANOUT_DATA
+#define PACKET_FANOUT_DATA             22
+#endif
+
 #include "queue.h"
 
 /* value for flags */
@@ -51,6 +60,7 @@
 #define AFP_TPACKET_V3 (1<<4)
 #define AFP_VLAN_DISABLED (1<<5)
 #define AFP_MMAP_LOCKED (1<<6)
+#define AFP_BYPASS   (1<<7)
 
 #define AFP_COPY_MODE_NONE  0
 #define AFP_COPY_MODE_TAP   1
@@ -88,6 +98,14 @@ typedef struct AFPIfaceConfig_
     int copy_mode;
     ChecksumValidationMode checksum_mode;
     char *bpf_filter;
+    /* eBPF programs, fds are -1 if not used */
+    char *ebpf_lb_file;
+    int ebpf_lb_fd;
+    char *ebpf_filter_file;
+    int ebpf_filter_fd;
+    char *xdp_filter_file;
+    int xdp_filter_fd;
+    uint8_t xdp_mode;
     char *out_iface;
     SC_ATOMIC_DECLARE(unsigned int, ref);
     void (*DerefFunc)(void *);
@@ -126,6 +144,11 @@ typedef struct AFPPacketVars_
      */
     AFPPeer *mpeer;
     uint8_t copy_mode;
+#ifdef HAVE_PACKET_EBPF
+    /** bypass tables of the capture interface */
+    int v4_map_fd;
+    int v6_map_fd;
+#endif
 } AFPPacketVars;
 
 #define AFPV_CLEANUP(afpv) do {           \
@@ -501,6 +501,18 @@ static void NFQReleasePacket(Packet *p)
     PacketFreeOrRelease(p);
 }
 
+/**
+ * \brief bypass a flow by setting the bypass mark on the verdict
+ *
+ * The netfilter ruleset has to save the mark to the connection and
+ * accept marked connections before they reach the queue. Netfilter keeps
+ * no per flow counters we could poll, so no update or free callbacks are
+ * set in the flow's bypass info: the flow manager times the flow out
+ * with the bypassed timeout and the flow records only count the packets
+ * that were queued.
+ *
+ * \retval 1 always, the mark is set on the packet's verdict
+ */
 static int NFQBypassCallback(Packet *p)
 {
     if (IS_TUNNEL_PKT(p)) {
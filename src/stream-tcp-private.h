@@ -27,6 +27,7 @@
 #include "decode.h"
 #include "util-pool.h"
 #include "util-pool-thread.h"
+#include "util-streaming-buffer.h"
 
 #define STREAMTCP_QUEUE_FLAG_TS     0x01
 #define STREAMTCP_QUEUE_FLAG_WS     0x02
@@ -51,10 +52,9 @@ typedef struct StreamTcpSackRecord_ {
 } StreamTcpSackRecord;
 
 typedef struct TcpSegment_ {
-    uint8_t *payload;
     uint16_t payload_len;       /**< actual size of the payload */
-    uint16_t pool_size;         /**< size of the memory */
     uint32_t seq;
+    StreamingBufferSegment sbseg; /**< data location in TcpStream::sb */
     struct TcpSegment_ *next;
     struct TcpSegment_ *prev;
     /* coccinelle: TcpSegment:flags:SEGMENTTCP_FLAG */
@@ -82,6 +82,9 @@ typedef struct TcpStream_ {
     uint32_t ra_app_base_seq;       /**< reassembled seq. We've reassembled up to this point. */
     uint32_t ra_raw_base_seq;       /**< reassembled seq. We've reassembled up to this point. */
 
+    uint32_t base_seq;              /**< seq of the data at sb.stream_offset */
+    StreamingBuffer sb;             /**< segment data of this stream */
+
     TcpSegment *seg_list;           /**< list of TCP segments that are not yet (fully) used in reassembly */
     TcpSegment *seg_list_tail;      /**< Last segment in the reassembled stream seg list*/
 
@@ -46,6 +46,7 @@
 #include "util-unittest-helper.h"
 #include "util-byte.h"
 #include "util-device.h"
+#include "util-misc.h"
 
 #include "stream-tcp.h"
 #include "stream-tcp-private.h"
@@ -66,27 +67,16 @@
 
 #define PSEUDO_PACKET_PAYLOAD_SIZE  65416 /* 64 Kb minus max IP and TCP header */
 
-#ifdef DEBUG
-static SCMutex segment_pool_memuse_mutex;
-static uint64_t segment_pool_memuse = 0;
-static uint64_t segment_pool_memcnt = 0;
-#endif
-
-/* We define several pools with prealloced segments with fixed size
- * payloads. We do this to prevent having to do an SCMalloc call for every
- * data segment we receive, which would be a large performance penalty.
- * The cost is in memory of course. The number of pools and the properties
- * of the pools are determined by the yaml. */
-static int segment_pool_num = 0;
-static Pool **segment_pool = NULL;
-static SCMutex *segment_pool_mutex = NULL;
-static uint16_t *segment_pool_pktsizes = NULL;
+/* We use a pool of prealloced segments. We do this to prevent having to
+ * do an SCMalloc call for every data segment we receive, which would be a
+ * large performance penalty. The segment data itself lives in the
+ * StreamingBuffer of the stream the segment belongs to. */
+static Pool *segment_pool = NULL;
+static SCMutex segment_pool_mutex;
 #ifdef DEBUG
 static SCMutex segment_pool_cnt_mutex;
 static uint64_t segment_pool_cnt = 0;
 #endif
-/* index to the right pool for all packet sizes. */
-static uint16_t segment_pool_idx[65536]; /* O(1) lookups of the pool */
 static int check_overlap_different_data = 0;
 
 /* Memory use counter */
@@ -99,13 +89,17 @@ static int HandleSegmentStartsAtSameListSegment(ThreadVars *, TcpReassemblyThrea
                                     TcpStream *, TcpSegment *, TcpSegment *, Packet *);
 static int HandleSegmentStartsAfterListSegment(ThreadVars *, TcpReassemblyThreadCtx *,
                                     TcpStream *, TcpSegment *, TcpSegment *, Packet *);
-void StreamTcpSegmentDataReplace(TcpSegment *, TcpSegment *, uint32_t, uint16_t);
-void StreamTcpSegmentDataCopy(TcpSegment *, TcpSegment *);
+void StreamTcpSegmentDataReplace(TcpStream *, TcpSegment *, TcpSegment *, Packet *,
+                                 uint32_t, uint16_t);
+void StreamTcpSegmentDataCopy(TcpStream *, TcpSegment *);
 TcpSegment* StreamTcpGetSegment(ThreadVars *tv, TcpReassemblyThreadCtx *, uint16_t);
 void StreamTcpCreateTestPacket(uint8_t *, uint8_t, uint8_t, uint8_t);
 void StreamTcpReassemblePseudoPacketCreate(TcpStream *, Packet *, PacketQueue *);
-static int StreamTcpSegmentDataCompare(TcpSegment *dst_seg, TcpSegment *src_seg,
+static int StreamTcpSegmentDataCompare(TcpStream *stream, TcpSegment *dst_seg,
+                                 TcpSegment *src_seg, Packet *p,
                                  uint32_t start_point, uint16_t len);
+static void StreamTcpSegmentDataWrite(TcpStream *, TcpSegment *, Packet *);
+static int StreamTcpReassemblePrepareSegmentData(TcpStream *, TcpSegment *, Packet *);
 
 void StreamTcpReassembleConfigEnableOverlapCheck(void)
 {
@@ -173,36 +167,19 @@ void *TcpSegmentPoolAlloc()
     return seg;
 }
 
-int TcpSegmentPoolInit(void *data, void *payload_len)
+int TcpSegmentPoolInit(void *data, void *initdata)
 {
     TcpSegment *seg = (TcpSegment *) data;
-    uint16_t size = *((uint16_t *) payload_len);
 
     /* do this before the can bail, so TcpSegmentPoolCleanup
      * won't have uninitialized memory to consider. */
     memset(seg, 0, sizeof (TcpSegment));
 
-    if (StreamTcpReassembleCheckMemcap((uint32_t)size + (uint32_t)sizeof(TcpSegment)) == 0) {
-        return 0;
-    }
-
-    seg->pool_size = size;
-    seg->payload_len = seg->pool_size;
-
-    seg->payload = SCMalloc(seg->payload_len);
-    if (seg->payload == NULL) {
+    if (StreamTcpReassembleCheckMemcap((uint32_t)sizeof(TcpSegment)) == 0) {
         return 0;
     }
 
-#ifdef DEBUG
-    SCMutexLock(&segment_pool_memuse_mutex);
-    segment_pool_memuse += seg->payload_len;
-    segment_pool_memcnt++;
-    SCLogDebug("segment_pool_memcnt %"PRIu64"", segment_pool_memcnt);
-    SCMutexUnlock(&segment_pool_memuse_mutex);
-#endif
-
-    StreamTcpReassembleIncrMemuse((uint32_t)seg->pool_size + sizeof(TcpSegment));
+    StreamTcpReassembleIncrMemuse((uint32_t)sizeof(TcpSegment));
     return 1;
 }
 
@@ -212,20 +189,127 @@ void TcpSegmentPoolCleanup(void *ptr)
     if (ptr == NULL)
         return;
 
-    TcpSegment *seg = (TcpSegment *) ptr;
+    StreamTcpReassembleDecrMemuse((uint32_t)sizeof(TcpSegment));
+    return;
+}
 
-    StreamTcpReassembleDecrMemuse((uint32_t)seg->pool_size + sizeof(TcpSegment));
+/** \brief StreamingBuffer memory callbacks, so that the per stream
+ *         buffers are accounted against the reassembly memcap. */
+static void *StreamTcpReassembleSbMalloc(size_t size)
+{
+    if (StreamTcpReassembleCheckMemcap((uint32_t)size) == 0)
+        return NULL;
 
-#ifdef DEBUG
-    SCMutexLock(&segment_pool_memuse_mutex);
-    segment_pool_memuse -= seg->pool_size;
-    segment_pool_memcnt--;
-    SCLogDebug("segment_pool_memcnt %"PRIu64"", segment_pool_memcnt);
-    SCMutexUnlock(&segment_pool_memuse_mutex);
-#endif
+    void *ptr = SCMalloc(size);
+    if (ptr == NULL)
+        return NULL;
 
-    SCFree(seg->payload);
-    return;
+    StreamTcpReassembleIncrMemuse((uint64_t)size);
+    return ptr;
+}
+
+static void *StreamTcpReassembleSbCalloc(size_t n, size_t size)
+{
+    if (StreamTcpReassembleCheckMemcap((uint32_t)(n * size)) == 0)
+        return NULL;
+
+    void *ptr = SCCalloc(n, size);
+    if (ptr == NULL)
+        return NULL;
+
+    StreamTcpReassembleIncrMemuse((uint64_t)(n * size));
+    return ptr;
+}
+
+static void *StreamTcpReassembleSbRealloc(void *optr, size_t orig_size, size_t size)
+{
+    if (size > orig_size) {
+        if (StreamTcpReassembleCheckMemcap((uint32_t)(size - orig_size)) == 0)
+            return NULL;
+    }
+
+    void *nptr = SCRealloc(optr, size);
+    if (nptr == NULL)
+        return NULL;
+
+    if (size > orig_size) {
+        StreamTcpReassembleIncrMemuse((uint64_t)(size - orig_size));
+    } else {
+        StreamTcpReassembleDecrMemuse((uint64_t)(orig_size - size));
+    }
+    return nptr;
+}
+
+static void StreamTcpReassembleSbFree(void *ptr, size_t size)
+{
+    SCFree(ptr);
+    StreamTcpReassembleDecrMemuse((uint64_t)size);
+}
+
+/**
+ *  \brief get the stream's data buffer, making sure it has a config
+ */
+static inline StreamingBuffer *StreamTcpGetStreamingBuffer(TcpStream *stream)
+{
+    if (stream->sb.cfg == NULL)
+        stream->sb.cfg = &stream_config.sbcnf;
+    return &stream->sb;
+}
+
+/**
+ *  \brief get the absolute StreamingBuffer offset for a sequence number
+ *
+ *  \note seq must not be before TcpStream::base_seq
+ */
+static inline uint64_t StreamTcpSeqToOffset(const TcpStream *stream, uint32_t seq)
+{
+    return stream->sb.stream_offset + (uint32_t)(seq - stream->base_seq);
+}
+
+/**
+ *  \brief get the data of a segment
+ *
+ *  \param stream stream the segment is part of
+ *  \param seg the segment
+ *  \param data pointer to the data, NULL if not available
+ *  \param data_len length of the data
+ */
+void StreamTcpSegmentGetData(const TcpStream *stream, const TcpSegment *seg,
+                             const uint8_t **data, uint32_t *data_len)
+{
+    StreamingBufferSegmentGetData(&stream->sb, &seg->sbseg, data, data_len);
+}
+
+/**
+ *  \brief slide the stream's data buffer forward so that it starts at
+ *         the first segment in the list, or empty it if the list is
+ *         empty.
+ *
+ *  Called after segments have been removed from the list.
+ */
+static void StreamTcpReassembleSlideBuffer(TcpStream *stream)
+{
+    if (stream->sb.buf == NULL && stream->sb.regions == NULL)
+        return;
+
+    uint64_t offset;
+    if (stream->seg_list != NULL) {
+        offset = stream->seg_list->sbseg.stream_offset;
+    } else {
+        /* regions only hold segment data, so they are unused now. The
+         * next segment resets base_seq. */
+        if (stream->sb.regions != NULL) {
+            StreamingBufferClear(&stream->sb);
+            return;
+        }
+        offset = stream->sb.stream_offset + stream->sb.buf_offset;
+    }
+
+    if (offset > stream->sb.stream_offset) {
+        uint32_t slide = (uint32_t)(offset - stream->sb.stream_offset);
+        StreamingBufferSlideToOffset(&stream->sb, offset);
+        stream->base_seq += slide;
+    }
 }
 
 /**
@@ -241,12 +325,11 @@ void StreamTcpSegmentReturntoPool(TcpSegment *seg)
     seg->next = NULL;
     seg->prev = NULL;
 
-    uint16_t idx = segment_pool_idx[seg->pool_size];
-    SCMutexLock(&segment_pool_mutex[idx]);
-    PoolReturn(segment_pool[idx], (void *) seg);
-    SCLogDebug("segment_pool[%"PRIu16"]->empty_stack_size %"PRIu32"",
-               idx,segment_pool[idx]->empty_stack_size);
-    SCMutexUnlock(&segment_pool_mutex[idx]);
+    SCMutexLock(&segment_pool_mutex);
+    PoolReturn(segment_pool, (void *) seg);
+    SCLogDebug("segment_pool->empty_stack_size %"PRIu32"",
+               segment_pool->empty_stack_size);
+    SCMutexUnlock(&segment_pool_mutex);
 
 #ifdef DEBUG
     SCMutexLock(&segment_pool_cnt_mutex);
@@ -265,9 +348,6 @@ void StreamTcpReturnStreamSegments (TcpStream *stream)
     TcpSegment *seg = stream->seg_list;
     TcpSegment *next_seg;
 
-    if (seg == NULL)
-        return;
-
     while (seg != NULL) {
         next_seg = seg->next;
         StreamTcpSegmentReturntoPool(seg);
@@ -276,6 +356,8 @@ void StreamTcpReturnStreamSegments (TcpStream *stream)
 
     stream->seg_list = NULL;
     stream->seg_list_tail = NULL;
+
+    StreamingBufferClear(&stream->sb);
 }
 
 /** \param f locked flow */
@@ -300,177 +382,61 @@ int StreamTcpAppLayerIsDisabled(Flow *f)
     return (ssn->flags & STREAMTCP_FLAG_APP_LAYER_DISABLED);
 }
 
-typedef struct SegmentSizes_
-{
-    uint16_t pktsize;
-    uint32_t prealloc;
-} SegmentSizes;
-
-/* sort small to big */
-static int SortByPktsize(const void *a, const void *b)
-{
-    const SegmentSizes *s0 = a;
-    const SegmentSizes *s1 = b;
-    return s0->pktsize - s1->pktsize;
-}
-
 int StreamTcpReassemblyConfig(char quiet)
 {
-    Pool **my_segment_pool = NULL;
-    SCMutex *my_segment_lock = NULL;
-    uint16_t *my_segment_pktsizes = NULL;
-    SegmentSizes sizes[256];
-    memset(&sizes, 0x00, sizeof(sizes));
-
-    int npools = 0;
-    ConfNode *segs = ConfGetNode("stream.reassembly.segments");
-    if (segs != NULL) {
-        ConfNode *seg;
-        TAILQ_FOREACH(seg, &segs->head, next) {
-            ConfNode *segsize = ConfNodeLookupChild(seg,"size");
-            if (segsize == NULL)
-                continue;
-            ConfNode *segpre = ConfNodeLookupChild(seg,"prealloc");
-            if (segpre == NULL)
-                continue;
-
-            if (npools >= 256) {
-                SCLogError(SC_ERR_INVALID_ARGUMENT, "too many segment packet "
-                                                    "pools defined, max is 256");
-                return -1;
-            }
-
-            SCLogDebug("segsize->val %s", segsize->val);
-            SCLogDebug("segpre->val %s", segpre->val);
-
-            uint16_t pktsize = 0;
-            if (ByteExtractStringUint16(&pktsize, 10, strlen(segsize->val),
-                                        segsize->val) == -1)
-            {
-                SCLogError(SC_ERR_INVALID_ARGUMENT, "segment packet size "
-                                                    "of %s is invalid", segsize->val);
-                return -1;
-            }
-            uint32_t prealloc = 0;
-            if (ByteExtractStringUint32(&prealloc, 10, strlen(segpre->val),
-                                        segpre->val) == -1)
-            {
-                SCLogError(SC_ERR_INVALID_ARGUMENT, "segment prealloc of "
-                                                    "%s is invalid", segpre->val);
-                return -1;
-            }
-
-            sizes[npools].pktsize = pktsize;
-            sizes[npools].prealloc = prealloc;
-            SCLogDebug("pktsize %u, prealloc %u", sizes[npools].pktsize,
-                                                  sizes[npools].prealloc);
-            npools++;
-        }
-    }
-
-    SCLogDebug("npools %d", npools);
-    if (npools > 0) {
-        /* sort the array as the index code below relies on it */
-        qsort(&sizes, npools, sizeof(sizes[0]), SortByPktsize);
-        if (sizes[npools - 1].pktsize != 0xffff) {
-            sizes[npools].pktsize = 0xffff;
-            sizes[npools].prealloc = 8;
-            npools++;
-            SCLogConfig("appended a segment pool for pktsize 65536");
+    uint32_t segment_prealloc = 2048;
+    ConfNode *seg = ConfGetNode("stream.reassembly.segment-prealloc");
+    if (seg) {
+        uint32_t prealloc = 0;
+        if (ByteExtractStringUint32(&prealloc, 10, strlen(seg->val), seg->val) == -1)
+        {
+            SCLogError(SC_ERR_INVALID_ARGUMENT, "segment-prealloc of "
+                    "%s is invalid", seg->val);
+            return -1;
         }
-    } else if (npools == 0) {
-        /* defaults */
-        sizes[0].pktsize = 4;
-        sizes[0].prealloc = 256;
-        sizes[1].pktsize = 16;
-        sizes[1].prealloc = 512;
-        sizes[2].pktsize = 112;
-        sizes[2].prealloc = 512;
-        sizes[3].pktsize = 248;
-        sizes[3].prealloc = 512;
-        sizes[4].pktsize = 512;
-        sizes[4].prealloc = 512;
-        sizes[5].pktsize = 768;
-        sizes[5].prealloc = 1024;
-        sizes[6].pktsize = 1448;
-        sizes[6].prealloc = 1024;
-        sizes[7].pktsize = 0xffff;
-        sizes[7].prealloc = 128;
-        npools = 8;
-    }
-
-    int i = 0;
-    for (i = 0; i < npools; i++) {
-        SCLogDebug("pktsize %u, prealloc %u", sizes[i].pktsize, sizes[i].prealloc);
-    }
-
-    my_segment_pool = SCMalloc(npools * sizeof(Pool *));
-    if (my_segment_pool == NULL) {
-        SCLogError(SC_ERR_MEM_ALLOC, "malloc failed");
-        return -1;
-    }
-    my_segment_lock = SCMalloc(npools * sizeof(SCMutex));
-    if (my_segment_lock == NULL) {
-        SCLogError(SC_ERR_MEM_ALLOC, "malloc failed");
-
-        SCFree(my_segment_pool);
-        return -1;
-    }
-    my_segment_pktsizes = SCMalloc(npools * sizeof(uint16_t));
-    if (my_segment_pktsizes == NULL) {
-        SCLogError(SC_ERR_MEM_ALLOC, "malloc failed");
-
-        SCFree(my_segment_lock);
-        SCFree(my_segment_pool);
-        return -1;
-    }
-    uint32_t my_segment_poolsizes[npools];
-
-    for (i = 0; i < npools; i++) {
-        my_segment_pktsizes[i] = sizes[i].pktsize;
-        my_segment_poolsizes[i] = sizes[i].prealloc;
-        SCMutexInit(&my_segment_lock[i], NULL);
-
-        /* setup the pool */
-        SCMutexLock(&my_segment_lock[i]);
-        my_segment_pool[i] = PoolInit(0, my_segment_poolsizes[i], 0,
-                TcpSegmentPoolAlloc, TcpSegmentPoolInit,
-                (void *) &my_segment_pktsizes[i],
-                TcpSegmentPoolCleanup, NULL);
-        SCMutexUnlock(&my_segment_lock[i]);
-
-        if (my_segment_pool[i] == NULL) {
-            SCLogError(SC_ERR_INITIALIZATION, "couldn't set up segment pool "
-                    "for packet size %u. Memcap too low?", my_segment_pktsizes[i]);
-            exit(EXIT_FAILURE);
+        segment_prealloc = prealloc;
+    } else {
+        /* the segment data is no longer stored per segment, so the size
+         * buckets are gone. Honor the total prealloc of the old config. */
+        ConfNode *segs = ConfGetNode("stream.reassembly.segments");
+        if (segs != NULL) {
+            uint32_t total = 0;
+            ConfNode *sseg;
+            TAILQ_FOREACH(sseg, &segs->head, next) {
+                ConfNode *segpre = ConfNodeLookupChild(sseg,"prealloc");
+                if (segpre == NULL)
+                    continue;
+
+                uint32_t prealloc = 0;
+                if (ByteExtractStringUint32(&prealloc, 10, strlen(segpre->val),
+                                            segpre->val) == -1)
+                {
+                    SCLogError(SC_ERR_INVALID_ARGUMENT, "segment prealloc of "
+                                                        "%s is invalid", segpre->val);
+                    return -1;
+                }
+                total += prealloc;
+            }
+            SCLogWarning(SC_WARN_OPTION_OBSOLETE, "stream.reassembly.segments "
+                    "is obsolete, use stream.reassembly.segment-prealloc. "
+                    "Using a prealloc of %u segments.", total);
+            segment_prealloc = total;
         }
-
-        SCLogDebug("my_segment_pktsizes[i] %u, my_segment_poolsizes[i] %u",
-                my_segment_pktsizes[i], my_segment_poolsizes[i]);
-        if (!quiet)
-            SCLogConfig("segment pool: pktsize %u, prealloc %u",
-                    my_segment_pktsizes[i], my_segment_poolsizes[i]);
     }
+    if (!quiet)
+        SCLogConfig("stream.reassembly \"segment-prealloc\": %u", segment_prealloc);
 
-    uint16_t idx = 0;
-    uint16_t u16 = 0;
-    while (1) {
-        if (idx <= my_segment_pktsizes[u16]) {
-            segment_pool_idx[idx] = u16;
-            if (my_segment_pktsizes[u16] == idx)
-                u16++;
-        }
-
-        if (idx == 0xffff)
-            break;
-
-        idx++;
+    SCMutexInit(&segment_pool_mutex, NULL);
+    SCMutexLock(&segment_pool_mutex);
+    segment_pool = PoolInit(0, segment_prealloc, 0,
+            TcpSegmentPoolAlloc, TcpSegmentPoolInit, NULL,
+            TcpSegmentPoolCleanup, NULL);
+    SCMutexUnlock(&segment_pool_mutex);
+    if (segment_pool == NULL) {
+        SCLogError(SC_ERR_INITIALIZATION, "couldn't set up segment pool. "
+                "Memcap too low?");
+        exit(EXIT_FAILURE);
     }
-    /* set the globals */
-    segment_pool = my_segment_pool;
-    segment_pool_mutex = my_segment_lock;
-    segment_pool_pktsizes = my_segment_pktsizes;
-    segment_pool_num = npools;
 
     uint32_t stream_chunk_prealloc = 250;
     ConfNode *chunk = ConfGetNode("stream.reassembly.chunk-prealloc");
@@ -488,17 +454,32 @@ int StreamTcpReassemblyConfig(char quiet)
         SCLogConfig("stream.reassembly \"chunk-prealloc\": %u", stream_chunk_prealloc);
     StreamMsgQueuesInit(stream_chunk_prealloc);
 
-    intmax_t zero_copy_size = 128;
-    if (ConfGetInt("stream.reassembly.zero-copy-size", &zero_copy_size) == 1) {
-        if (zero_copy_size < 0 || zero_copy_size > 0xffff) {
-            SCLogError(SC_ERR_INVALID_ARGUMENT, "stream.reassembly.zero-copy-size of "
-                    "%"PRIiMAX" is invalid: valid values are 0 to 65535", zero_copy_size);
+    if (ConfGetNode("stream.reassembly.zero-copy-size") != NULL) {
+        SCLogWarning(SC_WARN_OPTION_OBSOLETE, "stream.reassembly.zero-copy-size "
+                "is obsolete. The app layer is always passed the stream data "
+                "without copying.");
+    }
+
+    uint32_t region_gap = 8192;
+    char *region_gap_str = NULL;
+    if (ConfGet("stream.reassembly.region-gap", &region_gap_str) == 1) {
+        if (ParseSizeStringU32(region_gap_str, &region_gap) < 0 ||
+                region_gap == 0) {
+            SCLogError(SC_ERR_INVALID_ARGUMENT, "region-gap of "
+                    "%s is invalid", region_gap_str);
             return -1;
         }
     }
-    stream_config.zero_copy_size = (uint16_t)zero_copy_size;
     if (!quiet)
-        SCLogConfig("stream.reassembly \"zero-copy-size\": %u", stream_config.zero_copy_size);
+        SCLogConfig("stream.reassembly \"region-gap\": %u", region_gap);
+
+    stream_config.sbcnf.flags = STREAMING_BUFFER_NOFLAGS;
+    stream_config.sbcnf.buf_size = 2048;
+    stream_config.sbcnf.region_gap = region_gap;
+    stream_config.sbcnf.Malloc = StreamTcpReassembleSbMalloc;
+    stream_config.sbcnf.Calloc = StreamTcpReassembleSbCalloc;
+    stream_config.sbcnf.Realloc = StreamTcpReassembleSbRealloc;
+    stream_config.sbcnf.Free = StreamTcpReassembleSbFree;
 
     return 0;
 }
@@ -511,7 +492,6 @@ int StreamTcpReassembleInit(char quiet)
     if (StreamTcpReassemblyConfig(quiet) < 0)
         return -1;
 #ifdef DEBUG
-    SCMutexInit(&segment_pool_memuse_mutex, NULL);
     SCMutexInit(&segment_pool_cnt_mutex, NULL);
 #endif
 
@@ -527,43 +507,32 @@ static uint32_t dbg_app_layer_gap_candidate;
 
 void StreamTcpReassembleFree(char quiet)
 {
-    uint16_t u16 = 0;
-    for (u16 = 0; u16 < segment_pool_num; u16++) {
-        SCMutexLock(&segment_pool_mutex[u16]);
-
+    SCMutexLock(&segment_pool_mutex);
+    if (segment_pool != NULL) {
         if (quiet == FALSE) {
-            PoolPrintSaturation(segment_pool[u16]);
-            SCLogDebug("segment_pool[u16]->empty_stack_size %"PRIu32", "
-                       "segment_pool[u16]->alloc_stack_size %"PRIu32", alloced "
-                       "%"PRIu32"", segment_pool[u16]->empty_stack_size,
-                       segment_pool[u16]->alloc_stack_size,
-                       segment_pool[u16]->allocated);
-
-            if (segment_pool[u16]->max_outstanding > segment_pool[u16]->allocated) {
-                SCLogPerf("TCP segment pool of size %u had a peak use of %u segments, "
-                        "more than the prealloc setting of %u", segment_pool_pktsizes[u16],
-                        segment_pool[u16]->max_outstanding, segment_pool[u16]->allocated);
+            PoolPrintSaturation(segment_pool);
+            SCLogDebug("segment_pool->empty_stack_size %"PRIu32", "
+                       "segment_pool->alloc_stack_size %"PRIu32", alloced "
+                       "%"PRIu32"", segment_pool->empty_stack_size,
+                       segment_pool->alloc_stack_size,
+                       segment_pool->allocated);
+
+            if (segment_pool->max_outstanding > segment_pool->allocated) {
+                SCLogPerf("TCP segment pool had a peak use of %u segments, "
+                        "more than the prealloc setting of %u",
+                        segment_pool->max_outstanding, segment_pool->allocated);
             }
         }
-        PoolFree(segment_pool[u16]);
-
-        SCMutexUnlock(&segment_pool_mutex[u16]);
-        SCMutexDestroy(&segment_pool_mutex[u16]);
+        PoolFree(segment_pool);
+        segment_pool = NULL;
     }
-    SCFree(segment_pool);
-    SCFree(segment_pool_mutex);
-    SCFree(segment_pool_pktsizes);
-    segment_pool = NULL;
-    segment_pool_mutex = NULL;
-    segment_pool_pktsizes = NULL;
+    SCMutexUnlock(&segment_pool_mutex);
+    SCMutexDestroy(&segment_pool_mutex);
 
     StreamMsgQueuesDeinit(quiet);
 
 #ifdef DEBUG
     SCLogDebug("segment_pool_cnt %"PRIu64"", segment_pool_cnt);
-    SCLogDebug("segment_pool_memuse %"PRIu64"", segment_pool_memuse);
-    SCLogDebug("segment_pool_memcnt %"PRIu64"", segment_pool_memcnt);
-    SCMutexDestroy(&segment_pool_memuse_mutex);
     SCMutexDestroy(&segment_pool_cnt_mutex);
     SCLogPerf("dbg_app_layer_gap %u", dbg_app_layer_gap);
     SCLogPerf("dbg_app_layer_gap_candidate %u", dbg_app_layer_gap_candidate);
@@ -588,10 +557,6 @@ void StreamTcpReassembleFreeThreadCtx(TcpReassemblyThreadCtx *ra_ctx)
 {
     SCEnter();
     AppLayerDestroyCtxThread(ra_ctx->app_tctx);
-#ifdef DEBUG
-    SCLogDebug("reassembly fast path stats: fp1 %"PRIu64" fp2 %"PRIu64" sp %"PRIu64,
-            ra_ctx->fp1, ra_ctx->fp2, ra_ctx->sp);
-#endif
     SCFree(ra_ctx);
     SCReturn;
 }
@@ -764,10 +729,29 @@ int StreamTcpReassembleInsertSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_
         goto end;
     }
 
+    /* make sure the buffer can hold the segment data before we touch
+     * the list, so that writing the data can't fail halfway through */
+    int r = StreamTcpReassemblePrepareSegmentData(stream, seg, p);
+    if (r == 1) {
+        SCLogDebug("segment data is before the stream buffer");
+        return_seg = TRUE;
+        ret_value = -1;
+
+        StreamTcpSetEvent(p, STREAM_REASSEMBLY_SEGMENT_BEFORE_BASE_SEQ);
+        goto end;
+    } else if (r < 0) {
+        return_seg = TRUE;
+        ret_value = -1;
+
+        StreamTcpSetEvent(p, STREAM_REASSEMBLY_NO_SEGMENT);
+        goto end;
+    }
+
     /* fast track */
     if (list_seg == NULL) {
         SCLogDebug("empty list, inserting seg %p seq %" PRIu32 ", "
                    "len %" PRIu32 "", seg, seg->seq, seg->payload_len);
+        StreamTcpSegmentDataWrite(stream, seg, p);
         stream->seg_list = seg;
         seg->prev = NULL;
         stream->seg_list_tail = seg;
@@ -779,6 +763,7 @@ int StreamTcpReassembleInsertSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_
     if (SEQ_GEQ(seg->seq, (stream->seg_list_tail->seq +
             stream->seg_list_tail->payload_len)))
     {
+        StreamTcpSegmentDataWrite(stream, seg, p);
         stream->seg_list_tail->next = seg;
         seg->prev = stream->seg_list_tail;
         stream->seg_list_tail = seg;
@@ -808,6 +793,7 @@ int StreamTcpReassembleInsertSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_
                            " %" PRIu32 ", list_seg->payload_len %" PRIu32 ", "
                            "list_seg->prev %p", seg->seq, list_seg->seq,
                            list_seg->payload_len, list_seg->prev);
+                StreamTcpSegmentDataWrite(stream, seg, p);
                 seg->next = list_seg;
                 if (list_seg->prev == NULL) {
                     stream->seg_list = seg;
@@ -862,6 +848,7 @@ int StreamTcpReassembleInsertSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_
                            list_seg->seq + list_seg->payload_len);
 
                 if (list_seg->next == NULL) {
+                    StreamTcpSegmentDataWrite(stream, seg, p);
                     list_seg->next = seg;
                     seg->prev = list_seg;
                     stream->seg_list_tail = seg;
@@ -993,7 +980,7 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
 
             TcpSegment *new_seg = StreamTcpGetSegment(tv, ra_ctx, packet_length);
             if (new_seg == NULL) {
-                SCLogDebug("segment_pool[%"PRIu16"] is empty", segment_pool_idx[packet_length]);
+                SCLogDebug("segment_pool is empty");
 
                 StreamTcpSetEvent(p, STREAM_REASSEMBLY_NO_SEGMENT);
                 SCReturnInt(-1);
@@ -1011,7 +998,8 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
             list_seg->prev = new_seg;
 
             /* create a new seg, copy the list_seg data over */
-            StreamTcpSegmentDataCopy(new_seg, seg);
+            StreamTcpSegmentDataReplace(stream, new_seg, seg, p, new_seg->seq,
+                                        new_seg->payload_len);
 
 #ifdef DEBUG
             PrintList(stream->seg_list);
@@ -1036,7 +1024,7 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
 
             TcpSegment *new_seg = StreamTcpGetSegment(tv, ra_ctx, packet_length);
             if (new_seg == NULL) {
-                SCLogDebug("segment_pool[%"PRIu16"] is empty", segment_pool_idx[packet_length]);
+                SCLogDebug("segment_pool is empty");
 
                 StreamTcpSetEvent(p, STREAM_REASSEMBLY_NO_SEGMENT);
                 SCReturnInt(-1);
@@ -1046,12 +1034,12 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
             new_seg->next = list_seg->next;
             new_seg->prev = list_seg->prev;
 
-            StreamTcpSegmentDataCopy(new_seg, list_seg);
+            StreamTcpSegmentDataCopy(stream, new_seg);
 
             /* first the data before the list_seg->seq */
             uint16_t replace = (uint16_t) (list_seg->seq - seg->seq);
             SCLogDebug("copying %"PRIu16" bytes to new_seg", replace);
-            StreamTcpSegmentDataReplace(new_seg, seg, seg->seq, replace);
+            StreamTcpSegmentDataReplace(stream, new_seg, seg, p, seg->seq, replace);
 
             /* if any, data after list_seg->seq + list_seg->payload_len */
             if (SEQ_GT((seg->seq + seg->payload_len), (list_seg->seq +
@@ -1061,7 +1049,7 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
                                              (list_seg->seq +
                                               list_seg->payload_len)));
                 SCLogDebug("replacing %"PRIu16"", replace);
-                StreamTcpSegmentDataReplace(new_seg, seg, (list_seg->seq +
+                StreamTcpSegmentDataReplace(stream, new_seg, seg, p, (list_seg->seq +
                                              list_seg->payload_len), replace);
             }
 
@@ -1101,7 +1089,7 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
 
                 TcpSegment *new_seg = StreamTcpGetSegment(tv, ra_ctx, packet_length);
                 if (new_seg == NULL) {
-                    SCLogDebug("segment_pool[%"PRIu16"] is empty", segment_pool_idx[packet_length]);
+                    SCLogDebug("segment_pool is empty");
 
                     StreamTcpSetEvent(p, STREAM_REASSEMBLY_NO_SEGMENT);
                     SCReturnInt(-1);
@@ -1121,12 +1109,12 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
                 new_seg->next = list_seg->next;
                 new_seg->prev = list_seg->prev;
 
-                StreamTcpSegmentDataCopy(new_seg, list_seg);
+                StreamTcpSegmentDataCopy(stream, new_seg);
 
                 uint16_t copy_len = (uint16_t) (list_seg->seq - seg->seq);
                 SCLogDebug("copy_len %" PRIu32 " (%" PRIu32 " - %" PRIu32 ")",
                             copy_len, list_seg->seq, seg->seq);
-                StreamTcpSegmentDataReplace(new_seg, seg, seg->seq, copy_len);
+                StreamTcpSegmentDataReplace(stream, new_seg, seg, p, seg->seq, copy_len);
 
                 /*update the stream last_seg in case of removal of list_seg*/
                 if (stream->seg_list_tail == list_seg)
@@ -1161,7 +1149,7 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
 
                     TcpSegment *new_seg = StreamTcpGetSegment(tv, ra_ctx, packet_length);
                     if (new_seg == NULL) {
-                        SCLogDebug("segment_pool[%"PRIu16"] is empty", segment_pool_idx[packet_length]);
+                        SCLogDebug("segment_pool is empty");
 
                         StreamTcpSetEvent(p, STREAM_REASSEMBLY_NO_SEGMENT);
                         SCReturnInt(-1);
@@ -1181,17 +1169,17 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
                     new_seg->prev = list_seg->prev;
 
                     /* create a new seg, copy the list_seg data over */
-                    StreamTcpSegmentDataCopy(new_seg, list_seg);
+                    StreamTcpSegmentDataCopy(stream, new_seg);
 
                     /* copy the part before list_seg */
                     uint16_t copy_len = list_seg->seq - new_seg->seq;
-                    StreamTcpSegmentDataReplace(new_seg, seg, new_seg->seq,
+                    StreamTcpSegmentDataReplace(stream, new_seg, seg, p, new_seg->seq,
                                                 copy_len);
 
                     /* copy the part after list_seg */
                     copy_len = (seg->seq + seg->payload_len) -
                                     (list_seg->seq + list_seg->payload_len);
-                    StreamTcpSegmentDataReplace(new_seg, seg, (list_seg->seq +
+                    StreamTcpSegmentDataReplace(stream, new_seg, seg, p, (list_seg->seq +
                                               list_seg->payload_len), copy_len);
 
                     if (new_seg->prev != NULL) {
@@ -1229,8 +1217,7 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
 
                 TcpSegment *new_seg = StreamTcpGetSegment(tv, ra_ctx, packet_length);
                 if (new_seg == NULL) {
-                    SCLogDebug("segment_pool[%"PRIu16"] is empty",
-                            segment_pool_idx[packet_length]);
+                    SCLogDebug("segment_pool is empty");
 
                     StreamTcpSetEvent(p, STREAM_REASSEMBLY_NO_SEGMENT);
                     SCReturnInt(-1);
@@ -1251,17 +1238,17 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
                 new_seg->prev = list_seg->prev;
 
                 /* create a new seg, copy the list_seg data over */
-                StreamTcpSegmentDataCopy(new_seg, list_seg);
+                StreamTcpSegmentDataCopy(stream, new_seg);
 
                 /* copy the part before list_seg */
                 uint16_t copy_len = list_seg->seq - new_seg->seq;
-                StreamTcpSegmentDataReplace(new_seg, seg, new_seg->seq,
+                StreamTcpSegmentDataReplace(stream, new_seg, seg, p, new_seg->seq,
                         copy_len);
 
                 /* copy the part after list_seg */
                 copy_len = (seg->seq + seg->payload_len) -
                     (list_seg->seq + list_seg->payload_len);
-                StreamTcpSegmentDataReplace(new_seg, seg, (list_seg->seq +
+                StreamTcpSegmentDataReplace(stream, new_seg, seg, p, (list_seg->seq +
                             list_seg->payload_len), copy_len);
 
                 if (new_seg->prev != NULL) {
@@ -1279,21 +1266,21 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
         }
 
         if (check_overlap_different_data &&
-                !StreamTcpSegmentDataCompare(seg, list_seg, list_seg->seq, overlap)) {
+                !StreamTcpSegmentDataCompare(stream, seg, list_seg, p, list_seg->seq, overlap)) {
             /* interesting, overlap with different data */
             StreamTcpSetEvent(p, STREAM_REASSEMBLY_OVERLAP_DIFFERENT_DATA);
         }
 
         if (StreamTcpInlineMode()) {
-            if (StreamTcpInlineSegmentCompare(seg, list_seg) != 0) {
-                StreamTcpInlineSegmentReplacePacket(p, list_seg);
+            if (StreamTcpInlineSegmentCompare(stream, p, list_seg) != 0) {
+                StreamTcpInlineSegmentReplacePacket(stream, p, list_seg);
             }
         } else {
             switch (os_policy) {
                 case OS_POLICY_SOLARIS:
                 case OS_POLICY_HPUX11:
                     if (end_after == TRUE || end_same == TRUE) {
-                        StreamTcpSegmentDataReplace(list_seg, seg, overlap_point,
+                        StreamTcpSegmentDataReplace(stream, list_seg, seg, p, overlap_point,
                                 overlap);
                     } else {
                         SCLogDebug("using old data in starts before list case, "
@@ -1323,7 +1310,7 @@ static int HandleSegmentStartsBeforeListSegment(ThreadVars *tv, TcpReassemblyThr
                             "list_seg->seq %" PRIu32 " policy %" PRIu32 " "
                             "overlap %" PRIu32 "", list_seg->seq, os_policy,
                             overlap);
-                    StreamTcpSegmentDataReplace(list_seg, seg, overlap_point,
+                    StreamTcpSegmentDataReplace(stream, list_seg, seg, p, overlap_point,
                             overlap);
                     break;
             }
@@ -1452,7 +1439,7 @@ static int HandleSegmentStartsAtSameListSegment(ThreadVars *tv, TcpReassemblyThr
 
                 TcpSegment *new_seg = StreamTcpGetSegment(tv, ra_ctx, packet_length);
                 if (new_seg == NULL) {
-                    SCLogDebug("egment_pool[%"PRIu16"] is empty", segment_pool_idx[packet_length]);
+                    SCLogDebug("segment_pool is empty");
 
                     StreamTcpSetEvent(p, STREAM_REASSEMBLY_NO_SEGMENT);
                     return -1;
@@ -1467,7 +1454,7 @@ static int HandleSegmentStartsAtSameListSegment(ThreadVars *tv, TcpReassemblyThr
                 SCLogDebug("new_seg %p, new_seg->next %p, new_seg->prev %p, "
                            "list_seg->next %p", new_seg, new_seg->next,
                            new_seg->prev, list_seg->next);
-                StreamTcpSegmentDataReplace(new_seg, seg, new_seg->seq,
+                StreamTcpSegmentDataReplace(stream, new_seg, seg, p, new_seg->seq,
                                             new_seg->payload_len);
 
                 /*update the stream last_seg in case of removal of list_seg*/
@@ -1477,14 +1464,14 @@ static int HandleSegmentStartsAtSameListSegment(ThreadVars *tv, TcpReassemblyThr
         }
 
         if (check_overlap_different_data &&
-                !StreamTcpSegmentDataCompare(list_seg, seg, seg->seq, overlap)) {
+                !StreamTcpSegmentDataCompare(stream, list_seg, seg, p, seg->seq, overlap)) {
             /* interesting, overlap with different data */
             StreamTcpSetEvent(p, STREAM_REASSEMBLY_OVERLAP_DIFFERENT_DATA);
         }
 
         if (StreamTcpInlineMode()) {
-            if (StreamTcpInlineSegmentCompare(list_seg, seg) != 0) {
-                StreamTcpInlineSegmentReplacePacket(p, list_seg);
+            if (StreamTcpInlineSegmentCompare(stream, p, list_seg) != 0) {
+                StreamTcpInlineSegmentReplacePacket(stream, p, list_seg);
             }
         } else {
             switch (os_policy) {
@@ -1492,7 +1479,7 @@ static int HandleSegmentStartsAtSameListSegment(ThreadVars *tv, TcpReassemblyThr
                 case OS_POLICY_SOLARIS:
                 case OS_POLICY_HPUX11:
                     if (end_after == TRUE || end_same == TRUE) {
-                        StreamTcpSegmentDataReplace(list_seg, seg, seg->seq, overlap);
+                        StreamTcpSegmentDataReplace(stream, list_seg, seg, p, seg->seq, overlap);
                     } else {
                         SCLogDebug("using old data in starts at list case, "
                                 "list_seg->seq %" PRIu32 " policy %" PRIu32 " "
@@ -1501,11 +1488,11 @@ static int HandleSegmentStartsAtSameListSegment(ThreadVars *tv, TcpReassemblyThr
                     }
                     break;
                 case OS_POLICY_LAST:
-                    StreamTcpSegmentDataReplace(list_seg, seg, seg->seq, overlap);
+                    StreamTcpSegmentDataReplace(stream, list_seg, seg, p, seg->seq, overlap);
                     break;
                 case OS_POLICY_LINUX:
                     if (end_after == TRUE) {
-                        StreamTcpSegmentDataReplace(list_seg, seg, seg->seq, overlap);
+                        StreamTcpSegmentDataReplace(stream, list_seg, seg, p, seg->seq, overlap);
                     } else {
                         SCLogDebug("using old data in starts at list case, "
                                 "list_seg->seq %" PRIu32 " policy %" PRIu32 " "
@@ -1656,7 +1643,7 @@ static int HandleSegmentStartsAfterListSegment(ThreadVars *tv, TcpReassemblyThre
 
                 TcpSegment *new_seg = StreamTcpGetSegment(tv, ra_ctx, packet_length);
                 if (new_seg == NULL) {
-                    SCLogDebug("segment_pool[%"PRIu16"] is empty", segment_pool_idx[packet_length]);
+                    SCLogDebug("segment_pool is empty");
 
                     StreamTcpSetEvent(p, STREAM_REASSEMBLY_NO_SEGMENT);
                     SCReturnInt(-1);
@@ -1674,7 +1661,7 @@ static int HandleSegmentStartsAfterListSegment(ThreadVars *tv, TcpReassemblyThre
                             new_seg->next, new_seg->prev, list_seg->next,
                             new_seg->seq);
 
-                StreamTcpSegmentDataReplace(new_seg, seg, new_seg->seq,
+                StreamTcpSegmentDataReplace(stream, new_seg, seg, p, new_seg->seq,
                                             new_seg->payload_len);
 
                 /* update the stream last_seg in case of removal of list_seg */
@@ -1684,21 +1671,21 @@ static int HandleSegmentStartsAfterListSegment(ThreadVars *tv, TcpReassemblyThre
         }
 
         if (check_overlap_different_data &&
-                !StreamTcpSegmentDataCompare(list_seg, seg, seg->seq, overlap)) {
+                !StreamTcpSegmentDataCompare(stream, list_seg, seg, p, seg->seq, overlap)) {
             /* interesting, overlap with different data */
             StreamTcpSetEvent(p, STREAM_REASSEMBLY_OVERLAP_DIFFERENT_DATA);
         }
 
         if (StreamTcpInlineMode()) {
-            if (StreamTcpInlineSegmentCompare(list_seg, seg) != 0) {
-                StreamTcpInlineSegmentReplacePacket(p, list_seg);
+            if (StreamTcpInlineSegmentCompare(stream, p, list_seg) != 0) {
+                StreamTcpInlineSegmentReplacePacket(stream, p, list_seg);
             }
         } else {
             switch (os_policy) {
                 case OS_POLICY_SOLARIS:
                 case OS_POLICY_HPUX11:
                     if (end_after == TRUE) {
-                        StreamTcpSegmentDataReplace(list_seg, seg, seg->seq, overlap);
+                        StreamTcpSegmentDataReplace(stream, list_seg, seg, p, seg->seq, overlap);
                     } else {
                         SCLogDebug("using old data in starts beyond list case, "
                                 "list_seg->seq %" PRIu32 " policy %" PRIu32 " "
@@ -1707,7 +1694,7 @@ static int HandleSegmentStartsAfterListSegment(ThreadVars *tv, TcpReassemblyThre
                     }
                     break;
                 case OS_POLICY_LAST:
-                    StreamTcpSegmentDataReplace(list_seg, seg, seg->seq, overlap);
+                    StreamTcpSegmentDataReplace(stream, list_seg, seg, p, seg->seq, overlap);
                     break;
                 case OS_POLICY_BSD:
                 case OS_POLICY_HPUX10:
@@ -1928,13 +1915,13 @@ int StreamTcpReassembleHandleSegmentHandleData(ThreadVars *tv, TcpReassemblyThre
 
     TcpSegment *seg = StreamTcpGetSegment(tv, ra_ctx, size);
     if (seg == NULL) {
-        SCLogDebug("segment_pool[%"PRIu16"] is empty", segment_pool_idx[size]);
+        SCLogDebug("segment_pool is empty");
 
         StreamTcpSetEvent(p, STREAM_REASSEMBLY_NO_SEGMENT);
         SCReturnInt(-1);
     }
 
-    memcpy(seg->payload, p->payload, size);
+    /* the data is added to the stream buffer on insert */
     seg->payload_len = size;
     seg->seq = TCP_GET_SEQ(p);
 
@@ -2315,6 +2302,14 @@ static int StreamTcpReassembleInlineRaw (TcpReassemblyThreadCtx *ra_ctx,
                 smsg->seq = ra_base_seq + 1;
             }
 
+            const uint8_t *seg_data;
+            uint32_t seg_datalen;
+            StreamTcpSegmentGetData(stream, seg, &seg_data, &seg_datalen);
+            if (seg_data == NULL || seg_datalen < seg->payload_len) {
+                SCLogDebug("segment data not in the stream buffer");
+                break;
+            }
+
             /* copy the data into the smsg */
             uint32_t copy_size = smsg->data_size - smsg_offset;
             if (copy_size > payload_len) {
@@ -2324,7 +2319,7 @@ static int StreamTcpReassembleInlineRaw (TcpReassemblyThreadCtx *ra_ctx,
                 BUG_ON(copy_size > smsg->data_size);
             }
             SCLogDebug("copy_size is %"PRIu16"", copy_size);
-            memcpy(smsg->data + smsg_offset, seg->payload + payload_offset,
+            memcpy(smsg->data + smsg_offset, seg_data + payload_offset,
                     copy_size);
             smsg_offset += copy_size;
 
@@ -2389,7 +2384,7 @@ static int StreamTcpReassembleInlineRaw (TcpReassemblyThreadCtx *ra_ctx,
                     SCLogDebug("copy payload_offset %" PRIu32 ", smsg_offset "
                                 "%" PRIu32 ", copy_size %" PRIu32 "",
                                 payload_offset, smsg_offset, copy_size);
-                    memcpy(smsg->data + smsg_offset, seg->payload +
+                    memcpy(smsg->data + smsg_offset, seg_data +
                             payload_offset, copy_size);
                     smsg_offset += copy_size;
                     if (gap == 0 && SEQ_GT((seg->seq + payload_offset + copy_size),ra_base_seq+1)) {
@@ -2507,6 +2502,8 @@ void StreamTcpPruneSession(Flow *f, uint8_t flags)
         seg = next_seg;
         continue;
     }
+
+    StreamTcpReassembleSlideBuffer(stream);
 }
 
 #ifdef DEBUG
@@ -2547,7 +2544,7 @@ static void GetSessionSize(TcpSession *ssn, Packet *p)
 typedef struct ReassembleData_ {
     uint32_t ra_base_seq;
     uint32_t data_len;
-    uint8_t data[4096];
+    uint8_t *data;      /* start of the data in the stream buffer */
     int partial;        /* last segment was processed only partially */
     uint32_t data_sent; /* data passed on this run */
 } ReassembleData;
@@ -2622,62 +2619,6 @@ static inline int DoReassemble(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
                  TcpSession *ssn, TcpStream *stream, TcpSegment *seg, ReassembleData *rd,
                  Packet *p)
 {
-    /* fast paths: send data directly into the app layer, w/o first doing
-     * a copy step. However, don't use the fast path until protocol detection
-     * has been completed
-     * TODO if initial data is big enough for proto detect, we could do the
-     *      fast path anyway. */
-    if (stream->flags & STREAMTCP_STREAM_FLAG_APPPROTO_DETECTION_COMPLETED) {
-        /* fast path 1: segment is exactly what we need */
-        if (likely(rd->data_len == 0 &&
-                    SEQ_EQ(seg->seq, rd->ra_base_seq+1) &&
-                    SEQ_EQ(stream->last_ack, (seg->seq + seg->payload_len))))
-        {
-            /* process single segment directly */
-            AppLayerHandleTCPData(tv, ra_ctx, p, p->flow, ssn, stream,
-                    seg->payload, seg->payload_len,
-                    StreamGetAppLayerFlags(ssn, stream, p));
-            AppLayerProfilingStore(ra_ctx->app_tctx, p);
-            rd->data_sent += seg->payload_len;
-            rd->ra_base_seq += seg->payload_len;
-#ifdef DEBUG
-            ra_ctx->fp1++;
-#endif
-            /* if after the first data chunk we have no alproto yet,
-             * there is no point in continueing here. */
-            if (!StreamTcpIsSetStreamFlagAppProtoDetectionCompleted(stream)) {
-                SCLogDebug("no alproto after first data chunk");
-                return 0;
-            }
-            return 1;
-            /* fast path 2: segment acked completely, meets minimal size req for 0copy processing */
-        } else if (rd->data_len == 0 &&
-                SEQ_EQ(seg->seq, rd->ra_base_seq+1) &&
-                SEQ_GT(stream->last_ack, (seg->seq + seg->payload_len)) &&
-                seg->payload_len >= stream_config.zero_copy_size)
-        {
-            /* process single segment directly */
-            AppLayerHandleTCPData(tv, ra_ctx, p, p->flow, ssn, stream,
-                    seg->payload, seg->payload_len,
-                    StreamGetAppLayerFlags(ssn, stream, p));
-            AppLayerProfilingStore(ra_ctx->app_tctx, p);
-            rd->data_sent += seg->payload_len;
-            rd->ra_base_seq += seg->payload_len;
-#ifdef DEBUG
-            ra_ctx->fp2++;
-#endif
-            /* if after the first data chunk we have no alproto yet,
-             * there is no point in continueing here. */
-            if (!StreamTcpIsSetStreamFlagAppProtoDetectionCompleted(stream)) {
-                SCLogDebug("no alproto after first data chunk");
-                return 0;
-            }
-            return 1;
-        }
-    }
-#ifdef DEBUG
-    ra_ctx->sp++;
-#endif
     uint16_t payload_offset = 0;
     uint16_t payload_len = 0;
 
@@ -2751,29 +2692,18 @@ static inline int DoReassemble(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
             return 0;
         }
 
-        /* copy the data into the buffer */
-        uint16_t copy_size = sizeof(rd->data) - rd->data_len;
-        if (copy_size + payload_offset > seg->payload_len) {
-            copy_size = seg->payload_len - payload_offset;
-        }
-        if (copy_size > payload_len) {
-            copy_size = payload_len;
-        }
-        if (SCLogDebugEnabled()) {
-            BUG_ON(copy_size > sizeof(rd->data));
-            BUG_ON(copy_size+payload_offset > seg->payload_len);
-            BUG_ON(copy_size+payload_offset > seg->pool_size);
+        const uint8_t *seg_data;
+        uint32_t seg_datalen;
+        StreamTcpSegmentGetData(stream, seg, &seg_data, &seg_datalen);
+        if (seg_data == NULL || (uint32_t)payload_offset + payload_len > seg_datalen) {
+            SCLogDebug("segment data not in the stream buffer");
+            return 0;
         }
 
-        SCLogDebug("copy_size is %"PRIu16"", copy_size);
-        memcpy(rd->data + rd->data_len, seg->payload + payload_offset, copy_size);
-        rd->data_len += copy_size;
-        rd->ra_base_seq += copy_size;
-        SCLogDebug("ra_base_seq %"PRIu32", data_len %"PRIu32, rd->ra_base_seq, rd->data_len);
-
-        /* queue the smsg if it's full */
-        if (rd->data_len == sizeof(rd->data)) {
-            /* process what we have so far */
+        /* contiguous segments are contiguous in the stream buffer, so we
+         * can pass the data on to the app layer without copying it. If the
+         * data doesn't follow what we have so far, pass that on first. */
+        if (rd->data_len > 0 && rd->data + rd->data_len != seg_data + payload_offset) {
             AppLayerHandleTCPData(tv, ra_ctx, p, p->flow, ssn, stream,
                     rd->data, rd->data_len,
                     StreamGetAppLayerFlags(ssn, stream, p));
@@ -2788,81 +2718,12 @@ static inline int DoReassemble(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
                 return 0;
             }
         }
+        if (rd->data_len == 0)
+            rd->data = (uint8_t *)seg_data + payload_offset;
 
-        /* if the payload len is bigger than what we copied, we handle the
-         * rest of the payload next... */
-        if (copy_size < payload_len) {
-            SCLogDebug("copy_size %" PRIu32 " < %" PRIu32 "", copy_size,
-                    payload_len);
-
-            payload_offset += copy_size;
-            payload_len -= copy_size;
-            SCLogDebug("payload_offset is %"PRIu16", seg->payload_len is "
-                    "%"PRIu16" and stream->last_ack is %"PRIu32"",
-                    payload_offset, seg->payload_len, stream->last_ack);
-            if (SCLogDebugEnabled()) {
-                BUG_ON(payload_offset > seg->payload_len);
-            }
-
-            /* we need a while loop here as the packets theoretically can be
-             * 64k */
-            char segment_done = FALSE;
-            while (segment_done == FALSE) {
-                SCLogDebug("new msg at offset %" PRIu32 ", payload_len "
-                        "%" PRIu32 "", payload_offset, payload_len);
-                rd->data_len = 0;
-
-                copy_size = sizeof(rd->data) - rd->data_len;
-                if (copy_size > (seg->payload_len - payload_offset)) {
-                    copy_size = (seg->payload_len - payload_offset);
-                }
-                if (SCLogDebugEnabled()) {
-                    BUG_ON(copy_size > sizeof(rd->data));
-                }
-
-                SCLogDebug("copy payload_offset %" PRIu32 ", data_len "
-                        "%" PRIu32 ", copy_size %" PRIu32 "",
-                        payload_offset, rd->data_len, copy_size);
-                memcpy(rd->data + rd->data_len, seg->payload +
-                        payload_offset, copy_size);
-                rd->data_len += copy_size;
-                rd->ra_base_seq += copy_size;
-                SCLogDebug("ra_base_seq %"PRIu32, rd->ra_base_seq);
-                SCLogDebug("copied payload_offset %" PRIu32 ", "
-                        "data_len %" PRIu32 ", copy_size %" PRIu32 "",
-                        payload_offset, rd->data_len, copy_size);
-
-                if (rd->data_len == sizeof(rd->data)) {
-                    /* process what we have so far */
-                    AppLayerHandleTCPData(tv, ra_ctx, p, p->flow, ssn, stream,
-                            rd->data, rd->data_len,
-                            StreamGetAppLayerFlags(ssn, stream, p));
-                    AppLayerProfilingStore(ra_ctx->app_tctx, p);
-                    rd->data_sent += rd->data_len;
-                    rd->data_len = 0;
-
-                    /* if after the first data chunk we have no alproto yet,
-                     * there is no point in continueing here. */
-                    if (!StreamTcpIsSetStreamFlagAppProtoDetectionCompleted(stream)) {
-                        SCLogDebug("no alproto after first data chunk");
-                        return 0;
-                    }
-                }
-
-                /* see if we have segment payload left to process */
-                if ((copy_size + payload_offset) < seg->payload_len) {
-                    payload_offset += copy_size;
-                    payload_len -= copy_size;
-
-                    if (SCLogDebugEnabled()) {
-                        BUG_ON(payload_offset > seg->payload_len);
-                    }
-                } else {
-                    payload_offset = 0;
-                    segment_done = TRUE;
-                }
-            }
-        }
+        rd->data_len += payload_len;
+        rd->ra_base_seq += payload_len;
+        SCLogDebug("ra_base_seq %"PRIu32", data_len %"PRIu32, rd->ra_base_seq, rd->data_len);
     }
 
     return 1;
@@ -2980,6 +2841,7 @@ int StreamTcpReassembleAppLayer (ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
      * detected. */
     ReassembleData rd;
     rd.ra_base_seq = stream->ra_app_base_seq;
+    rd.data = NULL;
     rd.data_len = 0;
     rd.data_sent = 0;
     rd.partial = FALSE;
@@ -3051,7 +2913,6 @@ int StreamTcpReassembleAppLayer (ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
     if (rd.data_len > 0) {
         SCLogDebug("data_len > 0, %u", rd.data_len);
         /* process what we have so far */
-        BUG_ON(rd.data_len > sizeof(rd.data));
         AppLayerHandleTCPData(tv, ra_ctx, p, p->flow, ssn, stream,
                               rd.data, rd.data_len,
                               StreamGetAppLayerFlags(ssn, stream, p));
@@ -3194,6 +3055,14 @@ static int DoRawReassemble(TcpSession *ssn, TcpStream *stream, TcpSegment *seg,
             SCLogDebug("smsg->seq %u", rd->smsg->seq);
         }
 
+        const uint8_t *seg_data;
+        uint32_t seg_datalen;
+        StreamTcpSegmentGetData(stream, seg, &seg_data, &seg_datalen);
+        if (seg_data == NULL || seg_datalen < seg->payload_len) {
+            SCLogDebug("segment data not in the stream buffer");
+            return 1;
+        }
+
         /* copy the data into the smsg */
         uint32_t copy_size = rd->smsg->data_size - rd->smsg_offset;
         if (copy_size + payload_offset > seg->payload_len) {
@@ -3206,7 +3075,7 @@ static int DoRawReassemble(TcpSession *ssn, TcpStream *stream, TcpSegment *seg,
             BUG_ON(copy_size > rd->smsg->data_size);
         }
         SCLogDebug("copy_size is %"PRIu16"", copy_size);
-        memcpy(rd->smsg->data + rd->smsg_offset, seg->payload + payload_offset,
+        memcpy(rd->smsg->data + rd->smsg_offset, seg_data + payload_offset,
                 copy_size);
         rd->smsg_offset += copy_size;
         rd->ra_base_seq += copy_size;
@@ -3266,7 +3135,7 @@ static int DoRawReassemble(TcpSession *ssn, TcpStream *stream, TcpSegment *seg,
                 SCLogDebug("copy payload_offset %" PRIu32 ", smsg_offset "
                         "%" PRIu32 ", copy_size %" PRIu32 "",
                         payload_offset, rd->smsg_offset, copy_size);
-                memcpy(rd->smsg->data + rd->smsg_offset, seg->payload +
+                memcpy(rd->smsg->data + rd->smsg_offset, seg_data +
                         payload_offset, copy_size);
                 rd->smsg_offset += copy_size;
                 rd->ra_base_seq += copy_size;
@@ -3407,6 +3276,8 @@ int StreamTcpReassembleHandleSegmentUpdateACK (ThreadVars *tv,
             r = -1;
         if (StreamTcpReassembleRaw(ra_ctx, ssn, stream, p) < 0)
             r = -1;
+
+        StreamTcpReassembleSlideBuffer(stream);
     }
 
     SCLogDebug("stream->seg_list %p", stream->seg_list);
@@ -3459,6 +3330,8 @@ int StreamTcpReassembleHandleSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_
         if (StreamTcpReassembleInlineRaw(ra_ctx, ssn, stream, p) < 0)
             r = -1;
 
+        StreamTcpReassembleSlideBuffer(stream);
+
         if (r < 0) {
             SCReturnInt(-1);
         }
@@ -3470,145 +3343,202 @@ int StreamTcpReassembleHandleSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_
 /**
  *  \brief  Function to replace the data from a specific point up to given length.
  *
+ *  The data of src_seg is taken from the packet, and written to the stream
+ *  buffer at the location of dst_seg. dst_seg is updated to point to its
+ *  data in the buffer.
+ *
+ *  \param  stream      Stream the segments belong to
  *  \param  dst_seg     Destination segment to replace the data
  *  \param  src_seg     Source segment of which data is to be written to destination
+ *  \param  p           Packet that contains the data of src_seg
  *  \param  start_point Starting point to replace the data onwards
  *  \param  len         Length up to which data is need to be replaced
- *
- *  \todo VJ We can remove the abort()s later.
- *  \todo VJ Why not memcpy?
  */
-void StreamTcpSegmentDataReplace(TcpSegment *dst_seg, TcpSegment *src_seg,
+void StreamTcpSegmentDataReplace(TcpStream *stream, TcpSegment *dst_seg,
+                                 TcpSegment *src_seg, Packet *p,
                                  uint32_t start_point, uint16_t len)
 {
-    uint32_t seq;
-    uint16_t src_pos = 0;
-    uint16_t dst_pos = 0;
+    uint32_t seq = start_point;
+    uint32_t end = start_point + len;
 
     SCLogDebug("start_point %u", start_point);
 
-    if (SEQ_GT(start_point, dst_seg->seq)) {
-        dst_pos = start_point - dst_seg->seq;
-    } else if (SEQ_LT(start_point, dst_seg->seq)) {
-        dst_pos = dst_seg->seq - start_point;
-    }
+    StreamTcpSegmentDataCopy(stream, dst_seg);
+
+    /* limit to the range both segments cover */
+    if (SEQ_LT(seq, src_seg->seq))
+        seq = src_seg->seq;
+    if (SEQ_LT(seq, dst_seg->seq))
+        seq = dst_seg->seq;
+    if (SEQ_GT(end, (src_seg->seq + src_seg->payload_len)))
+        end = src_seg->seq + src_seg->payload_len;
+    if (SEQ_GT(end, (dst_seg->seq + dst_seg->payload_len)))
+        end = dst_seg->seq + dst_seg->payload_len;
+    if (SEQ_GEQ(seq, end))
+        return;
 
+    uint32_t pkt_off = seq - TCP_GET_SEQ(p);
+    uint32_t size = end - seq;
     if (SCLogDebugEnabled()) {
-        BUG_ON(((len + dst_pos) - 1) > dst_seg->payload_len);
+        BUG_ON(pkt_off + size > p->payload_len);
     } else {
-        if (((len + dst_pos) - 1) > dst_seg->payload_len)
+        if (pkt_off + size > p->payload_len)
             return;
     }
 
-    src_pos = (uint16_t)(start_point - src_seg->seq);
+    /* space was reserved by StreamTcpReassemblePrepareSegmentData */
+    (void)StreamingBufferInsertAtNoTrack(&stream->sb, p->payload + pkt_off,
+            size, StreamTcpSeqToOffset(stream, seq));
 
-    SCLogDebug("Replacing data from dst_pos %"PRIu16"", dst_pos);
-
-    for (seq = start_point; SEQ_LT(seq, (start_point + len)) &&
-            src_pos < src_seg->payload_len && dst_pos < dst_seg->payload_len;
-            seq++, dst_pos++, src_pos++)
-    {
-        dst_seg->payload[dst_pos] = src_seg->payload[src_pos];
-    }
-
-    SCLogDebug("Replaced data of size %"PRIu16" up to src_pos %"PRIu16
-            " dst_pos %"PRIu16, len, src_pos, dst_pos);
+    SCLogDebug("Replaced data of size %"PRIu32" from seq %"PRIu32, size, seq);
 }
 
 /**
  *  \brief  Function to compare the data from a specific point up to given length.
  *
+ *  Compares the data in the stream buffer with the data of the packet.
+ *
+ *  \param  stream      Stream the segments belong to
  *  \param  dst_seg     Destination segment to compare the data
  *  \param  src_seg     Source segment of which data is to be compared to destination
+ *  \param  p           Packet that contains the new data
  *  \param  start_point Starting point to compare the data onwards
  *  \param  len         Length up to which data is need to be compared
  *
  *  \retval 1 same
  *  \retval 0 different
  */
-static int StreamTcpSegmentDataCompare(TcpSegment *dst_seg, TcpSegment *src_seg,
+static int StreamTcpSegmentDataCompare(TcpStream *stream, TcpSegment *dst_seg,
+                                 TcpSegment *src_seg, Packet *p,
                                  uint32_t start_point, uint16_t len)
 {
-    uint32_t seq;
-    uint16_t src_pos = 0;
-    uint16_t dst_pos = 0;
+    uint32_t seq = start_point;
+    uint32_t end = start_point + len;
 
     SCLogDebug("start_point %u dst_seg %u src_seg %u", start_point, dst_seg->seq, src_seg->seq);
 
-    if (SEQ_GT(start_point, dst_seg->seq)) {
-        SCLogDebug("start_point %u > dst %u", start_point, dst_seg->seq);
-        dst_pos = start_point - dst_seg->seq;
-    } else if (SEQ_LT(start_point, dst_seg->seq)) {
-        SCLogDebug("start_point %u < dst %u", start_point, dst_seg->seq);
-        dst_pos = dst_seg->seq - start_point;
-    }
-
-    if (SCLogDebugEnabled()) {
-        BUG_ON(((len + dst_pos) - 1) > dst_seg->payload_len);
-    } else {
-        if (((len + dst_pos) - 1) > dst_seg->payload_len)
-            return 1;
-    }
+    if (SEQ_LT(seq, src_seg->seq))
+        seq = src_seg->seq;
+    if (SEQ_LT(seq, dst_seg->seq))
+        seq = dst_seg->seq;
+    if (SEQ_GT(end, (src_seg->seq + src_seg->payload_len)))
+        end = src_seg->seq + src_seg->payload_len;
+    if (SEQ_GT(end, (dst_seg->seq + dst_seg->payload_len)))
+        end = dst_seg->seq + dst_seg->payload_len;
+    if (SEQ_GEQ(seq, end))
+        return 1;
 
-    src_pos = (uint16_t)(start_point - src_seg->seq);
+    uint32_t pkt_off = seq - TCP_GET_SEQ(p);
+    uint32_t size = end - seq;
+    if (pkt_off + size > p->payload_len)
+        return 1;
 
-    SCLogDebug("Comparing data from dst_pos %"PRIu16", src_pos %u", dst_pos, src_pos);
+    const uint8_t *data = NULL;
+    uint32_t data_len = 0;
+    if (StreamingBufferGetDataAtOffset(&stream->sb, &data, &data_len,
+                StreamTcpSeqToOffset(stream, seq)) == 0 || data_len < size)
+        return 1;
 
-    for (seq = start_point; SEQ_LT(seq, (start_point + len)) &&
-            src_pos < src_seg->payload_len && dst_pos < dst_seg->payload_len;
-            seq++, dst_pos++, src_pos++)
-    {
-        if (dst_seg->payload[dst_pos] != src_seg->payload[src_pos]) {
-            SCLogDebug("data is different %02x != %02x, dst_pos %u, src_pos %u", dst_seg->payload[dst_pos], src_seg->payload[src_pos], dst_pos, src_pos);
-            return 0;
-        }
+    if (memcmp(data, p->payload + pkt_off, size) != 0) {
+        SCLogDebug("data is different in range %u-%u", seq, end);
+        return 0;
     }
 
-    SCLogDebug("Compared data of size %"PRIu16" up to src_pos %"PRIu16
-            " dst_pos %"PRIu16, len, src_pos, dst_pos);
+    SCLogDebug("Compared data of size %"PRIu32" from seq %"PRIu32, size, seq);
     return 1;
 }
 
 /**
- *  \brief  Function to copy the data from src_seg to dst_seg.
+ *  \brief  Function to set up a segment to use the data of the segments it
+ *          replaces.
  *
- *  \param  dst_seg     Destination segment for copying the contents
- *  \param  src_seg     Source segment to copy its contents
+ *  The segment data is stored in the stream buffer by sequence number, so
+ *  a segment that replaces list segment(s) covering the same range can just
+ *  point to their data.
  *
- *  \todo VJ wouldn't a memcpy be more appropriate here?
+ *  \param  stream      Stream the segment belongs to
+ *  \param  dst_seg     Segment to set up
  *
- *  \warning Both segments need to be properly initialized.
+ *  \warning seq and payload_len of the segment need to be initialized.
  */
+void StreamTcpSegmentDataCopy(TcpStream *stream, TcpSegment *dst_seg)
+{
+    dst_seg->sbseg.stream_offset = StreamTcpSeqToOffset(stream, dst_seg->seq);
+    dst_seg->sbseg.segment_len = dst_seg->payload_len;
+}
 
-void StreamTcpSegmentDataCopy(TcpSegment *dst_seg, TcpSegment *src_seg)
+/**
+ *  \internal
+ *  \brief write the data of a segment that doesn't overlap with the list to
+ *         the stream buffer.
+ */
+static void StreamTcpSegmentDataWrite(TcpStream *stream, TcpSegment *seg, Packet *p)
 {
-    uint32_t u;
-    uint16_t dst_pos = 0;
-    uint16_t src_pos = 0;
-    uint32_t seq;
+    StreamTcpSegmentDataReplace(stream, seg, seg, p, seg->seq, seg->payload_len);
+}
 
-    if (SEQ_GT(dst_seg->seq, src_seg->seq)) {
-        src_pos = dst_seg->seq - src_seg->seq;
-        seq = dst_seg->seq;
-    } else {
-        dst_pos = src_seg->seq - dst_seg->seq;
-        seq = src_seg->seq;
-    }
+/**
+ *  \internal
+ *  \brief prepare the stream buffer for a new segment
+ *
+ *  If the segment list is empty, the buffer is reset to start at the
+ *  current reassembly point. The part of the segment that is before the
+ *  start of the buffer is cut off. Then space for the segment is reserved
+ *  in the buffer, and the part of the segment data that is beyond the end
+ *  of the data in the memory block holding it is added, so that all later
+ *  writes for this segment fit in the buffer.
+ *
+ *  \retval 0 ok
+ *  \retval 1 nothing left of the segment
+ *  \retval -1 error, out of memory
+ */
+static int StreamTcpReassemblePrepareSegmentData(TcpStream *stream,
+        TcpSegment *seg, Packet *p)
+{
+    StreamingBuffer *sb = StreamTcpGetStreamingBuffer(stream);
 
-    SCLogDebug("Copying data from seq %"PRIu32"", seq);
-    for (u = seq;
-            (SEQ_LT(u, (src_seg->seq + src_seg->payload_len)) &&
-             SEQ_LT(u, (dst_seg->seq + dst_seg->payload_len))); u++)
-    {
-        //SCLogDebug("u %"PRIu32, u);
+    if (stream->seg_list == NULL) {
+        StreamTcpReassembleSlideBuffer(stream);
+
+        /* start at the reassembly point so that segments filling the gap
+         * before this segment can still be added, unless that would waste
+         * more than a window of memory. */
+        uint32_t base_seq = StreamTcpReassembleGetRaBaseSeq(stream) + 1;
+        uint32_t limit = stream->window ? stream->window : 0xffff;
+        if (SEQ_LT(seg->seq, base_seq) || (seg->seq - base_seq) > limit)
+            base_seq = seg->seq;
+        stream->base_seq = base_seq;
+
+    } else if (SEQ_LT(seg->seq, stream->base_seq)) {
+        if (SEQ_LEQ((seg->seq + seg->payload_len), stream->base_seq))
+            return 1;
 
-        dst_seg->payload[dst_pos] = src_seg->payload[src_pos];
+        uint16_t skip = (uint16_t)(stream->base_seq - seg->seq);
+        SCLogDebug("cutting %u bytes before base_seq %u", skip, stream->base_seq);
+        seg->seq += skip;
+        seg->payload_len -= skip;
+    }
 
-        dst_pos++;
-        src_pos++;
+    /* segments far ahead of the data go into a separate region of the
+     * buffer, so they don't make it allocate the gap in between */
+    uint64_t seg_offset = StreamTcpSeqToOffset(stream, seg->seq);
+    uint64_t seg_end = seg_offset + seg->payload_len;
+    uint64_t buf_end = 0;
+    if (StreamingBufferReserveAt(sb, seg_offset, seg->payload_len, &buf_end) < 0) {
+        SCLogDebug("failed to reserve space in the stream buffer");
+        return -1;
+    }
+    if (seg_end > buf_end) {
+        uint64_t start = (seg_offset > buf_end) ? seg_offset : buf_end;
+        uint32_t pkt_off = (seg->seq + (uint32_t)(start - seg_offset)) - TCP_GET_SEQ(p);
+        if (StreamingBufferInsertAtNoTrack(sb, p->payload + pkt_off,
+                    (uint32_t)(seg_end - start), start) < 0)
+        {
+            SCLogDebug("failed to add segment data to the stream buffer");
+            return -1;
+        }
     }
-    SCLogDebug("Copyied data of size %"PRIu16" up to dst_pos %"PRIu16"",
-                src_pos, dst_pos);
+    return 0;
 }
 
 /**
@@ -3620,29 +3550,27 @@ void StreamTcpSegmentDataCopy(TcpSegment *dst_seg, TcpSegment *src_seg)
  */
 TcpSegment* StreamTcpGetSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx, uint16_t len)
 {
-    uint16_t idx = segment_pool_idx[len];
-    SCLogDebug("segment_pool_idx %" PRIu32 " for payload_len %" PRIu32 "",
-                idx, len);
+    SCMutexLock(&segment_pool_mutex);
+    TcpSegment *seg = (TcpSegment *) PoolGet(segment_pool);
 
-    SCMutexLock(&segment_pool_mutex[idx]);
-    TcpSegment *seg = (TcpSegment *) PoolGet(segment_pool[idx]);
-
-    SCLogDebug("segment_pool[%u]->empty_stack_size %u, segment_pool[%u]->alloc_"
-               "list_size %u, alloc %u", idx, segment_pool[idx]->empty_stack_size,
-               idx, segment_pool[idx]->alloc_stack_size,
-               segment_pool[idx]->allocated);
-    SCMutexUnlock(&segment_pool_mutex[idx]);
+    SCLogDebug("segment_pool->empty_stack_size %u, segment_pool->alloc_"
+               "list_size %u, alloc %u", segment_pool->empty_stack_size,
+               segment_pool->alloc_stack_size, segment_pool->allocated);
+    SCMutexUnlock(&segment_pool_mutex);
 
     SCLogDebug("seg we return is %p", seg);
     if (seg == NULL) {
-        SCLogDebug("segment_pool[%u]->empty_stack_size %u, "
-                   "alloc %u", idx, segment_pool[idx]->empty_stack_size,
-                   segment_pool[idx]->allocated);
+        SCLogDebug("segment_pool->empty_stack_size %u, "
+                   "alloc %u", segment_pool->empty_stack_size,
+                   segment_pool->allocated);
         /* Increment the counter to show that we are not able to serve the
            segment request due to memcap limit */
         StatsIncr(tv, ra_ctx->counter_tcp_segment_memcap);
     } else {
         seg->flags = stream_config.segment_init_flags;
+        seg->payload_len = len;
+        seg->sbseg.stream_offset = 0;
+        seg->sbseg.segment_len = 0;
         seg->next = NULL;
         seg->prev = NULL;
     }
@@ -3976,24 +3904,32 @@ int StreamTcpCheckStreamContents(uint8_t *stream_policy, uint16_t sp_size, TcpSt
     TcpSegment *temp;
     uint16_t i = 0;
     uint8_t j;
+    const uint8_t *data;
+    uint32_t data_len;
 
 #ifdef DEBUG
     if (SCLogDebugEnabled()) {
         TcpSegment *temp1;
-        for (temp1 = stream->seg_list; temp1 != NULL; temp1 = temp1->next)
-            PrintRawDataFp(stdout, temp1->payload, temp1->payload_len);
+        for (temp1 = stream->seg_list; temp1 != NULL; temp1 = temp1->next) {
+            StreamTcpSegmentGetData(stream, temp1, &data, &data_len);
+            PrintRawDataFp(stdout, data, data_len);
+        }
 
         PrintRawDataFp(stdout, stream_policy, sp_size);
     }
 #endif
 
     for (temp = stream->seg_list; temp != NULL; temp = temp->next) {
+        StreamTcpSegmentGetData(stream, temp, &data, &data_len);
+        if (data == NULL || data_len != temp->payload_len)
+            return 0;
+
         j = 0;
         for (; j < temp->payload_len; j++) {
             SCLogDebug("i %"PRIu16", len %"PRIu32", stream %"PRIx32" and temp is %"PRIx8"",
-                i, temp->payload_len, stream_policy[i], temp->payload[j]);
+                i, temp->payload_len, stream_policy[i], data[j]);
 
-            if (stream_policy[i] == temp->payload[j]) {
+            if (stream_policy[i] == data[j]) {
                 i++;
                 continue;
             } else
@@ -8690,6 +8626,45 @@ end:
     return ret;
 }
 
+/** \test a segment at the top of a large window doesn't make the stream
+ *        buffer allocate the gap before it
+ */
+static int StreamTcpReassembleInsertTest04(void)
+{
+    TcpReassemblyThreadCtx *ra_ctx = NULL;
+    ThreadVars tv;
+    TcpSession ssn;
+
+    memset(&tv, 0x00, sizeof(tv));
+
+    StreamTcpUTInit(&ra_ctx);
+    StreamTcpUTSetupSession(&ssn);
+    StreamTcpUTSetupStream(&ssn.client, 1);
+    ssn.client.window = 1024 * 1024 * 1024;
+
+    FAIL_IF(StreamTcpUTAddSegmentWithByte(&tv, ra_ctx, &ssn.client, 2, 'A', 5) == -1);
+    uint64_t sbuse = StreamingBufferGetMemoryUse(&ssn.client.sb);
+    uint64_t memuse = SC_ATOMIC_GET(ra_memuse);
+
+    uint32_t seq = 2 + ssn.client.window - 1;
+    FAIL_IF(StreamTcpUTAddSegmentWithByte(&tv, ra_ctx, &ssn.client, seq, 'B', 1) == -1);
+    FAIL_IF(StreamingBufferGetMemoryUse(&ssn.client.sb) >
+            sbuse + 1 + sizeof(StreamingBufferRegion));
+    FAIL_IF(SC_ATOMIC_GET(ra_memuse) > memuse + 1 + sizeof(StreamingBufferRegion));
+
+    /* both segments still have their data */
+    const uint8_t *data = NULL;
+    uint32_t data_len = 0;
+    StreamTcpSegmentGetData(&ssn.client, ssn.client.seg_list, &data, &data_len);
+    FAIL_IF(data_len != 5 || memcmp(data, "AAAAA", 5) != 0);
+    StreamTcpSegmentGetData(&ssn.client, ssn.client.seg_list_tail, &data, &data_len);
+    FAIL_IF(data_len != 1 || data[0] != 'B');
+
+    StreamTcpUTClearSession(&ssn);
+    StreamTcpUTDeinit(ra_ctx);
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 /** \brief  The Function Register the Unit tests to test the reassembly engine
@@ -8818,6 +8793,8 @@ void StreamTcpReassembleRegisterTests(void)
                    StreamTcpReassembleInsertTest02);
     UtRegisterTest("StreamTcpReassembleInsertTest03 -- insert with overlap",
                    StreamTcpReassembleInsertTest03);
+    UtRegisterTest("StreamTcpReassembleInsertTest04 -- insert far ahead",
+                   StreamTcpReassembleInsertTest04);
 
     StreamTcpInlineRegisterTests();
     StreamTcpUtilRegisterTests();
@@ -512,7 +512,7 @@ void StreamTcpInitConfig(char quiet)
     char *temp_stream_reassembly_toserver_chunk_size_str;
     if (ConfGet("stream.reassembly.toserver-chunk-size",
                 &temp_stream_reassembly_toserver_chunk_size_str) == 1) {
-        if (ParseSizeStringU16(temp_stream_reassembly_toserver_chunk_size_str,
+        if (ParseSizeStringU32(temp_stream_reassembly_toserver_chunk_size_str,
                                &stream_config.reassembly_toserver_chunk_size) < 0) {
             SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
                        "stream.reassembly.toserver-chunk-size "
@@ -536,7 +536,7 @@ void StreamTcpInitConfig(char quiet)
     char *temp_stream_reassembly_toclient_chunk_size_str;
     if (ConfGet("stream.reassembly.toclient-chunk-size",
                 &temp_stream_reassembly_toclient_chunk_size_str) == 1) {
-        if (ParseSizeStringU16(temp_stream_reassembly_toclient_chunk_size_str,
+        if (ParseSizeStringU32(temp_stream_reassembly_toclient_chunk_size_str,
                                &stream_config.reassembly_toclient_chunk_size) < 0) {
             SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
                        "stream.reassembly.toclient-chunk-size "
@@ -559,9 +559,9 @@ void StreamTcpInitConfig(char quiet)
             stream_config.reassembly_toclient_chunk_size);
 
     if (!quiet) {
-        SCLogConfig("stream.reassembly \"toserver-chunk-size\": %"PRIu16,
+        SCLogConfig("stream.reassembly \"toserver-chunk-size\": %"PRIu32,
             stream_config.reassembly_toserver_chunk_size);
-        SCLogConfig("stream.reassembly \"toclient-chunk-size\": %"PRIu16,
+        SCLogConfig("stream.reassembly \"toclient-chunk-size\": %"PRIu32,
             stream_config.reassembly_toclient_chunk_size);
     }
 
@@ -5783,7 +5783,11 @@ int StreamTcpSegmentForEach(const Packet *p, uint8_t flag, StreamSegmentCallback
     for (; seg != NULL &&
             (stream_inline || SEQ_LT(seg->seq, stream->last_ack));)
     {
-        ret = CallbackFunc(p, data, seg->payload, seg->payload_len);
+        const uint8_t *seg_data;
+        uint32_t seg_datalen;
+        StreamTcpSegmentGetData(stream, seg, &seg_data, &seg_datalen);
+
+        ret = CallbackFunc(p, data, (uint8_t *)seg_data, seg_datalen);
         if (ret != 1) {
             SCLogDebug("Callback function has failed");
             return -1;
@@ -8991,7 +8995,11 @@ static int StreamTcpTest30(void)
 
     if (StreamTcpCheckStreamContents(expected_content, 9, &ssn.client) != 1) {
         printf("the contents are not as expected(GET /EVIL), contents are: ");
-        PrintRawDataFp(stdout, ssn.client.seg_list->payload, 9);
+        const uint8_t *seg_data;
+        uint32_t seg_datalen;
+        StreamTcpSegmentGetData(&ssn.client, ssn.client.seg_list,
+                &seg_data, &seg_datalen);
+        PrintRawDataFp(stdout, seg_data, seg_datalen);
         result &= 0;
         goto end;
     }
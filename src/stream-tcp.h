@@ -51,16 +51,13 @@ typedef struct TcpStreamCnf_ {
     uint32_t ssn_init_flags; /**< new ssn flags will be initialized to this */
     uint8_t segment_init_flags; /**< new seg flags will be initialized to this */
 
-    uint16_t zero_copy_size;    /**< use zero copy for app layer above segments
-                                 *   of this size */
-
     uint32_t prealloc_sessions; /**< ssns to prealloc per stream thread */
     int midstream;
     int async_oneside;
     uint32_t reassembly_depth;  /**< Depth until when we reassemble the stream */
 
-    uint16_t reassembly_toserver_chunk_size;
-    uint16_t reassembly_toclient_chunk_size;
+    uint32_t reassembly_toserver_chunk_size;
+    uint32_t reassembly_toclient_chunk_size;
 
     int check_overlap_different_data;
     int bypass;
@@ -72,6 +69,8 @@ typedef struct TcpStreamCnf_ {
     uint32_t reassembly_inline_window;
     uint8_t flags;
     uint8_t max_synack_queued;
+
+    StreamingBufferConfig sbcnf;    /**< config for the per stream data buffers */
 } TcpStreamCnf;
 
 typedef struct StreamTcpThread_ {
@@ -39,8 +39,8 @@ static uint64_t stream_pool_memcnt = 0;
 #endif
 
 /* per queue setting */
-static uint16_t toserver_min_chunk_len = 2560;
-static uint16_t toclient_min_chunk_len = 2560;
+static uint32_t toserver_min_chunk_len = 2560;
+static uint32_t toclient_min_chunk_len = 2560;
 
 static Pool *stream_msg_pool = NULL;
 static SCMutex stream_msg_pool_mutex = SCMUTEX_INITIALIZER;
@@ -234,7 +234,7 @@ void StreamMsgQueueFree(StreamMsgQueue *q)
     StreamTcpReassembleDecrMemuse((uint32_t)sizeof(StreamMsgQueue));
 }
 
-void StreamMsgQueueSetMinChunkLen(uint8_t dir, uint16_t len)
+void StreamMsgQueueSetMinChunkLen(uint8_t dir, uint32_t len)
 {
     if (dir == FLOW_PKT_TOSERVER) {
         toserver_min_chunk_len = len;
@@ -243,7 +243,7 @@ void StreamMsgQueueSetMinChunkLen(uint8_t dir, uint16_t len)
     }
 }
 
-uint16_t StreamMsgQueueGetMinChunkLen(uint8_t dir)
+uint32_t StreamMsgQueueGetMinChunkLen(uint8_t dir)
 {
     if (dir == FLOW_PKT_TOSERVER) {
         return toserver_min_chunk_len;
@@ -65,8 +65,8 @@ void StreamMsgPutInQueue(StreamMsgQueue *, StreamMsg *);
 StreamMsgQueue *StreamMsgQueueGetNew(void);
 void StreamMsgQueueFree(StreamMsgQueue *);
 
-void StreamMsgQueueSetMinChunkLen(uint8_t dir, uint16_t len);
-uint16_t StreamMsgQueueGetMinChunkLen(uint8_t);
+void StreamMsgQueueSetMinChunkLen(uint8_t dir, uint32_t len);
+uint32_t StreamMsgQueueGetMinChunkLen(uint8_t);
 
 void StreamMsgReturnListToPool(void *);
 
@@ -172,6 +172,9 @@
 #include <netdb.h>
 #endif
 
+/* the pcap headers define struct bpf_insn, which conflicts with the
+ * kernel's definition used by the eBPF code */
+#ifndef SC_PCAP_DONT_INCLUDE_PCAP_H
 #ifdef HAVE_PCAP_H
 #include <pcap.h>
 #endif
@@ -183,6 +186,7 @@
 #ifdef HAVE_PCAP_BPF_H
 #include <pcap/bpf.h>
 #endif
+#endif /* SC_PCAP_DONT_INCLUDE_PCAP_H */
 
 #if __CYGWIN__
 #if !defined _X86_ && !defined __x86_64
@@ -311,26 +315,10 @@
 
 typedef enum PacketProfileDetectId_ {
     PROF_DETECT_MPM,
-    PROF_DETECT_MPM_PACKET,         /* PKT MPM */
-    PROF_DETECT_MPM_PKT_STREAM,     /* PKT inspected with stream MPM */
-    PROF_DETECT_MPM_STREAM,         /* STREAM MPM */
-    PROF_DETECT_MPM_URI,
-    PROF_DETECT_MPM_HCBD,
-    PROF_DETECT_MPM_HSBD,
-    PROF_DETECT_MPM_HHD,
-    PROF_DETECT_MPM_HRHD,
-    PROF_DETECT_MPM_HMD,
-    PROF_DETECT_MPM_HCD,
-    PROF_DETECT_MPM_HRUD,
-    PROF_DETECT_MPM_HSMD,
-    PROF_DETECT_MPM_HSCD,
-    PROF_DETECT_MPM_HUAD,
-    PROF_DETECT_MPM_HHHD,
-    PROF_DETECT_MPM_HRHHD,
-    PROF_DETECT_MPM_DNSQUERY,
-    PROF_DETECT_MPM_TLSSNI,
-    PROF_DETECT_MPM_TLSISSUER,
-    PROF_DETECT_MPM_TLSSUBJECT,
+    PROF_DETECT_PF_PKT,         /* packet prefilter engines */
+    PROF_DETECT_PF_PAYLOAD,     /* payload prefilter engines */
+    PROF_DETECT_PF_TX,          /* tx prefilter engines */
+    PROF_DETECT_PF_SORT,        /* sort of the prefilter results */
     PROF_DETECT_IPONLY,
     PROF_DETECT_RULES,
     PROF_DETECT_STATEFUL,
@@ -339,7 +327,6 @@ typedef enum PacketProfileDetectId_ {
     PROF_DETECT_ALERT,
     PROF_DETECT_CLEANUP,
     PROF_DETECT_GETSGH,
-    PROF_DETECT_MPM_FD_SMTP,
 
     PROF_DETECT_SIZE,
 } PacketProfileDetectId;
@@ -371,6 +358,7 @@ typedef enum {
     LOGGER_JSON_NETFLOW,
     LOGGER_STATS,
     LOGGER_JSON_STATS,
+    LOGGER_JSON_RULE_PROFILING,
     LOGGER_PRELUDE,
     LOGGER_PCAP,
     LOGGER_SIZE,
@@ -51,6 +51,7 @@
 #include "util-action.h"
 #include "util-pidfile.h"
 #include "util-ioctl.h"
+#include "util-ebpf.h"
 #include "util-device.h"
 #include "util-misc.h"
 #include "util-running-modes.h"
@@ -60,9 +61,11 @@
 #include "detect-fast-pattern.h"
 #include "detect-engine-tag.h"
 #include "detect-engine-threshold.h"
+#include "detect-engine-mpm-stream.h"
 #include "detect-engine-address.h"
 #include "detect-engine-port.h"
 #include "detect-engine-mpm.h"
+#include "detect-engine-state.h"
 
 #include "tm-queuehandlers.h"
 #include "tm-queues.h"
@@ -163,9 +166,10 @@
 #include "util-proto-name.h"
 #ifdef __SC_CUDA_SUPPORT__
 #include "util-cuda-buffer.h"
-#include "util-mpm-ac.h"
 #endif
+#include "util-mpm-ac.h"
 #include "util-mpm-hs.h"
+#include "util-mpm-cache.h"
 #include "util-storage.h"
 #include "host-storage.h"
 
@@ -685,12 +689,18 @@ void SCPrintBuildInfo(void)
 
     /* SIMD stuff */
     memset(features, 0x00, sizeof(features));
+#if defined(__AVX2__)
+    strlcat(features, "AVX2 ", sizeof(features));
+#endif
 #if defined(__SSE4_2__)
     strlcat(features, "SSE_4_2 ", sizeof(features));
 #endif
 #if defined(__SSE4_1__)
     strlcat(features, "SSE_4_1 ", sizeof(features));
 #endif
+#if defined(__SSSE3__)
+    strlcat(features, "SSSE_3 ", sizeof(features));
+#endif
 #if defined(__SSE3__)
     strlcat(features, "SSE_3 ", sizeof(features));
 #endif
@@ -2302,18 +2312,20 @@ static int PostConfLoadedSetup(SCInstance *suri)
     StorageInit();
     CIDRInit();
     SigParsePrepare();
-#ifdef PROFILING
     if (suri->run_mode != RUNMODE_UNIX_SOCKET) {
         SCProfilingRulesGlobalInit();
+#ifdef PROFILING
         SCProfilingKeywordsGlobalInit();
         SCProfilingSghsGlobalInit();
         SCProfilingInit();
-    }
 #endif /* PROFILING */
+    }
     SCReputationInitCtx();
     SCProtoNameInit();
 
     TagInitCtx();
+    FlowBypassInfoRegister();
+    DetectMpmStreamRegister();
     PacketAlertTagInit();
     ThresholdInit();
     HostBitInitCtx();
@@ -2471,6 +2483,8 @@ int main(int argc, char **argv)
         StreamTcpInitConfig(STREAM_VERBOSE);
         IPPairInitConfig(IPPAIR_VERBOSE);
         AppLayerRegisterGlobalCounters();
+        DetectEngineStateRegisterGlobalCounters();
+        DetectEngineBuildRegisterGlobalCounters();
     }
 
     DetectEngineCtx *de_ctx = NULL;
@@ -2731,6 +2745,9 @@ int main(int argc, char **argv)
 #ifdef HAVE_AF_PACKET
     AFPPeersListClean();
 #endif
+#ifdef HAVE_PACKET_EBPF
+    EBPFShutdown();
+#endif
 
 #ifdef PROFILING
     if (suri.run_mode != RUNMODE_UNIX_SOCKET) {
@@ -2748,9 +2765,11 @@ int main(int argc, char **argv)
 
     SC_ATOMIC_DESTROY(engine_stage);
 
+    MpmACGlobalCleanup();
 #ifdef BUILD_HYPERSCAN
     MpmHSGlobalCleanup();
 #endif
+    MpmCacheGlobalCleanup();
 
 #ifdef __SC_CUDA_SUPPORT__
     if (PatternMatchDefaultMatcher() == MPM_AC_CUDA)
@@ -33,6 +33,8 @@
 #include "tm-queues.h"
 #include "tm-queuehandlers.h"
 #include "tm-threads.h"
+#include "flow-hash.h"
+#include "flow-worker.h"
 #include "tmqh-packetpool.h"
 #include "threads.h"
 #include "util-debug.h"
@@ -173,6 +175,94 @@ TmEcode TmThreadsSlotVarRun(ThreadVars *tv, Packet *p,
     return TM_ECODE_OK;
 }
 
+/**
+ *  \brief Process a batch of packets
+ *
+ *  All packets are first run through the slot 's' (the decoder). Then
+ *  the flow hash buckets for the whole batch are prefetched, after which
+ *  each packet is run through the remaining slots. This way the bucket
+ *  and flow cache misses of one packet overlap with the work on the
+ *  others, instead of stalling the flow lookup of every packet.
+ *
+ *  Packets created by the decoder (tunnels) are processed after the
+ *  packets before it in the batch, but before the packet itself, as
+ *  TmThreadsSlotVarRun() would.
+ *
+ *  On failure all packets that have not been processed yet are returned
+ *  to the packet pool. The caller should not touch them anymore.
+ *
+ *  \param s first slot, normally the decode slot
+ *  \param pkts array of cnt packets
+ */
+TmEcode TmThreadsSlotProcessPktBatch(ThreadVars *tv, TmSlot *s,
+        Packet **pkts, const uint32_t cnt)
+{
+    uint32_t i, done = 0;
+
+    /* nothing to gain if there is no slot after the decoder. Slot 0 is
+     * also left to TmThreadsSlotProcessPkt as it may fill its post pq */
+    if (s == NULL || s->slot_next == NULL || s->id == 0 || cnt == 1) {
+        for (done = 0; done < cnt; ) {
+            if (TmThreadsSlotProcessPkt(tv, s, pkts[done++]) != TM_ECODE_OK)
+                goto error;
+        }
+        return TM_ECODE_OK;
+    }
+
+    TmSlotFunc SlotFunc = SC_ATOMIC_GET(s->SlotFunc);
+    void *slot_data = SC_ATOMIC_GET(s->slot_data);
+
+    for (i = 0; i < cnt; i++) {
+        Packet *p = pkts[i];
+
+        PACKET_PROFILING_TMM_START(p, s->tm_id);
+        TmEcode r = SlotFunc(tv, p, slot_data, &s->slot_pre_pq, NULL);
+        PACKET_PROFILING_TMM_END(p, s->tm_id);
+
+        if (unlikely(r == TM_ECODE_FAILED)) {
+            TmqhReleasePacketsToPacketPool(&s->slot_pre_pq);
+            goto error;
+        }
+
+        if (s->slot_pre_pq.top == NULL)
+            continue;
+
+        /* decoder created new packets: first finish the packets before
+         * the current one, then the new packets */
+        FlowHashPrefetchBatch(pkts + done, i - done);
+        while (done < i) {
+            if (TmThreadsSlotProcessPkt(tv, s->slot_next, pkts[done++]) != TM_ECODE_OK) {
+                TmqhReleasePacketsToPacketPool(&s->slot_pre_pq);
+                goto error;
+            }
+        }
+        while (s->slot_pre_pq.top != NULL) {
+            Packet *extra_p = PacketDequeue(&s->slot_pre_pq);
+            if (unlikely(extra_p == NULL))
+                continue;
+
+            if (TmThreadsSlotProcessPkt(tv, s->slot_next, extra_p) != TM_ECODE_OK) {
+                TmqhReleasePacketsToPacketPool(&s->slot_pre_pq);
+                goto error;
+            }
+        }
+    }
+
+    FlowHashPrefetchBatch(pkts + done, cnt - done);
+    while (done < cnt) {
+        if (TmThreadsSlotProcessPkt(tv, s->slot_next, pkts[done++]) != TM_ECODE_OK)
+            goto error;
+    }
+    return TM_ECODE_OK;
+
+error:
+    for ( ; done < cnt; done++) {
+        TmqhOutputPacketpool(tv, pkts[done]);
+    }
+    TmThreadsSetFlag(tv, THV_FAILED);
+    return TM_ECODE_FAILED;
+}
+
 /** \internal
  *
  *  \brief Process flow timeout packets
@@ -200,9 +290,18 @@ static int TmThreadTimeoutLoop(ThreadVars *tv, TmSlot *s)
         return r;
     }
 
+    /* the flows of a private flow table are handled by the worker
+     * itself, see FlowWorkerPrivateTableShutdown() */
+    int private_flows_done = 0;
+
     SCLogDebug("flow end loop starting");
     while(run) {
         Packet *p;
+        if (!private_flows_done && tv->stream_pq->len == 0) {
+            private_flows_done = FlowWorkerPrivateTableShutdown(tv,
+                    SC_ATOMIC_GET(stream_slot->slot_data));
+        }
+
         if (tv->stream_pq->len != 0) {
             SCMutexLock(&tv->stream_pq->mutex_q);
             p = PacketDequeue(tv->stream_pq);
@@ -217,7 +316,8 @@ static int TmThreadTimeoutLoop(ThreadVars *tv, TmSlot *s)
             usleep(1);
         }
 
-        if (tv->stream_pq->len == 0 && TmThreadsCheckFlag(tv, THV_KILL)) {
+        if (private_flows_done && tv->stream_pq->len == 0 &&
+                TmThreadsCheckFlag(tv, THV_KILL)) {
             run = 0;
         }
     }
@@ -32,6 +32,7 @@
 #include "util-privs.h"
 #include "util-debug.h"
 #include "util-signal.h"
+#include "util-profiling.h"
 
 #include "util-buffer.h"
 
@@ -935,6 +936,7 @@ static TmEcode UnixManagerThreadInit(ThreadVars *t, void *initdata, void **data)
     UnixManagerRegisterCommand("register-tenant", UnixSocketRegisterTenant, &command, UNIX_CMD_TAKE_ARGS);
     UnixManagerRegisterCommand("reload-tenant", UnixSocketReloadTenant, &command, UNIX_CMD_TAKE_ARGS);
     UnixManagerRegisterCommand("unregister-tenant", UnixSocketUnregisterTenant, &command, UNIX_CMD_TAKE_ARGS);
+    UnixManagerRegisterCommand("rule-profiling", SCProfilingRuleUnixSocket, NULL, 0);
 
     *data = utd;
     return TM_ECODE_OK;
@@ -0,0 +1,484 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * eBPF program loading and flow bypass tables.
+ *
+ * Programs are loaded once per interface from an ELF object built with
+ * clang (see the ebpf/ directory). The maps of the loaded objects are
+ * kept in a list so the capture threads can find the bypass tables of
+ * their interface and the flow manager can expire the entries of the
+ * flows that are not seen anymore.
+ */
+
+#define SC_PCAP_DONT_INCLUDE_PCAP_H 1
+#include "suricata-common.h"
+#include "threads.h"
+
+#include "util-debug.h"
+#include "util-ebpf.h"
+
+#ifdef HAVE_PACKET_EBPF
+
+#include <net/if.h>
+#include <linux/if_link.h>
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+
+#define EBPF_IFACE_NAME_LENGTH  48
+#define EBPF_MAP_NAME_LENGTH    32
+
+typedef struct EBPFMap_ {
+    char iface[EBPF_IFACE_NAME_LENGTH];
+    char name[EBPF_MAP_NAME_LENGTH];
+    int fd;
+    struct EBPFMap_ *next;
+} EBPFMap;
+
+typedef struct EBPFObject_ {
+    struct bpf_object *obj;
+    struct EBPFObject_ *next;
+} EBPFObject;
+
+typedef struct EBPFXDPLink_ {
+    int ifindex;
+    uint32_t flags;
+    struct EBPFXDPLink_ *next;
+} EBPFXDPLink;
+
+static SCMutex ebpf_lock = SCMUTEX_INITIALIZER;
+static EBPFMap *ebpf_maps = NULL;
+static EBPFObject *ebpf_objects = NULL;
+static EBPFXDPLink *ebpf_xdp_links = NULL;
+
+static int ebpf_ncpus = 0;
+
+static int EBPFPossibleCpus(void)
+{
+    if (ebpf_ncpus == 0) {
+        int n = libbpf_num_possible_cpus();
+        ebpf_ncpus = (n > 0) ? n : 1;
+    }
+    return ebpf_ncpus;
+}
+
+static void EBPFRegisterMaps(const char *iface, struct bpf_object *bpfobj)
+{
+    struct bpf_map *map;
+
+    bpf_object__for_each_map(map, bpfobj) {
+        EBPFMap *m = SCCalloc(1, sizeof(*m));
+        if (unlikely(m == NULL))
+            return;
+        strlcpy(m->iface, iface, sizeof(m->iface));
+        strlcpy(m->name, bpf_map__name(map), sizeof(m->name));
+        m->fd = bpf_map__fd(map);
+
+        SCLogDebug("iface %s: map %s fd %d", m->iface, m->name, m->fd);
+
+        SCMutexLock(&ebpf_lock);
+        m->next = ebpf_maps;
+        ebpf_maps = m;
+        SCMutexUnlock(&ebpf_lock);
+    }
+}
+
+/**
+ * \brief load an eBPF program from an ELF object
+ *
+ * The maps of the object are registered for \a iface. The program stays
+ * loaded until EBPFShutdown().
+ *
+ * \param iface interface the program will be attached to
+ * \param path ELF file built by clang
+ * \param section ELF section of the program
+ * \param val set to the fd of the program
+ * \param flags EBPF_SOCKET_FILTER or EBPF_XDP_CODE
+ *
+ * \retval 0 on success, -1 on error
+ */
+int EBPFLoadFile(const char *iface, const char *path, const char *section,
+        int *val, uint8_t flags)
+{
+    struct bpf_object *bpfobj = NULL;
+    struct bpf_program *bpfprog = NULL;
+    struct bpf_program *found = NULL;
+    char errbuf[128];
+
+    if (path == NULL || section == NULL) {
+        SCLogError(SC_ERR_INVALID_VALUE, "No file defined to load eBPF from");
+        return -1;
+    }
+
+    bpfobj = bpf_object__open(path);
+    long error = libbpf_get_error(bpfobj);
+    if (bpfobj == NULL || error) {
+        libbpf_strerror(error, errbuf, sizeof(errbuf));
+        SCLogError(SC_ERR_INVALID_VALUE, "Unable to load eBPF objects in '%s': %s",
+                path, errbuf);
+        return -1;
+    }
+
+    bpf_object__for_each_program(bpfprog, bpfobj) {
+        const char *title = bpf_program__section_name(bpfprog);
+        if (title != NULL && strcmp(title, section) == 0) {
+            if (flags & EBPF_SOCKET_FILTER) {
+                bpf_program__set_type(bpfprog, BPF_PROG_TYPE_SOCKET_FILTER);
+            } else if (flags & EBPF_XDP_CODE) {
+                bpf_program__set_type(bpfprog, BPF_PROG_TYPE_XDP);
+            }
+            found = bpfprog;
+            break;
+        }
+    }
+    if (found == NULL) {
+        SCLogError(SC_ERR_INVALID_VALUE, "No section '%s' in '%s' file",
+                section, path);
+        bpf_object__close(bpfobj);
+        return -1;
+    }
+
+    if (bpf_object__load(bpfobj) != 0) {
+        SCLogError(SC_ERR_INVALID_VALUE, "Unable to load eBPF object '%s': %s",
+                path, strerror(errno));
+        bpf_object__close(bpfobj);
+        return -1;
+    }
+
+    int pfd = bpf_program__fd(found);
+    if (pfd < 0) {
+        SCLogError(SC_ERR_INVALID_VALUE, "Unable to find section '%s' in '%s'",
+                section, path);
+        bpf_object__close(bpfobj);
+        return -1;
+    }
+
+    EBPFObject *o = SCCalloc(1, sizeof(*o));
+    if (unlikely(o == NULL)) {
+        bpf_object__close(bpfobj);
+        return -1;
+    }
+    o->obj = bpfobj;
+
+    EBPFRegisterMaps(iface, bpfobj);
+
+    SCMutexLock(&ebpf_lock);
+    o->next = ebpf_objects;
+    ebpf_objects = o;
+    SCMutexUnlock(&ebpf_lock);
+
+    SCLogConfig("%s: loaded eBPF section '%s' from '%s'", iface, section, path);
+    *val = pfd;
+    return 0;
+}
+
+/**
+ * \brief attach an XDP program to an interface
+ *
+ * \param mode one of EBPF_XDP_MODE_*
+ *
+ * \retval 0 on success, -1 on error
+ */
+int EBPFSetupXDP(const char *iface, int fd, uint8_t mode)
+{
+    uint32_t flags = 0;
+    int ifindex = if_nametoindex(iface);
+    if (ifindex == 0) {
+        SCLogError(SC_ERR_INVALID_VALUE, "Unknown interface '%s'", iface);
+        return -1;
+    }
+
+    switch (mode) {
+        case EBPF_XDP_MODE_SOFT:
+            flags = XDP_FLAGS_SKB_MODE;
+            break;
+        case EBPF_XDP_MODE_HW:
+            flags = XDP_FLAGS_HW_MODE;
+            break;
+        case EBPF_XDP_MODE_DRIVER:
+        default:
+            flags = XDP_FLAGS_DRV_MODE;
+            break;
+    }
+
+#ifdef HAVE_BPF_XDP_ATTACH
+    int r = bpf_xdp_attach(ifindex, fd, flags, NULL);
+#else
+    int r = bpf_set_link_xdp_fd(ifindex, fd, flags);
+#endif
+    if (r != 0) {
+        SCLogError(SC_ERR_INVALID_VALUE, "Unable to attach XDP program to '%s': %s",
+                iface, strerror(r < 0 ? -r : errno));
+        return -1;
+    }
+
+    EBPFXDPLink *l = SCCalloc(1, sizeof(*l));
+    if (l != NULL) {
+        l->ifindex = ifindex;
+        l->flags = flags;
+        SCMutexLock(&ebpf_lock);
+        l->next = ebpf_xdp_links;
+        ebpf_xdp_links = l;
+        SCMutexUnlock(&ebpf_lock);
+    }
+
+    SCLogConfig("%s: XDP program attached", iface);
+    return 0;
+}
+
+/** \brief detach the XDP programs set up by EBPFSetupXDP() */
+void EBPFRemoveXDP(void)
+{
+    SCMutexLock(&ebpf_lock);
+    EBPFXDPLink *l = ebpf_xdp_links;
+    while (l != NULL) {
+        EBPFXDPLink *next = l->next;
+#ifdef HAVE_BPF_XDP_ATTACH
+        (void)bpf_xdp_detach(l->ifindex, l->flags, NULL);
+#else
+        (void)bpf_set_link_xdp_fd(l->ifindex, -1, l->flags);
+#endif
+        SCFree(l);
+        l = next;
+    }
+    ebpf_xdp_links = NULL;
+    SCMutexUnlock(&ebpf_lock);
+}
+
+/**
+ * \brief get the fd of a map loaded for an interface
+ *
+ * \retval fd or -1 if no such map was loaded
+ */
+int EBPFGetMapFDByName(const char *iface, const char *name)
+{
+    int fd = -1;
+
+    SCMutexLock(&ebpf_lock);
+    for (EBPFMap *m = ebpf_maps; m != NULL; m = m->next) {
+        if (strcmp(m->iface, iface) == 0 && strcmp(m->name, name) == 0) {
+            fd = m->fd;
+            break;
+        }
+    }
+    SCMutexUnlock(&ebpf_lock);
+    return fd;
+}
+
+static uint64_t EBPFTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int EBPFInsertKeys(int fd, void *keys, size_t keylen, int cnt)
+{
+    int ncpus = EBPFPossibleCpus();
+    struct pair *values = SCCalloc(ncpus, sizeof(struct pair));
+    if (unlikely(values == NULL))
+        return 0;
+
+    /* start with the current time so the entry is not expired before
+     * the kernel sees a packet of the flow */
+    uint64_t now = EBPFTimeNs();
+    for (int i = 0; i < ncpus; i++)
+        values[i].time = now;
+
+    int r = 1;
+    for (int i = 0; i < cnt; i++) {
+        void *key = (uint8_t *)keys + i * keylen;
+        if (bpf_map_update_elem(fd, key, values, BPF_NOEXIST) != 0 &&
+                errno != EEXIST) {
+            SCLogDebug("bypass map update failed: %s", strerror(errno));
+            r = 0;
+            break;
+        }
+    }
+    SCFree(values);
+    return r;
+}
+
+/**
+ * \brief add the keys of a flow to an IPv4 bypass table
+ *
+ * \retval 1 if the flow is bypassed in the kernel, 0 otherwise
+ */
+int EBPFBypassFlowV4(int fd, struct flowv4_keys *keys, int cnt)
+{
+    return EBPFInsertKeys(fd, keys, sizeof(struct flowv4_keys), cnt);
+}
+
+/**
+ * \brief add the keys of a flow to an IPv6 bypass table
+ *
+ * \retval 1 if the flow is bypassed in the kernel, 0 otherwise
+ */
+int EBPFBypassFlowV6(int fd, struct flowv6_keys *keys, int cnt)
+{
+    return EBPFInsertKeys(fd, keys, sizeof(struct flowv6_keys), cnt);
+}
+
+/**
+ * \brief get the counters of a bypass table entry
+ *
+ * The per cpu values are summed. \a idle is set to the number of
+ * seconds since the kernel last saw a packet for the entry.
+ *
+ * \retval 0 if the entry was found, -1 otherwise
+ */
+int EBPFGetFlowStats(int fd, void *key, uint64_t *pkts, uint64_t *bytes,
+        uint32_t *idle)
+{
+    int ncpus = EBPFPossibleCpus();
+    struct pair *values = SCCalloc(ncpus, sizeof(struct pair));
+    if (unlikely(values == NULL))
+        return -1;
+
+    if (bpf_map_lookup_elem(fd, key, values) != 0) {
+        SCFree(values);
+        return -1;
+    }
+
+    uint64_t last = 0;
+    *pkts = 0;
+    *bytes = 0;
+    for (int i = 0; i < ncpus; i++) {
+        *pkts += values[i].packets;
+        *bytes += values[i].bytes;
+        if (values[i].time > last)
+            last = values[i].time;
+    }
+    SCFree(values);
+
+    uint64_t now = EBPFTimeNs();
+    *idle = (now > last) ? (uint32_t)((now - last) / 1000000000ULL) : 0;
+    return 0;
+}
+
+/** \brief remove an entry from a bypass table, if still present */
+void EBPFDeleteKey(int fd, void *key)
+{
+    if (bpf_map_delete_elem(fd, key) != 0 && errno != ENOENT) {
+        SCLogDebug("bypass map delete failed: %s", strerror(errno));
+    }
+}
+
+/**
+ * \brief remove the stale entries of a bypass table
+ *
+ * The successor of a key is looked up before the key is deleted, so
+ * the walk is not restarted by the deletion.
+ */
+static uint32_t EBPFTimeoutTable(int fd, size_t keylen, uint64_t now,
+        uint64_t timeout, struct pair *values, int ncpus)
+{
+    union {
+        struct flowv4_keys v4;
+        struct flowv6_keys v6;
+    } key, next_key;
+    uint32_t cnt = 0;
+
+    BUG_ON(keylen > sizeof(key));
+
+    int have_key = (bpf_map_get_next_key(fd, NULL, &key) == 0);
+    while (have_key) {
+        int have_next = (bpf_map_get_next_key(fd, &key, &next_key) == 0);
+
+        if (bpf_map_lookup_elem(fd, &key, values) == 0) {
+            uint64_t last = 0;
+            for (int i = 0; i < ncpus; i++) {
+                if (values[i].time > last)
+                    last = values[i].time;
+            }
+            if (now > last && now - last > timeout) {
+                if (bpf_map_delete_elem(fd, &key) == 0)
+                    cnt++;
+            }
+        }
+
+        memcpy(&key, &next_key, keylen);
+        have_key = have_next;
+    }
+    return cnt;
+}
+
+/**
+ * \brief expire the bypass table entries of flows not seen for \a timeout
+ *        seconds
+ *
+ * \param curtime current time of the monotonic clock, the clock used by
+ *        the kernel to timestamp the entries
+ *
+ * \retval number of entries removed
+ */
+uint32_t EBPFTimeoutFlowTables(const struct timespec *curtime,
+        uint32_t timeout)
+{
+    uint32_t cnt = 0;
+    int ncpus = EBPFPossibleCpus();
+    uint64_t now = (uint64_t)curtime->tv_sec * 1000000000ULL + curtime->tv_nsec;
+    uint64_t timeout_ns = (uint64_t)timeout * 1000000000ULL;
+
+    struct pair *values = SCCalloc(ncpus, sizeof(struct pair));
+    if (unlikely(values == NULL))
+        return 0;
+
+    SCMutexLock(&ebpf_lock);
+    for (EBPFMap *m = ebpf_maps; m != NULL; m = m->next) {
+        if (strcmp(m->name, EBPF_FLOW_TABLE_V4) == 0) {
+            cnt += EBPFTimeoutTable(m->fd, sizeof(struct flowv4_keys),
+                    now, timeout_ns, values, ncpus);
+        } else if (strcmp(m->name, EBPF_FLOW_TABLE_V6) == 0) {
+            cnt += EBPFTimeoutTable(m->fd, sizeof(struct flowv6_keys),
+                    now, timeout_ns, values, ncpus);
+        }
+    }
+    SCMutexUnlock(&ebpf_lock);
+
+    SCFree(values);
+    return cnt;
+}
+
+/** \brief detach XDP programs and free the loaded objects and maps */
+void EBPFShutdown(void)
+{
+    EBPFRemoveXDP();
+
+    SCMutexLock(&ebpf_lock);
+    EBPFMap *m = ebpf_maps;
+    while (m != NULL) {
+        EBPFMap *next = m->next;
+        SCFree(m);
+        m = next;
+    }
+    ebpf_maps = NULL;
+
+    EBPFObject *o = ebpf_objects;
+    while (o != NULL) {
+        EBPFObject *next = o->next;
+        bpf_object__close(o->obj);
+        SCFree(o);
+        o = next;
+    }
+    ebpf_objects = NULL;
+    SCMutexUnlock(&ebpf_lock);
+}
+
+#endif /* HAVE_PACKET_EBPF */
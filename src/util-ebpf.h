@@ -0,0 +1,91 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * eBPF program loading and flow bypass tables.
+ */
+
+#ifndef __UTIL_EBPF_H__
+#define __UTIL_EBPF_H__
+
+#ifdef HAVE_PACKET_EBPF
+
+#define EBPF_SOCKET_FILTER  (1<<0)
+#define EBPF_XDP_CODE       (1<<1)
+
+#define EBPF_XDP_MODE_DRIVER    0
+#define EBPF_XDP_MODE_SOFT      1
+#define EBPF_XDP_MODE_HW        2
+
+/** names of the bypass maps in the eBPF programs */
+#define EBPF_FLOW_TABLE_V4  "flow_table_v4"
+#define EBPF_FLOW_TABLE_V6  "flow_table_v6"
+
+/** key of the IPv4 bypass table. Addresses and ports are stored in
+ *  network byte order, as they are found in the packet. Must match
+ *  the definition in the ebpf/ programs. */
+struct flowv4_keys {
+    uint32_t src;
+    uint32_t dst;
+    union {
+        uint32_t ports;
+        uint16_t port16[2];
+    };
+    uint32_t ip_proto;
+} __attribute__((__aligned__(8)));
+
+/** key of the IPv6 bypass table */
+struct flowv6_keys {
+    uint32_t src[4];
+    uint32_t dst[4];
+    union {
+        uint32_t ports;
+        uint16_t port16[2];
+    };
+    uint32_t ip_proto;
+} __attribute__((__aligned__(8)));
+
+/** value of the bypass tables. The tables are per cpu, the kernel
+ *  updates the entry of the cpu that saw the packet. \a time is in
+ *  nanoseconds of the monotonic clock. */
+struct pair {
+    uint64_t time;
+    uint64_t packets;
+    uint64_t bytes;
+} __attribute__((__aligned__(8)));
+
+int EBPFLoadFile(const char *iface, const char *path, const char *section,
+        int *val, uint8_t flags);
+int EBPFSetupXDP(const char *iface, int fd, uint8_t mode);
+void EBPFRemoveXDP(void);
+
+int EBPFGetMapFDByName(const char *iface, const char *name);
+int EBPFBypassFlowV4(int fd, struct flowv4_keys *keys, int cnt);
+int EBPFBypassFlowV6(int fd, struct flowv6_keys *keys, int cnt);
+int EBPFGetFlowStats(int fd, void *key, uint64_t *pkts, uint64_t *bytes,
+        uint32_t *idle);
+void EBPFDeleteKey(int fd, void *key);
+
+uint32_t EBPFTimeoutFlowTables(const struct timespec *curtime,
+        uint32_t timeout);
+void EBPFShutdown(void);
+
+#endif /* HAVE_PACKET_EBPF */
+
+#endif /* __UTIL_EBPF_H__ */
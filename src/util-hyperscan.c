@@ -26,8 +26,26 @@
 #include "suricata-common.h"
 #include "suricata.h"
 
+#include "threads.h"
+#include "util-debug.h"
+#include "util-hash.h"
+#include "util-hash-lookup3.h"
+#include "util-mpm-cache.h"
+#include "util-hyperscan.h"
+
 #ifdef BUILD_HYPERSCAN
 
+/* Initial size of the global database hash. */
+#define INIT_DB_HASH_SIZE 1000
+
+/* Global hash table of Hyperscan databases, by key. Access is serialised via
+ * g_db_table_mutex. The keys only describe what is compiled, not the pattern
+ * ids and sids of the users, so that the databases are shared between the
+ * detection engines of a rule reload for the rule groups that didn't
+ * change. */
+static HashTable *g_db_table = NULL;
+static SCMutex g_db_table_mutex = SCMUTEX_INITIALIZER;
+
 /**
  * \internal
  * \brief Convert a pattern into a regex string accepted by the Hyperscan
@@ -56,4 +74,246 @@ char *HSRenderPattern(const uint8_t *pat, uint16_t pat_len)
     return str;
 }
 
+static uint32_t HSDatabaseHash(HashTable *ht, void *data, uint16_t len)
+{
+    const HSDatabase *db = data;
+    uint32_t hash = hashlittle_safe(db->key, db->key_len, 0);
+    return hash % ht->array_size;
+}
+
+static char HSDatabaseCompare(void *data1, uint16_t len1, void *data2,
+                              uint16_t len2)
+{
+    const HSDatabase *db1 = data1;
+    const HSDatabase *db2 = data2;
+
+    return db1->key_len == db2->key_len &&
+           memcmp(db1->key, db2->key, db1->key_len) == 0;
+}
+
+static void HSDatabaseFree(HSDatabase *db)
+{
+    BUG_ON(db->ref_cnt != 0);
+
+    if (db->hs_db != NULL) {
+        hs_free_database(db->hs_db);
+    }
+    SCFree(db->key);
+    SCFree(db);
+}
+
+static void HSDatabaseTableFree(void *data)
+{
+    /* Stub function handed to hash table; the databases are freed when
+     * their ref_cnt drops to zero. */
+}
+
+/* On disk database cache, see util-mpm-cache.c. The kind includes the
+ * Hyperscan version, databases are only loaded by the version that
+ * serialised them. */
+
+static void HSCacheKind(char *kind, size_t size)
+{
+    snprintf(kind, size, "hyperscan %s", hs_version());
+}
+
+static int HSCacheDeserialize(const uint8_t *buf, size_t len, void *data)
+{
+    hs_database_t **hs_db = data;
+    if (hs_deserialize_database((const char *)buf, len, hs_db) != HS_SUCCESS) {
+        *hs_db = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * \brief Get the path of the cache file of a key.
+ *
+ * \retval 0 path is set
+ * \retval -1 error
+ */
+int HSCachePath(const char *dir, const uint8_t *key, uint32_t key_len,
+                char *path, size_t size)
+{
+    char kind[128];
+    HSCacheKind(kind, sizeof(kind));
+    return MpmCachePath(dir, kind, key, key_len, path, size);
+}
+
+/**
+ * \brief Load the database of a key from the cache.
+ *
+ * \retval 0 hs_db is set up from the cache
+ * \retval -1 not in the cache (or unusable)
+ */
+int HSCacheLoad(const char *dir, const uint8_t *key, uint32_t key_len,
+                hs_database_t **hs_db)
+{
+    char kind[128];
+    HSCacheKind(kind, sizeof(kind));
+    return MpmCacheLoad(dir, kind, key, key_len, HSCacheDeserialize, hs_db);
+}
+
+/**
+ * \brief Store the compiled database of a key in the cache.
+ */
+int HSCacheSave(const char *dir, const uint8_t *key, uint32_t key_len,
+                const hs_database_t *hs_db)
+{
+    char *bytes = NULL;
+    size_t bytes_len = 0;
+    if (hs_serialize_database(hs_db, &bytes, &bytes_len) != HS_SUCCESS) {
+        return -1;
+    }
+
+    char kind[128];
+    HSCacheKind(kind, sizeof(kind));
+    int ret = MpmCacheSave(dir, kind, key, key_len, bytes, bytes_len);
+    SCFree(bytes);
+    return ret;
+}
+
+/**
+ * \internal
+ * \brief Use the database of the key from the hash, if there is one.
+ *
+ * \note g_db_table_mutex must be held
+ */
+static HSDatabase *HSDatabaseLookup(const uint8_t *key, uint32_t key_len)
+{
+    HSDatabase lookup = { .key = (uint8_t *)key, .key_len = key_len };
+    HSDatabase *db = HashTableLookup(g_db_table, &lookup, 1);
+    if (db == NULL) {
+        return NULL;
+    }
+
+    SCLogDebug("Reusing cached database %p (ref_cnt=%" PRIu32 ")",
+               db->hs_db, db->ref_cnt);
+    db->ref_cnt++;
+    return db;
+}
+
+/**
+ * \brief Get the database of a key, compiling it if needed.
+ *
+ * The database is taken from the databases in use, from the on disk
+ * cache (mpm-cache.dir) or compiled with Compile, in that order.
+ * The key has to describe everything that goes into the database, the
+ * callers start it with a string naming the kind of database.
+ *
+ * Callers can run in parallel (detect.mpm-build-threads), so the hash is
+ * only locked for the lookup and add, not for the compile itself.
+ *
+ * \param added set to 1 if the database wasn't in use yet
+ *
+ * \retval db the database, to release with HSDatabaseRelease()
+ * \retval NULL compile or alloc failure
+ */
+HSDatabase *HSDatabaseGet(const uint8_t *key, uint32_t key_len,
+                          HSDatabaseCompileFunc Compile, void *data,
+                          int *added)
+{
+    HSDatabase *db = NULL;
+
+    if (added != NULL) {
+        *added = 0;
+    }
+
+    SCMutexLock(&g_db_table_mutex);
+    if (g_db_table == NULL) {
+        g_db_table = HashTableInit(INIT_DB_HASH_SIZE, HSDatabaseHash,
+                                   HSDatabaseCompare, HSDatabaseTableFree);
+        if (g_db_table == NULL) {
+            SCMutexUnlock(&g_db_table_mutex);
+            return NULL;
+        }
+    }
+    db = HSDatabaseLookup(key, key_len);
+    SCMutexUnlock(&g_db_table_mutex);
+    if (db != NULL) {
+        return db;
+    }
+
+    db = SCCalloc(1, sizeof(HSDatabase));
+    if (db == NULL) {
+        return NULL;
+    }
+    db->key = SCMalloc(key_len);
+    if (db->key == NULL) {
+        SCFree(db);
+        return NULL;
+    }
+    memcpy(db->key, key, key_len);
+    db->key_len = key_len;
+
+    /* not in memory, see if it is in the on disk cache before compiling */
+    const char *cache_dir = MpmCacheDir();
+    if (cache_dir == NULL ||
+        HSCacheLoad(cache_dir, key, key_len, &db->hs_db) != 0) {
+        if (Compile(data, &db->hs_db) != 0) {
+            HSDatabaseFree(db);
+            return NULL;
+        }
+        if (cache_dir != NULL) {
+            (void)HSCacheSave(cache_dir, key, key_len, db->hs_db);
+        }
+    }
+
+    SCMutexLock(&g_db_table_mutex);
+    /* another user may have compiled the same database meanwhile */
+    HSDatabase *db_cached = HSDatabaseLookup(key, key_len);
+    if (db_cached != NULL) {
+        SCMutexUnlock(&g_db_table_mutex);
+        HSDatabaseFree(db);
+        return db_cached;
+    }
+    if (HashTableAdd(g_db_table, db, 1) != 0) {
+        SCMutexUnlock(&g_db_table_mutex);
+        HSDatabaseFree(db);
+        return NULL;
+    }
+    db->ref_cnt = 1;
+    SCMutexUnlock(&g_db_table_mutex);
+
+    if (added != NULL) {
+        *added = 1;
+    }
+    return db;
+}
+
+/**
+ * \brief Release a database of HSDatabaseGet(), freeing it if it was the
+ *        last user.
+ */
+void HSDatabaseRelease(HSDatabase *db)
+{
+    if (db == NULL) {
+        return;
+    }
+
+    SCMutexLock(&g_db_table_mutex);
+    BUG_ON(db->ref_cnt == 0);
+    db->ref_cnt--;
+    if (db->ref_cnt == 0) {
+        HashTableRemove(g_db_table, db, 1);
+        HSDatabaseFree(db);
+    }
+    SCMutexUnlock(&g_db_table_mutex);
+}
+
+/**
+ * \brief Clean up the global database hash.
+ */
+void HSDatabaseGlobalCleanup(void)
+{
+    SCMutexLock(&g_db_table_mutex);
+    if (g_db_table != NULL) {
+        SCLogPerf("Clearing Hyperscan database cache");
+        HashTableFree(g_db_table);
+        g_db_table = NULL;
+    }
+    SCMutexUnlock(&g_db_table_mutex);
+}
+
 #endif /* BUILD_HYPERSCAN */
@@ -28,4 +28,41 @@
 
 char *HSRenderPattern(const uint8_t *pat, uint16_t pat_len);
 
+#ifdef BUILD_HYPERSCAN
+
+#include <hs.h>
+
+/**
+ * A compiled database, shared by all users that ask for the same key,
+ * also between the detection engines of a rule reload.
+ */
+typedef struct HSDatabase_ {
+    /* what the database was compiled from, see HSDatabaseGet() */
+    uint8_t *key;
+    uint32_t key_len;
+
+    hs_database_t *hs_db;
+
+    /* number of users of the database */
+    uint32_t ref_cnt;
+} HSDatabase;
+
+/** compile the database of the key, the data is passed to HSDatabaseGet() */
+typedef int (*HSDatabaseCompileFunc)(void *data, hs_database_t **hs_db);
+
+HSDatabase *HSDatabaseGet(const uint8_t *key, uint32_t key_len,
+                          HSDatabaseCompileFunc Compile, void *data,
+                          int *added);
+void HSDatabaseRelease(HSDatabase *db);
+void HSDatabaseGlobalCleanup(void);
+
+int HSCacheLoad(const char *dir, const uint8_t *key, uint32_t key_len,
+                hs_database_t **hs_db);
+int HSCacheSave(const char *dir, const uint8_t *key, uint32_t key_len,
+                const hs_database_t *hs_db);
+int HSCachePath(const char *dir, const uint8_t *key, uint32_t key_len,
+                char *path, size_t size);
+
+#endif /* BUILD_HYPERSCAN */
+
 #endif /* __UTIL_HYPERSCAN__H__ */
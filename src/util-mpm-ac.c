@@ -53,12 +53,16 @@
 #include "detect-engine.h"
 
 #include "conf.h"
+#include "util-conf.h"
 #include "util-debug.h"
 #include "util-unittest.h"
 #include "util-unittest-helper.h"
 #include "util-memcmp.h"
 #include "util-mpm-ac.h"
 #include "util-memcpy.h"
+#include "util-hash.h"
+#include "util-hash-lookup3.h"
+#include "util-mpm-cache.h"
 
 #ifdef __SC_CUDA_SUPPORT__
 
@@ -79,7 +83,10 @@ int SCACAddPatternCS(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
                      uint32_t, SigIntId, uint8_t);
 int SCACPreparePatterns(MpmCtx *mpm_ctx);
 uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
-                    PatternMatcherQueue *pmq, const uint8_t *buf, uint16_t buflen);
+                    PatternMatcherQueue *pmq, const uint8_t *buf, uint32_t buflen);
+uint32_t SCACSearchStream(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                          PatternMatcherQueue *pmq, MpmStreamState *st,
+                          const uint8_t *buf, uint32_t buflen);
 void SCACPrintInfo(MpmCtx *mpm_ctx);
 void SCACPrintSearchStats(MpmThreadCtx *mpm_thread_ctx);
 void SCACRegisterTests(void);
@@ -95,6 +102,13 @@ void SCACRegisterTests(void);
 
 static int construct_both_16_and_32_state_tables = 0;
 
+/* Global hash table of the state tables in use, keyed on the patterns they
+ * were built from. Access is serialised via g_state_table_mutex. */
+static HashTable *g_state_table = NULL;
+static SCMutex g_state_table_mutex = SCMUTEX_INITIALIZER;
+
+#define INIT_STATE_TABLE_HASH_SIZE 1000
+
 /**
  * \brief Helper structure used by AC during state table creation
  */
@@ -270,7 +284,7 @@ static void SCACSetOutputState(int32_t state, uint32_t pid, MpmCtx *mpm_ctx)
  *
  * \param pattern     Pointer to the pattern.
  * \param pattern_len Pattern length.
- * \param pid         The pattern id, that corresponds to this pattern.  We
+ * \param pid         The pattern index, that corresponds to this pattern.  We
  *                    need it to updated the output table for this pattern.
  * \param mpm_ctx     Pointer to the mpm context.
  */
@@ -321,8 +335,7 @@ static inline void SCACCreateGotoTable(MpmCtx *mpm_ctx)
 
     /* add each pattern to create the goto table */
     for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
-        SCACEnter(ctx->parray[i]->ci, ctx->parray[i]->len,
-                  ctx->parray[i]->id, mpm_ctx);
+        SCACEnter(ctx->parray[i]->ci, ctx->parray[i]->len, i, mpm_ctx);
     }
 
     int ascii_code = 0;
@@ -749,6 +762,450 @@ static void SCACPrepareStateTable(MpmCtx *mpm_ctx)
     return;
 }
 
+/* The state and output tables only depend on the lowercased patterns and
+ * whether they are nocase, not on the case sensitive pattern, the pattern
+ * id or the sids. With the patterns sorted on these and the pattern index
+ * used in the output table instead of the pattern id, contexts with the same
+ * patterns build the same tables and can share them. */
+static int SCACPatternCompare(const void *a, const void *b)
+{
+    const MpmPattern *p1 = *(const MpmPattern **)a;
+    const MpmPattern *p2 = *(const MpmPattern **)b;
+
+    if (p1->len != p2->len)
+        return p1->len < p2->len ? -1 : 1;
+    const uint8_t nc1 = (p1->flags & MPM_PATTERN_FLAG_NOCASE) ? 1 : 0;
+    const uint8_t nc2 = (p2->flags & MPM_PATTERN_FLAG_NOCASE) ? 1 : 0;
+    if (nc1 != nc2)
+        return nc1 < nc2 ? -1 : 1;
+    return memcmp(p1->ci, p2->ci, p1->len);
+}
+
+/**
+ * \internal
+ * \brief Build the key of the state table for the (sorted) patterns.
+ *
+ * \retval key buffer, to be freed by the caller, NULL on alloc failure
+ */
+static uint8_t *SCACStateTableKey(MpmPattern **parray, uint32_t pattern_cnt,
+                                  uint32_t *key_len)
+{
+    uint32_t len = sizeof(uint32_t);
+    uint32_t i;
+    for (i = 0; i < pattern_cnt; i++) {
+        len += sizeof(uint16_t) + sizeof(uint8_t) + parray[i]->len;
+    }
+
+    uint8_t *key = SCMalloc(len);
+    if (key == NULL)
+        return NULL;
+
+    uint8_t *ptr = key;
+    memcpy(ptr, &pattern_cnt, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    for (i = 0; i < pattern_cnt; i++) {
+        const uint8_t nocase = (parray[i]->flags & MPM_PATTERN_FLAG_NOCASE) ? 1 : 0;
+        memcpy(ptr, &parray[i]->len, sizeof(uint16_t));
+        ptr += sizeof(uint16_t);
+        *ptr++ = nocase;
+        memcpy(ptr, parray[i]->ci, parray[i]->len);
+        ptr += parray[i]->len;
+    }
+
+    *key_len = len;
+    return key;
+}
+
+static uint32_t SCACStateTableHash(HashTable *ht, void *data, uint16_t len)
+{
+    const SCACStateTable *st = data;
+    uint32_t hash = hashlittle_safe(st->key, st->key_len, 0);
+    return hash % ht->array_size;
+}
+
+static char SCACStateTableCompare(void *data1, uint16_t len1, void *data2,
+                                  uint16_t len2)
+{
+    const SCACStateTable *st1 = data1;
+    const SCACStateTable *st2 = data2;
+
+    return st1->key_len == st2->key_len &&
+           memcmp(st1->key, st2->key, st1->key_len) == 0;
+}
+
+static void SCACStateTableFree(SCACStateTable *st)
+{
+    BUG_ON(st->ref_cnt != 0);
+
+    if (st->state_table_u16 != NULL)
+        SCFree(st->state_table_u16);
+    if (st->state_table_u32 != NULL)
+        SCFree(st->state_table_u32);
+    if (st->output_table != NULL) {
+        uint32_t state;
+        for (state = 0; state < st->state_count; state++) {
+            if (st->output_table[state].pids != NULL)
+                SCFree(st->output_table[state].pids);
+        }
+        SCFree(st->output_table);
+    }
+    SCFree(st->key);
+    SCFree(st);
+}
+
+static void SCACStateTableTableFree(void *data)
+{
+    /* Stub function handed to hash table; the tables are freed when
+     * their ref_cnt drops to zero. */
+}
+
+/**
+ * \internal
+ * \brief Use the tables of the key from the hash, if there are.
+ *
+ * \note g_state_table_mutex must be held
+ */
+static SCACStateTable *SCACStateTableLookup(uint8_t *key, uint32_t key_len)
+{
+    SCACStateTable lookup = { .key = key, .key_len = key_len };
+    SCACStateTable *st = HashTableLookup(g_state_table, &lookup, 1);
+    if (st == NULL)
+        return NULL;
+
+    SCLogDebug("reusing state table %p (ref_cnt=%"PRIu32")", st, st->ref_cnt);
+    st->ref_cnt++;
+    return st;
+}
+
+static void SCACStateTableUse(SCACCtx *ctx, SCACStateTable *st)
+{
+    ctx->shared = st;
+    ctx->state_count = st->state_count;
+    ctx->state_table_u16 = st->state_table_u16;
+    ctx->state_table_u32 = st->state_table_u32;
+    ctx->output_table = st->output_table;
+}
+
+/**
+ * \internal
+ * \brief Get the shared tables of the key, if a context with the same
+ *        patterns has them.
+ *
+ * Contexts are prepared in parallel (detect.mpm-build-threads), so the hash
+ * is only locked for the lookup and the add in SCACStateTableAdd(), not
+ * while building the tables.
+ *
+ * \retval 1 ctx uses the shared tables
+ * \retval 0 not in use yet, or alloc failure
+ */
+static int SCACStateTableGet(SCACCtx *ctx, uint8_t *key, uint32_t key_len)
+{
+    SCMutexLock(&g_state_table_mutex);
+    if (g_state_table == NULL) {
+        g_state_table = HashTableInit(INIT_STATE_TABLE_HASH_SIZE,
+                                      SCACStateTableHash,
+                                      SCACStateTableCompare,
+                                      SCACStateTableTableFree);
+        if (g_state_table == NULL) {
+            SCMutexUnlock(&g_state_table_mutex);
+            return 0;
+        }
+    }
+    SCACStateTable *st = SCACStateTableLookup(key, key_len);
+    SCMutexUnlock(&g_state_table_mutex);
+
+    if (st == NULL)
+        return 0;
+    SCACStateTableUse(ctx, st);
+    return 1;
+}
+
+/**
+ * \internal
+ * \brief Hand the tables the context built over to a shared table.
+ *
+ * If a context with the same patterns was prepared meanwhile, its tables are
+ * used and the ones of ctx are freed. On alloc failure ctx keeps its own.
+ *
+ * \param key key of the patterns, freed here if it isn't used
+ *
+ * \retval 1 tables added, 0 existing tables used, -1 not shared
+ */
+static int SCACStateTableAdd(SCACCtx *ctx, uint8_t *key, uint32_t key_len)
+{
+    SCACStateTable *st = SCCalloc(1, sizeof(SCACStateTable));
+    if (st == NULL) {
+        SCFree(key);
+        return -1;
+    }
+    st->key = key;
+    st->key_len = key_len;
+    st->state_count = ctx->state_count;
+    st->state_table_u16 = ctx->state_table_u16;
+    st->state_table_u32 = ctx->state_table_u32;
+    st->output_table = ctx->output_table;
+
+    SCMutexLock(&g_state_table_mutex);
+    SCACStateTable *st_cached = SCACStateTableLookup(key, key_len);
+    if (st_cached != NULL) {
+        SCMutexUnlock(&g_state_table_mutex);
+        SCACStateTableFree(st);
+        SCACStateTableUse(ctx, st_cached);
+        return 0;
+    }
+    if (HashTableAdd(g_state_table, st, 1) != 0) {
+        SCMutexUnlock(&g_state_table_mutex);
+        SCFree(key);
+        SCFree(st);
+        return -1;
+    }
+    st->ref_cnt = 1;
+    SCMutexUnlock(&g_state_table_mutex);
+
+    ctx->shared = st;
+    return 1;
+}
+
+static void SCACStateTableRelease(SCACStateTable *st)
+{
+    SCMutexLock(&g_state_table_mutex);
+    BUG_ON(st->ref_cnt == 0);
+    st->ref_cnt--;
+    if (st->ref_cnt == 0) {
+        HashTableRemove(g_state_table, st, 1);
+        SCACStateTableFree(st);
+    }
+    SCMutexUnlock(&g_state_table_mutex);
+}
+
+/**
+ * \brief Free the hash of the shared state tables.
+ */
+void MpmACGlobalCleanup(void)
+{
+    SCMutexLock(&g_state_table_mutex);
+    if (g_state_table != NULL) {
+        HashTableFree(g_state_table);
+        g_state_table = NULL;
+    }
+    SCMutexUnlock(&g_state_table_mutex);
+}
+
+/* On disk cache of the state and output tables, see util-mpm-cache.c.
+ *
+ * The tables are cached under the key they are shared with: the patterns
+ * of the context. A cache file holds a SCACCacheHeader, the state tables
+ * that were built, the number of output table entries of each state and
+ * then the entries of all states. The magic catches a file written on a
+ * host of the other endianness. The file is checked before use, no state
+ * or pattern index it holds can be out of range. */
+
+#define SC_AC_CACHE_KIND    "ac 1"
+#define SC_AC_CACHE_MAGIC   0x53414331
+#define SC_AC_CACHE_U16     0x01
+#define SC_AC_CACHE_U32     0x02
+
+typedef struct SCACCacheHeader_ {
+    uint32_t magic;
+    uint32_t state_count;
+    /* SC_AC_CACHE_U16 and/or SC_AC_CACHE_U32 */
+    uint32_t flags;
+    /* total number of output table entries */
+    uint32_t pid_cnt;
+} SCACCacheHeader;
+
+/** \internal
+ *  \brief the state tables SCACCreateDeltaTable() builds for state_count */
+static uint32_t SCACCacheFlags(uint32_t state_count)
+{
+    uint32_t flags = 0;
+    if ((state_count < 32767) || construct_both_16_and_32_state_tables)
+        flags |= SC_AC_CACHE_U16;
+    if (!(state_count < 32767) || construct_both_16_and_32_state_tables)
+        flags |= SC_AC_CACHE_U32;
+    return flags;
+}
+
+/**
+ * \internal
+ * \brief Set up the tables of the context from a cache file.
+ *
+ * \retval 0 tables set up
+ * \retval -1 file is unusable or alloc failure, the context is unchanged
+ */
+static int SCACCacheLoad(const uint8_t *buf, size_t len, void *data)
+{
+    MpmCtx *mpm_ctx = data;
+    SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
+    SC_AC_STATE_TYPE_U16 (*state_table_u16)[256] = NULL;
+    SC_AC_STATE_TYPE_U32 (*state_table_u32)[256] = NULL;
+    SCACOutputTable *output_table = NULL;
+    SCACCacheHeader hdr;
+    uint32_t state, i;
+
+    if (len < sizeof(hdr))
+        return -1;
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.magic != SC_AC_CACHE_MAGIC || hdr.state_count == 0 ||
+        hdr.state_count > 0x00FFFFFF ||
+        hdr.flags != SCACCacheFlags(hdr.state_count))
+        return -1;
+
+    const uint64_t u16_size = (hdr.flags & SC_AC_CACHE_U16) ?
+        (uint64_t)hdr.state_count * sizeof(SC_AC_STATE_TYPE_U16) * 256 : 0;
+    const uint64_t u32_size = (hdr.flags & SC_AC_CACHE_U32) ?
+        (uint64_t)hdr.state_count * sizeof(SC_AC_STATE_TYPE_U32) * 256 : 0;
+    if ((uint64_t)len != sizeof(hdr) + u16_size + u32_size +
+            (uint64_t)hdr.state_count * sizeof(uint32_t) +
+            (uint64_t)hdr.pid_cnt * sizeof(uint32_t))
+        return -1;
+    const uint8_t *ptr = buf + sizeof(hdr);
+
+    if (u16_size != 0) {
+        state_table_u16 = SCMalloc(u16_size);
+        if (state_table_u16 == NULL)
+            goto error;
+        memcpy(state_table_u16, ptr, u16_size);
+        ptr += u16_size;
+        for (state = 0; state < hdr.state_count; state++) {
+            for (i = 0; i < 256; i++) {
+                if ((state_table_u16[state][i] & 0x7FFF) >= hdr.state_count)
+                    goto error;
+            }
+        }
+    }
+    if (u32_size != 0) {
+        state_table_u32 = SCMalloc(u32_size);
+        if (state_table_u32 == NULL)
+            goto error;
+        memcpy(state_table_u32, ptr, u32_size);
+        ptr += u32_size;
+        for (state = 0; state < hdr.state_count; state++) {
+            for (i = 0; i < 256; i++) {
+                if ((state_table_u32[state][i] & 0x00FFFFFF) >= hdr.state_count)
+                    goto error;
+            }
+        }
+    }
+
+    output_table = SCCalloc(hdr.state_count, sizeof(SCACOutputTable));
+    if (output_table == NULL)
+        goto error;
+    const uint8_t *pids = ptr + hdr.state_count * sizeof(uint32_t);
+    uint32_t pid_cnt = hdr.pid_cnt;
+    for (state = 0; state < hdr.state_count; state++) {
+        uint32_t no_of_entries;
+        memcpy(&no_of_entries, ptr, sizeof(uint32_t));
+        ptr += sizeof(uint32_t);
+        if (no_of_entries == 0)
+            continue;
+        if (no_of_entries > pid_cnt)
+            goto error;
+        pid_cnt -= no_of_entries;
+
+        output_table[state].pids = SCMalloc(no_of_entries * sizeof(uint32_t));
+        if (output_table[state].pids == NULL)
+            goto error;
+        output_table[state].no_of_entries = no_of_entries;
+        memcpy(output_table[state].pids, pids, no_of_entries * sizeof(uint32_t));
+        pids += no_of_entries * sizeof(uint32_t);
+        for (i = 0; i < no_of_entries; i++) {
+            if ((output_table[state].pids[i] & AC_PID_MASK) >= mpm_ctx->pattern_cnt)
+                goto error;
+        }
+    }
+    if (pid_cnt != 0)
+        goto error;
+
+    ctx->state_count = hdr.state_count;
+    ctx->state_table_u16 = state_table_u16;
+    ctx->state_table_u32 = state_table_u32;
+    ctx->output_table = output_table;
+    if (state_table_u16 != NULL) {
+        mpm_ctx->memory_cnt++;
+        mpm_ctx->memory_size += u16_size;
+    }
+    if (state_table_u32 != NULL) {
+        mpm_ctx->memory_cnt++;
+        mpm_ctx->memory_size += u32_size;
+    }
+    return 0;
+
+error:
+    if (state_table_u16 != NULL)
+        SCFree(state_table_u16);
+    if (state_table_u32 != NULL)
+        SCFree(state_table_u32);
+    if (output_table != NULL) {
+        for (state = 0; state < hdr.state_count; state++) {
+            if (output_table[state].pids != NULL)
+                SCFree(output_table[state].pids);
+        }
+        SCFree(output_table);
+    }
+    return -1;
+}
+
+/**
+ * \internal
+ * \brief Store the tables of the context in the cache.
+ */
+static int SCACCacheSave(const char *dir, const SCACCtx *ctx,
+                         const uint8_t *key, uint32_t key_len)
+{
+    SCACCacheHeader hdr;
+    uint32_t state;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = SC_AC_CACHE_MAGIC;
+    hdr.state_count = ctx->state_count;
+    if (ctx->state_table_u16 != NULL)
+        hdr.flags |= SC_AC_CACHE_U16;
+    if (ctx->state_table_u32 != NULL)
+        hdr.flags |= SC_AC_CACHE_U32;
+    for (state = 0; state < ctx->state_count; state++) {
+        hdr.pid_cnt += ctx->output_table[state].no_of_entries;
+    }
+
+    const size_t u16_size = (hdr.flags & SC_AC_CACHE_U16) ?
+        ctx->state_count * sizeof(SC_AC_STATE_TYPE_U16) * 256 : 0;
+    const size_t u32_size = (hdr.flags & SC_AC_CACHE_U32) ?
+        ctx->state_count * sizeof(SC_AC_STATE_TYPE_U32) * 256 : 0;
+    const size_t len = sizeof(hdr) + u16_size + u32_size +
+        ctx->state_count * sizeof(uint32_t) + hdr.pid_cnt * sizeof(uint32_t);
+    uint8_t *buf = SCMalloc(len);
+    if (buf == NULL)
+        return -1;
+
+    uint8_t *ptr = buf;
+    memcpy(ptr, &hdr, sizeof(hdr));
+    ptr += sizeof(hdr);
+    if (u16_size != 0) {
+        memcpy(ptr, ctx->state_table_u16, u16_size);
+        ptr += u16_size;
+    }
+    if (u32_size != 0) {
+        memcpy(ptr, ctx->state_table_u32, u32_size);
+        ptr += u32_size;
+    }
+    for (state = 0; state < ctx->state_count; state++) {
+        memcpy(ptr, &ctx->output_table[state].no_of_entries, sizeof(uint32_t));
+        ptr += sizeof(uint32_t);
+    }
+    for (state = 0; state < ctx->state_count; state++) {
+        const SCACOutputTable *output_state = &ctx->output_table[state];
+        if (output_state->no_of_entries == 0)
+            continue;
+        memcpy(ptr, output_state->pids,
+               output_state->no_of_entries * sizeof(uint32_t));
+        ptr += output_state->no_of_entries * sizeof(uint32_t);
+    }
+
+    int ret = MpmCacheSave(dir, SC_AC_CACHE_KIND, key, key_len, buf, len);
+    SCFree(buf);
+    return ret;
+}
+
 /**
  * \brief Process the patterns added to the mpm, and create the internal tables.
  *
@@ -788,40 +1245,74 @@ int SCACPreparePatterns(MpmCtx *mpm_ctx)
     SCFree(mpm_ctx->init_hash);
     mpm_ctx->init_hash = NULL;
 
+    /* the pattern index is what goes into the output table, sort so that
+     * the same patterns give the same tables */
+    qsort(ctx->parray, mpm_ctx->pattern_cnt, sizeof(MpmPattern *),
+          SCACPatternCompare);
+
     /* the memory consumed by a single state in our goto table */
     ctx->single_state_size = sizeof(int32_t) * 256;
 
     /* handle no case patterns */
-    ctx->pid_pat_list = SCMalloc((mpm_ctx->max_pat_id + 1)* sizeof(SCACPatternList));
+    ctx->pid_pat_list = SCMalloc(mpm_ctx->pattern_cnt * sizeof(SCACPatternList));
     if (ctx->pid_pat_list == NULL) {
         SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
         exit(EXIT_FAILURE);
     }
-    memset(ctx->pid_pat_list, 0, (mpm_ctx->max_pat_id + 1) * sizeof(SCACPatternList));
+    memset(ctx->pid_pat_list, 0, mpm_ctx->pattern_cnt * sizeof(SCACPatternList));
 
     for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
         if (!(ctx->parray[i]->flags & MPM_PATTERN_FLAG_NOCASE)) {
-            ctx->pid_pat_list[ctx->parray[i]->id].cs = SCMalloc(ctx->parray[i]->len);
-            if (ctx->pid_pat_list[ctx->parray[i]->id].cs == NULL) {
+            ctx->pid_pat_list[i].cs = SCMalloc(ctx->parray[i]->len);
+            if (ctx->pid_pat_list[i].cs == NULL) {
                 SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
                 exit(EXIT_FAILURE);
             }
-            memcpy(ctx->pid_pat_list[ctx->parray[i]->id].cs,
+            memcpy(ctx->pid_pat_list[i].cs,
                    ctx->parray[i]->original_pat, ctx->parray[i]->len);
-            ctx->pid_pat_list[ctx->parray[i]->id].patlen = ctx->parray[i]->len;
+            ctx->pid_pat_list[i].patlen = ctx->parray[i]->len;
         }
 
         /* ACPatternList now owns this memory */
-        //SCLogInfo("ctx->parray[i]->sids_size %u", ctx->parray[i]->sids_size);
-        ctx->pid_pat_list[ctx->parray[i]->id].sids_size = ctx->parray[i]->sids_size;
-        ctx->pid_pat_list[ctx->parray[i]->id].sids = ctx->parray[i]->sids;
+        ctx->pid_pat_list[i].sids_size = ctx->parray[i]->sids_size;
+        ctx->pid_pat_list[i].sids = ctx->parray[i]->sids;
 
         ctx->parray[i]->sids_size = 0;
         ctx->parray[i]->sids = NULL;
     }
 
-    /* prepare the state table required by AC */
-    SCACPrepareStateTable(mpm_ctx);
+    /* the cuda matcher copies the state table of each context to the
+     * device, it doesn't share them */
+    int share = 1;
+#ifdef __SC_CUDA_SUPPORT__
+    if (mpm_ctx->mpm_type == MPM_AC_CUDA)
+        share = 0;
+#endif
+    uint32_t key_len = 0;
+    uint8_t *key = NULL;
+    if (share) {
+        key = SCACStateTableKey(ctx->parray, mpm_ctx->pattern_cnt, &key_len);
+    }
+
+    if (key != NULL && SCACStateTableGet(ctx, key, key_len) == 1) {
+        SCFree(key);
+    } else {
+        /* not in memory, see if it is in the on disk cache before
+         * building it */
+        const char *cache_dir = (key != NULL) ? MpmCacheDir() : NULL;
+        if (cache_dir == NULL ||
+            MpmCacheLoad(cache_dir, SC_AC_CACHE_KIND, key, key_len,
+                         SCACCacheLoad, mpm_ctx) != 0) {
+            /* prepare the state table required by AC */
+            SCACPrepareStateTable(mpm_ctx);
+
+            if (cache_dir != NULL)
+                (void)SCACCacheSave(cache_dir, ctx, key, key_len);
+        }
+
+        if (key != NULL)
+            (void)SCACStateTableAdd(ctx, key, key_len);
+    }
 
 #ifdef __SC_CUDA_SUPPORT__
     if (mpm_ctx->mpm_type == MPM_AC_CUDA) {
@@ -853,7 +1344,7 @@ int SCACPreparePatterns(MpmCtx *mpm_ctx)
     mpm_ctx->memory_cnt--;
     mpm_ctx->memory_size -= (mpm_ctx->pattern_cnt * sizeof(MpmPattern *));
 
-    ctx->pattern_id_bitarray_size = (mpm_ctx->max_pat_id / 8) + 1;
+    ctx->pattern_id_bitarray_size = (mpm_ctx->pattern_cnt / 8) + 1;
     SCLogDebug("ctx->pattern_id_bitarray_size %u", ctx->pattern_id_bitarray_size);
 
     return 0;
@@ -969,6 +1460,14 @@ void SCACDestroyCtx(MpmCtx *mpm_ctx)
         mpm_ctx->memory_size -= (mpm_ctx->pattern_cnt * sizeof(MpmPattern *));
     }
 
+    if (ctx->shared != NULL) {
+        SCACStateTableRelease(ctx->shared);
+        ctx->shared = NULL;
+        ctx->state_table_u16 = NULL;
+        ctx->state_table_u32 = NULL;
+        ctx->output_table = NULL;
+    }
+
     if (ctx->state_table_u16 != NULL) {
         SCFree(ctx->state_table_u16);
         ctx->state_table_u16 = NULL;
@@ -998,7 +1497,7 @@ void SCACDestroyCtx(MpmCtx *mpm_ctx)
 
     if (ctx->pid_pat_list != NULL) {
         uint32_t i;
-        for (i = 0; i < (mpm_ctx->max_pat_id + 1); i++) {
+        for (i = 0; i < mpm_ctx->pattern_cnt; i++) {
             if (ctx->pid_pat_list[i].cs != NULL)
                 SCFree(ctx->pid_pat_list[i].cs);
             if (ctx->pid_pat_list[i].sids != NULL)
@@ -1015,34 +1514,63 @@ void SCACDestroyCtx(MpmCtx *mpm_ctx)
 }
 
 /**
- * \brief The aho corasick search function.
+ * \internal
+ * \brief Compare a case sensitive pattern ending at buf[i] that started
+ *        in the data scanned before buf.
  *
- * \param mpm_ctx        Pointer to the mpm context.
- * \param mpm_thread_ctx Pointer to the mpm thread context.
- * \param pmq            Pointer to the Pattern Matcher Queue to hold
- *                       search matches.
- * \param buf            Buffer to be searched.
- * \param buflen         Buffer length.
+ * \retval 1 case matches, 0 no match or prev too short to tell
+ */
+static inline int SCACCheckCaseSpanning(const SCACPatternList *pat,
+                                        const uint8_t *prev, uint32_t prev_len,
+                                        const uint8_t *buf, uint32_t i)
+{
+    const uint32_t in_buf = i + 1;
+    const uint32_t in_prev = pat->patlen - in_buf;
+
+    if (prev == NULL || in_prev > prev_len)
+        return 0;
+    if (SCMemcmp(pat->cs, prev + prev_len - in_prev, in_prev) != 0)
+        return 0;
+    return SCMemcmp(pat->cs + in_prev, buf, in_buf) == 0;
+}
+
+/**
+ * \internal
+ * \brief Run the aho corasick state machine over a buffer.
+ *
+ * Continues from *state and leaves the state after the last byte in it.
+ * A case sensitive pattern ending at a position i < patlen - 1 started in
+ * the data scanned by a previous call. Its start is compared against the
+ * end of that data in prev. If prev is too short the match can't be
+ * confirmed and is dropped.
+ *
+ * \param ctx    Pointer to the ac context.
+ * \param pmq    Pointer to the Pattern Matcher Queue to hold search matches.
+ * \param buf    Buffer to be searched.
+ * \param buflen Buffer length.
+ * \param state_io State to start from, updated to the state after buf.
+ * \param prev   Last bytes scanned by the previous call, or NULL.
+ * \param prev_len Length of prev.
  *
  * \retval matches Match count.
  */
-uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
-                    PatternMatcherQueue *pmq, const uint8_t *buf, uint16_t buflen)
+static inline uint32_t SCACSearchState(const SCACCtx *ctx, PatternMatcherQueue *pmq,
+                                       const uint8_t *buf, uint32_t buflen,
+                                       uint32_t *state_io,
+                                       const uint8_t *prev, uint32_t prev_len)
 {
-    const SCACCtx *ctx = (SCACCtx *)mpm_ctx->ctx;
     int i = 0;
     int matches = 0;
 
     /* \todo tried loop unrolling with register var, with no perf increase.  Need
      * to dig deeper */
-    /* \todo Change it for stateful MPM.  Supply the state using mpm_thread_ctx */
     SCACPatternList *pid_pat_list = ctx->pid_pat_list;
 
     uint8_t bitarray[ctx->pattern_id_bitarray_size];
     memset(bitarray, 0, ctx->pattern_id_bitarray_size);
 
     if (ctx->state_count < 32767) {
-        register SC_AC_STATE_TYPE_U16 state = 0;
+        register SC_AC_STATE_TYPE_U16 state = (SC_AC_STATE_TYPE_U16)*state_io;
         SC_AC_STATE_TYPE_U16 (*state_table_u16)[256] = ctx->state_table_u16;
         for (i = 0; i < buflen; i++) {
             state = state_table_u16[state & 0x7FFF][u8_tolower(buf[i])];
@@ -1053,10 +1581,15 @@ uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
                 for (k = 0; k < no_of_entries; k++) {
                     if (pids[k] & AC_CASE_MASK) {
                         uint32_t lower_pid = pids[k] & AC_PID_MASK;
-                        if (SCMemcmp(pid_pat_list[lower_pid].cs,
-                                     buf + i - pid_pat_list[lower_pid].patlen + 1,
-                                     pid_pat_list[lower_pid].patlen) != 0) {
-                            /* inside loop */
+                        if (i + 1 >= pid_pat_list[lower_pid].patlen) {
+                            if (SCMemcmp(pid_pat_list[lower_pid].cs,
+                                         buf + i - pid_pat_list[lower_pid].patlen + 1,
+                                         pid_pat_list[lower_pid].patlen) != 0) {
+                                /* inside loop */
+                                continue;
+                            }
+                        } else if (!SCACCheckCaseSpanning(&pid_pat_list[lower_pid],
+                                                          prev, prev_len, buf, i)) {
                             continue;
                         }
                         if (bitarray[(lower_pid) / 8] & (1 << ((lower_pid) % 8))) {
@@ -1080,9 +1613,10 @@ uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
                 }
             }
         } /* for (i = 0; i < buflen; i++) */
+        *state_io = state;
 
     } else {
-        register SC_AC_STATE_TYPE_U32 state = 0;
+        register SC_AC_STATE_TYPE_U32 state = *state_io;
         SC_AC_STATE_TYPE_U32 (*state_table_u32)[256] = ctx->state_table_u32;
         for (i = 0; i < buflen; i++) {
             state = state_table_u32[state & 0x00FFFFFF][u8_tolower(buf[i])];
@@ -1093,10 +1627,15 @@ uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
                 for (k = 0; k < no_of_entries; k++) {
                     if (pids[k] & AC_CASE_MASK) {
                         uint32_t lower_pid = pids[k] & 0x0000FFFF;
-                        if (SCMemcmp(pid_pat_list[lower_pid].cs,
-                                     buf + i - pid_pat_list[lower_pid].patlen + 1,
-                                     pid_pat_list[lower_pid].patlen) != 0) {
-                            /* inside loop */
+                        if (i + 1 >= pid_pat_list[lower_pid].patlen) {
+                            if (SCMemcmp(pid_pat_list[lower_pid].cs,
+                                         buf + i - pid_pat_list[lower_pid].patlen + 1,
+                                         pid_pat_list[lower_pid].patlen) != 0) {
+                                /* inside loop */
+                                continue;
+                            }
+                        } else if (!SCACCheckCaseSpanning(&pid_pat_list[lower_pid],
+                                                          prev, prev_len, buf, i)) {
                             continue;
                         }
                         if (bitarray[(lower_pid) / 8] & (1 << ((lower_pid) % 8))) {
@@ -1120,11 +1659,57 @@ uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
                 }
             }
         } /* for (i = 0; i < buflen; i++) */
+        *state_io = state;
     }
 
     return matches;
 }
 
+/**
+ * \brief The aho corasick search function.
+ *
+ * \param mpm_ctx        Pointer to the mpm context.
+ * \param mpm_thread_ctx Pointer to the mpm thread context.
+ * \param pmq            Pointer to the Pattern Matcher Queue to hold
+ *                       search matches.
+ * \param buf            Buffer to be searched.
+ * \param buflen         Buffer length.
+ *
+ * \retval matches Match count.
+ */
+uint32_t SCACSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                    PatternMatcherQueue *pmq, const uint8_t *buf, uint32_t buflen)
+{
+    uint32_t state = 0;
+    return SCACSearchState((SCACCtx *)mpm_ctx->ctx, pmq, buf, buflen, &state,
+                           NULL, 0);
+}
+
+/**
+ * \brief The aho corasick streaming search function, continuing from the
+ *        state left by the previous call.
+ *
+ * \param mpm_ctx        Pointer to the mpm context.
+ * \param mpm_thread_ctx Pointer to the mpm thread context.
+ * \param pmq            Pointer to the Pattern Matcher Queue to hold
+ *                       search matches.
+ * \param st             Stream state, the ac state is kept in st->state and
+ *                       the last bytes scanned in st->tail.
+ * \param buf            Buffer to be searched.
+ * \param buflen         Buffer length.
+ *
+ * \retval matches Match count.
+ */
+uint32_t SCACSearchStream(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                          PatternMatcherQueue *pmq, MpmStreamState *st,
+                          const uint8_t *buf, uint32_t buflen)
+{
+    uint32_t ret = SCACSearchState((SCACCtx *)mpm_ctx->ctx, pmq, buf, buflen,
+                                   &st->state, st->tail, st->tail_len);
+    MpmStreamStateKeepTail(st, mpm_ctx, buf, buflen);
+    return ret;
+}
+
 /**
  * \brief Add a case insensitive pattern.  Although we have different calls for
  *        adding case sensitive and insensitive patterns, we make a single call
@@ -1767,6 +2352,7 @@ void MpmACRegister(void)
     mpm_table[MPM_AC].AddPatternNocase = SCACAddPatternCI;
     mpm_table[MPM_AC].Prepare = SCACPreparePatterns;
     mpm_table[MPM_AC].Search = SCACSearch;
+    mpm_table[MPM_AC].SearchStream = SCACSearchStream;
     mpm_table[MPM_AC].Cleanup = NULL;
     mpm_table[MPM_AC].PrintCtx = SCACPrintInfo;
     mpm_table[MPM_AC].PrintThreadCtx = SCACPrintSearchStats;
@@ -1791,6 +2377,7 @@ void MpmACCudaRegister(void)
     mpm_table[MPM_AC_CUDA].AddPatternNocase = SCACAddPatternCI;
     mpm_table[MPM_AC_CUDA].Prepare = SCACPreparePatterns;
     mpm_table[MPM_AC_CUDA].Search = SCACSearch;
+    mpm_table[MPM_AC_CUDA].SearchStream = SCACSearchStream;
     mpm_table[MPM_AC_CUDA].Cleanup = NULL;
     mpm_table[MPM_AC_CUDA].PrintCtx = SCACPrintInfo;
     mpm_table[MPM_AC_CUDA].PrintThreadCtx = SCACPrintSearchStats;
@@ -2827,6 +3414,191 @@ end:
     return result;
 }
 
+/** \test case sensitive pattern spanning the parts of a stream */
+static int SCACTest30(void)
+{
+    MpmCtx mpm_ctx;
+    MpmThreadCtx mpm_thread_ctx;
+    PatternMatcherQueue pmq;
+    MpmStreamState st;
+
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    memset(&st, 0, sizeof(st));
+    MpmInitCtx(&mpm_ctx, MPM_AC);
+    SCACInitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+
+    MpmAddPatternCS(&mpm_ctx, (uint8_t *)"abCD", 4, 0, 0, 0, 0, 0);
+    PmqSetup(&pmq);
+
+    FAIL_IF(SCACPreparePatterns(&mpm_ctx) != 0);
+
+    /* wrong case in the second part */
+    uint32_t cnt = MpmStreamSearch(&mpm_ctx, &mpm_thread_ctx, &pmq, &st,
+                                   (uint8_t *)"xxab", 4);
+    cnt += MpmStreamSearch(&mpm_ctx, &mpm_thread_ctx, &pmq, &st,
+                           (uint8_t *)"cdxx", 4);
+    FAIL_IF(cnt != 0);
+
+    /* wrong case in the first part */
+    MpmStreamStateReset(&st);
+    cnt = MpmStreamSearch(&mpm_ctx, &mpm_thread_ctx, &pmq, &st,
+                          (uint8_t *)"xxaB", 4);
+    cnt += MpmStreamSearch(&mpm_ctx, &mpm_thread_ctx, &pmq, &st,
+                           (uint8_t *)"CDxx", 4);
+    FAIL_IF(cnt != 0);
+
+    MpmStreamStateReset(&st);
+    cnt = MpmStreamSearch(&mpm_ctx, &mpm_thread_ctx, &pmq, &st,
+                          (uint8_t *)"xxab", 4);
+    cnt += MpmStreamSearch(&mpm_ctx, &mpm_thread_ctx, &pmq, &st,
+                           (uint8_t *)"CDxx", 4);
+    FAIL_IF(cnt != 1);
+
+    /* one byte at a time */
+    MpmStreamStateReset(&st);
+    const uint8_t *data = (uint8_t *)"xabCDx";
+    uint32_t i;
+    cnt = 0;
+    for (i = 0; i < 6; i++)
+        cnt += MpmStreamSearch(&mpm_ctx, &mpm_thread_ctx, &pmq, &st,
+                               data + i, 1);
+    FAIL_IF(cnt != 1);
+
+    MpmStreamStateFree(&st);
+    SCACDestroyCtx(&mpm_ctx);
+    SCACDestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    PASS;
+}
+
+
+/** \test contexts with the same patterns share the state tables, each with
+ *        its own pattern ids, sids and case sensitive patterns */
+static int SCACTest31(void)
+{
+    MpmCtx mpm_ctx1, mpm_ctx2;
+    MpmThreadCtx mpm_thread_ctx;
+    PatternMatcherQueue pmq;
+
+    memset(&mpm_ctx1, 0, sizeof(MpmCtx));
+    memset(&mpm_ctx2, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    MpmInitCtx(&mpm_ctx1, MPM_AC);
+    MpmInitCtx(&mpm_ctx2, MPM_AC);
+    SCACInitThreadCtx(&mpm_ctx1, &mpm_thread_ctx);
+    PmqSetup(&pmq);
+
+    MpmAddPatternCS(&mpm_ctx1, (uint8_t *)"abcd", 4, 0, 0, 0, 10, 0);
+    MpmAddPatternCI(&mpm_ctx1, (uint8_t *)"efgh", 4, 0, 0, 1, 11, 0);
+    FAIL_IF(SCACPreparePatterns(&mpm_ctx1) != 0);
+
+    /* other ids and sids, added in an other order, other case */
+    MpmAddPatternCI(&mpm_ctx2, (uint8_t *)"efgh", 4, 0, 0, 7, 21, 0);
+    MpmAddPatternCS(&mpm_ctx2, (uint8_t *)"ABCD", 4, 0, 0, 5, 20, 0);
+    FAIL_IF(SCACPreparePatterns(&mpm_ctx2) != 0);
+
+    SCACCtx *ctx1 = (SCACCtx *)mpm_ctx1.ctx;
+    SCACCtx *ctx2 = (SCACCtx *)mpm_ctx2.ctx;
+    FAIL_IF_NULL(ctx1->shared);
+    FAIL_IF_NOT(ctx1->shared == ctx2->shared);
+    FAIL_IF_NOT(ctx1->shared->ref_cnt == 2);
+
+    const char *buf = "xxabcdxxEFGH";
+    uint32_t cnt = SCACSearch(&mpm_ctx1, &mpm_thread_ctx, &pmq,
+                              (uint8_t *)buf, strlen(buf));
+    FAIL_IF_NOT(cnt == 2);
+    FAIL_IF_NOT(pmq.rule_id_array_cnt == 2);
+    PmqReset(&pmq);
+
+    /* the tables stay for the other context */
+    SCACDestroyCtx(&mpm_ctx1);
+
+    cnt = SCACSearch(&mpm_ctx2, &mpm_thread_ctx, &pmq,
+                     (uint8_t *)buf, strlen(buf));
+    FAIL_IF_NOT(cnt == 1);
+    FAIL_IF_NOT(pmq.rule_id_array_cnt == 1);
+    FAIL_IF_NOT(pmq.rule_id_array[0] == 21);
+    PmqReset(&pmq);
+
+    buf = "xxABCDxx";
+    cnt = SCACSearch(&mpm_ctx2, &mpm_thread_ctx, &pmq,
+                     (uint8_t *)buf, strlen(buf));
+    FAIL_IF_NOT(cnt == 1);
+    FAIL_IF_NOT(pmq.rule_id_array_cnt == 1);
+    FAIL_IF_NOT(pmq.rule_id_array[0] == 20);
+
+    FAIL_IF_NOT(ctx2->shared->ref_cnt == 1);
+    SCACDestroyCtx(&mpm_ctx2);
+    SCACDestroyThreadCtx(&mpm_ctx1, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    PASS;
+}
+
+#ifdef HAVE_SYS_MMAN_H
+/** \test the tables are stored in and loaded from the on disk cache, a
+ *        damaged cache file is not used */
+static int SCACTest32(void)
+{
+    MpmCtx mpm_ctx;
+    MpmThreadCtx mpm_thread_ctx;
+    PatternMatcherQueue pmq;
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    struct stat st;
+    int i;
+
+    snprintf(dir, sizeof(dir), "%s/suricata-ac-cache-XXXXXX",
+             ConfigGetLogDirectory());
+    FAIL_IF_NULL(mkdtemp(dir));
+    ConfCreateContextBackup();
+    ConfInit();
+    FAIL_IF(ConfSet("mpm-cache.dir", dir) != 1);
+    MpmCacheGlobalCleanup();
+
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    PmqSetup(&pmq);
+
+    /* built and stored, loaded, built again as the file is truncated */
+    for (i = 0; i < 3; i++) {
+        memset(&mpm_ctx, 0, sizeof(MpmCtx));
+        MpmInitCtx(&mpm_ctx, MPM_AC);
+        if (i == 0)
+            SCACInitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+        MpmAddPatternCI(&mpm_ctx, (uint8_t *)"efgh", 4, 0, 0, 7 + i, 21, 0);
+        MpmAddPatternCS(&mpm_ctx, (uint8_t *)"ABCD", 4, 0, 0, 5 + i, 20, 0);
+        FAIL_IF(SCACPreparePatterns(&mpm_ctx) != 0);
+
+        SCACCtx *ctx = (SCACCtx *)mpm_ctx.ctx;
+        FAIL_IF_NULL(ctx->shared);
+        /* only building the tables allocates states */
+        FAIL_IF((ctx->allocated_state_count == 0) != (i == 1));
+        FAIL_IF(MpmCachePath(dir, SC_AC_CACHE_KIND, ctx->shared->key,
+                             ctx->shared->key_len, path, sizeof(path)) != 0);
+        FAIL_IF(stat(path, &st) != 0);
+
+        const char *buf = "xxABCDxxEFGHxxabcd";
+        uint32_t cnt = SCACSearch(&mpm_ctx, &mpm_thread_ctx, &pmq,
+                                  (uint8_t *)buf, strlen(buf));
+        FAIL_IF_NOT(cnt == 2);
+        FAIL_IF_NOT(pmq.rule_id_array_cnt == 2);
+        PmqReset(&pmq);
+
+        SCACDestroyCtx(&mpm_ctx);
+        if (i == 1)
+            FAIL_IF(truncate(path, st.st_size - 1) != 0);
+    }
+
+    FAIL_IF(unlink(path) != 0);
+    FAIL_IF(rmdir(dir) != 0);
+    ConfRestoreContextBackup();
+    MpmCacheGlobalCleanup();
+    SCACDestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    PASS;
+}
+#endif /* HAVE_SYS_MMAN_H */
+
 #endif /* UNITTESTS */
 
 void SCACRegisterTests(void)
@@ -2862,6 +3634,11 @@ void SCACRegisterTests(void)
     UtRegisterTest("SCACTest27", SCACTest27);
     UtRegisterTest("SCACTest28", SCACTest28);
     UtRegisterTest("SCACTest29", SCACTest29);
+    UtRegisterTest("SCACTest30", SCACTest30);
+    UtRegisterTest("SCACTest31", SCACTest31);
+#ifdef HAVE_SYS_MMAN_H
+    UtRegisterTest("SCACTest32", SCACTest32);
+#endif
 #endif
 
     return;
@@ -54,6 +54,23 @@ typedef struct SCACOutputTable_ {
     uint32_t no_of_entries;
 } SCACOutputTable;
 
+/* state and output tables built from a set of patterns. They are shared by
+ * all contexts with the same set, including the contexts of the detection
+ * engines of a rule reload. */
+typedef struct SCACStateTable_ {
+    /* the patterns the tables were built from: length, nocase flag and
+     * lowercased pattern of each */
+    uint8_t *key;
+    uint32_t key_len;
+
+    uint32_t ref_cnt;
+
+    uint32_t state_count;
+    SC_AC_STATE_TYPE_U16 (*state_table_u16)[256];
+    SC_AC_STATE_TYPE_U32 (*state_table_u32)[256];
+    SCACOutputTable *output_table;
+} SCACStateTable;
+
 typedef struct SCACCtx_ {
     /* pattern arrays.  We need this only during the goto table creation phase */
     MpmPattern **parray;
@@ -75,6 +92,10 @@ typedef struct SCACCtx_ {
     SCACOutputTable *output_table;
     SCACPatternList *pid_pat_list;
 
+    /* shared tables that state_table_u16/u32 and output_table point to,
+     * NULL if they belong to this context */
+    SCACStateTable *shared;
+
     /* the size of each state */
     uint32_t single_state_size;
 
@@ -94,6 +115,7 @@ typedef struct SCACThreadCtx_ {
 } SCACThreadCtx;
 
 void MpmACRegister(void);
+void MpmACGlobalCleanup(void);
 
 
 #ifdef __SC_CUDA_SUPPORT__
@@ -0,0 +1,596 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * On disk cache of the built mpm tables.
+ *
+ * A cache file holds the serialised tables of a key. It starts with the
+ * Suricata version, the kind of the tables and the key. The kind names the
+ * matcher and the version of its serialisation, e.g. "hyperscan 4.3.1" or
+ * "ac 1". The file name is a hash of these, they are compared when loading
+ * so a hash collision or a file of an other version is never used.
+ *
+ * Restarts and rule reloads load the tables of the contexts with unchanged
+ * patterns from the cache instead of building them again.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+
+#include "conf.h"
+#include "threads.h"
+#include "util-conf.h"
+#include "util-debug.h"
+#include "util-hash-lookup3.h"
+#include "util-misc.h"
+#include "util-mpm-cache.h"
+#include "util-unittest.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <dirent.h>
+#endif
+
+#define MPM_CACHE_HEADER "suricata mpm cache 3\n"
+#define MPM_CACHE_SUFFIX ".mpm"
+
+/* Default size limit of the cache directory (mpm-cache.max-size). */
+#define MPM_CACHE_DEFAULT_MAX_SIZE (1024ULL * 1024 * 1024)
+
+/* Directory of the cache (mpm-cache.dir), NULL if disabled, and its size
+ * limit, 0 for no limit. Set up on first use. The size is the size of the
+ * cache files as of the last prune plus what was saved since. All of these
+ * are protected by g_cache_mutex. */
+static int g_cache_setup = 0;
+static char *g_cache_dir = NULL;
+static uint64_t g_cache_max_size = MPM_CACHE_DEFAULT_MAX_SIZE;
+static uint64_t g_cache_size = 0;
+static SCMutex g_cache_mutex = SCMUTEX_INITIALIZER;
+
+#ifdef HAVE_SYS_MMAN_H
+
+/**
+ * \internal
+ * \brief Read the cache config.
+ *
+ * \note g_cache_mutex must be held
+ */
+static void MpmCacheSetup(void)
+{
+    char *dir = NULL;
+    if (ConfGet("mpm-cache.dir", &dir) != 1 || dir == NULL || dir[0] == '\0')
+        return;
+
+    if (access(dir, R_OK | W_OK | X_OK) != 0) {
+        SCLogWarning(SC_ERR_INVALID_ARGUMENT, "mpm-cache.dir %s is not "
+                "usable: %s, mpm cache disabled", dir, strerror(errno));
+        return;
+    }
+    g_cache_dir = SCStrdup(dir);
+    if (g_cache_dir == NULL)
+        return;
+
+    char *max_size = NULL;
+    if (ConfGet("mpm-cache.max-size", &max_size) == 1 && max_size != NULL) {
+        if (ParseSizeStringU64(max_size, &g_cache_max_size) < 0) {
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "invalid mpm-cache.max-size "
+                    "%s, using the default", max_size);
+            g_cache_max_size = MPM_CACHE_DEFAULT_MAX_SIZE;
+        }
+    }
+    SCLogConfig("using mpm cache in %s, max size %"PRIu64,
+            g_cache_dir, g_cache_max_size);
+
+    /* the cache may have grown over the limit under an other config */
+    g_cache_size = MpmCachePrune(g_cache_dir, g_cache_max_size);
+}
+
+/**
+ * \brief Get the configured cache directory.
+ *
+ * \retval dir the directory, valid until MpmCacheGlobalCleanup()
+ * \retval NULL the cache is disabled
+ */
+const char *MpmCacheDir(void)
+{
+    SCMutexLock(&g_cache_mutex);
+    if (!g_cache_setup) {
+        MpmCacheSetup();
+        g_cache_setup = 1;
+    }
+    const char *dir = g_cache_dir;
+    SCMutexUnlock(&g_cache_mutex);
+    return dir;
+}
+
+/**
+ * \internal
+ * \brief Build the key of a cache file: the versions and the key.
+ *
+ * \retval file_key buffer, to be freed by the caller, NULL on error
+ */
+static uint8_t *MpmCacheFileKey(const char *kind, const uint8_t *key,
+                                uint32_t key_len, uint32_t *file_key_len)
+{
+    char header[256];
+    snprintf(header, sizeof(header), "%ssuricata %s %s\n",
+             MPM_CACHE_HEADER, PROG_VER, kind);
+    size_t header_len = strlen(header);
+
+    if ((uint64_t)header_len + key_len > UINT32_MAX) {
+        return NULL;
+    }
+    uint8_t *file_key = SCMalloc(header_len + key_len);
+    if (file_key == NULL) {
+        return NULL;
+    }
+    memcpy(file_key, header, header_len);
+    memcpy(file_key + header_len, key, key_len);
+
+    *file_key_len = (uint32_t)(header_len + key_len);
+    return file_key;
+}
+
+static void MpmCacheFilePath(const char *dir, const uint8_t *file_key,
+                             uint32_t file_key_len, char *path, size_t size)
+{
+    const uint32_t h1 = hashlittle_safe(file_key, file_key_len, 0);
+    const uint32_t h2 = hashlittle_safe(file_key, file_key_len, 0x5c4a5d1b);
+    snprintf(path, size, "%s/%08x%08x" MPM_CACHE_SUFFIX, dir, h1, h2);
+}
+
+/**
+ * \brief Get the path of the cache file of a key.
+ *
+ * \retval 0 path is set
+ * \retval -1 alloc failure
+ */
+int MpmCachePath(const char *dir, const char *kind, const uint8_t *key,
+                 uint32_t key_len, char *path, size_t size)
+{
+    uint32_t file_key_len = 0;
+    uint8_t *file_key = MpmCacheFileKey(kind, key, key_len, &file_key_len);
+    if (file_key == NULL) {
+        return -1;
+    }
+    MpmCacheFilePath(dir, file_key, file_key_len, path, size);
+    SCFree(file_key);
+    return 0;
+}
+
+/**
+ * \brief Load the tables of a key from the cache.
+ *
+ * \param Load called with the cached data to set up the tables
+ *
+ * \retval 0 the tables are set up from the cache
+ * \retval -1 not in the cache (or unusable)
+ */
+int MpmCacheLoad(const char *dir, const char *kind, const uint8_t *key,
+                 uint32_t key_len, MpmCacheLoadFunc Load, void *data)
+{
+    int ret = -1;
+    uint32_t file_key_len = 0;
+    uint8_t *file_key = MpmCacheFileKey(kind, key, key_len, &file_key_len);
+    if (file_key == NULL) {
+        return -1;
+    }
+
+    char path[PATH_MAX];
+    MpmCacheFilePath(dir, file_key, file_key_len, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        goto end;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        (uint64_t)st.st_size <= sizeof(uint32_t) + (uint64_t)file_key_len) {
+        goto end;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        goto end;
+    }
+
+    const uint8_t *buf = map;
+    uint32_t len = 0;
+    memcpy(&len, buf, sizeof(uint32_t));
+    if (len == file_key_len &&
+        memcmp(buf + sizeof(uint32_t), file_key, file_key_len) == 0) {
+        const uint8_t *tables = buf + sizeof(uint32_t) + file_key_len;
+        size_t tables_len = st.st_size - sizeof(uint32_t) - file_key_len;
+        if (Load(tables, tables_len, data) == 0) {
+            SCLogDebug("loaded %s tables from %s", kind, path);
+            /* mark it as used, pruning removes the least recently used */
+            (void)futimens(fd, NULL);
+            ret = 0;
+        } else {
+            SCLogDebug("failed to load %s tables from %s", kind, path);
+        }
+    } else {
+        SCLogDebug("%s: key mismatch", path);
+    }
+    munmap(map, st.st_size);
+
+end:
+    if (fd >= 0) {
+        close(fd);
+    }
+    SCFree(file_key);
+    return ret;
+}
+
+static int MpmCacheWrite(int fd, const void *buf, size_t len)
+{
+    const uint8_t *ptr = buf;
+    while (len > 0) {
+        ssize_t r = write(fd, ptr, len);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        ptr += r;
+        len -= r;
+    }
+    return 0;
+}
+
+/**
+ * \internal
+ * \brief Account a file saved in the configured cache, pruning the cache
+ *        if it grew over the limit.
+ */
+static void MpmCacheAddSize(const char *dir, uint64_t size)
+{
+    SCMutexLock(&g_cache_mutex);
+    if (g_cache_dir != NULL && g_cache_max_size != 0 &&
+        strcmp(dir, g_cache_dir) == 0) {
+        g_cache_size += size;
+        if (g_cache_size > g_cache_max_size) {
+            g_cache_size = MpmCachePrune(g_cache_dir, g_cache_max_size);
+        }
+    }
+    SCMutexUnlock(&g_cache_mutex);
+}
+
+/**
+ * \brief Store the serialised tables of a key in the cache.
+ *
+ * Written to a temporary file that is renamed into place, so that other
+ * instances never load a partial file. Files saved in the configured
+ * cache count towards its size limit.
+ */
+int MpmCacheSave(const char *dir, const char *kind, const uint8_t *key,
+                 uint32_t key_len, const void *buf, size_t len)
+{
+    int ret = -1;
+    int fd = -1;
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX];
+
+    uint32_t file_key_len = 0;
+    uint8_t *file_key = MpmCacheFileKey(kind, key, key_len, &file_key_len);
+    if (file_key == NULL) {
+        return -1;
+    }
+    MpmCacheFilePath(dir, file_key, file_key_len, path, sizeof(path));
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s/.mpm-XXXXXX", dir);
+    fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        SCLogDebug("failed to create %s: %s", tmp_path, strerror(errno));
+        goto end;
+    }
+
+    if (MpmCacheWrite(fd, &file_key_len, sizeof(uint32_t)) != 0 ||
+        MpmCacheWrite(fd, file_key, file_key_len) != 0 ||
+        MpmCacheWrite(fd, buf, len) != 0) {
+        SCLogDebug("failed to write %s: %s", tmp_path, strerror(errno));
+        unlink(tmp_path);
+        goto end;
+    }
+    close(fd);
+    fd = -1;
+
+    if (rename(tmp_path, path) != 0) {
+        SCLogDebug("failed to rename %s to %s: %s", tmp_path, path,
+                   strerror(errno));
+        unlink(tmp_path);
+        goto end;
+    }
+    SCLogDebug("stored %s tables in %s", kind, path);
+    MpmCacheAddSize(dir, sizeof(uint32_t) + (uint64_t)file_key_len + len);
+    ret = 0;
+
+end:
+    if (fd >= 0) {
+        close(fd);
+    }
+    SCFree(file_key);
+    return ret;
+}
+
+typedef struct MpmCacheFile_ {
+    char name[NAME_MAX + 1];
+    uint64_t size;
+    time_t mtime;
+} MpmCacheFile;
+
+static int MpmCacheFileCompare(const void *a, const void *b)
+{
+    const MpmCacheFile *f1 = a;
+    const MpmCacheFile *f2 = b;
+
+    if (f1->mtime != f2->mtime)
+        return f1->mtime < f2->mtime ? -1 : 1;
+    return strcmp(f1->name, f2->name);
+}
+
+/**
+ * \brief Remove the least recently used files of the cache until it is
+ *        below the size limit.
+ *
+ * Loading a file updates its modification time, so the tables in use
+ * are removed last. The cache is pruned down to 3/4 of the limit, so that
+ * the next saves don't prune again right away. Only the cache files are
+ * looked at, not the temporary files of saves in progress.
+ *
+ * \param max_size size limit, 0 for no limit
+ *
+ * \retval size the size of the cache files left
+ */
+uint64_t MpmCachePrune(const char *dir, uint64_t max_size)
+{
+    MpmCacheFile *files = NULL;
+    uint32_t cnt = 0, size = 0;
+    uint64_t total = 0;
+    const size_t suffix_len = strlen(MPM_CACHE_SUFFIX);
+
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        return 0;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        const size_t len = strlen(de->d_name);
+        if (de->d_name[0] == '.' || len <= suffix_len ||
+            strcmp(de->d_name + len - suffix_len, MPM_CACHE_SUFFIX) != 0) {
+            continue;
+        }
+
+        char path[PATH_MAX];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        if (cnt == size) {
+            uint32_t new_size = size ? size * 2 : 64;
+            MpmCacheFile *ptmp = SCRealloc(files, new_size * sizeof(MpmCacheFile));
+            if (ptmp == NULL) {
+                break;
+            }
+            files = ptmp;
+            size = new_size;
+        }
+        strlcpy(files[cnt].name, de->d_name, sizeof(files[cnt].name));
+        files[cnt].size = (uint64_t)st.st_size;
+        files[cnt].mtime = st.st_mtime;
+        cnt++;
+        total += (uint64_t)st.st_size;
+    }
+    closedir(d);
+
+    if (max_size != 0 && total > max_size) {
+        const uint64_t target = max_size - max_size / 4;
+        uint32_t i, removed = 0;
+
+        qsort(files, cnt, sizeof(MpmCacheFile), MpmCacheFileCompare);
+        for (i = 0; i < cnt && total > target; i++) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", dir, files[i].name);
+            if (unlink(path) == 0) {
+                total -= files[i].size;
+                removed++;
+            }
+        }
+        SCLogPerf("removed %"PRIu32" mpm cache files from %s, size "
+                "now %"PRIu64, removed, dir, total);
+    }
+
+    if (files != NULL) {
+        SCFree(files);
+    }
+    return total;
+}
+
+#else /* !HAVE_SYS_MMAN_H */
+
+const char *MpmCacheDir(void)
+{
+    SCMutexLock(&g_cache_mutex);
+    if (!g_cache_setup) {
+        char *dir = NULL;
+        if (ConfGet("mpm-cache.dir", &dir) == 1 && dir != NULL && dir[0] != '\0') {
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT, "mpm-cache.dir is not "
+                    "supported on this platform");
+        }
+        g_cache_setup = 1;
+    }
+    SCMutexUnlock(&g_cache_mutex);
+    return NULL;
+}
+
+int MpmCacheLoad(const char *dir, const char *kind, const uint8_t *key,
+                 uint32_t key_len, MpmCacheLoadFunc Load, void *data)
+{
+    return -1;
+}
+
+int MpmCacheSave(const char *dir, const char *kind, const uint8_t *key,
+                 uint32_t key_len, const void *buf, size_t len)
+{
+    return -1;
+}
+
+int MpmCachePath(const char *dir, const char *kind, const uint8_t *key,
+                 uint32_t key_len, char *path, size_t size)
+{
+    return -1;
+}
+
+uint64_t MpmCachePrune(const char *dir, uint64_t max_size)
+{
+    return 0;
+}
+
+#endif /* HAVE_SYS_MMAN_H */
+
+/**
+ * \brief Clean up the cache settings.
+ */
+void MpmCacheGlobalCleanup(void)
+{
+    SCMutexLock(&g_cache_mutex);
+    if (g_cache_dir != NULL) {
+        SCFree(g_cache_dir);
+        g_cache_dir = NULL;
+    }
+    g_cache_max_size = MPM_CACHE_DEFAULT_MAX_SIZE;
+    g_cache_size = 0;
+    g_cache_setup = 0;
+    SCMutexUnlock(&g_cache_mutex);
+}
+
+/*************************************Unittests********************************/
+
+#ifdef UNITTESTS
+#ifdef HAVE_SYS_MMAN_H
+
+static int MpmCacheTestLoad(const uint8_t *buf, size_t len, void *data)
+{
+    const char *expect = data;
+    if (len != strlen(expect) || memcmp(buf, expect, len) != 0)
+        return -1;
+    return 0;
+}
+
+static int MpmCacheTestLoadFail(const uint8_t *buf, size_t len, void *data)
+{
+    return -1;
+}
+
+/** \test a saved file is only loaded for the same kind and key */
+static int MpmCacheTest01(void)
+{
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    char path2[PATH_MAX];
+    const uint8_t key[] = "key1";
+    const uint8_t key2[] = "key2";
+    const char *tables = "tables";
+
+    snprintf(dir, sizeof(dir), "%s/suricata-mpm-cache-XXXXXX",
+             ConfigGetLogDirectory());
+    FAIL_IF_NULL(mkdtemp(dir));
+
+    FAIL_IF(MpmCacheSave(dir, "test 1", key, sizeof(key), tables,
+                         strlen(tables)) != 0);
+    FAIL_IF(MpmCacheLoad(dir, "test 1", key, sizeof(key), MpmCacheTestLoad,
+                         (void *)tables) != 0);
+    /* the loader rejecting the data is a miss */
+    FAIL_IF(MpmCacheLoad(dir, "test 1", key, sizeof(key), MpmCacheTestLoadFail,
+                         NULL) == 0);
+    FAIL_IF(MpmCacheLoad(dir, "test 2", key, sizeof(key), MpmCacheTestLoad,
+                         (void *)tables) == 0);
+    FAIL_IF(MpmCacheLoad(dir, "test 1", key2, sizeof(key2), MpmCacheTestLoad,
+                         (void *)tables) == 0);
+
+    FAIL_IF(MpmCachePath(dir, "test 1", key, sizeof(key), path,
+                         sizeof(path)) != 0);
+    FAIL_IF(MpmCachePath(dir, "test 2", key, sizeof(key), path2,
+                         sizeof(path2)) != 0);
+    FAIL_IF(strcmp(path, path2) == 0);
+    FAIL_IF(unlink(path) != 0);
+    FAIL_IF(rmdir(dir) != 0);
+    PASS;
+}
+
+/** \test the cache is pruned to 3/4 of the limit, least recently used
+ *        files first, other files are left alone */
+static int MpmCacheTest02(void)
+{
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    const char *names[] = { "0000000000000001.mpm", "0000000000000002.mpm",
+                            "0000000000000003.mpm", "other" };
+    uint8_t data[100];
+    int i;
+
+    memset(data, 0, sizeof(data));
+    snprintf(dir, sizeof(dir), "%s/suricata-mpm-cache-XXXXXX",
+             ConfigGetLogDirectory());
+    FAIL_IF_NULL(mkdtemp(dir));
+
+    /* file 2 was used last */
+    const time_t mtimes[] = { 1000, 3000, 2000, 0 };
+    for (i = 0; i < 4; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        FILE *fp = fopen(path, "w");
+        FAIL_IF_NULL(fp);
+        FAIL_IF(fwrite(data, 1, sizeof(data), fp) != sizeof(data));
+        fclose(fp);
+        struct timeval tv[2] = { { mtimes[i], 0 }, { mtimes[i], 0 } };
+        FAIL_IF(utimes(path, tv) != 0);
+    }
+
+    /* below the limit, or no limit */
+    FAIL_IF(MpmCachePrune(dir, 300) != 300);
+    FAIL_IF(MpmCachePrune(dir, 0) != 300);
+
+    /* 3/4 of 250 leaves one file */
+    FAIL_IF(MpmCachePrune(dir, 250) != 100);
+    for (i = 0; i < 4; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        int exists = (access(path, F_OK) == 0);
+        FAIL_IF(exists != (i == 1 || i == 3));
+        if (exists)
+            FAIL_IF(unlink(path) != 0);
+    }
+    FAIL_IF(rmdir(dir) != 0);
+    PASS;
+}
+
+#endif /* HAVE_SYS_MMAN_H */
+#endif /* UNITTESTS */
+
+void MpmCacheRegisterTests(void)
+{
+#ifdef UNITTESTS
+#ifdef HAVE_SYS_MMAN_H
+    UtRegisterTest("MpmCacheTest01", MpmCacheTest01);
+    UtRegisterTest("MpmCacheTest02", MpmCacheTest02);
+#endif
+#endif
+}
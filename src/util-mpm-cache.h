@@ -0,0 +1,45 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * On disk cache of the built mpm tables (mpm-cache.dir), shared by the
+ * Hyperscan databases and the "ac" state tables.
+ */
+
+#ifndef __UTIL_MPM_CACHE_H__
+#define __UTIL_MPM_CACHE_H__
+
+/** set up the object of a cache file from its data, the data is only valid
+ *  during the call. Returns 0 on success, -1 if the data is unusable. */
+typedef int (*MpmCacheLoadFunc)(const uint8_t *buf, size_t len, void *data);
+
+const char *MpmCacheDir(void);
+
+int MpmCacheLoad(const char *dir, const char *kind, const uint8_t *key,
+                 uint32_t key_len, MpmCacheLoadFunc Load, void *data);
+int MpmCacheSave(const char *dir, const char *kind, const uint8_t *key,
+                 uint32_t key_len, const void *buf, size_t len);
+int MpmCachePath(const char *dir, const char *kind, const uint8_t *key,
+                 uint32_t key_len, char *path, size_t size);
+uint64_t MpmCachePrune(const char *dir, uint64_t max_size);
+
+void MpmCacheGlobalCleanup(void);
+void MpmCacheRegisterTests(void);
+
+#endif /* __UTIL_MPM_CACHE_H__ */
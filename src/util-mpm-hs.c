@@ -32,6 +32,7 @@
 #include "detect-engine.h"
 
 #include "conf.h"
+#include "util-conf.h"
 #include "util-debug.h"
 #include "util-unittest.h"
 #include "util-unittest-helper.h"
@@ -56,7 +57,7 @@ int SCHSAddPatternCS(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
                      uint32_t, SigIntId, uint8_t);
 int SCHSPreparePatterns(MpmCtx *mpm_ctx);
 uint32_t SCHSSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
-                    PatternMatcherQueue *pmq, const uint8_t *buf, const uint16_t buflen);
+                    PatternMatcherQueue *pmq, const uint8_t *buf, const uint32_t buflen);
 void SCHSPrintInfo(MpmCtx *mpm_ctx);
 void SCHSPrintSearchStats(MpmThreadCtx *mpm_thread_ctx);
 void SCHSRegisterTests(void);
@@ -64,20 +65,12 @@ void SCHSRegisterTests(void);
 /* size of the hash table used to speed up pattern insertions initially */
 #define INIT_HASH_SIZE 65536
 
-/* Initial size of the global database hash (used for de-duplication). */
-#define INIT_DB_HASH_SIZE 1000
-
 /* Global prototype scratch, built incrementally as Hyperscan databases are
  * built and then cloned for each thread context. Access is serialised via
  * g_scratch_proto_mutex. */
 static hs_scratch_t *g_scratch_proto = NULL;
 static SCMutex g_scratch_proto_mutex = SCMUTEX_INITIALIZER;
 
-/* Global hash table of Hyperscan databases, used for de-duplication. Access is
- * serialised via g_db_table_mutex. */
-static HashTable *g_db_table = NULL;
-static SCMutex g_db_table_mutex = SCMUTEX_INITIALIZER;
-
 /**
  * \internal
  * \brief Wraps SCMalloc (which is a macro) so that it can be passed to
@@ -437,132 +430,149 @@ static void SCHSFreeCompileData(SCHSCompileData *cd)
     SCFree(cd);
 }
 
-typedef struct PatternDatabase_ {
-    SCHSPattern **parray;
-    hs_database_t *hs_db;
-    uint32_t pattern_cnt;
-
-    /* Reference count: number of MPM contexts using this pattern database. */
-    uint32_t ref_cnt;
-} PatternDatabase;
-
-static uint32_t SCHSPatternHash(const SCHSPattern *p, uint32_t hash)
+/**
+ * \internal
+ * \brief qsort compare function to put the patterns of a context in an order
+ *        that only depends on the patterns, not on the order they were added
+ *        in or their ids.
+ */
+static int SCHSPatternSortCompare(const void *a, const void *b)
 {
-    BUG_ON(p->original_pat == NULL);
-    BUG_ON(p->sids == NULL);
-
-    hash = hashlittle_safe(&p->len, sizeof(p->len), hash);
-    hash = hashlittle_safe(&p->flags, sizeof(p->flags), hash);
-    hash = hashlittle_safe(p->original_pat, p->len, hash);
-    hash = hashlittle_safe(&p->id, sizeof(p->id), hash);
-    hash = hashlittle_safe(&p->offset, sizeof(p->offset), hash);
-    hash = hashlittle_safe(&p->depth, sizeof(p->depth), hash);
-    hash = hashlittle_safe(&p->sids_size, sizeof(p->sids_size), hash);
-    hash = hashlittle_safe(p->sids, p->sids_size * sizeof(SigIntId), hash);
-    return hash;
+    const SCHSPattern *p1 = *(const SCHSPattern **)a;
+    const SCHSPattern *p2 = *(const SCHSPattern **)b;
+
+    if (p1->len != p2->len)
+        return p1->len < p2->len ? -1 : 1;
+    if (p1->flags != p2->flags)
+        return p1->flags < p2->flags ? -1 : 1;
+    if (p1->offset != p2->offset)
+        return p1->offset < p2->offset ? -1 : 1;
+    if (p1->depth != p2->depth)
+        return p1->depth < p2->depth ? -1 : 1;
+    return memcmp(p1->original_pat, p2->original_pat, p1->len);
 }
 
-static char SCHSPatternCompare(const SCHSPattern *p1, const SCHSPattern *p2)
+/* The databases are shared through util-hyperscan.c, keyed on the patterns
+ * in database order. The pattern ids and sids are left out of the key, they
+ * are not part of the compiled database. */
+#define HS_MPM_KEY "mpm\n"
+
+/**
+ * \internal
+ * \brief Build the database key of the patterns of a context.
+ *
+ * \retval key buffer, to be freed by the caller, NULL on error
+ */
+static uint8_t *SCHSDatabaseKey(SCHSPattern **parray, uint32_t pattern_cnt,
+                                uint32_t *key_len)
 {
-    if ((p1->len != p2->len) || (p1->flags != p2->flags) ||
-        (p1->id != p2->id) || (p1->offset != p2->offset) ||
-        (p1->depth != p2->depth) || (p1->sids_size != p2->sids_size)) {
-        return 0;
-    }
+    const size_t tag_len = strlen(HS_MPM_KEY);
 
-    if (SCMemcmp(p1->original_pat, p2->original_pat, p1->len) != 0) {
-        return 0;
+    size_t len = tag_len + sizeof(uint32_t);
+    for (uint32_t i = 0; i < pattern_cnt; i++) {
+        len += sizeof(uint16_t) * 3 + sizeof(uint8_t) + parray[i]->len;
     }
-
-    if (SCMemcmp(p1->sids, p2->sids, p1->sids_size * sizeof(p1->sids[0])) !=
-        0) {
-        return 0;
+    if (len > UINT32_MAX) {
+        return NULL;
     }
 
-    return 1;
-}
-
-static uint32_t PatternDatabaseHash(HashTable *ht, void *data, uint16_t len)
-{
-    const PatternDatabase *pd = data;
-    uint32_t hash = 0;
-    hash = hashword(&pd->pattern_cnt, 1, hash);
-
-    for (uint32_t i = 0; i < pd->pattern_cnt; i++) {
-        hash = SCHSPatternHash(pd->parray[i], hash);
+    uint8_t *key = SCMalloc(len);
+    if (key == NULL) {
+        return NULL;
+    }
+    uint8_t *ptr = key;
+    memcpy(ptr, HS_MPM_KEY, tag_len);
+    ptr += tag_len;
+    memcpy(ptr, &pattern_cnt, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    for (uint32_t i = 0; i < pattern_cnt; i++) {
+        const SCHSPattern *p = parray[i];
+        memcpy(ptr, &p->len, sizeof(uint16_t));
+        ptr += sizeof(uint16_t);
+        memcpy(ptr, &p->offset, sizeof(uint16_t));
+        ptr += sizeof(uint16_t);
+        memcpy(ptr, &p->depth, sizeof(uint16_t));
+        ptr += sizeof(uint16_t);
+        *ptr++ = p->flags;
+        memcpy(ptr, p->original_pat, p->len);
+        ptr += p->len;
     }
 
-    hash %= ht->array_size;
-    return hash;
+    *key_len = (uint32_t)len;
+    return key;
 }
 
-static char PatternDatabaseCompare(void *data1, uint16_t len1, void *data2,
-                                   uint16_t len2)
+typedef struct SCHSCompileArgs_ {
+    SCHSPattern **parray;
+    uint32_t pattern_cnt;
+} SCHSCompileArgs;
+
+/**
+ * \internal
+ * \brief Compile the Hyperscan database for the patterns, called by
+ *        HSDatabaseGet() if the database isn't in use or cached yet.
+ */
+static int SCHSDatabaseCompile(void *data, hs_database_t **hs_db)
 {
-    const PatternDatabase *pd1 = data1;
-    const PatternDatabase *pd2 = data2;
+    const SCHSCompileArgs *args = data;
+    hs_error_t err;
+    hs_compile_error_t *compile_err = NULL;
+    int ret = -1;
 
-    if (pd1->pattern_cnt != pd2->pattern_cnt) {
-        return 0;
+    BUG_ON(args->pattern_cnt == 0);
+
+    SCHSCompileData *cd = SCHSAllocCompileData(args->pattern_cnt);
+    if (cd == NULL) {
+        return -1;
     }
 
-    for (uint32_t i = 0; i < pd1->pattern_cnt; i++) {
-        if (SCHSPatternCompare(pd1->parray[i], pd2->parray[i]) == 0) {
-            return 0;
+    for (uint32_t i = 0; i < args->pattern_cnt; i++) {
+        const SCHSPattern *p = args->parray[i];
+
+        cd->ids[i] = i;
+        cd->flags[i] = HS_FLAG_SINGLEMATCH;
+        if (p->flags & MPM_PATTERN_FLAG_NOCASE) {
+            cd->flags[i] |= HS_FLAG_CASELESS;
         }
-    }
 
-    return 1;
-}
+        cd->expressions[i] = HSRenderPattern(p->original_pat, p->len);
 
-static void PatternDatabaseFree(PatternDatabase *pd)
-{
-    BUG_ON(pd->ref_cnt != 0);
-
-    if (pd->parray != NULL) {
-        for (uint32_t i = 0; i < pd->pattern_cnt; i++) {
-            SCHSPattern *p = pd->parray[i];
-            if (p != NULL) {
-                SCFree(p->original_pat);
-                SCFree(p->sids);
-                SCFree(p);
+        if (p->flags & (MPM_PATTERN_FLAG_OFFSET | MPM_PATTERN_FLAG_DEPTH)) {
+            cd->ext[i] = SCMalloc(sizeof(hs_expr_ext_t));
+            if (cd->ext[i] == NULL) {
+                goto end;
+            }
+            memset(cd->ext[i], 0, sizeof(hs_expr_ext_t));
+
+            if (p->flags & MPM_PATTERN_FLAG_OFFSET) {
+                cd->ext[i]->flags |= HS_EXT_FLAG_MIN_OFFSET;
+                cd->ext[i]->min_offset = p->offset + p->len;
+            }
+            if (p->flags & MPM_PATTERN_FLAG_DEPTH) {
+                cd->ext[i]->flags |= HS_EXT_FLAG_MAX_OFFSET;
+                cd->ext[i]->max_offset = p->offset + p->depth;
             }
         }
-        SCFree(pd->parray);
     }
 
-    hs_free_database(pd->hs_db);
-
-    SCFree(pd);
-}
-
-static void PatternDatabaseTableFree(void *data)
-{
-    /* Stub function handed to hash table; actual freeing of PatternDatabase
-     * structures is done in MPM destruction when the ref_cnt drops to zero. */
-}
+    err = hs_compile_ext_multi((const char *const *)cd->expressions, cd->flags,
+                               cd->ids, (const hs_expr_ext_t *const *)cd->ext,
+                               cd->pattern_cnt, HS_MODE_BLOCK, NULL, hs_db,
+                               &compile_err);
 
-static PatternDatabase *PatternDatabaseAlloc(uint32_t pattern_cnt)
-{
-    PatternDatabase *pd = SCMalloc(sizeof(PatternDatabase));
-    if (pd == NULL) {
-        return NULL;
-    }
-    memset(pd, 0, sizeof(PatternDatabase));
-    pd->pattern_cnt = pattern_cnt;
-    pd->ref_cnt = 0;
-    pd->hs_db = NULL;
-
-    /* alloc the pattern array */
-    pd->parray =
-        (SCHSPattern **)SCMalloc(pd->pattern_cnt * sizeof(SCHSPattern *));
-    if (pd->parray == NULL) {
-        SCFree(pd);
-        return NULL;
+    if (err != HS_SUCCESS) {
+        SCLogError(SC_ERR_FATAL, "failed to compile hyperscan database");
+        if (compile_err) {
+            SCLogError(SC_ERR_FATAL, "compile error: %s", compile_err->message);
+        }
+        hs_free_compile_error(compile_err);
+        goto end;
     }
-    memset(pd->parray, 0, pd->pattern_cnt * sizeof(SCHSPattern *));
+    ret = 0;
 
-    return pd;
+end:
+    SCHSFreeCompileData(cd);
+    return ret;
 }
 
 /**
@@ -580,19 +590,15 @@ int SCHSPreparePatterns(MpmCtx *mpm_ctx)
     }
 
     hs_error_t err;
-    hs_compile_error_t *compile_err = NULL;
-    SCHSCompileData *cd = NULL;
-    PatternDatabase *pd = NULL;
+    uint8_t *key = NULL;
+    uint32_t key_len = 0;
 
-    cd = SCHSAllocCompileData(mpm_ctx->pattern_cnt);
-    if (cd == NULL) {
-        goto error;
-    }
-
-    pd = PatternDatabaseAlloc(mpm_ctx->pattern_cnt);
-    if (pd == NULL) {
+    ctx->parray = SCMalloc(mpm_ctx->pattern_cnt * sizeof(SCHSPattern *));
+    if (ctx->parray == NULL) {
         goto error;
     }
+    mpm_ctx->memory_cnt++;
+    mpm_ctx->memory_size += mpm_ctx->pattern_cnt * sizeof(SCHSPattern *);
 
     /* populate the pattern array with the patterns in the hash */
     for (uint32_t i = 0, p = 0; i < INIT_HASH_SIZE; i++) {
@@ -600,7 +606,7 @@ int SCHSPreparePatterns(MpmCtx *mpm_ctx)
         while (node != NULL) {
             nnode = node->next;
             node->next = NULL;
-            pd->parray[p++] = node;
+            ctx->parray[p++] = node;
             node = nnode;
         }
     }
@@ -609,122 +615,60 @@ int SCHSPreparePatterns(MpmCtx *mpm_ctx)
     SCFree(ctx->init_hash);
     ctx->init_hash = NULL;
 
-    /* Serialise whole database compilation as a relatively easy way to ensure
-     * dedupe is safe. */
-    SCMutexLock(&g_db_table_mutex);
-
-    /* Init global pattern database hash if necessary. */
-    if (g_db_table == NULL) {
-        g_db_table = HashTableInit(INIT_DB_HASH_SIZE, PatternDatabaseHash,
-                                   PatternDatabaseCompare,
-                                   PatternDatabaseTableFree);
-        if (g_db_table == NULL) {
-            SCMutexUnlock(&g_db_table_mutex);
-            goto error;
-        }
-    }
+    /* the same patterns have to end up in the same order for the database
+     * to be reused, whatever their ids, sids and insertion order */
+    qsort(ctx->parray, mpm_ctx->pattern_cnt, sizeof(SCHSPattern *),
+          SCHSPatternSortCompare);
 
-    /* Check global hash table to see if we've seen this pattern database
-     * before, and reuse the Hyperscan database if so. */
-    PatternDatabase *pd_cached = HashTableLookup(g_db_table, pd, 1);
-
-    if (pd_cached != NULL) {
-        SCLogDebug("Reusing cached database %p with %" PRIu32
-                   " patterns (ref_cnt=%" PRIu32 ")",
-                   pd_cached->hs_db, pd_cached->pattern_cnt,
-                   pd_cached->ref_cnt);
-        pd_cached->ref_cnt++;
-        ctx->pattern_db = pd_cached;
-        SCMutexUnlock(&g_db_table_mutex);
-        PatternDatabaseFree(pd);
-        SCHSFreeCompileData(cd);
-        return 0;
+    key = SCHSDatabaseKey(ctx->parray, mpm_ctx->pattern_cnt, &key_len);
+    if (key == NULL) {
+        goto error;
     }
 
     BUG_ON(ctx->pattern_db != NULL); /* already built? */
 
-    for (uint32_t i = 0; i < pd->pattern_cnt; i++) {
-        const SCHSPattern *p = pd->parray[i];
-
-        cd->ids[i] = i;
-        cd->flags[i] = HS_FLAG_SINGLEMATCH;
-        if (p->flags & MPM_PATTERN_FLAG_NOCASE) {
-            cd->flags[i] |= HS_FLAG_CASELESS;
-        }
-
-        cd->expressions[i] = HSRenderPattern(p->original_pat, p->len);
-
-        if (p->flags & (MPM_PATTERN_FLAG_OFFSET | MPM_PATTERN_FLAG_DEPTH)) {
-            cd->ext[i] = SCMalloc(sizeof(hs_expr_ext_t));
-            if (cd->ext[i] == NULL) {
-                goto error;
-            }
-            memset(cd->ext[i], 0, sizeof(hs_expr_ext_t));
-
-            if (p->flags & MPM_PATTERN_FLAG_OFFSET) {
-                cd->ext[i]->flags |= HS_EXT_FLAG_MIN_OFFSET;
-                cd->ext[i]->min_offset = p->offset + p->len;
-            }
-            if (p->flags & MPM_PATTERN_FLAG_DEPTH) {
-                cd->ext[i]->flags |= HS_EXT_FLAG_MAX_OFFSET;
-                cd->ext[i]->max_offset = p->offset + p->depth;
-            }
-        }
-    }
-
-    BUG_ON(mpm_ctx->pattern_cnt == 0);
-
-    err = hs_compile_ext_multi((const char *const *)cd->expressions, cd->flags,
-                               cd->ids, (const hs_expr_ext_t *const *)cd->ext,
-                               cd->pattern_cnt, HS_MODE_BLOCK, NULL, &pd->hs_db,
-                               &compile_err);
-
-    if (err != HS_SUCCESS) {
-        SCLogError(SC_ERR_FATAL, "failed to compile hyperscan database");
-        if (compile_err) {
-            SCLogError(SC_ERR_FATAL, "compile error: %s", compile_err->message);
-        }
-        hs_free_compile_error(compile_err);
+    /* reuse the database of an other context with the same patterns, from
+     * this or an other detection engine, or from the on disk cache */
+    SCHSCompileArgs args = { .parray = ctx->parray,
+                             .pattern_cnt = mpm_ctx->pattern_cnt };
+    int added = 0;
+    HSDatabase *db = HSDatabaseGet(key, key_len, SCHSDatabaseCompile, &args,
+                                   &added);
+    if (db == NULL) {
         goto error;
     }
-
-    ctx->pattern_db = pd;
+    ctx->pattern_db = db;
 
     SCMutexLock(&g_scratch_proto_mutex);
-    err = hs_alloc_scratch(pd->hs_db, &g_scratch_proto);
+    err = hs_alloc_scratch(db->hs_db, &g_scratch_proto);
     SCMutexUnlock(&g_scratch_proto_mutex);
     if (err != HS_SUCCESS) {
         SCLogError(SC_ERR_FATAL, "failed to allocate scratch");
         goto error;
     }
 
-    err = hs_database_size(pd->hs_db, &ctx->hs_db_size);
-    if (err != HS_SUCCESS) {
-        SCLogError(SC_ERR_FATAL, "failed to query database size");
-        goto error;
-    }
-
-    mpm_ctx->memory_cnt++;
-    mpm_ctx->memory_size += ctx->hs_db_size;
+    /* the memory of a shared database is accounted to the context that
+     * added it */
+    if (added) {
+        err = hs_database_size(db->hs_db, &ctx->hs_db_size);
+        if (err != HS_SUCCESS) {
+            SCLogError(SC_ERR_FATAL, "failed to query database size");
+            goto error;
+        }
 
-    SCLogDebug("Built %" PRIu32 " patterns into a database of size %" PRIuMAX
-               " bytes", mpm_ctx->pattern_cnt, (uintmax_t)ctx->hs_db_size);
+        mpm_ctx->memory_cnt++;
+        mpm_ctx->memory_size += ctx->hs_db_size;
 
-    /* Cache this database globally for later. */
-    pd->ref_cnt = 1;
-    HashTableAdd(g_db_table, pd, 1);
-    SCMutexUnlock(&g_db_table_mutex);
+        SCLogDebug("Built %" PRIu32 " patterns into a database of size %" PRIuMAX
+                   " bytes", mpm_ctx->pattern_cnt, (uintmax_t)ctx->hs_db_size);
+    }
 
-    SCHSFreeCompileData(cd);
+    SCFree(key);
     return 0;
 
 error:
-    SCMutexUnlock(&g_db_table_mutex);
-    if (pd) {
-        PatternDatabaseFree(pd);
-    }
-    if (cd) {
-        SCHSFreeCompileData(cd);
+    if (key != NULL) {
+        SCFree(key);
     }
     return -1;
 }
@@ -854,19 +798,21 @@ void SCHSDestroyCtx(MpmCtx *mpm_ctx)
         mpm_ctx->memory_size -= (INIT_HASH_SIZE * sizeof(SCHSPattern *));
     }
 
-    /* Decrement pattern database ref count, and delete it entirely if the
-     * count has dropped to zero. */
-    SCMutexLock(&g_db_table_mutex);
-    PatternDatabase *pd = ctx->pattern_db;
-    if (pd) {
-        BUG_ON(pd->ref_cnt == 0);
-        pd->ref_cnt--;
-        if (pd->ref_cnt == 0) {
-            HashTableRemove(g_db_table, pd, 1);
-            PatternDatabaseFree(pd);
+    if (ctx->parray != NULL) {
+        for (uint32_t i = 0; i < mpm_ctx->pattern_cnt; i++) {
+            SCHSFreePattern(mpm_ctx, ctx->parray[i]);
         }
+        SCFree(ctx->parray);
+        ctx->parray = NULL;
+        mpm_ctx->memory_cnt--;
+        mpm_ctx->memory_size -= (mpm_ctx->pattern_cnt * sizeof(SCHSPattern *));
+    }
+
+    /* Release the pattern database, it is freed with its last user. */
+    if (ctx->pattern_db != NULL) {
+        HSDatabaseRelease(ctx->pattern_db);
+        ctx->pattern_db = NULL;
     }
-    SCMutexUnlock(&g_db_table_mutex);
 
     SCFree(mpm_ctx->ctx);
     mpm_ctx->memory_cnt--;
@@ -886,8 +832,7 @@ static int SCHSMatchEvent(unsigned int id, unsigned long long from,
 {
     SCHSCallbackCtx *cctx = ctx;
     PatternMatcherQueue *pmq = cctx->pmq;
-    const PatternDatabase *pd = cctx->ctx->pattern_db;
-    const SCHSPattern *pat = pd->parray[id];
+    const SCHSPattern *pat = cctx->ctx->parray[id];
 
     SCLogDebug("Hyperscan Match %" PRIu32 ": id=%" PRIu32 " @ %" PRIuMAX
                " (pat id=%" PRIu32 ")",
@@ -912,12 +857,12 @@ static int SCHSMatchEvent(unsigned int id, unsigned long long from,
  * \retval matches Match count.
  */
 uint32_t SCHSSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
-                    PatternMatcherQueue *pmq, const uint8_t *buf, const uint16_t buflen)
+                    PatternMatcherQueue *pmq, const uint8_t *buf, const uint32_t buflen)
 {
     uint32_t ret = 0;
     SCHSCtx *ctx = (SCHSCtx *)mpm_ctx->ctx;
     SCHSThreadCtx *hs_thread_ctx = (SCHSThreadCtx *)(mpm_thread_ctx->ctx);
-    const PatternDatabase *pd = ctx->pattern_db;
+    const HSDatabase *db = ctx->pattern_db;
 
     if (unlikely(buflen == 0)) {
         return 0;
@@ -927,10 +872,10 @@ uint32_t SCHSSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
 
     /* scratch should have been cloned from g_scratch_proto at thread init. */
     hs_scratch_t *scratch = hs_thread_ctx->scratch;
-    BUG_ON(pd->hs_db == NULL);
+    BUG_ON(db->hs_db == NULL);
     BUG_ON(scratch == NULL);
 
-    hs_error_t err = hs_scan(pd->hs_db, (const char *)buf, buflen, 0, scratch,
+    hs_error_t err = hs_scan(db->hs_db, (const char *)buf, buflen, 0, scratch,
                              SCHSMatchEvent, &cctx);
     if (err != HS_SUCCESS) {
         /* An error value (other than HS_SCAN_TERMINATED) from hs_scan()
@@ -1016,9 +961,9 @@ void SCHSPrintInfo(MpmCtx *mpm_ctx)
     printf("\n");
 
     if (ctx) {
-        PatternDatabase *pd = ctx->pattern_db;
+        const HSDatabase *db = ctx->pattern_db;
         char *db_info = NULL;
-        if (hs_database_info(pd->hs_db, &db_info) == HS_SUCCESS) {
+        if (db != NULL && hs_database_info(db->hs_db, &db_info) == HS_SUCCESS) {
             printf("HS Database Info: %s\n", db_info);
             SCFree(db_info);
         }
@@ -1069,13 +1014,7 @@ void MpmHSGlobalCleanup(void)
     }
     SCMutexUnlock(&g_scratch_proto_mutex);
 
-    SCMutexLock(&g_db_table_mutex);
-    if (g_db_table != NULL) {
-        SCLogPerf("Clearing Hyperscan database cache");
-        HashTableFree(g_db_table);
-        g_db_table = NULL;
-    }
-    SCMutexUnlock(&g_db_table_mutex);
+    HSDatabaseGlobalCleanup();
 }
 
 /*************************************Unittests********************************/
@@ -2130,6 +2069,113 @@ end:
     return result;
 }
 
+/** \test contexts with the same patterns, but with other pattern ids and
+ *        sids and added in another order, share the database and report
+ *        their own sids */
+static int SCHSTest30(void)
+{
+    MpmCtx mpm_ctx1, mpm_ctx2;
+    MpmThreadCtx mpm_thread_ctx;
+    PatternMatcherQueue pmq;
+
+    memset(&mpm_ctx1, 0, sizeof(MpmCtx));
+    memset(&mpm_ctx2, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    MpmInitCtx(&mpm_ctx1, MPM_HS);
+    MpmInitCtx(&mpm_ctx2, MPM_HS);
+
+    MpmAddPatternCS(&mpm_ctx1, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    MpmAddPatternCI(&mpm_ctx1, (uint8_t *)"xyz", 3, 0, 0, 1, 1, 0);
+    MpmAddPatternCS(&mpm_ctx2, (uint8_t *)"xyz", 3, 0, 0, 7, 8, MPM_PATTERN_FLAG_NOCASE);
+    MpmAddPatternCS(&mpm_ctx2, (uint8_t *)"abcd", 4, 0, 0, 5, 6, 0);
+    PmqSetup(&pmq);
+
+    FAIL_IF(SCHSPreparePatterns(&mpm_ctx1) != 0);
+    FAIL_IF(SCHSPreparePatterns(&mpm_ctx2) != 0);
+    SCHSCtx *ctx1 = (SCHSCtx *)mpm_ctx1.ctx;
+    SCHSCtx *ctx2 = (SCHSCtx *)mpm_ctx2.ctx;
+    FAIL_IF_NULL(ctx1->pattern_db);
+    FAIL_IF(ctx1->pattern_db != ctx2->pattern_db);
+    SCHSInitThreadCtx(&mpm_ctx1, &mpm_thread_ctx);
+
+    char *buf = "abcdXYZ";
+    uint32_t cnt = SCHSSearch(&mpm_ctx2, &mpm_thread_ctx, &pmq, (uint8_t *)buf,
+                              strlen(buf));
+    FAIL_IF(cnt != 2);
+    FAIL_IF(pmq.rule_id_array_cnt != 2);
+    FAIL_IF(!((pmq.rule_id_array[0] == 6 && pmq.rule_id_array[1] == 8) ||
+              (pmq.rule_id_array[0] == 8 && pmq.rule_id_array[1] == 6)));
+
+    /* the database stays usable for the other context */
+    SCHSDestroyCtx(&mpm_ctx1);
+    PmqReset(&pmq);
+    buf = "xyz";
+    cnt = SCHSSearch(&mpm_ctx2, &mpm_thread_ctx, &pmq, (uint8_t *)buf,
+                     strlen(buf));
+    FAIL_IF(cnt != 1);
+    FAIL_IF(pmq.rule_id_array_cnt != 1);
+    FAIL_IF(pmq.rule_id_array[0] != 8);
+
+    SCHSDestroyCtx(&mpm_ctx2);
+    SCHSDestroyThreadCtx(&mpm_ctx1, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    PASS;
+}
+
+#ifdef HAVE_SYS_MMAN_H
+/** \test store a database in the on disk cache and load it for the same
+ *        patterns only */
+static int SCHSTest31(void)
+{
+    MpmCtx mpm_ctx1, mpm_ctx2;
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+
+    snprintf(dir, sizeof(dir), "%s/suricata-hs-cache-XXXXXX",
+             ConfigGetLogDirectory());
+    FAIL_IF_NULL(mkdtemp(dir));
+
+    memset(&mpm_ctx1, 0, sizeof(MpmCtx));
+    memset(&mpm_ctx2, 0, sizeof(MpmCtx));
+    MpmInitCtx(&mpm_ctx1, MPM_HS);
+    MpmInitCtx(&mpm_ctx2, MPM_HS);
+    MpmAddPatternCS(&mpm_ctx1, (uint8_t *)"cache", 5, 0, 0, 0, 0, 0);
+    MpmAddPatternCI(&mpm_ctx1, (uint8_t *)"test31", 6, 0, 4, 1, 1, 0);
+    MpmAddPatternCS(&mpm_ctx2, (uint8_t *)"cache", 5, 0, 0, 0, 0, 0);
+    FAIL_IF(SCHSPreparePatterns(&mpm_ctx1) != 0);
+    FAIL_IF(SCHSPreparePatterns(&mpm_ctx2) != 0);
+    SCHSCtx *ctx1 = (SCHSCtx *)mpm_ctx1.ctx;
+    SCHSCtx *ctx2 = (SCHSCtx *)mpm_ctx2.ctx;
+    HSDatabase *db1 = ctx1->pattern_db;
+    FAIL_IF_NULL(db1);
+
+    FAIL_IF(HSCacheSave(dir, db1->key, db1->key_len, db1->hs_db) != 0);
+
+    uint32_t key_len = 0;
+    uint8_t *key = SCHSDatabaseKey(ctx1->parray, mpm_ctx1.pattern_cnt, &key_len);
+    FAIL_IF_NULL(key);
+    hs_database_t *hs_db = NULL;
+    FAIL_IF(HSCacheLoad(dir, key, key_len, &hs_db) != 0);
+    FAIL_IF_NULL(hs_db);
+    hs_free_database(hs_db);
+    FAIL_IF(HSCachePath(dir, key, key_len, path, sizeof(path)) != 0);
+    SCFree(key);
+
+    key = SCHSDatabaseKey(ctx2->parray, mpm_ctx2.pattern_cnt, &key_len);
+    FAIL_IF_NULL(key);
+    hs_db = NULL;
+    FAIL_IF(HSCacheLoad(dir, key, key_len, &hs_db) == 0);
+    SCFree(key);
+
+    FAIL_IF(unlink(path) != 0);
+    FAIL_IF(rmdir(dir) != 0);
+
+    SCHSDestroyCtx(&mpm_ctx1);
+    SCHSDestroyCtx(&mpm_ctx2);
+    PASS;
+}
+#endif /* HAVE_SYS_MMAN_H */
+
 #endif /* UNITTESTS */
 
 void SCHSRegisterTests(void)
@@ -2164,6 +2210,10 @@ void SCHSRegisterTests(void)
     UtRegisterTest("SCHSTest27", SCHSTest27);
     UtRegisterTest("SCHSTest28", SCHSTest28);
     UtRegisterTest("SCHSTest29", SCHSTest29);
+    UtRegisterTest("SCHSTest30", SCHSTest30);
+#ifdef HAVE_SYS_MMAN_H
+    UtRegisterTest("SCHSTest31", SCHSTest31);
+#endif
 #endif
 
     return;
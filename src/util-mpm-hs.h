@@ -53,9 +53,13 @@ typedef struct SCHSCtx_ {
     /* hash used during ctx initialization */
     SCHSPattern **init_hash;
 
-    /* pattern database and pattern arrays. */
+    /* pattern database, shared with other contexts with the same patterns */
     void *pattern_db;
 
+    /* patterns in database order, with the pattern ids and sids of this
+     * context. */
+    SCHSPattern **parray;
+
     /* size of database, for accounting. */
     size_t hs_db_size;
 } SCHSCtx;
@@ -0,0 +1,922 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Teddy multi pattern matcher.
+ *
+ * The patterns are spread over 8 buckets. For each of the first fp_len
+ * (up to 3) pattern bytes two 16 byte tables are built, indexed by the low
+ * and the high nibble of a byte, holding the bit of every bucket that has
+ * a pattern with such a nibble at that position. With SSSE3 (or AVX2) a
+ * block of 16 (or 32) buffer offsets is filtered with a few pshufb and and
+ * instructions; the buckets left over for an offset are then verified
+ * against the actual patterns. Without SSSE3, and for the buffer tail, an
+ * exact per byte table is used instead.
+ *
+ * All tables fit in a few cache lines, so this is a lot faster than the
+ * Aho-Corasick state table on the small contexts of the per rule group
+ * mpms. The filter gets less selective as the number of patterns grows,
+ * so contexts with more than teddy.max-patterns patterns are handed to
+ * the "ac" mpm instead.
+ *
+ * Like the ac mpms, offset and depth of the patterns are not used.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+
+#include "detect.h"
+#include "detect-parse.h"
+#include "detect-engine.h"
+
+#include "conf.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+#include "util-memcmp.h"
+#include "util-mpm-teddy.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+void SCTeddyInitCtx(MpmCtx *);
+void SCTeddyInitThreadCtx(MpmCtx *, MpmThreadCtx *);
+void SCTeddyDestroyCtx(MpmCtx *);
+void SCTeddyDestroyThreadCtx(MpmCtx *, MpmThreadCtx *);
+int SCTeddyAddPatternCI(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
+                        uint32_t, SigIntId, uint8_t);
+int SCTeddyAddPatternCS(MpmCtx *, uint8_t *, uint16_t, uint16_t, uint16_t,
+                        uint32_t, SigIntId, uint8_t);
+int SCTeddyPreparePatterns(MpmCtx *mpm_ctx);
+uint32_t SCTeddySearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                       PatternMatcherQueue *pmq, const uint8_t *buf, uint32_t buflen);
+void SCTeddyPrintInfo(MpmCtx *mpm_ctx);
+void SCTeddyPrintSearchStats(MpmThreadCtx *mpm_thread_ctx);
+void SCTeddyRegisterTests(void);
+
+/** the mpm used for contexts with too many patterns */
+#define TEDDY_FALLBACK_MPM  MPM_AC
+
+static uint32_t SCTeddyGetMaxPatterns(void)
+{
+    intmax_t value = 0;
+    if (ConfGetInt("teddy.max-patterns", &value) == 1 && value >= 0 &&
+            value <= UINT32_MAX) {
+        return (uint32_t)value;
+    }
+    return TEDDY_DEFAULT_MAX_PATTERNS;
+}
+
+/**
+ * \internal
+ * \brief Move the memory accounting of the fallback ctx to our mpm ctx.
+ */
+static void SCTeddyFallbackAccount(MpmCtx *mpm_ctx, MpmCtx *fb)
+{
+    mpm_ctx->memory_cnt += fb->memory_cnt;
+    mpm_ctx->memory_size += fb->memory_size;
+    fb->memory_cnt = 0;
+    fb->memory_size = 0;
+}
+
+/**
+ * \internal
+ * \brief Hand the patterns of the ctx to an ac ctx and prepare that.
+ */
+static int SCTeddyPrepareFallback(MpmCtx *mpm_ctx)
+{
+    SCTeddyCtx *ctx = (SCTeddyCtx *)mpm_ctx->ctx;
+
+    MpmCtx *fb = SCMalloc(sizeof(MpmCtx));
+    if (unlikely(fb == NULL))
+        return -1;
+    memset(fb, 0, sizeof(MpmCtx));
+    MpmInitCtx(fb, TEDDY_FALLBACK_MPM);
+
+    /* use our pattern hash instead of the one the fallback ctx set up */
+    if (fb->init_hash != NULL)
+        SCFree(fb->init_hash);
+    fb->init_hash = mpm_ctx->init_hash;
+    mpm_ctx->init_hash = NULL;
+
+    fb->global = mpm_ctx->global;
+    fb->pattern_cnt = mpm_ctx->pattern_cnt;
+    fb->minlen = mpm_ctx->minlen;
+    fb->maxlen = mpm_ctx->maxlen;
+    fb->max_pat_id = mpm_ctx->max_pat_id;
+
+    int r = mpm_table[fb->mpm_type].Prepare(fb);
+    SCTeddyFallbackAccount(mpm_ctx, fb);
+    ctx->fallback = fb;
+    return r;
+}
+
+static int SCTeddyPatternCompare(const void *a, const void *b)
+{
+    const SCTeddyPattern *pa = (const SCTeddyPattern *)a;
+    const SCTeddyPattern *pb = (const SCTeddyPattern *)b;
+    uint16_t len = MIN(pa->len, pb->len);
+    uint16_t i;
+
+    for (i = 0; i < len; i++) {
+        int ca = u8_tolower(pa->pat[i]);
+        int cb = u8_tolower(pb->pat[i]);
+        if (ca != cb)
+            return ca - cb;
+    }
+    return (int)pa->len - (int)pb->len;
+}
+
+/**
+ * \internal
+ * \brief Set the bit of bucket in the masks of filter byte pos for c.
+ */
+static void SCTeddySetMask(SCTeddyCtx *ctx, uint16_t pos, uint8_t c, uint8_t bucket)
+{
+    ctx->lo_mask[pos][c & 0x0f] |= (1 << bucket);
+    ctx->hi_mask[pos][c >> 4] |= (1 << bucket);
+    ctx->byte_mask[pos][c] |= (1 << bucket);
+}
+
+/**
+ * \internal
+ * \brief Spread the patterns over the buckets and build the filter masks.
+ *
+ * The patterns are sorted first so that patterns sharing a prefix end up
+ * in the same bucket, which keeps the number of false bucket hits down.
+ */
+static void SCTeddyBuildMasks(MpmCtx *mpm_ctx)
+{
+    SCTeddyCtx *ctx = (SCTeddyCtx *)mpm_ctx->ctx;
+    uint32_t i;
+    uint16_t f;
+
+    ctx->fp_len = MIN(mpm_ctx->minlen, TEDDY_MAX_FP_LEN);
+    if (ctx->fp_len == 0)
+        ctx->fp_len = 1;
+
+    qsort(ctx->patterns, ctx->pattern_cnt, sizeof(SCTeddyPattern),
+            SCTeddyPatternCompare);
+
+    uint8_t b;
+    for (b = 0; b <= TEDDY_BUCKETS; b++) {
+        ctx->bucket_start[b] = (uint32_t)(((uint64_t)ctx->pattern_cnt * b) /
+                TEDDY_BUCKETS);
+    }
+
+    for (b = 0; b < TEDDY_BUCKETS; b++) {
+        for (i = ctx->bucket_start[b]; i < ctx->bucket_start[b + 1]; i++) {
+            const SCTeddyPattern *p = &ctx->patterns[i];
+            for (f = 0; f < ctx->fp_len; f++) {
+                uint8_t c = p->pat[f];
+                if (p->nocase) {
+                    SCTeddySetMask(ctx, f, u8_tolower(c), b);
+                    SCTeddySetMask(ctx, f, (uint8_t)toupper(c), b);
+                } else {
+                    SCTeddySetMask(ctx, f, c, b);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * \brief Process the patterns added to the mpm, and create the filter
+ *        masks, or the fallback ctx if there are too many patterns.
+ *
+ * \param mpm_ctx Pointer to the mpm context.
+ */
+int SCTeddyPreparePatterns(MpmCtx *mpm_ctx)
+{
+    SCTeddyCtx *ctx = (SCTeddyCtx *)mpm_ctx->ctx;
+
+    if (mpm_ctx->pattern_cnt == 0 || mpm_ctx->init_hash == NULL) {
+        SCLogDebug("no patterns supplied to this mpm_ctx");
+        return 0;
+    }
+
+    if (mpm_ctx->pattern_cnt > SCTeddyGetMaxPatterns()) {
+        SCLogDebug("%u patterns, using fallback mpm", mpm_ctx->pattern_cnt);
+        return SCTeddyPrepareFallback(mpm_ctx);
+    }
+
+    ctx->patterns = SCMalloc(mpm_ctx->pattern_cnt * sizeof(SCTeddyPattern));
+    if (ctx->patterns == NULL)
+        goto error;
+    memset(ctx->patterns, 0, mpm_ctx->pattern_cnt * sizeof(SCTeddyPattern));
+    mpm_ctx->memory_cnt++;
+    mpm_ctx->memory_size += (mpm_ctx->pattern_cnt * sizeof(SCTeddyPattern));
+
+    /* take the patterns out of the hash */
+    uint32_t i;
+    for (i = 0; i < MPM_INIT_HASH_SIZE; i++) {
+        MpmPattern *node = mpm_ctx->init_hash[i], *nnode = NULL;
+        while (node != NULL) {
+            nnode = node->next;
+
+            SCTeddyPattern *p = &ctx->patterns[ctx->pattern_cnt++];
+            p->pat = SCMalloc(node->len);
+            if (p->pat == NULL) {
+                SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
+                exit(EXIT_FAILURE);
+            }
+            p->nocase = (node->flags & MPM_PATTERN_FLAG_NOCASE) ? 1 : 0;
+            memcpy(p->pat, p->nocase ? node->ci : node->original_pat, node->len);
+            p->len = node->len;
+            p->id = node->id;
+            mpm_ctx->memory_cnt++;
+            mpm_ctx->memory_size += node->len;
+
+            /* the teddy pattern now owns the sids */
+            p->sids_size = node->sids_size;
+            p->sids = node->sids;
+            node->sids_size = 0;
+            node->sids = NULL;
+
+            MpmFreePattern(mpm_ctx, node);
+            node = nnode;
+        }
+    }
+
+    /* we no longer need the hash, so free it's memory */
+    SCFree(mpm_ctx->init_hash);
+    mpm_ctx->init_hash = NULL;
+
+    SCTeddyBuildMasks(mpm_ctx);
+
+    ctx->pattern_id_bitarray_size = (mpm_ctx->max_pat_id / 8) + 1;
+    SCLogDebug("%u patterns, filter length %u", ctx->pattern_cnt, ctx->fp_len);
+    return 0;
+
+error:
+    return -1;
+}
+
+/**
+ * \brief Init the mpm thread context. The teddy search itself doesn't use
+ *        the thread ctx, it is set up for the fallback mpm.
+ *
+ * \param mpm_ctx        Pointer to the mpm context.
+ * \param mpm_thread_ctx Pointer to the mpm thread context.
+ */
+void SCTeddyInitThreadCtx(MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx)
+{
+    mpm_table[TEDDY_FALLBACK_MPM].InitThreadCtx(mpm_ctx, mpm_thread_ctx);
+}
+
+/**
+ * \brief Initialize the teddy context.
+ *
+ * \param mpm_ctx       Mpm context.
+ */
+void SCTeddyInitCtx(MpmCtx *mpm_ctx)
+{
+    if (mpm_ctx->ctx != NULL)
+        return;
+
+    mpm_ctx->ctx = SCMalloc(sizeof(SCTeddyCtx));
+    if (mpm_ctx->ctx == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    memset(mpm_ctx->ctx, 0, sizeof(SCTeddyCtx));
+
+    mpm_ctx->memory_cnt++;
+    mpm_ctx->memory_size += sizeof(SCTeddyCtx);
+
+    /* initialize the hash we use to speed up pattern insertions */
+    mpm_ctx->init_hash = SCMalloc(sizeof(MpmPattern *) * MPM_INIT_HASH_SIZE);
+    if (mpm_ctx->init_hash == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    memset(mpm_ctx->init_hash, 0, sizeof(MpmPattern *) * MPM_INIT_HASH_SIZE);
+
+    SCReturn;
+}
+
+/**
+ * \brief Destroy the mpm thread context.
+ *
+ * \param mpm_ctx        Pointer to the mpm context.
+ * \param mpm_thread_ctx Pointer to the mpm thread context.
+ */
+void SCTeddyDestroyThreadCtx(MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx)
+{
+    mpm_table[TEDDY_FALLBACK_MPM].DestroyThreadCtx(mpm_ctx, mpm_thread_ctx);
+}
+
+/**
+ * \brief Destroy the mpm context.
+ *
+ * \param mpm_ctx Pointer to the mpm context.
+ */
+void SCTeddyDestroyCtx(MpmCtx *mpm_ctx)
+{
+    SCTeddyCtx *ctx = (SCTeddyCtx *)mpm_ctx->ctx;
+    if (ctx == NULL)
+        return;
+
+    if (mpm_ctx->init_hash != NULL) {
+        uint32_t i;
+        for (i = 0; i < MPM_INIT_HASH_SIZE; i++) {
+            MpmPattern *node = mpm_ctx->init_hash[i], *nnode = NULL;
+            while (node != NULL) {
+                nnode = node->next;
+                if (node->sids != NULL)
+                    SCFree(node->sids);
+                MpmFreePattern(mpm_ctx, node);
+                node = nnode;
+            }
+        }
+        SCFree(mpm_ctx->init_hash);
+        mpm_ctx->init_hash = NULL;
+    }
+
+    if (ctx->fallback != NULL) {
+        mpm_table[ctx->fallback->mpm_type].DestroyCtx(ctx->fallback);
+        SCTeddyFallbackAccount(mpm_ctx, ctx->fallback);
+        SCFree(ctx->fallback);
+        ctx->fallback = NULL;
+    }
+
+    if (ctx->patterns != NULL) {
+        uint32_t i;
+        for (i = 0; i < ctx->pattern_cnt; i++) {
+            SCFree(ctx->patterns[i].pat);
+            mpm_ctx->memory_cnt--;
+            mpm_ctx->memory_size -= ctx->patterns[i].len;
+            if (ctx->patterns[i].sids != NULL)
+                SCFree(ctx->patterns[i].sids);
+        }
+        SCFree(ctx->patterns);
+        ctx->patterns = NULL;
+        mpm_ctx->memory_cnt--;
+        mpm_ctx->memory_size -= (mpm_ctx->pattern_cnt * sizeof(SCTeddyPattern));
+    }
+
+    SCFree(mpm_ctx->ctx);
+    mpm_ctx->ctx = NULL;
+    mpm_ctx->memory_cnt--;
+    mpm_ctx->memory_size -= sizeof(SCTeddyCtx);
+}
+
+/**
+ * \internal
+ * \brief Verify the patterns of the buckets in bmask at offset pos.
+ *
+ * \retval matches number of patterns matching at pos
+ */
+static inline uint32_t SCTeddyVerify(const SCTeddyCtx *ctx,
+        PatternMatcherQueue *pmq, const uint8_t *buf, uint32_t buflen,
+        uint32_t pos, uint32_t bmask, uint8_t *bitarray)
+{
+    const uint8_t *p = buf + pos;
+    const uint32_t left = buflen - pos;
+    uint32_t matches = 0;
+
+    while (bmask) {
+        const uint32_t b = __builtin_ctz(bmask);
+        bmask &= bmask - 1;
+
+        uint32_t k;
+        for (k = ctx->bucket_start[b]; k < ctx->bucket_start[b + 1]; k++) {
+            const SCTeddyPattern *pat = &ctx->patterns[k];
+            if (pat->len > left)
+                continue;
+            if (pat->nocase) {
+                if (SCMemcmpLowercase(pat->pat, p, pat->len) != 0)
+                    continue;
+            } else {
+                if (SCMemcmp(pat->pat, p, pat->len) != 0)
+                    continue;
+            }
+
+            if (!(bitarray[pat->id / 8] & (1 << (pat->id % 8)))) {
+                bitarray[pat->id / 8] |= (1 << (pat->id % 8));
+                MpmAddSids(pmq, pat->sids, pat->sids_size);
+            }
+            matches++;
+        }
+    }
+    return matches;
+}
+
+#if defined(__AVX2__)
+/**
+ * \internal
+ * \brief Run the filter over 32 offsets at a time.
+ *
+ * \param pos set to the first offset that has not been looked at
+ */
+static uint32_t SCTeddySearchBlocks(const SCTeddyCtx *ctx,
+        PatternMatcherQueue *pmq, const uint8_t *buf, uint32_t buflen,
+        uint8_t *bitarray, uint32_t *pos)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo[TEDDY_MAX_FP_LEN], hi[TEDDY_MAX_FP_LEN];
+    const uint32_t fp_len = ctx->fp_len;
+    uint32_t matches = 0;
+    uint32_t i, f;
+
+    /* pshufb works per 128 bit lane, so use the tables in both */
+    for (f = 0; f < fp_len; f++) {
+        lo[f] = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128((const __m128i *)ctx->lo_mask[f]));
+        hi[f] = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128((const __m128i *)ctx->hi_mask[f]));
+    }
+
+    /* the filter of the last offset of a block reads fp_len - 1 bytes
+     * past the block */
+    for (i = 0; i + 32 + fp_len - 1 <= buflen; i += 32) {
+        __m256i res = _mm256_set1_epi8((char)0xff);
+        for (f = 0; f < fp_len; f++) {
+            const __m256i v = _mm256_loadu_si256((const __m256i *)(buf + i + f));
+            const __m256i l = _mm256_and_si256(v, nibble);
+            const __m256i h = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+            res = _mm256_and_si256(res,
+                    _mm256_and_si256(_mm256_shuffle_epi8(lo[f], l),
+                                     _mm256_shuffle_epi8(hi[f], h)));
+        }
+
+        uint32_t hits = ~(uint32_t)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(res, zero));
+        if (hits == 0)
+            continue;
+
+        uint8_t r[32];
+        _mm256_storeu_si256((__m256i *)r, res);
+        while (hits) {
+            const uint32_t j = __builtin_ctz(hits);
+            hits &= hits - 1;
+            matches += SCTeddyVerify(ctx, pmq, buf, buflen, i + j, r[j], bitarray);
+        }
+    }
+
+    *pos = i;
+    return matches;
+}
+#elif defined(__SSSE3__)
+/**
+ * \internal
+ * \brief Run the filter over 16 offsets at a time.
+ *
+ * \param pos set to the first offset that has not been looked at
+ */
+static uint32_t SCTeddySearchBlocks(const SCTeddyCtx *ctx,
+        PatternMatcherQueue *pmq, const uint8_t *buf, uint32_t buflen,
+        uint8_t *bitarray, uint32_t *pos)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo[TEDDY_MAX_FP_LEN], hi[TEDDY_MAX_FP_LEN];
+    const uint32_t fp_len = ctx->fp_len;
+    uint32_t matches = 0;
+    uint32_t i, f;
+
+    for (f = 0; f < fp_len; f++) {
+        lo[f] = _mm_loadu_si128((const __m128i *)ctx->lo_mask[f]);
+        hi[f] = _mm_loadu_si128((const __m128i *)ctx->hi_mask[f]);
+    }
+
+    /* the filter of the last offset of a block reads fp_len - 1 bytes
+     * past the block */
+    for (i = 0; i + 16 + fp_len - 1 <= buflen; i += 16) {
+        __m128i res = _mm_set1_epi8((char)0xff);
+        for (f = 0; f < fp_len; f++) {
+            const __m128i v = _mm_loadu_si128((const __m128i *)(buf + i + f));
+            const __m128i l = _mm_and_si128(v, nibble);
+            const __m128i h = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+            res = _mm_and_si128(res,
+                    _mm_and_si128(_mm_shuffle_epi8(lo[f], l),
+                                  _mm_shuffle_epi8(hi[f], h)));
+        }
+
+        uint32_t hits = ~(uint32_t)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(res, zero)) & 0xffff;
+        if (hits == 0)
+            continue;
+
+        uint8_t r[16];
+        _mm_storeu_si128((__m128i *)r, res);
+        while (hits) {
+            const uint32_t j = __builtin_ctz(hits);
+            hits &= hits - 1;
+            matches += SCTeddyVerify(ctx, pmq, buf, buflen, i + j, r[j], bitarray);
+        }
+    }
+
+    *pos = i;
+    return matches;
+}
+#endif
+
+/**
+ * \brief The teddy search function.
+ *
+ * \param mpm_ctx        Pointer to the mpm context.
+ * \param mpm_thread_ctx Pointer to the mpm thread context.
+ * \param pmq            Pointer to the Pattern Matcher Queue to hold
+ *                       search matches.
+ * \param buf            Buffer to be searched.
+ * \param buflen         Buffer length.
+ *
+ * \retval matches Match count.
+ */
+uint32_t SCTeddySearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                       PatternMatcherQueue *pmq, const uint8_t *buf, uint32_t buflen)
+{
+    const SCTeddyCtx *ctx = (SCTeddyCtx *)mpm_ctx->ctx;
+
+    if (ctx->fallback != NULL) {
+        return mpm_table[ctx->fallback->mpm_type].Search(ctx->fallback,
+                mpm_thread_ctx, pmq, buf, buflen);
+    }
+    if (ctx->pattern_cnt == 0 || buflen < ctx->fp_len)
+        return 0;
+
+    uint8_t bitarray[ctx->pattern_id_bitarray_size];
+    memset(bitarray, 0, ctx->pattern_id_bitarray_size);
+
+    const uint32_t fp_len = ctx->fp_len;
+    uint32_t matches = 0;
+    uint32_t i = 0;
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+    matches += SCTeddySearchBlocks(ctx, pmq, buf, buflen, bitarray, &i);
+#endif
+
+    /* offsets not covered by a full block */
+    for ( ; i + fp_len <= buflen; i++) {
+        uint32_t bmask = ctx->byte_mask[0][buf[i]];
+        uint32_t f;
+        for (f = 1; f < fp_len && bmask; f++)
+            bmask &= ctx->byte_mask[f][buf[i + f]];
+        if (bmask)
+            matches += SCTeddyVerify(ctx, pmq, buf, buflen, i, bmask, bitarray);
+    }
+
+    return matches;
+}
+
+/**
+ * \brief Add a case insensitive pattern.
+ *
+ * \param mpm_ctx Pointer to the mpm context.
+ * \param pat     The pattern to add.
+ * \param patnen  The pattern length.
+ * \param offset  Ignored.
+ * \param depth   Ignored.
+ * \param pid     The pattern id.
+ * \param sid     Ignored.
+ * \param flags   Flags associated with this pattern.
+ *
+ * \retval  0 On success.
+ * \retval -1 On failure.
+ */
+int SCTeddyAddPatternCI(MpmCtx *mpm_ctx, uint8_t *pat, uint16_t patlen,
+                        uint16_t offset, uint16_t depth, uint32_t pid,
+                        SigIntId sid, uint8_t flags)
+{
+    flags |= MPM_PATTERN_FLAG_NOCASE;
+    return MpmAddPattern(mpm_ctx, pat, patlen, offset, depth, pid, sid, flags);
+}
+
+/**
+ * \brief Add a case sensitive pattern.
+ *
+ * \param mpm_ctx Pointer to the mpm context.
+ * \param pat     The pattern to add.
+ * \param patnen  The pattern length.
+ * \param offset  Ignored.
+ * \param depth   Ignored.
+ * \param pid     The pattern id.
+ * \param sid     Ignored.
+ * \param flags   Flags associated with this pattern.
+ *
+ * \retval  0 On success.
+ * \retval -1 On failure.
+ */
+int SCTeddyAddPatternCS(MpmCtx *mpm_ctx, uint8_t *pat, uint16_t patlen,
+                        uint16_t offset, uint16_t depth, uint32_t pid,
+                        SigIntId sid, uint8_t flags)
+{
+    return MpmAddPattern(mpm_ctx, pat, patlen, offset, depth, pid, sid, flags);
+}
+
+void SCTeddyPrintSearchStats(MpmThreadCtx *mpm_thread_ctx)
+{
+    return;
+}
+
+void SCTeddyPrintInfo(MpmCtx *mpm_ctx)
+{
+    SCTeddyCtx *ctx = (SCTeddyCtx *)mpm_ctx->ctx;
+
+    printf("MPM Teddy Information:\n");
+    printf("Memory allocs:   %" PRIu32 "\n", mpm_ctx->memory_cnt);
+    printf("Memory alloced:  %" PRIu32 "\n", mpm_ctx->memory_size);
+    printf(" Sizeof:\n");
+    printf("  MpmCtx         %" PRIuMAX "\n", (uintmax_t)sizeof(MpmCtx));
+    printf("  SCTeddyCtx:    %" PRIuMAX "\n", (uintmax_t)sizeof(SCTeddyCtx));
+    printf("  SCTeddyPattern %" PRIuMAX "\n", (uintmax_t)sizeof(SCTeddyPattern));
+    printf("Unique Patterns: %" PRIu32 "\n", mpm_ctx->pattern_cnt);
+    printf("Smallest:        %" PRIu32 "\n", mpm_ctx->minlen);
+    printf("Largest:         %" PRIu32 "\n", mpm_ctx->maxlen);
+    if (ctx->fallback != NULL) {
+        printf("Fallback mpm:    %s\n", mpm_table[ctx->fallback->mpm_type].name);
+    } else {
+        printf("Filter length:   %" PRIu32 "\n", ctx->fp_len);
+    }
+    printf("\n");
+
+    return;
+}
+
+/************************** Mpm Registration ***************************/
+
+/**
+ * \brief Register the teddy mpm.
+ */
+void MpmTeddyRegister(void)
+{
+    mpm_table[MPM_TEDDY].name = "teddy";
+    mpm_table[MPM_TEDDY].InitCtx = SCTeddyInitCtx;
+    mpm_table[MPM_TEDDY].InitThreadCtx = SCTeddyInitThreadCtx;
+    mpm_table[MPM_TEDDY].DestroyCtx = SCTeddyDestroyCtx;
+    mpm_table[MPM_TEDDY].DestroyThreadCtx = SCTeddyDestroyThreadCtx;
+    mpm_table[MPM_TEDDY].AddPattern = SCTeddyAddPatternCS;
+    mpm_table[MPM_TEDDY].AddPatternNocase = SCTeddyAddPatternCI;
+    mpm_table[MPM_TEDDY].Prepare = SCTeddyPreparePatterns;
+    mpm_table[MPM_TEDDY].Search = SCTeddySearch;
+    mpm_table[MPM_TEDDY].Cleanup = NULL;
+    mpm_table[MPM_TEDDY].PrintCtx = SCTeddyPrintInfo;
+    mpm_table[MPM_TEDDY].PrintThreadCtx = SCTeddyPrintSearchStats;
+    mpm_table[MPM_TEDDY].RegisterUnittests = SCTeddyRegisterTests;
+
+    return;
+}
+
+/*************************************Unittests********************************/
+
+#ifdef UNITTESTS
+
+static int SCTeddyTest01(void)
+{
+    MpmCtx mpm_ctx;
+    MpmThreadCtx mpm_thread_ctx;
+    PatternMatcherQueue pmq;
+
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    MpmInitCtx(&mpm_ctx, MPM_TEDDY);
+    SCTeddyInitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+
+    /* 1 match */
+    MpmAddPatternCS(&mpm_ctx, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+    PmqSetup(&pmq);
+
+    FAIL_IF(SCTeddyPreparePatterns(&mpm_ctx) != 0);
+
+    const char *buf = "abcdefghjiklmnopqrstuvwxyz";
+    uint32_t cnt = SCTeddySearch(&mpm_ctx, &mpm_thread_ctx, &pmq,
+                                 (uint8_t *)buf, strlen(buf));
+    FAIL_IF(cnt != 1);
+
+    SCTeddyDestroyCtx(&mpm_ctx);
+    SCTeddyDestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    PASS;
+}
+
+/** \test case sensitive and insensitive patterns, at the start and the end
+ *        of buffers shorter and longer than a simd block */
+static int SCTeddyTest02(void)
+{
+    MpmCtx mpm_ctx;
+    MpmThreadCtx mpm_thread_ctx;
+    PatternMatcherQueue pmq;
+
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    MpmInitCtx(&mpm_ctx, MPM_TEDDY);
+    SCTeddyInitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+
+    MpmAddPatternCS(&mpm_ctx, (uint8_t *)"Abcd", 4, 0, 0, 0, 0, 0);
+    MpmAddPatternCI(&mpm_ctx, (uint8_t *)"wxYZ", 4, 0, 0, 1, 1, 0);
+    MpmAddPatternCS(&mpm_ctx, (uint8_t *)"xyz", 3, 0, 0, 2, 2, 0);
+    PmqSetup(&pmq);
+
+    FAIL_IF(SCTeddyPreparePatterns(&mpm_ctx) != 0);
+
+    const char *buf = "Abcdefghjiklmnopqrstuvwxyz";
+    uint32_t cnt = SCTeddySearch(&mpm_ctx, &mpm_thread_ctx, &pmq,
+                                 (uint8_t *)buf, strlen(buf));
+    FAIL_IF(cnt != 3);
+    FAIL_IF(pmq.rule_id_array_cnt != 3);
+    PmqReset(&pmq);
+
+    /* case sensitive pattern must not match */
+    buf = "abcdWXYZ";
+    cnt = SCTeddySearch(&mpm_ctx, &mpm_thread_ctx, &pmq,
+                        (uint8_t *)buf, strlen(buf));
+    FAIL_IF(cnt != 1);
+    FAIL_IF(pmq.rule_id_array_cnt != 1);
+    FAIL_IF(pmq.rule_id_array[0] != 1);
+    PmqReset(&pmq);
+
+    /* too short for any pattern */
+    buf = "xy";
+    cnt = SCTeddySearch(&mpm_ctx, &mpm_thread_ctx, &pmq,
+                        (uint8_t *)buf, strlen(buf));
+    FAIL_IF(cnt != 0);
+
+    SCTeddyDestroyCtx(&mpm_ctx);
+    SCTeddyDestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    PASS;
+}
+
+/** \test one byte patterns and repeated matches */
+static int SCTeddyTest03(void)
+{
+    MpmCtx mpm_ctx;
+    MpmThreadCtx mpm_thread_ctx;
+    PatternMatcherQueue pmq;
+
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    MpmInitCtx(&mpm_ctx, MPM_TEDDY);
+    SCTeddyInitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+
+    MpmAddPatternCS(&mpm_ctx, (uint8_t *)"A", 1, 0, 0, 0, 0, 0);
+    MpmAddPatternCS(&mpm_ctx, (uint8_t *)"AAAA", 4, 0, 0, 1, 1, 0);
+    PmqSetup(&pmq);
+
+    FAIL_IF(SCTeddyPreparePatterns(&mpm_ctx) != 0);
+
+    uint8_t buf[40];
+    memset(buf, 'A', sizeof(buf));
+    uint32_t cnt = SCTeddySearch(&mpm_ctx, &mpm_thread_ctx, &pmq,
+                                 buf, sizeof(buf));
+    FAIL_IF(cnt != 40 + 37);
+    FAIL_IF(pmq.rule_id_array_cnt != 2);
+
+    SCTeddyDestroyCtx(&mpm_ctx);
+    SCTeddyDestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    PASS;
+}
+
+static uint32_t SCTeddyTestRand(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return (*state >> 16) & 0x7fff;
+}
+
+static int SCTeddyTestCompare(PatternMatcherQueue *a, PatternMatcherQueue *b)
+{
+    uint32_t i, j;
+
+    if (a->rule_id_array_cnt != b->rule_id_array_cnt)
+        return 0;
+    for (i = 0; i < a->rule_id_array_cnt; i++) {
+        for (j = 0; j < b->rule_id_array_cnt; j++) {
+            if (a->rule_id_array[i] == b->rule_id_array[j])
+                break;
+        }
+        if (j == b->rule_id_array_cnt)
+            return 0;
+    }
+    return 1;
+}
+
+/** \test compare against ac on random patterns over a small alphabet, with
+ *        a pattern count below and above the fallback limit */
+static int SCTeddyTest04(void)
+{
+    uint32_t seed = 1;
+    uint32_t pattern_cnts[] = { 5, 40, TEDDY_DEFAULT_MAX_PATTERNS + 10 };
+    uint32_t t;
+
+    for (t = 0; t < sizeof(pattern_cnts) / sizeof(pattern_cnts[0]); t++) {
+        MpmCtx teddy_ctx, ac_ctx;
+        MpmThreadCtx teddy_thread_ctx, ac_thread_ctx;
+        PatternMatcherQueue teddy_pmq, ac_pmq;
+
+        memset(&teddy_ctx, 0, sizeof(MpmCtx));
+        memset(&ac_ctx, 0, sizeof(MpmCtx));
+        memset(&teddy_thread_ctx, 0, sizeof(MpmThreadCtx));
+        memset(&ac_thread_ctx, 0, sizeof(MpmThreadCtx));
+        MpmInitCtx(&teddy_ctx, MPM_TEDDY);
+        MpmInitCtx(&ac_ctx, MPM_AC);
+        MpmInitThreadCtx(&teddy_thread_ctx, MPM_TEDDY);
+        MpmInitThreadCtx(&ac_thread_ctx, MPM_AC);
+        PmqSetup(&teddy_pmq);
+        PmqSetup(&ac_pmq);
+
+        uint32_t i, j;
+        for (i = 0; i < pattern_cnts[t]; i++) {
+            uint8_t pat[8];
+            uint16_t len = 1 + SCTeddyTestRand(&seed) % sizeof(pat);
+            for (j = 0; j < len; j++)
+                pat[j] = "abcABC"[SCTeddyTestRand(&seed) % 6];
+            if (SCTeddyTestRand(&seed) % 2) {
+                MpmAddPatternCI(&teddy_ctx, pat, len, 0, 0, i, i, 0);
+                MpmAddPatternCI(&ac_ctx, pat, len, 0, 0, i, i, 0);
+            } else {
+                MpmAddPatternCS(&teddy_ctx, pat, len, 0, 0, i, i, 0);
+                MpmAddPatternCS(&ac_ctx, pat, len, 0, 0, i, i, 0);
+            }
+        }
+        FAIL_IF(mpm_table[MPM_TEDDY].Prepare(&teddy_ctx) != 0);
+        FAIL_IF(mpm_table[MPM_AC].Prepare(&ac_ctx) != 0);
+        SCTeddyCtx *ctx = (SCTeddyCtx *)teddy_ctx.ctx;
+        FAIL_IF((ctx->fallback != NULL) !=
+                (pattern_cnts[t] > TEDDY_DEFAULT_MAX_PATTERNS));
+
+        for (i = 0; i < 100; i++) {
+            uint8_t buf[100];
+            uint16_t buflen = SCTeddyTestRand(&seed) % sizeof(buf);
+            for (j = 0; j < buflen; j++)
+                buf[j] = "abcABCx"[SCTeddyTestRand(&seed) % 7];
+
+            uint32_t teddy_cnt = mpm_table[MPM_TEDDY].Search(&teddy_ctx,
+                    &teddy_thread_ctx, &teddy_pmq, buf, buflen);
+            uint32_t ac_cnt = mpm_table[MPM_AC].Search(&ac_ctx,
+                    &ac_thread_ctx, &ac_pmq, buf, buflen);
+            FAIL_IF(teddy_cnt != ac_cnt);
+            FAIL_IF(!SCTeddyTestCompare(&teddy_pmq, &ac_pmq));
+            PmqReset(&teddy_pmq);
+            PmqReset(&ac_pmq);
+        }
+
+        mpm_table[MPM_TEDDY].DestroyCtx(&teddy_ctx);
+        mpm_table[MPM_AC].DestroyCtx(&ac_ctx);
+        mpm_table[MPM_TEDDY].DestroyThreadCtx(&teddy_ctx, &teddy_thread_ctx);
+        mpm_table[MPM_AC].DestroyThreadCtx(&ac_ctx, &ac_thread_ctx);
+        PmqFree(&teddy_pmq);
+        PmqFree(&ac_pmq);
+    }
+    PASS;
+}
+
+/** \test no patterns */
+static int SCTeddyTest05(void)
+{
+    MpmCtx mpm_ctx;
+    MpmThreadCtx mpm_thread_ctx;
+    PatternMatcherQueue pmq;
+
+    memset(&mpm_ctx, 0, sizeof(MpmCtx));
+    memset(&mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
+    MpmInitCtx(&mpm_ctx, MPM_TEDDY);
+    SCTeddyInitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    PmqSetup(&pmq);
+
+    FAIL_IF(SCTeddyPreparePatterns(&mpm_ctx) != 0);
+
+    const char *buf = "abcdefghjiklmnopqrstuvwxyz";
+    uint32_t cnt = SCTeddySearch(&mpm_ctx, &mpm_thread_ctx, &pmq,
+                                 (uint8_t *)buf, strlen(buf));
+    FAIL_IF(cnt != 0);
+
+    SCTeddyDestroyCtx(&mpm_ctx);
+    SCTeddyDestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    PmqFree(&pmq);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void SCTeddyRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SCTeddyTest01", SCTeddyTest01);
+    UtRegisterTest("SCTeddyTest02", SCTeddyTest02);
+    UtRegisterTest("SCTeddyTest03", SCTeddyTest03);
+    UtRegisterTest("SCTeddyTest04", SCTeddyTest04);
+    UtRegisterTest("SCTeddyTest05", SCTeddyTest05);
+#endif /* UNITTESTS */
+
+    return;
+}
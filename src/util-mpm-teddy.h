@@ -0,0 +1,74 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Teddy multi pattern matcher: a SIMD nibble mask filter on the first
+ * bytes of the patterns, followed by exact verification.
+ */
+
+#ifndef __UTIL_MPM_TEDDY__H__
+#define __UTIL_MPM_TEDDY__H__
+
+/** number of pattern buckets, one bit of the masks each */
+#define TEDDY_BUCKETS           8
+/** max number of leading pattern bytes used by the filter */
+#define TEDDY_MAX_FP_LEN        3
+/** default max number of patterns before falling back to ac */
+#define TEDDY_DEFAULT_MAX_PATTERNS  64
+
+typedef struct SCTeddyPattern_ {
+    /* pattern, lowercased if nocase */
+    uint8_t *pat;
+    uint16_t len;
+    uint8_t nocase;
+    /* pattern id */
+    uint32_t id;
+
+    /* sid(s) for this pattern */
+    uint32_t sids_size;
+    SigIntId *sids;
+} SCTeddyPattern;
+
+typedef struct SCTeddyCtx_ {
+    /* nibble masks per filter byte: bit b is set if a pattern of bucket b
+     * has a byte with this low/high nibble at that position */
+    uint8_t lo_mask[TEDDY_MAX_FP_LEN][16];
+    uint8_t hi_mask[TEDDY_MAX_FP_LEN][16];
+    /* exact bucket masks per filter byte, used for the buffer tail and
+     * when built without SSSE3 */
+    uint8_t byte_mask[TEDDY_MAX_FP_LEN][256];
+
+    /* number of leading bytes the filter looks at, 1 to TEDDY_MAX_FP_LEN */
+    uint16_t fp_len;
+
+    /* patterns ordered by bucket, bucket b uses
+     * patterns[bucket_start[b]] to patterns[bucket_start[b + 1] - 1] */
+    SCTeddyPattern *patterns;
+    uint32_t pattern_cnt;
+    uint32_t bucket_start[TEDDY_BUCKETS + 1];
+
+    uint32_t pattern_id_bitarray_size;
+
+    /* ac context used instead if the context has too many patterns */
+    MpmCtx *fallback;
+} SCTeddyCtx;
+
+void MpmTeddyRegister(void);
+
+#endif /* __UTIL_MPM_TEDDY__H__ */
@@ -31,6 +31,7 @@
 #include "util-mpm-ac.h"
 #include "util-mpm-ac-bs.h"
 #include "util-mpm-ac-tile.h"
+#include "util-mpm-teddy.h"
 #include "util-mpm-hs.h"
 #include "util-hashlist.h"
 
@@ -515,6 +516,7 @@ void MpmTableSetup(void)
     MpmACRegister();
     MpmACBSRegister();
     MpmACTileRegister();
+    MpmTeddyRegister();
 #ifdef BUILD_HYPERSCAN
     MpmHSRegister();
 #endif /* BUILD_HYPERSCAN */
@@ -527,6 +529,8 @@ int MpmAddPatternCS(struct MpmCtx_ *mpm_ctx, uint8_t *pat, uint16_t patlen,
                     uint16_t offset, uint16_t depth,
                     uint32_t pid, SigIntId sid, uint8_t flags)
 {
+    if (offset != 0 || depth != 0)
+        mpm_ctx->flags |= MPMCTX_FLAG_OFFSET_DEPTH;
     return mpm_table[mpm_ctx->mpm_type].AddPattern(mpm_ctx, pat, patlen,
                                                    offset, depth,
                                                    pid, sid, flags);
@@ -536,6 +540,8 @@ int MpmAddPatternCI(struct MpmCtx_ *mpm_ctx, uint8_t *pat, uint16_t patlen,
                     uint16_t offset, uint16_t depth,
                     uint32_t pid, SigIntId sid, uint8_t flags)
 {
+    if (offset != 0 || depth != 0)
+        mpm_ctx->flags |= MPMCTX_FLAG_OFFSET_DEPTH;
     return mpm_table[mpm_ctx->mpm_type].AddPatternNocase(mpm_ctx, pat, patlen,
                                                          offset, depth,
                                                          pid, sid, flags);
@@ -823,10 +829,333 @@ error:
     return -1;
 }
 
+/**
+ * \brief Search a buffer as the continuation of the buffers searched before
+ *        with the same state.
+ *
+ * Patterns spanning the previous buffer and this one are found as well.
+ * Backends with a SearchStream function carry their own state over. For the
+ * others the last maxlen - 1 bytes searched are kept and searched again
+ * together with the start of the new buffer, so the patterns completely in
+ * those bytes can be reported a second time.
+ *
+ * \param mpm_ctx        Pointer to the mpm context.
+ * \param mpm_thread_ctx Pointer to the mpm thread context.
+ * \param pmq            Pointer to the Pattern Matcher Queue to hold
+ *                       search matches.
+ * \param st             Stream state, zeroed or reset with
+ *                       MpmStreamStateReset() at the start of a stream.
+ * \param buf            Buffer to be searched.
+ * \param buflen         Buffer length.
+ *
+ * \retval matches Match count.
+ */
+uint32_t MpmStreamSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                         PatternMatcherQueue *pmq, MpmStreamState *st,
+                         const uint8_t *buf, uint32_t buflen)
+{
+    const MpmTableElmt *m = &mpm_table[mpm_ctx->mpm_type];
+    uint32_t ret = 0;
+
+    if (m->SearchStream != NULL) {
+        if (buflen == 0)
+            return 0;
+        return m->SearchStream(mpm_ctx, mpm_thread_ctx, pmq, st, buf, buflen);
+    }
+
+    const uint32_t keep = mpm_ctx->maxlen > 1 ? mpm_ctx->maxlen - 1 : 0;
+    if (keep > 0 && st->tail_size < 2 * keep) {
+        if (MpmStreamStateSetup(st, mpm_ctx) != 0) {
+            /* only the patterns spanning two buffers are missed */
+            st->tail_len = 0;
+        }
+    }
+    const int use_tail = (keep > 0 && st->tail_size >= 2 * keep);
+
+    if (use_tail && st->tail_len > keep) {
+        memmove(st->tail, st->tail + st->tail_len - keep, keep);
+        st->tail_len = keep;
+    }
+
+    /* patterns spanning the previous buffers and this one */
+    if (use_tail && st->tail_len > 0 && buflen > 0) {
+        const uint32_t head = MIN(buflen, keep);
+        memcpy(st->tail + st->tail_len, buf, head);
+        if (st->tail_len + head >= mpm_ctx->minlen) {
+            ret += m->Search(mpm_ctx, mpm_thread_ctx, pmq,
+                             st->tail, st->tail_len + head);
+        }
+    }
+
+    if (buflen > 0 && buflen >= mpm_ctx->minlen) {
+        ret += m->Search(mpm_ctx, mpm_thread_ctx, pmq, buf, buflen);
+    }
+
+    if (use_tail)
+        MpmStreamStateKeepTail(st, mpm_ctx, buf, buflen);
+
+    return ret;
+}
+
+/**
+ * \brief Get the size of the tail buffer a stream state needs to search
+ *        the parts of a stream with this mpm ctx.
+ *
+ * \retval size in bytes, 0 if no tail is needed
+ */
+uint32_t MpmStreamStateSize(const MpmCtx *mpm_ctx)
+{
+    const uint32_t keep = mpm_ctx->maxlen > 1 ? mpm_ctx->maxlen - 1 : 0;
+    if (mpm_table[mpm_ctx->mpm_type].SearchStream != NULL)
+        return keep;
+    return 2 * keep;
+}
+
+/**
+ * \brief Size the tail buffer of a stream state for an mpm ctx.
+ *
+ * Backends without SearchStream search each part of the stream on its own,
+ * so the offset and depth of the patterns would apply to every part instead
+ * of to the stream. Ctxs with such patterns can't be searched as a stream.
+ *
+ * \retval 0 ok, -1 the ctx can't be searched as a stream or alloc failed
+ */
+int MpmStreamStateSetup(MpmStreamState *st, const MpmCtx *mpm_ctx)
+{
+    if (mpm_table[mpm_ctx->mpm_type].SearchStream == NULL &&
+        (mpm_ctx->flags & MPMCTX_FLAG_OFFSET_DEPTH))
+        return -1;
+
+    const uint32_t size = MpmStreamStateSize(mpm_ctx);
+    if (st->tail_size < size) {
+        uint8_t *tail = SCRealloc(st->tail, size);
+        if (tail == NULL)
+            return -1;
+        st->tail = tail;
+        st->tail_size = size;
+    }
+    return 0;
+}
+
+/**
+ * \brief Keep the last maxlen - 1 bytes of the stream searched so far in
+ *        the tail of the stream state, after searching buf.
+ *
+ * If the tail can't be sized the kept bytes are dropped, see
+ * MpmStreamStateSetup().
+ */
+void MpmStreamStateKeepTail(MpmStreamState *st, const MpmCtx *mpm_ctx,
+                            const uint8_t *buf, uint32_t buflen)
+{
+    const uint32_t keep = mpm_ctx->maxlen > 1 ? mpm_ctx->maxlen - 1 : 0;
+    if (keep == 0)
+        return;
+    if (st->tail_size < keep && MpmStreamStateSetup(st, mpm_ctx) != 0) {
+        st->tail_len = 0;
+        return;
+    }
+
+    if (buflen >= keep) {
+        memcpy(st->tail, buf + buflen - keep, keep);
+        st->tail_len = keep;
+    } else {
+        /* drop the oldest bytes first so the new ones fit */
+        if (st->tail_len + buflen > keep) {
+            const uint32_t drop = st->tail_len + buflen - keep;
+            memmove(st->tail, st->tail + drop, st->tail_len - drop);
+            st->tail_len -= drop;
+        }
+        memcpy(st->tail + st->tail_len, buf, buflen);
+        st->tail_len += buflen;
+    }
+}
+
+/** \brief reset a stream state to start a new stream */
+void MpmStreamStateReset(MpmStreamState *st)
+{
+    st->state = 0;
+    st->tail_len = 0;
+}
+
+/** \brief free the memory held by a stream state */
+void MpmStreamStateFree(MpmStreamState *st)
+{
+    if (st->tail != NULL)
+        SCFree(st->tail);
+    memset(st, 0, sizeof(*st));
+}
+
 
 /************************************Unittests*********************************/
 
 #ifdef UNITTESTS
+static int MpmStreamTestHasSid(const PatternMatcherQueue *pmq, SigIntId sid)
+{
+    uint32_t i;
+    for (i = 0; i < pmq->rule_id_array_cnt; i++) {
+        if (pmq->rule_id_array[i] == sid)
+            return 1;
+    }
+    return 0;
+}
+
+/** \test find patterns spanning the parts of a stream, with the data split
+ *        at every position and passed one byte at a time, for every mpm */
+static int MpmStreamSearchTest01(void)
+{
+    const uint8_t *data = (const uint8_t *)"..abcd....wxYZ...abcdefghijklmnop..";
+    const uint32_t data_len = strlen((const char *)data);
+    uint16_t matcher;
+
+    for (matcher = 0; matcher < MPM_TABLE_SIZE; matcher++) {
+        if (mpm_table[matcher].name == NULL)
+            continue;
+#ifdef __SC_CUDA_SUPPORT__
+        if (matcher == MPM_AC_CUDA)
+            continue;
+#endif
+
+        MpmCtx mpm_ctx;
+        MpmThreadCtx mpm_thread_ctx;
+        PatternMatcherQueue pmq;
+        MpmStreamState st;
+
+        memset(&mpm_ctx, 0, sizeof(mpm_ctx));
+        memset(&mpm_thread_ctx, 0, sizeof(mpm_thread_ctx));
+        memset(&st, 0, sizeof(st));
+        MpmInitCtx(&mpm_ctx, matcher);
+        mpm_table[matcher].InitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+
+        MpmAddPatternCS(&mpm_ctx, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+        MpmAddPatternCI(&mpm_ctx, (uint8_t *)"WXYZ", 4, 0, 0, 1, 1, 0);
+        MpmAddPatternCS(&mpm_ctx, (uint8_t *)"defghijklmn", 11, 0, 0, 2, 2, 0);
+        FAIL_IF(mpm_table[matcher].Prepare(&mpm_ctx) != 0);
+
+        uint32_t split;
+        for (split = 0; split <= data_len + 1; split++) {
+            FAIL_IF(PmqSetup(&pmq) != 0);
+            MpmStreamStateReset(&st);
+
+            if (split <= data_len) {
+                MpmStreamSearch(&mpm_ctx, &mpm_thread_ctx, &pmq, &st,
+                                data, split);
+                MpmStreamSearch(&mpm_ctx, &mpm_thread_ctx, &pmq, &st,
+                                data + split, data_len - split);
+            } else {
+                uint32_t i;
+                for (i = 0; i < data_len; i++) {
+                    MpmStreamSearch(&mpm_ctx, &mpm_thread_ctx, &pmq, &st,
+                                    data + i, 1);
+                }
+            }
+
+            FAIL_IF_NOT(MpmStreamTestHasSid(&pmq, 0));
+            FAIL_IF_NOT(MpmStreamTestHasSid(&pmq, 1));
+            FAIL_IF_NOT(MpmStreamTestHasSid(&pmq, 2));
+            PmqFree(&pmq);
+        }
+
+        MpmStreamStateFree(&st);
+        mpm_table[matcher].DestroyCtx(&mpm_ctx);
+        mpm_table[matcher].DestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    }
+
+    PASS;
+}
+
+/** \test ctxs with offset or depth patterns are only searched as a stream
+ *        by the backends with SearchStream */
+static int MpmStreamSearchTest02(void)
+{
+    uint16_t matcher;
+
+    for (matcher = 0; matcher < MPM_TABLE_SIZE; matcher++) {
+        if (mpm_table[matcher].name == NULL)
+            continue;
+#ifdef __SC_CUDA_SUPPORT__
+        if (matcher == MPM_AC_CUDA)
+            continue;
+#endif
+
+        MpmCtx mpm_ctx;
+        MpmStreamState st;
+
+        memset(&mpm_ctx, 0, sizeof(mpm_ctx));
+        memset(&st, 0, sizeof(st));
+        MpmInitCtx(&mpm_ctx, matcher);
+
+        MpmAddPatternCS(&mpm_ctx, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+        FAIL_IF(mpm_ctx.flags & MPMCTX_FLAG_OFFSET_DEPTH);
+        MpmAddPatternCS(&mpm_ctx, (uint8_t *)"efgh", 4, 0, 10, 1, 1, 0);
+        FAIL_IF_NOT(mpm_ctx.flags & MPMCTX_FLAG_OFFSET_DEPTH);
+        FAIL_IF(mpm_table[matcher].Prepare(&mpm_ctx) != 0);
+
+        int r = MpmStreamStateSetup(&st, &mpm_ctx);
+        if (mpm_table[matcher].SearchStream != NULL) {
+            FAIL_IF(r != 0);
+            FAIL_IF(st.tail_size != MpmStreamStateSize(&mpm_ctx));
+        } else {
+            FAIL_IF(r != -1);
+        }
+
+        MpmStreamStateFree(&st);
+        mpm_table[matcher].DestroyCtx(&mpm_ctx);
+    }
+
+    PASS;
+}
+
+/** \test find patterns beyond the first 64KiB of a buffer, for every mpm */
+static int MpmSearchTest01(void)
+{
+    const uint32_t buflen = 100000;
+    uint16_t matcher;
+
+    uint8_t *buf = SCMalloc(buflen);
+    FAIL_IF_NULL(buf);
+    memset(buf, 'x', buflen);
+    memcpy(buf + 70000, "abcd", 4);
+    memcpy(buf + buflen - 4, "WXYZ", 4);
+
+    for (matcher = 0; matcher < MPM_TABLE_SIZE; matcher++) {
+        if (mpm_table[matcher].name == NULL || mpm_table[matcher].Search == NULL)
+            continue;
+#ifdef __SC_CUDA_SUPPORT__
+        if (matcher == MPM_AC_CUDA)
+            continue;
+#endif
+
+        MpmCtx mpm_ctx;
+        MpmThreadCtx mpm_thread_ctx;
+        PatternMatcherQueue pmq;
+
+        memset(&mpm_ctx, 0, sizeof(mpm_ctx));
+        memset(&mpm_thread_ctx, 0, sizeof(mpm_thread_ctx));
+        MpmInitCtx(&mpm_ctx, matcher);
+        mpm_table[matcher].InitThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+
+        MpmAddPatternCS(&mpm_ctx, (uint8_t *)"abcd", 4, 0, 0, 0, 0, 0);
+        MpmAddPatternCI(&mpm_ctx, (uint8_t *)"wxyz", 4, 0, 0, 1, 1, 0);
+        FAIL_IF(mpm_table[matcher].Prepare(&mpm_ctx) != 0);
+        FAIL_IF(PmqSetup(&pmq) != 0);
+
+        uint32_t cnt = mpm_table[matcher].Search(&mpm_ctx, &mpm_thread_ctx,
+                                                 &pmq, buf, buflen);
+        FAIL_IF(cnt != 2);
+
+        /* a length truncated to 16 bits would stop before both patterns */
+        cnt = mpm_table[matcher].Search(&mpm_ctx, &mpm_thread_ctx,
+                                        &pmq, buf, 65536);
+        FAIL_IF(cnt != 0);
+
+        PmqFree(&pmq);
+        mpm_table[matcher].DestroyCtx(&mpm_ctx);
+        mpm_table[matcher].DestroyThreadCtx(&mpm_ctx, &mpm_thread_ctx);
+    }
+
+    SCFree(buf);
+    PASS;
+}
 #endif /* UNITTESTS */
 
 void MpmRegisterTests(void)
@@ -834,6 +1163,10 @@ void MpmRegisterTests(void)
 #ifdef UNITTESTS
     uint16_t i;
 
+    UtRegisterTest("MpmStreamSearchTest01", MpmStreamSearchTest01);
+    UtRegisterTest("MpmStreamSearchTest02", MpmStreamSearchTest02);
+    UtRegisterTest("MpmSearchTest01", MpmSearchTest01);
+
     for (i = 0; i < MPM_TABLE_SIZE; i++) {
         if (i == MPM_NOTSET)
             continue;
@@ -38,6 +38,8 @@ enum {
 #endif
     MPM_AC_BS,
     MPM_AC_TILE,
+    /* simd prefilter, ac for large contexts */
+    MPM_TEDDY,
     MPM_HS,
     /* table size */
     MPM_TABLE_SIZE,
@@ -123,6 +125,9 @@ typedef struct MpmCtx_ {
 
     uint32_t max_pat_id;
 
+    /* MPMCTX_FLAG_* */
+    uint32_t flags;
+
     /* hash used during ctx initialization */
     MpmPattern **init_hash;
 } MpmCtx;
@@ -131,6 +136,9 @@ typedef struct MpmCtx_ {
  * we should supply this as the key */
 #define MPM_CTX_FACTORY_UNIQUE_CONTEXT -1
 
+/** ctx has patterns with an offset or depth */
+#define MPMCTX_FLAG_OFFSET_DEPTH    0x01
+
 typedef struct MpmCtxFactoryItem_ {
     const char *name;
     MpmCtx *mpm_ctx_ts;
@@ -143,6 +151,22 @@ typedef struct MpmCtxFactoryContainer_ {
     int32_t no_of_items;
 } MpmCtxFactoryContainer;
 
+/** state of a streaming search, kept between the MpmStreamSearch() calls
+ *  for the consecutive parts of a stream */
+typedef struct MpmStreamState_ {
+    /** backend state to continue from, e.g. the ac state */
+    uint32_t state;
+
+    /** last maxlen - 1 bytes scanned. Backends without SearchStream use
+     *  them to find the patterns spanning two parts, and need twice that
+     *  so the head of the next part can be appended. Backends with
+     *  SearchStream use them to confirm the case of patterns spanning
+     *  two parts. See MpmStreamStateSize(). */
+    uint8_t *tail;
+    uint32_t tail_len;
+    uint32_t tail_size;
+} MpmStreamState;
+
 /** pattern is case insensitive */
 #define MPM_PATTERN_FLAG_NOCASE     0x01
 /** pattern is negated */
@@ -178,7 +202,10 @@ typedef struct MpmTableElmt_ {
     int  (*AddPattern)(struct MpmCtx_ *, uint8_t *, uint16_t, uint16_t, uint16_t, uint32_t, SigIntId, uint8_t);
     int  (*AddPatternNocase)(struct MpmCtx_ *, uint8_t *, uint16_t, uint16_t, uint16_t, uint32_t, SigIntId, uint8_t);
     int  (*Prepare)(struct MpmCtx_ *);
-    uint32_t (*Search)(const struct MpmCtx_ *, struct MpmThreadCtx_ *, PatternMatcherQueue *, const uint8_t *, uint16_t);
+    uint32_t (*Search)(const struct MpmCtx_ *, struct MpmThreadCtx_ *, PatternMatcherQueue *, const uint8_t *, uint32_t);
+    /** optional: search a buffer as the continuation of the buffers searched
+     *  before with the same state, see MpmStreamSearch() */
+    uint32_t (*SearchStream)(const struct MpmCtx_ *, struct MpmThreadCtx_ *, PatternMatcherQueue *, MpmStreamState *, const uint8_t *, uint32_t);
     void (*Cleanup)(struct MpmThreadCtx_ *);
     void (*PrintCtx)(struct MpmCtx_ *);
     void (*PrintThreadCtx)(struct MpmThreadCtx_ *);
@@ -252,6 +279,16 @@ int MpmAddPatternCI(struct MpmCtx_ *mpm_ctx, uint8_t *pat, uint16_t patlen,
 
 void MpmFreePattern(MpmCtx *mpm_ctx, MpmPattern *p);
 
+uint32_t MpmStreamSearch(const MpmCtx *mpm_ctx, MpmThreadCtx *mpm_thread_ctx,
+                         PatternMatcherQueue *pmq, MpmStreamState *st,
+                         const uint8_t *buf, uint32_t buflen);
+uint32_t MpmStreamStateSize(const MpmCtx *mpm_ctx);
+int MpmStreamStateSetup(MpmStreamState *st, const MpmCtx *mpm_ctx);
+void MpmStreamStateKeepTail(MpmStreamState *st, const MpmCtx *mpm_ctx,
+                            const uint8_t *buf, uint32_t buflen);
+void MpmStreamStateReset(MpmStreamState *st);
+void MpmStreamStateFree(MpmStreamState *st);
+
 int MpmAddPattern(MpmCtx *mpm_ctx, uint8_t *pat, uint16_t patlen,
                             uint16_t offset, uint16_t depth, uint32_t pid,
                             SigIntId sid, uint8_t flags);
@@ -48,5 +48,13 @@
  */
 #define hw_barrier() __sync_synchronize()
 
+/** from http://gcc.gnu.org/onlinedocs/gcc/Other-Builtins.html
+ *
+ * Prefetch the cache line holding 'addr' for reading
+ */
+#ifndef prefetch
+#define prefetch(addr) __builtin_prefetch((addr), 0, 3)
+#endif
+
 #endif /* __UTIL_OPTIMIZE_H__ */
 
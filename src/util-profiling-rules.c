@@ -27,6 +27,9 @@
 #include "suricata-common.h"
 #include "decode.h"
 #include "detect.h"
+#include "detect-engine.h"
+#include "detect-parse.h"
+#include "detect-content.h"
 #include "conf.h"
 
 #include "tm-threads.h"
@@ -36,8 +39,6 @@
 #include "util-profiling.h"
 #include "util-profiling-locks.h"
 
-#ifdef PROFILING
-
 /**
  * Extra data for rule profiling.
  */
@@ -45,6 +46,8 @@ typedef struct SCProfileData_ {
     uint32_t sid;
     uint32_t gid;
     uint32_t rev;
+    uint16_t buffer;    /**< list of the fast pattern, DETECT_SM_LIST_MAX if none */
+    uint8_t mpm;        /**< rule is only inspected after a mpm hit */
     uint64_t checks;
     uint64_t matches;
     uint64_t max;
@@ -52,10 +55,43 @@ typedef struct SCProfileData_ {
     uint64_t ticks_no_match;
 } SCProfileData;
 
+/**
+ * Rule inspection cost attributed to a rule group or to the buffer
+ * holding the fast pattern of the rules.
+ */
+typedef struct SCProfileRuleGroupData_ {
+    uint64_t checks;
+    uint64_t matches;
+    uint64_t ticks;
+    uint64_t mpm_checks;    /**< checks of rules that got in through the mpm */
+    uint64_t mpm_matches;
+} SCProfileRuleGroupData;
+
+#define PROFILE_RULE_BUFFERS (DETECT_SM_LIST_MAX + 1)
+
+/**
+ * Per thread counters. They are linked into the detect ctx so that the
+ * live export can read them while the thread is running.
+ */
+typedef struct SCProfileRuleThreadData_ {
+    SCProfileData *data;
+    uint32_t size;
+    uint32_t sgh_size;
+    SCProfileRuleGroupData *sgh_data;
+    SCProfileRuleGroupData buffer_data[PROFILE_RULE_BUFFERS];
+    struct SCProfileRuleThreadData_ *next;
+} SCProfileRuleThreadData;
+
 typedef struct SCProfileDetectCtx_ {
     uint32_t size;
     uint32_t id;
     SCProfileData *data;
+    uint32_t sgh_size;
+    SCProfileRuleGroupData *sgh_data;
+    SCProfileRuleGroupData buffer_data[PROFILE_RULE_BUFFERS];
+    /** threads still running, their data is merged into the above when
+     *  they exit */
+    SCProfileRuleThreadData *threads;
     pthread_mutex_t data_m;
 } SCProfileDetectCtx;
 
@@ -66,6 +102,8 @@ typedef struct SCProfileSummary_ {
     uint32_t sid;
     uint32_t gid;
     uint32_t rev;
+    uint16_t buffer;
+    uint8_t mpm;
     uint64_t ticks;
     double avgticks;
     double avgticks_match;
@@ -77,8 +115,9 @@ typedef struct SCProfileSummary_ {
     uint64_t ticks_no_match;
 } SCProfileSummary;
 
-extern int profiling_output_to_file;
+static int profiling_output_to_file = 0;
 int profiling_rules_enabled = 0;
+int profiling_rules_sample_rate = 1;
 static char *profiling_file_name = "";
 static const char *profiling_file_mode = "a";
 #ifdef HAVE_LIBJANSSON
@@ -104,6 +143,33 @@ static int profiling_rules_sort_order = SC_PROFILING_RULES_SORT_BY_TICKS;
  */
 static uint32_t profiling_rules_limit = UINT32_MAX;
 
+/**
+ * Used as a check so we don't double enter a profiling run.
+ */
+__thread int profiling_rules_entered = 0;
+
+/** per thread sample counter for the rule profiling sample rate */
+static __thread uint64_t rule_samples = 0;
+
+/* see if we want to profile rules for this packet */
+int SCProfileRuleStart(Packet *p)
+{
+#ifdef PROFILE_LOCKING
+    if (p->profile != NULL) {
+        p->flags |= PKT_PROFILE;
+        return 1;
+    }
+#else
+    /* thread local counter so the detect threads don't share the
+     * cache line of a global sample counter */
+    if (++rule_samples % profiling_rules_sample_rate == 0) {
+        p->flags |= PKT_PROFILE;
+        return 1;
+    }
+#endif
+    return 0;
+}
+
 void SCProfilingRulesGlobalInit(void)
 {
     ConfNode *conf;
@@ -181,6 +247,27 @@ void SCProfilingRulesGlobalInit(void)
 
                 profiling_output_to_file = 1;
             }
+            val = ConfNodeLookupChildValue(conf, "sample-rate");
+            if (val != NULL) {
+                uint32_t sample_rate = 0;
+                if (ByteExtractStringUint32(&sample_rate, 10,
+                            (uint16_t)strlen(val), val) <= 0 ||
+                        sample_rate == 0 || sample_rate > INT_MAX) {
+                    SCLogError(SC_ERR_INVALID_ARGUMENT, "Invalid sample-rate: %s", val);
+                    exit(EXIT_FAILURE);
+                }
+                profiling_rules_sample_rate = (int)sample_rate;
+            } else {
+                intmax_t rate_v = 0;
+                if (ConfGetInt("profiling.sample-rate", &rate_v) == 1 &&
+                        rate_v > 0 && rate_v <= INT_MAX) {
+                    profiling_rules_sample_rate = (int)rate_v;
+                }
+            }
+            if (profiling_rules_sample_rate > 1) {
+                SCLogInfo("rule profiling runs for every %dth packet",
+                        profiling_rules_sample_rate);
+            }
             if (ConfNodeChildValueIsTrue(conf, "json")) {
 #ifdef HAVE_LIBJANSSON
                 profiling_rule_json = 1;
@@ -290,36 +377,148 @@ SCProfileSummarySortByMaxTicks(const void *a, const void *b)
         return s0->max > s1->max ? -1 : 1;
 }
 
+/**
+ * \brief Fill the summary records from the rule counters and sort them
+ *        according to the configured sort order.
+ *
+ * \retval total_ticks ticks spent in all rules
+ */
+static uint64_t SCProfilingRuleSummarize(const SCProfileData *data,
+        uint32_t count, SCProfileSummary *summary)
+{
+    uint32_t i;
+    uint64_t total_ticks = 0;
+
+    memset(summary, 0, sizeof(SCProfileSummary) * count);
+    for (i = 0; i < count; i++) {
+        summary[i].sid = data[i].sid;
+        summary[i].rev = data[i].rev;
+        summary[i].gid = data[i].gid;
+        summary[i].buffer = data[i].buffer;
+        summary[i].mpm = data[i].mpm;
+
+        summary[i].ticks = data[i].ticks_match + data[i].ticks_no_match;
+        summary[i].checks = data[i].checks;
+
+        if (summary[i].ticks > 0) {
+            summary[i].avgticks = (long double)summary[i].ticks / (long double)summary[i].checks;
+        }
+
+        summary[i].matches = data[i].matches;
+        summary[i].max = data[i].max;
+        summary[i].ticks_match = data[i].ticks_match;
+        summary[i].ticks_no_match = data[i].ticks_no_match;
+        if (summary[i].ticks_match > 0) {
+            summary[i].avgticks_match = (long double)summary[i].ticks_match /
+                (long double)summary[i].matches;
+        }
+
+        if (summary[i].ticks_no_match > 0) {
+            summary[i].avgticks_no_match = (long double)summary[i].ticks_no_match /
+                ((long double)summary[i].checks - (long double)summary[i].matches);
+        }
+        total_ticks += summary[i].ticks;
+    }
+
+    switch (profiling_rules_sort_order) {
+        case SC_PROFILING_RULES_SORT_BY_TICKS:
+            qsort(summary, count, sizeof(SCProfileSummary),
+                    SCProfileSummarySortByTicks);
+            break;
+        case SC_PROFILING_RULES_SORT_BY_AVG_TICKS:
+            qsort(summary, count, sizeof(SCProfileSummary),
+                    SCProfileSummarySortByAvgTicks);
+            break;
+        case SC_PROFILING_RULES_SORT_BY_CHECKS:
+            qsort(summary, count, sizeof(SCProfileSummary),
+                    SCProfileSummarySortByChecks);
+            break;
+        case SC_PROFILING_RULES_SORT_BY_MATCHES:
+            qsort(summary, count, sizeof(SCProfileSummary),
+                    SCProfileSummarySortByMatches);
+            break;
+        case SC_PROFILING_RULES_SORT_BY_MAX_TICKS:
+            qsort(summary, count, sizeof(SCProfileSummary),
+                    SCProfileSummarySortByMaxTicks);
+            break;
+        case SC_PROFILING_RULES_SORT_BY_AVG_TICKS_MATCH:
+            qsort(summary, count, sizeof(SCProfileSummary),
+                    SCProfileSummarySortByAvgTicksMatch);
+            break;
+        case SC_PROFILING_RULES_SORT_BY_AVG_TICKS_NO_MATCH:
+            qsort(summary, count, sizeof(SCProfileSummary),
+                    SCProfileSummarySortByAvgTicksNoMatch);
+            break;
+    }
+
+    return total_ticks;
+}
+
+static const char *SCProfilingRuleBufferName(uint16_t buffer)
+{
+    if (buffer >= DETECT_SM_LIST_MAX)
+        return "none";
+    return DetectListToHumanString(buffer);
+}
+
 #ifdef HAVE_LIBJANSSON
 
-static void DumpJson(FILE *fp, SCProfileSummary *summary, uint32_t count, uint64_t total_ticks)
+static void RuleGroupDataToJson(json_t *js, const SCProfileRuleGroupData *d,
+        uint64_t total_ticks)
+{
+    json_object_set_new(js, "checks", json_integer(d->checks));
+    json_object_set_new(js, "matches", json_integer(d->matches));
+    json_object_set_new(js, "ticks_total", json_integer(d->ticks));
+    json_object_set_new(js, "ticks_avg",
+            json_integer(d->checks ? d->ticks / d->checks : 0));
+
+    double percent = total_ticks ? (long double)d->ticks /
+        (long double)total_ticks * 100 : 0;
+    json_object_set_new(js, "percent", json_integer(percent));
+
+    json_object_set_new(js, "mpm_checks", json_integer(d->mpm_checks));
+    json_object_set_new(js, "mpm_false_positives",
+            json_integer(d->mpm_checks - d->mpm_matches));
+    if (d->mpm_checks > 0) {
+        json_object_set_new(js, "mpm_fp_ratio",
+                json_real((double)(d->mpm_checks - d->mpm_matches) /
+                    (double)d->mpm_checks));
+    }
+}
+
+/**
+ * \brief Add the per rule, per rule group and per buffer breakdown to
+ *        a json object.
+ */
+static void SCProfilingRuleDataToJson(json_t *js,
+        const SCProfileData *data, uint32_t size,
+        const SCProfileRuleGroupData *sgh_data, uint32_t sgh_size,
+        const SCProfileRuleGroupData *buffer_data)
 {
-    char timebuf[64];
     uint32_t i;
-    struct timeval tval;
+    uint64_t total_ticks = 0;
 
-    json_t *js = json_object();
-    if (js == NULL)
-        return;
     json_t *jsa = json_array();
-    if (jsa == NULL) {
-        json_decref(js);
+    if (jsa == NULL)
         return;
-    }
 
-    gettimeofday(&tval, NULL);
-    CreateIsoTimeString(&tval, timebuf, sizeof(timebuf));
-    json_object_set_new(js, "timestamp", json_string(timebuf));
+    SCProfileSummary *summary = NULL;
+    if (size > 0)
+        summary = SCMalloc(sizeof(SCProfileSummary) * size);
+    if (summary != NULL) {
+        total_ticks = SCProfilingRuleSummarize(data, size, summary);
 
-    for (i = 0; i < count; i++) {
-        /* Stop dumping when we hit our first rule with 0 checks.  Due
-         * to sorting this will be the beginning of all the rules with
-         * 0 checks. */
-        if (summary[i].checks == 0)
-            break;
+        for (i = 0; i < MIN(size, profiling_rules_limit); i++) {
+            /* Stop dumping when we hit our first rule with 0 checks.  Due
+             * to sorting this will be the beginning of all the rules with
+             * 0 checks. */
+            if (summary[i].checks == 0)
+                break;
+
+            json_t *jsm = json_object();
+            if (jsm == NULL)
+                continue;
 
-        json_t *jsm = json_object();
-        if (jsm) {
             json_object_set_new(jsm, "signature_id", json_integer(summary[i].sid));
             json_object_set_new(jsm, "gid", json_integer(summary[i].gid));
             json_object_set_new(jsm, "rev", json_integer(summary[i].rev));
@@ -333,23 +532,83 @@ static void DumpJson(FILE *fp, SCProfileSummary *summary, uint32_t count, uint64
             json_object_set_new(jsm, "ticks_avg_match", json_integer(summary[i].avgticks_match));
             json_object_set_new(jsm, "ticks_avg_nomatch", json_integer(summary[i].avgticks_no_match));
 
-            double percent = (long double)summary[i].ticks /
-                (long double)total_ticks * 100;
+            double percent = total_ticks ? (long double)summary[i].ticks /
+                (long double)total_ticks * 100 : 0;
             json_object_set_new(jsm, "percent", json_integer(percent));
+
+            json_object_set_new(jsm, "buffer",
+                    json_string(SCProfilingRuleBufferName(summary[i].buffer)));
+            if (summary[i].mpm) {
+                /* the rule was only inspected because its fast pattern
+                 * matched, so every non-match is a mpm false positive */
+                json_object_set_new(jsm, "mpm_fp_ratio",
+                        json_real((double)(summary[i].checks - summary[i].matches) /
+                            (double)summary[i].checks));
+            }
             json_array_append_new(jsa, jsm);
         }
+        SCFree(summary);
     }
     json_object_set_new(js, "rules", jsa);
 
+    jsa = json_array();
+    if (jsa == NULL)
+        return;
+    for (i = 0; i < sgh_size; i++) {
+        if (sgh_data[i].checks == 0)
+            continue;
+
+        json_t *jsg = json_object();
+        if (jsg == NULL)
+            continue;
+        json_object_set_new(jsg, "id", json_integer(i));
+        RuleGroupDataToJson(jsg, &sgh_data[i], total_ticks);
+        json_array_append_new(jsa, jsg);
+    }
+    json_object_set_new(js, "rule_groups", jsa);
+
+    jsa = json_array();
+    if (jsa == NULL)
+        return;
+    for (i = 0; i < PROFILE_RULE_BUFFERS; i++) {
+        if (buffer_data[i].checks == 0)
+            continue;
+
+        json_t *jsb = json_object();
+        if (jsb == NULL)
+            continue;
+        json_object_set_new(jsb, "name", json_string(SCProfilingRuleBufferName(i)));
+        RuleGroupDataToJson(jsb, &buffer_data[i], total_ticks);
+        json_array_append_new(jsa, jsb);
+    }
+    json_object_set_new(js, "buffers", jsa);
+}
+
+static void DumpJson(FILE *fp, SCProfileDetectCtx *rules_ctx)
+{
+    char timebuf[64];
+    struct timeval tval;
+
+    json_t *js = json_object();
+    if (js == NULL)
+        return;
+
+    gettimeofday(&tval, NULL);
+    CreateIsoTimeString(&tval, timebuf, sizeof(timebuf));
+    json_object_set_new(js, "timestamp", json_string(timebuf));
+
+    SCProfilingRuleDataToJson(js, rules_ctx->data, rules_ctx->size,
+            rules_ctx->sgh_data, rules_ctx->sgh_size, rules_ctx->buffer_data);
+
     char *js_s = json_dumps(js,
             JSON_PRESERVE_ORDER|JSON_COMPACT|JSON_ENSURE_ASCII|
             JSON_ESCAPE_SLASH);
+    json_decref(js);
 
     if (unlikely(js_s == NULL))
         return;
     fprintf(fp, "%s", js_s);
     free(js_s);
-    json_decref(js);
 }
 
 #endif /* HAVE_LIBJANSSON */
@@ -421,7 +680,6 @@ static void DumpText(FILE *fp, SCProfileSummary *summary, uint32_t count, uint64
 void
 SCProfilingRuleDump(SCProfileDetectCtx *rules_ctx)
 {
-    uint32_t i;
     FILE *fp;
 
     if (rules_ctx == NULL)
@@ -439,89 +697,32 @@ SCProfilingRuleDump(SCProfileDetectCtx *rules_ctx)
        fp = stdout;
     }
 
-    int summary_size = sizeof(SCProfileSummary) * rules_ctx->size;
-    SCProfileSummary *summary = SCMalloc(summary_size);
-    if (unlikely(summary == NULL)) {
-        SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory for profiling summary");
-        return;
-    }
-
     uint32_t count = rules_ctx->size;
-    uint64_t total_ticks = 0;
 
     SCLogPerf("Dumping profiling data for %u rules.", count);
 
-    memset(summary, 0, summary_size);
-    for (i = 0; i < count; i++) {
-        summary[i].sid = rules_ctx->data[i].sid;
-        summary[i].rev = rules_ctx->data[i].rev;
-        summary[i].gid = rules_ctx->data[i].gid;
-
-        summary[i].ticks = rules_ctx->data[i].ticks_match + rules_ctx->data[i].ticks_no_match;
-        summary[i].checks = rules_ctx->data[i].checks;
-
-        if (summary[i].ticks > 0) {
-            summary[i].avgticks = (long double)summary[i].ticks / (long double)summary[i].checks;
-        }
-
-        summary[i].matches = rules_ctx->data[i].matches;
-        summary[i].max = rules_ctx->data[i].max;
-        summary[i].ticks_match = rules_ctx->data[i].ticks_match;
-        summary[i].ticks_no_match = rules_ctx->data[i].ticks_no_match;
-        if (summary[i].ticks_match > 0) {
-            summary[i].avgticks_match = (long double)summary[i].ticks_match /
-                (long double)summary[i].matches;
-        }
-
-        if (summary[i].ticks_no_match > 0) {
-            summary[i].avgticks_no_match = (long double)summary[i].ticks_no_match /
-                ((long double)summary[i].checks - (long double)summary[i].matches);
-        }
-        total_ticks += summary[i].ticks;
-    }
-
-    switch (profiling_rules_sort_order) {
-        case SC_PROFILING_RULES_SORT_BY_TICKS:
-            qsort(summary, count, sizeof(SCProfileSummary),
-                    SCProfileSummarySortByTicks);
-            break;
-        case SC_PROFILING_RULES_SORT_BY_AVG_TICKS:
-            qsort(summary, count, sizeof(SCProfileSummary),
-                    SCProfileSummarySortByAvgTicks);
-            break;
-        case SC_PROFILING_RULES_SORT_BY_CHECKS:
-            qsort(summary, count, sizeof(SCProfileSummary),
-                    SCProfileSummarySortByChecks);
-            break;
-        case SC_PROFILING_RULES_SORT_BY_MATCHES:
-            qsort(summary, count, sizeof(SCProfileSummary),
-                    SCProfileSummarySortByMatches);
-            break;
-        case SC_PROFILING_RULES_SORT_BY_MAX_TICKS:
-            qsort(summary, count, sizeof(SCProfileSummary),
-                    SCProfileSummarySortByMaxTicks);
-            break;
-        case SC_PROFILING_RULES_SORT_BY_AVG_TICKS_MATCH:
-            qsort(summary, count, sizeof(SCProfileSummary),
-                    SCProfileSummarySortByAvgTicksMatch);
-            break;
-        case SC_PROFILING_RULES_SORT_BY_AVG_TICKS_NO_MATCH:
-            qsort(summary, count, sizeof(SCProfileSummary),
-                    SCProfileSummarySortByAvgTicksNoMatch);
-            break;
-    }
 #ifdef HAVE_LIBJANSSON
     if (profiling_rule_json) {
-        DumpJson(fp, summary, count, total_ticks);
+        DumpJson(fp, rules_ctx);
     } else
 #endif
-    {
+    if (count > 0) {
+        SCProfileSummary *summary = SCMalloc(sizeof(SCProfileSummary) * count);
+        if (unlikely(summary == NULL)) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory for profiling summary");
+            if (fp != stdout)
+                fclose(fp);
+            return;
+        }
+
+        uint64_t total_ticks = SCProfilingRuleSummarize(rules_ctx->data,
+                count, summary);
         DumpText(fp, summary, count, total_ticks);
+        SCFree(summary);
     }
 
     if (fp != stdout)
         fclose(fp);
-    SCFree(summary);
     SCLogPerf("Done dumping profiling data.");
 }
 
@@ -537,9 +738,24 @@ SCProfilingRegisterRuleCounter(SCProfileDetectCtx *ctx)
     return ctx->id++;
 }
 
+static inline void SCProfilingRuleGroupUpdate(SCProfileRuleGroupData *d,
+        const int mpm, const uint64_t ticks, const int match)
+{
+    d->checks++;
+    d->matches += match;
+    d->ticks += ticks;
+    if (mpm) {
+        d->mpm_checks++;
+        d->mpm_matches += match;
+    }
+}
+
 /**
  * \brief Update a rule counter.
  *
+ * The cost is also attributed to the rule group that is inspected and
+ * to the buffer of the rule's fast pattern.
+ *
  * \param id The ID of this counter.
  * \param ticks Number of CPU ticks for this rule.
  * \param match Did the rule match?
@@ -558,6 +774,13 @@ SCProfilingRuleUpdateCounter(DetectEngineThreadCtx *det_ctx, uint16_t id, uint64
             p->ticks_match += ticks;
         else
             p->ticks_no_match += ticks;
+
+        SCProfileRuleThreadData *td = det_ctx->rule_perf_thread_data;
+        SCProfilingRuleGroupUpdate(&td->buffer_data[p->buffer], p->mpm, ticks, match);
+        if (det_ctx->sgh != NULL && det_ctx->sgh->id < td->sgh_size) {
+            SCProfilingRuleGroupUpdate(&td->sgh_data[det_ctx->sgh->id],
+                    p->mpm, ticks, match);
+        }
     }
 }
 
@@ -583,6 +806,8 @@ void SCProfilingRuleDestroyCtx(SCProfileDetectCtx *ctx)
         SCProfilingRuleDump(ctx);
         if (ctx->data != NULL)
             SCFree(ctx->data);
+        if (ctx->sgh_data != NULL)
+            SCFree(ctx->sgh_data);
         pthread_mutex_destroy(&ctx->data_m);
         SCFree(ctx);
     }
@@ -593,42 +818,117 @@ void SCProfilingRuleThreadSetup(SCProfileDetectCtx *ctx, DetectEngineThreadCtx *
     if (ctx == NULL|| ctx->size == 0)
         return;
 
+    SCProfileRuleThreadData *td = SCMalloc(sizeof(SCProfileRuleThreadData));
+    if (td == NULL)
+        return;
+    memset(td, 0x00, sizeof(SCProfileRuleThreadData));
+
     SCProfileData *a = SCMalloc(sizeof(SCProfileData) * ctx->size);
-    if (a != NULL) {
-        memset(a, 0x00, sizeof(SCProfileData) * ctx->size);
+    if (a == NULL) {
+        SCFree(td);
+        return;
+    }
+    memset(a, 0x00, sizeof(SCProfileData) * ctx->size);
+
+    /* the buffer and mpm info is needed on update */
+    uint32_t i;
+    for (i = 0; i < ctx->size; i++) {
+        a[i].buffer = ctx->data[i].buffer;
+        a[i].mpm = ctx->data[i].mpm;
+    }
+    td->data = a;
+    td->size = ctx->size;
+
+    if (ctx->sgh_size > 0) {
+        td->sgh_data = SCMalloc(sizeof(SCProfileRuleGroupData) * ctx->sgh_size);
+        if (td->sgh_data == NULL) {
+            SCFree(a);
+            SCFree(td);
+            return;
+        }
+        memset(td->sgh_data, 0x00, sizeof(SCProfileRuleGroupData) * ctx->sgh_size);
+        td->sgh_size = ctx->sgh_size;
+    }
+
+    pthread_mutex_lock(&ctx->data_m);
+    td->next = ctx->threads;
+    ctx->threads = td;
+    pthread_mutex_unlock(&ctx->data_m);
+
+    det_ctx->rule_perf_data = a;
+    det_ctx->rule_perf_data_size = ctx->size;
+    det_ctx->rule_perf_thread_data = td;
+}
+
+static void SCProfilingRuleMergeData(SCProfileData *dst,
+        const SCProfileData *src, uint32_t size)
+{
+    uint32_t i;
+    for (i = 0; i < size; i++) {
+        dst[i].checks += src[i].checks;
+        dst[i].matches += src[i].matches;
+        dst[i].ticks_match += src[i].ticks_match;
+        dst[i].ticks_no_match += src[i].ticks_no_match;
+        if (src[i].max > dst[i].max)
+            dst[i].max = src[i].max;
+    }
+}
 
-        det_ctx->rule_perf_data = a;
-        det_ctx->rule_perf_data_size = ctx->size;
+static void SCProfilingRuleMergeGroupData(SCProfileRuleGroupData *dst,
+        const SCProfileRuleGroupData *src, uint32_t size)
+{
+    uint32_t i;
+    for (i = 0; i < size; i++) {
+        dst[i].checks += src[i].checks;
+        dst[i].matches += src[i].matches;
+        dst[i].ticks += src[i].ticks;
+        dst[i].mpm_checks += src[i].mpm_checks;
+        dst[i].mpm_matches += src[i].mpm_matches;
     }
 }
 
-static void SCProfilingRuleThreadMerge(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx)
+static void SCProfilingRuleThreadMerge(SCProfileDetectCtx *ctx,
+        const SCProfileRuleThreadData *td)
 {
-    if (de_ctx == NULL || de_ctx->profile_ctx == NULL || de_ctx->profile_ctx->data == NULL ||
-        det_ctx == NULL || det_ctx->rule_perf_data == NULL)
+    if (ctx->data == NULL)
         return;
 
-    int i;
-    for (i = 0; i < det_ctx->rule_perf_data_size; i++) {
-        de_ctx->profile_ctx->data[i].checks += det_ctx->rule_perf_data[i].checks;
-        de_ctx->profile_ctx->data[i].matches += det_ctx->rule_perf_data[i].matches;
-        de_ctx->profile_ctx->data[i].ticks_match += det_ctx->rule_perf_data[i].ticks_match;
-        de_ctx->profile_ctx->data[i].ticks_no_match += det_ctx->rule_perf_data[i].ticks_no_match;
-        if (det_ctx->rule_perf_data[i].max > de_ctx->profile_ctx->data[i].max)
-            de_ctx->profile_ctx->data[i].max = det_ctx->rule_perf_data[i].max;
+    SCProfilingRuleMergeData(ctx->data, td->data, MIN(ctx->size, td->size));
+    if (ctx->sgh_data != NULL) {
+        SCProfilingRuleMergeGroupData(ctx->sgh_data, td->sgh_data,
+                MIN(ctx->sgh_size, td->sgh_size));
     }
+    SCProfilingRuleMergeGroupData(ctx->buffer_data, td->buffer_data,
+            PROFILE_RULE_BUFFERS);
 }
 
 void SCProfilingRuleThreadCleanup(DetectEngineThreadCtx *det_ctx)
 {
-    if (det_ctx == NULL || det_ctx->de_ctx == NULL || det_ctx->rule_perf_data == NULL)
+    if (det_ctx == NULL || det_ctx->de_ctx == NULL || det_ctx->rule_perf_thread_data == NULL)
         return;
 
-    pthread_mutex_lock(&det_ctx->de_ctx->profile_ctx->data_m);
-    SCProfilingRuleThreadMerge(det_ctx->de_ctx, det_ctx);
-    pthread_mutex_unlock(&det_ctx->de_ctx->profile_ctx->data_m);
+    SCProfileDetectCtx *ctx = det_ctx->de_ctx->profile_ctx;
+    SCProfileRuleThreadData *td = det_ctx->rule_perf_thread_data;
+
+    pthread_mutex_lock(&ctx->data_m);
+    SCProfilingRuleThreadMerge(ctx, td);
+
+    SCProfileRuleThreadData **ptd = &ctx->threads;
+    while (*ptd != NULL) {
+        if (*ptd == td) {
+            *ptd = td->next;
+            break;
+        }
+        ptd = &(*ptd)->next;
+    }
+    pthread_mutex_unlock(&ctx->data_m);
+
+    if (td->sgh_data != NULL)
+        SCFree(td->sgh_data);
+    SCFree(td->data);
+    SCFree(td);
 
-    SCFree(det_ctx->rule_perf_data);
+    det_ctx->rule_perf_thread_data = NULL;
     det_ctx->rule_perf_data = NULL;
     det_ctx->rule_perf_data_size = 0;
 }
@@ -662,15 +962,126 @@ SCProfilingRuleInitCounters(DetectEngineCtx *de_ctx)
 
         sig = de_ctx->sig_list;
         while (sig != NULL) {
-            de_ctx->profile_ctx->data[sig->profiling_id].sid = sig->id;
-            de_ctx->profile_ctx->data[sig->profiling_id].gid = sig->gid;
-            de_ctx->profile_ctx->data[sig->profiling_id].rev = sig->rev;
+            SCProfileData *d = &de_ctx->profile_ctx->data[sig->profiling_id];
+            d->sid = sig->id;
+            d->gid = sig->gid;
+            d->rev = sig->rev;
+            d->buffer = DETECT_SM_LIST_MAX;
+            if (sig->mpm_sm != NULL) {
+                int list = SigMatchListSMBelongsTo(sig, sig->mpm_sm);
+                if (list >= 0)
+                    d->buffer = (uint16_t)list;
+
+                const DetectContentData *cd = (DetectContentData *)sig->mpm_sm->ctx;
+                d->mpm = !(cd->flags & DETECT_CONTENT_NEGATED);
+            }
             sig = sig->next;
         }
+
+        if (de_ctx->sgh_array_cnt > 0) {
+            de_ctx->profile_ctx->sgh_data = SCMalloc(sizeof(SCProfileRuleGroupData) *
+                    de_ctx->sgh_array_cnt);
+            BUG_ON(de_ctx->profile_ctx->sgh_data == NULL);
+            memset(de_ctx->profile_ctx->sgh_data, 0x00,
+                    sizeof(SCProfileRuleGroupData) * de_ctx->sgh_array_cnt);
+            de_ctx->profile_ctx->sgh_size = de_ctx->sgh_array_cnt;
+        }
     }
 
     SCLogPerf("Registered %"PRIu32" rule profiling counters.", count);
 }
 
-#endif /* PROFILING */
+#ifdef HAVE_LIBJANSSON
+/**
+ * \brief Get a snapshot of the rule profiling counters while the engine
+ *        is running.
+ *
+ * Running threads update their counters without locking, so the
+ * snapshot may miss the updates that are in progress.
+ *
+ * \retval js json object with rules, rule_groups and buffers, or NULL
+ */
+json_t *SCProfilingRuleGetJson(DetectEngineCtx *de_ctx)
+{
+    if (de_ctx == NULL || de_ctx->profile_ctx == NULL)
+        return NULL;
+
+    SCProfileDetectCtx *ctx = de_ctx->profile_ctx;
+    SCProfileData *data = NULL;
+    SCProfileRuleGroupData *sgh_data = NULL;
+    SCProfileRuleGroupData buffer_data[PROFILE_RULE_BUFFERS];
+    json_t *js = NULL;
+
+    if (ctx->data == NULL)
+        return NULL;
+
+    data = SCMalloc(sizeof(SCProfileData) * ctx->size);
+    if (data == NULL)
+        return NULL;
+    if (ctx->sgh_size > 0) {
+        sgh_data = SCMalloc(sizeof(SCProfileRuleGroupData) * ctx->sgh_size);
+        if (sgh_data == NULL) {
+            SCFree(data);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_lock(&ctx->data_m);
+    memcpy(data, ctx->data, sizeof(SCProfileData) * ctx->size);
+    if (sgh_data != NULL)
+        memcpy(sgh_data, ctx->sgh_data, sizeof(SCProfileRuleGroupData) * ctx->sgh_size);
+    memcpy(buffer_data, ctx->buffer_data, sizeof(buffer_data));
+
+    const SCProfileRuleThreadData *td;
+    for (td = ctx->threads; td != NULL; td = td->next) {
+        SCProfilingRuleMergeData(data, td->data, MIN(ctx->size, td->size));
+        if (sgh_data != NULL) {
+            SCProfilingRuleMergeGroupData(sgh_data, td->sgh_data,
+                    MIN(ctx->sgh_size, td->sgh_size));
+        }
+        SCProfilingRuleMergeGroupData(buffer_data, td->buffer_data,
+                PROFILE_RULE_BUFFERS);
+    }
+    pthread_mutex_unlock(&ctx->data_m);
+
+    js = json_object();
+    if (js != NULL) {
+        SCProfilingRuleDataToJson(js, data, ctx->size, sgh_data, ctx->sgh_size,
+                buffer_data);
+    }
+
+    if (sgh_data != NULL)
+        SCFree(sgh_data);
+    SCFree(data);
+    return js;
+}
+#endif /* HAVE_LIBJANSSON */
+
+#ifdef BUILD_UNIX_SOCKET
+/**
+ * \brief Unix socket command returning the live rule profiling data of
+ *        the current detection engine.
+ */
+TmEcode SCProfilingRuleUnixSocket(json_t *cmd, json_t *answer, void *data)
+{
+    if (profiling_rules_enabled == 0) {
+        json_object_set_new(answer, "message",
+                json_string("rule profiling is not enabled"));
+        return TM_ECODE_FAILED;
+    }
 
+    DetectEngineCtx *de_ctx = DetectEngineGetCurrent();
+    json_t *js = SCProfilingRuleGetJson(de_ctx);
+    if (de_ctx != NULL)
+        DetectEngineDeReference(&de_ctx);
+
+    if (js == NULL) {
+        json_object_set_new(answer, "message",
+                json_string("no rule profiling data available"));
+        return TM_ECODE_FAILED;
+    }
+
+    json_object_set_new(answer, "message", js);
+    return TM_ECODE_OK;
+}
+#endif /* BUILD_UNIX_SOCKET */
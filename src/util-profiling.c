@@ -100,7 +100,6 @@ struct ProfileProtoRecords packet_profile_flowworker_data[PROFILE_FLOWWORKER_SIZ
 int profiling_packets_enabled = 0;
 int profiling_packets_csv_enabled = 0;
 
-int profiling_output_to_file = 0;
 int profiling_packets_output_to_file = 0;
 char *profiling_file_name;
 char *profiling_packets_file_name;
@@ -110,11 +109,6 @@ const char *profiling_packets_file_mode = "a";
 static int rate = 1;
 static SC_ATOMIC_DECLARE(uint64_t, samples);
 
-/**
- * Used as a check so we don't double enter a profiling run.
- */
-__thread int profiling_rules_entered = 0;
-
 void SCProfilingDumpPacketStats(void);
 const char * PacketProfileDetectIdToString(PacketProfileDetectId id);
 const char * PacketProfileLoggertIdToString(LoggerId id);
@@ -1179,24 +1173,6 @@ PktProfiling *SCProfilePacketStart(void)
         return NULL;
 }
 
-/* see if we want to profile rules for this packet */
-int SCProfileRuleStart(Packet *p)
-{
-#ifdef PROFILE_LOCKING
-    if (p->profile != NULL) {
-        p->flags |= PKT_PROFILE;
-        return 1;
-    }
-#else
-    uint64_t sample = SC_ATOMIC_ADD(samples, 1);
-    if (sample % rate == 0) {
-        p->flags |= PKT_PROFILE;
-        return 1;
-    }
-#endif
-    return 0;
-}
-
 #define CASE_CODE(E)  case E: return #E
 
 /**
@@ -1210,24 +1186,10 @@ const char * PacketProfileDetectIdToString(PacketProfileDetectId id)
 {
     switch (id) {
         CASE_CODE (PROF_DETECT_MPM);
-        CASE_CODE (PROF_DETECT_MPM_PACKET);
-//        CASE_CODE (PROF_DETECT_MPM_PKT_STREAM);
-        CASE_CODE (PROF_DETECT_MPM_STREAM);
-        CASE_CODE (PROF_DETECT_MPM_URI);
-        CASE_CODE (PROF_DETECT_MPM_HCBD);
-        CASE_CODE (PROF_DETECT_MPM_HSBD);
-        CASE_CODE (PROF_DETECT_MPM_HHD);
-        CASE_CODE (PROF_DETECT_MPM_HRHD);
-        CASE_CODE (PROF_DETECT_MPM_HMD);
-        CASE_CODE (PROF_DETECT_MPM_HCD);
-        CASE_CODE (PROF_DETECT_MPM_HRUD);
-        CASE_CODE (PROF_DETECT_MPM_HSMD);
-        CASE_CODE (PROF_DETECT_MPM_HSCD);
-        CASE_CODE (PROF_DETECT_MPM_HUAD);
-        CASE_CODE (PROF_DETECT_MPM_DNSQUERY);
-        CASE_CODE (PROF_DETECT_MPM_TLSSNI);
-        CASE_CODE (PROF_DETECT_MPM_TLSISSUER);
-        CASE_CODE (PROF_DETECT_MPM_TLSSUBJECT);
+        CASE_CODE (PROF_DETECT_PF_PKT);
+        CASE_CODE (PROF_DETECT_PF_PAYLOAD);
+        CASE_CODE (PROF_DETECT_PF_TX);
+        CASE_CODE (PROF_DETECT_PF_SORT);
         CASE_CODE (PROF_DETECT_IPONLY);
         CASE_CODE (PROF_DETECT_RULES);
         CASE_CODE (PROF_DETECT_PREFILTER);
@@ -1236,8 +1198,6 @@ const char * PacketProfileDetectIdToString(PacketProfileDetectId id)
         CASE_CODE (PROF_DETECT_CLEANUP);
         CASE_CODE (PROF_DETECT_GETSGH);
         CASE_CODE (PROF_DETECT_NONMPMLIST);
-        case PROF_DETECT_MPM_PKT_STREAM:
-            return "PROF_DETECT_MPM_PKT_STR";
         default:
             return "UNKNOWN";
     }
@@ -1279,6 +1239,7 @@ const char * PacketProfileLoggertIdToString(LoggerId id)
         CASE_CODE (LOGGER_JSON_NETFLOW);
         CASE_CODE (LOGGER_STATS);
         CASE_CODE (LOGGER_JSON_STATS);
+        CASE_CODE (LOGGER_JSON_RULE_PROFILING);
         CASE_CODE (LOGGER_PRELUDE);
         CASE_CODE (LOGGER_PCAP);
         default:
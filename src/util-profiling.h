@@ -25,24 +25,27 @@
 #ifndef __UTIL_PROFILE_H__
 #define __UTIL_PROFILE_H__
 
-#ifdef PROFILING
-
-#include "util-profiling-locks.h"
 #include "util-cpu.h"
 
+/* Rule profiling is built in all builds, and only runs when enabled in
+ * the config. The other profiling needs a profiling build. */
+
 extern int profiling_rules_enabled;
-extern int profiling_packets_enabled;
-extern int profiling_sghs_enabled;
 extern __thread int profiling_rules_entered;
+extern int profiling_rules_sample_rate;
 
-void SCProfilingPrintPacketProfile(Packet *);
-void SCProfilingAddPacket(Packet *);
 int SCProfileRuleStart(Packet *p);
 
+/** decide once per packet if its rule inspection is profiled */
+#define RULE_PROFILING_SAMPLE(p) \
+    if (profiling_rules_enabled) { \
+        (void)SCProfileRuleStart((p)); \
+    }
+
 #define RULE_PROFILING_START(p) \
     uint64_t profile_rule_start_ = 0; \
     uint64_t profile_rule_end_ = 0; \
-    if (profiling_rules_enabled && SCProfileRuleStart((p))) { \
+    if (profiling_rules_enabled && ((p)->flags & PKT_PROFILE)) { \
         if (profiling_rules_entered > 0) { \
             SCLogError(SC_ERR_FATAL, "Re-entered profiling, exiting."); \
             exit(1); \
@@ -59,6 +62,29 @@ int SCProfileRuleStart(Packet *p);
         profiling_rules_entered--; \
     }
 
+void SCProfilingRulesGlobalInit(void);
+void SCProfilingRuleDestroyCtx(struct SCProfileDetectCtx_ *);
+void SCProfilingRuleInitCounters(DetectEngineCtx *);
+void SCProfilingRuleUpdateCounter(DetectEngineThreadCtx *, uint16_t, uint64_t, int);
+void SCProfilingRuleThreadSetup(struct SCProfileDetectCtx_ *, DetectEngineThreadCtx *);
+void SCProfilingRuleThreadCleanup(DetectEngineThreadCtx *);
+#ifdef HAVE_LIBJANSSON
+json_t *SCProfilingRuleGetJson(DetectEngineCtx *);
+#endif
+#ifdef BUILD_UNIX_SOCKET
+TmEcode SCProfilingRuleUnixSocket(json_t *cmd, json_t *answer, void *data);
+#endif
+
+#ifdef PROFILING
+
+#include "util-profiling-locks.h"
+
+extern int profiling_packets_enabled;
+extern int profiling_sghs_enabled;
+
+void SCProfilingPrintPacketProfile(Packet *);
+void SCProfilingAddPacket(Packet *);
+
 extern int profiling_keyword_enabled;
 extern __thread int profiling_keyword_entered;
 
@@ -275,13 +301,6 @@ PktProfiling *SCProfilePacketStart(void);
     }
 
 
-void SCProfilingRulesGlobalInit(void);
-void SCProfilingRuleDestroyCtx(struct SCProfileDetectCtx_ *);
-void SCProfilingRuleInitCounters(DetectEngineCtx *);
-void SCProfilingRuleUpdateCounter(DetectEngineThreadCtx *, uint16_t, uint64_t, int);
-void SCProfilingRuleThreadSetup(struct SCProfileDetectCtx_ *, DetectEngineThreadCtx *);
-void SCProfilingRuleThreadCleanup(DetectEngineThreadCtx *);
-
 void SCProfilingKeywordsGlobalInit(void);
 void SCProfilingKeywordDestroyCtx(DetectEngineCtx *);//struct SCProfileKeywordDetectCtx_ *);
 void SCProfilingKeywordInitCounters(DetectEngineCtx *);
@@ -303,9 +322,6 @@ void SCProfilingDump(void);
 
 #else
 
-#define RULE_PROFILING_START(p)
-#define RULE_PROFILING_END(a,b,c,p)
-
 #define KEYWORD_PROFILING_SET_LIST(a,b)
 #define KEYWORD_PROFILING_START
 #define KEYWORD_PROFILING_END(a,b,c)
@@ -448,7 +448,7 @@ static void BMDestroyCtx(SpmCtx *ctx)
 }
 
 static uint8_t *BMScan(const SpmCtx *ctx, SpmThreadCtx *thread_ctx,
-                       const uint8_t *haystack, uint16_t haystack_len)
+                       const uint8_t *haystack, uint32_t haystack_len)
 {
     const SpmBmCtx *sctx = ctx->ctx;
 
@@ -0,0 +1,295 @@
+/* Copyright (C) 2016 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Single pattern matcher comparing the first and last needle byte against
+ * a block of haystack offsets at a time.
+ *
+ * For every offset i of a 16 (SSE2) or 32 (AVX2) byte block, haystack
+ * byte i is compared to the first needle byte and byte i + len - 1 to the
+ * last needle byte. Only the offsets where both match are compared to the
+ * rest of the needle, lowest offset first. For nocase needles both cases
+ * of the first and last byte are compared.
+ *
+ * Needles of 1 and 2 bytes need no further compare. Case sensitive one
+ * byte needles are handed to memchr.
+ *
+ * There is no context to build besides a copy of the needle, so unlike
+ * Boyer-Moore this is cheap for the many short lived scans of relative
+ * content inspection.
+ */
+
+#include "suricata-common.h"
+#include "suricata.h"
+
+#include "util-spm.h"
+#include "util-spm-simd.h"
+#include "util-debug.h"
+#include "util-error.h"
+#include "util-memcmp.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+typedef struct SpmSimdCtx_ {
+    /* needle, lowercased if nocase */
+    uint8_t *needle;
+    uint16_t needle_len;
+    int nocase;
+
+    /* first and last needle byte, in both cases if nocase */
+    uint8_t first_lo;
+    uint8_t first_up;
+    uint8_t last_lo;
+    uint8_t last_up;
+} SpmSimdCtx;
+
+/**
+ * \internal
+ * \brief Compare the needle bytes between the first and the last one.
+ *
+ * \retval 1 match
+ */
+static inline int SimdMatchMiddle(const SpmSimdCtx *sctx, const uint8_t *p)
+{
+    if (sctx->needle_len <= 2)
+        return 1;
+    if (sctx->nocase)
+        return SCMemcmpLowercase(sctx->needle + 1, p + 1, sctx->needle_len - 2) == 0;
+    return SCMemcmp(sctx->needle + 1, p + 1, sctx->needle_len - 2) == 0;
+}
+
+#if defined(__AVX2__)
+static const uint8_t *SimdScanBlocks(const SpmSimdCtx *sctx,
+        const uint8_t *haystack, uint32_t haystack_len, uint32_t *pos)
+{
+    const __m256i first_lo = _mm256_set1_epi8(sctx->first_lo);
+    const __m256i first_up = _mm256_set1_epi8(sctx->first_up);
+    const __m256i last_lo = _mm256_set1_epi8(sctx->last_lo);
+    const __m256i last_up = _mm256_set1_epi8(sctx->last_up);
+    const uint32_t last = sctx->needle_len - 1;
+    uint32_t i;
+
+    for (i = 0; i + last + 32 <= haystack_len; i += 32) {
+        const __m256i f = _mm256_loadu_si256((const __m256i *)(haystack + i));
+        const __m256i l = _mm256_loadu_si256((const __m256i *)(haystack + i + last));
+        const __m256i ef = _mm256_or_si256(_mm256_cmpeq_epi8(f, first_lo),
+                                           _mm256_cmpeq_epi8(f, first_up));
+        const __m256i el = _mm256_or_si256(_mm256_cmpeq_epi8(l, last_lo),
+                                           _mm256_cmpeq_epi8(l, last_up));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(ef, el));
+        while (bits) {
+            const uint32_t j = __builtin_ctz(bits);
+            bits &= bits - 1;
+            if (SimdMatchMiddle(sctx, haystack + i + j))
+                return haystack + i + j;
+        }
+    }
+
+    *pos = i;
+    return NULL;
+}
+#elif defined(__SSE2__)
+static const uint8_t *SimdScanBlocks(const SpmSimdCtx *sctx,
+        const uint8_t *haystack, uint32_t haystack_len, uint32_t *pos)
+{
+    const __m128i first_lo = _mm_set1_epi8(sctx->first_lo);
+    const __m128i first_up = _mm_set1_epi8(sctx->first_up);
+    const __m128i last_lo = _mm_set1_epi8(sctx->last_lo);
+    const __m128i last_up = _mm_set1_epi8(sctx->last_up);
+    const uint32_t last = sctx->needle_len - 1;
+    uint32_t i;
+
+    for (i = 0; i + last + 16 <= haystack_len; i += 16) {
+        const __m128i f = _mm_loadu_si128((const __m128i *)(haystack + i));
+        const __m128i l = _mm_loadu_si128((const __m128i *)(haystack + i + last));
+        const __m128i ef = _mm_or_si128(_mm_cmpeq_epi8(f, first_lo),
+                                        _mm_cmpeq_epi8(f, first_up));
+        const __m128i el = _mm_or_si128(_mm_cmpeq_epi8(l, last_lo),
+                                        _mm_cmpeq_epi8(l, last_up));
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_and_si128(ef, el));
+        while (bits) {
+            const uint32_t j = __builtin_ctz(bits);
+            bits &= bits - 1;
+            if (SimdMatchMiddle(sctx, haystack + i + j))
+                return haystack + i + j;
+        }
+    }
+
+    *pos = i;
+    return NULL;
+}
+#endif
+
+static uint8_t *SimdScan(const SpmCtx *ctx, SpmThreadCtx *thread_ctx,
+                         const uint8_t *haystack, uint32_t haystack_len)
+{
+    const SpmSimdCtx *sctx = ctx->ctx;
+    const uint32_t last = sctx->needle_len - 1;
+    uint32_t i = 0;
+
+    if (sctx->needle_len > haystack_len)
+        return NULL;
+
+    if (sctx->needle_len == 1 && !sctx->nocase)
+        return memchr(haystack, sctx->first_lo, haystack_len);
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    const uint8_t *found = SimdScanBlocks(sctx, haystack, haystack_len, &i);
+    if (found != NULL)
+        return (uint8_t *)found;
+#endif
+
+    /* offsets not covered by a full block */
+    for ( ; i + last < haystack_len; i++) {
+        const uint8_t f = haystack[i];
+        const uint8_t l = haystack[i + last];
+        if ((f == sctx->first_lo || f == sctx->first_up) &&
+            (l == sctx->last_lo || l == sctx->last_up) &&
+            SimdMatchMiddle(sctx, haystack + i))
+        {
+            return (uint8_t *)haystack + i;
+        }
+    }
+    return NULL;
+}
+
+static SpmCtx *SimdInitCtx(const uint8_t *needle, uint16_t needle_len, int nocase,
+                           SpmGlobalThreadCtx *global_thread_ctx)
+{
+    if (needle_len == 0) {
+        SCLogDebug("empty needle");
+        return NULL;
+    }
+
+    SpmCtx *ctx = SCMalloc(sizeof(SpmCtx));
+    if (ctx == NULL) {
+        SCLogDebug("Unable to alloc SpmCtx.");
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->matcher = SPM_SIMD;
+
+    SpmSimdCtx *sctx = SCMalloc(sizeof(SpmSimdCtx));
+    if (sctx == NULL) {
+        SCLogDebug("Unable to alloc SpmSimdCtx.");
+        SCFree(ctx);
+        return NULL;
+    }
+    memset(sctx, 0, sizeof(*sctx));
+
+    sctx->needle = SCMalloc(needle_len);
+    if (sctx->needle == NULL) {
+        SCLogDebug("Unable to alloc string.");
+        SCFree(sctx);
+        SCFree(ctx);
+        return NULL;
+    }
+    sctx->needle_len = needle_len;
+    sctx->nocase = nocase ? 1 : 0;
+
+    if (sctx->nocase) {
+        uint16_t i;
+        for (i = 0; i < needle_len; i++)
+            sctx->needle[i] = u8_tolower(needle[i]);
+        sctx->first_lo = sctx->needle[0];
+        sctx->first_up = (uint8_t)toupper(sctx->needle[0]);
+        sctx->last_lo = sctx->needle[needle_len - 1];
+        sctx->last_up = (uint8_t)toupper(sctx->needle[needle_len - 1]);
+    } else {
+        memcpy(sctx->needle, needle, needle_len);
+        sctx->first_lo = sctx->first_up = sctx->needle[0];
+        sctx->last_lo = sctx->last_up = sctx->needle[needle_len - 1];
+    }
+
+    ctx->ctx = sctx;
+    return ctx;
+}
+
+static void SimdDestroyCtx(SpmCtx *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    SpmSimdCtx *sctx = ctx->ctx;
+    if (sctx != NULL) {
+        if (sctx->needle != NULL) {
+            SCFree(sctx->needle);
+        }
+        SCFree(sctx);
+    }
+
+    SCFree(ctx);
+}
+
+static SpmGlobalThreadCtx *SimdInitGlobalThreadCtx(void)
+{
+    SpmGlobalThreadCtx *global_thread_ctx = SCMalloc(sizeof(SpmGlobalThreadCtx));
+    if (global_thread_ctx == NULL) {
+        SCLogDebug("Unable to alloc SpmThreadCtx.");
+        return NULL;
+    }
+    memset(global_thread_ctx, 0, sizeof(*global_thread_ctx));
+    global_thread_ctx->matcher = SPM_SIMD;
+    return global_thread_ctx;
+}
+
+static void SimdDestroyGlobalThreadCtx(SpmGlobalThreadCtx *global_thread_ctx)
+{
+    if (global_thread_ctx == NULL) {
+        return;
+    }
+    SCFree(global_thread_ctx);
+}
+
+static void SimdDestroyThreadCtx(SpmThreadCtx *thread_ctx)
+{
+    if (thread_ctx == NULL) {
+        return;
+    }
+    SCFree(thread_ctx);
+}
+
+static SpmThreadCtx *SimdMakeThreadCtx(const SpmGlobalThreadCtx *global_thread_ctx)
+{
+    SpmThreadCtx *thread_ctx = SCMalloc(sizeof(SpmThreadCtx));
+    if (thread_ctx == NULL) {
+        SCLogDebug("Unable to alloc SpmThreadCtx.");
+        return NULL;
+    }
+    memset(thread_ctx, 0, sizeof(*thread_ctx));
+    thread_ctx->matcher = SPM_SIMD;
+    return thread_ctx;
+}
+
+void SpmSimdRegister(void)
+{
+    spm_table[SPM_SIMD].name = "simd";
+    spm_table[SPM_SIMD].InitGlobalThreadCtx = SimdInitGlobalThreadCtx;
+    spm_table[SPM_SIMD].DestroyGlobalThreadCtx = SimdDestroyGlobalThreadCtx;
+    spm_table[SPM_SIMD].MakeThreadCtx = SimdMakeThreadCtx;
+    spm_table[SPM_SIMD].DestroyThreadCtx = SimdDestroyThreadCtx;
+    spm_table[SPM_SIMD].InitCtx = SimdInitCtx;
+    spm_table[SPM_SIMD].DestroyCtx = SimdDestroyCtx;
+    spm_table[SPM_SIMD].Scan = SimdScan;
+}
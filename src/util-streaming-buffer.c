@@ -69,6 +69,14 @@ StreamingBuffer *StreamingBufferInit(const StreamingBufferConfig *cfg)
     return NULL;
 }
 
+static void RegionFree(StreamingBuffer *sb, StreamingBufferRegion *r)
+{
+    if (r->buf != NULL) {
+        FREE(sb->cfg, r->buf, r->buf_size);
+    }
+    FREE(sb->cfg, r, sizeof(StreamingBufferRegion));
+}
+
 void StreamingBufferClear(StreamingBuffer *sb)
 {
     if (sb != NULL) {
@@ -78,6 +86,14 @@ void StreamingBufferClear(StreamingBuffer *sb)
             FREE(sb->cfg, sb->buf, sb->buf_size);
             sb->buf = NULL;
         }
+        sb->buf_size = 0;
+        sb->buf_offset = 0;
+
+        while (sb->regions != NULL) {
+            StreamingBufferRegion *r = sb->regions;
+            sb->regions = r->next;
+            RegionFree(sb, r);
+        }
     }
 }
 
@@ -151,9 +167,61 @@ static void Grow(StreamingBuffer *sb)
     }
 }
 
+#define MAIN_END(sb) ((sb)->stream_offset + (sb)->buf_size)
+#define REGION_END(r) ((r)->stream_offset + (r)->buf_size)
+
+/**
+ *  \internal
+ *  \brief move the regions the main memory block now overlaps into it
+ *
+ *  Needed after the main block grew or slid forward, so that the
+ *  memory blocks never overlap. If the main block can't grow to hold
+ *  a region, it is shrunk to end where the region starts instead.
+ */
+static void AbsorbRegions(StreamingBuffer *sb)
+{
+    StreamingBufferRegion *r;
+    while ((r = sb->regions) != NULL && sb->buf != NULL &&
+            r->stream_offset < MAIN_END(sb))
+    {
+        uint32_t rel_offset = r->stream_offset - sb->stream_offset;
+        if (rel_offset + r->buf_offset > sb->buf_size) {
+            GrowToSize(sb, rel_offset + r->buf_offset);
+        }
+        if (rel_offset + r->buf_offset > sb->buf_size) {
+            SCLogDebug("can't grow to hold region at %"PRIu64, r->stream_offset);
+            if (rel_offset == 0) {
+                FREE(sb->cfg, sb->buf, sb->buf_size);
+                sb->buf = NULL;
+                sb->buf_size = 0;
+                sb->buf_offset = 0;
+                sb->stream_offset = r->stream_offset;
+            } else {
+                void *ptr = REALLOC(sb->cfg, sb->buf, sb->buf_size, rel_offset);
+                if (ptr != NULL) {
+                    sb->buf = ptr;
+                    sb->buf_size = rel_offset;
+                }
+            }
+            return;
+        }
+
+        SCLogDebug("absorbing region at %"PRIu64" len %u", r->stream_offset,
+                r->buf_offset);
+        memcpy(sb->buf + rel_offset, r->buf, r->buf_offset);
+        if (r->buf_offset > 0 && rel_offset + r->buf_offset > sb->buf_offset)
+            sb->buf_offset = rel_offset + r->buf_offset;
+        sb->regions = r->next;
+        RegionFree(sb, r);
+    }
+}
+
 /**
  *  \brief slide to absolute offset
- *  \todo if sliding beyond window, we could perhaps reset?
+ *
+ *  If the offset is beyond the data in the main memory block, the
+ *  region holding the offset becomes the main block. Regions before
+ *  the offset are freed.
  */
 void StreamingBufferSlideToOffset(StreamingBuffer *sb, uint64_t offset)
 {
@@ -166,6 +234,32 @@ void StreamingBufferSlideToOffset(StreamingBuffer *sb, uint64_t offset)
         memmove(sb->buf, sb->buf+slide, size);
         sb->stream_offset += slide;
         sb->buf_offset = size;
+        AbsorbRegions(sb);
+
+    } else if (sb->regions != NULL &&
+            offset > sb->stream_offset + sb->buf_offset)
+    {
+        StreamingBufferRegion *r;
+        while ((r = sb->regions) != NULL &&
+                r->stream_offset + r->buf_offset < offset)
+        {
+            sb->regions = r->next;
+            RegionFree(sb, r);
+        }
+        if (r != NULL && r->stream_offset <= offset) {
+            SCLogDebug("region at %"PRIu64" becomes the main block",
+                    r->stream_offset);
+            if (sb->buf != NULL)
+                FREE(sb->cfg, sb->buf, sb->buf_size);
+            sb->buf = r->buf;
+            sb->buf_size = r->buf_size;
+            sb->buf_offset = r->buf_offset;
+            sb->stream_offset = r->stream_offset;
+            sb->regions = r->next;
+            FREE(sb->cfg, r, sizeof(StreamingBufferRegion));
+
+            StreamingBufferSlideToOffset(sb, offset);
+        }
     }
 }
 
@@ -176,6 +270,7 @@ void StreamingBufferSlide(StreamingBuffer *sb, uint32_t slide)
     memmove(sb->buf, sb->buf+slide, size);
     sb->stream_offset += slide;
     sb->buf_offset = size;
+    AbsorbRegions(sb);
 }
 
 #define DATA_FITS(sb, len) \
@@ -280,41 +375,252 @@ void StreamingBufferAppendNoTrack(StreamingBuffer *sb,
     ((offset) + (len) <= (sb)->buf_size)
 
 /**
- *  \param offset offset relative to StreamingBuffer::stream_offset
+ *  \internal
+ *  \brief grow a region to cover offset to end
+ *
+ *  Regions that the grown region overlaps are merged into it.
+ *
+ *  \retval 0 ok
+ *  \retval -1 out of memory
  */
-void StreamingBufferInsertAt(StreamingBuffer *sb, StreamingBufferSegment *seg,
-                             const uint8_t *data, uint32_t data_len,
-                             uint64_t offset)
+static int RegionGrow(StreamingBuffer *sb, StreamingBufferRegion *r,
+                      uint64_t offset, uint64_t end)
 {
-    BUG_ON(seg == NULL);
+    uint64_t start = MIN(r->stream_offset, offset);
+    uint64_t new_end = MAX(REGION_END(r), end);
+    StreamingBufferRegion *n;
+    for (n = r->next; n != NULL && n->stream_offset < new_end; n = n->next) {
+        new_end = MAX(new_end, REGION_END(n));
+    }
+    if (new_end - start > UINT32_MAX)
+        return -1;
+
+    uint32_t size = (uint32_t)(new_end - start);
+    uint32_t shift = (uint32_t)(r->stream_offset - start);
+    if (size > r->buf_size) {
+        if (shift == 0) {
+            void *ptr = REALLOC(sb->cfg, r->buf, r->buf_size, size);
+            if (ptr == NULL)
+                return -1;
+            memset((uint8_t *)ptr + r->buf_size, 0, size - r->buf_size);
+            r->buf = ptr;
+        } else {
+            uint8_t *ptr = CALLOC(sb->cfg, 1, size);
+            if (ptr == NULL)
+                return -1;
+            memcpy(ptr + shift, r->buf, r->buf_offset);
+            FREE(sb->cfg, r->buf, r->buf_size);
+            r->buf = ptr;
+            r->stream_offset = start;
+            if (r->buf_offset > 0)
+                r->buf_offset += shift;
+        }
+        r->buf_size = size;
+    }
+
+    while ((n = r->next) != NULL && n->stream_offset < new_end) {
+        uint32_t rel_offset = (uint32_t)(n->stream_offset - r->stream_offset);
+        memcpy(r->buf + rel_offset, n->buf, n->buf_offset);
+        if (n->buf_offset > 0 && rel_offset + n->buf_offset > r->buf_offset)
+            r->buf_offset = rel_offset + n->buf_offset;
+        r->next = n->next;
+        RegionFree(sb, n);
+    }
+    return 0;
+}
 
+/**
+ *  \internal
+ *  \brief make sure a memory block can hold data at offset to offset+len
+ *
+ *  Data close enough to the main memory block goes into it, growing it
+ *  if needed. Data further ahead goes into the region it is close to,
+ *  or into a new one, so that a single insert far ahead of the data
+ *  doesn't allocate all of the gap.
+ *
+ *  \param region set to the region holding the data, NULL for the main
+ *                block
+ *
+ *  \retval 0 ok
+ *  \retval -1 error: offset before window or out of memory
+ */
+static int ReserveAtOffset(StreamingBuffer *sb, uint64_t offset,
+                           uint32_t len, StreamingBufferRegion **region)
+{
     if (offset < sb->stream_offset)
-        return;
+        return -1;
 
-    if (sb->buf == NULL) {
-        if (InitBuffer(sb) == -1)
-            return;
+    const uint64_t end = offset + len;
+    const uint32_t gap = sb->cfg->region_gap;
+    StreamingBufferRegion *r, *prev = NULL;
+
+    *region = NULL;
+
+    /* fits in the main block or a region already */
+    if (sb->buf != NULL && end <= MAIN_END(sb))
+        return 0;
+    for (r = sb->regions; r != NULL && r->stream_offset <= offset; r = r->next) {
+        if (end <= REGION_END(r)) {
+            *region = r;
+            return 0;
+        }
     }
 
-    uint32_t rel_offset = offset - sb->stream_offset;
-    if (!DATA_FITS_AT_OFFSET(sb, data_len, rel_offset)) {
-        if (sb->cfg->flags & STREAMING_BUFFER_AUTOSLIDE) {
-            AutoSlide(sb);
-            rel_offset = offset - sb->stream_offset;
+    if (gap == 0 || len == 0 || offset <= MAIN_END(sb) + gap) {
+        if (sb->buf == NULL) {
+            if (InitBuffer(sb) == -1)
+                return -1;
+        }
+        if (end - sb->stream_offset > UINT32_MAX)
+            return -1;
+
+        uint32_t rel_offset = offset - sb->stream_offset;
+        if (!DATA_FITS_AT_OFFSET(sb, len, rel_offset)) {
+            if (sb->cfg->flags & STREAMING_BUFFER_AUTOSLIDE) {
+                AutoSlide(sb);
+                rel_offset = offset - sb->stream_offset;
+            }
+            if (!DATA_FITS_AT_OFFSET(sb, len, rel_offset)) {
+                GrowToSize(sb, (rel_offset + len));
+            }
         }
-        if (!DATA_FITS_AT_OFFSET(sb, data_len, rel_offset)) {
-            GrowToSize(sb, (rel_offset + data_len));
+        AbsorbRegions(sb);
+        if (!DATA_FITS_AT_OFFSET(sb, len, rel_offset)) {
+            return -1;
         }
+        return 0;
+    }
+
+    /* find the first region close to the data */
+    for (r = sb->regions; r != NULL; prev = r, r = r->next) {
+        if (offset <= REGION_END(r) + gap)
+            break;
+    }
+    if (r != NULL && end + gap >= r->stream_offset) {
+        if (RegionGrow(sb, r, offset, end) < 0)
+            return -1;
+        *region = r;
+        return 0;
+    }
+
+    SCLogDebug("new region at %"PRIu64" len %u", offset, len);
+    StreamingBufferRegion *n = CALLOC(sb->cfg, 1, sizeof(StreamingBufferRegion));
+    if (n == NULL)
+        return -1;
+    n->buf = CALLOC(sb->cfg, 1, len);
+    if (n->buf == NULL) {
+        FREE(sb->cfg, n, sizeof(StreamingBufferRegion));
+        return -1;
     }
-    BUG_ON(!DATA_FITS_AT_OFFSET(sb, data_len, rel_offset));
+    n->stream_offset = offset;
+    n->buf_size = len;
+    n->next = r;
+    if (prev != NULL)
+        prev->next = n;
+    else
+        sb->regions = n;
+    *region = n;
+    return 0;
+}
+
+/**
+ *  \internal
+ *  \brief copy data into the buffer at an absolute offset, growing
+ *         the buffer if needed
+ *
+ *  \retval 0 ok
+ *  \retval -1 error: offset before window or out of memory
+ */
+static int InsertAtOffset(StreamingBuffer *sb,
+                          const uint8_t *data, uint32_t data_len,
+                          uint64_t offset)
+{
+    StreamingBufferRegion *r = NULL;
+    if (ReserveAtOffset(sb, offset, data_len, &r) < 0)
+        return -1;
+
+    if (r == NULL) {
+        uint32_t rel_offset = offset - sb->stream_offset;
+        memcpy(sb->buf + rel_offset, data, data_len);
+        if (rel_offset + data_len > sb->buf_offset)
+            sb->buf_offset = rel_offset + data_len;
+    } else {
+        uint32_t rel_offset = offset - r->stream_offset;
+        memcpy(r->buf + rel_offset, data, data_len);
+        if (rel_offset + data_len > r->buf_offset)
+            r->buf_offset = rel_offset + data_len;
+    }
+    return 0;
+}
+
+/**
+ *  \brief make sure data can be inserted at offset to offset+len
+ *         without allocating memory
+ *
+ *  \param data_end set to the end of the data in the memory block that
+ *                  will hold the range. Data beyond it is not in use.
+ *
+ *  \retval 0 ok
+ *  \retval -1 error: offset before window or out of memory
+ */
+int StreamingBufferReserveAt(StreamingBuffer *sb, uint64_t offset,
+                             uint32_t len, uint64_t *data_end)
+{
+    StreamingBufferRegion *r = NULL;
+    if (ReserveAtOffset(sb, offset, len, &r) < 0)
+        return -1;
+
+    if (r == NULL)
+        *data_end = sb->stream_offset + sb->buf_offset;
+    else
+        *data_end = r->stream_offset + r->buf_offset;
+    return 0;
+}
+
+/**
+ *  \brief get the memory in use by the buffer's data blocks
+ */
+uint64_t StreamingBufferGetMemoryUse(const StreamingBuffer *sb)
+{
+    uint64_t size = sb->buf_size;
+    const StreamingBufferRegion *r;
+    for (r = sb->regions; r != NULL; r = r->next) {
+        size += r->buf_size + sizeof(StreamingBufferRegion);
+    }
+    return size;
+}
+
+/**
+ *  \param offset offset relative to StreamingBuffer::stream_offset
+ *
+ *  \retval 0 ok
+ *  \retval -1 error, seg is not updated
+ */
+int StreamingBufferInsertAt(StreamingBuffer *sb, StreamingBufferSegment *seg,
+                            const uint8_t *data, uint32_t data_len,
+                            uint64_t offset)
+{
+    BUG_ON(seg == NULL);
+
+    if (InsertAtOffset(sb, data, data_len, offset) < 0)
+        return -1;
 
-    memcpy(sb->buf + rel_offset, data, data_len);
     seg->stream_offset = offset;
     seg->segment_len = data_len;
-    if (rel_offset + data_len > sb->buf_offset)
-        sb->buf_offset = rel_offset + data_len;
-
+    return 0;
+}
 
+/**
+ *  \brief add data at offset w/o tracking a segment
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int StreamingBufferInsertAtNoTrack(StreamingBuffer *sb,
+                                   const uint8_t *data, uint32_t data_len,
+                                   uint64_t offset)
+{
+    return InsertAtOffset(sb, data, data_len, offset);
 }
 
 int StreamingBufferSegmentIsBeforeWindow(const StreamingBuffer *sb,
@@ -332,7 +638,22 @@ void StreamingBufferSegmentGetData(const StreamingBuffer *sb,
                                    const StreamingBufferSegment *seg,
                                    const uint8_t **data, uint32_t *data_len)
 {
-    if (seg->stream_offset >= sb->stream_offset) {
+    if (seg->stream_offset >= MAIN_END(sb)) {
+        const StreamingBufferRegion *r;
+        for (r = sb->regions; r != NULL && r->stream_offset <= seg->stream_offset;
+                r = r->next)
+        {
+            if (seg->stream_offset < REGION_END(r)) {
+                uint32_t offset = seg->stream_offset - r->stream_offset;
+                *data = r->buf + offset;
+                if (offset + seg->segment_len > r->buf_size)
+                    *data_len = r->buf_size - offset;
+                else
+                    *data_len = seg->segment_len;
+                return;
+            }
+        }
+    } else if (seg->stream_offset >= sb->stream_offset) {
         uint64_t offset = seg->stream_offset - sb->stream_offset;
         *data = sb->buf + offset;
         if (offset + seg->segment_len > sb->buf_size)
@@ -402,11 +723,22 @@ int StreamingBufferGetDataAtOffset (const StreamingBuffer *sb,
         *data = sb->buf + skip;
         *data_len = sb->buf_offset - skip;
         return 1;
-    } else {
-        *data = NULL;
-        *data_len = 0;
-        return 0;
     }
+
+    const StreamingBufferRegion *r;
+    for (r = sb ? sb->regions : NULL; r != NULL && r->stream_offset <= offset;
+            r = r->next)
+    {
+        if (offset < r->stream_offset + r->buf_offset) {
+            uint32_t skip = offset - r->stream_offset;
+            *data = r->buf + skip;
+            *data_len = r->buf_offset - skip;
+            return 1;
+        }
+    }
+    *data = NULL;
+    *data_len = 0;
+    return 0;
 }
 
 /**
@@ -711,6 +1043,127 @@ static int StreamingBufferTest05(void)
     StreamingBufferClear(&sb);
     PASS;
 }
+
+/** \test out of order inserts and a slide */
+static int StreamingBufferTest06(void)
+{
+    StreamingBufferConfig cfg = { 0, 0, 8, NULL, NULL, NULL, NULL };
+    StreamingBuffer sb = STREAMING_BUFFER_INITIALIZER(&cfg);
+    StreamingBufferSegment seg1, seg2;
+
+    FAIL_IF(StreamingBufferInsertAt(&sb, &seg2, (const uint8_t *)"CDEF", 4, 2) != 0);
+    FAIL_IF(sb.buf_offset != 6);
+    FAIL_IF(StreamingBufferInsertAt(&sb, &seg1, (const uint8_t *)"AB", 2, 0) != 0);
+    FAIL_IF(sb.buf_offset != 6);
+    FAIL_IF(StreamingBufferInsertAtNoTrack(&sb, (const uint8_t *)"GHIJKLMN", 8, 6) != 0);
+    FAIL_IF(sb.buf_offset != 14);
+    FAIL_IF(sb.buf_size < 14);
+    FAIL_IF(!StreamingBufferCompareRawData(&sb, (const uint8_t *)"ABCDEFGHIJKLMN", 14));
+    FAIL_IF(!StreamingBufferSegmentCompareRawData(&sb, &seg2, (const uint8_t *)"CDEF", 4));
+
+    StreamingBufferSlideToOffset(&sb, 4);
+    FAIL_IF(sb.stream_offset != 4);
+    FAIL_IF(sb.buf_offset != 10);
+    FAIL_IF(!StreamingBufferSegmentIsBeforeWindow(&sb, &seg1));
+    FAIL_IF(!StreamingBufferSegmentCompareRawData(&sb, &seg2, (const uint8_t *)"EF", 2));
+
+    /* can't insert before the window */
+    FAIL_IF(StreamingBufferInsertAt(&sb, &seg1, (const uint8_t *)"AB", 2, 0) != -1);
+
+    StreamingBufferClear(&sb);
+    FAIL_IF(sb.buf != NULL);
+    FAIL_IF(sb.buf_size != 0);
+    FAIL_IF(sb.buf_offset != 0);
+    PASS;
+}
+
+/** \test data far ahead goes into regions that are merged back */
+static int StreamingBufferTest07(void)
+{
+    StreamingBufferConfig cfg = { 0, 0, 8, NULL, NULL, NULL, NULL, 16 };
+    StreamingBuffer sb = STREAMING_BUFFER_INITIALIZER(&cfg);
+    StreamingBufferSegment seg;
+    const uint8_t *data = NULL;
+    uint32_t data_len = 0;
+
+    FAIL_IF(StreamingBufferInsertAtNoTrack(&sb, (const uint8_t *)"AB", 2, 0) != 0);
+    FAIL_IF(sb.buf_size != 8);
+
+    /* far ahead: only the data itself is allocated */
+    FAIL_IF(StreamingBufferInsertAtNoTrack(&sb, (const uint8_t *)"XY", 2, 1000) != 0);
+    FAIL_IF(sb.buf_size != 8);
+    FAIL_IF_NULL(sb.regions);
+    FAIL_IF(StreamingBufferGetMemoryUse(&sb) != 8 + 2 + sizeof(StreamingBufferRegion));
+    FAIL_IF(StreamingBufferGetDataAtOffset(&sb, &data, &data_len, 1000) != 1);
+    FAIL_IF(data_len != 2 || memcmp(data, "XY", 2) != 0);
+
+    /* close to the region: grows it, also backwards */
+    FAIL_IF(StreamingBufferInsertAtNoTrack(&sb, (const uint8_t *)"Z", 1, 1002) != 0);
+    FAIL_IF(StreamingBufferInsertAtNoTrack(&sb, (const uint8_t *)"W", 1, 990) != 0);
+    FAIL_IF(sb.regions->next != NULL);
+    FAIL_IF(sb.regions->stream_offset != 990);
+    FAIL_IF(sb.regions->buf_offset != 13);
+    FAIL_IF(StreamingBufferGetDataAtOffset(&sb, &data, &data_len, 1000) != 1);
+    FAIL_IF(data_len != 3 || memcmp(data, "XYZ", 3) != 0);
+
+    /* a second region */
+    FAIL_IF(StreamingBufferInsertAt(&sb, &seg, (const uint8_t *)"Q", 1, 2000) != 0);
+    FAIL_IF_NULL(sb.regions->next);
+    FAIL_IF(!StreamingBufferSegmentCompareRawData(&sb, &seg, (const uint8_t *)"Q", 1));
+
+    /* reserving space doesn't add data */
+    uint64_t data_end = 0;
+    FAIL_IF(StreamingBufferReserveAt(&sb, 1003, 4, &data_end) != 0);
+    FAIL_IF(data_end != 1003);
+    FAIL_IF(sb.regions->buf_offset != 13);
+
+    /* sliding past the main block makes the region the main block */
+    StreamingBufferSlideToOffset(&sb, 1000);
+    FAIL_IF(sb.stream_offset != 1000);
+    FAIL_IF(sb.buf_offset != 3);
+    FAIL_IF(memcmp(sb.buf, "XYZ", 3) != 0);
+    FAIL_IF_NULL(sb.regions);
+    FAIL_IF(sb.regions->stream_offset != 2000);
+
+    /* filling the gap merges the remaining region into the main block */
+    uint8_t fill[1000];
+    memset(fill, 'F', sizeof(fill));
+    FAIL_IF(StreamingBufferInsertAtNoTrack(&sb, fill, 997, 1003) != 0);
+    FAIL_IF(sb.regions != NULL);
+    FAIL_IF(sb.buf_offset != 1001);
+    FAIL_IF(!StreamingBufferSegmentCompareRawData(&sb, &seg, (const uint8_t *)"Q", 1));
+
+    StreamingBufferClear(&sb);
+    FAIL_IF(sb.regions != NULL);
+    PASS;
+}
+
+/** \test main block sliding over a region takes in its data */
+static int StreamingBufferTest08(void)
+{
+    StreamingBufferConfig cfg = { 0, 0, 8, NULL, NULL, NULL, NULL, 16 };
+    StreamingBuffer sb = STREAMING_BUFFER_INITIALIZER(&cfg);
+    const uint8_t *data = NULL;
+    uint32_t data_len = 0;
+
+    FAIL_IF(StreamingBufferInsertAtNoTrack(&sb, (const uint8_t *)"ABCDEFGH", 8, 0) != 0);
+    FAIL_IF(StreamingBufferInsertAtNoTrack(&sb, (const uint8_t *)"Z", 1, 30) != 0);
+    FAIL_IF_NULL(sb.regions);
+
+    StreamingBufferSlideToOffset(&sb, 8);
+    FAIL_IF(sb.stream_offset != 8);
+    FAIL_IF_NULL(sb.regions);
+
+    FAIL_IF(StreamingBufferInsertAtNoTrack(&sb, (const uint8_t *)"IJKLMNOP", 8, 16) != 0);
+    FAIL_IF(sb.regions != NULL);
+    FAIL_IF(StreamingBufferGetDataAtOffset(&sb, &data, &data_len, 30) != 1);
+    FAIL_IF(data_len != 1 || data[0] != 'Z');
+    FAIL_IF(StreamingBufferGetDataAtOffset(&sb, &data, &data_len, 16) != 1);
+    FAIL_IF(memcmp(data, "IJKLMNOP", 8) != 0);
+
+    StreamingBufferClear(&sb);
+    PASS;
+}
 #endif
 
 void StreamingBufferRegisterTests(void)
@@ -721,5 +1174,8 @@ void StreamingBufferRegisterTests(void)
     UtRegisterTest("StreamingBufferTest03", StreamingBufferTest03);
     UtRegisterTest("StreamingBufferTest04", StreamingBufferTest04);
     UtRegisterTest("StreamingBufferTest05", StreamingBufferTest05);
+    UtRegisterTest("StreamingBufferTest06", StreamingBufferTest06);
+    UtRegisterTest("StreamingBufferTest07", StreamingBufferTest07);
+    UtRegisterTest("StreamingBufferTest08", StreamingBufferTest08);
 #endif
 }
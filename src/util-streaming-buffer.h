@@ -34,6 +34,12 @@
  *
  * Using the segments is optional.
  *
+ * Data inserted far beyond the end of the data in the buffer is not
+ * stored in the main memory block, as that would mean allocating all
+ * of the gap in between. If StreamingBufferConfig::region_gap is set,
+ * such data goes into a separate StreamingBufferRegion. Regions are
+ * merged into the main block when it reaches them.
+ *
  *
  * stream_offset            buf_offset          stream_offset + buf_size
  * ^                        ^                   ^
@@ -70,9 +76,20 @@ typedef struct StreamingBufferConfig_ {
     void *(*Calloc)(size_t n, size_t size);
     void *(*Realloc)(void *ptr, size_t orig_size, size_t size);
     void (*Free)(void *ptr, size_t size);
+    uint32_t region_gap;    /**< max gap to the data before inserted data
+                                 goes into a region, 0 to disable regions */
 } StreamingBufferConfig;
 
-#define STREAMING_BUFFER_CONFIG_INITIALIZER { 0, 0, 0, NULL, NULL, NULL, NULL, }
+#define STREAMING_BUFFER_CONFIG_INITIALIZER { 0, 0, 0, NULL, NULL, NULL, NULL, 0, }
+
+/** memory block for data far beyond the main block */
+typedef struct StreamingBufferRegion_ {
+    uint64_t stream_offset; /**< offset of the start of the memory block */
+    uint8_t *buf;           /**< memory block */
+    uint32_t buf_size;      /**< size of memory block */
+    uint32_t buf_offset;    /**< end of the data in buf */
+    struct StreamingBufferRegion_ *next;
+} StreamingBufferRegion;
 
 typedef struct StreamingBuffer_ {
     const StreamingBufferConfig *cfg;
@@ -81,15 +98,17 @@ typedef struct StreamingBuffer_ {
     uint8_t *buf;           /**< memory block for reassembly */
     uint32_t buf_size;      /**< size of memory block */
     uint32_t buf_offset;    /**< how far we are in buf_size */
+    StreamingBufferRegion *regions; /**< sorted list of regions beyond the
+                                         main memory block */
 #ifdef DEBUG
     uint32_t buf_size_max;
 #endif
 } StreamingBuffer;
 
 #ifndef DEBUG
-#define STREAMING_BUFFER_INITIALIZER(cfg) { (cfg), 0, NULL, 0, 0, };
+#define STREAMING_BUFFER_INITIALIZER(cfg) { (cfg), 0, NULL, 0, 0, NULL, };
 #else
-#define STREAMING_BUFFER_INITIALIZER(cfg) { (cfg), 0, NULL, 0, 0, 0 };
+#define STREAMING_BUFFER_INITIALIZER(cfg) { (cfg), 0, NULL, 0, 0, NULL, 0 };
 #endif
 
 typedef struct StreamingBufferSegment_ {
@@ -110,9 +129,15 @@ void StreamingBufferAppend(StreamingBuffer *sb, StreamingBufferSegment *seg,
         const uint8_t *data, uint32_t data_len);
 void StreamingBufferAppendNoTrack(StreamingBuffer *sb,
         const uint8_t *data, uint32_t data_len);
-void StreamingBufferInsertAt(StreamingBuffer *sb, StreamingBufferSegment *seg,
-                             const uint8_t *data, uint32_t data_len,
-                             uint64_t offset);
+int StreamingBufferInsertAt(StreamingBuffer *sb, StreamingBufferSegment *seg,
+                            const uint8_t *data, uint32_t data_len,
+                            uint64_t offset);
+int StreamingBufferInsertAtNoTrack(StreamingBuffer *sb,
+                                   const uint8_t *data, uint32_t data_len,
+                                   uint64_t offset);
+int StreamingBufferReserveAt(StreamingBuffer *sb, uint64_t offset,
+                             uint32_t len, uint64_t *data_end);
+uint64_t StreamingBufferGetMemoryUse(const StreamingBuffer *sb);
 
 void StreamingBufferSegmentGetData(const StreamingBuffer *sb,
                                    const StreamingBufferSegment *seg,
@@ -30,6 +30,7 @@
 
 #include "flow-private.h"
 #include "flow-util.h"
+#include "flow-slab.h"
 
 #include "detect.h"
 #include "detect-parse.h"
@@ -988,10 +989,15 @@ int UTHBuildPacketOfFlowsTest01(void)
 
     FlowInitConfig(FLOW_QUIET);
     uint32_t flow_spare_q_len = flow_spare_q.len;
+    uint32_t slab_used = 0, slab_used_after = 0;
+    FlowSlabGetObjects(NULL, &slab_used);
 
     UTHBuildPacketOfFlows(0, 100, 0);
 
-    if (flow_spare_q.len != flow_spare_q_len - 100)
+    /* new flows come from the slab, not from the spare queue */
+    FlowSlabGetObjects(NULL, &slab_used_after);
+    if (flow_spare_q.len != flow_spare_q_len ||
+        slab_used_after != slab_used + 100)
         result = 0;
     else
         result = 1;